@@ -0,0 +1,443 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	enum : uint32_t
+	{
+		PrepareBatchSize = 16384,
+		BinChunkSize = 16384,		// Triangles per job when a node is binned in parallel
+	};
+
+	// Relative to one triangle intersection
+	constexpr float TraversalCost = 1.0f;
+
+	float GetComponent(const Float3& v, uint32_t axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+
+	float GetHalfArea(const Float3& boundsMin, const Float3& boundsMax)
+	{
+		const Float3 extent = boundsMax - boundsMin;
+		return extent.x < 0.0f ? 0.0f : extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+}
+
+Bvh::Bvh(JobSystem* pJobSystem)
+	: m_pJobSystem(pJobSystem)
+{
+}
+
+void Bvh::Build(const Float3* pPositions, const uint32_t* pIndices, uint32_t numTriangles)
+{
+	m_references.resize(numTriangles);
+	m_triangles.resize(numTriangles);
+
+	auto prepareTriangles = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const Float3& p0 = pPositions[pIndices[i * 3 + 0]];
+			const Float3& p1 = pPositions[pIndices[i * 3 + 1]];
+			const Float3& p2 = pPositions[pIndices[i * 3 + 2]];
+			m_references[i] = { Min(Min(p0, p1), p2), i, Max(Max(p0, p1), p2), 0 };
+			m_triangles[i] = { p0, p1 - p0, p2 - p0 };
+		}
+	};
+	JobCounter prepareCounter;
+	m_pJobSystem->ParallelFor(numTriangles, PrepareBatchSize, prepareTriangles, &prepareCounter);
+	m_pJobSystem->Wait(&prepareCounter);
+
+	m_nodes.resize(std::max(numTriangles * 2, 2u) - 1);
+	m_nodes[0] = { { FLT_MAX, FLT_MAX, FLT_MAX }, 0, { -FLT_MAX, -FLT_MAX, -FLT_MAX }, numTriangles };
+	m_numNodes = 1;
+	if (numTriangles > 0)
+	{
+		Subdivide(0, 0);
+	}
+	m_nodes.resize(m_numNodes);
+
+	// Triangles in leaf order
+	const std::vector<Triangle> inputTriangles = std::move(m_triangles);
+	m_triangles.resize(numTriangles);
+	m_triangleIndices.resize(numTriangles);
+	auto reorderTriangles = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			m_triangleIndices[i] = m_references[i].triangle;
+			m_triangles[i] = inputTriangles[m_references[i].triangle];
+		}
+	};
+	JobCounter reorderCounter;
+	m_pJobSystem->ParallelFor(numTriangles, PrepareBatchSize, reorderTriangles, &reorderCounter);
+	m_pJobSystem->Wait(&reorderCounter);
+
+	m_references = {};
+	ComputeStatistics();
+}
+
+void Bvh::ComputeBounds(uint32_t first, uint32_t count, Float3& boundsMin, Float3& boundsMax, Float3& centroidMin, Float3& centroidMax) const
+{
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const Reference& reference = m_references[i];
+		const Float3 centroid = (reference.boundsMin + reference.boundsMax) * 0.5f;
+		boundsMin = Min(boundsMin, reference.boundsMin);
+		boundsMax = Max(boundsMax, reference.boundsMax);
+		centroidMin = Min(centroidMin, centroid);
+		centroidMax = Max(centroidMax, centroid);
+	}
+}
+
+void Bvh::FillBins(uint32_t first, uint32_t count, uint32_t axis, float centroidMin, float binScale, Bin* pBins) const
+{
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const Reference& reference = m_references[i];
+		const float centroid = (GetComponent(reference.boundsMin, axis) + GetComponent(reference.boundsMax, axis)) * 0.5f;
+		Bin& bin = pBins[std::min(uint32_t((centroid - centroidMin) * binScale), NumBins - 1u)];
+		bin.boundsMin = Min(bin.boundsMin, reference.boundsMin);
+		bin.boundsMax = Max(bin.boundsMax, reference.boundsMax);
+		bin.count++;
+	}
+}
+
+void Bvh::Subdivide(uint32_t nodeIndex, uint32_t depth)
+{
+	const uint32_t first = m_nodes[nodeIndex].leftOrFirst;
+	const uint32_t count = m_nodes[nodeIndex].count;
+	const bool bParallel = count > ParallelBinSize;
+	const uint32_t numChunks = bParallel ? (count + BinChunkSize - 1) / BinChunkSize : 1;
+	auto getChunkRange = [&](uint32_t chunk, uint32_t& chunkFirst, uint32_t& chunkCount)
+	{
+		chunkFirst = first + chunk * BinChunkSize;
+		chunkCount = bParallel ? std::min<uint32_t>(BinChunkSize, first + count - chunkFirst) : count;
+	};
+
+	// Node and centroid bounds, per chunk then merged
+	struct ChunkBounds
+	{
+		Float3 boundsMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+		Float3 boundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		Float3 centroidMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+		Float3 centroidMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	};
+	// Only nodes binned in parallel allocate, the others use the stack
+	ChunkBounds localBounds;
+	std::vector<ChunkBounds> parallelBounds(bParallel ? numChunks : 0);
+	ChunkBounds* pChunkBounds = bParallel ? parallelBounds.data() : &localBounds;
+	auto computeChunkBounds = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t chunk = begin; chunk < end; chunk++)
+		{
+			uint32_t chunkFirst, chunkCount;
+			getChunkRange(chunk, chunkFirst, chunkCount);
+			ChunkBounds& bounds = pChunkBounds[chunk];
+			ComputeBounds(chunkFirst, chunkCount, bounds.boundsMin, bounds.boundsMax, bounds.centroidMin, bounds.centroidMax);
+		}
+	};
+	if (bParallel)
+	{
+		JobCounter counter;
+		m_pJobSystem->ParallelFor(numChunks, 1, computeChunkBounds, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+	else
+	{
+		computeChunkBounds(0, 1);
+	}
+	ChunkBounds bounds;
+	for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+	{
+		bounds.boundsMin = Min(bounds.boundsMin, pChunkBounds[chunk].boundsMin);
+		bounds.boundsMax = Max(bounds.boundsMax, pChunkBounds[chunk].boundsMax);
+		bounds.centroidMin = Min(bounds.centroidMin, pChunkBounds[chunk].centroidMin);
+		bounds.centroidMax = Max(bounds.centroidMax, pChunkBounds[chunk].centroidMax);
+	}
+	m_nodes[nodeIndex].boundsMin = bounds.boundsMin;
+	m_nodes[nodeIndex].boundsMax = bounds.boundsMax;
+	if (count <= 1 || depth + 1 >= MaxDepth)
+	{
+		return;
+	}
+
+	// Bin centroids along every axis with an extent
+	const Bin emptyBin = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX }, 0 };
+	Bin localBins[3 * NumBins];
+	std::fill(localBins, localBins + 3 * NumBins, emptyBin);
+	std::vector<Bin> parallelBins(bParallel ? size_t(numChunks) * 3 * NumBins : 0, emptyBin);
+	Bin* pChunkBins = bParallel ? parallelBins.data() : localBins;
+	float binScales[3];
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const float extent = GetComponent(bounds.centroidMax, axis) - GetComponent(bounds.centroidMin, axis);
+		binScales[axis] = extent > 0.0f ? float(NumBins) / extent : 0.0f;
+	}
+	auto fillChunkBins = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t chunk = begin; chunk < end; chunk++)
+		{
+			uint32_t chunkFirst, chunkCount;
+			getChunkRange(chunk, chunkFirst, chunkCount);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				if (binScales[axis] > 0.0f)
+				{
+					FillBins(chunkFirst, chunkCount, axis, GetComponent(bounds.centroidMin, axis), binScales[axis], &pChunkBins[(size_t(chunk) * 3 + axis) * NumBins]);
+				}
+			}
+		}
+	};
+	if (bParallel)
+	{
+		JobCounter counter;
+		m_pJobSystem->ParallelFor(numChunks, 1, fillChunkBins, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+	else
+	{
+		fillChunkBins(0, 1);
+	}
+
+	// Sweep the bin boundaries, cost = area * triangles on both sides
+	float bestCost = FLT_MAX;
+	uint32_t bestAxis = 0;
+	uint32_t bestSplit = 0;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		if (binScales[axis] == 0.0f)
+		{
+			continue;
+		}
+		Bin bins[NumBins];
+		std::fill(bins, bins + NumBins, emptyBin);
+		for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+		{
+			const Bin* pAxisBins = &pChunkBins[(size_t(chunk) * 3 + axis) * NumBins];
+			for (uint32_t i = 0; i < NumBins; i++)
+			{
+				bins[i].boundsMin = Min(bins[i].boundsMin, pAxisBins[i].boundsMin);
+				bins[i].boundsMax = Max(bins[i].boundsMax, pAxisBins[i].boundsMax);
+				bins[i].count += pAxisBins[i].count;
+			}
+		}
+
+		float leftCosts[NumBins - 1];
+		Bin left = emptyBin;
+		for (uint32_t i = 0; i < NumBins - 1; i++)
+		{
+			left.boundsMin = Min(left.boundsMin, bins[i].boundsMin);
+			left.boundsMax = Max(left.boundsMax, bins[i].boundsMax);
+			left.count += bins[i].count;
+			leftCosts[i] = left.count * GetHalfArea(left.boundsMin, left.boundsMax);
+		}
+		Bin right = emptyBin;
+		for (uint32_t i = NumBins - 1; i > 0; i--)
+		{
+			right.boundsMin = Min(right.boundsMin, bins[i].boundsMin);
+			right.boundsMax = Max(right.boundsMax, bins[i].boundsMax);
+			right.count += bins[i].count;
+			const float cost = leftCosts[i - 1] + right.count * GetHalfArea(right.boundsMin, right.boundsMax);
+			if (right.count > 0 && right.count < count && cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// All centroids in one point, or splitting costs more than intersecting every triangle
+	const float nodeArea = GetHalfArea(bounds.boundsMin, bounds.boundsMax);
+	if (bestCost == FLT_MAX || (count <= MaxLeafSize && TraversalCost * nodeArea + bestCost >= count * nodeArea))
+	{
+		return;
+	}
+
+	const float centroidMin = GetComponent(bounds.centroidMin, bestAxis);
+	const float binScale = binScales[bestAxis];
+	Reference* pMiddle = std::partition(&m_references[first], &m_references[first] + count, [&](const Reference& reference)
+	{
+		const float centroid = (GetComponent(reference.boundsMin, bestAxis) + GetComponent(reference.boundsMax, bestAxis)) * 0.5f;
+		return std::min(uint32_t((centroid - centroidMin) * binScale), NumBins - 1u) < bestSplit;
+	});
+	const uint32_t leftCount = uint32_t(pMiddle - &m_references[first]);
+
+	const uint32_t children = m_numNodes.fetch_add(2);
+	m_nodes[children] = { {}, first, {}, leftCount };
+	m_nodes[children + 1] = { {}, first + leftCount, {}, count - leftCount };
+	m_nodes[nodeIndex].leftOrFirst = children;
+	m_nodes[nodeIndex].count = 0;
+
+	if (count > ParallelTaskSize)
+	{
+		JobCounter counter;
+		m_pJobSystem->Run([this, children, depth] { Subdivide(children, depth + 1); }, &counter);
+		Subdivide(children + 1, depth + 1);
+		m_pJobSystem->Wait(&counter);
+	}
+	else
+	{
+		Subdivide(children, depth + 1);
+		Subdivide(children + 1, depth + 1);
+	}
+}
+
+void Bvh::ComputeStatistics()
+{
+	m_statistics = {};
+	m_statistics.numNodes = uint32_t(m_nodes.size());
+	if (m_triangleIndices.empty())
+	{
+		return;
+	}
+
+	const float rootArea = std::max(GetHalfArea(m_nodes[0].boundsMin, m_nodes[0].boundsMax), FLT_MIN);
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0u, 0u } };
+	while (!stack.empty())
+	{
+		const auto [nodeIndex, depth] = stack.back();
+		stack.pop_back();
+		const BvhNode& node = m_nodes[nodeIndex];
+		const float relativeArea = GetHalfArea(node.boundsMin, node.boundsMax) / rootArea;
+		m_statistics.maxDepth = std::max(m_statistics.maxDepth, depth);
+		if (node.IsLeaf())
+		{
+			m_statistics.numLeaves++;
+			m_statistics.sahCost += relativeArea * node.count;
+		}
+		else
+		{
+			m_statistics.sahCost += relativeArea * TraversalCost;
+			stack.push_back({ node.leftOrFirst, depth + 1 });
+			stack.push_back({ node.leftOrFirst + 1, depth + 1 });
+		}
+	}
+}
+
+BoundingBox Bvh::GetBounds() const
+{
+	return { m_nodes.empty() ? Float3() : m_nodes[0].boundsMin, m_nodes.empty() ? Float3() : m_nodes[0].boundsMax };
+}
+
+bool Bvh::Intersect(const BvhRay& ray, BvhHit& hit) const
+{
+	if (m_triangles.empty())
+	{
+		return false;
+	}
+
+	const Float3 inverseDirection = GetRayInverseDirection(ray.direction);
+	float tMax = ray.tMax;
+	uint32_t closest = BvhHit::InvalidTriangle;
+	float closestU = 0.0f;
+	float closestV = 0.0f;
+
+	struct StackEntry
+	{
+		uint32_t	node;
+		float		distance;
+	};
+	StackEntry stack[MaxDepth];
+	uint32_t stackSize = 0;
+	if (IntersectRayBounds(m_nodes[0].boundsMin, m_nodes[0].boundsMax, ray.origin, inverseDirection, ray.tMin, tMax) != FLT_MAX)
+	{
+		stack[stackSize++] = { 0, ray.tMin };
+	}
+	while (stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		if (entry.distance >= tMax)
+		{
+			continue;
+		}
+		const BvhNode* pNode = &m_nodes[entry.node];
+		while (!pNode->IsLeaf())
+		{
+			uint32_t nearChild = pNode->leftOrFirst;
+			uint32_t farChild = nearChild + 1;
+			float nearDistance = IntersectRayBounds(m_nodes[nearChild].boundsMin, m_nodes[nearChild].boundsMax, ray.origin, inverseDirection, ray.tMin, tMax);
+			float farDistance = IntersectRayBounds(m_nodes[farChild].boundsMin, m_nodes[farChild].boundsMax, ray.origin, inverseDirection, ray.tMin, tMax);
+			if (farDistance < nearDistance)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearDistance, farDistance);
+			}
+			if (nearDistance == FLT_MAX)
+			{
+				pNode = nullptr;
+				break;
+			}
+			if (farDistance != FLT_MAX)
+			{
+				stack[stackSize++] = { farChild, farDistance };
+			}
+			pNode = &m_nodes[nearChild];
+		}
+		if (!pNode)
+		{
+			continue;
+		}
+
+		for (uint32_t i = pNode->leftOrFirst; i < pNode->leftOrFirst + pNode->count; i++)
+		{
+			float t, u, v;
+			if (IntersectRayTriangle(m_triangles[i].v0, m_triangles[i].edge1, m_triangles[i].edge2, ray, tMax, t, u, v))
+			{
+				tMax = t;
+				closest = i;
+				closestU = u;
+				closestV = v;
+			}
+		}
+	}
+
+	if (closest == BvhHit::InvalidTriangle)
+	{
+		return false;
+	}
+	hit = { tMax, closestU, closestV, m_triangleIndices[closest] };
+	return true;
+}
+
+bool Bvh::IsOccluded(const BvhRay& ray) const
+{
+	if (m_triangles.empty())
+	{
+		return false;
+	}
+
+	const Float3 inverseDirection = GetRayInverseDirection(ray.direction);
+	uint32_t stack[MaxDepth];
+	uint32_t stackSize = 0;
+	if (IntersectRayBounds(m_nodes[0].boundsMin, m_nodes[0].boundsMax, ray.origin, inverseDirection, ray.tMin, ray.tMax) != FLT_MAX)
+	{
+		stack[stackSize++] = 0;
+	}
+	while (stackSize > 0)
+	{
+		const BvhNode& node = m_nodes[stack[--stackSize]];
+		if (node.IsLeaf())
+		{
+			for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+			{
+				float t, u, v;
+				if (IntersectRayTriangle(m_triangles[i].v0, m_triangles[i].edge1, m_triangles[i].edge2, ray, ray.tMax, t, u, v))
+				{
+					return true;
+				}
+			}
+			continue;
+		}
+		for (uint32_t child = node.leftOrFirst; child < node.leftOrFirst + 2; child++)
+		{
+			if (IntersectRayBounds(m_nodes[child].boundsMin, m_nodes[child].boundsMax, ray.origin, inverseDirection, ray.tMin, ray.tMax) != FLT_MAX)
+			{
+				stack[stackSize++] = child;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+// Triangle bounding volume hierarchy for ray queries (PathTracer, bakers)
+// Built top down with a binned surface area heuristic: large nodes bin their centroids in parallel chunks and
+// subtrees above a size threshold are built as jobs, so the build scales with the JobSystem. Children are allocated
+// in pairs from an atomic counter, the node order therefore depends on scheduling but the tree does not.
+//
+// Triangles are copied in leaf order as (v0, edge1, edge2) so leaves are contiguous in memory. Traversal is
+// closest hit or any hit with a small stack, the nearer child first.
+
+#include "EngineMath.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <vector>
+
+struct BvhNode
+{
+	Float3		boundsMin;
+	uint32_t	leftOrFirst;	// Inner node: index of the left child, the right one follows. Leaf: first triangle
+	Float3		boundsMax;
+	uint32_t	count;			// Triangles of a leaf, 0 for inner nodes
+
+	bool IsLeaf() const { return count != 0; }
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode should stay half a cache line");
+
+struct BvhRay
+{
+	Float3	origin;
+	Float3	direction;			// Need not be normalized, t is in units of its length
+	float	tMin = 0.0f;
+	float	tMax = 1e30f;
+};
+
+struct BvhHit
+{
+	enum : uint32_t { InvalidTriangle = ~0u };
+
+	float		t = 0.0f;
+	float		u = 0.0f;		// Barycentrics of vertex 1 and 2
+	float		v = 0.0f;
+	uint32_t	triangle = InvalidTriangle;		// Index into the triangles passed to Build()
+};
+
+// Ray tests shared by the hierarchies. Zero direction components become tiny instead, so 0 * inverse is never NaN
+inline Float3 GetRayInverseDirection(const Float3& direction)
+{
+	auto inverse = [](float value) { return 1.0f / (std::fabs(value) > 1e-20f ? value : std::copysign(1e-20f, value)); };
+	return { inverse(direction.x), inverse(direction.y), inverse(direction.z) };
+}
+
+// Entry distance clamped to tMin, FLT_MAX on a miss
+inline float IntersectRayBounds(const Float3& boundsMin, const Float3& boundsMax, const Float3& origin, const Float3& inverseDirection, float tMin, float tMax)
+{
+	const float x0 = (boundsMin.x - origin.x) * inverseDirection.x;
+	const float x1 = (boundsMax.x - origin.x) * inverseDirection.x;
+	const float y0 = (boundsMin.y - origin.y) * inverseDirection.y;
+	const float y1 = (boundsMax.y - origin.y) * inverseDirection.y;
+	const float z0 = (boundsMin.z - origin.z) * inverseDirection.z;
+	const float z1 = (boundsMax.z - origin.z) * inverseDirection.z;
+	const float entry = std::max({ std::min(x0, x1), std::min(y0, y1), std::min(z0, z1), tMin });
+	const float exit = std::min({ std::max(x0, x1), std::max(y0, y1), std::max(z0, z1), tMax });
+	return entry <= exit ? entry : FLT_MAX;
+}
+
+// Moeller-Trumbore, hits strictly within (ray.tMin, tMax)
+inline bool IntersectRayTriangle(const Float3& v0, const Float3& edge1, const Float3& edge2, const BvhRay& ray, float tMax, float& t, float& u, float& v)
+{
+	const Float3 p = Cross(ray.direction, edge2);
+	const float determinant = Dot(edge1, p);
+	if (std::fabs(determinant) < 1e-20f)
+	{
+		return false;
+	}
+	const float inverseDeterminant = 1.0f / determinant;
+	const Float3 s = ray.origin - v0;
+	u = Dot(s, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+	const Float3 q = Cross(s, edge1);
+	v = Dot(ray.direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f)
+	{
+		return false;
+	}
+	t = Dot(edge2, q) * inverseDeterminant;
+	return t > ray.tMin && t < tMax;
+}
+
+struct BvhBuildStatistics
+{
+	uint32_t	numNodes = 0;
+	uint32_t	numLeaves = 0;
+	uint32_t	maxDepth = 0;
+	float		sahCost = 0.0f;		// Expected traversal + intersection cost per ray, relative to the root area
+};
+
+class Bvh
+{
+public:
+	enum : uint32_t
+	{
+		NumBins = 16,
+		MaxLeafSize = 8,
+		MaxDepth = 64,				// Traversal stack size
+		ParallelTaskSize = 4096,	// Subtrees with more triangles are built as jobs
+		ParallelBinSize = 65536,	// Nodes with more triangles are binned in parallel chunks
+	};
+
+	explicit Bvh(JobSystem* pJobSystem);
+
+	// Indexed triangle list. Degenerate triangles are kept, they never hit
+	void Build(const Float3* pPositions, const uint32_t* pIndices, uint32_t numTriangles);
+
+	// Closest hit within [tMin, tMax], false if there is none
+	bool Intersect(const BvhRay& ray, BvhHit& hit) const;
+	// Any hit within [tMin, tMax], for shadow rays
+	bool IsOccluded(const BvhRay& ray) const;
+
+	uint32_t GetNumTriangles() const { return uint32_t(m_triangleIndices.size()); }
+	const std::vector<BvhNode>& GetNodes() const { return m_nodes; }
+	BoundingBox GetBounds() const;
+	const BvhBuildStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+	struct Triangle
+	{
+		Float3 v0;
+		Float3 edge1;
+		Float3 edge2;
+	};
+
+	// Partitioned in place while building, the bounds travel with the triangle so every pass reads sequentially
+	struct Reference
+	{
+		Float3		boundsMin;
+		uint32_t	triangle;
+		Float3		boundsMax;
+		uint32_t	reserved;
+	};
+
+	struct Bin
+	{
+		Float3		boundsMin;
+		Float3		boundsMax;
+		uint32_t	count;
+	};
+
+	void Subdivide(uint32_t nodeIndex, uint32_t depth);
+	void ComputeBounds(uint32_t first, uint32_t count, Float3& boundsMin, Float3& boundsMax, Float3& centroidMin, Float3& centroidMax) const;
+	void FillBins(uint32_t first, uint32_t count, uint32_t axis, float centroidMin, float binScale, Bin* pBins) const;
+	void ComputeStatistics();
+
+	JobSystem*				m_pJobSystem;
+	std::vector<BvhNode>	m_nodes;
+	std::atomic<uint32_t>	m_numNodes = 0;
+	std::vector<Triangle>	m_triangles;			// Leaf order
+	std::vector<uint32_t>	m_triangleIndices;		// Leaf order to input order
+
+	std::vector<Reference>	m_references;			// Build scratch
+
+	BvhBuildStatistics		m_statistics;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// Perspective camera, left handed with +z forward in view space
+
+#include "EngineMath.h"
+
+struct Camera
+{
+	Float3	position = { 0.0f, 0.0f, 0.0f };
+	Float3	forward = { 0.0f, 0.0f, 1.0f };
+	Float3	up = { 0.0f, 1.0f, 0.0f };
+	float	fovY = 1.0471976f;	// 60 degrees
+	float	aspectRatio = 16.0f / 9.0f;
+	float	nearZ = 0.1f;
+	float	farZ = 1000.0f;
+
+	Float4x4 GetViewMatrix() const { return MatrixLookToLH(position, forward, up); }
+	Float4x4 GetProjectionMatrix() const { return MatrixPerspectiveFovLH(fovY, aspectRatio, nearZ, farZ); }
+	Float4x4 GetViewProjectionMatrix() const { return MatrixMultiply(GetViewMatrix(), GetProjectionMatrix()); }
+};
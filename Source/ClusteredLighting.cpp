@@ -0,0 +1,518 @@
+#include "ClusteredLighting.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstring>
+
+namespace
+{
+	// Fields of the view space light SoA, m_viewLights[field * numLights + light]
+	enum ViewLightField
+	{
+		ViewLightCenterX,
+		ViewLightCenterY,
+		ViewLightCenterZ,
+		ViewLightRadius,
+		ViewLightDirectionX,
+		ViewLightDirectionY,
+		ViewLightDirectionZ,
+		ViewLightCos,
+		ViewLightSin,
+		ViewLightSpotMask,		// All bits set for spot lights
+		NumViewLightFields,
+	};
+
+	// m_lightRanges[light * NumLightRangeFields + field], inclusive
+	enum LightRangeField
+	{
+		LightRangeSliceMin,
+		LightRangeSliceMax,
+		LightRangeTileYMin,
+		LightRangeTileYMax,
+		LightRangeTileXMin,
+		LightRangeTileXMax,
+		NumLightRangeFields,
+	};
+
+	enum : uint32_t
+	{
+		PrepareBatchSize = 1024,
+	};
+
+	float SpotMaskAsFloat(bool bIsSpot)
+	{
+		const uint32_t bits = bIsSpot ? ~0u : 0u;
+		float mask;
+		memcpy(&mask, &bits, sizeof(mask));
+		return mask;
+	}
+
+	int32_t ClampTile(float pixel, uint32_t tileSize, uint32_t numTiles)
+	{
+		return std::clamp(int32_t(std::floor(pixel / float(tileSize))), 0, int32_t(numTiles) - 1);
+	}
+}
+
+uint32_t LightList::AddPointLight(const Float3& position, float lightRadius, const Float3& intensity)
+{
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	positionZ.push_back(position.z);
+	radius.push_back(lightRadius);
+	directionX.push_back(0.0f);
+	directionY.push_back(0.0f);
+	directionZ.push_back(1.0f);
+	cosOuterAngle.push_back(-1.0f);
+	sinOuterAngle.push_back(0.0f);
+	bIsSpot.push_back(0);
+	intensityR.push_back(intensity.x);
+	intensityG.push_back(intensity.y);
+	intensityB.push_back(intensity.z);
+	return GetNumLights() - 1;
+}
+
+uint32_t LightList::AddSpotLight(const Float3& position, const Float3& direction, float range, float outerAngle, const Float3& intensity)
+{
+	const Float3 normalizedDirection = Normalize(direction);
+	positionX.push_back(position.x);
+	positionY.push_back(position.y);
+	positionZ.push_back(position.z);
+	radius.push_back(range);
+	directionX.push_back(normalizedDirection.x);
+	directionY.push_back(normalizedDirection.y);
+	directionZ.push_back(normalizedDirection.z);
+	cosOuterAngle.push_back(std::cos(outerAngle));
+	sinOuterAngle.push_back(std::sin(outerAngle));
+	bIsSpot.push_back(1);
+	intensityR.push_back(intensity.x);
+	intensityG.push_back(intensity.y);
+	intensityB.push_back(intensity.z);
+	return GetNumLights() - 1;
+}
+
+void LightList::Clear()
+{
+	for (std::vector<float>* pStream : { &positionX, &positionY, &positionZ, &radius, &directionX, &directionY, &directionZ, &cosOuterAngle, &sinOuterAngle, &intensityR, &intensityG, &intensityB })
+	{
+		pStream->clear();
+	}
+	bIsSpot.clear();
+}
+
+ClusteredLightBinner::ClusteredLightBinner(JobSystem* pJobSystem, const ClusterGridDesc& desc)
+	: m_pJobSystem(pJobSystem)
+{
+	SetGridDesc(desc);
+}
+
+void ClusteredLightBinner::SetGridDesc(const ClusterGridDesc& desc)
+{
+	check(desc.width == 0 || desc.height == 0 || desc.tileSize == 0 || desc.numSlices == 0);
+	m_desc = desc;
+	m_numTilesX = (desc.width + desc.tileSize - 1) / desc.tileSize;
+	m_numTilesY = (desc.height + desc.tileSize - 1) / desc.tileSize;
+	m_slices.resize(desc.numSlices);
+	m_bBoundsDirty = true;
+}
+
+void ClusteredLightBinner::UpdateClusterBounds(const Camera& camera)
+{
+	m_tanHalfFovY = std::tan(camera.fovY * 0.5f);
+	m_tanHalfFovX = m_tanHalfFovY * camera.aspectRatio;
+	m_nearZ = camera.nearZ;
+	m_farZ = camera.farZ;
+
+	const uint32_t numSlices = m_desc.numSlices;
+	m_sliceNearZ.resize(numSlices);
+	m_sliceFarZ.resize(numSlices);
+	for (uint32_t slice = 0; slice < numSlices; slice++)
+	{
+		// Exponential slices keep clusters roughly cubic
+		m_sliceNearZ[slice] = m_nearZ * std::pow(m_farZ / m_nearZ, float(slice) / numSlices);
+		m_sliceFarZ[slice] = slice + 1 == numSlices ? m_farZ : m_nearZ * std::pow(m_farZ / m_nearZ, float(slice + 1) / numSlices);
+	}
+
+	// The frustum widens with depth, each extent comes from either the near or the far plane of the slice
+	m_tileMinX.resize(numSlices * m_numTilesX);
+	m_tileMaxX.resize(numSlices * m_numTilesX);
+	m_tileMinY.resize(numSlices * m_numTilesY);
+	m_tileMaxY.resize(numSlices * m_numTilesY);
+	for (uint32_t slice = 0; slice < numSlices; slice++)
+	{
+		const float z0 = m_sliceNearZ[slice];
+		const float z1 = m_sliceFarZ[slice];
+		for (uint32_t tileX = 0; tileX < m_numTilesX; tileX++)
+		{
+			const float ndcMin = 2.0f * float(tileX * m_desc.tileSize) / m_desc.width - 1.0f;
+			const float ndcMax = std::min(2.0f * float((tileX + 1) * m_desc.tileSize) / m_desc.width - 1.0f, 1.0f);
+			m_tileMinX[slice * m_numTilesX + tileX] = std::min(ndcMin * z0, ndcMin * z1) * m_tanHalfFovX;
+			m_tileMaxX[slice * m_numTilesX + tileX] = std::max(ndcMax * z0, ndcMax * z1) * m_tanHalfFovX;
+		}
+		for (uint32_t tileY = 0; tileY < m_numTilesY; tileY++)
+		{
+			// Tile row 0 is the top of the screen
+			const float ndcTop = 1.0f - 2.0f * float(tileY * m_desc.tileSize) / m_desc.height;
+			const float ndcBottom = std::max(1.0f - 2.0f * float((tileY + 1) * m_desc.tileSize) / m_desc.height, -1.0f);
+			m_tileMinY[slice * m_numTilesY + tileY] = std::min(ndcBottom * z0, ndcBottom * z1) * m_tanHalfFovY;
+			m_tileMaxY[slice * m_numTilesY + tileY] = std::max(ndcTop * z0, ndcTop * z1) * m_tanHalfFovY;
+		}
+	}
+	m_bBoundsDirty = false;
+}
+
+BoundingBox ClusteredLightBinner::GetClusterBounds(uint32_t tileX, uint32_t tileY, uint32_t slice) const
+{
+	return
+	{
+		{ m_tileMinX[slice * m_numTilesX + tileX], m_tileMinY[slice * m_numTilesY + tileY], m_sliceNearZ[slice] },
+		{ m_tileMaxX[slice * m_numTilesX + tileX], m_tileMaxY[slice * m_numTilesY + tileY], m_sliceFarZ[slice] },
+	};
+}
+
+Float2 ClusteredLightBinner::GetClusterSliceScaleBias() const
+{
+	const float scale = float(m_desc.numSlices) / std::log(m_farZ / m_nearZ);
+	return { scale, -std::log(m_nearZ) * scale };
+}
+
+int32_t ClusteredLightBinner::GetSliceFromDepth(float viewZ) const
+{
+	if (viewZ < m_nearZ || viewZ > m_farZ)
+	{
+		return -1;
+	}
+	const float slice = std::log(viewZ / m_nearZ) * float(m_desc.numSlices) / std::log(m_farZ / m_nearZ);
+	return std::min(int32_t(slice), int32_t(m_desc.numSlices) - 1);
+}
+
+void ClusteredLightBinner::Bin(const LightList& lights, const Camera& camera)
+{
+	if (m_bBoundsDirty || std::tan(camera.fovY * 0.5f) != m_tanHalfFovY || m_tanHalfFovY * camera.aspectRatio != m_tanHalfFovX ||
+		camera.nearZ != m_nearZ || camera.farZ != m_farZ)
+	{
+		UpdateClusterBounds(camera);
+	}
+
+	m_numLights = lights.GetNumLights();
+	m_viewLights.resize(size_t(m_numLights) * NumViewLightFields);
+	m_lightRanges.resize(size_t(m_numLights) * NumLightRangeFields);
+
+	// Lights to view space with their slice and tile ranges
+	const Float4x4 view = camera.GetViewMatrix();
+	{
+		JobCounter counter;
+		auto prepare = [&](uint32_t begin, uint32_t end) { PrepareLights(lights, view, begin, end); };
+		m_pJobSystem->ParallelFor(m_numLights, PrepareBatchSize, prepare, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+
+	// Visible lights bucketed by slice
+	m_statistics = {};
+	m_sliceLightOffsets.assign(m_desc.numSlices + 1, 0);
+	for (uint32_t light = 0; light < m_numLights; light++)
+	{
+		const int32_t* pRange = &m_lightRanges[size_t(light) * NumLightRangeFields];
+		m_statistics.numVisibleLights += pRange[LightRangeSliceMin] <= pRange[LightRangeSliceMax];
+		for (int32_t slice = pRange[LightRangeSliceMin]; slice <= pRange[LightRangeSliceMax]; slice++)
+		{
+			m_sliceLightOffsets[slice + 1]++;
+		}
+	}
+	for (uint32_t slice = 0; slice < m_desc.numSlices; slice++)
+	{
+		m_sliceLightOffsets[slice + 1] += m_sliceLightOffsets[slice];
+	}
+	m_sliceLights.resize(m_sliceLightOffsets[m_desc.numSlices]);
+	std::vector<uint32_t> sliceCursors(m_sliceLightOffsets.begin(), m_sliceLightOffsets.end() - 1);
+	for (uint32_t light = 0; light < m_numLights; light++)
+	{
+		const int32_t* pRange = &m_lightRanges[size_t(light) * NumLightRangeFields];
+		for (int32_t slice = pRange[LightRangeSliceMin]; slice <= pRange[LightRangeSliceMax]; slice++)
+		{
+			m_sliceLights[sliceCursors[slice]++] = light;
+		}
+	}
+	{
+		JobCounter counter;
+		auto binSlices = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t slice = begin; slice < end; slice++)
+			{
+				BinSlice(slice);
+			}
+		};
+		m_pJobSystem->ParallelFor(m_desc.numSlices, 1, binSlices, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+
+	// Slices are concatenated into one index list
+	std::vector<uint32_t> sliceOffsets(m_desc.numSlices);
+	uint32_t numIndices = 0;
+	for (uint32_t slice = 0; slice < m_desc.numSlices; slice++)
+	{
+		sliceOffsets[slice] = numIndices;
+		numIndices += uint32_t(m_slices[slice].indices.size());
+		m_statistics.maxLightsPerCluster = std::max(m_statistics.maxLightsPerCluster, m_slices[slice].maxLightsPerCluster);
+	}
+	m_clusterRanges.resize(GetNumClusters());
+	m_lightIndices.resize(numIndices);
+	{
+		JobCounter counter;
+		auto gather = [&](uint32_t begin, uint32_t end)
+		{
+			const uint32_t numTiles = m_numTilesX * m_numTilesY;
+			for (uint32_t slice = begin; slice < end; slice++)
+			{
+				const SliceBins& bins = m_slices[slice];
+				std::copy(bins.indices.begin(), bins.indices.end(), m_lightIndices.begin() + sliceOffsets[slice]);
+				for (uint32_t tile = 0; tile < numTiles; tile++)
+				{
+					m_clusterRanges[slice * numTiles + tile] = { bins.ranges[tile].offset + sliceOffsets[slice], bins.ranges[tile].count };
+				}
+			}
+		};
+		m_pJobSystem->ParallelFor(m_desc.numSlices, 1, gather, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+
+	m_statistics.numLightIndices = numIndices;
+}
+
+void ClusteredLightBinner::PrepareLights(const LightList& lights, const Float4x4& view, uint32_t begin, uint32_t end)
+{
+	const size_t numLights = m_numLights;
+	for (uint32_t light = begin; light < end; light++)
+	{
+		const Float3 center = TransformPoint({ lights.positionX[light], lights.positionY[light], lights.positionZ[light] }, view);
+		const Float3 direction = TransformVector({ lights.directionX[light], lights.directionY[light], lights.directionZ[light] }, view);
+		const float radius = lights.radius[light];
+
+		const float fields[NumViewLightFields] =
+		{
+			center.x, center.y, center.z, radius, direction.x, direction.y, direction.z,
+			lights.cosOuterAngle[light], lights.sinOuterAngle[light], SpotMaskAsFloat(lights.bIsSpot[light] != 0),
+		};
+		for (uint32_t field = 0; field < NumViewLightFields; field++)
+		{
+			m_viewLights[field * numLights + light] = fields[field];
+		}
+
+		int32_t* pRange = &m_lightRanges[size_t(light) * NumLightRangeFields];
+		pRange[LightRangeSliceMin] = 1;
+		pRange[LightRangeSliceMax] = 0;
+
+		const float minZ = std::max(center.z - radius, m_nearZ);
+		const float maxZ = std::min(center.z + radius, m_farZ);
+		if (minZ > maxZ)
+		{
+			continue;
+		}
+
+		// Conservative NDC rectangle of the bounding box: negative extents are widest on the nearest depth
+		const float minX = center.x - radius;
+		const float maxX = center.x + radius;
+		const float minY = center.y - radius;
+		const float maxY = center.y + radius;
+		const float ndcMinX = minX / ((minX < 0.0f ? minZ : maxZ) * m_tanHalfFovX);
+		const float ndcMaxX = maxX / ((maxX > 0.0f ? minZ : maxZ) * m_tanHalfFovX);
+		const float ndcMinY = minY / ((minY < 0.0f ? minZ : maxZ) * m_tanHalfFovY);
+		const float ndcMaxY = maxY / ((maxY > 0.0f ? minZ : maxZ) * m_tanHalfFovY);
+		if (ndcMinX > 1.0f || ndcMaxX < -1.0f || ndcMinY > 1.0f || ndcMaxY < -1.0f)
+		{
+			continue;
+		}
+
+		pRange[LightRangeSliceMin] = std::max(GetSliceFromDepth(minZ), 0);
+		pRange[LightRangeSliceMax] = std::max(GetSliceFromDepth(maxZ), 0);
+		pRange[LightRangeTileXMin] = ClampTile((ndcMinX * 0.5f + 0.5f) * m_desc.width, m_desc.tileSize, m_numTilesX);
+		pRange[LightRangeTileXMax] = ClampTile((ndcMaxX * 0.5f + 0.5f) * m_desc.width, m_desc.tileSize, m_numTilesX);
+		pRange[LightRangeTileYMin] = ClampTile((0.5f - ndcMaxY * 0.5f) * m_desc.height, m_desc.tileSize, m_numTilesY);
+		pRange[LightRangeTileYMax] = ClampTile((0.5f - ndcMinY * 0.5f) * m_desc.height, m_desc.tileSize, m_numTilesY);
+	}
+}
+
+void ClusteredLightBinner::BinSlice(uint32_t slice)
+{
+	SliceBins& bins = m_slices[slice];
+	const size_t numLights = m_numLights;
+
+	// Lights of the slice bucketed by tile row, a counting sort keeps them in ascending order
+	const uint32_t* pSliceLights = m_sliceLights.data() + m_sliceLightOffsets[slice];
+	const uint32_t numSliceLights = m_sliceLightOffsets[slice + 1] - m_sliceLightOffsets[slice];
+	bins.rowOffsets.assign(m_numTilesY + 1, 0);
+	for (uint32_t i = 0; i < numSliceLights; i++)
+	{
+		const int32_t* pRange = &m_lightRanges[size_t(pSliceLights[i]) * NumLightRangeFields];
+		for (int32_t tileY = pRange[LightRangeTileYMin]; tileY <= pRange[LightRangeTileYMax]; tileY++)
+		{
+			bins.rowOffsets[tileY + 1]++;
+		}
+	}
+	for (uint32_t tileY = 0; tileY < m_numTilesY; tileY++)
+	{
+		bins.rowOffsets[tileY + 1] += bins.rowOffsets[tileY];
+	}
+	bins.rowLights.resize(bins.rowOffsets[m_numTilesY]);
+	bins.rowCursors.assign(bins.rowOffsets.begin(), bins.rowOffsets.end() - 1);
+	for (uint32_t i = 0; i < numSliceLights; i++)
+	{
+		const int32_t* pRange = &m_lightRanges[size_t(pSliceLights[i]) * NumLightRangeFields];
+		for (int32_t tileY = pRange[LightRangeTileYMin]; tileY <= pRange[LightRangeTileYMax]; tileY++)
+		{
+			bins.rowLights[bins.rowCursors[tileY]++] = pSliceLights[i];
+		}
+	}
+
+	bins.indices.clear();
+	bins.ranges.resize(size_t(m_numTilesX) * m_numTilesY);
+	bins.maxLightsPerCluster = 0;
+	const float sliceMinZ = m_sliceNearZ[slice];
+	const float sliceMaxZ = m_sliceFarZ[slice];
+	const float sphereZ = (sliceMinZ + sliceMaxZ) * 0.5f;
+	const float extentZ = sliceMaxZ - sphereZ;
+
+	// Per tile x extents padded for 4 wide loads from any tile, the padding lanes are masked off by the tile range
+	const uint32_t paddedTilesX = m_numTilesX + 3;
+	bins.tileMinX.assign(paddedTilesX, 0.0f);
+	bins.tileMaxX.assign(paddedTilesX, 0.0f);
+	bins.tileSphereX.assign(paddedTilesX, 0.0f);
+	bins.tileSphereRadius.assign(paddedTilesX, 0.0f);
+	std::copy_n(&m_tileMinX[slice * m_numTilesX], m_numTilesX, bins.tileMinX.begin());
+	std::copy_n(&m_tileMaxX[slice * m_numTilesX], m_numTilesX, bins.tileMaxX.begin());
+
+	for (uint32_t tileY = 0; tileY < m_numTilesY; tileY++)
+	{
+		const uint32_t* pRowLights = bins.rowLights.data() + bins.rowOffsets[tileY];
+		const uint32_t numRowLights = bins.rowOffsets[tileY + 1] - bins.rowOffsets[tileY];
+		const uint32_t numMaskWords = (numRowLights + 63) / 64;
+		bins.rowMasks.assign(size_t(numMaskWords) * m_numTilesX, 0);
+
+		// Spot cones are tested against the bounding sphere of the cluster
+		const float minY = m_tileMinY[slice * m_numTilesY + tileY];
+		const float maxY = m_tileMaxY[slice * m_numTilesY + tileY];
+		const float sphereY = (minY + maxY) * 0.5f;
+		const float extentY = maxY - sphereY;
+		for (uint32_t tileX = 0; tileX < m_numTilesX; tileX++)
+		{
+			const float sphereX = (bins.tileMinX[tileX] + bins.tileMaxX[tileX]) * 0.5f;
+			const float extentX = bins.tileMaxX[tileX] - sphereX;
+			bins.tileSphereX[tileX] = sphereX;
+			bins.tileSphereRadius[tileX] = std::sqrt(extentX * extentX + extentY * extentY + extentZ * extentZ);
+		}
+
+		// One light at a time against the tiles of its x range, 4 tiles per step. Hits set the light's bit in the tile mask
+		for (uint32_t i = 0; i < numRowLights; i++)
+		{
+			const uint32_t light = pRowLights[i];
+			const int32_t tileXMin = m_lightRanges[size_t(light) * NumLightRangeFields + LightRangeTileXMin];
+			const int32_t tileXMax = m_lightRanges[size_t(light) * NumLightRangeFields + LightRangeTileXMax];
+			const float centerX = m_viewLights[ViewLightCenterX * numLights + light];
+			const float centerY = m_viewLights[ViewLightCenterY * numLights + light];
+			const float centerZ = m_viewLights[ViewLightCenterZ * numLights + light];
+			const float radius = m_viewLights[ViewLightRadius * numLights + light];
+			uint32_t spotMask;
+			memcpy(&spotMask, &m_viewLights[ViewLightSpotMask * numLights + light], sizeof(spotMask));
+
+			// Sphere vs AABB, y and z distances are the same for the whole row
+			const float dy = std::max(std::max(minY - centerY, centerY - maxY), 0.0f);
+			const float dz = std::max(std::max(sliceMinZ - centerZ, centerZ - sliceMaxZ), 0.0f);
+			const float remainingRadiusSquared = radius * radius - dy * dy - dz * dz;
+			if (remainingRadiusSquared < 0.0f)
+			{
+				continue;
+			}
+
+			const float directionX = m_viewLights[ViewLightDirectionX * numLights + light];
+			const float directionY = m_viewLights[ViewLightDirectionY * numLights + light];
+			const float directionZ = m_viewLights[ViewLightDirectionZ * numLights + light];
+			const float cosAngle = m_viewLights[ViewLightCos * numLights + light];
+			const float sinAngle = m_viewLights[ViewLightSin * numLights + light];
+			const float vy = sphereY - centerY;
+			const float vz = sphereZ - centerZ;
+			const float axialYZ = vy * directionY + vz * directionZ;
+			const float lengthSquaredYZ = vy * vy + vz * vz;
+
+			uint64_t* pMasks = &bins.rowMasks[size_t(i / 64) * m_numTilesX];
+			const uint64_t lightBit = uint64_t(1) << (i % 64);
+			int32_t tileX = tileXMin;
+#if ENGINE_SIMD_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 lightX = _mm_set1_ps(centerX);
+			const __m128 remaining = _mm_set1_ps(remainingRadiusSquared);
+			const __m128 lightDirectionX = _mm_set1_ps(directionX);
+			const __m128 axialBase = _mm_set1_ps(axialYZ);
+			const __m128 lengthSquaredBase = _mm_set1_ps(lengthSquaredYZ);
+			const __m128 coneCos = _mm_set1_ps(cosAngle);
+			const __m128 coneSin = _mm_set1_ps(sinAngle);
+			const __m128 bIsSpot = _mm_castsi128_ps(_mm_set1_epi32(int32_t(spotMask)));
+			const __m128i tileEnd = _mm_set1_epi32(tileXMax + 1);
+			const __m128i laneOffsets = _mm_set_epi32(3, 2, 1, 0);
+			for (; tileX <= tileXMax; tileX += 4)
+			{
+				const __m128 boxMinX = _mm_loadu_ps(&bins.tileMinX[tileX]);
+				const __m128 boxMaxX = _mm_loadu_ps(&bins.tileMaxX[tileX]);
+				const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMinX, lightX), _mm_sub_ps(lightX, boxMaxX)), zero);
+				const __m128 bSphereHit = _mm_cmple_ps(_mm_mul_ps(dx, dx), remaining);
+
+				// Cone vs cluster sphere: distance of the sphere to the cone side, or sphere behind the apex
+				const __m128 clusterRadius = _mm_loadu_ps(&bins.tileSphereRadius[tileX]);
+				const __m128 vx = _mm_sub_ps(_mm_loadu_ps(&bins.tileSphereX[tileX]), lightX);
+				const __m128 axial = _mm_add_ps(axialBase, _mm_mul_ps(vx, lightDirectionX));
+				const __m128 lengthSquared = _mm_add_ps(lengthSquaredBase, _mm_mul_ps(vx, vx));
+				const __m128 radial = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSquared, _mm_mul_ps(axial, axial)), zero));
+				const __m128 coneDistance = _mm_sub_ps(_mm_mul_ps(coneCos, radial), _mm_mul_ps(axial, coneSin));
+				const __m128 bConeCulled = _mm_or_ps(_mm_cmpgt_ps(coneDistance, clusterRadius), _mm_cmplt_ps(_mm_add_ps(axial, clusterRadius), zero));
+
+				const __m128i tiles = _mm_add_epi32(_mm_set1_epi32(tileX), laneOffsets);
+				const __m128 bInRange = _mm_castsi128_ps(_mm_cmpgt_epi32(tileEnd, tiles));
+				uint32_t hitMask = uint32_t(_mm_movemask_ps(_mm_and_ps(_mm_andnot_ps(_mm_and_ps(bIsSpot, bConeCulled), bSphereHit), bInRange)));
+				while (hitMask != 0)
+				{
+					const uint32_t lane = uint32_t(std::countr_zero(hitMask));
+					pMasks[tileX + lane] |= lightBit;
+					hitMask &= hitMask - 1;
+				}
+			}
+#else
+			for (; tileX <= tileXMax; tileX++)
+			{
+				const float dx = std::max(std::max(bins.tileMinX[tileX] - centerX, centerX - bins.tileMaxX[tileX]), 0.0f);
+				if (dx * dx > remainingRadiusSquared)
+				{
+					continue;
+				}
+				if (spotMask != 0)
+				{
+					const float clusterRadius = bins.tileSphereRadius[tileX];
+					const float vx = bins.tileSphereX[tileX] - centerX;
+					const float axial = axialYZ + vx * directionX;
+					const float radial = std::sqrt(std::max(lengthSquaredYZ + vx * vx - axial * axial, 0.0f));
+					if (cosAngle * radial - axial * sinAngle > clusterRadius || axial + clusterRadius < 0.0f)
+					{
+						continue;
+					}
+				}
+				pMasks[tileX] |= lightBit;
+			}
+#endif
+		}
+
+		// Masks to index lists, lights stay in ascending order per cluster
+		for (uint32_t tileX = 0; tileX < m_numTilesX; tileX++)
+		{
+			const uint32_t offset = uint32_t(bins.indices.size());
+			for (uint32_t word = 0; word < numMaskWords; word++)
+			{
+				for (uint64_t bits = bins.rowMasks[size_t(word) * m_numTilesX + tileX]; bits != 0; bits &= bits - 1)
+				{
+					bins.indices.push_back(pRowLights[word * 64 + uint32_t(std::countr_zero(bits))]);
+				}
+			}
+			const uint32_t count = uint32_t(bins.indices.size()) - offset;
+			bins.ranges[tileY * m_numTilesX + tileX] = { offset, count };
+			bins.maxLightsPerCluster = std::max(bins.maxLightsPerCluster, count);
+		}
+	}
+}
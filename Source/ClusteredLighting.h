@@ -0,0 +1,160 @@
+#pragma once
+
+// Clustered forward light binning on the CPU
+// The view frustum is split into screen tiles x exponential depth slices (froxels). Every frame the lights are
+// transformed to view space, bucketed by slice and tile row, and each light is tested against 4 cluster AABBs of
+// its row at a time (sphere for point lights, sphere + cone for spot lights). Slices are binned in parallel on the
+// JobSystem.
+//
+// Output is GPU ready: one ClusterLightRange per cluster, x fastest then y then slice, pointing into one packed
+// list of light indices. The shader finds its cluster with GetClusterSliceScaleBias().
+
+#include "Camera.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <vector>
+
+struct ClusterGridDesc
+{
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t tileSize = 64;		// Pixels
+	uint32_t numSlices = 24;
+};
+
+// World space lights, structure of arrays. `intensity` is linear RGB radiant intensity, see GetLightDistanceAttenuation()
+struct LightList
+{
+	uint32_t AddPointLight(const Float3& position, float radius, const Float3& intensity = { 1.0f, 1.0f, 1.0f });
+	// `outerAngle` is the half angle of the cone in radians
+	uint32_t AddSpotLight(const Float3& position, const Float3& direction, float range, float outerAngle, const Float3& intensity = { 1.0f, 1.0f, 1.0f });
+	void Clear();
+
+	uint32_t GetNumLights() const { return uint32_t(positionX.size()); }
+	bool IsEmpty() const { return positionX.empty(); }
+
+	std::vector<float>		positionX;
+	std::vector<float>		positionY;
+	std::vector<float>		positionZ;
+	std::vector<float>		radius;			// Range of spot lights
+	std::vector<float>		directionX;		// Spot lights only
+	std::vector<float>		directionY;
+	std::vector<float>		directionZ;
+	std::vector<float>		cosOuterAngle;
+	std::vector<float>		sinOuterAngle;
+	std::vector<uint8_t>	bIsSpot;
+	std::vector<float>		intensityR;
+	std::vector<float>		intensityG;
+	std::vector<float>		intensityB;
+};
+
+// Light falloff of the clustered lights, also used by the PathTracer: inverse square, windowed to reach 0 at the radius
+inline float GetLightDistanceAttenuation(float distanceSquared, float radius)
+{
+	const float ratio = distanceSquared / (radius * radius);
+	const float window = std::max(1.0f - ratio * ratio, 0.0f);
+	return window * window / std::max(distanceSquared, 1e-4f);
+}
+
+// Smooth edge over the outer fifth of the cone's cosine range, 1 inside
+inline float GetSpotConeAttenuation(float cosAngle, float cosOuterAngle)
+{
+	const float t = std::clamp((cosAngle - cosOuterAngle) / std::max((1.0f - cosOuterAngle) * 0.2f, 1e-4f), 0.0f, 1.0f);
+	return t * t * (3.0f - 2.0f * t);
+}
+
+struct ClusterLightRange
+{
+	uint32_t offset;
+	uint32_t count;
+};
+
+struct ClusteredLightingStatistics
+{
+	uint32_t numVisibleLights = 0;			// Touching at least one slice and tile
+	uint32_t numLightIndices = 0;
+	uint32_t maxLightsPerCluster = 0;
+};
+
+class ClusteredLightBinner
+{
+public:
+	ClusteredLightBinner(JobSystem* pJobSystem, const ClusterGridDesc& desc = {});
+
+	// E.g. on resize, cluster bounds are rebuilt on the next Bin()
+	void SetGridDesc(const ClusterGridDesc& desc);
+	const ClusterGridDesc& GetGridDesc() const { return m_desc; }
+
+	// Blocks until done, the calling thread helps the workers
+	void Bin(const LightList& lights, const Camera& camera);
+
+	const std::vector<ClusterLightRange>& GetClusterRanges() const { return m_clusterRanges; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_lightIndices; }
+	const ClusteredLightingStatistics& GetStatistics() const { return m_statistics; }
+
+	uint32_t GetNumTilesX() const { return m_numTilesX; }
+	uint32_t GetNumTilesY() const { return m_numTilesY; }
+	uint32_t GetNumClusters() const { return m_numTilesX * m_numTilesY * m_desc.numSlices; }
+	uint32_t GetClusterIndex(uint32_t tileX, uint32_t tileY, uint32_t slice) const { return (slice * m_numTilesY + tileY) * m_numTilesX + tileX; }
+
+	// View space AABB of a cluster, valid after Bin()
+	BoundingBox GetClusterBounds(uint32_t tileX, uint32_t tileY, uint32_t slice) const;
+	// slice = floor(log(viewZ) * scale + bias), for shader constants
+	Float2 GetClusterSliceScaleBias() const;
+	// -1 outside of [nearZ, farZ]
+	int32_t GetSliceFromDepth(float viewZ) const;
+
+private:
+	// Per slice output and scratch, each slice is binned by one job
+	struct SliceBins
+	{
+		std::vector<uint32_t>			rowOffsets;			// Lights of the slice by tile row, rowLights[rowOffsets[y], rowOffsets[y + 1])
+		std::vector<uint32_t>			rowCursors;
+		std::vector<uint32_t>			rowLights;
+		std::vector<uint64_t>			rowMasks;			// [word][tileX], bit i set when light i of the row touches the cluster
+		std::vector<float>				tileMinX;
+		std::vector<float>				tileMaxX;
+		std::vector<float>				tileSphereX;		// Cluster bounding spheres of the current row
+		std::vector<float>				tileSphereRadius;
+		std::vector<uint32_t>			indices;
+		std::vector<ClusterLightRange>	ranges;			// Offsets relative to this slice
+		uint32_t						maxLightsPerCluster = 0;
+	};
+
+	void UpdateClusterBounds(const Camera& camera);
+	void PrepareLights(const LightList& lights, const Float4x4& view, uint32_t begin, uint32_t end);
+	void BinSlice(uint32_t slice);
+
+	JobSystem*			m_pJobSystem;
+	ClusterGridDesc		m_desc;
+	uint32_t			m_numTilesX = 0;
+	uint32_t			m_numTilesY = 0;
+
+	// Projection the bounds were built for
+	float				m_tanHalfFovX = 0.0f;
+	float				m_tanHalfFovY = 0.0f;
+	float				m_nearZ = 0.0f;
+	float				m_farZ = 0.0f;
+	bool				m_bBoundsDirty = true;
+
+	// Cluster AABBs factor into per slice depth, per (slice, tileX) x and per (slice, tileY) y extents
+	std::vector<float>	m_sliceNearZ;
+	std::vector<float>	m_sliceFarZ;
+	std::vector<float>	m_tileMinX;
+	std::vector<float>	m_tileMaxX;
+	std::vector<float>	m_tileMinY;
+	std::vector<float>	m_tileMaxY;
+
+	// View space lights and their conservative slice / tile ranges, empty range when culled
+	std::vector<float>		m_viewLights;
+	std::vector<int32_t>	m_lightRanges;
+	uint32_t				m_numLights = 0;
+	std::vector<uint32_t>	m_sliceLightOffsets;	// Lights by slice, m_sliceLights[m_sliceLightOffsets[s], m_sliceLightOffsets[s + 1])
+	std::vector<uint32_t>	m_sliceLights;
+
+	std::vector<SliceBins>			m_slices;
+	std::vector<ClusterLightRange>	m_clusterRanges;
+	std::vector<uint32_t>			m_lightIndices;
+	ClusteredLightingStatistics		m_statistics;
+};
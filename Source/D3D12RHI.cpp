@@ -0,0 +1,423 @@
+#include "D3D12RHI.h"
+
+#include <algorithm>
+
+void D3D12RHICommandList::Begin(RHICommandAllocator* pAllocator, RHIPipelineState* pInitialState)
+{
+	ID3D12PipelineState* pPipelineState = pInitialState ? static_cast<D3D12RHIPipelineState*>(pInitialState)->GetPipelineState() : nullptr;
+	// Reset command list before re-recording, after ExecuteCommandList is called
+	ThrowIfFailed(m_commandList->Reset(static_cast<D3D12RHICommandAllocator*>(pAllocator)->GetCommandAllocator(), pPipelineState));
+	if (pInitialState)
+	{
+		m_commandList->SetGraphicsRootSignature(static_cast<D3D12RHIPipelineState*>(pInitialState)->GetRootSignature());
+	}
+}
+
+void D3D12RHICommandList::SetPipelineState(RHIPipelineState* pPipelineState)
+{
+	D3D12RHIPipelineState* pD3D12PipelineState = static_cast<D3D12RHIPipelineState*>(pPipelineState);
+	m_commandList->SetPipelineState(pD3D12PipelineState->GetPipelineState());
+	m_commandList->SetGraphicsRootSignature(pD3D12PipelineState->GetRootSignature());
+}
+
+void D3D12RHICommandList::SetViewport(const RHIViewport& viewport)
+{
+	CD3DX12_VIEWPORT d3d12Viewport(viewport.topLeftX, viewport.topLeftY, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth);
+	m_commandList->RSSetViewports(1, &d3d12Viewport);
+}
+
+void D3D12RHICommandList::SetScissorRect(const RHIRect& rect)
+{
+	CD3DX12_RECT d3d12Rect(rect.left, rect.top, rect.right, rect.bottom);
+	m_commandList->RSSetScissorRects(1, &d3d12Rect);
+}
+
+void D3D12RHICommandList::ResourceBarrier(uint32_t numBarriers, const RHIResourceBarrier* pBarriers)
+{
+	// Batch up to 16 barriers per call
+	constexpr uint32_t MaxBatchSize = 16;
+	CD3DX12_RESOURCE_BARRIER barriers[MaxBatchSize];
+	for (uint32_t first = 0; first < numBarriers; first += MaxBatchSize)
+	{
+		const uint32_t batchSize = std::min(MaxBatchSize, numBarriers - first);
+		for (uint32_t i = 0; i < batchSize; i++)
+		{
+			const RHIResourceBarrier& barrier = pBarriers[first + i];
+			if (barrier.type == RHIBarrierType::Aliasing)
+			{
+				barriers[i] = CD3DX12_RESOURCE_BARRIER::Aliasing(
+					barrier.pResourceBefore ? static_cast<D3D12RHIResource*>(barrier.pResourceBefore)->GetResource() : nullptr,
+					static_cast<D3D12RHIResource*>(barrier.pResource)->GetResource());
+				continue;
+			}
+			if (barrier.type == RHIBarrierType::UnorderedAccess)
+			{
+				barriers[i] = CD3DX12_RESOURCE_BARRIER::UAV(static_cast<D3D12RHIResource*>(barrier.pResource)->GetResource());
+				continue;
+			}
+			barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(
+				static_cast<D3D12RHIResource*>(barrier.pResource)->GetResource(),
+				ToD3D12ResourceState(barrier.stateBefore),
+				ToD3D12ResourceState(barrier.stateAfter));
+		}
+		m_commandList->ResourceBarrier(batchSize, barriers);
+	}
+}
+
+void D3D12RHICommandList::SetRenderTarget(RHIResource* pRenderTarget)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = static_cast<D3D12RHIResource*>(pRenderTarget)->GetRtvHandle();
+	m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+}
+
+void D3D12RHICommandList::ClearRenderTarget(RHIResource* pRenderTarget, const float color[4])
+{
+	m_commandList->ClearRenderTargetView(static_cast<D3D12RHIResource*>(pRenderTarget)->GetRtvHandle(), color, 0, nullptr);
+}
+
+void D3D12RHICommandList::DiscardResource(RHIResource* pResource)
+{
+	m_commandList->DiscardResource(static_cast<D3D12RHIResource*>(pResource)->GetResource(), nullptr);
+}
+
+void D3D12RHICommandList::SetPrimitiveTopology(RHIPrimitiveTopology topology)
+{
+	m_commandList->IASetPrimitiveTopology(ToD3D12PrimitiveTopology(topology));
+}
+
+void D3D12RHICommandList::SetVertexBuffer(uint32_t slot, const RHIVertexBufferView& view)
+{
+	D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+	vertexBufferView.BufferLocation = view.bufferLocation;
+	vertexBufferView.SizeInBytes = view.sizeInBytes;
+	vertexBufferView.StrideInBytes = view.strideInBytes;
+	m_commandList->IASetVertexBuffers(slot, 1, &vertexBufferView);
+}
+
+void D3D12RHICommandList::DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance)
+{
+	m_commandList->DrawInstanced(vertexCountPerInstance, instanceCount, startVertex, startInstance);
+}
+
+void D3D12RHICommandList::UpscaleTexture(RHIResource* pDest, const RHIRect& destRect, RHIResource* pSource, const RHIRect& sourceRect, RHIUpscaleFilter filter)
+{
+	const D3D12RHIDevice::UpscalePipeline& pipeline = m_pRHIDevice->GetUpscalePipeline(pDest->GetDesc().format);
+	const D3D12Descriptor srv = m_pRHIDevice->AllocateTransientSrv(static_cast<D3D12RHIResource*>(pSource));
+	ID3D12DescriptorHeap* pHeap = m_pRHIDevice->GetContext().GetDescriptorHeapManager().GetHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	// UpscaleConstants of Upscale.hlsl
+	struct
+	{
+		int32_t		sourceRect[4];
+		float		destOrigin[2];
+		float		sourceStep[2];
+		uint32_t	bCatmullRom;
+	} constants =
+	{
+		{ sourceRect.left, sourceRect.top, sourceRect.right, sourceRect.bottom },
+		{ float(destRect.left), float(destRect.top) },
+		{ float(sourceRect.right - sourceRect.left) / float(destRect.right - destRect.left), float(sourceRect.bottom - sourceRect.top) / float(destRect.bottom - destRect.top) },
+		filter == RHIUpscaleFilter::CatmullRom ? 1u : 0u,
+	};
+
+	m_commandList->SetDescriptorHeaps(1, &pHeap);
+	m_commandList->SetPipelineState(pipeline.pipelineState.Get());
+	m_commandList->SetGraphicsRootSignature(pipeline.rootSignature.Get());
+	m_commandList->SetGraphicsRoot32BitConstants(0, sizeof(constants) / 4, &constants, 0);
+	m_commandList->SetGraphicsRootDescriptorTable(1, srv.gpuHandle);
+	SetViewport({ float(destRect.left), float(destRect.top), float(destRect.right - destRect.left), float(destRect.bottom - destRect.top), 0.0f, 1.0f });
+	SetScissorRect(destRect);
+	SetRenderTarget(pDest);
+	m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_commandList->DrawInstanced(3, 1, 0, 0);
+}
+
+void D3D12RHICommandQueue::ExecuteCommandLists(uint32_t numCommandLists, RHICommandList* const* ppCommandLists)
+{
+	constexpr uint32_t MaxBatchSize = 16;
+	ID3D12CommandList* ppD3D12CommandLists[MaxBatchSize];
+	for (uint32_t first = 0; first < numCommandLists; first += MaxBatchSize)
+	{
+		const uint32_t batchSize = std::min(MaxBatchSize, numCommandLists - first);
+		for (uint32_t i = 0; i < batchSize; i++)
+		{
+			ppD3D12CommandLists[i] = static_cast<D3D12RHICommandList*>(ppCommandLists[first + i])->GetCommandList();
+		}
+		m_pCommandQueue->ExecuteCommandLists(batchSize, ppD3D12CommandLists);
+	}
+}
+
+void D3D12RHICommandQueue::Signal(RHIFence* pFence, uint64_t value)
+{
+	ThrowIfFailed(m_pCommandQueue->Signal(static_cast<D3D12RHIFence*>(pFence)->GetFence(), value));
+}
+
+D3D12RHIDevice::D3D12RHIDevice()
+	: m_graphicsQueue(m_context.GetCommandQueue().Get())
+	, m_creationAllocator(m_context.GetDevice().Get())
+	, m_shaderCache(GetExecutableDirectory() + L"ShaderCache", &m_shaderCompiler)
+{
+}
+
+ShaderBytecode D3D12RHIDevice::LoadShader(const RHIShaderDesc& shaderDesc)
+{
+	ShaderCompileRequest request;
+	request.filePath = GetSourceDirectory() + shaderDesc.fileName;
+	request.entryPoint = shaderDesc.entryPoint;
+	request.target = shaderDesc.target;
+#if BUILD_DEBUG
+	request.flags1 = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+	return m_shaderCache.GetOrCompile(request);
+}
+
+D3D12Descriptor D3D12RHIDevice::AllocateRtv(ID3D12Resource* pResource)
+{
+	D3D12Descriptor rtv = m_context.GetDescriptorHeapManager().AllocatePersistent(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	m_context.GetDevice()->CreateRenderTargetView(pResource, nullptr, rtv.cpuHandle);
+	return rtv;
+}
+
+void D3D12RHISwapChain::Resize(uint32_t width, uint32_t height)
+{
+	// DXGI refuses to resize while any back buffer is referenced
+	m_backBuffers.clear();
+	m_pContext->ResizeSwapChain(width, height);
+	m_backBuffers = m_pDevice->CreateBackBuffers(width, height, m_format);
+}
+
+std::unique_ptr<RHISwapChain> D3D12RHIDevice::CreateSwapChain(void* nativeWindow, uint32_t bufferCount, uint32_t width, uint32_t height, RHIFormat format)
+{
+	m_context.CreateSwapChain(static_cast<HWND>(nativeWindow), bufferCount, width, height);
+	return std::make_unique<D3D12RHISwapChain>(this, &m_context, format, CreateBackBuffers(width, height, format));
+}
+
+std::vector<std::unique_ptr<D3D12RHIResource>> D3D12RHIDevice::CreateBackBuffers(uint32_t width, uint32_t height, RHIFormat format)
+{
+	DXGI_SWAP_CHAIN_DESC1 swapChainDesc{};
+	ThrowIfFailed(m_context.GetSwapChain()->GetDesc1(&swapChainDesc));
+
+	// Create a RTV for each frame
+	std::vector<std::unique_ptr<D3D12RHIResource>> backBuffers;
+	for (uint32_t i = 0; i < swapChainDesc.BufferCount; i++)
+	{
+		// Getting back buffer resource handle
+		ComPtr<ID3D12Resource> backBuffer;
+		ThrowIfFailed(m_context.GetSwapChain()->GetBuffer(i, IID_PPV_ARGS(&backBuffer)));
+		RHIResourceDesc desc = RHIResourceDesc::Texture2D(width, height, format, true);
+		desc.initialState = RHIResourceState::Present;
+		backBuffers.push_back(std::make_unique<D3D12RHIResource>(desc, backBuffer, &m_context.GetDescriptorHeapManager(), AllocateRtv(backBuffer.Get())));
+	}
+	return backBuffers;
+}
+
+const D3D12RHIDevice::UpscalePipeline& D3D12RHIDevice::GetUpscalePipeline(RHIFormat renderTargetFormat)
+{
+	std::lock_guard<std::mutex> lock(m_upscaleMutex);
+	UpscalePipeline& pipeline = m_upscalePipelines[renderTargetFormat];
+	if (pipeline.pipelineState)
+	{
+		return pipeline;
+	}
+
+	// UpscaleConstants as root constants, the source texture in a descriptor table
+	CD3DX12_DESCRIPTOR_RANGE sourceRange;
+	sourceRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	CD3DX12_ROOT_PARAMETER parameters[2];
+	parameters[0].InitAsConstants(9, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	parameters[1].InitAsDescriptorTable(1, &sourceRange, D3D12_SHADER_VISIBILITY_PIXEL);
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+	rootSignatureDesc.Init(2, parameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> signature;
+	ComPtr<ID3DBlob> error;
+	ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
+	ThrowIfFailed(m_context.GetDevice()->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&pipeline.rootSignature)));
+
+	ShaderBytecode vertexShader = LoadShader({ L"Upscale.hlsl", "VSFullscreen", "vs_5_0" });
+	ShaderBytecode pixelShader = LoadShader({ L"Upscale.hlsl", "PSUpscale", "ps_5_0" });
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
+	psoDesc.pRootSignature = pipeline.rootSignature.Get();
+	psoDesc.VS = { vertexShader.GetData(), vertexShader.GetSize() };
+	psoDesc.PS = { pixelShader.GetData(), pixelShader.GetSize() };
+	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState.DepthEnable = FALSE;
+	psoDesc.DepthStencilState.StencilEnable = FALSE;
+	psoDesc.SampleMask = UINT_MAX;
+	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	psoDesc.NumRenderTargets = 1;
+	psoDesc.RTVFormats[0] = ToDxgiFormat(renderTargetFormat);
+	psoDesc.SampleDesc.Count = 1;
+	ThrowIfFailed(m_context.GetDevice()->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipeline.pipelineState)));
+	return pipeline;
+}
+
+D3D12Descriptor D3D12RHIDevice::AllocateTransientSrv(D3D12RHIResource* pResource)
+{
+	D3D12Descriptor srv;
+	{
+		std::lock_guard<std::mutex> lock(m_transientDescriptorMutex);
+		srv = m_context.GetDescriptorHeapManager().AllocateTransient(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1);
+	}
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+	srvDesc.Format = ToDxgiFormat(pResource->GetDesc().format);
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture2D.MipLevels = 1;
+	m_context.GetDevice()->CreateShaderResourceView(pResource->GetResource(), &srvDesc, srv.cpuHandle);
+	return srv;
+}
+
+CD3DX12_RESOURCE_DESC D3D12RHIDevice::ToD3D12ResourceDesc(const RHIResourceDesc& desc)
+{
+	if (desc.dimension == RHIResourceDimension::Buffer)
+	{
+		return CD3DX12_RESOURCE_DESC::Buffer(desc.width);
+	}
+	CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(ToDxgiFormat(desc.format), desc.width, desc.height, 1, 1);
+	if (desc.bRenderTarget)
+	{
+		resourceDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+	}
+	return resourceDesc;
+}
+
+std::unique_ptr<RHIResource> D3D12RHIDevice::CreateResource(const RHIResourceDesc& desc)
+{
+	auto heapProperty = CD3DX12_HEAP_PROPERTIES(ToD3D12HeapType(desc.heapType));
+	CD3DX12_RESOURCE_DESC resourceDesc = ToD3D12ResourceDesc(desc);
+
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(m_context.GetDevice()->CreateCommittedResource(
+		&heapProperty,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		ToD3D12ResourceState(desc.initialState),
+		nullptr,
+		IID_PPV_ARGS(&resource)
+	));
+
+	D3D12Descriptor rtv;
+	if (desc.bRenderTarget)
+	{
+		rtv = AllocateRtv(resource.Get());
+	}
+	return std::make_unique<D3D12RHIResource>(desc, resource, &m_context.GetDescriptorHeapManager(), rtv);
+}
+
+std::unique_ptr<RHIHeap> D3D12RHIDevice::CreateHeap(uint64_t size)
+{
+	// Render targets only, resource heap tier 1 does not mix them with buffers or other textures
+	CD3DX12_HEAP_DESC heapDesc(size, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+	ComPtr<ID3D12Heap> heap;
+	ThrowIfFailed(m_context.GetDevice()->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap)));
+	return std::make_unique<D3D12RHIHeap>(size, heap);
+}
+
+std::unique_ptr<RHIResource> D3D12RHIDevice::CreatePlacedResource(RHIHeap* pHeap, uint64_t offset, const RHIResourceDesc& desc)
+{
+	CD3DX12_RESOURCE_DESC resourceDesc = ToD3D12ResourceDesc(desc);
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(m_context.GetDevice()->CreatePlacedResource(
+		static_cast<D3D12RHIHeap*>(pHeap)->GetHeap(),
+		offset,
+		&resourceDesc,
+		ToD3D12ResourceState(desc.initialState),
+		nullptr,
+		IID_PPV_ARGS(&resource)
+	));
+
+	D3D12Descriptor rtv;
+	if (desc.bRenderTarget)
+	{
+		rtv = AllocateRtv(resource.Get());
+	}
+	return std::make_unique<D3D12RHIResource>(desc, resource, &m_context.GetDescriptorHeapManager(), rtv);
+}
+
+RHIResourceAllocationInfo D3D12RHIDevice::GetResourceAllocationInfo(const RHIResourceDesc& desc)
+{
+	CD3DX12_RESOURCE_DESC resourceDesc = ToD3D12ResourceDesc(desc);
+	const D3D12_RESOURCE_ALLOCATION_INFO info = m_context.GetDevice()->GetResourceAllocationInfo(0, 1, &resourceDesc);
+	return { info.SizeInBytes, info.Alignment };
+}
+
+std::unique_ptr<RHIPipelineState> D3D12RHIDevice::CreateGraphicsPipelineState(const RHIGraphicsPipelineDesc& desc, const std::vector<uint8_t>* pCachedBlob)
+{
+	// Create an empty root signature
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+	rootSignatureDesc.Init(
+		0, nullptr, // Parameters
+		0, nullptr, // Static Samplers
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+
+	ComPtr<ID3DBlob> signature;
+	ComPtr<ID3DBlob> error;
+	ComPtr<ID3D12RootSignature> rootSignature;
+	ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
+	ThrowIfFailed(m_context.GetDevice()->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
+
+	// Compiled shaders come from the persistent cache, only edited shaders are recompiled
+	ShaderBytecode vertexShader = LoadShader(desc.vertexShader);
+	ShaderBytecode pixelShader = LoadShader(desc.pixelShader);
+
+	// Define vertex input layout
+	std::vector<D3D12_INPUT_ELEMENT_DESC> inputElementsDesc;
+	for (const RHIInputElementDesc& element : desc.inputLayout)
+	{
+		inputElementsDesc.push_back({ element.semanticName, element.semanticIndex, ToDxgiFormat(element.format), element.inputSlot, element.alignedByteOffset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+
+	// Describe PSO
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
+	psoDesc.InputLayout = { inputElementsDesc.data(), uint32_t(inputElementsDesc.size()) };
+	psoDesc.pRootSignature = rootSignature.Get();
+	psoDesc.VS = { vertexShader.GetData(), vertexShader.GetSize() };
+	psoDesc.PS = { pixelShader.GetData(), pixelShader.GetSize() };
+	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState.DepthEnable = desc.bDepthEnable ? TRUE : FALSE;
+	psoDesc.DepthStencilState.StencilEnable = FALSE;
+	psoDesc.SampleMask = UINT_MAX;
+	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	psoDesc.NumRenderTargets = 1;
+	psoDesc.RTVFormats[0] = ToDxgiFormat(desc.renderTargetFormat);
+	psoDesc.SampleDesc.Count = 1;
+
+	ComPtr<ID3D12PipelineState> pipelineState;
+	if (pCachedBlob && !pCachedBlob->empty())
+	{
+		// Blob from another driver or adapter is rejected, fall back to a full compile
+		psoDesc.CachedPSO = { pCachedBlob->data(), pCachedBlob->size() };
+		if (FAILED(m_context.GetDevice()->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState))))
+		{
+			psoDesc.CachedPSO = {};
+			pipelineState.Reset();
+		}
+	}
+	if (!pipelineState)
+	{
+		ThrowIfFailed(m_context.GetDevice()->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
+	}
+
+	return std::make_unique<D3D12RHIPipelineState>(desc, rootSignature, pipelineState);
+}
+
+std::unique_ptr<RHIFence> D3D12RHIDevice::CreateFence(uint64_t initialValue)
+{
+	return std::make_unique<D3D12RHIFence>(m_context.GetDevice().Get(), initialValue);
+}
+
+std::unique_ptr<RHICommandAllocator> D3D12RHIDevice::CreateCommandAllocator()
+{
+	return std::make_unique<D3D12RHICommandAllocator>(m_context.GetDevice().Get());
+}
+
+std::unique_ptr<RHICommandList> D3D12RHIDevice::CreateCommandList()
+{
+	// Command list is closed right away, Begin() binds the allocator actually recorded into
+	return std::make_unique<D3D12RHICommandList>(this, m_context.GetDevice().Get(), m_creationAllocator.GetCommandAllocator());
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+// D3D12 implementation of RHI.h, thin wrappers over the native objects
+
+#include "RHI.h"
+#include "D3D12Utility.h"
+#include "D3D12RenderContext.h"
+#include "D3D12ShaderCompiler.h"
+
+#include <map>
+#include <mutex>
+
+class D3D12RHIDevice;
+
+inline DXGI_FORMAT ToDxgiFormat(RHIFormat format)
+{
+	switch (format)
+	{
+	case RHIFormat::R8G8B8A8_UNORM:		return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case RHIFormat::R16G16B16A16_FLOAT:	return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case RHIFormat::R32_FLOAT:			return DXGI_FORMAT_R32_FLOAT;
+	case RHIFormat::R32G32_FLOAT:		return DXGI_FORMAT_R32G32_FLOAT;
+	case RHIFormat::R32G32B32_FLOAT:	return DXGI_FORMAT_R32G32B32_FLOAT;
+	case RHIFormat::R32G32B32A32_FLOAT:	return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case RHIFormat::D32_FLOAT:			return DXGI_FORMAT_D32_FLOAT;
+	case RHIFormat::R16G16_FLOAT:		return DXGI_FORMAT_R16G16_FLOAT;
+	case RHIFormat::R16G16_SNORM:		return DXGI_FORMAT_R16G16_SNORM;
+	default:							return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+inline D3D12_RESOURCE_STATES ToD3D12ResourceState(RHIResourceState state)
+{
+	switch (state)
+	{
+	case RHIResourceState::Present:					return D3D12_RESOURCE_STATE_PRESENT;
+	case RHIResourceState::RenderTarget:			return D3D12_RESOURCE_STATE_RENDER_TARGET;
+	case RHIResourceState::GenericRead:				return D3D12_RESOURCE_STATE_GENERIC_READ;
+	case RHIResourceState::VertexAndConstantBuffer:	return D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+	case RHIResourceState::IndexBuffer:				return D3D12_RESOURCE_STATE_INDEX_BUFFER;
+	case RHIResourceState::ShaderResource:			return D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	case RHIResourceState::UnorderedAccess:			return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	case RHIResourceState::DepthWrite:				return D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	case RHIResourceState::CopyDest:				return D3D12_RESOURCE_STATE_COPY_DEST;
+	case RHIResourceState::CopySource:				return D3D12_RESOURCE_STATE_COPY_SOURCE;
+	default:										return D3D12_RESOURCE_STATE_COMMON;
+	}
+}
+
+inline D3D12_HEAP_TYPE ToD3D12HeapType(RHIHeapType heapType)
+{
+	switch (heapType)
+	{
+	case RHIHeapType::Upload:	return D3D12_HEAP_TYPE_UPLOAD;
+	case RHIHeapType::Readback:	return D3D12_HEAP_TYPE_READBACK;
+	default:					return D3D12_HEAP_TYPE_DEFAULT;
+	}
+}
+
+inline D3D_PRIMITIVE_TOPOLOGY ToD3D12PrimitiveTopology(RHIPrimitiveTopology topology)
+{
+	switch (topology)
+	{
+	case RHIPrimitiveTopology::TriangleList:	return D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	default:									return D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	}
+}
+
+class D3D12RHIResource : public RHIResource
+{
+public:
+	D3D12RHIResource(const RHIResourceDesc& desc, ComPtr<ID3D12Resource> resource, D3D12DescriptorHeapManager* pDescriptorHeapManager = nullptr, const D3D12Descriptor& rtv = {})
+		: RHIResource(desc)
+		, m_resource(resource)
+		, m_pDescriptorHeapManager(pDescriptorHeapManager)
+		, m_rtv(rtv)
+	{
+	}
+
+	~D3D12RHIResource()
+	{
+		if (m_pDescriptorHeapManager)
+		{
+			m_pDescriptorHeapManager->FreePersistent(m_rtv);
+		}
+	}
+
+	void* Map() override
+	{
+		void* pData = nullptr;
+		CD3DX12_RANGE readRange(0, 0); // Not intended to be read from CPU
+		ThrowIfFailed(m_resource->Map(0, m_desc.heapType == RHIHeapType::Readback ? nullptr : &readRange, &pData));
+		return pData;
+	}
+
+	void Unmap() override { m_resource->Unmap(0, nullptr); }
+	uint64_t GetGpuVirtualAddress() const override { return m_resource->GetGPUVirtualAddress(); }
+
+	ID3D12Resource* GetResource() const { return m_resource.Get(); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetRtvHandle() const { return m_rtv.cpuHandle; }
+
+private:
+	ComPtr<ID3D12Resource>		m_resource;
+	D3D12DescriptorHeapManager*	m_pDescriptorHeapManager;
+	D3D12Descriptor				m_rtv;
+};
+
+class D3D12RHIHeap : public RHIHeap
+{
+public:
+	D3D12RHIHeap(uint64_t size, ComPtr<ID3D12Heap> heap) : RHIHeap(size), m_heap(heap) {}
+
+	ID3D12Heap* GetHeap() const { return m_heap.Get(); }
+
+private:
+	ComPtr<ID3D12Heap> m_heap;
+};
+
+class D3D12RHIPipelineState : public RHIPipelineState
+{
+public:
+	D3D12RHIPipelineState(const RHIGraphicsPipelineDesc& desc, ComPtr<ID3D12RootSignature> rootSignature, ComPtr<ID3D12PipelineState> pipelineState)
+		: RHIPipelineState(desc)
+		, m_rootSignature(rootSignature)
+		, m_pipelineState(pipelineState)
+	{
+	}
+
+	ID3D12RootSignature* GetRootSignature() const { return m_rootSignature.Get(); }
+	ID3D12PipelineState* GetPipelineState() const { return m_pipelineState.Get(); }
+
+	bool GetCachedBlob(std::vector<uint8_t>& blob) const override
+	{
+		ComPtr<ID3DBlob> cachedBlob;
+		if (FAILED(m_pipelineState->GetCachedBlob(&cachedBlob)))
+		{
+			return false;
+		}
+		const uint8_t* pData = static_cast<const uint8_t*>(cachedBlob->GetBufferPointer());
+		blob.assign(pData, pData + cachedBlob->GetBufferSize());
+		return true;
+	}
+
+private:
+	ComPtr<ID3D12RootSignature>	m_rootSignature;
+	ComPtr<ID3D12PipelineState>	m_pipelineState;
+};
+
+class D3D12RHIFence : public RHIFence
+{
+public:
+	D3D12RHIFence(ID3D12Device* pDevice, uint64_t initialValue)
+	{
+		ThrowIfFailed(pDevice->CreateFence(initialValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+		// Create an event handle to use for frame synchronization
+		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (m_fenceEvent == nullptr)
+		{
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+		}
+	}
+
+	~D3D12RHIFence()
+	{
+		CloseHandle(m_fenceEvent);
+	}
+
+	uint64_t GetCompletedValue() const override { return m_fence->GetCompletedValue(); }
+
+	void Wait(uint64_t value) override
+	{
+		// If fence not yet reach `value`, set an event and wait for it
+		if (m_fence->GetCompletedValue() < value)
+		{
+			ThrowIfFailed(m_fence->SetEventOnCompletion(value, m_fenceEvent));
+			WaitForSingleObject(m_fenceEvent, INFINITE);
+		}
+	}
+
+	ID3D12Fence* GetFence() const { return m_fence.Get(); }
+
+private:
+	ComPtr<ID3D12Fence>	m_fence;
+	HANDLE				m_fenceEvent;
+};
+
+class D3D12RHICommandAllocator : public RHICommandAllocator
+{
+public:
+	explicit D3D12RHICommandAllocator(ID3D12Device* pDevice)
+	{
+		ThrowIfFailed(pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
+	}
+
+	// Command allocators can be reset only if associated command lists have finished excution
+	// So fence is needed
+	void Reset() override { ThrowIfFailed(m_commandAllocator->Reset()); }
+
+	ID3D12CommandAllocator* GetCommandAllocator() const { return m_commandAllocator.Get(); }
+
+private:
+	ComPtr<ID3D12CommandAllocator> m_commandAllocator;
+};
+
+class D3D12RHICommandList : public RHICommandList
+{
+public:
+	D3D12RHICommandList(D3D12RHIDevice* pRHIDevice, ID3D12Device* pDevice, ID3D12CommandAllocator* pAllocator)
+		: m_pRHIDevice(pRHIDevice)
+	{
+		ThrowIfFailed(pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, pAllocator, nullptr, IID_PPV_ARGS(&m_commandList)));
+		// Command lists are created in recording state, manually close
+		ThrowIfFailed(m_commandList->Close());
+	}
+
+	void Begin(RHICommandAllocator* pAllocator, RHIPipelineState* pInitialState = nullptr) override;
+	void Close() override { ThrowIfFailed(m_commandList->Close()); }
+
+	void SetPipelineState(RHIPipelineState* pPipelineState) override;
+	void SetViewport(const RHIViewport& viewport) override;
+	void SetScissorRect(const RHIRect& rect) override;
+	void ResourceBarrier(uint32_t numBarriers, const RHIResourceBarrier* pBarriers) override;
+	void SetRenderTarget(RHIResource* pRenderTarget) override;
+	void ClearRenderTarget(RHIResource* pRenderTarget, const float color[4]) override;
+	void DiscardResource(RHIResource* pResource) override;
+	void SetPrimitiveTopology(RHIPrimitiveTopology topology) override;
+	void SetVertexBuffer(uint32_t slot, const RHIVertexBufferView& view) override;
+	void DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance) override;
+	void UpscaleTexture(RHIResource* pDest, const RHIRect& destRect, RHIResource* pSource, const RHIRect& sourceRect, RHIUpscaleFilter filter) override;
+
+	ID3D12GraphicsCommandList* GetCommandList() const { return m_commandList.Get(); }
+
+private:
+	D3D12RHIDevice*						m_pRHIDevice;
+	ComPtr<ID3D12GraphicsCommandList>	m_commandList;
+};
+
+class D3D12RHICommandQueue : public RHICommandQueue
+{
+public:
+	explicit D3D12RHICommandQueue(ID3D12CommandQueue* pCommandQueue) : m_pCommandQueue(pCommandQueue) {}
+
+	void ExecuteCommandLists(uint32_t numCommandLists, RHICommandList* const* ppCommandLists) override;
+	void Signal(RHIFence* pFence, uint64_t value) override;
+
+private:
+	ID3D12CommandQueue* m_pCommandQueue;
+};
+
+class D3D12RHISwapChain : public RHISwapChain
+{
+public:
+	D3D12RHISwapChain(D3D12RHIDevice* pDevice, D3D12GraphicsContext* pContext, RHIFormat format, std::vector<std::unique_ptr<D3D12RHIResource>>&& backBuffers)
+		: m_pDevice(pDevice)
+		, m_pContext(pContext)
+		, m_swapChain(pContext->GetSwapChain())
+		, m_format(format)
+		, m_backBuffers(std::move(backBuffers))
+	{
+	}
+
+	uint32_t GetBufferCount() const override { return uint32_t(m_backBuffers.size()); }
+	RHIResource* GetBackBuffer(uint32_t index) override { return m_backBuffers[index].get(); }
+	uint32_t GetCurrentBackBufferIndex() const override { return m_swapChain->GetCurrentBackBufferIndex(); }
+	void Present(uint32_t syncInterval, uint32_t flags) override
+	{
+		const bool bAllowTearing = (flags & RHIPresentFlagAllowTearing) && syncInterval == 0 && m_pContext->IsTearingSupported();
+		ThrowIfFailed(m_swapChain->Present(syncInterval, bAllowTearing ? DXGI_PRESENT_ALLOW_TEARING : 0));
+		// Present marks the frame boundary for transient descriptors and deferred frees
+		m_pContext->GetDescriptorHeapManager().EndFrame(m_pContext->GetCommandQueue().Get());
+	}
+	void Resize(uint32_t width, uint32_t height) override;
+
+	bool IsTearingSupported() const override { return m_pContext->IsTearingSupported(); }
+	void SetMaximumFrameLatency(uint32_t maxLatency) override { ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(maxLatency)); }
+	void WaitForFrameLatency() override
+	{
+		// Bounded, a lost device must not hang the frame loop
+		WaitForSingleObjectEx(m_pContext->GetFrameLatencyWaitableObject(), 1000, TRUE);
+	}
+
+private:
+	D3D12RHIDevice*										m_pDevice;
+	D3D12GraphicsContext*								m_pContext;
+	ComPtr<IDXGISwapChain3>								m_swapChain;
+	RHIFormat											m_format;
+	std::vector<std::unique_ptr<D3D12RHIResource>>		m_backBuffers;
+};
+
+class D3D12RHIDevice : public RHIDevice
+{
+public:
+	D3D12RHIDevice();
+
+	RHIBackend GetBackend() const override { return RHIBackend::D3D12; }
+	RHICommandQueue* GetGraphicsQueue() override { return &m_graphicsQueue; }
+
+	std::unique_ptr<RHISwapChain> CreateSwapChain(void* nativeWindow, uint32_t bufferCount, uint32_t width, uint32_t height, RHIFormat format) override;
+	std::unique_ptr<RHIResource> CreateResource(const RHIResourceDesc& desc) override;
+	std::unique_ptr<RHIHeap> CreateHeap(uint64_t size) override;
+	std::unique_ptr<RHIResource> CreatePlacedResource(RHIHeap* pHeap, uint64_t offset, const RHIResourceDesc& desc) override;
+	RHIResourceAllocationInfo GetResourceAllocationInfo(const RHIResourceDesc& desc) override;
+	std::unique_ptr<RHIPipelineState> CreateGraphicsPipelineState(const RHIGraphicsPipelineDesc& desc, const std::vector<uint8_t>* pCachedBlob = nullptr) override;
+	std::unique_ptr<RHIFence> CreateFence(uint64_t initialValue) override;
+	std::unique_ptr<RHICommandAllocator> CreateCommandAllocator() override;
+	std::unique_ptr<RHICommandList> CreateCommandList() override;
+
+	D3D12GraphicsContext& GetContext() { return m_context; }
+
+	// Of the swap chain's current buffers
+	std::vector<std::unique_ptr<D3D12RHIResource>> CreateBackBuffers(uint32_t width, uint32_t height, RHIFormat format);
+
+	// Backs RHICommandList::UpscaleTexture(), created on first use per render target format. Thread safe
+	struct UpscalePipeline
+	{
+		ComPtr<ID3D12RootSignature>	rootSignature;
+		ComPtr<ID3D12PipelineState>	pipelineState;
+	};
+	const UpscalePipeline& GetUpscalePipeline(RHIFormat renderTargetFormat);
+	// Shader visible, valid for the current frame. Thread safe
+	D3D12Descriptor AllocateTransientSrv(D3D12RHIResource* pResource);
+
+private:
+	static CD3DX12_RESOURCE_DESC ToD3D12ResourceDesc(const RHIResourceDesc& desc);
+	D3D12Descriptor AllocateRtv(ID3D12Resource* pResource);
+	ShaderBytecode LoadShader(const RHIShaderDesc& shaderDesc);
+
+	D3D12GraphicsContext	m_context;
+	D3D12RHICommandQueue	m_graphicsQueue;
+	// Command lists need an allocator at creation time
+	D3D12RHICommandAllocator m_creationAllocator;
+	D3D12ShaderCompiler		m_shaderCompiler;
+	ShaderCache				m_shaderCache;
+
+	// Command lists record in parallel
+	std::mutex								m_upscaleMutex;
+	std::map<RHIFormat, UpscalePipeline>	m_upscalePipelines;
+	std::mutex								m_transientDescriptorMutex;
+};
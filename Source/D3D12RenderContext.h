@@ -1,8 +1,129 @@
 #pragma once
 
+#include "D3D12Utility.h"
+#include "DescriptorAllocator.h"
+
+struct D3D12Descriptor
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE	cpuHandle{};
+	D3D12_GPU_DESCRIPTOR_HANDLE	gpuHandle{};	// Only valid for shader visible heaps
+	DescriptorRange				range;
+	D3D12_DESCRIPTOR_HEAP_TYPE	type = D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES;
+
+	bool IsValid() const { return range.IsValid(); }
+};
+
+// One heap per descriptor type, index management is done by DescriptorHeapAllocator.
+// Frame boundaries are marked by its own fence, signaled on the queue in EndFrame()
 class D3D12DescriptorHeapManager
 {
+public:
+	void Initialize(ID3D12Device* pDevice)
+	{
+		// { type, persistent, transient }, only CBV_SRV_UAV and samplers can be shader visible
+		InitializeHeap(pDevice, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 4096, 4096);
+		InitializeHeap(pDevice, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 256, 256);
+		InitializeHeap(pDevice, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 256, 0);
+		InitializeHeap(pDevice, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 64, 0);
+
+		ThrowIfFailed(pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+		m_frameFenceValue = 1;
+		BeginFrame();
+	}
+
+	D3D12Descriptor AllocatePersistent(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count = 1)
+	{
+		return MakeDescriptor(type, m_heaps[type].allocator->AllocatePersistent(count));
+	}
+
+	// Slots are recycled after the GPU finished the current frame
+	void FreePersistent(const D3D12Descriptor& descriptor)
+	{
+		if (descriptor.IsValid())
+		{
+			m_heaps[descriptor.type].allocator->FreePersistent(descriptor.range);
+		}
+	}
+
+	// Contiguous descriptors valid for the current frame only
+	D3D12Descriptor AllocateTransient(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count)
+	{
+		return MakeDescriptor(type, m_heaps[type].allocator->AllocateTransient(count));
+	}
+
+	// Call once per frame after the last submission
+	void EndFrame(ID3D12CommandQueue* pCommandQueue)
+	{
+		for (HeapInfo& heap : m_heaps)
+		{
+			heap.allocator->EndFrame();
+		}
+		ThrowIfFailed(pCommandQueue->Signal(m_fence.Get(), m_frameFenceValue));
+		m_frameFenceValue++;
+		BeginFrame();
+	}
+
+	ID3D12DescriptorHeap* GetHeap(D3D12_DESCRIPTOR_HEAP_TYPE type) const { return m_heaps[type].heap.Get(); }
+
+private:
+	struct HeapInfo
+	{
+		ComPtr<ID3D12DescriptorHeap>				heap;
+		uint32_t									descriptorSize = 0;
+		D3D12_CPU_DESCRIPTOR_HANDLE					cpuStart{};
+		D3D12_GPU_DESCRIPTOR_HANDLE					gpuStart{};
+		std::unique_ptr<DescriptorHeapAllocator>	allocator;
+	};
+
+	void InitializeHeap(ID3D12Device* pDevice, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numPersistent, uint32_t numTransient)
+	{
+		const bool bShaderVisible = type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV || type == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
+
+		D3D12_DESCRIPTOR_HEAP_DESC heapDesc{};
+		heapDesc.NumDescriptors = numPersistent + numTransient;
+		heapDesc.Type = type;
+		heapDesc.Flags = bShaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+
+		HeapInfo& heap = m_heaps[type];
+		ThrowIfFailed(pDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&heap.heap)));
+		heap.descriptorSize = pDevice->GetDescriptorHandleIncrementSize(type);
+		heap.cpuStart = heap.heap->GetCPUDescriptorHandleForHeapStart();
+		if (bShaderVisible)
+		{
+			heap.gpuStart = heap.heap->GetGPUDescriptorHandleForHeapStart();
+		}
+		heap.allocator = std::make_unique<DescriptorHeapAllocator>(numPersistent, numTransient);
+	}
+
+	void BeginFrame()
+	{
+		const uint64_t completedValue = m_fence->GetCompletedValue();
+		for (HeapInfo& heap : m_heaps)
+		{
+			heap.allocator->BeginFrame(m_frameFenceValue, completedValue);
+		}
+	}
+
+	D3D12Descriptor MakeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE type, const DescriptorRange& range)
+	{
+		// Running out of descriptors is a budget problem, not something to recover from
+		check(!range.IsValid());
 
+		const HeapInfo& heap = m_heaps[type];
+		D3D12Descriptor descriptor;
+		descriptor.cpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(heap.cpuStart, range.offset, heap.descriptorSize);
+		if (heap.gpuStart.ptr != 0)
+		{
+			descriptor.gpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(heap.gpuStart, range.offset, heap.descriptorSize);
+		}
+		descriptor.range = range;
+		descriptor.type = type;
+		return descriptor;
+	}
+
+	HeapInfo				m_heaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+	ComPtr<ID3D12Fence>		m_fence;
+	uint64_t				m_frameFenceValue = 0;
 };
 
 class D3D12GraphicsContext
@@ -62,38 +183,18 @@ private:
 		queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
 		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
 		ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
-		// Create command allocator
-		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
-	}
-
-	void CreateCommandAllocator()
-	{
-		// Create command allocator
-		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
-	}
-
-	void CreateCommandList()
-	{
-		// Create command list
-		ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocator.Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
-		// Command lists are created in recording state, manually close
-		ThrowIfFailed(m_commandList->Close());
 	}
 
 public:
-	D3D12GraphicsContext(uint32_t width, uint32_t height)
-		: m_backBufferWidth(width)
-		, m_backBufferHeight(height)
-		, m_viewport(0.f, 0.f, float(width), float(height))
-		, m_scissorRect(0, 0, width, height)
+	// Command allocators and lists are owned by D3D12RHICommandAllocator/D3D12RHICommandList
+	D3D12GraphicsContext()
 	{
 		CreateDxgiFactory();
 		CreateDevice(true);
 		// Command queue should be created before swapchain because swapchain needa a command queue
 		// to flush on it.
 		CreateCommandQueues();
-		CreateCommandAllocator();
-		CreateCommandList();
+		m_descriptorHeapManager.Initialize(m_device.Get());
 	}
 
 	void CreateSwapChain(HWND hWnd, uint32_t frameCount, uint32_t width, uint32_t height)
@@ -107,6 +208,21 @@ public:
 		swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
 		swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 		swapChainDesc.SampleDesc.Count = 1;
+		// Latency is bounded by waiting on the frame latency object before a frame starts, see FramePacer
+		swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+
+		// Tearing needs DXGI 1.5 and a display that supports it
+		ComPtr<IDXGIFactory5> factory5;
+		BOOL bAllowTearing = FALSE;
+		if (SUCCEEDED(m_dxgiFactory.As(&factory5)) &&
+			SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &bAllowTearing, sizeof(bAllowTearing))))
+		{
+			m_bTearingSupported = bAllowTearing == TRUE;
+		}
+		if (m_bTearingSupported)
+		{
+			swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+		}
 
 		ComPtr<IDXGISwapChain1> swapChain;
 		ThrowIfFailed(m_dxgiFactory->CreateSwapChainForHwnd(
@@ -122,49 +238,41 @@ public:
 		ThrowIfFailed(m_dxgiFactory->MakeWindowAssociation(hWnd, DXGI_MWA_NO_ALT_ENTER));
 		// SwapChain1 created -> SwapChain3
 		ThrowIfFailed(swapChain.As(&m_swapChain));
+		m_frameLatencyWaitableObject = m_swapChain->GetFrameLatencyWaitableObject();
 	}
 
-
-	~D3D12GraphicsContext()
+	// Every reference to the old back buffers must be released, and the GPU done with them
+	void ResizeSwapChain(uint32_t width, uint32_t height)
 	{
+		DXGI_SWAP_CHAIN_DESC1 swapChainDesc{};
+		ThrowIfFailed(m_swapChain->GetDesc1(&swapChainDesc));
+		// Flags must match the creation flags, the waitable object stays valid
+		ThrowIfFailed(m_swapChain->ResizeBuffers(swapChainDesc.BufferCount, width, height, swapChainDesc.Format, swapChainDesc.Flags));
 	}
 
-	// Resetting command allocator and command list
-	void BeginFrame(ID3D12PipelineState* initialPipelineState = nullptr)
-	{
-		// Command allocators can be reset only if associated command lists have finished excution
-		// So fence is needed
-		ThrowIfFailed(m_commandAllocator->Reset());
-		// Reset command list before re-recording, after ExecuteCommandList is called
-		ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), initialPipelineState));
-	}
 
-	void EndFrame()
+	~D3D12GraphicsContext()
 	{
+		if (m_frameLatencyWaitableObject)
+		{
+			CloseHandle(m_frameLatencyWaitableObject);
+		}
 	}
 
 	ComPtr<ID3D12Device>&				GetDevice() { return m_device; }
 	ComPtr<ID3D12CommandQueue>&			GetCommandQueue() { return m_commandQueue; }
-	ComPtr<ID3D12GraphicsCommandList>&	GetCommandList() { return m_commandList; }
 	ComPtr<IDXGISwapChain3>&			GetSwapChain() { return m_swapChain; }
-	
-	CD3DX12_VIEWPORT const&	GetViewport() const { return m_viewport; }
-	CD3DX12_RECT const&		GetScissorRect() const { return m_scissorRect; }
-
-	uint32_t GetBackBufferWidth() const { return m_backBufferWidth; }
-	uint32_t GetBackBufferHeight() const { return m_backBufferHeight; }
+	HANDLE								GetFrameLatencyWaitableObject() const { return m_frameLatencyWaitableObject; }
+	bool								IsTearingSupported() const { return m_bTearingSupported; }
+	D3D12DescriptorHeapManager&			GetDescriptorHeapManager() { return m_descriptorHeapManager; }
 
 private:
 	ComPtr<IDXGIFactory4>	m_dxgiFactory;
 	ComPtr<ID3D12Device>	m_device;
-
-	CD3DX12_VIEWPORT		m_viewport;
-	CD3DX12_RECT			m_scissorRect;
-	uint32_t				m_backBufferWidth;
-	uint32_t				m_backBufferHeight;
 	ComPtr<IDXGISwapChain3> m_swapChain;
+	HANDLE					m_frameLatencyWaitableObject = nullptr;
+	bool					m_bTearingSupported = false;
 
-	ComPtr<ID3D12CommandAllocator>		m_commandAllocator;
 	ComPtr<ID3D12CommandQueue>			m_commandQueue;
-	ComPtr<ID3D12GraphicsCommandList>	m_commandList;
+	D3D12DescriptorHeapManager			m_descriptorHeapManager;
 };
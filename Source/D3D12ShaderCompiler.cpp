@@ -0,0 +1,51 @@
+#include "D3D12ShaderCompiler.h"
+#include "Hash.h"
+
+uint64_t D3D12ShaderCompiler::GetVersionHash() const
+{
+	// Bumping the d3dcompiler DLL changes the generated code
+	return HashString("D3DCompileFromFile", D3D_COMPILER_VERSION);
+}
+
+bool D3D12ShaderCompiler::Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderDefine& define : request.defines)
+	{
+		macros.push_back({ define.name.c_str(), define.value.c_str() });
+	}
+	macros.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> shaderBlob;
+	ComPtr<ID3DBlob> errorBlob;
+	HRESULT hr = D3DCompileFromFile(
+		request.filePath.c_str(),
+		macros.data(),
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		request.entryPoint.c_str(),
+		request.target.c_str(),
+		request.flags1,
+		request.flags2,
+		&shaderBlob,
+		&errorBlob);
+
+	if (errorBlob)
+	{
+		errors.assign(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize());
+		OutputDebugStringA(errors.c_str());
+	}
+	if (FAILED(hr))
+	{
+		if (errors.empty())
+		{
+			char message[64]{};
+			snprintf(message, sizeof(message), "HRESULT of 0x%08x", static_cast<UINT>(hr));
+			errors = message;
+		}
+		return false;
+	}
+
+	const uint8_t* pData = static_cast<const uint8_t*>(shaderBlob->GetBufferPointer());
+	bytecode.assign(pData, pData + shaderBlob->GetBufferSize());
+	return true;
+}
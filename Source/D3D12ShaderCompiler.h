@@ -0,0 +1,13 @@
+#pragma once
+
+// D3DCompiler (FXC) implementation of ShaderCompiler, used by the D3D12 backend through ShaderCache
+
+#include "D3D12Utility.h"
+#include "ShaderCache.h"
+
+class D3D12ShaderCompiler : public ShaderCompiler
+{
+public:
+	uint64_t GetVersionHash() const override;
+	bool Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors) override;
+};
@@ -0,0 +1,192 @@
+#include "DescriptorAllocator.h"
+
+DescriptorFreeListAllocator::DescriptorFreeListAllocator(uint32_t capacity)
+{
+	Reset(capacity);
+}
+
+void DescriptorFreeListAllocator::Reset(uint32_t capacity)
+{
+	m_freeBlocksByOffset.clear();
+	m_freeBlocksBySize.clear();
+	m_capacity = capacity;
+	m_numFree = 0;
+	if (capacity > 0)
+	{
+		AddFreeBlock(0, capacity);
+	}
+}
+
+DescriptorRange DescriptorFreeListAllocator::Allocate(uint32_t count)
+{
+	// Smallest block which fits
+	auto bySizeIt = m_freeBlocksBySize.lower_bound(count);
+	if (count == 0 || bySizeIt == m_freeBlocksBySize.end())
+	{
+		return {};
+	}
+
+	const uint32_t blockOffset = bySizeIt->second;
+	const uint32_t blockCount = bySizeIt->first;
+	m_freeBlocksBySize.erase(bySizeIt);
+	m_freeBlocksByOffset.erase(blockOffset);
+	m_numFree -= blockCount;
+
+	if (blockCount > count)
+	{
+		AddFreeBlock(blockOffset + count, blockCount - count);
+	}
+	return { blockOffset, count };
+}
+
+void DescriptorFreeListAllocator::Free(const DescriptorRange& range)
+{
+	check(!range.IsValid() || range.offset + range.count > m_capacity);
+
+	uint32_t offset = range.offset;
+	uint32_t count = range.count;
+
+	// Merge with the following block
+	auto nextIt = m_freeBlocksByOffset.lower_bound(offset);
+	check(nextIt != m_freeBlocksByOffset.end() && nextIt->first < offset + count); // Double free
+	if (nextIt != m_freeBlocksByOffset.end() && nextIt->first == offset + count)
+	{
+		count += nextIt->second;
+		auto eraseIt = nextIt++;
+		RemoveFreeBlock(eraseIt);
+	}
+
+	// Merge with the preceding block
+	if (nextIt != m_freeBlocksByOffset.begin())
+	{
+		auto prevIt = std::prev(nextIt);
+		check(prevIt->first + prevIt->second > offset); // Double free
+		if (prevIt->first + prevIt->second == offset)
+		{
+			offset = prevIt->first;
+			count += prevIt->second;
+			RemoveFreeBlock(prevIt);
+		}
+	}
+
+	AddFreeBlock(offset, count);
+}
+
+void DescriptorFreeListAllocator::AddFreeBlock(uint32_t offset, uint32_t count)
+{
+	m_freeBlocksByOffset.emplace(offset, count);
+	m_freeBlocksBySize.emplace(count, offset);
+	m_numFree += count;
+}
+
+void DescriptorFreeListAllocator::RemoveFreeBlock(FreeBlocksByOffset::iterator it)
+{
+	auto range = m_freeBlocksBySize.equal_range(it->second);
+	for (auto bySizeIt = range.first; bySizeIt != range.second; ++bySizeIt)
+	{
+		if (bySizeIt->second == it->first)
+		{
+			m_freeBlocksBySize.erase(bySizeIt);
+			break;
+		}
+	}
+	m_numFree -= it->second;
+	m_freeBlocksByOffset.erase(it);
+}
+
+DescriptorRingAllocator::DescriptorRingAllocator(uint32_t capacity)
+{
+	Reset(capacity);
+}
+
+void DescriptorRingAllocator::Reset(uint32_t capacity)
+{
+	m_frameMarkers.clear();
+	m_head = 0;
+	m_tail = 0;
+	m_capacity = capacity;
+}
+
+DescriptorRange DescriptorRingAllocator::Allocate(uint32_t count)
+{
+	if (count == 0 || count > m_capacity)
+	{
+		return {};
+	}
+
+	// Skip the end of the ring if the range would wrap
+	const uint32_t offset = uint32_t(m_head % m_capacity);
+	const uint32_t padding = offset + count > m_capacity ? m_capacity - offset : 0;
+	if (m_head + padding + count - m_tail > m_capacity)
+	{
+		return {};
+	}
+
+	m_head += padding;
+	DescriptorRange range{ uint32_t(m_head % m_capacity), count };
+	m_head += count;
+	return range;
+}
+
+void DescriptorRingAllocator::EndFrame(uint64_t fenceValue)
+{
+	m_frameMarkers.push_back({ fenceValue, m_head });
+}
+
+void DescriptorRingAllocator::Retire(uint64_t completedFenceValue)
+{
+	while (!m_frameMarkers.empty() && m_frameMarkers.front().fenceValue <= completedFenceValue)
+	{
+		m_tail = m_frameMarkers.front().head;
+		m_frameMarkers.pop_front();
+	}
+}
+
+DescriptorHeapAllocator::DescriptorHeapAllocator(uint32_t numPersistent, uint32_t numTransient)
+	: m_persistent(numPersistent)
+	, m_transient(numTransient)
+	, m_frameFenceValue(0)
+{
+}
+
+void DescriptorHeapAllocator::BeginFrame(uint64_t frameFenceValue, uint64_t completedFenceValue)
+{
+	m_frameFenceValue = frameFenceValue;
+	m_transient.Retire(completedFenceValue);
+	ReleaseCompleted(completedFenceValue);
+}
+
+void DescriptorHeapAllocator::EndFrame()
+{
+	m_transient.EndFrame(m_frameFenceValue);
+}
+
+DescriptorRange DescriptorHeapAllocator::AllocatePersistent(uint32_t count)
+{
+	return m_persistent.Allocate(count);
+}
+
+void DescriptorHeapAllocator::FreePersistent(const DescriptorRange& range)
+{
+	m_pendingFrees.push_back({ m_frameFenceValue, range });
+}
+
+DescriptorRange DescriptorHeapAllocator::AllocateTransient(uint32_t count)
+{
+	DescriptorRange range = m_transient.Allocate(count);
+	if (range.IsValid())
+	{
+		range.offset += m_persistent.GetCapacity();
+	}
+	return range;
+}
+
+void DescriptorHeapAllocator::ReleaseCompleted(uint64_t completedFenceValue)
+{
+	// Frees are queued in frame order, so fence values are monotonic
+	while (!m_pendingFrees.empty() && m_pendingFrees.front().fenceValue <= completedFenceValue)
+	{
+		m_persistent.Free(m_pendingFrees.front().range);
+		m_pendingFrees.pop_front();
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+// API neutral descriptor index management, D3D12DescriptorHeapManager maps the ranges to heap handles.
+// A heap is split into a persistent region served from a free list and a transient region used as a
+// per-frame linear ring. Both are retired by fence value, so a slot is reused only after the GPU is done with it.
+
+#include "Platform.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+struct DescriptorRange
+{
+	static constexpr uint32_t InvalidOffset = UINT32_MAX;
+
+	uint32_t offset = InvalidOffset;
+	uint32_t count = 0;
+
+	bool IsValid() const { return offset != InvalidOffset; }
+};
+
+// Best fit free list over [0, capacity), adjacent free blocks are coalesced
+class DescriptorFreeListAllocator
+{
+public:
+	explicit DescriptorFreeListAllocator(uint32_t capacity = 0);
+
+	void Reset(uint32_t capacity);
+
+	// Returns an invalid range when out of space
+	DescriptorRange Allocate(uint32_t count);
+	void Free(const DescriptorRange& range);
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	uint32_t GetNumFreeDescriptors() const { return m_numFree; }
+	size_t GetNumFreeBlocks() const { return m_freeBlocksByOffset.size(); }
+
+private:
+	using FreeBlocksByOffset = std::map<uint32_t, uint32_t>;		// offset -> count
+	using FreeBlocksBySize = std::multimap<uint32_t, uint32_t>;		// count -> offset
+
+	void AddFreeBlock(uint32_t offset, uint32_t count);
+	void RemoveFreeBlock(FreeBlocksByOffset::iterator it);
+
+	FreeBlocksByOffset	m_freeBlocksByOffset;
+	FreeBlocksBySize	m_freeBlocksBySize;
+	uint32_t			m_capacity;
+	uint32_t			m_numFree;
+};
+
+// Linear allocator over a ring, every frame marks its end position with the fence value
+// it will signal, space is reclaimed once that fence value completes.
+class DescriptorRingAllocator
+{
+public:
+	explicit DescriptorRingAllocator(uint32_t capacity = 0);
+
+	void Reset(uint32_t capacity);
+
+	// Ranges never wrap around the end, returns an invalid range when ring is full
+	DescriptorRange Allocate(uint32_t count);
+	void EndFrame(uint64_t fenceValue);
+	void Retire(uint64_t completedFenceValue);
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	uint32_t GetNumUsedDescriptors() const { return uint32_t(m_head - m_tail); }
+
+private:
+	struct FrameMarker
+	{
+		uint64_t fenceValue;
+		uint64_t head;
+	};
+
+	std::deque<FrameMarker>	m_frameMarkers;
+	uint64_t				m_head;		// Monotonic, offset is `m_head % m_capacity`
+	uint64_t				m_tail;
+	uint32_t				m_capacity;
+};
+
+// Persistent + transient regions of one heap, with fence deferred freeing of persistent ranges.
+// Usage per frame: BeginFrame(fence value to signal, completed value) -> allocate/free -> EndFrame()
+class DescriptorHeapAllocator
+{
+public:
+	DescriptorHeapAllocator(uint32_t numPersistent, uint32_t numTransient);
+
+	void BeginFrame(uint64_t frameFenceValue, uint64_t completedFenceValue);
+	void EndFrame();
+
+	DescriptorRange AllocatePersistent(uint32_t count = 1);
+	// Range becomes reusable once the fence value of the current frame completes
+	void FreePersistent(const DescriptorRange& range);
+	// Valid until the current frame retires, offsets start after the persistent region
+	DescriptorRange AllocateTransient(uint32_t count);
+
+	uint32_t GetCapacity() const { return m_persistent.GetCapacity() + m_transient.GetCapacity(); }
+	uint32_t GetNumFreePersistent() const { return m_persistent.GetNumFreeDescriptors(); }
+	size_t GetNumPendingFrees() const { return m_pendingFrees.size(); }
+	const DescriptorRingAllocator& GetTransientAllocator() const { return m_transient; }
+
+private:
+	struct PendingFree
+	{
+		uint64_t		fenceValue;
+		DescriptorRange	range;
+	};
+
+	void ReleaseCompleted(uint64_t completedFenceValue);
+
+	DescriptorFreeListAllocator	m_persistent;
+	DescriptorRingAllocator		m_transient;
+	std::deque<PendingFree>		m_pendingFrees;
+	uint64_t					m_frameFenceValue;
+};
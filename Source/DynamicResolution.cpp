@@ -0,0 +1,74 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t GetScaledSize(uint32_t size, float scale)
+{
+	return std::max(1u, uint32_t(std::ceil(double(size) * scale - 1e-6)));
+}
+
+DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings& settings)
+{
+	SetSettings(settings);
+}
+
+void DynamicResolutionController::SetSettings(const DynamicResolutionSettings& settings)
+{
+	// Written as negations so NaN fails them too
+	check(!(settings.targetFrameSeconds > 0.0 && std::isfinite(settings.targetFrameSeconds)));
+	check(!(settings.minScale > 0.0f && settings.maxScale > 0.0f && settings.maxScaleChange > 0.0f));
+	check(!(std::isfinite(settings.proportionalGain) && std::isfinite(settings.integralGain) && std::isfinite(settings.derivativeGain)));
+	m_settings = settings;
+	m_settings.maxScale = std::clamp(m_settings.maxScale, 0.01f, 1.0f);
+	m_settings.minScale = std::clamp(m_settings.minScale, 0.01f, m_settings.maxScale);
+	Reset();
+}
+
+void DynamicResolutionController::Reset()
+{
+	m_scale = m_settings.maxScale;
+	m_lastError = 0.0;
+	m_lastErrorChange = 0.0;
+	m_bFirstFrame = true;
+}
+
+float DynamicResolutionController::Update(double frameSeconds)
+{
+	// A broken measurement keeps the current scale rather than reaching it as NaN
+	if (!(frameSeconds > 0.0 && std::isfinite(frameSeconds)))
+	{
+		return m_scale;
+	}
+	// Relative, so the gains do not depend on the target. A frame ten times over budget counts as twice over
+	const double error = std::clamp((m_settings.targetFrameSeconds - frameSeconds) / m_settings.targetFrameSeconds, -1.0, 1.0);
+	if (m_bFirstFrame)
+	{
+		m_lastError = error;
+		m_bFirstFrame = false;
+	}
+	const double errorChange = error - m_lastError;
+	const double relativeChange = m_settings.proportionalGain * errorChange + m_settings.integralGain * error +
+		m_settings.derivativeGain * (errorChange - m_lastErrorChange);
+	m_lastError = error;
+	m_lastErrorChange = errorChange;
+
+	// Frame time follows the pixel count, the scale is its square root
+	const double pixels = double(m_scale) * m_scale * std::max(1.0 + relativeChange, 0.0);
+	const float scale = float(std::sqrt(pixels));
+	const float maxChange = m_settings.maxScaleChange;
+	m_scale = std::clamp(std::clamp(scale, m_scale - maxChange, m_scale + maxChange), m_settings.minScale, m_settings.maxScale);
+	return m_scale;
+}
+
+void DynamicResolutionController::GetRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const
+{
+	width = GetScaledSize(outputWidth, m_scale);
+	height = GetScaledSize(outputHeight, m_scale);
+}
+
+void DynamicResolutionController::GetMaxRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const
+{
+	width = GetScaledSize(outputWidth, m_settings.maxScale);
+	height = GetScaledSize(outputHeight, m_settings.maxScale);
+}
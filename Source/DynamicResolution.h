@@ -0,0 +1,56 @@
+#pragma once
+
+// Dynamic resolution
+// DynamicResolutionController picks the render scale of every frame from the measured frame times, so frames fit the
+// target frame time at the highest resolution that allows. Render targets are sized for the maximum scale once, only
+// the viewport changes per frame, and the upscale pass resamples the rendered rectangle to the output.
+//
+// The controller is an incremental PID on the relative frame time error, acting on the pixel count (scale squared),
+// which GPU cost is roughly proportional to. Acting on increments keeps it free of integral windup at the bounds, and
+// a per frame limit on the scale change keeps single hitches from dropping the resolution in one step.
+
+#include "Platform.h"
+
+#include <cstdint>
+
+struct DynamicResolutionSettings
+{
+	double	targetFrameSeconds = 1.0 / 60.0;
+	float	minScale = 0.5f;			// Per axis, of the output size
+	float	maxScale = 1.0f;			// Render targets are sized for this one
+	float	maxScaleChange = 0.05f;		// Per frame, per axis
+	double	proportionalGain = 0.25;	// On the change of the error
+	double	integralGain = 0.3;			// On the error
+	double	derivativeGain = 0.0;		// On the change of the change, amplifies noise
+};
+
+class DynamicResolutionController
+{
+public:
+	explicit DynamicResolutionController(const DynamicResolutionSettings& settings = {});
+
+	// Starts over at the maximum scale. Throws for a non-positive target frame time, scales or scale change
+	void SetSettings(const DynamicResolutionSettings& settings);
+	const DynamicResolutionSettings& GetSettings() const { return m_settings; }
+	void Reset();
+
+	// Measured time of the last frame, CPU or GPU whichever bounds it, without waits for the display.
+	// Returns the scale of the next frame, unchanged for non-positive or non-finite times
+	float Update(double frameSeconds);
+	float GetScale() const { return m_scale; }
+
+	// Render size at the current scale, at least one pixel
+	void GetRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const;
+	// Size of render targets every scale fits in
+	void GetMaxRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const;
+
+private:
+	DynamicResolutionSettings	m_settings;
+	float						m_scale = 1.0f;
+	double						m_lastError = 0.0;
+	double						m_lastErrorChange = 0.0;
+	bool						m_bFirstFrame = true;
+};
+
+// Output size times scale, rounded up, never 0
+uint32_t GetScaledSize(uint32_t size, float scale);
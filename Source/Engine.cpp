@@ -1,140 +1,197 @@
 #include "Engine.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
 #include <iostream>
 
-Engine::Engine(uint32_t width, uint32_t height, std::wstring name)
-	: m_context(width, height)
+#if defined(_WIN32)
+	#include "Win32Application.h"
+#endif
+
+namespace
+{
+	// Positive decimal number ending at terminator, wcstoul alone would accept a sign, whitespace and trailing characters
+	bool ParseCount(const wchar_t* pText, wchar_t terminator, uint32_t& value, const wchar_t** ppEnd = nullptr)
+	{
+		if (!iswdigit(*pText))
+		{
+			return false;
+		}
+		wchar_t* pEnd;
+		errno = 0;
+		const unsigned long parsed = wcstoul(pText, &pEnd, 10);
+		if (errno == ERANGE || parsed == 0 || parsed > UINT32_MAX || *pEnd != terminator)
+		{
+			return false;
+		}
+		value = uint32_t(parsed);
+		if (ppEnd)
+		{
+			*ppEnd = pEnd;
+		}
+		return true;
+	}
+}
+
+Engine::Engine(uint32_t width, uint32_t height, std::wstring name, RHIBackend backend)
+	: m_backend(backend)
+	, m_pipelineState(nullptr)
+	, m_width(width)
+	, m_height(height)
+	, m_viewport{ 0.f, 0.f, float(width), float(height), 0.f, 1.f }
+	, m_scissorRect{ 0, 0, int32_t(width), int32_t(height) }
 	, m_frameIndex(0)
-	, m_rtvDescriptorSize(0)
+	, m_maxFramesInFlight(FrameCount)
 	, m_title(name)
 {
-	WCHAR assetsPath[512];
-	GetAssetsPath(assetsPath, _countof(assetsPath));
+	wchar_t assetsPath[512];
+	GetAssetsPath(assetsPath, 512);
 	m_assetsPath = assetsPath;
+	m_probeVolumePath = m_assetsPath + L"ProbeVolume.probes";
+	m_lightmapPath = m_assetsPath + L"Scene.lightmap";
+	m_iblCachePath = GetExecutableDirectory() + L"IBLCache";
+	m_pipelineCachePath = GetExecutableDirectory() + L"PipelineCache.bin";
 }
 
 void Engine::OnInit()
 {
-	// Swapchain require hWnd, which is created after Engine::Engine()
-	m_context.CreateSwapChain(Win32Application::GetHwnd(), FrameCount, m_context.GetBackBufferWidth(), m_context.GetBackBufferHeight());
+	PROFILE_THREAD("Main");
+	PROFILE_SCOPE("Engine::OnInit");
+	{
+		PROFILE_SCOPE("CreateDevice");
+		// Headless frames are read back from host memory, which only the Null backend offers
+		m_device = CreateRHIDevice(m_bHeadless ? RHIBackend::Null : m_backend);
+	}
 
-	m_rtvDescriptorSize = m_context.GetDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	{
+		PROFILE_SCOPE("CreateSwapChain");
+		if (m_bHeadless)
+		{
+			CreateOutputTargets();
+		}
+		else
+		{
+			// Swapchain require hWnd, which is created after Engine::Engine()
+			void* nativeWindow = nullptr;
+#if defined(_WIN32)
+			nativeWindow = Win32Application::GetHwnd();
+#endif
+			m_swapChain = m_device->CreateSwapChain(nativeWindow, FrameCount, m_width, m_height, RHIFormat::R8G8B8A8_UNORM);
+			m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+		}
+
+		if (m_device->GetBackend() == RHIBackend::Null)
+		{
+			m_framePacerClock = std::make_unique<SimulatedFramePacerClock>(true);
+			m_framePacer = std::make_unique<FramePacer>(m_framePacerClock.get(), m_framePacingSettings);
+		}
+		else
+		{
+			m_framePacerClock = std::make_unique<RealFramePacerClock>();
+			m_framePacer = std::make_unique<FramePacer>(m_framePacerClock.get(), m_framePacingSettings);
+			m_framePacer->SetSwapChain(m_swapChain.get());
+		}
+	}
 
-	// Create descriptor heap
-	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc{};
-	rtvHeapDesc.NumDescriptors = FrameCount;
-	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	ThrowIfFailed(m_context.GetDevice()->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_rtvHeap)));
+	{
+		PROFILE_SCOPE("CreateFrameSystems");
+		m_framePipeline = std::make_unique<FramePipeline>(m_device.get(), m_maxFramesInFlight, NumRenderPasses);
+		m_jobSystem = std::make_unique<JobSystem>();
+		m_commandRecorder = std::make_unique<ParallelCommandRecorder>(m_device.get(), m_jobSystem.get(), NumRenderPasses);
+		m_renderGraph = std::make_unique<RenderGraph>(m_device.get());
+
+		ClusterGridDesc clusterGridDesc;
+		clusterGridDesc.width = m_width;
+		clusterGridDesc.height = m_height;
+		m_lightBinner = std::make_unique<ClusteredLightBinner>(m_jobSystem.get(), clusterGridDesc);
+		m_camera.aspectRatio = float(m_width) / float(m_height);
+		m_frustumCuller = std::make_unique<FrustumCuller>(m_jobSystem.get());
+		m_occlusionCuller = std::make_unique<OcclusionCuller>(m_jobSystem.get(), OcclusionBufferWidth, OcclusionBufferWidth * m_height / m_width);
+		m_shadowSetup = std::make_unique<ShadowSetup>();
+		if (m_bHeadless && !m_imageSequencePath.empty())
+		{
+			m_imageSequenceWriter = std::make_unique<ImageSequenceWriter>(m_jobSystem.get(), m_imageSequencePath);
+		}
+	}
 
-	// Create a RTV for each frame
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
-	for (int32_t i = 0; i < FrameCount; i++)
 	{
-		// Getting back buffer resource handle
-		ThrowIfFailed(m_context.GetSwapChain()->GetBuffer(i, IID_PPV_ARGS(&m_renderTargets[i])));
-		m_context.GetDevice()->CreateRenderTargetView(m_renderTargets[i].Get(), nullptr, rtvHandle);
-		rtvHandle.Offset(1, m_rtvDescriptorSize);
+		PROFILE_SCOPE("LoadBakedLighting");
+		std::error_code error;
+		if (std::filesystem::exists(m_probeVolumePath, error))
+		{
+			m_probeVolume.Open(m_probeVolumePath);
+		}
+		if (std::filesystem::exists(m_lightmapPath, error))
+		{
+			m_lightmap.Open(m_lightmapPath);
+		}
+		m_iblCache = std::make_unique<IBLCache>(m_iblCachePath, m_jobSystem.get());
 	}
 
-	// Create an empty root signature
-	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-	rootSignatureDesc.Init(
-		0, nullptr, // Parameters
-		0, nullptr, // Static Samplers
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	if ((m_bSoftwareRasterization || m_bHeadless) && m_device->GetBackend() == RHIBackend::Null)
+	{
+		m_softwareRasterizer = std::make_unique<SoftwareRasterizer>(m_jobSystem.get());
+		static_cast<NullRHIDevice*>(m_device.get())->GetNullGraphicsQueue().SetExecutor(m_softwareRasterizer.get());
+	}
 
-	ComPtr<ID3DBlob> signature;
-	ComPtr<ID3DBlob> error;
-	ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
-	ThrowIfFailed(m_context.GetDevice()->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
+	PipelineCache::PipelineFuture pipelineState;
+	{
+		PROFILE_SCOPE("RequestPipelines");
+		// Pipelines known from the last run start compiling in the background right away
+		m_pipelineCache = std::make_unique<PipelineCache>(m_device.get());
+		m_pipelineCache->Load(m_pipelineCachePath);
+
+		// Describe PSO, shaders are compiled by the backend
+		RHIGraphicsPipelineDesc psoDesc;
+		psoDesc.vertexShader = { L"Shader.hlsl", "VSMain", "vs_5_0" };
+		psoDesc.pixelShader = { L"Shader.hlsl", "PSMain", "ps_5_0" };
+		psoDesc.inputLayout = SceneVertexLayout::GetInputLayout();
+		psoDesc.topology = RHIPrimitiveTopology::TriangleList;
+		psoDesc.renderTargetFormat = RHIFormat::R8G8B8A8_UNORM;
+		psoDesc.bDepthEnable = false;
+		pipelineState = m_pipelineCache->RequestAsync(psoDesc);
+	}
 
-	// Create the PSO, compling and loading shaders
-	ComPtr<ID3DBlob> vertexShader;
-	ComPtr<ID3DBlob> pixelShader;
+	{
+		PROFILE_SCOPE("CreateSceneData");
+		// Create the vertex data, uploaded through the ring in OnUpdate()
+		float aspectRatio = float(m_width) / float(m_height);
+		const Float3 positions[] = { { 0.0f, 0.25f * aspectRatio, 0.0f }, { 0.25f, -0.25f * aspectRatio, 0.0f }, { -0.25f, -0.25f * aspectRatio, 0.0f } };
+		Float4 colors[] = { { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } };
+		if (m_probeVolume.IsOpen())
+		{
+			// Colors are the albedo, lit by the baked irradiance facing the camera
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				const Float3 ambient = m_probeVolume.SampleIrradiance(positions[i], { 0.0f, 0.0f, -1.0f }) * (1.0f / 3.14159265f);
+				colors[i] = { colors[i].x * ambient.x, colors[i].y * ambient.y, colors[i].z * ambient.z, colors[i].w };
+			}
+		}
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			m_triangleVertices[i].Set<0>(positions[i]);
+		}
+		SceneVertexLayout::PackAttribute<1>(PackColorsRGBA8, colors, 3, m_triangleVertices);
+
+		// One persistently mapped upload buffer shared by all dynamic data
+		m_uploadHeap = std::make_unique<UploadHeap>(m_device.get(), UploadHeapSize);
+	}
 
-#if defined(_DEBUG)
-	uint32_t compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-	uint32_t compileFlags = 0;
-#endif
+	{
+		PROFILE_SCOPE("WaitForPipelines");
+		m_pipelineState = pipelineState.get();
+	}
 
-	// Compiling shaders
-	ShaderCompileHelper(L"Shader.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader);
-	ShaderCompileHelper(L"Shader.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader);
-
-	// Define vertex input layout
-	D3D12_INPUT_ELEMENT_DESC inputElementsDesc[] =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
-
-	// Describe PSO
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc{};
-	psoDesc.InputLayout = { inputElementsDesc, _countof(inputElementsDesc) };
-	psoDesc.pRootSignature = m_rootSignature.Get();
-	psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-	psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
-	psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-	psoDesc.DepthStencilState.DepthEnable = FALSE;
-	psoDesc.DepthStencilState.StencilEnable = FALSE;
-	psoDesc.SampleMask = UINT_MAX;
-	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-	psoDesc.NumRenderTargets = 1;
-	psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	psoDesc.SampleDesc.Count = 1;
-	ThrowIfFailed(m_context.GetDevice()->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
-
-	// Create the vertex buffer
-	float aspectRatio = float(m_context.GetBackBufferWidth()) / float(m_context.GetBackBufferHeight());
-	Vertex triangleVertices[] =
-	{
-		{ { 0.0f, 0.25f * aspectRatio, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
-		{ { 0.25f, -0.25f * aspectRatio, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
-		{ { -0.25f, -0.25f * aspectRatio, 0.0f } , { 0.0f, 0.0f, 1.0f, 1.0f } }
-	};
-
-	const uint32_t vertexBufferSize = sizeof(triangleVertices);
-
-	auto heapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize);
-
-	// Using a upload heap for simplicity
-	ThrowIfFailed(m_context.GetDevice()->CreateCommittedResource(
-		&heapProperty,
-		D3D12_HEAP_FLAG_NONE,
-		&resourceDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&m_vertexBuffer)
-	));
-
-	// Copy the triangle data to vertex buffer
-	uint8_t* pVertexDataBegin = nullptr;
-	CD3DX12_RANGE readRange(0, 0); // Not intended to be read from CPU
-	ThrowIfFailed(m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-	memcpy(pVertexDataBegin, triangleVertices, sizeof(triangleVertices));
-	m_vertexBuffer->Unmap(0, nullptr);
-
-	// Initialize vertex buffer view
-	m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-	m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-	m_vertexBufferView.SizeInBytes = vertexBufferSize;
-
-	// Create synchronization objects and wait until assets being uplaod to GPU
-	ThrowIfFailed(m_context.GetDevice()->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fenceObject)));
-	m_fenceValue = 1;
-
-	// Create an event handle to use for frame synchronization
-	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-	if (m_fenceEvent == nullptr)
-	{
-		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-	}
-
-	// Wait for command list to excute
-	WaitForGpuCommandCompletion();
+	{
+		PROFILE_SCOPE("WaitForGpu");
+		// Wait until assets being uplaod to GPU
+		WaitForGpuCommandCompletion();
+	}
 }
 
 Engine::~Engine()
@@ -143,8 +200,66 @@ Engine::~Engine()
 
 
 _Use_decl_annotations_
-void Engine::ParseCommandLineArgs(wchar_t* argv[], int32_t argc)
+bool Engine::ParseCommandLineArgs(wchar_t* argv[], int32_t argc)
+{
+	for (int32_t i = 1; i < argc; i++)
+	{
+		const bool bHasValue = i + 1 < argc;
+		uint32_t width;
+		uint32_t height;
+		const wchar_t* pSeparator;
+		uint32_t numFrames;
+		if (wcscmp(argv[i], L"--headless") == 0)
+		{
+			SetHeadless(true);
+		}
+		else if (wcscmp(argv[i], L"--frames") == 0 && bHasValue && ParseCount(argv[i + 1], L'\0', numFrames))
+		{
+			SetHeadlessFrameCount(numFrames);
+			i++;
+		}
+		else if (wcscmp(argv[i], L"--size") == 0 && bHasValue && ParseCount(argv[i + 1], L'x', width, &pSeparator) && ParseCount(pSeparator + 1, L'\0', height))
+		{
+			// Headless frames go through the software rasterizer, which has a fixed point range limit
+			if (width > SoftwareRasterizer::MaxRenderTargetSize || height > SoftwareRasterizer::MaxRenderTargetSize)
+			{
+				fprintf(stderr, "--size must not exceed %ux%u\n", uint32_t(SoftwareRasterizer::MaxRenderTargetSize), uint32_t(SoftwareRasterizer::MaxRenderTargetSize));
+				return false;
+			}
+			// Before OnInit(), nothing is sized yet
+			m_width = width;
+			m_height = height;
+			m_viewport = { 0.0f, 0.0f, float(width), float(height), 0.0f, 1.0f };
+			m_scissorRect = { 0, 0, int32_t(width), int32_t(height) };
+			i++;
+		}
+		else if (wcscmp(argv[i], L"--scene") == 0 && bHasValue)
+		{
+			// Same file names as the defaults in the assets folder
+			const std::filesystem::path sceneDirectory = argv[++i];
+			SetProbeVolumePath((sceneDirectory / L"ProbeVolume.probes").wstring());
+			SetLightmapPath((sceneDirectory / L"Scene.lightmap").wstring());
+		}
+		else if (wcscmp(argv[i], L"--output") == 0 && bHasValue)
+		{
+			SetImageSequence(argv[++i]);
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+const char* Engine::GetCommandLineUsage()
 {
+	return "Usage: LightingEffects [options]\n"
+		"  --headless          no window or swap chain, renders through the software rasterizer and exits\n"
+		"  --frames N          frames to render headless, default 1\n"
+		"  --size WxH          output size, default 1280x720, at most 6144x6144\n"
+		"  --scene DIR         baked lighting to load, DIR/ProbeVolume.probes and DIR/Scene.lightmap\n"
+		"  --output PATTERN    headless image sequence, .ppm or .hdr, e.g. Frames/Preview_####.ppm\n";
 }
 
 std::wstring Engine::GetAssetFullPath(const wchar_t* assetName)
@@ -154,75 +269,395 @@ std::wstring Engine::GetAssetFullPath(const wchar_t* assetName)
 
 void Engine::WaitForGpuCommandCompletion()
 {
-	const uint64_t currentFenceValue = m_fenceValue;
-	m_fenceValue++;
-	// After commands in the command queue before `Signal` are finished, fence will be set to `currentFenceValue`
-	ThrowIfFailed(m_context.GetCommandQueue()->Signal(m_fenceObject.Get(), currentFenceValue));
-	// If fence not yet reach `currentFenceValue`, set an event and wait for it
-	if (m_fenceObject->GetCompletedValue() < currentFenceValue)
+	m_framePipeline->WaitForIdle(m_device->GetGraphicsQueue());
+}
+
+const std::vector<uint32_t>& Engine::GetVisibleObjects() const
+{
+	return m_occluders.empty() ? m_frustumCuller->GetVisibleIndices() : m_occlusionCuller->GetVisibleIndices();
+}
+
+void Engine::SetMaxFramesInFlight(uint32_t maxFramesInFlight)
+{
+	check(m_framePipeline != nullptr);
+	m_maxFramesInFlight = std::max(1u, std::min(maxFramesInFlight, uint32_t(MaxFramesInFlightLimit)));
+}
+
+void Engine::SetFramePacing(const FramePacingSettings& settings)
+{
+	m_framePacingSettings = settings;
+	if (m_framePacer)
+	{
+		m_framePacer->SetSettings(settings);
+	}
+}
+
+void Engine::SetHeadless(bool bEnable)
+{
+	check(m_device != nullptr);
+	m_bHeadless = bEnable;
+	// Nothing waits for a display, frames start as soon as the previous one is submitted
+	if (bEnable)
+	{
+		m_framePacingSettings.mode = PresentMode::Uncapped;
+	}
+}
+
+RHIResource* Engine::GetOutputTarget()
+{
+	return m_outputTargets[m_lastOutputSlot].get();
+}
+
+void Engine::CreateOutputTargets()
+{
+	// Rest in CopySource between frames, where a readback copy would take them from
+	for (uint32_t slot = 0; slot < m_maxFramesInFlight; slot++)
+	{
+		RHIResourceDesc desc = RHIResourceDesc::Texture2D(m_width, m_height, RHIFormat::R8G8B8A8_UNORM, true);
+		desc.initialState = RHIResourceState::CopySource;
+		m_outputTargets[slot] = m_device->CreateResource(desc);
+		m_outputFrames[slot] = UINT32_MAX;
+	}
+}
+
+void Engine::ReadBackOutput(uint32_t slot)
+{
+	if (m_outputFrames[slot] == UINT32_MAX)
+	{
+		return;
+	}
+	PROFILE_SCOPE("ReadBackOutput");
+	if (m_imageSequenceWriter)
+	{
+		const NullResource* pTarget = static_cast<const NullResource*>(m_outputTargets[slot].get());
+		const RHIResourceDesc& desc = pTarget->GetDesc();
+		m_imageSequenceWriter->Write(m_outputFrames[slot], pTarget->GetData(), pTarget->GetRowPitch(), uint32_t(desc.width), desc.height);
+	}
+	m_outputFrames[slot] = UINT32_MAX;
+}
+
+void Engine::ReadBackOutputs()
+{
+	// Oldest first
+	for (uint32_t slot = 1; slot <= m_maxFramesInFlight; slot++)
+	{
+		ReadBackOutput((m_lastOutputSlot + slot) % m_maxFramesInFlight);
+	}
+	if (m_imageSequenceWriter)
+	{
+		m_imageSequenceWriter->Flush();
+	}
+}
+
+int Engine::RunHeadless()
+{
+	try
 	{
-		ThrowIfFailed(m_fenceObject->SetEventOnCompletion(currentFenceValue, m_fenceEvent));
-		WaitForSingleObject(m_fenceEvent, INFINITE);
+		check(!m_bHeadless);
+		HeadlessStatistics statistics;
+		auto startTime = std::chrono::steady_clock::now();
+		OnInit();
+		statistics.initSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+		// Only the frames count towards the stage timings
+		Profiler::Reset();
+		startTime = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < m_numHeadlessFrames; frame++)
+		{
+			OnUpdate();
+		}
+		{
+			PROFILE_SCOPE("FlushOutput");
+			WaitForGpuCommandCompletion();
+			ReadBackOutputs();
+		}
+		statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		Profiler::EndFrame();
+
+		statistics.numFrames = m_numHeadlessFrames;
+		statistics.width = m_width;
+		statistics.height = m_height;
+		statistics.numImagesWritten = m_imageSequenceWriter ? m_imageSequenceWriter->GetNumWritten() : 0;
+#if ENABLE_PROFILER
+		statistics.stageReport = Profiler::FormatReport();
+#endif
+		OnDestroy();
+
+		m_headlessStatistics = statistics;
+		std::cout << statistics.FormatReport() << std::flush;
 	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Headless: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+std::string HeadlessStatistics::FormatReport() const
+{
+	char summary[256];
+	snprintf(summary, sizeof(summary), "%u frames at %ux%u in %.3f s, %.1f fps, %.3f ms per frame, %u images written, init %.3f s\n",
+		numFrames, width, height, seconds, GetFramesPerSecond(), numFrames > 0 ? seconds * 1000.0 / numFrames : 0.0, numImagesWritten, initSeconds);
+	return summary + stageReport;
+}
+
+void Engine::SetDynamicResolution(bool bEnable, const DynamicResolutionSettings& settings)
+{
+	m_bDynamicResolution = bEnable;
+	m_dynamicResolution.SetSettings(settings);
 }
 
 void Engine::OnResize(uint32_t newWidth, uint32_t newHeight)
 {
+	// Minimized windows keep their swap chain
+	if (newWidth == 0 || newHeight == 0 || (newWidth == m_width && newHeight == m_height))
+	{
+		return;
+	}
+	m_width = newWidth;
+	m_height = newHeight;
+	if (m_swapChain != nullptr)
+	{
+		// Back buffers are replaced, no frame in flight may still use them. Scene color follows at the next frame
+		WaitForGpuCommandCompletion();
+		m_swapChain->Resize(newWidth, newHeight);
+		m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+	}
+	else if (m_outputTargets[0] != nullptr)
+	{
+		// Same for the headless targets, frames still in them are written at the size they were rendered at
+		WaitForGpuCommandCompletion();
+		ReadBackOutputs();
+		CreateOutputTargets();
+	}
+	if (m_lightBinner != nullptr)
+	{
+		ClusterGridDesc clusterGridDesc = m_lightBinner->GetGridDesc();
+		clusterGridDesc.width = newWidth;
+		clusterGridDesc.height = newHeight;
+		m_lightBinner->SetGridDesc(clusterGridDesc);
+		m_occlusionCuller->SetResolution(OcclusionBufferWidth, OcclusionBufferWidth * newHeight / newWidth);
+		m_camera.aspectRatio = float(newWidth) / float(newHeight);
+	}
 }
 
 void Engine::OnUpdate()
 {
-	// Record command list
-	m_context.BeginFrame(m_pipelineState.Get());
+	// Closes the previous frame, its scopes have all ended by now
+	Profiler::EndFrame();
+	PROFILE_SCOPE("Engine::OnUpdate");
 
-	ComPtr<ID3D12GraphicsCommandList>& m_commandList = m_context.GetCommandList();
+	{
+		PROFILE_SCOPE("FramePacing");
+		// Waits for the display queue or the frame cap before anything of the frame is sampled
+		m_framePacer->BeginFrame();
+	}
+	m_frameWorkStart = std::chrono::steady_clock::now();
 
-	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-	m_commandList->RSSetViewports(1, &m_context.GetViewport());
-	m_commandList->RSSetScissorRects(1, &m_context.GetScissorRect());
+	{
+		PROFILE_SCOPE("BeginFrame");
+		// Only blocks if the GPU still uses the command allocator of this frame slot
+		m_framePipeline->BeginFrame();
+		m_uploadHeap->BeginFrame(m_framePipeline->GetCompletedFenceValue());
+	}
+	if (m_bHeadless)
+	{
+		// The slot is retired, its target still holds the frame rendered max frames in flight ago
+		ReadBackOutput(m_framePipeline->GetCurrentSlot());
+	}
 
-	// Indicate that backbuffer will be used as render target
-	auto transitionPresentToRt = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-	m_commandList->ResourceBarrier(1, &transitionPresentToRt);
+	if (!m_lights.IsEmpty())
+	{
+		PROFILE_SCOPE("BinLights");
+		m_lightBinner->Bin(m_lights, m_camera);
+	}
+	{
+		PROFILE_SCOPE("SetupShadows");
+		m_shadowSetup->Update(m_camera, m_sunDirection, m_shadowedLights);
+	}
+	if (!m_objectBounds.IsEmpty())
+	{
+		PROFILE_SCOPE("CullObjects");
+		const Float4x4 viewProjection = m_camera.GetViewProjectionMatrix();
+		m_frustumCuller->Cull(m_objectBounds, ExtractFrustumPlanes(viewProjection));
+		if (!m_occluders.empty())
+		{
+			PROFILE_SCOPE("OcclusionCulling");
+			m_occlusionCuller->BeginFrame(viewProjection);
+			for (const OccluderMesh& occluder : m_occluders)
+			{
+				m_occlusionCuller->AddOccluder(occluder, MatrixIdentity());
+			}
+			m_occlusionCuller->RenderOccluders();
+			m_occlusionCuller->TestOccludees(m_objectBounds, m_frustumCuller->GetVisibleIndices());
+		}
+	}
 
-	// Get RTV handle
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
-	m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+	RHIVertexBufferView vertexBufferView;
+	{
+		PROFILE_SCOPE("UploadFrameData");
+		// Copy the triangle data to upload ring
+		const uint32_t vertexBufferSize = sizeof(m_triangleVertices);
+		UploadAllocation vertexData = m_uploadHeap->Upload(m_triangleVertices, vertexBufferSize, UploadAlignmentVertex);
+		vertexBufferView.bufferLocation = vertexData.gpuAddress;
+		vertexBufferView.strideInBytes = SceneVertexLayout::Stride;
+		vertexBufferView.sizeInBytes = vertexBufferSize;
+	}
 
-	// Record commands
-	const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-	m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-	m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	m_commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-	m_commandList->DrawInstanced(3, 1, 0, 0);
+	{
+		// Only the viewport follows the render scale, scene color stays sized for the maximum
+		uint32_t renderWidth;
+		uint32_t renderHeight;
+		m_dynamicResolution.GetRenderSize(m_width, m_height, renderWidth, renderHeight);
+		m_viewport = { 0.0f, 0.0f, float(renderWidth), float(renderHeight), 0.0f, 1.0f };
+		m_scissorRect = { 0, 0, int32_t(renderWidth), int32_t(renderHeight) };
+	}
 
-	// Indicate that back buffer will be present
-	auto transitionRtToPresent = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-	m_commandList->ResourceBarrier(1, &transitionRtToPresent);
+	// Passes that survive compilation record in parallel, submitted in RenderPass order
+	BuildRenderGraph(vertexBufferView);
+	{
+		PROFILE_SCOPE("RecordAndSubmit");
+		m_commandRecorder->RecordAndSubmit(m_framePipeline.get(), m_device->GetGraphicsQueue(), m_renderGraph->GetNumCompiledPasses(), [&](uint32_t pass, RHICommandList* pCommandList)
+		{
+			m_renderGraph->RecordPass(pass, pCommandList);
+		}, m_pipelineState);
+	}
 
-	ThrowIfFailed(m_commandList->Close());
+	if (m_bHeadless)
+	{
+		// Read back once the slot comes around again, or by RunHeadless()
+		m_lastOutputSlot = m_framePipeline->GetCurrentSlot();
+		m_outputFrames[m_lastOutputSlot] = m_outputFrameCount++;
+		m_framePacer->EndFrame();
+	}
+	else
+	{
+		PROFILE_SCOPE("Present");
+		const FramePresent present = m_framePacer->GetPresent();
+		m_swapChain->Present(present.syncInterval, present.flags);
+		m_framePacer->EndFrame();
+	}
 
-	// Execute the command list
-	ID3D12CommandList* ppCommandLists[] = { m_context.GetCommandList().Get() };
-	m_context.GetCommandQueue()->ExecuteCommandLists(1, ppCommandLists);
+	{
+		PROFILE_SCOPE("EndFrame");
+		// No wait here, CPU moves on to the next frame while GPU works on this one
+		m_uploadHeap->EndFrame(m_framePipeline->GetCurrentFenceValue());
+		m_framePipeline->EndFrame(m_device->GetGraphicsQueue());
+		if (m_swapChain)
+		{
+			m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+		}
+	}
 
-	// Present the frame
-	ThrowIfFailed(m_context.GetSwapChain()->Present(1, 0));
+	// Picks the render scale of the next frame
+	m_lastFrameWorkSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_frameWorkStart).count();
+	if (m_bDynamicResolution)
+	{
+		m_dynamicResolution.Update(m_lastFrameWorkSeconds);
+	}
+}
 
-	WaitForGpuCommandCompletion();
-	m_frameIndex = m_context.GetSwapChain()->GetCurrentBackBufferIndex();
+void Engine::BuildRenderGraph(const RHIVertexBufferView& vertexBufferView)
+{
+	PROFILE_SCOPE("BuildRenderGraph");
+	static const char* const passNames[NumRenderPasses] = { "Clear", "Scene", "Upscale" };
+
+	// Back buffer is presentable outside the graph, headless output targets rest as copy source. Only the upscale
+	// pass writes them
+	m_renderGraph->Reset();
+	uint32_t maxWidth;
+	uint32_t maxHeight;
+	m_dynamicResolution.GetMaxRenderSize(m_width, m_height, maxWidth, maxHeight);
+	const RenderGraphTexture sceneColor = m_renderGraph->CreateTexture("SceneColor", maxWidth, maxHeight, RHIFormat::R8G8B8A8_UNORM);
+	const RenderGraphTexture backBuffer = m_bHeadless ?
+		m_renderGraph->ImportTexture("Output", m_outputTargets[m_framePipeline->GetCurrentSlot()].get(), RHIResourceState::CopySource, RHIResourceState::CopySource) :
+		m_renderGraph->ImportTexture("BackBuffer", m_swapChain->GetBackBuffer(m_frameIndex), RHIResourceState::Present, RHIResourceState::Present);
+	for (uint32_t pass = 0; pass < NumRenderPasses; pass++)
+	{
+		const uint32_t graphPass = m_renderGraph->AddPass(passNames[pass], [this, pass, sceneColor, backBuffer, vertexBufferView](RHICommandList* pCommandList, const RenderGraph& graph)
+		{
+			RecordRenderPass(RenderPass(pass), pCommandList, graph.GetResource(sceneColor), graph.GetResource(backBuffer), vertexBufferView);
+		});
+		if (pass == RenderPassUpscale)
+		{
+			m_renderGraph->Read(graphPass, sceneColor);
+			m_renderGraph->Write(graphPass, backBuffer, RHIResourceState::RenderTarget);
+		}
+		else
+		{
+			m_renderGraph->Write(graphPass, sceneColor, RHIResourceState::RenderTarget);
+		}
+	}
+	m_renderGraph->Compile();
+}
 
-	m_context.EndFrame();
+void Engine::RecordRenderPass(RenderPass pass, RHICommandList* pCommandList, RHIResource* pSceneColor, RHIResource* pBackBuffer, const RHIVertexBufferView& vertexBufferView)
+{
+	// Command lists do not inherit state, every pass binds what it uses. Barriers come from the render graph
+	switch (pass)
+	{
+	case RenderPassClear:
+	{
+		const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
+		pCommandList->ClearRenderTarget(pSceneColor, clearColor);
+		break;
+	}
+	case RenderPassScene:
+	{
+		pCommandList->SetViewport(m_viewport);
+		pCommandList->SetScissorRect(m_scissorRect);
+		pCommandList->SetRenderTarget(pSceneColor);
+		pCommandList->SetPrimitiveTopology(RHIPrimitiveTopology::TriangleList);
+		pCommandList->SetVertexBuffer(0, vertexBufferView);
+		pCommandList->DrawInstanced(3, 1, 0, 0);
+		break;
+	}
+	case RenderPassUpscale:
+	{
+		// The rendered rectangle of scene color to the whole back buffer
+		const RHIRect outputRect = { 0, 0, int32_t(m_width), int32_t(m_height) };
+		pCommandList->UpscaleTexture(pBackBuffer, outputRect, pSceneColor, m_scissorRect, m_upscaleFilter);
+		break;
+	}
+	default:
+		break;
+	}
 }
 
 void Engine::OnDestroy()
 {
 	WaitForGpuCommandCompletion();
-	CloseHandle(m_fenceEvent);
+	if (m_bHeadless)
+	{
+		ReadBackOutputs();
+	}
+
+	if (m_softwareRasterizer)
+	{
+		static_cast<NullRHIDevice*>(m_device.get())->GetNullGraphicsQueue().SetExecutor(nullptr);
+	}
+
+	if (m_pipelineCache)
+	{
+		m_pipelineCache->Save(m_pipelineCachePath);
+	}
+}
+
+void Engine::SetEnvironment(const RadianceCubemap& environment, const IBLDesc& desc)
+{
+	m_environmentLighting = m_iblCache->GetOrPrefilter(environment, desc);
 }
 
 void Engine::OnKeyDown(uint8_t key)
 {
+	// P cycles the present modes
+	if (key == 'P')
+	{
+		FramePacingSettings settings = m_framePacingSettings;
+		settings.mode = PresentMode((uint32_t(settings.mode) + 1) % (uint32_t(PresentMode::FrameCap) + 1));
+		SetFramePacing(settings);
+	}
 }
 
 void Engine::OnKeyUp(uint8_t key)
@@ -1,24 +1,67 @@
 #pragma once
 
-#include "D3D12Utility.h"
-#include "D3D12RenderContext.h"
-#include "Win32Application.h"
+#include "RHI.h"
+#include "Camera.h"
+#include "ClusteredLighting.h"
+#include "DynamicResolution.h"
+#include "EngineMath.h"
+#include "FramePacer.h"
+#include "FramePipeline.h"
+#include "FrustumCulling.h"
+#include "ImageBasedLighting.h"
+#include "ImageSequence.h"
+#include "JobSystem.h"
+#include "Lightmap.h"
+#include "OcclusionCulling.h"
+#include "ParallelCommandRecorder.h"
+#include "PipelineCache.h"
+#include "ProbeVolume.h"
+#include "RenderGraph.h"
+#include "ShadowSetup.h"
+#include "SoftwareRasterizer.h"
+#include "UploadRing.h"
+#include "VertexLayout.h"
 
 enum
 {
 	FrameCount = 3,
+	UploadHeapSize = 4 * 1024 * 1024,
+	OcclusionBufferWidth = 320,		// Height follows the aspect ratio
 };
 
-struct Vertex
+// Each pass is recorded into its own command list in parallel, submitted in this order.
+// Clear and Scene render the scene color at the render scale, Upscale resamples it into the back buffer
+enum RenderPass
 {
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT4 color;
+	RenderPassClear,
+	RenderPassScene,
+	RenderPassUpscale,
+	NumRenderPasses,
+};
+
+// 16 bytes, the color is expanded back to float4 by the input assembler
+using SceneVertexLayout = VertexLayout<VertexAttribute<"POSITION", Float3>, VertexAttribute<"COLOR", ColorRGBA8>>;
+using SceneVertex = SceneVertexLayout::Vertex;
+
+// Of Engine::RunHeadless()
+struct HeadlessStatistics
+{
+	uint32_t	numFrames = 0;
+	uint32_t	width = 0;
+	uint32_t	height = 0;
+	uint32_t	numImagesWritten = 0;
+	double		initSeconds = 0.0;
+	double		seconds = 0.0;		// Of the frames, including the wait for their images
+	std::string	stageReport;		// Profiler::FormatReport() of the frames, empty without ENABLE_PROFILER
+
+	double GetFramesPerSecond() const { return seconds > 0.0 ? numFrames / seconds : 0.0; }
+	std::string FormatReport() const;
 };
 
 class Engine
 {
 public:
-	Engine(uint32_t width, uint32_t height, std::wstring name);
+	Engine(uint32_t width, uint32_t height, std::wstring name, RHIBackend backend = GetDefaultRHIBackend());
 	~Engine();
 
 	void OnInit();
@@ -29,36 +72,177 @@ public:
 	void OnKeyDown(uint8_t key);
 	void OnKeyUp(uint8_t key);
 
-	uint32_t GetWidth() const { return m_context.GetBackBufferWidth(); }
-	uint32_t GetHeight() const { return m_context.GetBackBufferHeight(); }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
 	const wchar_t* GetTitle() const { return m_title.c_str(); }
 
-	void ParseCommandLineArgs(_In_reads_(argc) wchar_t* argv[], int32_t argc);
+	// Should be called before OnInit(), argv[0] is the program. False on unknown options or malformed values
+	bool ParseCommandLineArgs(_In_reads_(argc) wchar_t* argv[], int32_t argc);
+	static const char* GetCommandLineUsage();
 
 	std::wstring GetAssetFullPath(const wchar_t* assetName);
 
 	void WaitForGpuCommandCompletion();
 
-private:
-	D3D12GraphicsContext m_context;
+	// Should be called before OnInit(), 1 means CPU and GPU take turns
+	void SetMaxFramesInFlight(uint32_t maxFramesInFlight);
+	uint32_t GetMaxFramesInFlight() const { return m_maxFramesInFlight; }
+
+	// Any time, takes effect at the next frame. D3D12 paces against the real display, the Null backend against
+	// a simulated display clock that follows real time but skips the waits
+	void SetFramePacing(const FramePacingSettings& settings);
+	const FramePacer* GetFramePacer() const { return m_framePacer.get(); }
+
+	// Any time. When enabled the render scale follows the measured frame times, otherwise frames render at the
+	// maximum scale. Scene color is sized for the maximum scale, the viewport covers the current one
+	void SetDynamicResolution(bool bEnable, const DynamicResolutionSettings& settings = {});
+	bool IsDynamicResolutionEnabled() const { return m_bDynamicResolution; }
+	const DynamicResolutionController& GetDynamicResolution() const { return m_dynamicResolution; }
+	void SetUpscaleFilter(RHIUpscaleFilter filter) { m_upscaleFilter = filter; }
+	// Of the last frame
+	uint32_t GetRenderWidth() const { return uint32_t(m_scissorRect.right); }
+	uint32_t GetRenderHeight() const { return uint32_t(m_scissorRect.bottom); }
+	double GetLastFrameWorkSeconds() const { return m_lastFrameWorkSeconds; }
+
+	// Should be called before OnInit(), the Null backend then renders frames with the SoftwareRasterizer
+	void SetSoftwareRasterization(bool bEnable) { m_bSoftwareRasterization = bEnable; }
+
+	// Should be called before OnInit(). Frames render into offscreen targets instead of a swap chain, so no window
+	// is needed, through the Null backend and the SoftwareRasterizer whatever the backend passed to Engine(). Frames
+	// are not paced and the output of each one is read back once the frame pipeline retires it
+	void SetHeadless(bool bEnable);
+	bool IsHeadless() const { return m_bHeadless; }
+	// Headless, should be called before OnInit(). Frames rendered from then on are written as an image sequence
+	void SetImageSequence(const std::wstring& pathPattern) { m_imageSequencePath = pathPattern; }
+	void SetHeadlessFrameCount(uint32_t numFrames) { m_numHeadlessFrames = std::max(numFrames, 1u); }
+	// Init, the frames of SetHeadlessFrameCount(), then destroy. Prints the report to stdout, failures to stderr,
+	// returns the exit code of the process
+	int RunHeadless();
+	const HeadlessStatistics& GetHeadlessStatistics() const { return m_headlessStatistics; }
+	// Headless, offscreen target of the last frame. The Null backend keeps it in host memory
+	RHIResource* GetOutputTarget();
+
+	RHIDevice* GetDevice() { return m_device.get(); }
+	RHISwapChain* GetSwapChain() { return m_swapChain.get(); }
+	FramePipeline* GetFramePipeline() { return m_framePipeline.get(); }
+	JobSystem* GetJobSystem() { return m_jobSystem.get(); }
+	PipelineCache* GetPipelineCache() { return m_pipelineCache.get(); }
+	// Declared and compiled every frame, the barriers come from the declared reads and writes
+	const RenderGraph* GetRenderGraph() const { return m_renderGraph.get(); }
+	SoftwareRasterizer* GetSoftwareRasterizer() { return m_softwareRasterizer.get(); }
+
+	// Lights are binned into clusters every frame before command recording
+	Camera& GetCamera() { return m_camera; }
+	LightList& GetLights() { return m_lights; }
+	const ClusteredLightBinner* GetLightBinner() const { return m_lightBinner.get(); }
+
+	// Objects are culled against the camera every frame before command recording, only visible ones are drawn.
+	// With occluders the frustum culling result is occlusion tested against them
+	CullingBounds& GetObjectBounds() { return m_objectBounds; }
+	std::vector<OccluderMesh>& GetOccluders() { return m_occluders; }
+	const FrustumCuller* GetFrustumCuller() const { return m_frustumCuller.get(); }
+	const OcclusionCuller* GetOcclusionCuller() const { return m_occlusionCuller.get(); }
+	const std::vector<uint32_t>& GetVisibleObjects() const;
+
+	// Cascades and atlas tiles are set up every frame before command recording
+	void SetSunDirection(const Float3& direction) { m_sunDirection = Normalize(direction); }
+	std::vector<ShadowedLight>& GetShadowedLights() { return m_shadowedLights; }
+	ShadowSetup* GetShadowSetup() { return m_shadowSetup.get(); }
+
+	// Should be called before OnInit(), the baked probe volume is optional and loaded at startup when present
+	void SetProbeVolumePath(const std::wstring& path) { m_probeVolumePath = path; }
+	const ProbeVolume& GetProbeVolume() const { return m_probeVolume; }
+	// Same for the baked lightmaps of the static objects
+	void SetLightmapPath(const std::wstring& path) { m_lightmapPath = path; }
+	const Lightmap& GetLightmap() const { return m_lightmap; }
+
+	// Should be called before OnInit(), the default is IBLCache next to the executable
+	void SetIBLCachePath(const std::wstring& path) { m_iblCachePath = path; }
+	// Same for the pipeline cache loaded by OnInit() and saved by OnDestroy(), default PipelineCache.bin
+	void SetPipelineCachePath(const std::wstring& path) { m_pipelineCachePath = path; }
+	// Should be called after OnInit(). Prefiltered on first use, later runs map the cached result
+	void SetEnvironment(const RadianceCubemap& environment, const IBLDesc& desc = {});
+	const IBLData& GetEnvironmentLighting() const { return m_environmentLighting; }
+	const IBLCache* GetIBLCache() const { return m_iblCache.get(); }
 
-	ComPtr<ID3D12Resource> m_renderTargets[FrameCount];
-	
-	ComPtr<ID3D12RootSignature> m_rootSignature;
-	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
-	ComPtr<ID3D12PipelineState> m_pipelineState;
-
-	uint32_t m_rtvDescriptorSize;
-
-	// App resource
-	ComPtr<ID3D12Resource> m_vertexBuffer;
-	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
-
-	// Synchronization objects
+private:
+	void BuildRenderGraph(const RHIVertexBufferView& vertexBufferView);
+	void RecordRenderPass(RenderPass pass, RHICommandList* pCommandList, RHIResource* pSceneColor, RHIResource* pBackBuffer, const RHIVertexBufferView& vertexBufferView);
+	void CreateOutputTargets();
+	// Writes the frame last rendered into the output target of `slot`, which must be retired
+	void ReadBackOutput(uint32_t slot);
+	// Every frame not read back yet, the GPU must be idle. Waits for their images
+	void ReadBackOutputs();
+
+	// Created in OnInit(), after the command line may have asked for headless
+	RHIBackend m_backend;
+	std::unique_ptr<RHIDevice> m_device;
+	std::unique_ptr<RHISwapChain> m_swapChain;
+
+	// Headless, one output target per frame slot replaces the back buffers
+	bool m_bHeadless = false;
+	uint32_t m_numHeadlessFrames = 1;
+	uint32_t m_outputFrameCount = 0;
+	std::unique_ptr<RHIResource> m_outputTargets[MaxFramesInFlightLimit];
+	uint32_t m_outputFrames[MaxFramesInFlightLimit];	// Frame last rendered into the target, UINT32_MAX once read back
+	uint32_t m_lastOutputSlot = 0;
+	std::wstring m_imageSequencePath;
+	std::unique_ptr<ImageSequenceWriter> m_imageSequenceWriter;
+	HeadlessStatistics m_headlessStatistics;
+
+	std::unique_ptr<JobSystem> m_jobSystem;
+	std::unique_ptr<ParallelCommandRecorder> m_commandRecorder;
+	std::unique_ptr<RenderGraph> m_renderGraph;
+	// Pipelines are owned by the cache, saved on exit for a warm start
+	std::unique_ptr<PipelineCache> m_pipelineCache;
+	std::wstring m_pipelineCachePath;
+	RHIPipelineState* m_pipelineState;
+	// Executes the Null backend's command streams when enabled
+	std::unique_ptr<SoftwareRasterizer> m_softwareRasterizer;
+	bool m_bSoftwareRasterization = false;
+
+	uint32_t m_width;
+	uint32_t m_height;
+	// Render scale of the current frame, set before the render graph is built
+	RHIViewport m_viewport;
+	RHIRect m_scissorRect;
+	DynamicResolutionController m_dynamicResolution;
+	bool m_bDynamicResolution = false;
+	RHIUpscaleFilter m_upscaleFilter = RHIUpscaleFilter::CatmullRom;
+	// From the end of frame pacing to the end of the frame, includes waits for the GPU
+	std::chrono::steady_clock::time_point m_frameWorkStart;
+	double m_lastFrameWorkSeconds = 0.0;
+
+	// App resource, dynamic data is written to the upload ring every frame
+	std::unique_ptr<UploadHeap> m_uploadHeap;
+	SceneVertex m_triangleVertices[3];
+
+	Camera m_camera;
+	LightList m_lights;
+	std::unique_ptr<ClusteredLightBinner> m_lightBinner;
+	CullingBounds m_objectBounds;
+	std::unique_ptr<FrustumCuller> m_frustumCuller;
+	std::vector<OccluderMesh> m_occluders;	// World space
+	std::unique_ptr<OcclusionCuller> m_occlusionCuller;
+	Float3 m_sunDirection = { 0.3f, -0.9f, 0.3f };
+	std::vector<ShadowedLight> m_shadowedLights;
+	std::unique_ptr<ShadowSetup> m_shadowSetup;
+	std::wstring m_probeVolumePath;
+	ProbeVolume m_probeVolume;	// Mapped, diffuse ambient
+	std::wstring m_lightmapPath;
+	Lightmap m_lightmap;		// Mapped, static diffuse lighting
+	std::wstring m_iblCachePath;
+	std::unique_ptr<IBLCache> m_iblCache;
+	IBLData m_environmentLighting;
+
+	// Synchronization objects, per frame command allocators and fence values
 	uint32_t m_frameIndex;
-	HANDLE m_fenceEvent;
-	ComPtr<ID3D12Fence> m_fenceObject;
-	uint64_t m_fenceValue;
+	uint32_t m_maxFramesInFlight;
+	std::unique_ptr<FramePipeline> m_framePipeline;
+	// Decides when frames start and how they are presented
+	std::unique_ptr<FramePacerClock> m_framePacerClock;
+	std::unique_ptr<FramePacer> m_framePacer;
+	FramePacingSettings m_framePacingSettings;
 
 	std::wstring m_assetsPath;
 	std::wstring m_title;
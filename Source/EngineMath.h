@@ -0,0 +1,182 @@
+#pragma once
+
+// Portable storage types, memory layout matches DirectX::XMFLOAT* so they can be uploaded as-is
+
+#include <algorithm>
+#include <cmath>
+
+struct Float2
+{
+	float x;
+	float y;
+};
+
+struct Float3
+{
+	float x;
+	float y;
+	float z;
+};
+
+struct Float4
+{
+	float x;
+	float y;
+	float z;
+	float w;
+};
+
+static_assert(sizeof(Float3) == 12, "Float3 should be tightly packed");
+static_assert(sizeof(Float4) == 16, "Float4 should be tightly packed");
+
+// Row major, row vectors (v' = v * M) like DirectXMath, so matrices can be uploaded to HLSL as-is
+struct Float4x4
+{
+	float m[4][4];
+};
+
+struct BoundingBox
+{
+	Float3 min;
+	Float3 max;
+};
+
+struct BoundingSphere
+{
+	Float3 center;
+	float radius;
+};
+
+// Small helpers for CPU side code outside of hot loops, throughput critical paths use SoA SIMD
+inline Float3 operator+(const Float3& a, const Float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Float3 operator-(const Float3& a, const Float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Float3 operator*(const Float3& a, float scale) { return { a.x * scale, a.y * scale, a.z * scale }; }
+inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float3 Cross(const Float3& a, const Float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+inline float Length(const Float3& a) { return std::sqrt(Dot(a, a)); }
+inline Float3 Normalize(const Float3& a) { return a * (1.0f / Length(a)); }
+inline Float3 Min(const Float3& a, const Float3& b) { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) }; }
+inline Float3 Max(const Float3& a, const Float3& b) { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) }; }
+
+inline Float4x4 MatrixIdentity()
+{
+	return { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+}
+
+inline Float4x4 MatrixMultiply(const Float4x4& a, const Float4x4& b)
+{
+	Float4x4 result;
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column] + a.m[row][2] * b.m[2][column] + a.m[row][3] * b.m[3][column];
+		}
+	}
+	return result;
+}
+
+// Left handed, +z forward, same as XMMatrixLookToLH
+inline Float4x4 MatrixLookToLH(const Float3& eye, const Float3& direction, const Float3& up)
+{
+	const Float3 zAxis = Normalize(direction);
+	const Float3 xAxis = Normalize(Cross(up, zAxis));
+	const Float3 yAxis = Cross(zAxis, xAxis);
+	return { {
+		{ xAxis.x, yAxis.x, zAxis.x, 0.0f },
+		{ xAxis.y, yAxis.y, zAxis.y, 0.0f },
+		{ xAxis.z, yAxis.z, zAxis.z, 0.0f },
+		{ -Dot(xAxis, eye), -Dot(yAxis, eye), -Dot(zAxis, eye), 1.0f } } };
+}
+
+// Depth 0 at nearZ and 1 at farZ, same as XMMatrixPerspectiveFovLH
+inline Float4x4 MatrixPerspectiveFovLH(float fovY, float aspectRatio, float nearZ, float farZ)
+{
+	const float yScale = 1.0f / std::tan(fovY * 0.5f);
+	const float xScale = yScale / aspectRatio;
+	const float zRange = farZ / (farZ - nearZ);
+	return { {
+		{ xScale, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, yScale, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, zRange, 1.0f },
+		{ 0.0f, 0.0f, -nearZ * zRange, 0.0f } } };
+}
+
+// Depth 0 at nearZ and 1 at farZ, same as XMMatrixOrthographicOffCenterLH
+inline Float4x4 MatrixOrthographicOffCenterLH(float left, float right, float bottom, float top, float nearZ, float farZ)
+{
+	const float width = 1.0f / (right - left);
+	const float height = 1.0f / (top - bottom);
+	const float range = 1.0f / (farZ - nearZ);
+	return { {
+		{ 2.0f * width, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 2.0f * height, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, range, 0.0f },
+		{ -(left + right) * width, -(top + bottom) * height, -nearZ * range, 1.0f } } };
+}
+
+// Last column must be (0, 0, 0, 1)
+inline Float4x4 MatrixInverseAffine(const Float4x4& matrix)
+{
+	const float (&m)[4][4] = matrix.m;
+	const float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	const float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	const float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	const float inverseDeterminant = 1.0f / (m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02);
+	Float4x4 result = { { {
+		c00 * inverseDeterminant,
+		(m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inverseDeterminant,
+		(m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inverseDeterminant,
+		0.0f }, {
+		c01 * inverseDeterminant,
+		(m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inverseDeterminant,
+		(m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inverseDeterminant,
+		0.0f }, {
+		c02 * inverseDeterminant,
+		(m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inverseDeterminant,
+		(m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inverseDeterminant,
+		0.0f }, {
+		0.0f, 0.0f, 0.0f, 1.0f } } };
+	for (int column = 0; column < 3; column++)
+	{
+		result.m[3][column] = -(m[3][0] * result.m[0][column] + m[3][1] * result.m[1][column] + m[3][2] * result.m[2][column]);
+	}
+	return result;
+}
+
+inline Float4 Transform(const Float4& v, const Float4x4& matrix)
+{
+	return {
+		v.x * matrix.m[0][0] + v.y * matrix.m[1][0] + v.z * matrix.m[2][0] + v.w * matrix.m[3][0],
+		v.x * matrix.m[0][1] + v.y * matrix.m[1][1] + v.z * matrix.m[2][1] + v.w * matrix.m[3][1],
+		v.x * matrix.m[0][2] + v.y * matrix.m[1][2] + v.z * matrix.m[2][2] + v.w * matrix.m[3][2],
+		v.x * matrix.m[0][3] + v.y * matrix.m[1][3] + v.z * matrix.m[2][3] + v.w * matrix.m[3][3] };
+}
+
+// w = 1, affine matrices only
+inline Float3 TransformPoint(const Float3& point, const Float4x4& matrix)
+{
+	const Float4 result = Transform({ point.x, point.y, point.z, 1.0f }, matrix);
+	return { result.x, result.y, result.z };
+}
+
+inline Float3 TransformVector(const Float3& vector, const Float4x4& matrix)
+{
+	const Float4 result = Transform({ vector.x, vector.y, vector.z, 0.0f }, matrix);
+	return { result.x, result.y, result.z };
+}
+
+// Box around the transformed box, from the transformed center and extent (Arvo). Affine matrices only
+inline BoundingBox TransformBounds(const BoundingBox& box, const Float4x4& matrix)
+{
+	const Float3 center = TransformPoint((box.min + box.max) * 0.5f, matrix);
+	const Float3 extent = (box.max - box.min) * 0.5f;
+	const float (&m)[4][4] = matrix.m;
+	const Float3 worldExtent =
+	{
+		std::fabs(m[0][0]) * extent.x + std::fabs(m[1][0]) * extent.y + std::fabs(m[2][0]) * extent.z,
+		std::fabs(m[0][1]) * extent.x + std::fabs(m[1][1]) * extent.y + std::fabs(m[2][1]) * extent.z,
+		std::fabs(m[0][2]) * extent.x + std::fabs(m[1][2]) * extent.y + std::fabs(m[2][2]) * extent.z,
+	};
+	return { center - worldExtent, center + worldExtent };
+}
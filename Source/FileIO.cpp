@@ -0,0 +1,387 @@
+#include "FileIO.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#if !defined(_WIN32)
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+#endif
+
+namespace
+{
+	int32_t GetLastErrorCode()
+	{
+#if defined(_WIN32)
+		return int32_t(GetLastError());
+#else
+		return errno;
+#endif
+	}
+
+	std::string GetErrorMessage(int32_t errorCode)
+	{
+#if defined(_WIN32)
+		char message[256]{};
+		FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, DWORD(errorCode), 0, message, sizeof(message), nullptr);
+		return message;
+#else
+		return strerror(errorCode);
+#endif
+	}
+
+	// Single OS calls are limited to 32 bit sizes on Windows and ~2 GB on Linux
+	constexpr uint64_t MaxIoSize = 1ull << 30;
+
+#if defined(_WIN32)
+	constexpr int32_t EndOfFileError = ERROR_HANDLE_EOF;
+#else
+	constexpr int32_t EndOfFileError = EIO;
+#endif
+}
+
+FileIOException::FileIOException(const std::wstring& fileName, const char* operation, int32_t errorCode)
+	: std::runtime_error(std::string(operation) + " failed for " + std::filesystem::path(fileName).string() + ": " + GetErrorMessage(errorCode))
+	, m_errorCode(errorCode)
+{
+}
+
+File::File(File&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+File& File::operator=(File&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(m_fileName, other.m_fileName);
+		std::swap(m_size, other.m_size);
+		std::swap(m_file, other.m_file);
+	}
+	return *this;
+}
+
+void File::Open(const std::wstring& fileName)
+{
+	Close();
+	m_fileName = fileName;
+
+#if defined(_WIN32)
+	m_file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		throw FileIOException(fileName, "Open", GetLastErrorCode());
+	}
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(m_file, &fileSize))
+	{
+		const int32_t errorCode = GetLastErrorCode();
+		Close();
+		throw FileIOException(fileName, "GetFileSizeEx", errorCode);
+	}
+	m_size = uint64_t(fileSize.QuadPart);
+#else
+	m_file = open(std::filesystem::path(fileName).c_str(), O_RDONLY);
+	if (m_file < 0)
+	{
+		throw FileIOException(fileName, "Open", GetLastErrorCode());
+	}
+	struct stat fileStat{};
+	if (fstat(m_file, &fileStat) != 0)
+	{
+		const int32_t errorCode = GetLastErrorCode();
+		Close();
+		throw FileIOException(fileName, "fstat", errorCode);
+	}
+	m_size = uint64_t(fileStat.st_size);
+#endif
+}
+
+void File::Create(const std::wstring& fileName)
+{
+	Close();
+	m_fileName = fileName;
+
+#if defined(_WIN32)
+	m_file = CreateFileW(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+#else
+	m_file = open(std::filesystem::path(fileName).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (m_file < 0)
+#endif
+	{
+		throw FileIOException(fileName, "Create", GetLastErrorCode());
+	}
+	m_size = 0;
+}
+
+void File::Close()
+{
+#if defined(_WIN32)
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_file >= 0)
+	{
+		close(m_file);
+	}
+	m_file = -1;
+#endif
+	m_size = 0;
+}
+
+bool File::IsOpen() const
+{
+#if defined(_WIN32)
+	return m_file != INVALID_HANDLE_VALUE;
+#else
+	return m_file >= 0;
+#endif
+}
+
+void File::ReadAt(uint64_t offset, void* pDestination, uint64_t size) const
+{
+	uint8_t* pBytes = static_cast<uint8_t*>(pDestination);
+	while (size > 0)
+	{
+		const uint64_t ioSize = std::min(size, MaxIoSize);
+#if defined(_WIN32)
+		// Positional read on a synchronous handle, several threads may read the same file
+		OVERLAPPED overlapped{};
+		overlapped.Offset = DWORD(offset);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+		DWORD numBytesRead = 0;
+		if (!ReadFile(m_file, pBytes, DWORD(ioSize), &numBytesRead, &overlapped))
+		{
+			throw FileIOException(m_fileName, "ReadFile", GetLastErrorCode());
+		}
+		const uint64_t bytesRead = numBytesRead;
+#else
+		const ssize_t result = pread(m_file, pBytes, size_t(ioSize), off_t(offset));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw FileIOException(m_fileName, "pread", GetLastErrorCode());
+		}
+		const uint64_t bytesRead = uint64_t(result);
+#endif
+		if (bytesRead == 0)
+		{
+			// Past the end of the file
+			throw FileIOException(m_fileName, "Read", EndOfFileError);
+		}
+		pBytes += bytesRead;
+		offset += bytesRead;
+		size -= bytesRead;
+	}
+}
+
+void File::WriteAt(uint64_t offset, const void* pSource, uint64_t size)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pSource);
+	while (size > 0)
+	{
+		const uint64_t ioSize = std::min(size, MaxIoSize);
+#if defined(_WIN32)
+		OVERLAPPED overlapped{};
+		overlapped.Offset = DWORD(offset);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+		DWORD numBytesWritten = 0;
+		if (!WriteFile(m_file, pBytes, DWORD(ioSize), &numBytesWritten, &overlapped))
+		{
+			throw FileIOException(m_fileName, "WriteFile", GetLastErrorCode());
+		}
+		const uint64_t bytesWritten = numBytesWritten;
+#else
+		const ssize_t result = pwrite(m_file, pBytes, size_t(ioSize), off_t(offset));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw FileIOException(m_fileName, "pwrite", GetLastErrorCode());
+		}
+		const uint64_t bytesWritten = uint64_t(result);
+#endif
+		pBytes += bytesWritten;
+		offset += bytesWritten;
+		size -= bytesWritten;
+		m_size = std::max(m_size, offset);
+	}
+}
+
+std::vector<uint8_t> ReadWholeFile(const std::wstring& fileName)
+{
+	File file;
+	file.Open(fileName);
+	std::vector<uint8_t> data(size_t(file.GetSize()));
+	file.ReadAt(0, data.data(), data.size());
+	return data;
+}
+
+void WriteFileAtomically(const std::wstring& fileName, const void* pData, size_t size)
+{
+	std::filesystem::path tempPath = fileName;
+	tempPath += "." + HashToString(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		File file;
+		file.Create(tempPath.wstring());
+		file.WriteAt(0, pData, size);
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, fileName, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		throw FileIOException(fileName, "Rename", error.value());
+	}
+}
+
+AsyncFileReader::AsyncFileReader(uint32_t numThreads, uint64_t chunkSize)
+	: m_chunkSize(std::max<uint64_t>(chunkSize, 4096))
+{
+	for (uint32_t i = 0; i < std::max(numThreads, 1u); i++)
+	{
+		m_threads.emplace_back(&AsyncFileReader::IoThreadMain, this);
+	}
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bExit = true;
+	}
+	m_requestAvailable.notify_all();
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+std::future<void> AsyncFileReader::ReadAsync(const File& file, uint64_t offset, uint64_t size, void* pDestination)
+{
+	std::shared_ptr<ReadBatch> batch = std::make_shared<ReadBatch>();
+	std::future<void> future = batch->promise.get_future();
+
+	const uint32_t numChunks = uint32_t((size + m_chunkSize - 1) / m_chunkSize);
+	if (numChunks == 0)
+	{
+		batch->promise.set_value();
+		return future;
+	}
+	batch->numRemainingChunks = numChunks;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (uint64_t chunkOffset = 0; chunkOffset < size; chunkOffset += m_chunkSize)
+		{
+			m_requests.push_back({ &file, offset + chunkOffset, std::min(m_chunkSize, size - chunkOffset), static_cast<uint8_t*>(pDestination) + chunkOffset, batch });
+		}
+	}
+	m_requestAvailable.notify_all();
+	return future;
+}
+
+void AsyncFileReader::Stream(const File& file, uint64_t offset, uint64_t size, const std::function<void(uint64_t, const uint8_t*, uint64_t)>& consume, uint32_t numBuffers)
+{
+	numBuffers = std::max(numBuffers, 2u);
+	std::vector<std::vector<uint8_t>> buffers(numBuffers);
+	std::vector<std::future<void>> reads(numBuffers);
+	const uint64_t numChunks = (size + m_chunkSize - 1) / m_chunkSize;
+
+	auto issue = [&](uint64_t chunk)
+	{
+		const uint64_t chunkOffset = chunk * m_chunkSize;
+		std::vector<uint8_t>& buffer = buffers[chunk % numBuffers];
+		buffer.resize(size_t(std::min(m_chunkSize, size - chunkOffset)));
+		reads[chunk % numBuffers] = ReadAsync(file, offset + chunkOffset, buffer.size(), buffer.data());
+	};
+
+	for (uint64_t chunk = 0; chunk < std::min<uint64_t>(numBuffers, numChunks); chunk++)
+	{
+		issue(chunk);
+	}
+	for (uint64_t chunk = 0; chunk < numChunks; chunk++)
+	{
+		const uint32_t slot = uint32_t(chunk % numBuffers);
+		try
+		{
+			reads[slot].get();
+			consume(chunk * m_chunkSize, buffers[slot].data(), buffers[slot].size());
+		}
+		catch (...)
+		{
+			// Buffers are owned by this frame, reads still in flight must finish first
+			for (std::future<void>& read : reads)
+			{
+				if (read.valid())
+				{
+					read.wait();
+				}
+			}
+			throw;
+		}
+		if (chunk + numBuffers < numChunks)
+		{
+			issue(chunk + numBuffers);
+		}
+	}
+}
+
+void AsyncFileReader::IoThreadMain()
+{
+	for (;;)
+	{
+		ChunkRequest request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_requestAvailable.wait(lock, [this] { return m_bExit || !m_requests.empty(); });
+			if (m_requests.empty())
+			{
+				return;
+			}
+			request = std::move(m_requests.front());
+			m_requests.pop_front();
+		}
+
+		try
+		{
+			request.pFile->ReadAt(request.offset, request.pDestination, request.size);
+			m_statistics.bytesRead += request.size;
+			m_statistics.chunksRead++;
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(request.batch->errorMutex);
+			if (!request.batch->error)
+			{
+				request.batch->error = std::current_exception();
+			}
+		}
+
+		if (--request.batch->numRemainingChunks == 0)
+		{
+			if (request.batch->error)
+			{
+				request.batch->promise.set_exception(request.batch->error);
+			}
+			else
+			{
+				request.batch->promise.set_value();
+			}
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+// Portable file access
+// File does positional, thread safe reads without a 4 GB limit, AsyncFileReader splits large reads into chunks
+// serviced by I/O threads so data can land directly in its final place (e.g. upload memory).
+// Memory mapped access is in FileView.h.
+
+#include "Platform.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Carries the path and the OS error message
+class FileIOException : public std::runtime_error
+{
+public:
+	FileIOException(const std::wstring& fileName, const char* operation, int32_t errorCode);
+
+	int32_t GetErrorCode() const { return m_errorCode; }
+
+private:
+	int32_t m_errorCode;
+};
+
+class File
+{
+public:
+	File() {}
+	~File() { Close(); }
+
+	File(File&& other) noexcept;
+	File& operator=(File&& other) noexcept;
+	File(const File&) = delete;
+	File& operator=(const File&) = delete;
+
+	// Throw FileIOException on failure
+	void Open(const std::wstring& fileName);
+	void Create(const std::wstring& fileName);
+	void Close();
+
+	bool IsOpen() const;
+	uint64_t GetSize() const { return m_size; }
+	const std::wstring& GetFileName() const { return m_fileName; }
+
+	// Thread safe, independent of any file position. Throws if fewer than `size` bytes are available
+	void ReadAt(uint64_t offset, void* pDestination, uint64_t size) const;
+	void WriteAt(uint64_t offset, const void* pSource, uint64_t size);
+
+private:
+	std::wstring	m_fileName;
+	uint64_t		m_size = 0;
+#if defined(_WIN32)
+	HANDLE			m_file = INVALID_HANDLE_VALUE;
+#else
+	int				m_file = -1;
+#endif
+};
+
+// Whole file into memory, for small files. Prefer FileView for anything parsed in place
+std::vector<uint8_t> ReadWholeFile(const std::wstring& fileName);
+// To a temporary file next to `fileName`, then renamed over it, readers never see a partial file.
+// The temporary name is unique per thread, so threads may write the same file concurrently. Throws FileIOException
+void WriteFileAtomically(const std::wstring& fileName, const void* pData, size_t size);
+
+struct AsyncFileReaderStatistics
+{
+	std::atomic<uint64_t> bytesRead = 0;
+	std::atomic<uint64_t> chunksRead = 0;
+};
+
+class AsyncFileReader
+{
+public:
+	enum : uint64_t { DefaultChunkSize = 4 * 1024 * 1024 };
+
+	// Each I/O thread keeps one chunk read in flight
+	explicit AsyncFileReader(uint32_t numThreads = 2, uint64_t chunkSize = DefaultChunkSize);
+	~AsyncFileReader();
+
+	// Reads [offset, offset + size) into `pDestination` in chunks. `file` and the destination must stay valid until
+	// the future is ready, the future rethrows the first FileIOException
+	std::future<void> ReadAsync(const File& file, uint64_t offset, uint64_t size, void* pDestination);
+
+	// Streams [offset, offset + size) in order through `consume(offset, pData, size)` on the calling thread.
+	// Up to `numBuffers` chunks are read ahead while the previous ones are consumed
+	void Stream(const File& file, uint64_t offset, uint64_t size, const std::function<void(uint64_t, const uint8_t*, uint64_t)>& consume, uint32_t numBuffers = 3);
+
+	uint64_t GetChunkSize() const { return m_chunkSize; }
+	const AsyncFileReaderStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+	struct ReadBatch
+	{
+		std::atomic<uint32_t>	numRemainingChunks = 0;
+		std::mutex				errorMutex;
+		std::exception_ptr		error;
+		std::promise<void>		promise;
+	};
+
+	struct ChunkRequest
+	{
+		const File*					pFile;
+		uint64_t					offset;
+		uint64_t					size;
+		uint8_t*					pDestination;
+		std::shared_ptr<ReadBatch>	batch;
+	};
+
+	void IoThreadMain();
+
+	uint64_t							m_chunkSize;
+	std::vector<std::thread>			m_threads;
+	std::mutex							m_mutex;
+	std::condition_variable				m_requestAvailable;
+	std::deque<ChunkRequest>			m_requests;
+	bool								m_bExit = false;
+
+	AsyncFileReaderStatistics			m_statistics;
+};
@@ -0,0 +1,193 @@
+#include "FileView.h"
+#include "FileIO.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <utility>
+
+#if !defined(_WIN32)
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+FileView::FileView(FileView&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+FileView& FileView::operator=(FileView&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(m_pData, other.m_pData);
+		std::swap(m_size, other.m_size);
+		std::swap(m_bOpen, other.m_bOpen);
+		std::swap(m_file, other.m_file);
+#if defined(_WIN32)
+		std::swap(m_mapping, other.m_mapping);
+#endif
+	}
+	return *this;
+}
+
+bool FileView::Open(const std::wstring& fileName)
+{
+	const char* pFailedOperation = nullptr;
+	return OpenImpl(fileName, pFailedOperation);
+}
+
+void FileView::OpenOrThrow(const std::wstring& fileName)
+{
+	const char* pFailedOperation = nullptr;
+	if (!OpenImpl(fileName, pFailedOperation))
+	{
+#if defined(_WIN32)
+		throw FileIOException(fileName, pFailedOperation, int32_t(GetLastError()));
+#else
+		throw FileIOException(fileName, pFailedOperation, errno);
+#endif
+	}
+}
+
+bool FileView::OpenImpl(const std::wstring& fileName, const char*& pFailedOperation)
+{
+	Close();
+
+#if defined(_WIN32)
+	m_file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		pFailedOperation = "CreateFileW";
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(m_file, &fileSize))
+	{
+		pFailedOperation = "GetFileSizeEx";
+		CloseKeepError();
+		return false;
+	}
+	m_size = uint64_t(fileSize.QuadPart);
+
+	// Mapping a zero sized file fails, nothing to map anyway
+	if (m_size > 0)
+	{
+		m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mapping == nullptr)
+		{
+			pFailedOperation = "CreateFileMappingW";
+			CloseKeepError();
+			return false;
+		}
+		m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		if (m_pData == nullptr)
+		{
+			pFailedOperation = "MapViewOfFile";
+			CloseKeepError();
+			return false;
+		}
+	}
+#else
+	const std::string path = std::filesystem::path(fileName).string();
+	m_file = open(path.c_str(), O_RDONLY);
+	if (m_file < 0)
+	{
+		pFailedOperation = "open";
+		return false;
+	}
+
+	struct stat fileStat{};
+	if (fstat(m_file, &fileStat) != 0)
+	{
+		pFailedOperation = "fstat";
+		CloseKeepError();
+		return false;
+	}
+	m_size = uint64_t(fileStat.st_size);
+
+	if (m_size > 0)
+	{
+		void* pData = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+		if (pData == MAP_FAILED)
+		{
+			pFailedOperation = "mmap";
+			CloseKeepError();
+			return false;
+		}
+		m_pData = static_cast<const uint8_t*>(pData);
+	}
+#endif
+
+	m_bOpen = true;
+	return true;
+}
+
+void FileView::CloseKeepError()
+{
+	// Closing handles may overwrite the error of the failed call
+#if defined(_WIN32)
+	const DWORD error = GetLastError();
+	Close();
+	SetLastError(error);
+#else
+	const int error = errno;
+	Close();
+	errno = error;
+#endif
+}
+
+void FileView::Prefetch(uint64_t offset, uint64_t size) const
+{
+	if (m_pData == nullptr || offset >= m_size)
+	{
+		return;
+	}
+	size = std::min(size, m_size - offset);
+#if defined(_WIN32)
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<uint8_t*>(m_pData + offset), SIZE_T(size) };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// madvise wants page aligned addresses
+	const uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+	const uintptr_t begin = reinterpret_cast<uintptr_t>(m_pData + offset) & ~(pageSize - 1);
+	const uintptr_t end = reinterpret_cast<uintptr_t>(m_pData + offset + size);
+	madvise(reinterpret_cast<void*>(begin), size_t(end - begin), MADV_WILLNEED);
+#endif
+}
+
+void FileView::Close()
+{
+#if defined(_WIN32)
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData)
+	{
+		munmap(const_cast<uint8_t*>(m_pData), m_size);
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+	}
+	m_file = -1;
+#endif
+	m_pData = nullptr;
+	m_size = 0;
+	m_bOpen = false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Read-only memory mapped view of a whole file (mmap on Linux, file mapping on Windows)
+
+#include "Platform.h"
+
+class FileView
+{
+public:
+	FileView() {}
+	~FileView() { Close(); }
+
+	FileView(FileView&& other) noexcept;
+	FileView& operator=(FileView&& other) noexcept;
+	FileView(const FileView&) = delete;
+	FileView& operator=(const FileView&) = delete;
+
+	// Returns false if the file can not be opened, an empty file is a valid view of size 0
+	bool Open(const std::wstring& fileName);
+	// Same as Open() but throws FileIOException with the OS error
+	void OpenOrThrow(const std::wstring& fileName);
+	void Close();
+
+	// Hint to start paging in a range ahead of access, e.g. the next chunk of a sequential parse
+	void Prefetch(uint64_t offset, uint64_t size) const;
+
+	bool IsOpen() const { return m_bOpen; }
+	const uint8_t* GetData() const { return m_pData; }
+	uint64_t GetSize() const { return m_size; }
+
+private:
+	bool OpenImpl(const std::wstring& fileName, const char*& pFailedOperation);
+	void CloseKeepError();
+
+	const uint8_t*	m_pData = nullptr;
+	uint64_t		m_size = 0;
+	bool			m_bOpen = false;
+#if defined(_WIN32)
+	HANDLE			m_file = INVALID_HANDLE_VALUE;
+	HANDLE			m_mapping = nullptr;
+#else
+	int				m_file = -1;
+#endif
+};
@@ -0,0 +1,362 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+const char* GetPresentModeName(PresentMode mode)
+{
+	switch (mode)
+	{
+	case PresentMode::Vsync:			return "Vsync";
+	case PresentMode::Uncapped:			return "Uncapped";
+	case PresentMode::LatencyWaitable:	return "LatencyWaitable";
+	case PresentMode::FrameCap:			return "FrameCap";
+	default:							return "Unknown";
+	}
+}
+
+void FrameTimeHistogram::Add(double seconds)
+{
+	seconds = std::max(seconds, 0.0);
+	const uint32_t bucket = uint32_t(std::min(seconds / BucketSeconds, double(NumBuckets - 1)));
+	m_buckets[bucket]++;
+	m_minSeconds = m_count ? std::min(m_minSeconds, seconds) : seconds;
+	m_maxSeconds = std::max(m_maxSeconds, seconds);
+	m_totalSeconds += seconds;
+	m_count++;
+}
+
+double FrameTimeHistogram::GetPercentileSeconds(double percentile) const
+{
+	if (m_count == 0)
+	{
+		return 0.0;
+	}
+	const uint64_t rank = std::max<uint64_t>(uint64_t(std::ceil(percentile / 100.0 * double(m_count))), 1);
+	uint64_t count = 0;
+	for (uint32_t bucket = 0; bucket < NumBuckets; bucket++)
+	{
+		count += m_buckets[bucket];
+		if (count >= rank)
+		{
+			// The last bucket has no upper edge
+			return bucket == NumBuckets - 1 ? m_maxSeconds : std::min(double(bucket + 1) * BucketSeconds, m_maxSeconds);
+		}
+	}
+	return m_maxSeconds;
+}
+
+std::string FrameTimeHistogram::Format(const char* title) const
+{
+	enum { BarWidth = 40 };
+
+	std::string text;
+	char line[160];
+	snprintf(line, sizeof(line), "%s: %llu samples, avg %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", title, (unsigned long long)m_count,
+		GetMeanSeconds() * 1e3, GetPercentileSeconds(50.0) * 1e3, GetPercentileSeconds(99.0) * 1e3, m_maxSeconds * 1e3);
+	text += line;
+
+	const uint64_t largest = *std::max_element(m_buckets, m_buckets + NumBuckets);
+	for (uint32_t bucket = 0; bucket < NumBuckets; bucket++)
+	{
+		if (m_buckets[bucket] == 0)
+		{
+			continue;
+		}
+		const std::string bar(size_t((m_buckets[bucket] * BarWidth + largest - 1) / largest), '#');
+		if (bucket == NumBuckets - 1)
+		{
+			snprintf(line, sizeof(line), "     >%6.2f ms %-*s %llu\n", bucket * BucketSeconds * 1e3, int(BarWidth), bar.c_str(), (unsigned long long)m_buckets[bucket]);
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "  %6.2f-%6.2f ms %-*s %llu\n", bucket * BucketSeconds * 1e3, (bucket + 1) * BucketSeconds * 1e3, int(BarWidth), bar.c_str(),
+				(unsigned long long)m_buckets[bucket]);
+		}
+		text += line;
+	}
+	return text;
+}
+
+RealFramePacerClock::RealFramePacerClock()
+	: m_origin(std::chrono::steady_clock::now())
+{
+#if defined(_WIN32) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+	// Windows 10 1803 and later, older versions fall back to Sleep() at the system timer resolution
+	m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+}
+
+RealFramePacerClock::~RealFramePacerClock()
+{
+#if defined(_WIN32)
+	if (m_timer)
+	{
+		CloseHandle(m_timer);
+	}
+#endif
+}
+
+double RealFramePacerClock::Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_origin).count();
+}
+
+void RealFramePacerClock::SleepOneMillisecond()
+{
+#if defined(_WIN32)
+	if (m_timer)
+	{
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -10000;	// Relative, 100 ns units
+		SetWaitableTimerEx(m_timer, &dueTime, 0, nullptr, nullptr, nullptr, 0);
+		WaitForSingleObject(m_timer, INFINITE);
+		return;
+	}
+	Sleep(1);
+#else
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+}
+
+void RealFramePacerClock::SleepUntil(double time)
+{
+	while (time - Now() > m_sleepEstimate)
+	{
+		const double start = Now();
+		SleepOneMillisecond();
+		const double observed = Now() - start;
+
+		// Welford's running variance of the observed sleep lengths
+		m_numSleeps++;
+		const double delta = observed - m_sleepMean;
+		m_sleepMean += delta / double(m_numSleeps);
+		m_sleepM2 += delta * (observed - m_sleepMean);
+		m_sleepEstimate = m_sleepMean + std::sqrt(m_sleepM2 / double(m_numSleeps - 1));
+	}
+	while (Now() < time)
+	{
+		std::this_thread::yield();
+	}
+}
+
+SimulatedFramePacerClock::SimulatedFramePacerClock(bool bFollowRealTime)
+	: m_bFollowRealTime(bFollowRealTime)
+	, m_lastRealTime(std::chrono::steady_clock::now())
+{
+}
+
+double SimulatedFramePacerClock::Now()
+{
+	if (m_bFollowRealTime)
+	{
+		const std::chrono::steady_clock::time_point realTime = std::chrono::steady_clock::now();
+		m_time += std::chrono::duration<double>(realTime - m_lastRealTime).count();
+		m_lastRealTime = realTime;
+	}
+	return m_time;
+}
+
+void SimulatedFramePacerClock::SleepUntil(double time)
+{
+	const double now = Now();
+	if (time > now)
+	{
+		m_sleptSeconds += time - now;
+		m_time = time;
+	}
+}
+
+FramePacer::FramePacer(FramePacerClock* pClock, const FramePacingSettings& settings)
+	: m_pClock(pClock)
+	, m_settings(settings)
+	, m_pendingSettings(settings)
+{
+}
+
+void FramePacer::SetSettings(const FramePacingSettings& settings)
+{
+	m_pendingSettings = settings;
+	m_bSettingsChanged = true;
+}
+
+void FramePacer::SetSwapChain(RHISwapChain* pSwapChain)
+{
+	m_pSwapChain = pSwapChain;
+	m_bTearingSupported = pSwapChain ? pSwapChain->IsTearingSupported() : true;
+	m_bSettingsChanged = true;
+}
+
+void FramePacer::ApplySettings()
+{
+	if (m_pendingSettings.mode != m_settings.mode || m_pendingSettings.frameCapRate != m_settings.frameCapRate)
+	{
+		m_nextCappedStart = 0.0;
+	}
+	m_settings = m_pendingSettings;
+	m_settings.refreshRate = std::max(m_settings.refreshRate, 1.0);
+	m_settings.frameCapRate = std::max(m_settings.frameCapRate, 1.0);
+	m_settings.maxFrameLatency = std::max(m_settings.maxFrameLatency, 1u);
+	if (m_pSwapChain)
+	{
+		m_pSwapChain->SetMaximumFrameLatency(m_settings.mode == PresentMode::LatencyWaitable ? m_settings.maxFrameLatency : uint32_t(FramePacerDefaultFrameLatency));
+	}
+	m_bSettingsChanged = false;
+}
+
+double FramePacer::GetNextVblank(double time) const
+{
+	const double refreshInterval = 1.0 / m_settings.refreshRate;
+	return std::ceil(time / refreshInterval) * refreshInterval;
+}
+
+void FramePacer::RetireDisplayedFrames(double time)
+{
+	while (!m_queuedScanouts.empty() && m_queuedScanouts.front() <= time)
+	{
+		m_queuedScanouts.pop_front();
+	}
+}
+
+uint32_t FramePacer::GetQueuedFrames()
+{
+	RetireDisplayedFrames(m_pClock->Now());
+	return uint32_t(m_queuedScanouts.size());
+}
+
+void FramePacer::BeginFrame()
+{
+	if (m_bSettingsChanged)
+	{
+		ApplySettings();
+	}
+
+	const double requestTime = m_pClock->Now();
+	bool bWaited = false;
+	if (m_pSwapChain)
+	{
+		// The display queue is real, the swap chain blocks until it has room
+		m_pSwapChain->WaitForFrameLatency();
+		bWaited = m_pClock->Now() - requestTime > 50e-6;
+	}
+	else
+	{
+		// Modeled queue, Present(0) frames never wait in it
+		uint32_t maxQueuedFrames = ~0u;
+		if (m_settings.mode == PresentMode::Vsync)
+		{
+			maxQueuedFrames = FramePacerDefaultFrameLatency;
+		}
+		else if (m_settings.mode == PresentMode::LatencyWaitable)
+		{
+			maxQueuedFrames = m_settings.maxFrameLatency;
+		}
+		RetireDisplayedFrames(requestTime);
+		if (m_queuedScanouts.size() >= maxQueuedFrames)
+		{
+			// Room once enough of the oldest frames started scanning out
+			m_pClock->SleepUntil(m_queuedScanouts[m_queuedScanouts.size() - maxQueuedFrames]);
+			bWaited = true;
+		}
+	}
+
+	if (m_settings.mode == PresentMode::FrameCap)
+	{
+		const double period = 1.0 / m_settings.frameCapRate;
+		const double now = m_pClock->Now();
+		// A frame late by a whole period restarts the cadence, catching up would burst frames
+		if (m_nextCappedStart == 0.0 || now > m_nextCappedStart + period)
+		{
+			m_nextCappedStart = now;
+		}
+		if (m_nextCappedStart > now)
+		{
+			m_pClock->SleepUntil(m_nextCappedStart);
+			bWaited = true;
+		}
+		m_nextCappedStart += period;
+	}
+
+	const double frameStart = m_pClock->Now();
+	if (bWaited)
+	{
+		m_statistics.numThrottledFrames++;
+		m_statistics.throttleSeconds += frameStart - requestTime;
+	}
+	if (!m_bFirstFrame)
+	{
+		m_statistics.frameTimes.Add(frameStart - m_frameStart);
+	}
+	m_frameStart = frameStart;
+	m_bFirstFrame = false;
+}
+
+FramePresent FramePacer::GetPresent() const
+{
+	if (m_settings.mode == PresentMode::Vsync || m_settings.mode == PresentMode::LatencyWaitable)
+	{
+		return { 1, RHIPresentFlagNone };
+	}
+	return { 0, m_bTearingSupported ? uint32_t(RHIPresentFlagAllowTearing) : uint32_t(RHIPresentFlagNone) };
+}
+
+void FramePacer::EndFrame()
+{
+	const double presentTime = m_pClock->Now();
+	RetireDisplayedFrames(presentTime);
+
+	const FramePresent present = GetPresent();
+	double scanout;
+	if (present.syncInterval > 0)
+	{
+		// Flip queue, one frame per vblank at most
+		scanout = std::max(GetNextVblank(presentTime), m_lastScanout + double(present.syncInterval) / m_settings.refreshRate);
+	}
+	else if (present.flags & RHIPresentFlagAllowTearing)
+	{
+		// Scanout switches buffers mid frame, after anything still queued
+		scanout = std::max(presentTime, m_lastScanout);
+	}
+	else
+	{
+		// Flip model without tearing, the newest frame replaces those waiting for the same vblank
+		scanout = std::max(GetNextVblank(presentTime), m_lastScanout);
+		while (!m_queuedScanouts.empty() && m_queuedScanouts.back() >= scanout)
+		{
+			m_queuedScanouts.pop_back();
+		}
+	}
+	if (scanout > presentTime)
+	{
+		m_queuedScanouts.push_back(scanout);
+	}
+	m_lastScanout = scanout;
+
+	m_lastLatency = scanout - m_frameStart;
+	m_statistics.latencies.Add(m_lastLatency);
+	m_statistics.maxQueuedFrames = std::max(m_statistics.maxQueuedFrames, uint32_t(m_queuedScanouts.size()));
+	m_statistics.numFrames++;
+}
+
+void FramePacer::ResetStatistics()
+{
+	m_statistics = {};
+	m_bFirstFrame = true;
+}
+
+std::string FramePacer::FormatReport() const
+{
+	std::string report;
+	char line[200];
+	const double averageFrameTime = m_statistics.frameTimes.GetMeanSeconds();
+	snprintf(line, sizeof(line), "Present mode %s, %.1f Hz display, %llu frames at %.1f fps\n", GetPresentModeName(m_settings.mode), m_settings.refreshRate,
+		(unsigned long long)m_statistics.numFrames, averageFrameTime > 0.0 ? 1.0 / averageFrameTime : 0.0);
+	report += line;
+	snprintf(line, sizeof(line), "Throttled %llu frames for %.3f s, up to %u frames queued\n", (unsigned long long)m_statistics.numThrottledFrames,
+		m_statistics.throttleSeconds, m_statistics.maxQueuedFrames);
+	report += line;
+	report += m_statistics.frameTimes.Format("Frame time");
+	report += m_statistics.latencies.Format("Latency");
+	return report;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+// Frame pacing and present policies
+// FramePacer decides when a frame may start and how it is presented. It models the display's flip queue, frames
+// waiting for a vblank, to bound latency and to measure it: latency is the time from the start of a frame, where
+// input is sampled, to the modeled start of its scanout. Time comes from a FramePacerClock, so the headless
+// backend drives the same logic with a simulated display clock instead of real waits.
+// With a real swap chain the waits are the swap chain's, the model only measures, and since its vblanks are not
+// synchronized to the display the latencies are estimates within one refresh.
+
+#include "RHI.h"
+
+#include <chrono>
+#include <deque>
+
+enum class PresentMode : uint8_t
+{
+	Vsync,				// Present(1), the flip queue fills up to FramePacerDefaultFrameLatency frames
+	Uncapped,			// Present(0) with tearing where supported, frames never wait
+	LatencyWaitable,	// Present(1), a frame starts only once fewer than maxFrameLatency frames are queued
+	FrameCap,			// Present(0) with tearing, frames start on a fixed cadence with a precise sleep
+};
+
+enum : uint32_t
+{
+	FramePacerDefaultFrameLatency = 3,	// DXGI default
+};
+
+const char* GetPresentModeName(PresentMode mode);
+
+struct FramePacingSettings
+{
+	PresentMode	mode = PresentMode::Vsync;
+	double		refreshRate = 60.0;		// Hz of the modeled display
+	uint32_t	maxFrameLatency = 1;	// LatencyWaitable
+	double		frameCapRate = 60.0;	// FrameCap, frames per second
+};
+
+// Fixed width buckets, the last one collects everything longer
+class FrameTimeHistogram
+{
+public:
+	enum : uint32_t { NumBuckets = 201 };
+	static constexpr double BucketSeconds = 0.25e-3;
+
+	void Add(double seconds);
+	void Reset() { *this = {}; }
+
+	uint64_t GetCount() const { return m_count; }
+	uint64_t GetBucketCount(uint32_t bucket) const { return m_buckets[bucket]; }
+	double GetMeanSeconds() const { return m_count ? m_totalSeconds / double(m_count) : 0.0; }
+	double GetMinSeconds() const { return m_count ? m_minSeconds : 0.0; }
+	double GetMaxSeconds() const { return m_maxSeconds; }
+	// Upper edge of the bucket holding the nearest rank, clamped to the largest sample
+	double GetPercentileSeconds(double percentile) const;
+	// One line per non empty bucket range, with a bar scaled to the largest bucket
+	std::string Format(const char* title) const;
+
+private:
+	uint64_t	m_buckets[NumBuckets] = {};
+	uint64_t	m_count = 0;
+	double		m_totalSeconds = 0.0;
+	double		m_minSeconds = 0.0;
+	double		m_maxSeconds = 0.0;
+};
+
+class FramePacerClock
+{
+public:
+	virtual ~FramePacerClock() {}
+
+	// Seconds from an arbitrary origin
+	virtual double Now() = 0;
+	virtual void SleepUntil(double time) = 0;
+};
+
+// steady_clock. Sleeps in 1 ms steps while the remaining time exceeds the observed length of such a sleep
+// (mean plus one standard deviation), then spins, so wake ups land within microseconds without burning a core
+class RealFramePacerClock : public FramePacerClock
+{
+public:
+	RealFramePacerClock();
+	~RealFramePacerClock();
+
+	double Now() override;
+	void SleepUntil(double time) override;
+
+	double GetSleepEstimate() const { return m_sleepEstimate; }
+
+private:
+	void SleepOneMillisecond();
+
+	std::chrono::steady_clock::time_point	m_origin;
+	double									m_sleepEstimate = 5e-3;
+	double									m_sleepMean = 5e-3;
+	double									m_sleepM2 = 0.0;
+	uint64_t								m_numSleeps = 1;
+#if defined(_WIN32)
+	HANDLE									m_timer = nullptr;	// High resolution waitable timer where available
+#endif
+};
+
+// Virtual time, sleeping jumps ahead instantly. Work advances it through Advance() or, when following real time,
+// by the real time elapsed between calls
+class SimulatedFramePacerClock : public FramePacerClock
+{
+public:
+	explicit SimulatedFramePacerClock(bool bFollowRealTime = false);
+
+	double Now() override;
+	void SleepUntil(double time) override;
+
+	void Advance(double seconds) { m_time += seconds; }
+	double GetSleptSeconds() const { return m_sleptSeconds; }
+
+private:
+	bool									m_bFollowRealTime;
+	double									m_time = 0.0;
+	double									m_sleptSeconds = 0.0;
+	std::chrono::steady_clock::time_point	m_lastRealTime;
+};
+
+struct FramePresent
+{
+	uint32_t	syncInterval;
+	uint32_t	flags;			// RHIPresentFlags
+};
+
+struct FramePacerStatistics
+{
+	uint64_t			numFrames = 0;
+	uint64_t			numThrottledFrames = 0;		// Waited for the flip queue or the frame cap
+	double				throttleSeconds = 0.0;
+	uint32_t			maxQueuedFrames = 0;		// Seen when a frame was presented, including itself
+	FrameTimeHistogram	frameTimes;					// Frame start to frame start
+	FrameTimeHistogram	latencies;					// Frame start to scanout
+};
+
+class FramePacer
+{
+public:
+	explicit FramePacer(FramePacerClock* pClock, const FramePacingSettings& settings = {});
+
+	// Takes effect at the next BeginFrame()
+	void SetSettings(const FramePacingSettings& settings);
+	const FramePacingSettings& GetSettings() const { return m_settings; }
+	// Real swap chains also bound latency through their waitable object, and decide whether tearing is possible
+	void SetSwapChain(RHISwapChain* pSwapChain);
+
+	// Waits as the mode requires and starts the frame, sample input after this
+	void BeginFrame();
+	// Arguments of RHISwapChain::Present() for this frame
+	FramePresent GetPresent() const;
+	// Right after Present(), queues the frame on the modeled display
+	void EndFrame();
+
+	// Presented frames whose scanout has not started yet
+	uint32_t GetQueuedFrames();
+	double GetLastFrameLatency() const { return m_lastLatency; }
+	FramePacerClock* GetClock() { return m_pClock; }
+
+	const FramePacerStatistics& GetStatistics() const { return m_statistics; }
+	void ResetStatistics();
+	// Mode, rates and both histograms
+	std::string FormatReport() const;
+
+private:
+	void ApplySettings();
+	double GetNextVblank(double time) const;
+	void RetireDisplayedFrames(double time);
+
+	FramePacerClock*		m_pClock;
+	RHISwapChain*			m_pSwapChain = nullptr;
+	FramePacingSettings		m_settings;
+	FramePacingSettings		m_pendingSettings;
+	bool					m_bSettingsChanged = true;
+	bool					m_bTearingSupported = true;
+
+	double					m_frameStart = 0.0;
+	double					m_nextCappedStart = 0.0;
+	bool					m_bFirstFrame = true;
+	std::deque<double>		m_queuedScanouts;		// Increasing
+	double					m_lastScanout = -1.0;
+	double					m_lastLatency = 0.0;
+
+	FramePacerStatistics	m_statistics;
+};
@@ -0,0 +1,84 @@
+#include "FramePipeline.h"
+
+FramePipeline::FramePipeline(RHIDevice* pDevice, uint32_t maxFramesInFlight, uint32_t numCommandAllocators)
+	: m_maxFramesInFlight(maxFramesInFlight)
+	, m_numCommandAllocators(numCommandAllocators)
+	, m_currentSlot(0)
+	, m_nextFenceValue(1)
+{
+	check(maxFramesInFlight == 0 || maxFramesInFlight > MaxFramesInFlightLimit);
+	check(numCommandAllocators == 0);
+	for (uint32_t i = 0; i < m_maxFramesInFlight; i++)
+	{
+		for (uint32_t j = 0; j < m_numCommandAllocators; j++)
+		{
+			m_frames[i].commandAllocators.push_back(pDevice->CreateCommandAllocator());
+		}
+	}
+	m_fence = pDevice->CreateFence(0);
+}
+
+FramePipeline::~FramePipeline()
+{
+}
+
+void FramePipeline::BeginFrame()
+{
+	if (!m_bTiming)
+	{
+		m_firstFrameTime = std::chrono::steady_clock::now();
+		m_bTiming = true;
+	}
+
+	// Slot was used `m_maxFramesInFlight` frames ago, its allocator may still be read by the GPU
+	FrameSlot& frame = m_frames[m_currentSlot];
+	if (frame.fenceValue != 0 && m_fence->GetCompletedValue() < frame.fenceValue)
+	{
+		m_statistics.numStalls++;
+		WaitForFenceValue(frame.fenceValue);
+	}
+
+	for (std::unique_ptr<RHICommandAllocator>& commandAllocator : frame.commandAllocators)
+	{
+		commandAllocator->Reset();
+	}
+}
+
+void FramePipeline::EndFrame(RHICommandQueue* pQueue)
+{
+	FrameSlot& frame = m_frames[m_currentSlot];
+	frame.fenceValue = m_nextFenceValue++;
+	pQueue->Signal(m_fence.get(), frame.fenceValue);
+
+	m_currentSlot = (m_currentSlot + 1) % m_maxFramesInFlight;
+	m_statistics.numFrames++;
+	m_statistics.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_firstFrameTime).count();
+}
+
+void FramePipeline::WaitForIdle(RHICommandQueue* pQueue)
+{
+	const uint64_t idleValue = m_nextFenceValue++;
+	pQueue->Signal(m_fence.get(), idleValue);
+	WaitForFenceValue(idleValue);
+}
+
+uint32_t FramePipeline::GetFramesInFlight() const
+{
+	const uint64_t completedValue = m_fence->GetCompletedValue();
+	uint32_t numFramesInFlight = 0;
+	for (uint32_t i = 0; i < m_maxFramesInFlight; i++)
+	{
+		if (m_frames[i].fenceValue > completedValue)
+		{
+			numFramesInFlight++;
+		}
+	}
+	return numFramesInFlight;
+}
+
+void FramePipeline::WaitForFenceValue(uint64_t value)
+{
+	const auto waitStart = std::chrono::steady_clock::now();
+	m_fence->Wait(value);
+	m_statistics.cpuWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+}
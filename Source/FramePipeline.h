@@ -0,0 +1,72 @@
+#pragma once
+
+// CPU/GPU frame pipelining
+// Each frame in flight owns command allocators (one per command list recorded in parallel) and the fence
+// value signaled after its submission.
+// The CPU only blocks when it is about to reuse the resources of a frame the GPU has not retired yet.
+
+#include "RHI.h"
+
+#include <chrono>
+
+enum
+{
+	MaxFramesInFlightLimit = 8,
+};
+
+struct FramePipelineStatistics
+{
+	uint64_t	numFrames = 0;
+	uint64_t	numStalls = 0;			// BeginFrame() had to block on the fence
+	double		cpuWaitSeconds = 0.0;	// Time blocked in BeginFrame()/WaitForIdle()
+	double		wallSeconds = 0.0;		// From first BeginFrame() to last EndFrame()
+};
+
+class FramePipeline
+{
+public:
+	FramePipeline(RHIDevice* pDevice, uint32_t maxFramesInFlight, uint32_t numCommandAllocators = 1);
+	~FramePipeline();
+
+	// Blocks until the frame slot about to be reused is retired, then resets its allocators
+	void BeginFrame();
+	// Signals the slot fence value on `pQueue`, call after the frame's last submission
+	void EndFrame(RHICommandQueue* pQueue);
+	// Wait until every submitted frame is retired, e.g. before destroying resources
+	void WaitForIdle(RHICommandQueue* pQueue);
+
+	// Command lists recorded concurrently need distinct allocators
+	RHICommandAllocator* GetCommandAllocator(uint32_t index = 0) { return m_frames[m_currentSlot].commandAllocators[index].get(); }
+	uint32_t GetNumCommandAllocators() const { return m_numCommandAllocators; }
+	uint32_t GetCurrentSlot() const { return m_currentSlot; }
+	uint32_t GetMaxFramesInFlight() const { return m_maxFramesInFlight; }
+	// Number of frames submitted but not yet retired by the GPU
+	uint32_t GetFramesInFlight() const;
+	uint64_t GetCompletedFenceValue() const { return m_fence->GetCompletedValue(); }
+	// Fence value the current frame will signal, usable to tag frame transient allocations
+	uint64_t GetCurrentFenceValue() const { return m_nextFenceValue; }
+
+	const FramePipelineStatistics& GetStatistics() const { return m_statistics; }
+	void ResetStatistics() { m_statistics = {}; m_bTiming = false; }
+
+private:
+	struct FrameSlot
+	{
+		std::vector<std::unique_ptr<RHICommandAllocator>> commandAllocators;
+		uint64_t								fenceValue = 0;		// 0 means never submitted
+	};
+
+	void WaitForFenceValue(uint64_t value);
+
+	FrameSlot							m_frames[MaxFramesInFlightLimit];
+	uint32_t							m_maxFramesInFlight;
+	uint32_t							m_numCommandAllocators;
+	uint32_t							m_currentSlot;
+
+	std::unique_ptr<RHIFence>			m_fence;
+	uint64_t							m_nextFenceValue;
+
+	FramePipelineStatistics				m_statistics;
+	bool								m_bTiming = false;
+	std::chrono::steady_clock::time_point m_firstFrameTime;
+};
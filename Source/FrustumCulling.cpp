@@ -0,0 +1,244 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+	Float4 NormalizePlane(const Float4& plane)
+	{
+		const float scale = 1.0f / Length({ plane.x, plane.y, plane.z });
+		return { plane.x * scale, plane.y * scale, plane.z * scale, plane.w * scale };
+	}
+
+	uint32_t CullScalar(const FrustumCullingJob& job, uint32_t* pVisible)
+	{
+		const float* const* pFields = job.pFields;
+		uint32_t numVisible = 0;
+		for (uint32_t i = job.begin; i < job.end; i++)
+		{
+			bool bCulled = false;
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				const float* plane = job.planes[p];
+				const float sphereDistance = plane[0] * pFields[CullingSphereX][i] + plane[1] * pFields[CullingSphereY][i] + plane[2] * pFields[CullingSphereZ][i] + plane[3] + pFields[CullingSphereRadius][i];
+				const float boxDistance = plane[0] * pFields[CullingBoxCenterX][i] + plane[1] * pFields[CullingBoxCenterY][i] + plane[2] * pFields[CullingBoxCenterZ][i] + plane[3]
+					+ std::abs(plane[0]) * pFields[CullingBoxExtentX][i] + std::abs(plane[1]) * pFields[CullingBoxExtentY][i] + std::abs(plane[2]) * pFields[CullingBoxExtentZ][i];
+				bCulled |= sphereDistance < 0.0f || boxDistance < 0.0f;
+			}
+			pVisible[numVisible] = i;
+			numVisible += bCulled ? 0 : 1;
+		}
+		return numVisible;
+	}
+
+#if ENGINE_SIMD_SSE2
+	uint32_t CullSSE2(const FrustumCullingJob& job, uint32_t* pVisible)
+	{
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm_set1_ps(job.planes[p][0]);
+			planeY[p] = _mm_set1_ps(job.planes[p][1]);
+			planeZ[p] = _mm_set1_ps(job.planes[p][2]);
+			planeW[p] = _mm_set1_ps(job.planes[p][3]);
+			absPlaneX[p] = _mm_set1_ps(std::abs(job.planes[p][0]));
+			absPlaneY[p] = _mm_set1_ps(std::abs(job.planes[p][1]));
+			absPlaneZ[p] = _mm_set1_ps(std::abs(job.planes[p][2]));
+		}
+
+		const float* const* pFields = job.pFields;
+		const __m128 zero = _mm_setzero_ps();
+		uint32_t numVisible = 0;
+		for (uint32_t i = job.begin; i < job.end; i += 4)
+		{
+			const __m128 sphereX = _mm_loadu_ps(pFields[CullingSphereX] + i);
+			const __m128 sphereY = _mm_loadu_ps(pFields[CullingSphereY] + i);
+			const __m128 sphereZ = _mm_loadu_ps(pFields[CullingSphereZ] + i);
+			const __m128 radius = _mm_loadu_ps(pFields[CullingSphereRadius] + i);
+			__m128 culled = zero;
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], sphereX), _mm_mul_ps(planeY[p], sphereY)), _mm_add_ps(_mm_mul_ps(planeZ[p], sphereZ), _mm_add_ps(planeW[p], radius)));
+				culled = _mm_or_ps(culled, _mm_cmplt_ps(distance, zero));
+			}
+
+			// Boxes only for the objects whose sphere is in
+			uint32_t culledMask = uint32_t(_mm_movemask_ps(culled));
+			if (culledMask != 0xF)
+			{
+				const __m128 centerX = _mm_loadu_ps(pFields[CullingBoxCenterX] + i);
+				const __m128 centerY = _mm_loadu_ps(pFields[CullingBoxCenterY] + i);
+				const __m128 centerZ = _mm_loadu_ps(pFields[CullingBoxCenterZ] + i);
+				const __m128 extentX = _mm_loadu_ps(pFields[CullingBoxExtentX] + i);
+				const __m128 extentY = _mm_loadu_ps(pFields[CullingBoxExtentY] + i);
+				const __m128 extentZ = _mm_loadu_ps(pFields[CullingBoxExtentZ] + i);
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)), _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+					const __m128 extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[p], extentX), _mm_mul_ps(absPlaneY[p], extentY)), _mm_mul_ps(absPlaneZ[p], extentZ));
+					culled = _mm_or_ps(culled, _mm_cmplt_ps(_mm_add_ps(center, extent), zero));
+				}
+				culledMask = uint32_t(_mm_movemask_ps(culled));
+			}
+
+			// Branch free compaction
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				pVisible[numVisible] = i + lane;
+				numVisible += ((culledMask >> lane) & 1) ^ 1;
+			}
+		}
+		return numVisible;
+	}
+#endif
+
+	FrustumCullingKernel GetKernel(SimdLevel level)
+	{
+		switch (level)
+		{
+		case SimdLevel::AVX512:	return GetFrustumCullingKernelAVX512();
+		case SimdLevel::AVX2:	return GetFrustumCullingKernelAVX2();
+#if ENGINE_SIMD_SSE2
+		case SimdLevel::SSE2:	return CullSSE2;
+#endif
+		default:				return CullScalar;
+		}
+	}
+}
+
+Frustum ExtractFrustumPlanes(const Float4x4& viewProjection)
+{
+	// Row vectors, clip space component c is dot((p, 1), column c)
+	const Float4x4& m = viewProjection;
+	const Float4 x = { m.m[0][0], m.m[1][0], m.m[2][0], m.m[3][0] };
+	const Float4 y = { m.m[0][1], m.m[1][1], m.m[2][1], m.m[3][1] };
+	const Float4 z = { m.m[0][2], m.m[1][2], m.m[2][2], m.m[3][2] };
+	const Float4 w = { m.m[0][3], m.m[1][3], m.m[2][3], m.m[3][3] };
+
+	Frustum frustum;
+	frustum.planes[0] = NormalizePlane({ w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w });	// -w <= x
+	frustum.planes[1] = NormalizePlane({ w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w });	// x <= w
+	frustum.planes[2] = NormalizePlane({ w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w });
+	frustum.planes[3] = NormalizePlane({ w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w });
+	frustum.planes[4] = NormalizePlane(z);												// 0 <= z
+	frustum.planes[5] = NormalizePlane({ w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w });	// z <= w
+	return frustum;
+}
+
+uint32_t CullingBounds::Add(const BoundingSphere& sphere, const BoundingBox& box)
+{
+	if (m_numObjects == GetPaddedNumObjects())
+	{
+		// Empty objects: the sphere is behind every plane
+		for (uint32_t field = 0; field < NumFrustumCullingFields; field++)
+		{
+			const float value = field == CullingSphereRadius ? -std::numeric_limits<float>::infinity() : 0.0f;
+			fields[field].resize(m_numObjects + Padding, value);
+		}
+	}
+	Set(m_numObjects, sphere, box);
+	return m_numObjects++;
+}
+
+void CullingBounds::Set(uint32_t object, const BoundingSphere& sphere, const BoundingBox& box)
+{
+	fields[CullingSphereX][object] = sphere.center.x;
+	fields[CullingSphereY][object] = sphere.center.y;
+	fields[CullingSphereZ][object] = sphere.center.z;
+	fields[CullingSphereRadius][object] = sphere.radius;
+	fields[CullingBoxCenterX][object] = (box.min.x + box.max.x) * 0.5f;
+	fields[CullingBoxCenterY][object] = (box.min.y + box.max.y) * 0.5f;
+	fields[CullingBoxCenterZ][object] = (box.min.z + box.max.z) * 0.5f;
+	fields[CullingBoxExtentX][object] = (box.max.x - box.min.x) * 0.5f;
+	fields[CullingBoxExtentY][object] = (box.max.y - box.min.y) * 0.5f;
+	fields[CullingBoxExtentZ][object] = (box.max.z - box.min.z) * 0.5f;
+}
+
+void CullingBounds::Clear()
+{
+	for (std::vector<float>& field : fields)
+	{
+		field.clear();
+	}
+	m_numObjects = 0;
+}
+
+FrustumCuller::FrustumCuller(JobSystem* pJobSystem)
+	: m_pJobSystem(pJobSystem)
+{
+	SetSimdLevel(GetSupportedSimdLevel());
+}
+
+void FrustumCuller::SetSimdLevel(SimdLevel level)
+{
+	level = std::min(level, GetSupportedSimdLevel());
+	while (GetKernel(level) == nullptr)
+	{
+		level = SimdLevel(uint8_t(level) - 1);
+	}
+	m_simdLevel = level;
+	m_kernel = GetKernel(level);
+}
+
+void FrustumCuller::Cull(const CullingBounds& bounds, const Frustum& frustum)
+{
+	FrustumCullingJob job = {};
+	for (uint32_t field = 0; field < NumFrustumCullingFields; field++)
+	{
+		job.pFields[field] = bounds.fields[field].data();
+	}
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		memcpy(job.planes[p], &frustum.planes[p], sizeof(job.planes[p]));
+	}
+
+	const uint32_t numObjects = bounds.GetPaddedNumObjects();
+	const uint32_t numChunks = (numObjects + ChunkSize - 1) / ChunkSize;
+	m_chunkVisible.resize(numObjects);
+	m_chunkCounts.resize(numChunks);
+	m_chunkOffsets.resize(numChunks);
+
+	{
+		JobCounter counter;
+		auto cullChunks = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t chunk = begin; chunk < end; chunk++)
+			{
+				FrustumCullingJob chunkJob = job;
+				chunkJob.begin = chunk * ChunkSize;
+				chunkJob.end = std::min(chunkJob.begin + ChunkSize, numObjects);
+				m_chunkCounts[chunk] = m_kernel(chunkJob, m_chunkVisible.data() + chunkJob.begin);
+			}
+		};
+		m_pJobSystem->ParallelFor(numChunks, 1, cullChunks, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+
+	// Chunks are concatenated into one index list
+	uint32_t numVisible = 0;
+	for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+	{
+		m_chunkOffsets[chunk] = numVisible;
+		numVisible += m_chunkCounts[chunk];
+	}
+	m_visibleIndices.resize(numVisible);
+
+	{
+		JobCounter counter;
+		auto gather = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t chunk = begin; chunk < end; chunk++)
+			{
+				if (m_chunkCounts[chunk] == 0)
+				{
+					continue;
+				}
+				memcpy(m_visibleIndices.data() + m_chunkOffsets[chunk], m_chunkVisible.data() + size_t(chunk) * ChunkSize, m_chunkCounts[chunk] * sizeof(uint32_t));
+			}
+		};
+		m_pJobSystem->ParallelFor(numChunks, 4, gather, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// Visibility of object bounds against the view frustum
+// Bounds are kept in structure of arrays form and tested 4, 8 or 16 objects at a time with SSE2, AVX2 or AVX-512,
+// whichever is the widest the CPU supports. An object is visible when both its bounding sphere and its AABB touch
+// all 6 planes, the sphere rejects most objects and the box tightens what is left. Chunks of objects are culled in
+// parallel on the JobSystem, the result is one packed list of visible indices in ascending order.
+
+#include "EngineMath.h"
+#include "FrustumCullingKernels.h"
+#include "JobSystem.h"
+#include "Simd.h"
+
+#include <vector>
+
+// 6 planes of a view frustum: left, right, bottom, top, near, far. Normalized, points inside have
+// dot(normal, p) + w >= 0
+struct Frustum
+{
+	Float4 planes[6];
+};
+
+// D3D clip space, 0 <= z <= w
+Frustum ExtractFrustumPlanes(const Float4x4& viewProjection);
+
+// World space bounds, structure of arrays. Columns are padded to a multiple of Padding with empty objects that
+// are always culled, so the kernels never need a scalar tail
+struct CullingBounds
+{
+	enum { Padding = 16 };	// Lanes of the widest kernel
+
+	uint32_t Add(const BoundingSphere& sphere, const BoundingBox& box);
+	void Set(uint32_t object, const BoundingSphere& sphere, const BoundingBox& box);
+	void Clear();
+
+	uint32_t GetNumObjects() const { return m_numObjects; }
+	uint32_t GetPaddedNumObjects() const { return uint32_t(fields[0].size()); }
+	bool IsEmpty() const { return m_numObjects == 0; }
+
+	std::vector<float>	fields[NumFrustumCullingFields];	// Indexed by FrustumCullingField, boxes are center / extent
+
+private:
+	uint32_t			m_numObjects = 0;
+};
+
+class FrustumCuller
+{
+public:
+	enum { ChunkSize = 16384 };	// Objects per job
+
+	explicit FrustumCuller(JobSystem* pJobSystem);
+
+	// Picks the kernel, clamped to GetSupportedSimdLevel() and the kernels that were built
+	void SetSimdLevel(SimdLevel level);
+	SimdLevel GetSimdLevel() const { return m_simdLevel; }
+
+	// Blocks until done, the calling thread helps the workers
+	void Cull(const CullingBounds& bounds, const Frustum& frustum);
+
+	const std::vector<uint32_t>& GetVisibleIndices() const { return m_visibleIndices; }
+
+private:
+	JobSystem*				m_pJobSystem;
+	SimdLevel				m_simdLevel = SimdLevel::Scalar;
+	FrustumCullingKernel	m_kernel = nullptr;
+
+	std::vector<uint32_t>	m_chunkVisible;		// Chunk c writes its indices from c * ChunkSize
+	std::vector<uint32_t>	m_chunkCounts;
+	std::vector<uint32_t>	m_chunkOffsets;
+	std::vector<uint32_t>	m_visibleIndices;
+};
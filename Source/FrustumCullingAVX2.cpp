@@ -0,0 +1,112 @@
+#include "FrustumCullingKernels.h"
+
+// Built with AVX2 and FMA enabled, only called once GetSupportedSimdLevel() reports them
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+
+#include <immintrin.h>
+
+namespace
+{
+	// Lane permutation that moves the visible lanes of an 8 bit mask to the front, one byte per lane
+	struct CompactionTable
+	{
+		uint64_t	permutations[256];
+		uint8_t		counts[256];
+	};
+
+	constexpr CompactionTable MakeCompactionTable()
+	{
+		CompactionTable table = {};
+		for (uint32_t mask = 0; mask < 256; mask++)
+		{
+			uint32_t count = 0;
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				if (mask & (1u << lane))
+				{
+					table.permutations[mask] |= uint64_t(lane) << (count * 8);
+					count++;
+				}
+			}
+			table.counts[mask] = uint8_t(count);
+		}
+		return table;
+	}
+
+	constexpr CompactionTable s_compactionTable = MakeCompactionTable();
+
+	uint32_t CullAVX2(const FrustumCullingJob& job, uint32_t* pVisible)
+	{
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6], absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm256_set1_ps(job.planes[p][0]);
+			planeY[p] = _mm256_set1_ps(job.planes[p][1]);
+			planeZ[p] = _mm256_set1_ps(job.planes[p][2]);
+			planeW[p] = _mm256_set1_ps(job.planes[p][3]);
+			absPlaneX[p] = _mm256_andnot_ps(signMask, planeX[p]);
+			absPlaneY[p] = _mm256_andnot_ps(signMask, planeY[p]);
+			absPlaneZ[p] = _mm256_andnot_ps(signMask, planeZ[p]);
+		}
+
+		const float* const* pFields = job.pFields;
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256i laneStep = _mm256_set1_epi32(8);
+		__m256i indices = _mm256_add_epi32(_mm256_set1_epi32(int32_t(job.begin)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		uint32_t numVisible = 0;
+		for (uint32_t i = job.begin; i < job.end; i += 8, indices = _mm256_add_epi32(indices, laneStep))
+		{
+			const __m256 sphereX = _mm256_loadu_ps(pFields[CullingSphereX] + i);
+			const __m256 sphereY = _mm256_loadu_ps(pFields[CullingSphereY] + i);
+			const __m256 sphereZ = _mm256_loadu_ps(pFields[CullingSphereZ] + i);
+			const __m256 radius = _mm256_loadu_ps(pFields[CullingSphereRadius] + i);
+			__m256 culled = zero;
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				const __m256 distance = _mm256_fmadd_ps(planeX[p], sphereX, _mm256_fmadd_ps(planeY[p], sphereY, _mm256_fmadd_ps(planeZ[p], sphereZ, _mm256_add_ps(planeW[p], radius))));
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+			}
+
+			// Boxes only for the objects whose sphere is in
+			uint32_t culledMask = uint32_t(_mm256_movemask_ps(culled));
+			if (culledMask != 0xFF)
+			{
+				const __m256 centerX = _mm256_loadu_ps(pFields[CullingBoxCenterX] + i);
+				const __m256 centerY = _mm256_loadu_ps(pFields[CullingBoxCenterY] + i);
+				const __m256 centerZ = _mm256_loadu_ps(pFields[CullingBoxCenterZ] + i);
+				const __m256 extentX = _mm256_loadu_ps(pFields[CullingBoxExtentX] + i);
+				const __m256 extentY = _mm256_loadu_ps(pFields[CullingBoxExtentY] + i);
+				const __m256 extentZ = _mm256_loadu_ps(pFields[CullingBoxExtentZ] + i);
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const __m256 extent = _mm256_fmadd_ps(absPlaneX[p], extentX, _mm256_fmadd_ps(absPlaneY[p], extentY, _mm256_fmadd_ps(absPlaneZ[p], extentZ, planeW[p])));
+					const __m256 distance = _mm256_fmadd_ps(planeX[p], centerX, _mm256_fmadd_ps(planeY[p], centerY, _mm256_fmadd_ps(planeZ[p], centerZ, extent)));
+					culled = _mm256_or_ps(culled, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+				}
+				culledMask = uint32_t(_mm256_movemask_ps(culled));
+			}
+
+			// Visible indices are permuted to the front and stored as a whole, the next store overwrites the rest
+			const uint32_t visibleMask = ~culledMask & 0xFF;
+			const __m256i permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&s_compactionTable.permutations[visibleMask])));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pVisible + numVisible), _mm256_permutevar8x32_epi32(indices, permutation));
+			numVisible += s_compactionTable.counts[visibleMask];
+		}
+		return numVisible;
+	}
+}
+
+FrustumCullingKernel GetFrustumCullingKernelAVX2()
+{
+	return CullAVX2;
+}
+
+#else
+
+FrustumCullingKernel GetFrustumCullingKernelAVX2()
+{
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "FrustumCullingKernels.h"
+
+// Built with AVX-512F enabled, only called once GetSupportedSimdLevel() reports it
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+namespace
+{
+	uint32_t CullAVX512(const FrustumCullingJob& job, uint32_t* pVisible)
+	{
+		__m512 planeX[6], planeY[6], planeZ[6], planeW[6], absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm512_set1_ps(job.planes[p][0]);
+			planeY[p] = _mm512_set1_ps(job.planes[p][1]);
+			planeZ[p] = _mm512_set1_ps(job.planes[p][2]);
+			planeW[p] = _mm512_set1_ps(job.planes[p][3]);
+			absPlaneX[p] = _mm512_abs_ps(planeX[p]);
+			absPlaneY[p] = _mm512_abs_ps(planeY[p]);
+			absPlaneZ[p] = _mm512_abs_ps(planeZ[p]);
+		}
+
+		const float* const* pFields = job.pFields;
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512i laneStep = _mm512_set1_epi32(16);
+		__m512i indices = _mm512_add_epi32(_mm512_set1_epi32(int32_t(job.begin)), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		uint32_t numVisible = 0;
+		for (uint32_t i = job.begin; i < job.end; i += 16, indices = _mm512_add_epi32(indices, laneStep))
+		{
+			const __m512 sphereX = _mm512_loadu_ps(pFields[CullingSphereX] + i);
+			const __m512 sphereY = _mm512_loadu_ps(pFields[CullingSphereY] + i);
+			const __m512 sphereZ = _mm512_loadu_ps(pFields[CullingSphereZ] + i);
+			const __m512 radius = _mm512_loadu_ps(pFields[CullingSphereRadius] + i);
+			__mmask16 culled = 0;
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				const __m512 distance = _mm512_fmadd_ps(planeX[p], sphereX, _mm512_fmadd_ps(planeY[p], sphereY, _mm512_fmadd_ps(planeZ[p], sphereZ, _mm512_add_ps(planeW[p], radius))));
+				culled |= _mm512_cmp_ps_mask(distance, zero, _CMP_LT_OQ);
+			}
+
+			// Boxes only for the objects whose sphere is in
+			if (culled != 0xFFFF)
+			{
+				const __m512 centerX = _mm512_loadu_ps(pFields[CullingBoxCenterX] + i);
+				const __m512 centerY = _mm512_loadu_ps(pFields[CullingBoxCenterY] + i);
+				const __m512 centerZ = _mm512_loadu_ps(pFields[CullingBoxCenterZ] + i);
+				const __m512 extentX = _mm512_loadu_ps(pFields[CullingBoxExtentX] + i);
+				const __m512 extentY = _mm512_loadu_ps(pFields[CullingBoxExtentY] + i);
+				const __m512 extentZ = _mm512_loadu_ps(pFields[CullingBoxExtentZ] + i);
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const __m512 extent = _mm512_fmadd_ps(absPlaneX[p], extentX, _mm512_fmadd_ps(absPlaneY[p], extentY, _mm512_fmadd_ps(absPlaneZ[p], extentZ, planeW[p])));
+					const __m512 distance = _mm512_fmadd_ps(planeX[p], centerX, _mm512_fmadd_ps(planeY[p], centerY, _mm512_fmadd_ps(planeZ[p], centerZ, extent)));
+					culled |= _mm512_cmp_ps_mask(distance, zero, _CMP_LT_OQ);
+				}
+			}
+
+			// Compressed in a register and stored as a whole (compressing stores are microcoded on some CPUs),
+			// the next store overwrites the rest
+			const __mmask16 visible = __mmask16(~culled);
+			_mm512_storeu_si512(pVisible + numVisible, _mm512_maskz_compress_epi32(visible, indices));
+			numVisible += uint32_t(_mm_popcnt_u32(visible));
+		}
+		return numVisible;
+	}
+}
+
+FrustumCullingKernel GetFrustumCullingKernelAVX512()
+{
+	return CullAVX512;
+}
+
+#else
+
+FrustumCullingKernel GetFrustumCullingKernelAVX512()
+{
+	return nullptr;
+}
+
+#endif
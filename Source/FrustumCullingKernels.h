@@ -0,0 +1,39 @@
+#pragma once
+
+// Internal to FrustumCulling.cpp and the kernels built per instruction set (FrustumCullingAVX2.cpp, ...).
+// Those translation units are compiled with wider instruction sets, so only plain data is shared with them: an
+// inline function of a common header instantiated there could be picked by the linker for the whole program.
+
+#include <cstdint>
+
+// Columns of CullingBounds
+enum FrustumCullingField
+{
+	CullingSphereX,
+	CullingSphereY,
+	CullingSphereZ,
+	CullingSphereRadius,
+	CullingBoxCenterX,
+	CullingBoxCenterY,
+	CullingBoxCenterZ,
+	CullingBoxExtentX,
+	CullingBoxExtentY,
+	CullingBoxExtentZ,
+	NumFrustumCullingFields,
+};
+
+struct FrustumCullingJob
+{
+	const float*	pFields[NumFrustumCullingFields];
+	float			planes[6][4];		// Normalized, inside is dot(normal, p) + w >= 0
+	uint32_t		begin;				// Both multiples of CullingBounds::Padding
+	uint32_t		end;
+};
+
+// Writes the ascending indices of visible objects in [begin, end) to pVisible, returns their number.
+// May write up to end - begin entries regardless of how many are visible
+using FrustumCullingKernel = uint32_t (*)(const FrustumCullingJob& job, uint32_t* pVisible);
+
+// nullptr when the compiler could not build them for this target
+FrustumCullingKernel GetFrustumCullingKernelAVX2();
+FrustumCullingKernel GetFrustumCullingKernelAVX512();
@@ -0,0 +1,67 @@
+#pragma once
+
+// Non-cryptographic 64 bit hashing (MurmurHash64A), used for content addressed caches.
+// Results are persisted on disk, so the function must not change without bumping cache versions.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+inline uint64_t HashBytes(const void* pData, size_t size, uint64_t seed = 0)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ull;
+	const int r = 47;
+
+	uint64_t h = seed ^ (uint64_t(size) * m);
+
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	const uint8_t* pEnd = pBytes + (size & ~size_t(7));
+	for (; pBytes != pEnd; pBytes += 8)
+	{
+		uint64_t k;
+		memcpy(&k, pBytes, sizeof(k));
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	const size_t remaining = size & 7;
+	if (remaining > 0)
+	{
+		uint64_t tail = 0;
+		memcpy(&tail, pBytes, remaining);
+		h ^= tail;
+		h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+inline uint64_t HashCombine(uint64_t seed, uint64_t value)
+{
+	return HashBytes(&value, sizeof(value), seed);
+}
+
+inline uint64_t HashString(std::string_view string, uint64_t seed = 0)
+{
+	return HashBytes(string.data(), string.size(), seed);
+}
+
+// Fixed width lowercase hex, used for cache file names
+inline std::string HashToString(uint64_t hash)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string result(16, '0');
+	for (int i = 15; i >= 0; i--)
+	{
+		result[i] = digits[hash & 0xf];
+		hash >>= 4;
+	}
+	return result;
+}
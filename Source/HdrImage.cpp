@@ -0,0 +1,252 @@
+#include "HdrImage.h"
+#include "FileIO.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	enum : uint32_t
+	{
+		MinRunLength = 4,
+		MaxRunLength = 127,
+		MaxLiteralLength = 128,
+		MinRleWidth = 8,
+		MaxRleWidth = 0x7fff,
+		MaxPixels = 1 << 28,
+	};
+
+	[[noreturn]] void ThrowInvalidHdrImage(const char* reason)
+	{
+		throw std::runtime_error(std::string("Invalid HDR image: ") + reason);
+	}
+
+	void FloatToRgbe(const Float3& color, uint8_t* pRgbe)
+	{
+		const float r = std::max(color.x, 0.0f);
+		const float g = std::max(color.y, 0.0f);
+		const float b = std::max(color.z, 0.0f);
+		const float maxComponent = std::max({ r, g, b });
+		if (!(maxComponent >= 1e-32f))
+		{
+			memset(pRgbe, 0, 4);
+			return;
+		}
+		int exponent;
+		const float scale = std::frexp(maxComponent, &exponent) * 256.0f / maxComponent;
+		pRgbe[0] = uint8_t(std::min(r * scale, 255.0f));
+		pRgbe[1] = uint8_t(std::min(g * scale, 255.0f));
+		pRgbe[2] = uint8_t(std::min(b * scale, 255.0f));
+		pRgbe[3] = uint8_t(exponent + 128);
+	}
+
+	Float3 RgbeToFloat(const uint8_t* pRgbe)
+	{
+		if (pRgbe[3] == 0)
+		{
+			return { 0.0f, 0.0f, 0.0f };
+		}
+		const float scale = std::ldexp(1.0f, int(pRgbe[3]) - (128 + 8));
+		return { pRgbe[0] * scale, pRgbe[1] * scale, pRgbe[2] * scale };
+	}
+
+	// One component of a scanline as runs of equal bytes and literal spans
+	void EncodeScanlineComponent(const uint8_t* pData, uint32_t count, std::vector<uint8_t>& output)
+	{
+		uint32_t i = 0;
+		while (i < count)
+		{
+			uint32_t runStart = i;
+			uint32_t runLength = 0;
+			while (runStart < count)
+			{
+				runLength = 1;
+				while (runStart + runLength < count && runLength < MaxRunLength && pData[runStart + runLength] == pData[runStart])
+				{
+					runLength++;
+				}
+				if (runLength >= MinRunLength)
+				{
+					break;
+				}
+				runStart += runLength;
+			}
+			while (i < runStart)
+			{
+				const uint32_t literalLength = std::min<uint32_t>(MaxLiteralLength, runStart - i);
+				output.push_back(uint8_t(literalLength));
+				output.insert(output.end(), pData + i, pData + i + literalLength);
+				i += literalLength;
+			}
+			if (runLength >= MinRunLength)
+			{
+				output.push_back(uint8_t(128 + runLength));
+				output.push_back(pData[runStart]);
+				i = runStart + runLength;
+			}
+		}
+	}
+
+	// Bounded reader over the file data
+	struct HdrReader
+	{
+		const uint8_t*	pData;
+		size_t			size;
+		size_t			offset = 0;
+
+		std::string ReadLine()
+		{
+			const size_t start = offset;
+			while (offset < size && pData[offset] != '\n')
+			{
+				offset++;
+			}
+			if (offset == size)
+			{
+				ThrowInvalidHdrImage("truncated header");
+			}
+			return std::string(reinterpret_cast<const char*>(pData + start), offset++ - start);
+		}
+
+		uint8_t ReadByte()
+		{
+			if (offset == size)
+			{
+				ThrowInvalidHdrImage("truncated pixel data");
+			}
+			return pData[offset++];
+		}
+	};
+}
+
+std::vector<uint8_t> EncodeHdrImage(const HdrImage& image)
+{
+	if (image.width == 0 || image.height == 0 || image.pixels.size() != size_t(image.width) * image.height)
+	{
+		ThrowInvalidHdrImage("size does not match the pixels");
+	}
+
+	char header[128];
+	const int headerLength = snprintf(header, sizeof(header), "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %u +X %u\n", image.height, image.width);
+	std::vector<uint8_t> data(header, header + headerLength);
+	data.reserve(data.size() + image.pixels.size() * 4);
+
+	const bool bRunLengthEncoded = image.width >= MinRleWidth && image.width <= MaxRleWidth;
+	std::vector<uint8_t> rgbe(size_t(image.width) * 4);
+	std::vector<uint8_t> component(image.width);
+	for (uint32_t y = 0; y < image.height; y++)
+	{
+		for (uint32_t x = 0; x < image.width; x++)
+		{
+			FloatToRgbe(image.GetPixel(x, y), &rgbe[size_t(x) * 4]);
+		}
+		if (!bRunLengthEncoded)
+		{
+			data.insert(data.end(), rgbe.begin(), rgbe.end());
+			continue;
+		}
+
+		// Components are stored one after another
+		data.insert(data.end(), { 2, 2, uint8_t(image.width >> 8), uint8_t(image.width & 0xff) });
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			for (uint32_t x = 0; x < image.width; x++)
+			{
+				component[x] = rgbe[size_t(x) * 4 + c];
+			}
+			EncodeScanlineComponent(component.data(), image.width, data);
+		}
+	}
+	return data;
+}
+
+HdrImage DecodeHdrImage(const uint8_t* pData, size_t size)
+{
+	HdrReader reader = { pData, size };
+	const std::string signature = reader.ReadLine();
+	if (signature != "#?RADIANCE" && signature != "#?RGBE")
+	{
+		ThrowInvalidHdrImage("missing signature");
+	}
+	for (std::string line = reader.ReadLine(); !line.empty(); line = reader.ReadLine())
+	{
+		if (line.rfind("FORMAT=", 0) == 0 && line != "FORMAT=32-bit_rle_rgbe")
+		{
+			ThrowInvalidHdrImage("unsupported pixel format");
+		}
+	}
+
+	HdrImage image;
+	const std::string resolution = reader.ReadLine();
+	char suffix;
+	if (sscanf(resolution.c_str(), "-Y %u +X %u%c", &image.height, &image.width, &suffix) != 2)
+	{
+		ThrowInvalidHdrImage("unsupported resolution line");
+	}
+	// Run length encoded data can be much smaller than the image, the reader bounds check the rest
+	if (image.width == 0 || image.height == 0 || uint64_t(image.width) * image.height > MaxPixels)
+	{
+		ThrowInvalidHdrImage("unsupported size");
+	}
+	image.Resize(image.width, image.height);
+
+	std::vector<uint8_t> rgbe(size_t(image.width) * 4);
+	for (uint32_t y = 0; y < image.height; y++)
+	{
+		const uint8_t* pScanline = pData + reader.offset;
+		const bool bRunLengthEncoded = image.width >= MinRleWidth && image.width <= MaxRleWidth && reader.size - reader.offset >= 4 &&
+			pScanline[0] == 2 && pScanline[1] == 2 && (pScanline[2] & 0x80) == 0;
+		if (!bRunLengthEncoded)
+		{
+			for (uint8_t& value : rgbe)
+			{
+				value = reader.ReadByte();
+			}
+		}
+		else
+		{
+			if ((uint32_t(pScanline[2]) << 8 | pScanline[3]) != image.width)
+			{
+				ThrowInvalidHdrImage("scanline width mismatch");
+			}
+			reader.offset += 4;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				for (uint32_t x = 0; x < image.width;)
+				{
+					const uint32_t count = reader.ReadByte();
+					const bool bRun = count > 128;
+					const uint32_t length = bRun ? count - 128 : count;
+					if (length == 0 || x + length > image.width)
+					{
+						ThrowInvalidHdrImage("bad scanline run");
+					}
+					const uint8_t runValue = bRun ? reader.ReadByte() : 0;
+					for (uint32_t i = 0; i < length; i++, x++)
+					{
+						rgbe[size_t(x) * 4 + c] = bRun ? runValue : reader.ReadByte();
+					}
+				}
+			}
+		}
+		for (uint32_t x = 0; x < image.width; x++)
+		{
+			image.GetPixel(x, y) = RgbeToFloat(&rgbe[size_t(x) * 4]);
+		}
+	}
+	return image;
+}
+
+void WriteHdrImage(const std::wstring& fileName, const HdrImage& image)
+{
+	const std::vector<uint8_t> data = EncodeHdrImage(image);
+	WriteFileAtomically(fileName, data.data(), data.size());
+}
+
+HdrImage ReadHdrImage(const std::wstring& fileName)
+{
+	const std::vector<uint8_t> data = ReadWholeFile(fileName);
+	return DecodeHdrImage(data.data(), data.size());
+}
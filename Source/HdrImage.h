@@ -0,0 +1,29 @@
+#pragma once
+
+// Linear float RGB images and Radiance .hdr (RGBE) files
+// Files are written with run length encoded scanlines where the format allows it (widths 8 to 32767), reading
+// accepts flat and run length encoded scanlines. Only the 32-bit_rle_rgbe format with "-Y h +X w" orientation.
+
+#include "EngineMath.h"
+
+#include <string>
+#include <vector>
+
+struct HdrImage
+{
+	void Resize(uint32_t newWidth, uint32_t newHeight) { width = newWidth; height = newHeight; pixels.assign(size_t(newWidth) * newHeight, { 0.0f, 0.0f, 0.0f }); }
+	Float3& GetPixel(uint32_t x, uint32_t y) { return pixels[size_t(y) * width + x]; }
+	const Float3& GetPixel(uint32_t x, uint32_t y) const { return pixels[size_t(y) * width + x]; }
+
+	uint32_t			width = 0;
+	uint32_t			height = 0;
+	std::vector<Float3>	pixels;		// Rows top to bottom
+};
+
+// Throw std::runtime_error on malformed data
+std::vector<uint8_t> EncodeHdrImage(const HdrImage& image);
+HdrImage DecodeHdrImage(const uint8_t* pData, size_t size);
+
+// Written to a temporary file and renamed. Throw FileIOException, or std::runtime_error on malformed files
+void WriteHdrImage(const std::wstring& fileName, const HdrImage& image);
+HdrImage ReadHdrImage(const std::wstring& fileName);
@@ -0,0 +1,533 @@
+#include "ImageBasedLighting.h"
+#include "FileIO.h"
+#include "Hash.h"
+#include "Profiler.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	constexpr float Pi = 3.14159265358979f;
+
+	enum : uint32_t
+	{
+		TexelsPerJob = 2048,
+		IrradianceSourceSize = 32,	// SH only keep low frequencies, larger source mips are not worth projecting
+	};
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint64_t GetCubemapBlockSize(uint32_t size)
+	{
+		return AlignUp(uint64_t(CubemapNumFaces) * size * size * sizeof(Half4), IBLBlockAlignment);
+	}
+
+	[[noreturn]] void ThrowInvalidIBLSettings(const char* reason)
+	{
+		throw std::runtime_error(std::string("Invalid IBL settings: ") + reason);
+	}
+
+	// Low discrepancy point set, Van der Corput radical inverse for y
+	void Hammersley(uint32_t index, uint32_t count, float& x, float& y)
+	{
+		uint32_t bits = index;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xaaaaaaaau) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xccccccccu) >> 2);
+		bits = ((bits & 0x0f0f0f0fu) << 4) | ((bits & 0xf0f0f0f0u) >> 4);
+		bits = ((bits & 0x00ff00ffu) << 8) | ((bits & 0xff00ff00u) >> 8);
+		x = float(index) / float(count);
+		y = float(bits) * 2.3283064365386963e-10f;
+	}
+
+	// Half vector around +z distributed like GGX D(h) * NdotH, `alpha` = roughness^2
+	Float3 ImportanceSampleGGX(float x, float y, float alpha)
+	{
+		const float phi = 2.0f * Pi * x;
+		const float cosTheta = std::sqrt((1.0f - y) / (1.0f + (alpha * alpha - 1.0f) * y));
+		const float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+		return { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+	}
+
+	float DistributionGGX(float NdotH, float alpha)
+	{
+		const float alpha2 = alpha * alpha;
+		const float denominator = NdotH * NdotH * (alpha2 - 1.0f) + 1.0f;
+		return alpha2 / (Pi * denominator * denominator);
+	}
+
+	// Smith with the k = alpha / 2 remapping used for image based lighting
+	float GeometrySmithIBL(float NdotV, float NdotL, float alpha)
+	{
+		const float k = alpha * 0.5f;
+		return (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+	}
+
+	Float3 SampleCubemapLod(const std::vector<RadianceCubemap>& mips, const Float3& direction, float lod)
+	{
+		const float maxLod = float(mips.size() - 1);
+		lod = std::clamp(lod, 0.0f, maxLod);
+		const uint32_t lod0 = uint32_t(lod);
+		const float t = lod - float(lod0);
+		const Float3 sample0 = IBLPrefilter::SampleCubemap(mips[lod0], direction);
+		if (t == 0.0f)
+		{
+			return sample0;
+		}
+		return sample0 * (1.0f - t) + IBLPrefilter::SampleCubemap(mips[lod0 + 1], direction) * t;
+	}
+
+	// Runs `processRow(face, y, row)` for every row of a cubemap and packs the row into `pFaces`
+	template <typename F>
+	void ProcessCubemapRows(JobSystem* pJobSystem, uint32_t size, Half4* pFaces, const F& processRow)
+	{
+		auto processRows = [&](uint32_t begin, uint32_t end)
+		{
+			std::vector<Float3> row(size);
+			for (uint32_t faceRow = begin; faceRow < end; faceRow++)
+			{
+				processRow(faceRow / size, faceRow % size, row.data());
+				PackPositionsHalf4(row.data(), size, pFaces + size_t(faceRow) * size, sizeof(Half4));
+			}
+		};
+		JobCounter counter;
+		pJobSystem->ParallelFor(CubemapNumFaces * size, std::max(TexelsPerJob / size, 1u), processRows, &counter);
+		pJobSystem->Wait(&counter);
+	}
+}
+
+const Half4* IBLData::GetSpecularFace(uint32_t mip, uint32_t face) const
+{
+	const uint32_t size = GetSpecularSize(mip);
+	return reinterpret_cast<const Half4*>(m_pData + m_pHeader->specularOffset + m_pHeader->mipOffsets[mip]) + size_t(face) * size * size;
+}
+
+const Half4* IBLData::GetIrradianceFace(uint32_t face) const
+{
+	const uint32_t size = m_pHeader->desc.irradianceSize;
+	return reinterpret_cast<const Half4*>(m_pData + m_pHeader->irradianceOffset) + size_t(face) * size * size;
+}
+
+bool IBLData::Attach(const uint8_t* pData, uint64_t size, uint64_t key)
+{
+	m_pHeader = nullptr;
+	m_pData = pData;
+	m_size = size;
+
+	// Truncated or foreign data is rejected, never partially used
+	if (pData == nullptr || size < sizeof(IBLFileHeader))
+	{
+		return false;
+	}
+	const IBLFileHeader* pHeader = reinterpret_cast<const IBLFileHeader*>(pData);
+	if (pHeader->magic != IBLFileMagic || pHeader->version != IBLFileVersion || pHeader->fileSize != size || (key != 0 && pHeader->key != key))
+	{
+		return false;
+	}
+	const IBLDesc& desc = pHeader->desc;
+	// Sizes are bounded before anything is multiplied by them, offsets before anything is added to them
+	auto isSizeValid = [](uint32_t value) { return value != 0 && value <= IBLMaxSize; };
+	if (!isSizeValid(desc.specularSize) || !isSizeValid(desc.irradianceSize) || !isSizeValid(desc.brdfLutSize) ||
+		desc.numSpecularMips == 0 || desc.numSpecularMips > IBLMaxSpecularMips || (desc.specularSize >> (desc.numSpecularMips - 1)) == 0)
+	{
+		return false;
+	}
+	auto isBlockInside = [&](uint64_t offset, uint64_t blockSize)
+	{
+		return offset % IBLBlockAlignment == 0 && offset <= size && blockSize <= size - offset;
+	};
+	if (pHeader->specularOffset > size)
+	{
+		return false;
+	}
+	for (uint32_t mip = 0; mip < desc.numSpecularMips; mip++)
+	{
+		const uint32_t mipSize = desc.specularSize >> mip;
+		if (pHeader->mipOffsets[mip] > size - pHeader->specularOffset ||
+			!isBlockInside(pHeader->specularOffset + pHeader->mipOffsets[mip], uint64_t(CubemapNumFaces) * mipSize * mipSize * sizeof(Half4)))
+		{
+			return false;
+		}
+	}
+	if (!isBlockInside(pHeader->irradianceOffset, uint64_t(CubemapNumFaces) * desc.irradianceSize * desc.irradianceSize * sizeof(Half4)) ||
+		!isBlockInside(pHeader->brdfLutOffset, uint64_t(desc.brdfLutSize) * desc.brdfLutSize * sizeof(Half2)))
+	{
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	return true;
+}
+
+IBLPrefilter::IBLPrefilter(JobSystem* pJobSystem)
+	: m_pJobSystem(pJobSystem)
+{
+}
+
+Float3 IBLPrefilter::SampleCubemap(const RadianceCubemap& cubemap, const Float3& direction)
+{
+	// Inverse of GetCubemapTexelDirection()
+	const float absX = std::abs(direction.x);
+	const float absY = std::abs(direction.y);
+	const float absZ = std::abs(direction.z);
+	uint32_t face;
+	float u;
+	float v;
+	float major;
+	if (absX >= absY && absX >= absZ)
+	{
+		face = direction.x > 0.0f ? 0 : 1;
+		u = direction.x > 0.0f ? -direction.z : direction.z;
+		v = -direction.y;
+		major = absX;
+	}
+	else if (absY >= absZ)
+	{
+		face = direction.y > 0.0f ? 2 : 3;
+		u = direction.x;
+		v = direction.y > 0.0f ? direction.z : -direction.z;
+		major = absY;
+	}
+	else
+	{
+		face = direction.z > 0.0f ? 4 : 5;
+		u = direction.z > 0.0f ? direction.x : -direction.x;
+		v = -direction.y;
+		major = absZ;
+	}
+
+	const float size = float(cubemap.size);
+	const float scale = 0.5f / major;
+	const float s = std::clamp((u * scale + 0.5f) * size - 0.5f, 0.0f, size - 1.0f);
+	const float t = std::clamp((v * scale + 0.5f) * size - 0.5f, 0.0f, size - 1.0f);
+	const uint32_t x0 = uint32_t(s);
+	const uint32_t y0 = uint32_t(t);
+	const uint32_t x1 = std::min(x0 + 1, cubemap.size - 1);
+	const uint32_t y1 = std::min(y0 + 1, cubemap.size - 1);
+	const float fx = s - float(x0);
+	const float fy = t - float(y0);
+
+	const uint32_t i00 = cubemap.GetTexelIndex(face, x0, y0);
+	const uint32_t i10 = cubemap.GetTexelIndex(face, x1, y0);
+	const uint32_t i01 = cubemap.GetTexelIndex(face, x0, y1);
+	const uint32_t i11 = cubemap.GetTexelIndex(face, x1, y1);
+	float result[3];
+	for (uint32_t channel = 0; channel < 3; channel++)
+	{
+		const float* pTexels = cubemap.channels[channel].data();
+		const float top = pTexels[i00] + (pTexels[i10] - pTexels[i00]) * fx;
+		const float bottom = pTexels[i01] + (pTexels[i11] - pTexels[i01]) * fx;
+		result[channel] = top + (bottom - top) * fy;
+	}
+	return { result[0], result[1], result[2] };
+}
+
+std::vector<RadianceCubemap> IBLPrefilter::BuildSourceMips(const RadianceCubemap& environment)
+{
+	check(environment.size == 0 || !std::has_single_bit(environment.size));
+
+	std::vector<RadianceCubemap> mips;
+	mips.push_back(environment);
+	while (mips.back().size > 1)
+	{
+		const RadianceCubemap& source = mips.back();
+		RadianceCubemap mip;
+		mip.Resize(source.size / 2);
+		for (uint32_t channel = 0; channel < 3; channel++)
+		{
+			const float* pSource = source.channels[channel].data();
+			float* pDestination = mip.channels[channel].data();
+			for (uint32_t face = 0; face < CubemapNumFaces; face++)
+			{
+				for (uint32_t y = 0; y < mip.size; y++)
+				{
+					const float* pRow0 = pSource + source.GetTexelIndex(face, 0, y * 2);
+					const float* pRow1 = pRow0 + source.size;
+					float* pRow = pDestination + mip.GetTexelIndex(face, 0, y);
+					for (uint32_t x = 0; x < mip.size; x++)
+					{
+						pRow[x] = (pRow0[x * 2] + pRow0[x * 2 + 1] + pRow1[x * 2] + pRow1[x * 2 + 1]) * 0.25f;
+					}
+				}
+			}
+		}
+		mips.push_back(std::move(mip));
+	}
+	return mips;
+}
+
+void IBLPrefilter::PrefilterSpecularMip(const std::vector<RadianceCubemap>& sourceMips, float roughness, uint32_t size, uint32_t numSamples, Half4* pFaces)
+{
+	const float sourceSize = float(sourceMips[0].size);
+	if (roughness <= 0.0f)
+	{
+		// Mirror reflection, resampled from the source mip closest to the output resolution
+		const float lod = std::max(std::log2(sourceSize / float(size)), 0.0f);
+		ProcessCubemapRows(m_pJobSystem, size, pFaces, [&](uint32_t face, uint32_t y, Float3* pRow)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				pRow[x] = SampleCubemapLod(sourceMips, GetCubemapTexelDirection(face, x, y, size), lod);
+			}
+		});
+		return;
+	}
+
+	// N = V = R, so the light directions in tangent space and their source mips are the same for every texel.
+	// Source mips are picked from the sample's solid angle (filtered importance sampling), few samples stay smooth
+	struct LightSample
+	{
+		Float3	direction;
+		float	NdotL;
+		float	lod;
+	};
+	const float alpha = roughness * roughness;
+	const float texelSolidAngle = 4.0f * Pi / (6.0f * sourceSize * sourceSize);
+	std::vector<LightSample> samples;
+	for (uint32_t i = 0; i < numSamples; i++)
+	{
+		float x;
+		float y;
+		Hammersley(i, numSamples, x, y);
+		const Float3 halfVector = ImportanceSampleGGX(x, y, alpha);
+		const Float3 direction = halfVector * (2.0f * halfVector.z) - Float3{ 0.0f, 0.0f, 1.0f };
+		if (direction.z <= 0.0f)
+		{
+			continue;
+		}
+		// pdf = D * NdotH / (4 * VdotH), NdotH == VdotH here
+		const float pdf = DistributionGGX(halfVector.z, alpha) * 0.25f;
+		const float sampleSolidAngle = 1.0f / (float(numSamples) * pdf + 1e-6f);
+		const float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+		samples.push_back({ direction, direction.z, lod });
+	}
+
+	ProcessCubemapRows(m_pJobSystem, size, pFaces, [&](uint32_t face, uint32_t y, Float3* pRow)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			const Float3 normal = GetCubemapTexelDirection(face, x, y, size);
+			const Float3 up = std::abs(normal.z) < 0.999f ? Float3{ 0.0f, 0.0f, 1.0f } : Float3{ 1.0f, 0.0f, 0.0f };
+			const Float3 tangent = Normalize(Cross(up, normal));
+			const Float3 bitangent = Cross(normal, tangent);
+
+			Float3 sum = { 0.0f, 0.0f, 0.0f };
+			float weight = 0.0f;
+			for (const LightSample& sample : samples)
+			{
+				const Float3 direction = tangent * sample.direction.x + bitangent * sample.direction.y + normal * sample.direction.z;
+				sum = sum + SampleCubemapLod(sourceMips, direction, sample.lod) * sample.NdotL;
+				weight += sample.NdotL;
+			}
+			pRow[x] = weight > 0.0f ? sum * (1.0f / weight) : SampleCubemapLod(sourceMips, normal, 0.0f);
+		}
+	});
+}
+
+void IBLPrefilter::ComputeIrradiance(const std::vector<RadianceCubemap>& sourceMips, uint32_t size, Half4* pFaces)
+{
+	// Cosine convolution in SH, exact for L2 and independent of the output size
+	size_t sourceMip = 0;
+	while (sourceMip + 1 < sourceMips.size() && sourceMips[sourceMip].size > IrradianceSourceSize)
+	{
+		sourceMip++;
+	}
+	const SHColor irradiance = ConvolveSHCosine(SHProjector(sourceMips[sourceMip].size).Project(sourceMips[sourceMip]));
+
+	ProcessCubemapRows(m_pJobSystem, size, pFaces, [&](uint32_t face, uint32_t y, Float3* pRow)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			const Float3 value = EvaluateSH(irradiance, GetCubemapTexelDirection(face, x, y, size));
+			pRow[x] = { std::max(value.x, 0.0f), std::max(value.y, 0.0f), std::max(value.z, 0.0f) };
+		}
+	});
+}
+
+void IBLPrefilter::ComputeBrdfLut(uint32_t size, uint32_t numSamples, Half2* pLut)
+{
+	auto computeRows = [&](uint32_t begin, uint32_t end)
+	{
+		// Half vectors only depend on the roughness, shared by the whole row
+		std::vector<Float3> halfVectors(numSamples);
+		for (uint32_t y = begin; y < end; y++)
+		{
+			const float roughness = (float(y) + 0.5f) / float(size);
+			const float alpha = roughness * roughness;
+			for (uint32_t i = 0; i < numSamples; i++)
+			{
+				float u;
+				float v;
+				Hammersley(i, numSamples, u, v);
+				halfVectors[i] = ImportanceSampleGGX(u, v, alpha);
+			}
+			for (uint32_t x = 0; x < size; x++)
+			{
+				const float NdotV = (float(x) + 0.5f) / float(size);
+				const Float3 view = { std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV };
+				float scale = 0.0f;
+				float bias = 0.0f;
+				for (const Float3& halfVector : halfVectors)
+				{
+					const float VdotH = Dot(view, halfVector);
+					const float NdotL = 2.0f * VdotH * halfVector.z - NdotV;
+					if (NdotL > 0.0f && VdotH > 0.0f)
+					{
+						const float visibility = GeometrySmithIBL(NdotV, NdotL, alpha) * VdotH / (halfVector.z * NdotV);
+						const float oneMinusVdotH = 1.0f - VdotH;
+						const float oneMinusVdotH2 = oneMinusVdotH * oneMinusVdotH;
+						const float fresnel = oneMinusVdotH2 * oneMinusVdotH2 * oneMinusVdotH;
+						scale += (1.0f - fresnel) * visibility;
+						bias += fresnel * visibility;
+					}
+				}
+				pLut[size_t(y) * size + x] = { FloatToHalf(scale / float(numSamples)), FloatToHalf(bias / float(numSamples)) };
+			}
+		}
+	};
+	JobCounter counter;
+	m_pJobSystem->ParallelFor(size, std::max(TexelsPerJob / size, 1u), computeRows, &counter);
+	m_pJobSystem->Wait(&counter);
+}
+
+IBLData IBLPrefilter::Prefilter(const RadianceCubemap& environment, const IBLDesc& desc, uint64_t key)
+{
+	if (environment.size == 0 || !std::has_single_bit(environment.size))
+	{
+		ThrowInvalidIBLSettings("environment size must be a power of two");
+	}
+	if (desc.specularSize == 0 || desc.irradianceSize == 0 || desc.brdfLutSize == 0 || desc.specularSamples == 0 || desc.brdfLutSamples == 0)
+	{
+		ThrowInvalidIBLSettings("sizes and sample counts must not be 0");
+	}
+	if (desc.specularSize > IBLMaxSize || desc.irradianceSize > IBLMaxSize || desc.brdfLutSize > IBLMaxSize)
+	{
+		ThrowInvalidIBLSettings("sizes must not exceed IBLMaxSize");
+	}
+	if (desc.numSpecularMips == 0 || desc.numSpecularMips > IBLMaxSpecularMips || (desc.specularSize >> (desc.numSpecularMips - 1)) == 0)
+	{
+		ThrowInvalidIBLSettings("too many specular mips");
+	}
+
+	IBLFileHeader header = {};
+	header.magic = IBLFileMagic;
+	header.version = IBLFileVersion;
+	header.key = key;
+	header.desc = desc;
+	header.specularOffset = AlignUp(sizeof(IBLFileHeader), IBLBlockAlignment);
+	uint64_t offset = 0;
+	for (uint32_t mip = 0; mip < desc.numSpecularMips; mip++)
+	{
+		header.mipOffsets[mip] = offset;
+		offset += GetCubemapBlockSize(desc.specularSize >> mip);
+	}
+	header.irradianceOffset = header.specularOffset + offset;
+	header.brdfLutOffset = header.irradianceOffset + GetCubemapBlockSize(desc.irradianceSize);
+	header.fileSize = AlignUp(header.brdfLutOffset + uint64_t(desc.brdfLutSize) * desc.brdfLutSize * sizeof(Half2), IBLBlockAlignment);
+
+	IBLData data;
+	data.m_owned.resize(header.fileSize, 0);
+	memcpy(data.m_owned.data(), &header, sizeof(header));
+	uint8_t* pData = data.m_owned.data();
+
+	const std::vector<RadianceCubemap> sourceMips = BuildSourceMips(environment);
+	for (uint32_t mip = 0; mip < desc.numSpecularMips; mip++)
+	{
+		const float roughness = desc.numSpecularMips > 1 ? float(mip) / float(desc.numSpecularMips - 1) : 0.0f;
+		Half4* pFaces = reinterpret_cast<Half4*>(pData + header.specularOffset + header.mipOffsets[mip]);
+		PrefilterSpecularMip(sourceMips, roughness, desc.specularSize >> mip, desc.specularSamples, pFaces);
+	}
+	ComputeIrradiance(sourceMips, desc.irradianceSize, reinterpret_cast<Half4*>(pData + header.irradianceOffset));
+	ComputeBrdfLut(desc.brdfLutSize, desc.brdfLutSamples, reinterpret_cast<Half2*>(pData + header.brdfLutOffset));
+
+	data.Attach(data.m_owned.data(), data.m_owned.size(), key);
+	return data;
+}
+
+IBLCache::IBLCache(const std::wstring& cacheDirectory, JobSystem* pJobSystem)
+	: m_cacheDirectory(cacheDirectory)
+	, m_prefilter(pJobSystem)
+{
+	std::error_code error;
+	std::filesystem::create_directories(m_cacheDirectory, error);
+}
+
+uint64_t IBLCache::ComputeKey(const RadianceCubemap& environment, const IBLDesc& desc)
+{
+	uint64_t key = HashCombine(IBLFileVersion, environment.size);
+	key = HashBytes(&desc, sizeof(desc), key);
+	for (const std::vector<float>& channel : environment.channels)
+	{
+		key = HashBytes(channel.data(), channel.size() * sizeof(float), key);
+	}
+	// 0 means "not cached" in the header
+	return key != 0 ? key : 1;
+}
+
+std::filesystem::path IBLCache::GetEntryPath(uint64_t key) const
+{
+	return m_cacheDirectory / (HashToString(key) + ".ibl");
+}
+
+IBLData IBLCache::GetOrPrefilter(const RadianceCubemap& environment, const IBLDesc& desc)
+{
+	PROFILE_SCOPE("IBLCache::GetOrPrefilter");
+	const uint64_t key = ComputeKey(environment, desc);
+
+	IBLData data;
+	if (LoadEntry(key, data))
+	{
+		m_statistics.hits++;
+		return data;
+	}
+	m_statistics.misses++;
+
+	data = m_prefilter.Prefilter(environment, desc, key);
+
+	// Prefer the mapped copy, keeps one code path for hits and misses
+	IBLData mapped;
+	if (StoreEntry(key, data) && LoadEntry(key, mapped))
+	{
+		return mapped;
+	}
+	m_statistics.writeFailures++;
+	return data;
+}
+
+bool IBLCache::LoadEntry(uint64_t key, IBLData& data) const
+{
+	if (!data.m_view.Open(GetEntryPath(key).wstring()))
+	{
+		return false;
+	}
+	// Truncated or foreign files are treated as misses and overwritten
+	if (!data.Attach(data.m_view.GetData(), data.m_view.GetSize(), key))
+	{
+		data.m_view.Close();
+		data.m_pData = nullptr;
+		data.m_size = 0;
+		return false;
+	}
+	return true;
+}
+
+bool IBLCache::StoreEntry(uint64_t key, const IBLData& data) const
+{
+	const std::filesystem::path entryPath = GetEntryPath(key);
+	try
+	{
+		WriteFileAtomically(entryPath.wstring(), data.GetData(), data.GetSize());
+	}
+	catch (const FileIOException&)
+	{
+		// Another thread or process may have stored the same entry first
+		std::error_code error;
+		return std::filesystem::exists(entryPath, error);
+	}
+	return true;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+// Image based lighting precomputation: GGX split sum BRDF LUT, prefiltered specular mip chain and irradiance cubemap
+// Everything is computed on the JobSystem from a RadianceCubemap and written as one upload ready blob, which
+// IBLCache stores on disk keyed by a hash of the environment and the settings. Later runs map the entry instead.
+//
+// Blob layout: IBLFileHeader, then the specular mips (mip after mip, face after face), the irradiance faces and the
+// LUT, each block aligned to IBLBlockAlignment. Cubemaps are Half4 (R16G16B16A16_FLOAT, alpha 1) with the face
+// order and orientation of SphericalHarmonics.h, the LUT is Half2 (R16G16_FLOAT): x = NdotV, y = roughness,
+// r = scale and g = bias of F0. Irradiance follows ProbeVolume.h, diffuse lighting is albedo / pi * irradiance.
+
+#include "FileView.h"
+#include "JobSystem.h"
+#include "SphericalHarmonics.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <vector>
+
+enum : uint32_t
+{
+	IBLFileMagic = 0x434c4249,	// "IBLC"
+	IBLFileVersion = 1,
+	IBLBlockAlignment = 64,
+	IBLMaxSpecularMips = 16,
+	IBLMaxSize = 1 << 16,		// Of every face and of the LUT, the block sizes of a file stay far from wrapping
+};
+
+struct IBLDesc
+{
+	uint32_t specularSize = 128;		// Mip 0, roughness 0
+	uint32_t numSpecularMips = 6;		// Roughness goes linearly from 0 to 1 over the mips
+	uint32_t specularSamples = 64;		// GGX importance samples per texel, filtered from the source mips
+	uint32_t irradianceSize = 32;
+	uint32_t brdfLutSize = 128;
+	uint32_t brdfLutSamples = 256;
+};
+
+struct IBLFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	fileSize;
+	uint64_t	key;					// IBLCache key, 0 when not cached
+	IBLDesc		desc;
+	uint32_t	reserved[2];
+	uint64_t	specularOffset;
+	uint64_t	irradianceOffset;
+	uint64_t	brdfLutOffset;
+	uint64_t	mipOffsets[IBLMaxSpecularMips];	// Relative to specularOffset
+};
+
+static_assert(sizeof(IBLFileHeader) == 208, "IBLFileHeader is part of the file format");
+
+// Either a mapped cache entry or an owned blob
+class IBLData
+{
+public:
+	bool IsValid() const { return m_pHeader != nullptr; }
+	bool IsMapped() const { return m_view.IsOpen(); }
+	const IBLFileHeader& GetHeader() const { return *m_pHeader; }
+	const uint8_t* GetData() const { return m_pData; }
+	uint64_t GetSize() const { return m_size; }
+
+	uint32_t GetSpecularSize(uint32_t mip) const { return std::max(m_pHeader->desc.specularSize >> mip, 1u); }
+	// Rows top to bottom, GetSpecularSize(mip) squared texels
+	const Half4* GetSpecularFace(uint32_t mip, uint32_t face) const;
+	const Half4* GetIrradianceFace(uint32_t face) const;
+	const Half2* GetBrdfLut() const { return reinterpret_cast<const Half2*>(m_pData + m_pHeader->brdfLutOffset); }
+
+private:
+	friend class IBLPrefilter;
+	friend class IBLCache;
+
+	// Checks the header and the block bounds, `key` == 0 accepts any key
+	bool Attach(const uint8_t* pData, uint64_t size, uint64_t key);
+
+	FileView				m_view;
+	std::vector<uint8_t>	m_owned;
+	const uint8_t*			m_pData = nullptr;
+	uint64_t				m_size = 0;
+	const IBLFileHeader*	m_pHeader = nullptr;
+};
+
+class IBLPrefilter
+{
+public:
+	explicit IBLPrefilter(JobSystem* pJobSystem);
+
+	// The environment size must be a power of two. Throws std::runtime_error on invalid settings
+	IBLData Prefilter(const RadianceCubemap& environment, const IBLDesc& desc = {}, uint64_t key = 0);
+
+	// Pieces of Prefilter(), rows top to bottom. `pFaces` receives 6 faces of `size` squared texels
+	void PrefilterSpecularMip(const std::vector<RadianceCubemap>& sourceMips, float roughness, uint32_t size, uint32_t numSamples, Half4* pFaces);
+	void ComputeIrradiance(const std::vector<RadianceCubemap>& sourceMips, uint32_t size, Half4* pFaces);
+	void ComputeBrdfLut(uint32_t size, uint32_t numSamples, Half2* pLut);
+
+	// Box filtered chain down to 1x1, mip 0 is a copy of `environment`
+	static std::vector<RadianceCubemap> BuildSourceMips(const RadianceCubemap& environment);
+	// Bilinear within the face the direction points at, edges are clamped
+	static Float3 SampleCubemap(const RadianceCubemap& cubemap, const Float3& direction);
+
+private:
+	JobSystem* m_pJobSystem;
+};
+
+struct IBLCacheStatistics
+{
+	std::atomic<uint32_t> hits = 0;
+	std::atomic<uint32_t> misses = 0;
+	std::atomic<uint32_t> writeFailures = 0;
+};
+
+// One file per environment and settings in the cache folder, hits are returned as mapped views
+class IBLCache
+{
+public:
+	IBLCache(const std::wstring& cacheDirectory, JobSystem* pJobSystem);
+
+	static uint64_t ComputeKey(const RadianceCubemap& environment, const IBLDesc& desc);
+	IBLData GetOrPrefilter(const RadianceCubemap& environment, const IBLDesc& desc = {});
+
+	std::filesystem::path GetEntryPath(uint64_t key) const;
+	const IBLCacheStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+	bool LoadEntry(uint64_t key, IBLData& data) const;
+	bool StoreEntry(uint64_t key, const IBLData& data) const;
+
+	std::filesystem::path	m_cacheDirectory;
+	IBLPrefilter			m_prefilter;
+	IBLCacheStatistics		m_statistics;
+};
@@ -0,0 +1,198 @@
+#include "ImageSequence.h"
+#include "FileIO.h"
+#include "HdrImage.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <stdexcept>
+
+namespace
+{
+	enum : uint32_t
+	{
+		DefaultFrameDigits = 4,
+	};
+
+	std::vector<uint8_t> EncodeImageRGBA8(ImageFileFormat format, const uint8_t* pPixels, uint32_t rowPitch, uint32_t width, uint32_t height)
+	{
+		if (format == ImageFileFormat::Hdr)
+		{
+			// UNORM values are linear, no sRGB decode
+			HdrImage image;
+			image.Resize(width, height);
+			for (uint32_t y = 0; y < height; y++)
+			{
+				const uint8_t* pRow = pPixels + size_t(y) * rowPitch;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					image.GetPixel(x, y) = { pRow[x * 4] * (1.0f / 255.0f), pRow[x * 4 + 1] * (1.0f / 255.0f), pRow[x * 4 + 2] * (1.0f / 255.0f) };
+				}
+			}
+			return EncodeHdrImage(image);
+		}
+
+		char header[64];
+		const int headerSize = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+		std::vector<uint8_t> data(size_t(headerSize) + size_t(width) * height * 3);
+		memcpy(data.data(), header, size_t(headerSize));
+		uint8_t* pDest = data.data() + headerSize;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const uint8_t* pRow = pPixels + size_t(y) * rowPitch;
+			for (uint32_t x = 0; x < width; x++, pDest += 3)
+			{
+				pDest[0] = pRow[x * 4];
+				pDest[1] = pRow[x * 4 + 1];
+				pDest[2] = pRow[x * 4 + 2];
+			}
+		}
+		return data;
+	}
+}
+
+ImageFileFormat GetImageFileFormat(const std::wstring& fileName)
+{
+	std::wstring extension = std::filesystem::path(fileName).extension().wstring();
+	for (wchar_t& c : extension)
+	{
+		c = wchar_t(std::towlower(c));
+	}
+	if (extension == L".ppm")
+	{
+		return ImageFileFormat::Ppm;
+	}
+	if (extension == L".hdr")
+	{
+		return ImageFileFormat::Hdr;
+	}
+	throw std::runtime_error("Image files are .ppm or .hdr: " + std::filesystem::path(fileName).string());
+}
+
+std::wstring GetImageSequencePath(const std::wstring& pathPattern, uint32_t frame)
+{
+	// Only the file name counts, directories may contain '#'
+	const size_t nameBegin = pathPattern.find_last_of(L"/\\") + 1;
+	size_t runEnd = pathPattern.find_last_of(L'#');
+	if (runEnd == std::wstring::npos || runEnd < nameBegin)
+	{
+		const std::filesystem::path path = pathPattern;
+		std::filesystem::path extension = path.extension();
+		std::wstring withRun = pathPattern.substr(0, pathPattern.size() - extension.native().size()) + L"_" + std::wstring(DefaultFrameDigits, L'#');
+		return GetImageSequencePath(withRun + extension.wstring(), frame);
+	}
+	size_t runBegin = runEnd;
+	while (runBegin > nameBegin && pathPattern[runBegin - 1] == L'#')
+	{
+		runBegin--;
+	}
+	runEnd++;
+
+	std::wstring number = std::to_wstring(frame);
+	if (number.size() < runEnd - runBegin)
+	{
+		number.insert(0, runEnd - runBegin - number.size(), L'0');
+	}
+	return pathPattern.substr(0, runBegin) + number + pathPattern.substr(runEnd);
+}
+
+void WriteImageRGBA8(const std::wstring& fileName, const uint8_t* pPixels, uint32_t rowPitch, uint32_t width, uint32_t height)
+{
+	const std::vector<uint8_t> data = EncodeImageRGBA8(GetImageFileFormat(fileName), pPixels, rowPitch, width, height);
+	WriteFileAtomically(fileName, data.data(), data.size());
+}
+
+ImageSequenceWriter::ImageSequenceWriter(JobSystem* pJobSystem, const std::wstring& pathPattern)
+	: m_pJobSystem(pJobSystem)
+	, m_pathPattern(pathPattern)
+{
+	GetImageFileFormat(pathPattern);
+	const std::filesystem::path directory = std::filesystem::path(pathPattern).parent_path();
+	std::error_code error;
+	if (!directory.empty() && !std::filesystem::create_directories(directory, error) && error)
+	{
+		throw FileIOException(directory.wstring(), "CreateDirectory", error.value());
+	}
+}
+
+ImageSequenceWriter::~ImageSequenceWriter()
+{
+	if (m_pJobSystem)
+	{
+		for (PendingImage& image : m_images)
+		{
+			m_pJobSystem->Wait(&image.counter);
+		}
+	}
+}
+
+void ImageSequenceWriter::Write(uint32_t frame, const uint8_t* pPixels, uint32_t rowPitch, uint32_t width, uint32_t height)
+{
+	PendingImage* pImage = &m_images[m_nextImage];
+	m_nextImage = (m_nextImage + 1) % MaxPendingImages;
+	if (m_pJobSystem)
+	{
+		m_pJobSystem->Wait(&pImage->counter);
+	}
+
+	pImage->frame = frame;
+	pImage->width = width;
+	pImage->height = height;
+	pImage->pixels.resize(size_t(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		memcpy(&pImage->pixels[size_t(y) * width * 4], pPixels + size_t(y) * rowPitch, size_t(width) * 4);
+	}
+
+	if (m_pJobSystem)
+	{
+		m_pJobSystem->Run([this, pImage] { WritePending(pImage); }, &pImage->counter);
+	}
+	else
+	{
+		WritePending(pImage);
+		Flush();
+	}
+}
+
+void ImageSequenceWriter::Flush()
+{
+	if (m_pJobSystem)
+	{
+		for (PendingImage& image : m_images)
+		{
+			m_pJobSystem->Wait(&image.counter);
+		}
+	}
+
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(m_errorMutex);
+		std::swap(error, m_error);
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void ImageSequenceWriter::WritePending(PendingImage* pImage)
+{
+	PROFILE_SCOPE("WriteImage");
+	try
+	{
+		WriteImageRGBA8(GetImageSequencePath(m_pathPattern, pImage->frame), pImage->pixels.data(), pImage->width * 4, pImage->width, pImage->height);
+		m_numWritten++;
+	}
+	catch (...)
+	{
+		// Jobs can not throw, the first failure surfaces in Flush()
+		std::lock_guard<std::mutex> lock(m_errorMutex);
+		if (!m_error)
+		{
+			m_error = std::current_exception();
+		}
+	}
+}
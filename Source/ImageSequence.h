@@ -0,0 +1,71 @@
+#pragma once
+
+// Numbered image files of rendered frames, e.g. the output of headless runs
+// Path patterns replace the last run of '#' with the zero padded frame number (Frames/Preview_####.ppm), without
+// one "_####" is appended to the file name. The extension picks the format: .ppm is binary 8 bit RGB and exact
+// for RGBA8 frames, .hdr is linear float RGB (HdrImage.h), alpha is dropped by both.
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class ImageFileFormat : uint8_t
+{
+	Ppm,
+	Hdr,
+};
+
+// Throws std::runtime_error for extensions other than .ppm and .hdr
+ImageFileFormat GetImageFileFormat(const std::wstring& fileName);
+std::wstring GetImageSequencePath(const std::wstring& pathPattern, uint32_t frame);
+
+// Written to a temporary file and renamed. Throws FileIOException
+void WriteImageRGBA8(const std::wstring& fileName, const uint8_t* pPixels, uint32_t rowPitch, uint32_t width, uint32_t height);
+
+// Frames are copied on Write() and encoded by jobs, rendering continues meanwhile. Once MaxPendingImages are queued
+// Write() waits for the oldest, so slow disks throttle the frames instead of piling up memory
+class ImageSequenceWriter
+{
+public:
+	enum : uint32_t { MaxPendingImages = 8 };
+
+	// Creates the directory of the pattern. Without `pJobSystem` images are written on the calling thread
+	ImageSequenceWriter(JobSystem* pJobSystem, const std::wstring& pathPattern);
+	// Waits for the queued images, failures are lost, Flush() first to see them
+	~ImageSequenceWriter();
+
+	ImageSequenceWriter(const ImageSequenceWriter&) = delete;
+	ImageSequenceWriter& operator=(const ImageSequenceWriter&) = delete;
+
+	void Write(uint32_t frame, const uint8_t* pPixels, uint32_t rowPitch, uint32_t width, uint32_t height);
+	// Waits for every queued image and rethrows the first failure of a job
+	void Flush();
+
+	const std::wstring& GetPathPattern() const { return m_pathPattern; }
+	// Files completed so far
+	uint32_t GetNumWritten() const { return m_numWritten.load(); }
+
+private:
+	struct PendingImage
+	{
+		uint32_t				frame = 0;
+		uint32_t				width = 0;
+		uint32_t				height = 0;
+		std::vector<uint8_t>	pixels;		// Tightly packed RGBA8
+		JobCounter				counter;
+	};
+
+	void WritePending(PendingImage* pImage);
+
+	JobSystem*				m_pJobSystem;
+	std::wstring			m_pathPattern;
+	PendingImage			m_images[MaxPendingImages];
+	uint32_t				m_nextImage = 0;
+	std::atomic<uint32_t>	m_numWritten = 0;
+	std::mutex				m_errorMutex;
+	std::exception_ptr		m_error;
+};
@@ -0,0 +1,322 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace
+{
+	// Executed jobs go back to the cache of the thread that ran them, no global lock on the hot path
+	struct JobCache
+	{
+		enum { MaxCachedJobs = 4096 };
+
+		~JobCache()
+		{
+			for (Job* pJob : jobs)
+			{
+				delete pJob;
+			}
+		}
+
+		std::vector<Job*> jobs;
+	};
+
+	thread_local JobCache t_jobCache;
+	// Worker of the job system owning the current thread, nullptr on other threads
+	thread_local void* t_pCurrentWorker = nullptr;
+}
+
+bool WorkStealingQueue::Push(Job* pJob)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= Capacity)
+	{
+		return false;
+	}
+	m_jobs[bottom & (Capacity - 1)].store(pJob, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* WorkStealingQueue::Pop()
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// Empty
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* pJob = m_jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// Last job, race against thieves
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			pJob = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return pJob;
+}
+
+Job* WorkStealingQueue::Steal()
+{
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+	{
+		return nullptr;
+	}
+
+	Job* pJob = m_jobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		// Lost against the owner or another thief
+		return nullptr;
+	}
+	return pJob;
+}
+
+JobSystem::JobSystem(uint32_t numWorkerThreads)
+{
+	for (uint32_t i = 0; i < numWorkerThreads; i++)
+	{
+		m_workers.push_back(std::make_unique<Worker>());
+		m_workers.back()->pSystem = this;
+	}
+	// Start threads once every deque exists, thieves iterate over all of them
+	for (std::unique_ptr<Worker>& worker : m_workers)
+	{
+		worker->thread = std::thread(&JobSystem::WorkerMain, this, worker.get());
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bExit = true;
+	}
+	m_wakeCondition.notify_all();
+	for (std::unique_ptr<Worker>& worker : m_workers)
+	{
+		worker->thread.join();
+	}
+}
+
+uint32_t JobSystem::GetDefaultNumWorkerThreads()
+{
+	// The thread calling Wait() takes the last core
+	const uint32_t numCores = std::thread::hardware_concurrency();
+	return numCores > 1 ? numCores - 1 : 0;
+}
+
+Job* JobSystem::AllocateJob()
+{
+	std::vector<Job*>& jobs = t_jobCache.jobs;
+	if (jobs.empty())
+	{
+		return new Job;
+	}
+	Job* pJob = jobs.back();
+	jobs.pop_back();
+	return pJob;
+}
+
+void JobSystem::FreeJob(Job* pJob)
+{
+	std::vector<Job*>& jobs = t_jobCache.jobs;
+	if (jobs.size() < JobCache::MaxCachedJobs)
+	{
+		jobs.push_back(pJob);
+	}
+	else
+	{
+		delete pJob;
+	}
+}
+
+void JobSystem::Submit(Job* pJob, JobCounter* pCounter, JobCounter* pDependency)
+{
+	pJob->pCounter = pCounter;
+	pJob->pNextWaiting = nullptr;
+	if (pCounter)
+	{
+		pCounter->m_value++;
+	}
+
+	if (pDependency)
+	{
+		pDependency->Lock();
+		if (pDependency->m_value != 0)
+		{
+			// Queued by the thread finishing the last job of `pDependency`
+			pJob->pNextWaiting = pDependency->m_pWaitingJobs;
+			pDependency->m_pWaitingJobs = pJob;
+			pDependency->Unlock();
+			return;
+		}
+		pDependency->Unlock();
+	}
+	Enqueue(pJob);
+}
+
+void JobSystem::Enqueue(Job* pJob)
+{
+	Worker* pWorker = GetCurrentWorker();
+	if (pWorker)
+	{
+		if (!pWorker->queue.Push(pJob))
+		{
+			// Deque full, running inline keeps ordering guarantees of counters intact
+			Execute(pJob);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_injectionMutex);
+		m_injectionQueue.push_back(pJob);
+	}
+
+	// Pairs with the sleeping worker incrementing m_numSleeping before checking m_numQueued
+	m_numQueued++;
+	if (m_numSleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wakeCondition.notify_one();
+	}
+}
+
+void JobSystem::Execute(Job* pJob)
+{
+	pJob->pInvoke(pJob);
+
+	JobCounter* pCounter = pJob->pCounter;
+	FreeJob(pJob);
+	if (pCounter == nullptr)
+	{
+		return;
+	}
+
+	pCounter->Lock();
+	Job* pWaitingJobs = nullptr;
+	if (--pCounter->m_value == 0)
+	{
+		pWaitingJobs = pCounter->m_pWaitingJobs;
+		pCounter->m_pWaitingJobs = nullptr;
+	}
+	// Counter may be destroyed by a waiter right after this
+	pCounter->Unlock();
+
+	while (pWaitingJobs)
+	{
+		Job* pNext = pWaitingJobs->pNextWaiting;
+		Enqueue(pWaitingJobs);
+		pWaitingJobs = pNext;
+	}
+}
+
+JobSystem::Worker* JobSystem::GetCurrentWorker()
+{
+	Worker* pWorker = static_cast<Worker*>(t_pCurrentWorker);
+	return pWorker && pWorker->pSystem == this ? pWorker : nullptr;
+}
+
+Job* JobSystem::FindJob(Worker* pWorker)
+{
+	if (m_numQueued.load(std::memory_order_relaxed) <= 0)
+	{
+		return nullptr;
+	}
+
+	Job* pJob = pWorker ? pWorker->queue.Pop() : nullptr;
+	if (pJob == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(m_injectionMutex);
+		if (!m_injectionQueue.empty())
+		{
+			pJob = m_injectionQueue.front();
+			m_injectionQueue.pop_front();
+		}
+	}
+	if (pJob == nullptr && !m_workers.empty())
+	{
+		// Start at a different victim per attempt, spreads contention between thieves
+		static thread_local uint32_t s_victimSeed = 0;
+		const size_t numWorkers = m_workers.size();
+		const size_t start = s_victimSeed++;
+		for (size_t i = 0; i < numWorkers && pJob == nullptr; i++)
+		{
+			Worker* pVictim = m_workers[(start + i) % numWorkers].get();
+			if (pVictim != pWorker)
+			{
+				pJob = pVictim->queue.Steal();
+			}
+		}
+	}
+
+	if (pJob)
+	{
+		m_numQueued--;
+	}
+	return pJob;
+}
+
+void JobSystem::Wait(JobCounter* pCounter)
+{
+	Worker* pWorker = GetCurrentWorker();
+	while (!pCounter->IsDone())
+	{
+		Job* pJob = FindJob(pWorker);
+		if (pJob)
+		{
+			Execute(pJob);
+		}
+		else
+		{
+			// Remaining jobs are running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerMain(Worker* pWorker)
+{
+	t_pCurrentWorker = pWorker;
+	PROFILE_THREAD("Job worker");
+
+	enum { NumSpinsBeforeSleep = 64 };
+	uint32_t numSpins = 0;
+	while (!m_bExit)
+	{
+		Job* pJob = FindJob(pWorker);
+		if (pJob)
+		{
+			Execute(pJob);
+			numSpins = 0;
+			continue;
+		}
+
+		if (++numSpins < NumSpinsBeforeSleep)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_numSleeping++;
+		m_wakeCondition.wait(lock, [this] { return m_bExit || m_numQueued.load() > 0; });
+		m_numSleeping--;
+		numSpins = 0;
+	}
+
+	t_pCurrentWorker = nullptr;
+}
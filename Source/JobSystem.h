@@ -0,0 +1,158 @@
+#pragma once
+
+// Work-stealing job system
+// Each worker owns a Chase-Lev deque: it pushes/pops at the bottom, idle workers steal from the top.
+// Jobs report completion to a JobCounter, jobs can depend on a counter and are only queued once it reaches 0.
+// Wait() keeps the calling thread busy running jobs instead of blocking, so nested waits never deadlock.
+
+#include "Platform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class JobSystem;
+
+struct Job
+{
+	enum { StorageSize = 48 };
+
+	void			(*pInvoke)(Job* pJob);
+	class JobCounter* pCounter;
+	Job*			pNextWaiting;	// Intrusive list of jobs waiting on a counter
+	alignas(16) uint8_t storage[StorageSize];
+};
+
+// Number of unfinished jobs. Must outlive them, i.e. Wait() on it before it goes out of scope
+class JobCounter
+{
+public:
+	JobCounter() {}
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return m_value.load() == 0 && !m_bLocked.load(); }
+
+private:
+	friend class JobSystem;
+
+	void Lock() { while (m_bLocked.exchange(true)) { std::this_thread::yield(); } }
+	void Unlock() { m_bLocked.store(false); }
+
+	std::atomic<uint32_t>	m_value = 0;
+	// Also held while the last job finishes, IsDone() stays false until the finishing thread stops touching the counter
+	std::atomic<bool>		m_bLocked = false;
+	Job*					m_pWaitingJobs = nullptr;
+};
+
+// Lock-free single owner deque (Chase-Lev with fixed capacity)
+class WorkStealingQueue
+{
+public:
+	enum { Capacity = 4096 };
+
+	// Owner thread only, false if full
+	bool Push(Job* pJob);
+	// Owner thread only, LIFO
+	Job* Pop();
+	// Any thread, FIFO
+	Job* Steal();
+
+private:
+	alignas(64) std::atomic<int64_t>	m_top = 0;
+	alignas(64) std::atomic<int64_t>	m_bottom = 0;
+	alignas(64) std::atomic<Job*>		m_jobs[Capacity] = {};
+};
+
+class JobSystem
+{
+public:
+	// `numWorkerThreads` excludes the threads calling Wait(), 0 runs everything inside Wait()
+	explicit JobSystem(uint32_t numWorkerThreads = GetDefaultNumWorkerThreads());
+	// Every counter must have been waited on, queued jobs are not run
+	~JobSystem();
+
+	static uint32_t GetDefaultNumWorkerThreads();
+	uint32_t GetNumWorkerThreads() const { return uint32_t(m_workers.size()); }
+
+	// `function` is a callable without arguments, captures must fit Job::StorageSize.
+	// With `pDependency` the job is only queued once that counter reaches 0
+	template <typename F>
+	void Run(F&& function, JobCounter* pCounter = nullptr, JobCounter* pDependency = nullptr)
+	{
+		using Function = std::decay_t<F>;
+		static_assert(sizeof(Function) <= Job::StorageSize && alignof(Function) <= 16, "Job captures too large");
+
+		Job* pJob = AllocateJob();
+		new (pJob->storage) Function(std::forward<F>(function));
+		pJob->pInvoke = [](Job* pJob)
+		{
+			Function* pFunction = reinterpret_cast<Function*>(pJob->storage);
+			(*pFunction)();
+			pFunction->~Function();
+		};
+		Submit(pJob, pCounter, pDependency);
+	}
+
+	// Splits [0, count) into jobs of `batchSize` items, `function(begin, end)` per job.
+	// `function` is referenced, not copied, it must live until `pCounter` is done
+	template <typename F>
+	void ParallelFor(uint32_t count, uint32_t batchSize, const F& function, JobCounter* pCounter, JobCounter* pDependency = nullptr)
+	{
+		batchSize = std::max(batchSize, 1u);
+		for (uint32_t begin = 0; begin < count; begin += batchSize)
+		{
+			const uint32_t end = std::min(begin + batchSize, count);
+			Run([&function, begin, end] { function(begin, end); }, pCounter, pDependency);
+		}
+	}
+
+	// Runs queued jobs on the calling thread until `pCounter` is done
+	void Wait(JobCounter* pCounter);
+
+private:
+	struct Worker
+	{
+		JobSystem*			pSystem = nullptr;
+		WorkStealingQueue	queue;
+		std::thread			thread;
+	};
+
+	static Job* AllocateJob();
+	static void FreeJob(Job* pJob);
+
+	void Submit(Job* pJob, JobCounter* pCounter, JobCounter* pDependency);
+	void Enqueue(Job* pJob);
+	void Execute(Job* pJob);
+	Job* FindJob(Worker* pWorker);
+	Worker* GetCurrentWorker();
+	void WorkerMain(Worker* pWorker);
+
+	std::vector<std::unique_ptr<Worker>>	m_workers;
+
+	// Jobs submitted from threads that are not workers of this system
+	std::mutex							m_injectionMutex;
+	std::deque<Job*>					m_injectionQueue;
+
+	std::atomic<int64_t>				m_numQueued = 0;
+	std::atomic<uint32_t>				m_numSleeping = 0;
+	std::mutex							m_sleepMutex;
+	std::condition_variable				m_wakeCondition;
+	std::atomic<bool>					m_bExit = false;
+};
+
+// ParallelFor() followed by a Wait() on its own counter
+template <typename F>
+void RunParallel(JobSystem* pJobSystem, uint32_t count, uint32_t batchSize, const F& function)
+{
+	JobCounter counter;
+	pJobSystem->ParallelFor(count, batchSize, function, &counter);
+	pJobSystem->Wait(&counter);
+}
@@ -0,0 +1,788 @@
+#include "Lbvh.h"
+#include "RadixSort.h"
+#include "Simd.h"
+
+#include <bit>
+
+namespace
+{
+	enum : uint32_t
+	{
+		RayBatchSize = 1024,	// Rays per job of QueryOcclusion()
+	};
+
+	// 10 bits spread to every third bit
+	uint32_t ExpandBits(uint32_t value)
+	{
+		value = (value * 0x00010001u) & 0xff0000ffu;
+		value = (value * 0x00000101u) & 0x0f00f00fu;
+		value = (value * 0x00000011u) & 0xc30c30c3u;
+		value = (value * 0x00000005u) & 0x49249249u;
+		return value;
+	}
+
+	uint32_t ComputeMortonCode(const Float3& normalized)
+	{
+		auto quantize = [](float value) { return uint32_t(std::clamp(value * 1024.0f, 0.0f, 1023.0f)); };
+		return ExpandBits(quantize(normalized.x)) << 2 | ExpandBits(quantize(normalized.y)) << 1 | ExpandBits(quantize(normalized.z));
+	}
+}
+
+#if ENGINE_SIMD_SSE2
+// 4 rays, one per lane. Unused lanes repeat the first ray and are masked out
+struct LbvhRayPacket
+{
+	__m128 origin[3];
+	__m128 direction[3];
+	__m128 inverseDirection[3];
+	__m128 tMin;
+	__m128 tMax;
+};
+
+namespace
+{
+	__m128 GetInverseDirection(__m128 direction)
+	{
+		// Same zero guard as GetRayInverseDirection()
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 tiny = _mm_set1_ps(1e-20f);
+		const __m128 bTiny = _mm_cmplt_ps(_mm_andnot_ps(signMask, direction), tiny);
+		const __m128 guarded = _mm_or_ps(_mm_and_ps(bTiny, _mm_or_ps(_mm_and_ps(direction, signMask), tiny)), _mm_andnot_ps(bTiny, direction));
+		return _mm_div_ps(_mm_set1_ps(1.0f), guarded);
+	}
+
+	void LoadRayPacket(const BvhRay* pRays, uint32_t count, LbvhRayPacket& packet)
+	{
+		alignas(16) float lanes[11][4];
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			const BvhRay& ray = pRays[lane < count ? lane : 0];
+			const float values[11] = { ray.origin.x, ray.origin.y, ray.origin.z, ray.direction.x, ray.direction.y, ray.direction.z, 0.0f, 0.0f, 0.0f, ray.tMin, ray.tMax };
+			for (uint32_t i = 0; i < 11; i++)
+			{
+				lanes[i][lane] = values[i];
+			}
+		}
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			packet.origin[axis] = _mm_load_ps(lanes[axis]);
+			packet.direction[axis] = _mm_load_ps(lanes[3 + axis]);
+			packet.inverseDirection[axis] = GetInverseDirection(packet.direction[axis]);
+		}
+		packet.tMin = _mm_load_ps(lanes[9]);
+		packet.tMax = _mm_load_ps(lanes[10]);
+	}
+
+	// Affine, row vectors
+	void TransformRayPacket(const LbvhRayPacket& packet, const Float4x4& matrix, LbvhRayPacket& result)
+	{
+		for (uint32_t column = 0; column < 3; column++)
+		{
+			const __m128 m0 = _mm_set1_ps(matrix.m[0][column]);
+			const __m128 m1 = _mm_set1_ps(matrix.m[1][column]);
+			const __m128 m2 = _mm_set1_ps(matrix.m[2][column]);
+			const __m128 direction = _mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.direction[0], m0), _mm_mul_ps(packet.direction[1], m1)), _mm_mul_ps(packet.direction[2], m2));
+			const __m128 origin = _mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.origin[0], m0), _mm_mul_ps(packet.origin[1], m1)), _mm_mul_ps(packet.origin[2], m2));
+			result.origin[column] = _mm_add_ps(origin, _mm_set1_ps(matrix.m[3][column]));
+			result.direction[column] = direction;
+			result.inverseDirection[column] = GetInverseDirection(direction);
+		}
+		result.tMin = packet.tMin;
+		result.tMax = packet.tMax;
+	}
+
+	// Lane mask of the rays entering the box within [tMin, tMax]
+	uint32_t IntersectBoundsPacket(const Float3& boundsMin, const Float3& boundsMax, const LbvhRayPacket& packet)
+	{
+		const float minimum[3] = { boundsMin.x, boundsMin.y, boundsMin.z };
+		const float maximum[3] = { boundsMax.x, boundsMax.y, boundsMax.z };
+		__m128 entry = packet.tMin;
+		__m128 exit = packet.tMax;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(minimum[axis]), packet.origin[axis]), packet.inverseDirection[axis]);
+			const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maximum[axis]), packet.origin[axis]), packet.inverseDirection[axis]);
+			entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+			exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+		}
+		return uint32_t(_mm_movemask_ps(_mm_cmple_ps(entry, exit)));
+	}
+
+	// Moeller-Trumbore against one triangle, lane mask of the hits within (tMin, tMax)
+	uint32_t IntersectTrianglePacket(const Float3& v0, const Float3& edge1, const Float3& edge2, const LbvhRayPacket& packet)
+	{
+		const __m128 e1x = _mm_set1_ps(edge1.x), e1y = _mm_set1_ps(edge1.y), e1z = _mm_set1_ps(edge1.z);
+		const __m128 e2x = _mm_set1_ps(edge2.x), e2y = _mm_set1_ps(edge2.y), e2z = _mm_set1_ps(edge2.z);
+		const __m128 dx = packet.direction[0], dy = packet.direction[1], dz = packet.direction[2];
+
+		const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+		const __m128 bValid = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), determinant), _mm_set1_ps(1e-20f));
+		const __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+		const __m128 sx = _mm_sub_ps(packet.origin[0], _mm_set1_ps(v0.x));
+		const __m128 sy = _mm_sub_ps(packet.origin[1], _mm_set1_ps(v0.y));
+		const __m128 sz = _mm_sub_ps(packet.origin[2], _mm_set1_ps(v0.z));
+		const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDeterminant);
+
+		const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDeterminant);
+		const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDeterminant);
+
+		const __m128 zero = _mm_setzero_ps();
+		__m128 bHit = _mm_and_ps(bValid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+		bHit = _mm_and_ps(bHit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+		bHit = _mm_and_ps(bHit, _mm_and_ps(_mm_cmpgt_ps(t, packet.tMin), _mm_cmplt_ps(t, packet.tMax)));
+		return uint32_t(_mm_movemask_ps(bHit));
+	}
+}
+#else
+struct LbvhRayPacket
+{
+};
+#endif
+
+Lbvh::Lbvh(JobSystem* pJobSystem)
+	: m_pJobSystem(pJobSystem)
+{
+}
+
+void Lbvh::Build(const Float3* pBoundsMin, const Float3* pBoundsMax, uint32_t count)
+{
+	m_mortonCodes.resize(count);
+	m_primitiveOrder.resize(count);
+	m_leafMin.resize(count);
+	m_leafMax.resize(count);
+	m_leafParents.resize(count);
+	if (count == 0)
+	{
+		m_nodes.clear();
+		m_nodeParents.clear();
+		return;
+	}
+
+	// Centroid bounds, per batch then merged
+	const uint32_t numBatches = (count + BatchSize - 1) / BatchSize;
+	std::vector<Float3> batchMin(numBatches, { FLT_MAX, FLT_MAX, FLT_MAX });
+	std::vector<Float3> batchMax(numBatches, { -FLT_MAX, -FLT_MAX, -FLT_MAX });
+	RunParallel(m_pJobSystem, numBatches, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t batch = begin; batch < end; batch++)
+		{
+			for (uint32_t i = batch * BatchSize; i < std::min(count, (batch + 1) * BatchSize); i++)
+			{
+				const Float3 centroid = (pBoundsMin[i] + pBoundsMax[i]) * 0.5f;
+				batchMin[batch] = Min(batchMin[batch], centroid);
+				batchMax[batch] = Max(batchMax[batch], centroid);
+			}
+		}
+	});
+	Float3 centroidMin = batchMin[0];
+	Float3 centroidMax = batchMax[0];
+	for (uint32_t batch = 1; batch < numBatches; batch++)
+	{
+		centroidMin = Min(centroidMin, batchMin[batch]);
+		centroidMax = Max(centroidMax, batchMax[batch]);
+	}
+	const Float3 extent = centroidMax - centroidMin;
+	const Float3 scale = { extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f };
+
+	RunParallel(m_pJobSystem, count, BatchSize, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const Float3 offset = (pBoundsMin[i] + pBoundsMax[i]) * 0.5f - centroidMin;
+			m_mortonCodes[i] = ComputeMortonCode({ offset.x * scale.x, offset.y * scale.y, offset.z * scale.z });
+			m_primitiveOrder[i] = i;
+		}
+	});
+	RadixSortPairs(m_pJobSystem, m_mortonCodes, m_primitiveOrder, MortonBits);
+
+	// n leaves need n - 1 internal nodes, a single primitive gets a root referencing it twice
+	const uint32_t numNodes = std::max(count - 1, 1u);
+	m_nodes.resize(numNodes);
+	m_nodeParents.resize(numNodes);
+	m_nodeParents[0] = InvalidNode;
+	if (count == 1)
+	{
+		m_nodes[0].left = m_nodes[0].right = LeafFlag;
+		m_leafParents[0] = 0;
+	}
+	else
+	{
+		RunParallel(m_pJobSystem, numNodes, BatchSize, [this](uint32_t begin, uint32_t end) { BuildHierarchy(begin, end); });
+	}
+	m_refitVisits.reset(new std::atomic<uint32_t>[numNodes]);
+
+	GatherLeafBounds(pBoundsMin, pBoundsMax);
+	RefitNodes();
+}
+
+void Lbvh::BuildHierarchy(uint32_t begin, uint32_t end)
+{
+	const int64_t count = int64_t(m_mortonCodes.size());
+	const uint32_t* pCodes = m_mortonCodes.data();
+	// Length of the common prefix of the keys at i and j, equal codes are told apart by their position
+	auto getCommonPrefix = [&](int64_t i, int64_t j) -> int32_t
+	{
+		if (j < 0 || j >= count)
+		{
+			return -1;
+		}
+		return pCodes[i] == pCodes[j] ? 32 + std::countl_zero(uint32_t(i ^ j)) : std::countl_zero(pCodes[i] ^ pCodes[j]);
+	};
+
+	for (int64_t i = begin; i < int64_t(end); i++)
+	{
+		// Direction of the range of this node, then its other end by exponential and binary search
+		const int64_t direction = getCommonPrefix(i, i + 1) > getCommonPrefix(i, i - 1) ? 1 : -1;
+		const int32_t minPrefix = getCommonPrefix(i, i - direction);
+		int64_t maxLength = 2;
+		while (getCommonPrefix(i, i + maxLength * direction) > minPrefix)
+		{
+			maxLength *= 2;
+		}
+		int64_t length = 0;
+		for (int64_t step = maxLength / 2; step >= 1; step /= 2)
+		{
+			if (getCommonPrefix(i, i + (length + step) * direction) > minPrefix)
+			{
+				length += step;
+			}
+		}
+		const int64_t j = i + length * direction;
+
+		// Split where the common prefix of the range ends
+		const int32_t nodePrefix = getCommonPrefix(i, j);
+		int64_t split = 0;
+		for (int64_t divider = 2;; divider *= 2)
+		{
+			const int64_t step = (length + divider - 1) / divider;
+			if (getCommonPrefix(i, i + (split + step) * direction) > nodePrefix)
+			{
+				split += step;
+			}
+			if (step == 1)
+			{
+				break;
+			}
+		}
+		const uint32_t gamma = uint32_t(i + split * direction + std::min<int64_t>(direction, 0));
+
+		LbvhNode& node = m_nodes[i];
+		const bool bLeftLeaf = std::min(i, j) == int64_t(gamma);
+		const bool bRightLeaf = std::max(i, j) == int64_t(gamma) + 1;
+		node.left = bLeftLeaf ? gamma | LeafFlag : gamma;
+		node.right = bRightLeaf ? (gamma + 1) | LeafFlag : gamma + 1;
+		(bLeftLeaf ? m_leafParents[gamma] : m_nodeParents[gamma]) = uint32_t(i);
+		(bRightLeaf ? m_leafParents[gamma + 1] : m_nodeParents[gamma + 1]) = uint32_t(i);
+	}
+}
+
+void Lbvh::Refit(const Float3* pBoundsMin, const Float3* pBoundsMax)
+{
+	if (!m_nodes.empty())
+	{
+		GatherLeafBounds(pBoundsMin, pBoundsMax);
+		RefitNodes();
+	}
+}
+
+void Lbvh::GatherLeafBounds(const Float3* pBoundsMin, const Float3* pBoundsMax)
+{
+	RunParallel(m_pJobSystem, GetNumPrimitives(), BatchSize, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t slot = begin; slot < end; slot++)
+		{
+			m_leafMin[slot] = pBoundsMin[m_primitiveOrder[slot]];
+			m_leafMax[slot] = pBoundsMax[m_primitiveOrder[slot]];
+		}
+	});
+}
+
+void Lbvh::RefitNodes()
+{
+	const uint32_t numNodes = uint32_t(m_nodes.size());
+	for (uint32_t i = 0; i < numNodes; i++)
+	{
+		m_refitVisits[i].store(0, std::memory_order_relaxed);
+	}
+	auto getChildBounds = [this](uint32_t child, Float3& boundsMin, Float3& boundsMax)
+	{
+		if (child & LeafFlag)
+		{
+			boundsMin = m_leafMin[child & ~LeafFlag];
+			boundsMax = m_leafMax[child & ~LeafFlag];
+		}
+		else
+		{
+			boundsMin = m_nodes[child].boundsMin;
+			boundsMax = m_nodes[child].boundsMax;
+		}
+	};
+
+	// Every leaf walks up, the first child to arrive at a node stops and the second one computes it
+	RunParallel(m_pJobSystem, GetNumPrimitives(), BatchSize, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t slot = begin; slot < end; slot++)
+		{
+			const bool bSingleLeaf = m_nodes.size() == 1 && m_nodes[0].left == m_nodes[0].right;
+			for (uint32_t node = m_leafParents[slot]; node != InvalidNode; node = m_nodeParents[node])
+			{
+				if (!bSingleLeaf && m_refitVisits[node].fetch_add(1, std::memory_order_acq_rel) == 0)
+				{
+					break;
+				}
+				Float3 leftMin, leftMax, rightMin, rightMax;
+				getChildBounds(m_nodes[node].left, leftMin, leftMax);
+				getChildBounds(m_nodes[node].right, rightMin, rightMax);
+				m_nodes[node].boundsMin = Min(leftMin, rightMin);
+				m_nodes[node].boundsMax = Max(leftMax, rightMax);
+			}
+		}
+	});
+}
+
+BoundingBox Lbvh::GetBounds() const
+{
+	return m_nodes.empty() ? BoundingBox{} : BoundingBox{ m_nodes[0].boundsMin, m_nodes[0].boundsMax };
+}
+
+TriangleLbvh::TriangleLbvh(JobSystem* pJobSystem)
+	: m_pJobSystem(pJobSystem)
+	, m_lbvh(pJobSystem)
+{
+}
+
+void TriangleLbvh::Build(const Float3* pPositions, const uint32_t* pIndices, uint32_t numTriangles)
+{
+	m_indices.assign(pIndices, pIndices + size_t(numTriangles) * 3);
+	m_boundsMin.resize(numTriangles);
+	m_boundsMax.resize(numTriangles);
+	m_triangles.resize(numTriangles);
+	UpdateBounds(pPositions);
+	m_lbvh.Build(m_boundsMin.data(), m_boundsMax.data(), numTriangles);
+	UpdateTriangles(pPositions);
+}
+
+void TriangleLbvh::Refit(const Float3* pPositions)
+{
+	UpdateBounds(pPositions);
+	m_lbvh.Refit(m_boundsMin.data(), m_boundsMax.data());
+	UpdateTriangles(pPositions);
+}
+
+void TriangleLbvh::UpdateBounds(const Float3* pPositions)
+{
+	const uint32_t numTriangles = uint32_t(m_triangles.size());
+	RunParallel(m_pJobSystem, numTriangles, Lbvh::BatchSize, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const Float3& p0 = pPositions[m_indices[i * 3 + 0]];
+			const Float3& p1 = pPositions[m_indices[i * 3 + 1]];
+			const Float3& p2 = pPositions[m_indices[i * 3 + 2]];
+			m_boundsMin[i] = Min(Min(p0, p1), p2);
+			m_boundsMax[i] = Max(Max(p0, p1), p2);
+		}
+	});
+}
+
+void TriangleLbvh::UpdateTriangles(const Float3* pPositions)
+{
+	const uint32_t numTriangles = uint32_t(m_triangles.size());
+	RunParallel(m_pJobSystem, numTriangles, Lbvh::BatchSize, [&](uint32_t begin, uint32_t end)
+	{
+		const std::vector<uint32_t>& order = m_lbvh.GetPrimitiveOrder();
+		for (uint32_t slot = begin; slot < end; slot++)
+		{
+			const uint32_t* pTriangle = &m_indices[order[slot] * 3];
+			const Float3& p0 = pPositions[pTriangle[0]];
+			m_triangles[slot] = { p0, pPositions[pTriangle[1]] - p0, pPositions[pTriangle[2]] - p0 };
+		}
+	});
+}
+
+bool TriangleLbvh::Intersect(const BvhRay& ray, BvhHit& hit) const
+{
+	const std::vector<LbvhNode>& nodes = m_lbvh.GetNodes();
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	const Float3 inverseDirection = GetRayInverseDirection(ray.direction);
+	float tMax = ray.tMax;
+	uint32_t closest = BvhHit::InvalidTriangle;
+	float closestU = 0.0f;
+	float closestV = 0.0f;
+	struct StackEntry
+	{
+		uint32_t	node;
+		float		distance;
+	};
+	StackEntry stack[Lbvh::MaxStackSize];
+	uint32_t stackSize = 0;
+	if (IntersectRayBounds(nodes[0].boundsMin, nodes[0].boundsMax, ray.origin, inverseDirection, ray.tMin, tMax) != FLT_MAX)
+	{
+		stack[stackSize++] = { 0, ray.tMin };
+	}
+	while (stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		if (entry.distance >= tMax)
+		{
+			continue;
+		}
+
+		// Leaf children are intersected right away, inner children are pushed far one first
+		const LbvhNode& node = nodes[entry.node];
+		uint32_t children[2] = { node.left, node.right };
+		float distances[2] = { FLT_MAX, FLT_MAX };
+		for (uint32_t c = 0; c < 2; c++)
+		{
+			if (children[c] & Lbvh::LeafFlag)
+			{
+				const uint32_t slot = children[c] & ~Lbvh::LeafFlag;
+				const Triangle& triangle = m_triangles[slot];
+				float t, u, v;
+				if (IntersectRayTriangle(triangle.v0, triangle.edge1, triangle.edge2, ray, tMax, t, u, v))
+				{
+					tMax = t;
+					closest = slot;
+					closestU = u;
+					closestV = v;
+				}
+			}
+			else
+			{
+				distances[c] = IntersectRayBounds(nodes[children[c]].boundsMin, nodes[children[c]].boundsMax, ray.origin, inverseDirection, ray.tMin, tMax);
+			}
+		}
+		if (distances[0] < distances[1])
+		{
+			std::swap(children[0], children[1]);
+			std::swap(distances[0], distances[1]);
+		}
+		for (uint32_t c = 0; c < 2; c++)
+		{
+			if (distances[c] != FLT_MAX)
+			{
+				stack[stackSize++] = { children[c], distances[c] };
+			}
+		}
+	}
+
+	if (closest == BvhHit::InvalidTriangle)
+	{
+		return false;
+	}
+	hit = { tMax, closestU, closestV, m_lbvh.GetPrimitiveOrder()[closest] };
+	return true;
+}
+
+bool TriangleLbvh::IsOccluded(const BvhRay& ray) const
+{
+	const std::vector<LbvhNode>& nodes = m_lbvh.GetNodes();
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	const Float3 inverseDirection = GetRayInverseDirection(ray.direction);
+	uint32_t stack[Lbvh::MaxStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const uint32_t reference = stack[--stackSize];
+		if (reference & Lbvh::LeafFlag)
+		{
+			const Triangle& triangle = m_triangles[reference & ~Lbvh::LeafFlag];
+			float t, u, v;
+			if (IntersectRayTriangle(triangle.v0, triangle.edge1, triangle.edge2, ray, ray.tMax, t, u, v))
+			{
+				return true;
+			}
+			continue;
+		}
+		const LbvhNode& node = nodes[reference];
+		if (IntersectRayBounds(node.boundsMin, node.boundsMax, ray.origin, inverseDirection, ray.tMin, ray.tMax) != FLT_MAX)
+		{
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = node.left;
+		}
+	}
+	return false;
+}
+
+uint32_t TriangleLbvh::OccludePacket(const LbvhRayPacket& packet, uint32_t activeMask) const
+{
+#if ENGINE_SIMD_SSE2
+	const std::vector<LbvhNode>& nodes = m_lbvh.GetNodes();
+	if (nodes.empty())
+	{
+		return 0;
+	}
+
+	uint32_t occluded = 0;
+	uint32_t stack[Lbvh::MaxStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const uint32_t reference = stack[--stackSize];
+		if (reference & Lbvh::LeafFlag)
+		{
+			const Triangle& triangle = m_triangles[reference & ~Lbvh::LeafFlag];
+			const uint32_t hits = IntersectTrianglePacket(triangle.v0, triangle.edge1, triangle.edge2, packet) & activeMask;
+			occluded |= hits;
+			activeMask &= ~hits;
+			if (activeMask == 0)
+			{
+				break;
+			}
+			continue;
+		}
+		const LbvhNode& node = nodes[reference];
+		if (IntersectBoundsPacket(node.boundsMin, node.boundsMax, packet) & activeMask)
+		{
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = node.left;
+		}
+	}
+	return occluded;
+#else
+	(void)packet;
+	(void)activeMask;
+	return 0;
+#endif
+}
+
+void TriangleLbvh::QueryOcclusion(const BvhRay* pRays, uint32_t numRays, uint8_t* pOccluded) const
+{
+	RunParallel(m_pJobSystem, numRays, RayBatchSize, [&](uint32_t begin, uint32_t end)
+	{
+#if ENGINE_SIMD_SSE2
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			const uint32_t count = std::min(end - i, 4u);
+			LbvhRayPacket packet;
+			LoadRayPacket(pRays + i, count, packet);
+			const uint32_t hits = OccludePacket(packet, (1u << count) - 1);
+			for (uint32_t lane = 0; lane < count; lane++)
+			{
+				pOccluded[i + lane] = uint8_t((hits >> lane) & 1);
+			}
+		}
+#else
+		for (uint32_t i = begin; i < end; i++)
+		{
+			pOccluded[i] = uint8_t(IsOccluded(pRays[i]));
+		}
+#endif
+	});
+}
+
+InstanceLbvh::InstanceLbvh(JobSystem* pJobSystem)
+	: m_pJobSystem(pJobSystem)
+	, m_lbvh(pJobSystem)
+{
+}
+
+uint32_t InstanceLbvh::AddInstance(const TriangleLbvh* pMesh, const Float4x4& objectToWorld)
+{
+	m_instances.push_back({ pMesh, objectToWorld, MatrixInverseAffine(objectToWorld) });
+	return uint32_t(m_instances.size() - 1);
+}
+
+void InstanceLbvh::SetTransform(uint32_t instance, const Float4x4& objectToWorld)
+{
+	m_instances[instance].objectToWorld = objectToWorld;
+	m_instances[instance].worldToObject = MatrixInverseAffine(objectToWorld);
+}
+
+void InstanceLbvh::Clear()
+{
+	m_instances.clear();
+	m_lbvh.Build(nullptr, nullptr, 0);
+}
+
+void InstanceLbvh::UpdateBounds()
+{
+	const uint32_t numInstances = GetNumInstances();
+	m_boundsMin.resize(numInstances);
+	m_boundsMax.resize(numInstances);
+	RunParallel(m_pJobSystem, numInstances, Lbvh::BatchSize, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const Instance& instance = m_instances[i];
+			const BoundingBox bounds = TransformBounds(instance.pMesh->GetBounds(), instance.objectToWorld);
+			m_boundsMin[i] = bounds.min;
+			m_boundsMax[i] = bounds.max;
+		}
+	});
+}
+
+void InstanceLbvh::Build()
+{
+	UpdateBounds();
+	m_lbvh.Build(m_boundsMin.data(), m_boundsMax.data(), GetNumInstances());
+}
+
+void InstanceLbvh::Refit()
+{
+	check(GetNumInstances() != m_lbvh.GetNumPrimitives());
+	UpdateBounds();
+	m_lbvh.Refit(m_boundsMin.data(), m_boundsMax.data());
+}
+
+bool InstanceLbvh::Intersect(const BvhRay& ray, LbvhInstanceHit& hit) const
+{
+	const std::vector<LbvhNode>& nodes = m_lbvh.GetNodes();
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	const Float3 inverseDirection = GetRayInverseDirection(ray.direction);
+	float tMax = ray.tMax;
+	bool bHit = false;
+	uint32_t stack[Lbvh::MaxStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const uint32_t reference = stack[--stackSize];
+		if (reference & Lbvh::LeafFlag)
+		{
+			const uint32_t slot = reference & ~Lbvh::LeafFlag;
+			if (IntersectRayBounds(m_lbvh.GetLeafBoundsMin(slot), m_lbvh.GetLeafBoundsMax(slot), ray.origin, inverseDirection, ray.tMin, tMax) == FLT_MAX)
+			{
+				continue;
+			}
+			// Affine transforms keep the ray parameter, t is the same in both spaces
+			const uint32_t instanceIndex = m_lbvh.GetPrimitiveOrder()[slot];
+			const Instance& instance = m_instances[instanceIndex];
+			const BvhRay objectRay = { TransformPoint(ray.origin, instance.worldToObject), TransformVector(ray.direction, instance.worldToObject), ray.tMin, tMax };
+			BvhHit objectHit;
+			if (instance.pMesh->Intersect(objectRay, objectHit))
+			{
+				tMax = objectHit.t;
+				hit = { objectHit, instanceIndex };
+				bHit = true;
+			}
+			continue;
+		}
+		const LbvhNode& node = nodes[reference];
+		if (IntersectRayBounds(node.boundsMin, node.boundsMax, ray.origin, inverseDirection, ray.tMin, tMax) != FLT_MAX)
+		{
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = node.left;
+		}
+	}
+	return bHit;
+}
+
+bool InstanceLbvh::IsOccluded(const BvhRay& ray) const
+{
+	const std::vector<LbvhNode>& nodes = m_lbvh.GetNodes();
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	const Float3 inverseDirection = GetRayInverseDirection(ray.direction);
+	uint32_t stack[Lbvh::MaxStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const uint32_t reference = stack[--stackSize];
+		if (reference & Lbvh::LeafFlag)
+		{
+			const uint32_t slot = reference & ~Lbvh::LeafFlag;
+			if (IntersectRayBounds(m_lbvh.GetLeafBoundsMin(slot), m_lbvh.GetLeafBoundsMax(slot), ray.origin, inverseDirection, ray.tMin, ray.tMax) == FLT_MAX)
+			{
+				continue;
+			}
+			const Instance& instance = m_instances[m_lbvh.GetPrimitiveOrder()[slot]];
+			if (instance.pMesh->IsOccluded({ TransformPoint(ray.origin, instance.worldToObject), TransformVector(ray.direction, instance.worldToObject), ray.tMin, ray.tMax }))
+			{
+				return true;
+			}
+			continue;
+		}
+		const LbvhNode& node = nodes[reference];
+		if (IntersectRayBounds(node.boundsMin, node.boundsMax, ray.origin, inverseDirection, ray.tMin, ray.tMax) != FLT_MAX)
+		{
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = node.left;
+		}
+	}
+	return false;
+}
+
+void InstanceLbvh::QueryOcclusion(const BvhRay* pRays, uint32_t numRays, uint8_t* pOccluded) const
+{
+	RunParallel(m_pJobSystem, numRays, RayBatchSize, [&](uint32_t begin, uint32_t end)
+	{
+#if ENGINE_SIMD_SSE2
+		const std::vector<LbvhNode>& nodes = m_lbvh.GetNodes();
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			const uint32_t count = std::min(end - i, 4u);
+			LbvhRayPacket packet;
+			LoadRayPacket(pRays + i, count, packet);
+			uint32_t activeMask = (1u << count) - 1;
+			uint32_t occluded = 0;
+
+			uint32_t stack[Lbvh::MaxStackSize];
+			uint32_t stackSize = 0;
+			if (!nodes.empty())
+			{
+				stack[stackSize++] = 0;
+			}
+			while (stackSize > 0 && activeMask != 0)
+			{
+				const uint32_t reference = stack[--stackSize];
+				if (reference & Lbvh::LeafFlag)
+				{
+					const uint32_t slot = reference & ~Lbvh::LeafFlag;
+					const uint32_t instanceMask = IntersectBoundsPacket(m_lbvh.GetLeafBoundsMin(slot), m_lbvh.GetLeafBoundsMax(slot), packet) & activeMask;
+					if (instanceMask != 0)
+					{
+						const Instance& instance = m_instances[m_lbvh.GetPrimitiveOrder()[slot]];
+						LbvhRayPacket objectPacket;
+						TransformRayPacket(packet, instance.worldToObject, objectPacket);
+						const uint32_t hits = instance.pMesh->OccludePacket(objectPacket, instanceMask);
+						occluded |= hits;
+						activeMask &= ~hits;
+					}
+					continue;
+				}
+				const LbvhNode& node = nodes[reference];
+				if (IntersectBoundsPacket(node.boundsMin, node.boundsMax, packet) & activeMask)
+				{
+					stack[stackSize++] = node.right;
+					stack[stackSize++] = node.left;
+				}
+			}
+			for (uint32_t lane = 0; lane < count; lane++)
+			{
+				pOccluded[i + lane] = uint8_t((occluded >> lane) & 1);
+			}
+		}
+#else
+		for (uint32_t i = begin; i < end; i++)
+		{
+			pOccluded[i] = uint8_t(IsOccluded(pRays[i]));
+		}
+#endif
+	});
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+// Linear BVH for ray queries on animated geometry: shadow, AO and bake rays that must be valid every frame
+// Primitives are sorted along a 30 bit Morton curve of their centroids (parallel radix sort) and the hierarchy is
+// emitted directly from the sorted codes, one internal node per job batch without any recursion (Karras 2012).
+// Deforming meshes keep the topology and refit the bounds bottom up, in parallel: the second child to finish
+// computes its parent. Builds cost a fraction of Bvh's SAH build for somewhat slower traversal.
+//
+// TriangleLbvh is the bottom level over one mesh in object space, InstanceLbvh the top level over transformed
+// TriangleLbvh instances. Both answer closest hit and any hit queries for single rays, and any hit for batches of
+// rays, which are traced 4 at a time with SSE2 (one ray per lane, lanes drop out once occluded).
+
+#include "Bvh.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+struct LbvhRayPacket;
+
+// Internal node. Children with LeafFlag set are primitives, by sorted position
+struct LbvhNode
+{
+	Float3		boundsMin;
+	uint32_t	left;
+	Float3		boundsMax;
+	uint32_t	right;
+};
+
+static_assert(sizeof(LbvhNode) == 32, "LbvhNode should stay half a cache line");
+
+// Hierarchy over primitive bounds
+class Lbvh
+{
+public:
+	enum : uint32_t
+	{
+		LeafFlag = 0x80000000u,
+		InvalidNode = ~0u,
+		MortonBits = 30,
+		BatchSize = 4096,
+		MaxStackSize = 128,		// Depth bound, Morton codes plus the index tie break give at most 62 levels
+	};
+
+	explicit Lbvh(JobSystem* pJobSystem);
+
+	// Bounds by primitive index
+	void Build(const Float3* pBoundsMin, const Float3* pBoundsMax, uint32_t count);
+	// Same primitives with new bounds, keeps the order and the topology
+	void Refit(const Float3* pBoundsMin, const Float3* pBoundsMax);
+
+	uint32_t GetNumPrimitives() const { return uint32_t(m_primitiveOrder.size()); }
+	// Sorted position to primitive index
+	const std::vector<uint32_t>& GetPrimitiveOrder() const { return m_primitiveOrder; }
+	// Node 0 is the root, empty without primitives
+	const std::vector<LbvhNode>& GetNodes() const { return m_nodes; }
+	BoundingBox GetBounds() const;
+
+	const Float3& GetLeafBoundsMin(uint32_t slot) const { return m_leafMin[slot]; }
+	const Float3& GetLeafBoundsMax(uint32_t slot) const { return m_leafMax[slot]; }
+
+private:
+	void BuildHierarchy(uint32_t begin, uint32_t end);
+	void GatherLeafBounds(const Float3* pBoundsMin, const Float3* pBoundsMax);
+	void RefitNodes();
+
+	JobSystem*					m_pJobSystem;
+	std::vector<uint32_t>		m_mortonCodes;		// Sorted
+	std::vector<uint32_t>		m_primitiveOrder;
+	std::vector<LbvhNode>		m_nodes;
+	std::vector<uint32_t>		m_nodeParents;
+	std::vector<uint32_t>		m_leafParents;
+	std::vector<Float3>			m_leafMin;			// By sorted position
+	std::vector<Float3>			m_leafMax;
+	std::unique_ptr<std::atomic<uint32_t>[]>	m_refitVisits;
+};
+
+// Bottom level: one triangle mesh in its own space
+class TriangleLbvh
+{
+public:
+	explicit TriangleLbvh(JobSystem* pJobSystem);
+
+	// Indexed triangle list, the indices are kept for Refit()
+	void Build(const Float3* pPositions, const uint32_t* pIndices, uint32_t numTriangles);
+	// Positions moved, same vertex count and indices as the last Build()
+	void Refit(const Float3* pPositions);
+
+	// BvhHit::triangle is the input triangle index
+	bool Intersect(const BvhRay& ray, BvhHit& hit) const;
+	bool IsOccluded(const BvhRay& ray) const;
+	// `pOccluded[i]` = IsOccluded(pRays[i]), rays are traced in groups of 4
+	void QueryOcclusion(const BvhRay* pRays, uint32_t numRays, uint8_t* pOccluded) const;
+
+	uint32_t GetNumTriangles() const { return m_lbvh.GetNumPrimitives(); }
+	BoundingBox GetBounds() const { return m_lbvh.GetBounds(); }
+	const Lbvh& GetHierarchy() const { return m_lbvh; }
+
+private:
+	friend class InstanceLbvh;
+
+	// Moeller-Trumbore data by sorted position
+	struct Triangle
+	{
+		Float3 v0;
+		Float3 edge1;
+		Float3 edge2;
+	};
+
+	void UpdateBounds(const Float3* pPositions);
+	// Triangle data follows the leaf order of the last Build()
+	void UpdateTriangles(const Float3* pPositions);
+	// Lanes in `activeMask` (bit per ray) of a packet, returns the lanes that hit
+	uint32_t OccludePacket(const LbvhRayPacket& packet, uint32_t activeMask) const;
+
+	JobSystem*				m_pJobSystem;
+	Lbvh					m_lbvh;
+	std::vector<uint32_t>	m_indices;
+	std::vector<Triangle>	m_triangles;
+	std::vector<Float3>		m_boundsMin;		// Scratch by input triangle
+	std::vector<Float3>		m_boundsMax;
+};
+
+struct LbvhInstanceHit
+{
+	BvhHit		hit;					// t along the world space ray
+	uint32_t	instance = ~0u;
+};
+
+// Top level: instances of bottom levels with affine object to world transforms
+class InstanceLbvh
+{
+public:
+	explicit InstanceLbvh(JobSystem* pJobSystem);
+
+	// The bottom level must outlive the instance. Build() or Refit() before the next query
+	uint32_t AddInstance(const TriangleLbvh* pMesh, const Float4x4& objectToWorld);
+	void SetTransform(uint32_t instance, const Float4x4& objectToWorld);
+	void Clear();
+
+	// Rebuild when instances were added or moved far, refit after small moves or refitted bottom levels
+	void Build();
+	void Refit();
+
+	bool Intersect(const BvhRay& ray, LbvhInstanceHit& hit) const;
+	bool IsOccluded(const BvhRay& ray) const;
+	void QueryOcclusion(const BvhRay* pRays, uint32_t numRays, uint8_t* pOccluded) const;
+
+	uint32_t GetNumInstances() const { return uint32_t(m_instances.size()); }
+	const Lbvh& GetHierarchy() const { return m_lbvh; }
+
+private:
+	struct Instance
+	{
+		const TriangleLbvh*	pMesh;
+		Float4x4			objectToWorld;
+		Float4x4			worldToObject;
+	};
+
+	void UpdateBounds();
+
+	JobSystem*				m_pJobSystem;
+	Lbvh					m_lbvh;
+	std::vector<Instance>	m_instances;
+	std::vector<Float3>		m_boundsMin;		// World space, by instance
+	std::vector<Float3>		m_boundsMax;
+};
@@ -0,0 +1,107 @@
+#include "Lightmap.h"
+
+#include <algorithm>
+
+namespace
+{
+	[[noreturn]] void ThrowInvalidLightmap(const char* reason)
+	{
+		throw std::runtime_error(std::string("Invalid lightmap: ") + reason);
+	}
+}
+
+void Lightmap::Open(const std::wstring& fileName)
+{
+	m_view.OpenOrThrow(fileName);
+	m_pData = m_view.GetData();
+	m_size = m_view.GetSize();
+	Validate();
+}
+
+void Lightmap::OpenFromMemory(const uint8_t* pData, uint64_t size)
+{
+	m_view.Close();
+	m_pData = pData;
+	m_size = size;
+	Validate();
+}
+
+void Lightmap::Close()
+{
+	m_view.Close();
+	m_pData = nullptr;
+	m_size = 0;
+	m_pHeader = nullptr;
+	m_pObjects = nullptr;
+	m_pUVs = nullptr;
+}
+
+void Lightmap::Validate()
+{
+	m_pHeader = nullptr;
+
+	if (m_pData == nullptr || m_size < sizeof(LightmapFileHeader))
+	{
+		ThrowInvalidLightmap("truncated header");
+	}
+	const LightmapFileHeader* pHeader = reinterpret_cast<const LightmapFileHeader*>(m_pData);
+	if (pHeader->magic != LightmapMagic)
+	{
+		ThrowInvalidLightmap("bad magic");
+	}
+	if (pHeader->version != LightmapVersion)
+	{
+		ThrowInvalidLightmap("unsupported version");
+	}
+	if (pHeader->fileSize != m_size)
+	{
+		ThrowInvalidLightmap("size mismatch, file truncated");
+	}
+	if (pHeader->atlasSize == 0 || pHeader->atlasSize > LightmapMaxAtlasSize)
+	{
+		ThrowInvalidLightmap("bad atlas size");
+	}
+	auto isInFile = [this](uint64_t offset, uint64_t size) { return offset % LightmapSectionAlignment == 0 && offset <= m_size && size <= m_size - offset; };
+	const uint64_t planeStride = GetLightmapPlaneStride(pHeader->atlasSize);
+	if (!isInFile(pHeader->objectOffset, uint64_t(pHeader->numObjects) * sizeof(LightmapFileObject)) ||
+		!isInFile(pHeader->uvOffset, uint64_t(pHeader->numUVs) * sizeof(Float2)) ||
+		!isInFile(pHeader->atlasOffset, planeStride * pHeader->numAtlases))
+	{
+		ThrowInvalidLightmap("sections out of bounds");
+	}
+	const LightmapFileObject* pObjects = reinterpret_cast<const LightmapFileObject*>(m_pData + pHeader->objectOffset);
+	for (uint32_t i = 0; i < pHeader->numObjects; i++)
+	{
+		if (pObjects[i].atlas >= pHeader->numAtlases || pObjects[i].firstUV > pHeader->numUVs || pObjects[i].numUVs > pHeader->numUVs - pObjects[i].firstUV)
+		{
+			ThrowInvalidLightmap("object out of range");
+		}
+	}
+
+	m_pHeader = pHeader;
+	m_pObjects = pObjects;
+	m_pUVs = reinterpret_cast<const Float2*>(m_pData + pHeader->uvOffset);
+	m_planeStride = planeStride;
+}
+
+Float3 Lightmap::SampleIrradiance(uint32_t atlas, const Float2& uv) const
+{
+	const uint32_t size = m_pHeader->atlasSize;
+	const Half4* pTexels = GetAtlas(atlas);
+	const float x = std::clamp(uv.x * float(size) - 0.5f, 0.0f, float(size - 1));
+	const float y = std::clamp(uv.y * float(size) - 0.5f, 0.0f, float(size - 1));
+	const uint32_t x0 = std::min(uint32_t(x), size - 1);
+	const uint32_t y0 = std::min(uint32_t(y), size - 1);
+	const uint32_t x1 = std::min(x0 + 1, size - 1);
+	const uint32_t y1 = std::min(y0 + 1, size - 1);
+	const float fractionX = x - float(x0);
+	const float fractionY = y - float(y0);
+	auto load = [&](uint32_t tx, uint32_t ty)
+	{
+		const Half4& texel = pTexels[ty * size + tx];
+		return Float3{ HalfToFloat(texel.x), HalfToFloat(texel.y), HalfToFloat(texel.z) };
+	};
+	const Float3 top = load(x0, y0) * (1.0f - fractionX) + load(x1, y0) * fractionX;
+	const Float3 bottom = load(x0, y1) * (1.0f - fractionX) + load(x1, y1) * fractionX;
+	return top * (1.0f - fractionY) + bottom * fractionY;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Baked lightmaps (.lightmap), used in place without a parsing step
+// Layout: LightmapFileHeader, LightmapFileObject per object, the objects' lightmap UVs, then one plane per atlas,
+// each aligned to LightmapSectionAlignment. UVs are per index (Float2 per triangle corner, in [0, 1] of the
+// object's atlas), charts split vertices so they can not be per vertex of the source mesh. A plane holds a Half4
+// (rgb, w unused) per texel, rows top to bottom, so it uploads as-is as an RGBA16F texture. Texels are irradiance
+// like ProbeVolume.h: diffuse lighting is albedo / pi * irradiance.
+// Files are written by LightmapBaker.h, little endian.
+
+#include "Platform.h"
+#include "EngineMath.h"
+#include "FileView.h"
+#include "VertexPacking.h"
+
+enum : uint32_t
+{
+	LightmapMagic = 0x50414d4c,		// "LMAP"
+	LightmapVersion = 1,
+	LightmapSectionAlignment = 64,
+	LightmapMaxAtlasSize = 16384,
+};
+
+struct LightmapFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	fileSize;
+	uint32_t	atlasSize;		// Texels, atlases are square
+	uint32_t	numAtlases;
+	uint32_t	numObjects;
+	uint32_t	numUVs;
+	uint64_t	objectOffset;	// From the start of the file
+	uint64_t	uvOffset;
+	uint64_t	atlasOffset;	// First plane
+	uint64_t	reserved;
+};
+
+struct LightmapFileObject
+{
+	uint32_t	atlas;
+	uint32_t	firstUV;
+	uint32_t	numUVs;			// Index count of the object
+	uint32_t	reserved;
+};
+
+static_assert(sizeof(LightmapFileHeader) == 64, "LightmapFileHeader is part of the file format");
+static_assert(sizeof(LightmapFileObject) == 16, "LightmapFileObject is part of the file format");
+
+inline uint64_t GetLightmapAlignedSize(uint64_t size)
+{
+	return (size + LightmapSectionAlignment - 1) / LightmapSectionAlignment * LightmapSectionAlignment;
+}
+
+inline uint64_t GetLightmapPlaneStride(uint32_t atlasSize)
+{
+	return GetLightmapAlignedSize(uint64_t(atlasSize) * atlasSize * sizeof(Half4));
+}
+
+class Lightmap
+{
+public:
+	// Maps the file. Throws FileIOException if it can not be opened, std::runtime_error if it is malformed
+	void Open(const std::wstring& fileName);
+	// Uses `pData` in place, it must stay valid while the Lightmap is used
+	void OpenFromMemory(const uint8_t* pData, uint64_t size);
+	void Close();
+
+	bool IsOpen() const { return m_pHeader != nullptr; }
+	const LightmapFileHeader& GetHeader() const { return *m_pHeader; }
+	uint32_t GetNumObjects() const { return m_pHeader->numObjects; }
+	uint32_t GetNumAtlases() const { return m_pHeader->numAtlases; }
+
+	// Pointers into the file
+	const LightmapFileObject& GetFileObject(uint32_t object) const { return m_pObjects[object]; }
+	const Float2* GetObjectUVs(uint32_t object) const { return m_pUVs + m_pObjects[object].firstUV; }
+	const Half4* GetAtlas(uint32_t atlas) const { return reinterpret_cast<const Half4*>(m_pData + m_pHeader->atlasOffset + atlas * m_planeStride); }
+
+	// Bilinear, clamped to the atlas edge
+	Float3 SampleIrradiance(uint32_t atlas, const Float2& uv) const;
+
+private:
+	void Validate();
+
+	FileView					m_view;
+	const uint8_t*				m_pData = nullptr;
+	uint64_t					m_size = 0;
+	const LightmapFileHeader*	m_pHeader = nullptr;
+	const LightmapFileObject*	m_pObjects = nullptr;
+	const Float2*				m_pUVs = nullptr;
+	uint64_t					m_planeStride = 0;
+};
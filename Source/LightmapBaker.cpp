@@ -0,0 +1,963 @@
+#include "LightmapBaker.h"
+#include "FileIO.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	constexpr uint32_t InvalidIndex = ~0u;
+	constexpr float HalfTexelDiagonal = 0.70710678f;
+
+	float Cross2(const Float2& a, const Float2& b) { return a.x * b.y - a.y * b.x; }
+	Float2 Subtract(const Float2& a, const Float2& b) { return { a.x - b.x, a.y - b.y }; }
+	Float2 Lerp(const Float2& a, const Float2& b, float t) { return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t }; }
+	float Length(const Float2& a) { return std::sqrt(a.x * a.x + a.y * a.y); }
+
+	bool Overlaps(const BoundingBox& a, const BoundingBox& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	BoundingBox Expand(const BoundingBox& box, float distance)
+	{
+		const Float3 offset = { distance, distance, distance };
+		return { box.min - offset, box.max + offset };
+	}
+
+	// Inverse transpose, from the inverse of the affine transform
+	Float3 TransformNormal(const Float3& normal, const Float4x4& worldToObject)
+	{
+		const float (&m)[4][4] = worldToObject.m;
+		return
+		{
+			normal.x * m[0][0] + normal.y * m[0][1] + normal.z * m[0][2],
+			normal.x * m[1][0] + normal.y * m[1][1] + normal.z * m[1][2],
+			normal.x * m[2][0] + normal.y * m[2][1] + normal.z * m[2][2],
+		};
+	}
+
+	float GetFloat(const Float3& v, uint32_t axis) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; }
+
+	// Skyline bottom left packer: rectangles rest on the lowest spot of the skyline, leftmost first
+	class SkylinePacker
+	{
+	public:
+		explicit SkylinePacker(uint32_t size)
+			: m_size(size)
+			, m_skyline{ { 0, 0, size } }
+		{
+		}
+
+		bool Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+		{
+			size_t bestSegment = SIZE_MAX;
+			uint32_t bestTop = UINT32_MAX;
+			for (size_t i = 0; i < m_skyline.size() && m_skyline[i].x + width <= m_size; i++)
+			{
+				uint32_t bottom = 0;
+				for (size_t j = i; j < m_skyline.size() && m_skyline[j].x < m_skyline[i].x + width; j++)
+				{
+					bottom = std::max(bottom, m_skyline[j].y);
+				}
+				if (bottom + height <= m_size && bottom + height < bestTop)
+				{
+					bestTop = bottom + height;
+					bestSegment = i;
+				}
+			}
+			if (bestSegment == SIZE_MAX)
+			{
+				return false;
+			}
+
+			x = m_skyline[bestSegment].x;
+			y = bestTop - height;
+			const uint32_t right = x + width;
+			while (bestSegment < m_skyline.size() && m_skyline[bestSegment].x < right)
+			{
+				Segment& segment = m_skyline[bestSegment];
+				const uint32_t segmentRight = segment.x + segment.width;
+				if (segmentRight > right)
+				{
+					segment.width = segmentRight - right;
+					segment.x = right;
+					break;
+				}
+				m_skyline.erase(m_skyline.begin() + bestSegment);
+			}
+			m_skyline.insert(m_skyline.begin() + bestSegment, { x, bestTop, width });
+			for (size_t i = 1; i < m_skyline.size();)
+			{
+				if (m_skyline[i - 1].y == m_skyline[i].y)
+				{
+					m_skyline[i - 1].width += m_skyline[i].width;
+					m_skyline.erase(m_skyline.begin() + i);
+				}
+				else
+				{
+					i++;
+				}
+			}
+			return true;
+		}
+
+	private:
+		struct Segment
+		{
+			uint32_t x;
+			uint32_t y;			// Top of the packed area below
+			uint32_t width;
+		};
+
+		uint32_t				m_size;
+		std::vector<Segment>	m_skyline;		// Left to right, covering the whole width
+	};
+
+	struct BilinearFootprint
+	{
+		uint32_t	index[4];
+		float		weight[4];
+	};
+
+	// `position` in texels, texel centers at + 0.5
+	BilinearFootprint GetBilinearFootprint(const Float2& position, uint32_t size)
+	{
+		const float x = std::clamp(position.x - 0.5f, 0.0f, float(size - 1));
+		const float y = std::clamp(position.y - 0.5f, 0.0f, float(size - 1));
+		const uint32_t x0 = std::min(uint32_t(x), size - 1);
+		const uint32_t y0 = std::min(uint32_t(y), size - 1);
+		const uint32_t x1 = std::min(x0 + 1, size - 1);
+		const uint32_t y1 = std::min(y0 + 1, size - 1);
+		const float fractionX = x - float(x0);
+		const float fractionY = y - float(y0);
+		return
+		{
+			{ y0 * size + x0, y0 * size + x1, y1 * size + x0, y1 * size + x1 },
+			{ (1.0f - fractionX) * (1.0f - fractionY), fractionX * (1.0f - fractionY), (1.0f - fractionX) * fractionY, fractionX * fractionY },
+		};
+	}
+
+	Float3 SampleBilinear(const std::vector<Float3>& texels, const BilinearFootprint& footprint)
+	{
+		Float3 value = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			value = value + texels[footprint.index[i]] * footprint.weight[i];
+		}
+		return value;
+	}
+
+	// Smallest change of the footprint's texels that moves the filtered value by `delta`
+	void AddBilinear(std::vector<Float3>& texels, const BilinearFootprint& footprint, const Float3& delta)
+	{
+		float sumSquared = 0.0f;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			sumSquared += footprint.weight[i] * footprint.weight[i];
+		}
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			texels[footprint.index[i]] = texels[footprint.index[i]] + delta * (footprint.weight[i] / sumSquared);
+		}
+	}
+
+	PathTracerSettings GetPathTracerSettings(const LightmapSettings& settings)
+	{
+		PathTracerSettings pathTracerSettings;
+		pathTracerSettings.maxBounces = settings.maxBounces;
+		pathTracerSettings.seed = settings.seed;
+		return pathTracerSettings;
+	}
+}
+
+LightmapBaker::LightmapBaker(JobSystem* pJobSystem, const LightmapSettings& settings)
+	: m_pJobSystem(pJobSystem)
+	, m_settings(settings)
+	, m_pathTracer(pJobSystem, GetPathTracerSettings(settings))
+{
+	m_settings.atlasSize = std::clamp(m_settings.atlasSize, 2 * m_settings.gutter + 1, uint32_t(LightmapMaxAtlasSize));
+}
+
+void LightmapBaker::SetScene(const LightmapScene& scene)
+{
+	for (const LightmapObject& object : scene.objects)
+	{
+		if (object.indices.size() % 3 != 0 || object.material >= scene.materials.size() ||
+			(!object.normals.empty() && object.normals.size() != object.positions.size()) ||
+			std::any_of(object.indices.begin(), object.indices.end(), [&](uint32_t index) { return index >= object.positions.size(); }))
+		{
+			throw std::runtime_error("Invalid lightmap scene: indices, normals or material of an object are inconsistent");
+		}
+	}
+
+	m_pScene = &scene;
+	const uint32_t numObjects = uint32_t(scene.objects.size());
+	m_charts.clear();
+	m_chartTriangles.clear();
+	m_seams.clear();
+	m_atlases.clear();
+	m_objectAtlases.assign(numObjects, 0);
+	m_objectUVs.assign(numObjects, {});
+	m_objectCharts.assign(numObjects, {});
+	m_objectMoved.assign(numObjects, 0);
+	for (uint32_t object = 0; object < numObjects; object++)
+	{
+		BuildCharts(object);
+	}
+	PackCharts();
+
+	const uint32_t numCharts = uint32_t(m_charts.size());
+	m_chartTexels.assign(numCharts, {});
+	m_chartBaked.assign(numCharts, 0);
+	RunParallel(m_pJobSystem, numCharts, 1, [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t chart = begin; chart < end; chart++)
+		{
+			RasterizeChart(chart);
+		}
+	});
+	FindSeams();
+	m_bTraceSceneValid = false;
+}
+
+void LightmapBaker::BuildCharts(uint32_t object)
+{
+	const LightmapObject& source = m_pScene->objects[object];
+	const uint32_t numTriangles = uint32_t(source.indices.size() / 3);
+	const uint32_t* pIndices = source.indices.data();
+
+	// Major axis and sign of every face, 0 to 5
+	std::vector<uint32_t> directions(numTriangles);
+	for (uint32_t triangle = 0; triangle < numTriangles; triangle++)
+	{
+		const Float3& p0 = source.positions[pIndices[triangle * 3]];
+		const Float3 normal = Cross(source.positions[pIndices[triangle * 3 + 1]] - p0, source.positions[pIndices[triangle * 3 + 2]] - p0);
+		const float magnitudes[3] = { std::fabs(normal.x), std::fabs(normal.y), std::fabs(normal.z) };
+		const uint32_t axis = magnitudes[0] >= magnitudes[1] && magnitudes[0] >= magnitudes[2] ? 0 : magnitudes[1] >= magnitudes[2] ? 1 : 2;
+		directions[triangle] = axis * 2 + (GetFloat(normal, axis) < 0.0f ? 1 : 0);
+	}
+
+	// Union find over triangles sharing a vertex and a direction
+	std::vector<uint32_t> parents(numTriangles);
+	for (uint32_t triangle = 0; triangle < numTriangles; triangle++)
+	{
+		parents[triangle] = triangle;
+	}
+	auto find = [&](uint32_t triangle)
+	{
+		while (parents[triangle] != triangle)
+		{
+			parents[triangle] = parents[parents[triangle]];
+			triangle = parents[triangle];
+		}
+		return triangle;
+	};
+	std::vector<uint32_t> vertexTriangles(source.positions.size() * 6, InvalidIndex);
+	for (uint32_t triangle = 0; triangle < numTriangles; triangle++)
+	{
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t& first = vertexTriangles[size_t(pIndices[triangle * 3 + corner]) * 6 + directions[triangle]];
+			if (first == InvalidIndex)
+			{
+				first = triangle;
+			}
+			else
+			{
+				parents[find(triangle)] = find(first);
+			}
+		}
+	}
+
+	std::vector<uint32_t> rootCharts(numTriangles, InvalidIndex);
+	for (uint32_t triangle = 0; triangle < numTriangles; triangle++)
+	{
+		uint32_t& chart = rootCharts[find(triangle)];
+		if (chart == InvalidIndex)
+		{
+			chart = uint32_t(m_charts.size());
+			m_charts.push_back({});
+			m_charts.back().object = object;
+			m_chartTriangles.emplace_back();
+			m_objectCharts[object].push_back(chart);
+		}
+		m_chartTriangles[chart].push_back(triangle);
+	}
+
+	// Projection onto the plane of the chart's axis, relative to the chart's corner, in object units
+	std::vector<Float2>& uvs = m_objectUVs[object];
+	uvs.resize(source.indices.size());
+	for (uint32_t chart : m_objectCharts[object])
+	{
+		const std::vector<uint32_t>& triangles = m_chartTriangles[chart];
+		const uint32_t axis = directions[triangles[0]] / 2;
+		Float2 minimum = { FLT_MAX, FLT_MAX };
+		for (uint32_t triangle : triangles)
+		{
+			for (uint32_t corner = triangle * 3; corner < triangle * 3 + 3; corner++)
+			{
+				const Float3& position = source.positions[pIndices[corner]];
+				uvs[corner] = { GetFloat(position, (axis + 1) % 3), GetFloat(position, (axis + 2) % 3) };
+				minimum = { std::min(minimum.x, uvs[corner].x), std::min(minimum.y, uvs[corner].y) };
+			}
+		}
+		for (uint32_t triangle : triangles)
+		{
+			for (uint32_t corner = triangle * 3; corner < triangle * 3 + 3; corner++)
+			{
+				uvs[corner] = Subtract(uvs[corner], minimum);
+			}
+		}
+		m_charts[chart].numTriangles = uint32_t(triangles.size());
+	}
+}
+
+void LightmapBaker::PackCharts()
+{
+	const uint32_t numObjects = uint32_t(m_objectCharts.size());
+	const uint32_t atlasSize = m_settings.atlasSize;
+	const uint32_t gutter = m_settings.gutter;
+
+	// Chart extents in object units, and the object scale from the transform
+	std::vector<Float2> extents(m_charts.size(), { 0.0f, 0.0f });
+	std::vector<float> objectDensities(numObjects);
+	std::vector<float> objectAreas(numObjects, 0.0f);
+	for (uint32_t object = 0; object < numObjects; object++)
+	{
+		const float (&m)[4][4] = m_pScene->objects[object].objectToWorld.m;
+		float scale = 0.0f;
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			scale = std::max(scale, Length(Float3{ m[row][0], m[row][1], m[row][2] }));
+		}
+		objectDensities[object] = m_settings.texelsPerUnit * scale;
+		for (uint32_t chart : m_objectCharts[object])
+		{
+			for (uint32_t triangle : m_chartTriangles[chart])
+			{
+				for (uint32_t corner = triangle * 3; corner < triangle * 3 + 3; corner++)
+				{
+					const Float2& uv = m_objectUVs[object][corner];
+					extents[chart] = { std::max(extents[chart].x, uv.x), std::max(extents[chart].y, uv.y) };
+				}
+			}
+			objectAreas[object] += extents[chart].x * extents[chart].y * objectDensities[object] * objectDensities[object];
+		}
+	}
+
+	// Large objects first, tall charts first within an object
+	std::vector<uint32_t> objectOrder(numObjects);
+	for (uint32_t object = 0; object < numObjects; object++)
+	{
+		objectOrder[object] = object;
+	}
+	std::stable_sort(objectOrder.begin(), objectOrder.end(), [&](uint32_t a, uint32_t b) { return objectAreas[a] > objectAreas[b]; });
+
+	std::vector<SkylinePacker> packers;
+	for (uint32_t object : objectOrder)
+	{
+		std::vector<uint32_t> charts = m_objectCharts[object];
+		std::stable_sort(charts.begin(), charts.end(), [&](uint32_t a, uint32_t b) { return extents[a].y > extents[b].y; });
+
+		bool bPacked = charts.empty();
+		float density = objectDensities[object];
+		for (uint32_t halving = 0; halving <= MaxDensityHalvings && !bPacked; halving++, density *= 0.5f)
+		{
+			bool bFits = true;
+			for (uint32_t chart : charts)
+			{
+				LightmapChart& target = m_charts[chart];
+				target.width = uint32_t(std::ceil(extents[chart].x * density + 1.0f));
+				target.height = uint32_t(std::ceil(extents[chart].y * density + 1.0f));
+				bFits &= target.width + 2 * gutter <= atlasSize && target.height + 2 * gutter <= atlasSize;
+			}
+			if (!bFits)
+			{
+				continue;
+			}
+
+			// All charts of the object into the first atlas that takes them, a new atlas as the last resort
+			for (uint32_t atlas = 0; atlas <= packers.size() && !bPacked; atlas++)
+			{
+				SkylinePacker packer = atlas < packers.size() ? packers[atlas] : SkylinePacker(atlasSize);
+				bPacked = true;
+				for (uint32_t chart : charts)
+				{
+					LightmapChart& target = m_charts[chart];
+					bPacked &= packer.Insert(target.width + 2 * gutter, target.height + 2 * gutter, target.x, target.y);
+					target.x += gutter;
+					target.y += gutter;
+					target.atlas = atlas;
+				}
+				if (bPacked)
+				{
+					if (atlas == packers.size())
+					{
+						packers.push_back(packer);
+					}
+					else
+					{
+						packers[atlas] = packer;
+					}
+					m_objectAtlases[object] = atlas;
+				}
+			}
+			if (bPacked)
+			{
+				// Object units to atlas UVs, the chart's corner lands on a texel center
+				for (uint32_t chart : charts)
+				{
+					const LightmapChart& target = m_charts[chart];
+					for (uint32_t triangle : m_chartTriangles[chart])
+					{
+						for (uint32_t corner = triangle * 3; corner < triangle * 3 + 3; corner++)
+						{
+							Float2& uv = m_objectUVs[object][corner];
+							uv = { (uv.x * density + 0.5f + float(target.x)) / float(atlasSize), (uv.y * density + 0.5f + float(target.y)) / float(atlasSize) };
+						}
+					}
+				}
+			}
+		}
+		if (!bPacked)
+		{
+			throw std::runtime_error("Can not pack lightmap: an object has too many charts for one atlas");
+		}
+	}
+
+	m_atlases.resize(packers.size());
+	for (LightmapAtlas& atlas : m_atlases)
+	{
+		atlas.irradiance.assign(size_t(atlasSize) * atlasSize, { 0.0f, 0.0f, 0.0f });
+		atlas.coverage.assign(size_t(atlasSize) * atlasSize, LightmapCoverage::Empty);
+	}
+}
+
+void LightmapBaker::RasterizeChart(uint32_t chart)
+{
+	LightmapChart& target = m_charts[chart];
+	const LightmapObject& source = m_pScene->objects[target.object];
+	const Float4x4 worldToObject = MatrixInverseAffine(source.objectToWorld);
+	const uint32_t atlasSize = m_settings.atlasSize;
+	const std::vector<Float2>& uvs = m_objectUVs[target.object];
+
+	// Closest triangle per texel, distance 0 when the center is inside
+	struct Candidate
+	{
+		float		distance = FLT_MAX;
+		uint32_t	triangle = InvalidIndex;
+		float		weights[3] = {};
+	};
+	std::vector<Candidate> candidates(size_t(target.width) * target.height);
+	const Float2 origin = { float(target.x), float(target.y) };
+	target.worldBounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	for (uint32_t triangle : m_chartTriangles[chart])
+	{
+		Float2 corners[3];
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			corners[corner] = Subtract({ uvs[triangle * 3 + corner].x * float(atlasSize), uvs[triangle * 3 + corner].y * float(atlasSize) }, origin);
+			const Float3 position = TransformPoint(source.positions[source.indices[triangle * 3 + corner]], source.objectToWorld);
+			target.worldBounds = { Min(target.worldBounds.min, position), Max(target.worldBounds.max, position) };
+		}
+		const float area = Cross2(Subtract(corners[1], corners[0]), Subtract(corners[2], corners[0]));
+		if (std::fabs(area) < 1e-12f)
+		{
+			continue;
+		}
+		auto getWeights = [&](const Float2& point, float (&weights)[3])
+		{
+			weights[0] = Cross2(Subtract(corners[1], point), Subtract(corners[2], point)) / area;
+			weights[1] = Cross2(Subtract(corners[2], point), Subtract(corners[0], point)) / area;
+			weights[2] = 1.0f - weights[0] - weights[1];
+		};
+
+		const float minX = std::min({ corners[0].x, corners[1].x, corners[2].x });
+		const float maxX = std::max({ corners[0].x, corners[1].x, corners[2].x });
+		const float minY = std::min({ corners[0].y, corners[1].y, corners[2].y });
+		const float maxY = std::max({ corners[0].y, corners[1].y, corners[2].y });
+		const uint32_t x0 = uint32_t(std::max(minX - 1.0f, 0.0f));
+		const uint32_t y0 = uint32_t(std::max(minY - 1.0f, 0.0f));
+		const uint32_t x1 = std::min(uint32_t(std::max(maxX + 1.0f, 0.0f)), target.width - 1);
+		const uint32_t y1 = std::min(uint32_t(std::max(maxY + 1.0f, 0.0f)), target.height - 1);
+		for (uint32_t y = y0; y <= y1; y++)
+		{
+			for (uint32_t x = x0; x <= x1; x++)
+			{
+				const Float2 center = { float(x) + 0.5f, float(y) + 0.5f };
+				Candidate candidate;
+				candidate.triangle = triangle;
+				getWeights(center, candidate.weights);
+				if (candidate.weights[0] >= 0.0f && candidate.weights[1] >= 0.0f && candidate.weights[2] >= 0.0f)
+				{
+					candidate.distance = 0.0f;
+				}
+				else
+				{
+					// Closest point on the edges
+					for (uint32_t edge = 0; edge < 3; edge++)
+					{
+						const Float2& a = corners[edge];
+						const Float2 ab = Subtract(corners[(edge + 1) % 3], a);
+						const Float2 ac = Subtract(center, a);
+						const float t = std::clamp((ab.x * ac.x + ab.y * ac.y) / std::max(ab.x * ab.x + ab.y * ab.y, 1e-12f), 0.0f, 1.0f);
+						const Float2 closest = Lerp(a, corners[(edge + 1) % 3], t);
+						const float distance = Length(Subtract(center, closest));
+						if (distance < candidate.distance)
+						{
+							candidate.distance = distance;
+							getWeights(closest, candidate.weights);
+						}
+					}
+					if (candidate.distance > HalfTexelDiagonal)
+					{
+						continue;
+					}
+				}
+				Candidate& best = candidates[size_t(y) * target.width + x];
+				if (candidate.distance < best.distance)
+				{
+					best = candidate;
+				}
+			}
+		}
+	}
+
+	// The gutter belongs to the chart, cleared for dilation
+	LightmapAtlas& atlas = m_atlases[target.atlas];
+	const uint32_t gutter = m_settings.gutter;
+	for (uint32_t y = target.y - gutter; y < target.y + target.height + gutter; y++)
+	{
+		std::fill_n(atlas.coverage.begin() + (size_t(y) * atlasSize + target.x - gutter), target.width + 2 * gutter, LightmapCoverage::Empty);
+	}
+
+	std::vector<Texel>& texels = m_chartTexels[chart];
+	texels.clear();
+	for (uint32_t y = 0; y < target.height; y++)
+	{
+		for (uint32_t x = 0; x < target.width; x++)
+		{
+			const Candidate& candidate = candidates[size_t(y) * target.width + x];
+			if (candidate.triangle == InvalidIndex)
+			{
+				continue;
+			}
+			const uint32_t* pTriangle = &source.indices[candidate.triangle * 3];
+			Float3 position = { 0.0f, 0.0f, 0.0f };
+			Float3 normal = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				position = position + source.positions[pTriangle[corner]] * candidate.weights[corner];
+				if (!source.normals.empty())
+				{
+					normal = normal + source.normals[pTriangle[corner]] * candidate.weights[corner];
+				}
+			}
+			if (Dot(normal, normal) <= 0.0f)
+			{
+				const Float3& p0 = source.positions[pTriangle[0]];
+				normal = Cross(source.positions[pTriangle[1]] - p0, source.positions[pTriangle[2]] - p0);
+			}
+			normal = TransformNormal(normal, worldToObject);
+
+			Texel texel = {};
+			texel.position = TransformPoint(position, source.objectToWorld);
+			texel.normal = Normalize(normal);
+			texel.index = (target.y + y) * atlasSize + target.x + x;
+			texels.push_back(texel);
+			atlas.coverage[texel.index] = candidate.distance == 0.0f ? LightmapCoverage::Inside : LightmapCoverage::Edge;
+		}
+	}
+	target.numTexels = uint32_t(texels.size());
+}
+
+void LightmapBaker::FindSeams()
+{
+	const float atlasSize = float(m_settings.atlasSize);
+	struct EdgeSide
+	{
+		uint32_t	chart;
+		Float2		start;		// At the lower vertex index
+		Float2		end;
+	};
+	for (uint32_t object = 0; object < m_objectCharts.size(); object++)
+	{
+		const std::vector<uint32_t>& indices = m_pScene->objects[object].indices;
+		const std::vector<Float2>& uvs = m_objectUVs[object];
+		std::unordered_map<uint64_t, EdgeSide> edges;
+		for (uint32_t chart : m_objectCharts[object])
+		{
+			for (uint32_t triangle : m_chartTriangles[chart])
+			{
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t a = triangle * 3 + corner;
+					const uint32_t b = triangle * 3 + (corner + 1) % 3;
+					const bool bSwap = indices[a] > indices[b];
+					const uint64_t key = uint64_t(indices[bSwap ? b : a]) << 32 | indices[bSwap ? a : b];
+					const Float2& start = uvs[bSwap ? b : a];
+					const Float2& end = uvs[bSwap ? a : b];
+					const EdgeSide side = { chart, { start.x * atlasSize, start.y * atlasSize }, { end.x * atlasSize, end.y * atlasSize } };
+					const auto result = edges.try_emplace(key, side);
+					if (!result.second && result.first->second.chart != chart)
+					{
+						const EdgeSide& other = result.first->second;
+						m_seams.push_back({ { other.chart, chart }, { other.start, side.start }, { other.end, side.end } });
+					}
+				}
+			}
+		}
+	}
+}
+
+void LightmapBaker::InvalidateBounds(const BoundingBox& bounds)
+{
+	for (uint32_t chart = 0; chart < m_charts.size(); chart++)
+	{
+		if (Overlaps(m_charts[chart].worldBounds, bounds))
+		{
+			m_chartBaked[chart] = 0;
+		}
+	}
+}
+
+void LightmapBaker::InvalidateObject(uint32_t object, const Float4x4& previousObjectToWorld)
+{
+	const LightmapObject& source = m_pScene->objects[object];
+	m_objectMoved[object] = 1;
+	for (uint32_t chart : m_objectCharts[object])
+	{
+		m_chartBaked[chart] = 0;
+	}
+	if (source.positions.empty())
+	{
+		return;
+	}
+
+	BoundingBox localBounds = { source.positions[0], source.positions[0] };
+	for (const Float3& position : source.positions)
+	{
+		localBounds = { Min(localBounds.min, position), Max(localBounds.max, position) };
+	}
+	const BoundingBox previousBounds = TransformBounds(localBounds, previousObjectToWorld);
+	const BoundingBox currentBounds = TransformBounds(localBounds, source.objectToWorld);
+	const BoundingBox bounds = { Min(previousBounds.min, currentBounds.min), Max(previousBounds.max, currentBounds.max) };
+	InvalidateBounds(Expand(bounds, m_settings.influenceDistance));
+
+	// Shadows of the sun: the box swept along the sun direction through the scene
+	const LightmapScene& scene = *m_pScene;
+	if (std::max({ scene.sunIlluminance.x, scene.sunIlluminance.y, scene.sunIlluminance.z }) > 0.0f)
+	{
+		BoundingBox sceneBounds = bounds;
+		for (const LightmapChart& chart : m_charts)
+		{
+			sceneBounds = { Min(sceneBounds.min, chart.worldBounds.min), Max(sceneBounds.max, chart.worldBounds.max) };
+		}
+		const Float3 sweep = Normalize(scene.sunDirection) * Length(sceneBounds.max - sceneBounds.min);
+		InvalidateBounds({ Min(bounds.min, bounds.min + sweep), Max(bounds.max, bounds.max + sweep) });
+	}
+
+	// Shadows of the lights reaching the object
+	const LightList& lights = scene.lights;
+	for (uint32_t light = 0; light < lights.GetNumLights(); light++)
+	{
+		const Float3 position = { lights.positionX[light], lights.positionY[light], lights.positionZ[light] };
+		if (Overlaps(Expand({ position, position }, lights.radius[light]), bounds))
+		{
+			InvalidateLight(position, lights.radius[light]);
+		}
+	}
+}
+
+void LightmapBaker::InvalidateLight(const Float3& position, float radius)
+{
+	InvalidateBounds(Expand({ position, position }, radius + m_settings.influenceDistance));
+}
+
+void LightmapBaker::InvalidateAll()
+{
+	std::fill(m_chartBaked.begin(), m_chartBaked.end(), uint8_t(0));
+}
+
+void LightmapBaker::UpdateTraceScene()
+{
+	m_traceScene.Clear();
+	m_traceScene.materials = m_pScene->materials;
+	std::vector<Float3> positions;
+	for (const LightmapObject& object : m_pScene->objects)
+	{
+		positions.resize(object.positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			positions[i] = TransformPoint(object.positions[i], object.objectToWorld);
+		}
+		m_traceScene.AddTriangles(positions.data(), nullptr, uint32_t(positions.size()), object.indices.data(), uint32_t(object.indices.size()), object.material);
+	}
+	m_pathTracer.SetScene(m_traceScene);
+	m_bTraceSceneValid = true;
+}
+
+LightmapBakeStatistics LightmapBaker::Bake(const LightmapProgressCallback& progress)
+{
+	if (!m_pScene)
+	{
+		throw std::runtime_error("LightmapBaker::Bake() without a scene");
+	}
+	const auto startTime = std::chrono::steady_clock::now();
+
+	// Moved objects get new texel positions and a new BVH
+	std::vector<uint32_t> movedCharts;
+	for (uint32_t object = 0; object < m_objectMoved.size(); object++)
+	{
+		if (m_objectMoved[object])
+		{
+			movedCharts.insert(movedCharts.end(), m_objectCharts[object].begin(), m_objectCharts[object].end());
+			m_objectMoved[object] = 0;
+			m_bTraceSceneValid = false;
+		}
+	}
+	RunParallel(m_pJobSystem, uint32_t(movedCharts.size()), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			RasterizeChart(movedCharts[i]);
+		}
+	});
+	if (!m_bTraceSceneValid)
+	{
+		UpdateTraceScene();
+	}
+	m_traceScene.lights = m_pScene->lights;
+	m_traceScene.sunDirection = m_pScene->sunDirection;
+	m_traceScene.sunIlluminance = m_pScene->sunIlluminance;
+	m_traceScene.pEnvironment = m_pScene->pEnvironment;
+	m_traceScene.skyRadiance = m_pScene->skyRadiance;
+
+	// Texel batches of the charts to bake
+	struct Batch
+	{
+		uint32_t chart;
+		uint32_t begin;
+		uint32_t end;
+	};
+	std::vector<Batch> batches;
+	std::vector<uint8_t> atlasChanged(m_atlases.size(), 0);
+	LightmapBakeStatistics statistics;
+	statistics.numCharts = uint32_t(m_charts.size());
+	for (uint32_t chart = 0; chart < m_charts.size(); chart++)
+	{
+		if (m_chartBaked[chart])
+		{
+			continue;
+		}
+		const uint32_t numTexels = uint32_t(m_chartTexels[chart].size());
+		for (uint32_t begin = 0; begin < numTexels; begin += TexelBatchSize)
+		{
+			batches.push_back({ chart, begin, std::min(begin + TexelBatchSize, numTexels) });
+		}
+		statistics.numBakedCharts++;
+		statistics.numTexels += numTexels;
+		atlasChanged[m_charts[chart].atlas] = 1;
+	}
+
+	// Progress is reported between slices of the batches
+	std::atomic<uint64_t> numRays = 0;
+	uint64_t numBakedTexels = 0;
+	const uint32_t numBatches = uint32_t(batches.size());
+	for (uint32_t step = 0; step < NumProgressSteps && numBatches > 0; step++)
+	{
+		const uint32_t sliceBegin = uint32_t(uint64_t(numBatches) * step / NumProgressSteps);
+		const uint32_t sliceEnd = uint32_t(uint64_t(numBatches) * (step + 1) / NumProgressSteps);
+		if (sliceBegin == sliceEnd)
+		{
+			continue;
+		}
+		RunParallel(m_pJobSystem, sliceEnd - sliceBegin, 1, [&](uint32_t begin, uint32_t end)
+		{
+			uint64_t batchRays = 0;
+			for (uint32_t i = sliceBegin + begin; i < sliceBegin + end; i++)
+			{
+				BakeTexels(batches[i].chart, batches[i].begin, batches[i].end, batchRays);
+			}
+			numRays += batchRays;
+		});
+		for (uint32_t i = sliceBegin; i < sliceEnd; i++)
+		{
+			numBakedTexels += batches[i].end - batches[i].begin;
+		}
+		if (progress)
+		{
+			progress(numBakedTexels, statistics.numTexels);
+		}
+	}
+	for (uint32_t chart = 0; chart < m_charts.size(); chart++)
+	{
+		m_chartBaked[chart] = 1;
+	}
+
+	for (uint32_t atlas = 0; atlas < m_atlases.size(); atlas++)
+	{
+		if (atlasChanged[atlas])
+		{
+			DilateAtlas(atlas);
+		}
+	}
+	BlendSeams(atlasChanged);
+
+	statistics.numRays = numRays;
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	statistics.numThreads = m_pJobSystem->GetNumWorkerThreads() + 1;
+	return statistics;
+}
+
+void LightmapBaker::BakeTexels(uint32_t chart, uint32_t begin, uint32_t end, uint64_t& numRays)
+{
+	const uint32_t atlas = m_charts[chart].atlas;
+	std::vector<Float3>& irradiance = m_atlases[atlas].irradiance;
+	const uint32_t atlasTexels = m_settings.atlasSize * m_settings.atlasSize;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const Texel& texel = m_chartTexels[chart][i];
+		Float3 direct, indirect;
+		m_pathTracer.GatherIrradiance(texel.position, texel.normal, atlas * atlasTexels + texel.index, m_settings.numSamples, direct, indirect, numRays);
+		irradiance[texel.index] = direct + indirect;
+	}
+}
+
+void LightmapBaker::DilateAtlas(uint32_t atlasIndex)
+{
+	LightmapAtlas& atlas = m_atlases[atlasIndex];
+	const uint32_t size = m_settings.atlasSize;
+	for (LightmapCoverage& coverage : atlas.coverage)
+	{
+		if (coverage == LightmapCoverage::Dilated)
+		{
+			coverage = LightmapCoverage::Empty;
+		}
+	}
+
+	// Every pass grows the filled area by a texel, empty texels take the mean of their filled neighbors
+	std::vector<LightmapCoverage> sourceCoverage;
+	for (uint32_t pass = 0; pass < m_settings.gutter; pass++)
+	{
+		sourceCoverage = atlas.coverage;
+		RunParallel(m_pJobSystem, size, 16, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t y = begin; y < end; y++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+				{
+					const uint32_t index = y * size + x;
+					if (sourceCoverage[index] != LightmapCoverage::Empty)
+					{
+						continue;
+					}
+					Float3 sum = { 0.0f, 0.0f, 0.0f };
+					uint32_t count = 0;
+					for (uint32_t ny = y > 0 ? y - 1 : 0; ny <= std::min(y + 1, size - 1); ny++)
+					{
+						for (uint32_t nx = x > 0 ? x - 1 : 0; nx <= std::min(x + 1, size - 1); nx++)
+						{
+							const uint32_t neighbor = ny * size + nx;
+							// Texels filled in this pass are not read: they are written by other rows concurrently
+							if (sourceCoverage[neighbor] != LightmapCoverage::Empty)
+							{
+								sum = sum + atlas.irradiance[neighbor];
+								count++;
+							}
+						}
+					}
+					if (count > 0)
+					{
+						atlas.irradiance[index] = sum * (1.0f / float(count));
+						atlas.coverage[index] = LightmapCoverage::Dilated;
+					}
+				}
+			}
+		});
+	}
+}
+
+void LightmapBaker::BlendSeams(const std::vector<uint8_t>& atlasChanged)
+{
+	// Gauss-Seidel: every sample along a seam moves both sides' bilinear values to their mean
+	const uint32_t size = m_settings.atlasSize;
+	for (uint32_t iteration = 0; iteration < m_settings.seamIterations; iteration++)
+	{
+		for (const Seam& seam : m_seams)
+		{
+			const uint32_t atlas = m_charts[seam.charts[0]].atlas;
+			if (!atlasChanged[atlas])
+			{
+				continue;
+			}
+			std::vector<Float3>& irradiance = m_atlases[atlas].irradiance;
+			const float length = std::max(Length(Subtract(seam.end[0], seam.start[0])), Length(Subtract(seam.end[1], seam.start[1])));
+			const uint32_t numSamples = uint32_t(std::ceil(length * 2.0f)) + 1;
+			for (uint32_t sample = 0; sample < numSamples; sample++)
+			{
+				const float t = (float(sample) + 0.5f) / float(numSamples);
+				const BilinearFootprint a = GetBilinearFootprint(Lerp(seam.start[0], seam.end[0], t), size);
+				const BilinearFootprint b = GetBilinearFootprint(Lerp(seam.start[1], seam.end[1], t), size);
+				const Float3 halfDifference = (SampleBilinear(irradiance, b) - SampleBilinear(irradiance, a)) * 0.5f;
+				AddBilinear(irradiance, a, halfDifference);
+				AddBilinear(irradiance, b, halfDifference * -1.0f);
+			}
+		}
+	}
+}
+
+std::vector<uint8_t> CookLightmap(const LightmapBaker& baker)
+{
+	const std::vector<LightmapAtlas>& atlases = baker.GetAtlases();
+	if (atlases.empty())
+	{
+		throw std::runtime_error("Can not cook lightmap: the baker has no charts");
+	}
+
+	LightmapFileHeader header = {};
+	header.magic = LightmapMagic;
+	header.version = LightmapVersion;
+	header.atlasSize = baker.GetSettings().atlasSize;
+	header.numAtlases = uint32_t(atlases.size());
+	header.numObjects = baker.GetNumObjects();
+	for (uint32_t object = 0; object < header.numObjects; object++)
+	{
+		header.numUVs += uint32_t(baker.GetObjectUVs(object).size());
+	}
+	header.objectOffset = GetLightmapAlignedSize(sizeof(header));
+	header.uvOffset = GetLightmapAlignedSize(header.objectOffset + uint64_t(header.numObjects) * sizeof(LightmapFileObject));
+	header.atlasOffset = GetLightmapAlignedSize(header.uvOffset + uint64_t(header.numUVs) * sizeof(Float2));
+	const uint64_t planeStride = GetLightmapPlaneStride(header.atlasSize);
+	header.fileSize = header.atlasOffset + planeStride * header.numAtlases;
+
+	std::vector<uint8_t> data(header.fileSize, 0);
+	memcpy(data.data(), &header, sizeof(header));
+	LightmapFileObject* pObjects = reinterpret_cast<LightmapFileObject*>(data.data() + header.objectOffset);
+	uint32_t firstUV = 0;
+	for (uint32_t object = 0; object < header.numObjects; object++)
+	{
+		const std::vector<Float2>& uvs = baker.GetObjectUVs(object);
+		pObjects[object] = { baker.GetObjectAtlas(object), firstUV, uint32_t(uvs.size()), 0 };
+		memcpy(data.data() + header.uvOffset + uint64_t(firstUV) * sizeof(Float2), uvs.data(), uvs.size() * sizeof(Float2));
+		firstUV += uint32_t(uvs.size());
+	}
+	for (uint32_t atlas = 0; atlas < header.numAtlases; atlas++)
+	{
+		Half4* pPlane = reinterpret_cast<Half4*>(data.data() + header.atlasOffset + atlas * planeStride);
+		const std::vector<Float3>& irradiance = atlases[atlas].irradiance;
+		for (size_t texel = 0; texel < irradiance.size(); texel++)
+		{
+			pPlane[texel] = { FloatToHalf(irradiance[texel].x), FloatToHalf(irradiance[texel].y), FloatToHalf(irradiance[texel].z), 0 };
+		}
+	}
+	return data;
+}
+
+void WriteLightmapFile(const std::wstring& fileName, const std::vector<uint8_t>& cookedLightmap)
+{
+	WriteFileAtomically(fileName, cookedLightmap.data(), cookedLightmap.size());
+}
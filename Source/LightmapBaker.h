@@ -0,0 +1,186 @@
+#pragma once
+
+// Offline side of Lightmap.h: charts, packs and bakes lightmaps of static objects and cooks the .lightmap file
+// Charts come from box projection: triangles of an object that face the same major axis and share vertices form a
+// chart, projected onto that axis plane in object space, so planar and boxy geometry maps without distortion.
+// Charts are packed into square atlases by a skyline packer, all charts of an object into the same atlas, and
+// rasterized once into texels with a world position and normal. Texels whose center misses every triangle but whose
+// square touches one are kept too (conservative), so bilinear filtering at chart borders never reads the gutter.
+//
+// Baking is texel parallel on the JobSystem through the PathTracer: lights and the sun are sampled with shadow
+// rays, sky and bounce light are gathered with cosine weighted paths. Every texel draws its random numbers from its
+// atlas position, so it bakes to the same value whatever else is baked with it. Afterwards the gutters are dilated
+// and the seams between charts are blended, so filtering on both sides of a seam sees the same values.
+//
+// Scene edits invalidate the charts they can reach (Invalidate*()), the next Bake() only recomputes those. Bounce
+// light is assumed to matter within `influenceDistance` of an edit, shadows of moved objects are followed along the
+// sun direction through the whole scene.
+
+#include "Lightmap.h"
+#include "PathTracer.h"
+
+#include <functional>
+#include <vector>
+
+struct LightmapObject
+{
+	std::vector<Float3>		positions;			// Object space
+	std::vector<Float3>		normals;			// Per vertex, optional: face normals when empty
+	std::vector<uint32_t>	indices;
+	Float4x4				objectToWorld = MatrixIdentity();
+	uint32_t				material = 0;
+};
+
+struct LightmapScene
+{
+	std::vector<LightmapObject>		objects;
+	std::vector<PathTracerMaterial>	materials;
+
+	// Same meaning as in PathTracerScene
+	LightList				lights;
+	Float3					sunDirection = { 0.0f, -1.0f, 0.0f };
+	Float3					sunIlluminance = { 0.0f, 0.0f, 0.0f };
+	const RadianceCubemap*	pEnvironment = nullptr;
+	Float3					skyRadiance = { 0.0f, 0.0f, 0.0f };
+};
+
+struct LightmapSettings
+{
+	float		texelsPerUnit = 8.0f;		// World space density, objects that do not fit into an atlas get less
+	uint32_t	atlasSize = 512;
+	uint32_t	gutter = 2;					// Texels around every chart, filled by dilation
+	uint32_t	numSamples = 64;			// Gather paths per texel
+	uint32_t	maxBounces = 4;
+	uint32_t	seamIterations = 8;
+	float		influenceDistance = 4.0f;	// World units
+	uint32_t	seed = 0;
+};
+
+struct LightmapChart
+{
+	uint32_t	object;
+	uint32_t	atlas;
+	uint32_t	x;				// Atlas texels, the gutter is outside
+	uint32_t	y;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	numTriangles;
+	uint32_t	numTexels;		// Covered texels
+	BoundingBox	worldBounds;
+};
+
+enum class LightmapCoverage : uint8_t
+{
+	Empty,
+	Edge,			// The texel square touches a triangle
+	Inside,			// The texel center is inside a triangle
+	Dilated,		// Gutter
+};
+
+struct LightmapAtlas
+{
+	std::vector<Float3>				irradiance;		// atlasSize * atlasSize, row major
+	std::vector<LightmapCoverage>	coverage;
+};
+
+struct LightmapBakeStatistics
+{
+	uint32_t	numCharts = 0;
+	uint32_t	numBakedCharts = 0;
+	uint64_t	numTexels = 0;		// Baked
+	uint64_t	numRays = 0;
+	double		seconds = 0.0;
+	uint32_t	numThreads = 1;		// Workers plus the calling thread
+
+	double GetTexelsPerSecond() const { return seconds > 0.0 ? double(numTexels) / seconds : 0.0; }
+};
+
+// Called on the thread calling Bake()
+using LightmapProgressCallback = std::function<void(uint64_t numBakedTexels, uint64_t numTexels)>;
+
+class LightmapBaker
+{
+public:
+	enum : uint32_t
+	{
+		TexelBatchSize = 64,
+		NumProgressSteps = 32,
+		MaxDensityHalvings = 16,
+	};
+
+	explicit LightmapBaker(JobSystem* pJobSystem, const LightmapSettings& settings = {});
+
+	// Charts, packs and rasterizes the scene, which must outlive the baker. Every chart needs baking afterwards.
+	// Throws std::runtime_error for invalid indices or materials
+	void SetScene(const LightmapScene& scene);
+
+	// Call after editing the scene, before the next Bake(). The scene already holds the new transform
+	void InvalidateObject(uint32_t object, const Float4x4& previousObjectToWorld);
+	// A light was added, removed or changed. A moved light is invalidated at the old and at the new position
+	void InvalidateLight(const Float3& position, float radius);
+	// Sun, sky or materials changed
+	void InvalidateAll();
+
+	// Bakes the invalidated charts, then dilates and blends the seams of their atlases. Blocks until done
+	LightmapBakeStatistics Bake(const LightmapProgressCallback& progress = {});
+
+	const LightmapSettings& GetSettings() const { return m_settings; }
+	uint32_t GetNumObjects() const { return uint32_t(m_objectUVs.size()); }
+	const std::vector<LightmapChart>& GetCharts() const { return m_charts; }
+	bool IsChartBaked(uint32_t chart) const { return m_chartBaked[chart] != 0; }
+	const std::vector<LightmapAtlas>& GetAtlases() const { return m_atlases; }
+	uint32_t GetObjectAtlas(uint32_t object) const { return m_objectAtlases[object]; }
+	// Per index of the object, in [0, 1] of its atlas
+	const std::vector<Float2>& GetObjectUVs(uint32_t object) const { return m_objectUVs[object]; }
+
+private:
+	struct Texel
+	{
+		Float3		position;
+		uint32_t	index;			// In the atlas
+		Float3		normal;
+		uint32_t	reserved;
+	};
+
+	// Chart border shared by two charts of the same object, endpoints in atlas texels
+	struct Seam
+	{
+		uint32_t	charts[2];
+		Float2		start[2];
+		Float2		end[2];
+	};
+
+	void BuildCharts(uint32_t object);
+	void PackCharts();
+	void RasterizeChart(uint32_t chart);
+	void FindSeams();
+	void InvalidateBounds(const BoundingBox& bounds);
+	void UpdateTraceScene();
+	void BakeTexels(uint32_t chart, uint32_t begin, uint32_t end, uint64_t& numRays);
+	void DilateAtlas(uint32_t atlas);
+	void BlendSeams(const std::vector<uint8_t>& atlasChanged);
+
+	JobSystem*								m_pJobSystem;
+	LightmapSettings						m_settings;
+	const LightmapScene*					m_pScene = nullptr;
+
+	std::vector<LightmapChart>				m_charts;
+	std::vector<std::vector<uint32_t>>		m_chartTriangles;	// Triangle indices of the object
+	std::vector<std::vector<Texel>>			m_chartTexels;
+	std::vector<uint8_t>					m_chartBaked;
+	std::vector<Seam>						m_seams;
+	std::vector<LightmapAtlas>				m_atlases;
+	std::vector<uint32_t>					m_objectAtlases;
+	std::vector<std::vector<Float2>>		m_objectUVs;
+	std::vector<std::vector<uint32_t>>		m_objectCharts;
+	std::vector<uint8_t>					m_objectMoved;		// Texels and the trace scene are out of date
+
+	PathTracerScene							m_traceScene;		// World space copy of the objects
+	PathTracer								m_pathTracer;
+	bool									m_bTraceSceneValid = false;
+};
+
+// Throws std::runtime_error if the baker has no scene
+std::vector<uint8_t> CookLightmap(const LightmapBaker& baker);
+// Writes a temporary and renames it, readers never see a partial file. Throws FileIOException
+void WriteLightmapFile(const std::wstring& fileName, const std::vector<uint8_t>& cookedLightmap);
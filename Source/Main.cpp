@@ -1,6 +1,14 @@
-#include "Win32Application.h"
 #include "Engine.h"
 
+#if defined(_WIN32)
+	#include "Win32Application.h"
+#else
+	#include <cstdio>
+	#include <filesystem>
+#endif
+
+#if defined(_WIN32)
+
 _Use_decl_annotations_
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
@@ -11,3 +19,32 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 	return Win32Application::Run(&engine, hInstance, nCmdShow);
 }
 
+#else
+
+// No window system here, only headless runs: LightingEffects --headless [options]
+int main(int argc, char* argv[])
+{
+	std::vector<std::wstring> args(argc);
+	for (int i = 0; i < argc; i++)
+	{
+		args[i] = std::filesystem::path(argv[i]).wstring();
+	}
+	std::vector<wchar_t*> wideArgv(argc);
+	for (int i = 0; i < argc; i++)
+	{
+		wideArgv[i] = args[i].data();
+	}
+
+	const uint32_t width = 1280;
+	const uint32_t height = 720;
+	const wchar_t* title = L"Lighting Effects";
+	Engine engine(width, height, title, RHIBackend::Null);
+	if (!engine.ParseCommandLineArgs(wideArgv.data(), argc) || !engine.IsHeadless())
+	{
+		fputs(Engine::GetCommandLineUsage(), stderr);
+		return 1;
+	}
+	return engine.RunHeadless();
+}
+
+#endif
@@ -0,0 +1,479 @@
+#include "MeshBuilder.h"
+#include "FileIO.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cfloat>
+#include <cmath>
+#include <filesystem>
+#include <unordered_map>
+
+namespace
+{
+	[[noreturn]] void ThrowInvalidMeshData(const char* reason)
+	{
+		throw std::runtime_error(std::string("Can not cook mesh: ") + reason);
+	}
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint16_t QuantizeUnorm16(float value, float minimum, float extent)
+	{
+		const float normalized = extent > 0.0f ? (value - minimum) / extent : 0.0f;
+		return uint16_t(std::lround(std::clamp(normalized, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	int8_t QuantizeSnorm8(float value)
+	{
+		return int8_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f));
+	}
+
+	struct PendingSection
+	{
+		MeshSectionType		type;
+		uint32_t			stride;
+		const void*			pData;
+		uint64_t			size;
+	};
+
+	// Position/uv/normal indices of one OBJ face corner, ~0u when missing
+	struct ObjCorner
+	{
+		uint32_t position;
+		uint32_t texCoord;
+		uint32_t normal;
+
+		bool operator==(const ObjCorner& other) const { return position == other.position && texCoord == other.texCoord && normal == other.normal; }
+	};
+
+	struct ObjCornerHasher
+	{
+		size_t operator()(const ObjCorner& corner) const { return size_t(HashBytes(&corner, sizeof(corner))); }
+	};
+
+	class ObjParser
+	{
+	public:
+		ObjParser(const char* pText, size_t size) : m_pCursor(pText), m_pEnd(pText + size) {}
+
+		MeshData Parse();
+
+	private:
+		[[noreturn]] void ThrowParseError(const char* reason) const
+		{
+			throw std::runtime_error("OBJ line " + std::to_string(m_line) + ": " + reason);
+		}
+
+		void SkipSpaces()
+		{
+			while (m_pCursor < m_pEnd && (*m_pCursor == ' ' || *m_pCursor == '\t' || *m_pCursor == '\r'))
+			{
+				m_pCursor++;
+			}
+		}
+
+		void SkipLine()
+		{
+			const char* pNewLine = static_cast<const char*>(memchr(m_pCursor, '\n', size_t(m_pEnd - m_pCursor)));
+			m_pCursor = pNewLine ? pNewLine + 1 : m_pEnd;
+			m_line++;
+		}
+
+		bool AtEndOfLine() const { return m_pCursor >= m_pEnd || *m_pCursor == '\n' || *m_pCursor == '#'; }
+
+		std::string_view ReadToken()
+		{
+			SkipSpaces();
+			const char* pBegin = m_pCursor;
+			while (m_pCursor < m_pEnd && *m_pCursor != ' ' && *m_pCursor != '\t' && *m_pCursor != '\r' && *m_pCursor != '\n')
+			{
+				m_pCursor++;
+			}
+			return std::string_view(pBegin, size_t(m_pCursor - pBegin));
+		}
+
+		float ReadFloat()
+		{
+			SkipSpaces();
+			float value = 0.0f;
+			const std::from_chars_result result = std::from_chars(m_pCursor, m_pEnd, value);
+			if (result.ec != std::errc())
+			{
+				ThrowParseError("expected a number");
+			}
+			m_pCursor = result.ptr;
+			return value;
+		}
+
+		// 1 based, negative values are relative to the end of the list
+		uint32_t ReadIndex(size_t count)
+		{
+			int64_t value = 0;
+			const std::from_chars_result result = std::from_chars(m_pCursor, m_pEnd, value);
+			if (result.ec != std::errc())
+			{
+				ThrowParseError("expected an index");
+			}
+			m_pCursor = result.ptr;
+			const int64_t index = value < 0 ? int64_t(count) + value : value - 1;
+			if (value == 0 || index < 0 || index >= int64_t(count))
+			{
+				ThrowParseError("index out of range");
+			}
+			return uint32_t(index);
+		}
+
+		ObjCorner ReadCorner()
+		{
+			ObjCorner corner = { ~0u, ~0u, ~0u };
+			corner.position = ReadIndex(m_positions.size());
+			if (m_pCursor < m_pEnd && *m_pCursor == '/')
+			{
+				m_pCursor++;
+				if (m_pCursor < m_pEnd && *m_pCursor != '/')
+				{
+					corner.texCoord = ReadIndex(m_texCoords.size());
+				}
+				if (m_pCursor < m_pEnd && *m_pCursor == '/')
+				{
+					m_pCursor++;
+					corner.normal = ReadIndex(m_normals.size());
+				}
+			}
+			return corner;
+		}
+
+		uint32_t GetVertex(const ObjCorner& corner)
+		{
+			auto [it, bInserted] = m_vertices.try_emplace(corner, uint32_t(m_mesh.positions.size()));
+			if (bInserted)
+			{
+				m_mesh.positions.push_back(m_positions[corner.position]);
+				m_mesh.texCoords.push_back(corner.texCoord != ~0u ? m_texCoords[corner.texCoord] : Float2{ 0.0f, 0.0f });
+				m_mesh.normals.push_back(corner.normal != ~0u ? m_normals[corner.normal] : Float3{ 0.0f, 0.0f, 0.0f });
+				m_numMissingTexCoords += corner.texCoord == ~0u;
+				m_numMissingNormals += corner.normal == ~0u;
+			}
+			return it->second;
+		}
+
+		void CloseSubmesh()
+		{
+			const uint32_t firstIndex = m_mesh.submeshes.empty() ? 0 : m_mesh.submeshes.back().firstIndex + m_mesh.submeshes.back().numIndices;
+			const uint32_t numIndices = uint32_t(m_mesh.indices.size()) - firstIndex;
+			if (numIndices > 0)
+			{
+				m_mesh.submeshes.push_back({ firstIndex, numIndices, m_materialIndex });
+			}
+		}
+
+		const char*		m_pCursor;
+		const char*		m_pEnd;
+		uint32_t		m_line = 1;
+
+		std::vector<Float3>		m_positions;
+		std::vector<Float2>		m_texCoords;
+		std::vector<Float3>		m_normals;
+		std::unordered_map<ObjCorner, uint32_t, ObjCornerHasher>	m_vertices;
+		std::unordered_map<std::string, uint32_t>					m_materials;
+		uint32_t		m_materialIndex = 0;
+		size_t			m_numMissingTexCoords = 0;
+		size_t			m_numMissingNormals = 0;
+
+		MeshData		m_mesh;
+	};
+
+	MeshData ObjParser::Parse()
+	{
+		std::vector<uint32_t> polygon;
+		while (m_pCursor < m_pEnd)
+		{
+			const std::string_view keyword = ReadToken();
+			if (keyword == "v")
+			{
+				const float x = ReadFloat();
+				const float y = ReadFloat();
+				const float z = ReadFloat();
+				m_positions.push_back({ x, y, z });
+			}
+			else if (keyword == "vt")
+			{
+				const float u = ReadFloat();
+				const float v = ReadFloat();
+				// OBJ has the origin at the bottom left, D3D at the top left
+				m_texCoords.push_back({ u, 1.0f - v });
+			}
+			else if (keyword == "vn")
+			{
+				const float x = ReadFloat();
+				const float y = ReadFloat();
+				const float z = ReadFloat();
+				m_normals.push_back({ x, y, z });
+			}
+			else if (keyword == "f")
+			{
+				polygon.clear();
+				for (SkipSpaces(); !AtEndOfLine(); SkipSpaces())
+				{
+					polygon.push_back(GetVertex(ReadCorner()));
+				}
+				if (polygon.size() < 3)
+				{
+					ThrowParseError("face with less than 3 vertices");
+				}
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					m_mesh.indices.insert(m_mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+				}
+			}
+			else if (keyword == "usemtl")
+			{
+				CloseSubmesh();
+				SkipSpaces();
+				const std::string_view name = ReadToken();
+				auto [it, bInserted] = m_materials.try_emplace(std::string(name), uint32_t(m_mesh.materialNames.size()));
+				if (bInserted)
+				{
+					m_mesh.materialNames.emplace_back(name);
+				}
+				m_materialIndex = it->second;
+			}
+			// Groups, smoothing groups, material libraries and comments carry nothing the runtime uses
+			SkipLine();
+		}
+		CloseSubmesh();
+
+		if (m_numMissingTexCoords == m_mesh.positions.size())
+		{
+			m_mesh.texCoords.clear();
+		}
+		if (m_numMissingNormals > 0)
+		{
+			ComputeVertexNormals(m_mesh);
+		}
+		return std::move(m_mesh);
+	}
+}
+
+std::vector<uint8_t> CookMesh(const MeshData& mesh, const MeshCookOptions& options)
+{
+	const size_t numVertices = mesh.positions.size();
+	if (numVertices > UINT32_MAX || mesh.indices.size() > UINT32_MAX)
+	{
+		ThrowInvalidMeshData("too many vertices or indices");
+	}
+	if ((!mesh.normals.empty() && mesh.normals.size() != numVertices) || (!mesh.texCoords.empty() && mesh.texCoords.size() != numVertices))
+	{
+		ThrowInvalidMeshData("vertex stream sizes differ");
+	}
+	for (uint32_t index : mesh.indices)
+	{
+		if (index >= numVertices)
+		{
+			ThrowInvalidMeshData("index out of range");
+		}
+	}
+
+	std::vector<MeshSubmesh> submeshes;
+	if (mesh.submeshes.empty())
+	{
+		submeshes.push_back({ 0, uint32_t(mesh.indices.size()), 0, 0, {} });
+	}
+	for (const MeshSubmeshDesc& desc : mesh.submeshes)
+	{
+		if (desc.firstIndex > mesh.indices.size() || desc.numIndices > mesh.indices.size() - desc.firstIndex)
+		{
+			ThrowInvalidMeshData("submesh index range out of bounds");
+		}
+		if (!mesh.materialNames.empty() && desc.materialIndex >= mesh.materialNames.size())
+		{
+			ThrowInvalidMeshData("submesh material out of range");
+		}
+		submeshes.push_back({ desc.firstIndex, desc.numIndices, desc.materialIndex, 0, {} });
+	}
+	for (MeshSubmesh& submesh : submeshes)
+	{
+		submesh.bounds = ComputeBounds(mesh.positions.data(), mesh.indices.data() + submesh.firstIndex, submesh.numIndices);
+	}
+
+	MeshFileHeader header = {};
+	header.magic = MeshFileMagic;
+	header.version = MeshFileVersion;
+	header.numVertices = uint32_t(numVertices);
+	header.numIndices = uint32_t(mesh.indices.size());
+	header.numSubmeshes = uint32_t(submeshes.size());
+	header.numMaterials = uint32_t(mesh.materialNames.size());
+	header.indexSize = !options.bForce32BitIndices && numVertices <= 65536 ? 2 : 4;
+	header.bounds = ComputeBounds(mesh.positions.data(), nullptr, numVertices);
+
+	// Derived streams are built first so every section can point at its final bytes
+	std::vector<uint16_t> indices16;
+	if (header.indexSize == 2)
+	{
+		indices16.assign(mesh.indices.begin(), mesh.indices.end());
+	}
+
+	std::vector<uint16_t> quantizedPositions;
+	const bool bQuantizedPositions = options.bQuantizedPositions;
+	const bool bFloatPositions = options.bFloatPositions || !bQuantizedPositions;
+	if (bQuantizedPositions)
+	{
+		const MeshBounds& bounds = header.bounds;
+		const Float3 extent = { bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z };
+		quantizedPositions.resize(numVertices * 4);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			quantizedPositions[i * 4 + 0] = QuantizeUnorm16(mesh.positions[i].x, bounds.min.x, extent.x);
+			quantizedPositions[i * 4 + 1] = QuantizeUnorm16(mesh.positions[i].y, bounds.min.y, extent.y);
+			quantizedPositions[i * 4 + 2] = QuantizeUnorm16(mesh.positions[i].z, bounds.min.z, extent.z);
+			quantizedPositions[i * 4 + 3] = 0;
+		}
+	}
+
+	std::vector<int8_t> quantizedNormals;
+	const bool bHasNormals = !mesh.normals.empty();
+	if (bHasNormals && options.bQuantizedNormals)
+	{
+		quantizedNormals.resize(numVertices * 4);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			quantizedNormals[i * 4 + 0] = QuantizeSnorm8(mesh.normals[i].x);
+			quantizedNormals[i * 4 + 1] = QuantizeSnorm8(mesh.normals[i].y);
+			quantizedNormals[i * 4 + 2] = QuantizeSnorm8(mesh.normals[i].z);
+			quantizedNormals[i * 4 + 3] = 0;
+		}
+	}
+
+	std::vector<char> materialNames(mesh.materialNames.size() * MeshMaterialNameSize, '\0');
+	for (size_t i = 0; i < mesh.materialNames.size(); i++)
+	{
+		// Names longer than the slot are truncated, the terminator is always kept
+		memcpy(&materialNames[i * MeshMaterialNameSize], mesh.materialNames[i].data(), std::min<size_t>(mesh.materialNames[i].size(), MeshMaterialNameSize - 1));
+	}
+
+	std::vector<PendingSection> pendingSections;
+	auto addSection = [&](MeshSectionType type, uint32_t stride, const void* pData, size_t count)
+	{
+		pendingSections.push_back({ type, stride, pData, uint64_t(count) * stride });
+	};
+	if (bFloatPositions)
+	{
+		addSection(MeshSectionType::Positions, sizeof(Float3), mesh.positions.data(), numVertices);
+	}
+	if (bQuantizedPositions)
+	{
+		addSection(MeshSectionType::QuantizedPositions, 4 * sizeof(uint16_t), quantizedPositions.data(), numVertices);
+	}
+	if (bHasNormals && (options.bFloatNormals || !options.bQuantizedNormals))
+	{
+		addSection(MeshSectionType::Normals, sizeof(Float3), mesh.normals.data(), numVertices);
+	}
+	if (bHasNormals && options.bQuantizedNormals)
+	{
+		addSection(MeshSectionType::QuantizedNormals, 4 * sizeof(int8_t), quantizedNormals.data(), numVertices);
+	}
+	if (!mesh.texCoords.empty())
+	{
+		addSection(MeshSectionType::TexCoords, sizeof(Float2), mesh.texCoords.data(), numVertices);
+	}
+	addSection(MeshSectionType::Indices, header.indexSize, header.indexSize == 2 ? static_cast<const void*>(indices16.data()) : mesh.indices.data(), mesh.indices.size());
+	addSection(MeshSectionType::Submeshes, sizeof(MeshSubmesh), submeshes.data(), submeshes.size());
+	if (!materialNames.empty())
+	{
+		addSection(MeshSectionType::MaterialNames, MeshMaterialNameSize, materialNames.data(), mesh.materialNames.size());
+	}
+
+	header.numSections = uint32_t(pendingSections.size());
+	std::vector<MeshSection> sections;
+	uint64_t offset = sizeof(MeshFileHeader) + pendingSections.size() * sizeof(MeshSection);
+	for (const PendingSection& pending : pendingSections)
+	{
+		offset = AlignUp(offset, MeshSectionAlignment);
+		sections.push_back({ pending.type, pending.stride, offset, pending.size });
+		offset += pending.size;
+	}
+	header.fileSize = offset;
+
+	std::vector<uint8_t> data(size_t(header.fileSize), 0);
+	memcpy(data.data(), &header, sizeof(header));
+	memcpy(data.data() + sizeof(header), sections.data(), sections.size() * sizeof(MeshSection));
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		if (pendingSections[i].size > 0)
+		{
+			memcpy(data.data() + sections[i].offset, pendingSections[i].pData, size_t(pendingSections[i].size));
+		}
+	}
+	return data;
+}
+
+void WriteMeshFile(const std::wstring& fileName, const std::vector<uint8_t>& cookedMesh)
+{
+	WriteFileAtomically(fileName, cookedMesh.data(), cookedMesh.size());
+}
+
+MeshData ImportObj(const std::wstring& fileName)
+{
+	FileView view;
+	view.OpenOrThrow(fileName);
+	try
+	{
+		return ImportObjFromMemory(reinterpret_cast<const char*>(view.GetData()), size_t(view.GetSize()));
+	}
+	catch (const std::runtime_error& error)
+	{
+		throw std::runtime_error(std::filesystem::path(fileName).string() + ": " + error.what());
+	}
+}
+
+MeshData ImportObjFromMemory(const char* pText, size_t size)
+{
+	return ObjParser(pText, size).Parse();
+}
+
+void ComputeVertexNormals(MeshData& mesh)
+{
+	mesh.normals.assign(mesh.positions.size(), Float3{ 0.0f, 0.0f, 0.0f });
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		const Float3& p0 = mesh.positions[mesh.indices[i + 0]];
+		const Float3& p1 = mesh.positions[mesh.indices[i + 1]];
+		const Float3& p2 = mesh.positions[mesh.indices[i + 2]];
+		const Float3 e0 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		const Float3 e1 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		// Unnormalized cross product, its length is twice the triangle area
+		const Float3 faceNormal = { e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x };
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			Float3& normal = mesh.normals[mesh.indices[i + corner]];
+			normal.x += faceNormal.x;
+			normal.y += faceNormal.y;
+			normal.z += faceNormal.z;
+		}
+	}
+	for (Float3& normal : mesh.normals)
+	{
+		const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		normal = length > 0.0f ? Float3{ normal.x / length, normal.y / length, normal.z / length } : Float3{ 0.0f, 1.0f, 0.0f };
+	}
+}
+
+MeshBounds ComputeBounds(const Float3* pPositions, const uint32_t* pIndices, size_t numIndices)
+{
+	if (numIndices == 0)
+	{
+		return {};
+	}
+	MeshBounds bounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	for (size_t i = 0; i < numIndices; i++)
+	{
+		const Float3& position = pPositions[pIndices ? pIndices[i] : i];
+		bounds.min = { std::min(bounds.min.x, position.x), std::min(bounds.min.y, position.y), std::min(bounds.min.z, position.z) };
+		bounds.max = { std::max(bounds.max.x, position.x), std::max(bounds.max.y, position.y), std::max(bounds.max.z, position.z) };
+	}
+	return bounds;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Offline side of MeshFile.h: in-memory meshes, Wavefront OBJ import and cooking into the binary format.
+// Used by the MeshCooker tool and tests, runtime code only loads cooked files.
+
+#include "MeshFile.h"
+
+#include <vector>
+
+struct MeshSubmeshDesc
+{
+	uint32_t firstIndex;
+	uint32_t numIndices;
+	uint32_t materialIndex;
+};
+
+// Triangle list. Optional streams are either empty or one element per position
+struct MeshData
+{
+	std::vector<Float3>				positions;
+	std::vector<Float3>				normals;
+	std::vector<Float2>				texCoords;
+	std::vector<uint32_t>			indices;
+	// Empty means a single submesh over all indices
+	std::vector<MeshSubmeshDesc>	submeshes;
+	std::vector<std::string>		materialNames;
+};
+
+struct MeshCookOptions
+{
+	bool bFloatPositions = true;
+	bool bFloatNormals = true;
+	// 16 bit unorm positions within the mesh bounds, 8 bit snorm normals
+	bool bQuantizedPositions = false;
+	bool bQuantizedNormals = false;
+	// Otherwise 16 bit indices are used whenever all vertices are addressable
+	bool bForce32BitIndices = false;
+};
+
+// Throws std::runtime_error if the mesh is inconsistent (stream sizes, index or submesh ranges)
+std::vector<uint8_t> CookMesh(const MeshData& mesh, const MeshCookOptions& options = {});
+// Writes a temporary and renames it, readers never see a partial file. Throws FileIOException
+void WriteMeshFile(const std::wstring& fileName, const std::vector<uint8_t>& cookedMesh);
+
+// Triangulates polygons as fans, welds identical position/uv/normal tuples and starts a submesh per `usemtl`.
+// Throws FileIOException or std::runtime_error with the line number
+MeshData ImportObj(const std::wstring& fileName);
+MeshData ImportObjFromMemory(const char* pText, size_t size);
+
+// Area weighted vertex normals, replaces any existing ones
+void ComputeVertexNormals(MeshData& mesh);
+// Bounds of the indexed positions, with `pIndices` == nullptr of positions [0, numIndices)
+MeshBounds ComputeBounds(const Float3* pPositions, const uint32_t* pIndices, size_t numIndices);
@@ -0,0 +1,157 @@
+#include "MeshFile.h"
+
+namespace
+{
+	uint32_t GetExpectedStride(MeshSectionType type, const MeshFileHeader& header)
+	{
+		switch (type)
+		{
+		case MeshSectionType::Positions:			return sizeof(Float3);
+		case MeshSectionType::Normals:				return sizeof(Float3);
+		case MeshSectionType::TexCoords:			return sizeof(Float2);
+		case MeshSectionType::QuantizedPositions:	return 4 * sizeof(uint16_t);
+		case MeshSectionType::QuantizedNormals:		return 4 * sizeof(int8_t);
+		case MeshSectionType::Indices:				return header.indexSize;
+		case MeshSectionType::Submeshes:			return sizeof(MeshSubmesh);
+		case MeshSectionType::MaterialNames:		return MeshMaterialNameSize;
+		default:									return 0;
+		}
+	}
+
+	uint64_t GetExpectedCount(MeshSectionType type, const MeshFileHeader& header)
+	{
+		switch (type)
+		{
+		case MeshSectionType::Indices:			return header.numIndices;
+		case MeshSectionType::Submeshes:		return header.numSubmeshes;
+		case MeshSectionType::MaterialNames:	return header.numMaterials;
+		default:								return header.numVertices;
+		}
+	}
+
+	[[noreturn]] void ThrowInvalidMesh(const char* reason)
+	{
+		throw std::runtime_error(std::string("Invalid mesh file: ") + reason);
+	}
+}
+
+void MeshFile::Open(const std::wstring& fileName)
+{
+	m_view.OpenOrThrow(fileName);
+	m_pData = m_view.GetData();
+	m_size = m_view.GetSize();
+	Validate();
+}
+
+void MeshFile::OpenFromMemory(const uint8_t* pData, uint64_t size)
+{
+	m_view.Close();
+	m_pData = pData;
+	m_size = size;
+	Validate();
+}
+
+void MeshFile::Validate()
+{
+	for (const MeshSection*& pSection : m_pSections)
+	{
+		pSection = nullptr;
+	}
+	m_pHeader = nullptr;
+
+	// Everything below is O(sections + submeshes), vertex and index data is not touched
+	if (m_pData == nullptr || m_size < sizeof(MeshFileHeader))
+	{
+		ThrowInvalidMesh("truncated header");
+	}
+	const MeshFileHeader* pHeader = reinterpret_cast<const MeshFileHeader*>(m_pData);
+	if (pHeader->magic != MeshFileMagic)
+	{
+		ThrowInvalidMesh("bad magic");
+	}
+	if (pHeader->version != MeshFileVersion)
+	{
+		ThrowInvalidMesh("unsupported version");
+	}
+	if (pHeader->fileSize != m_size)
+	{
+		ThrowInvalidMesh("size mismatch, file truncated");
+	}
+	if (pHeader->indexSize != 2 && pHeader->indexSize != 4)
+	{
+		ThrowInvalidMesh("bad index size");
+	}
+	if (uint64_t(pHeader->numSections) * sizeof(MeshSection) > m_size - sizeof(MeshFileHeader))
+	{
+		ThrowInvalidMesh("truncated section table");
+	}
+
+	const MeshSection* pSectionTable = reinterpret_cast<const MeshSection*>(m_pData + sizeof(MeshFileHeader));
+	for (uint32_t i = 0; i < pHeader->numSections; i++)
+	{
+		const MeshSection& section = pSectionTable[i];
+		if (uint32_t(section.type) >= uint32_t(MeshSectionType::Count))
+		{
+			// Unknown sections from newer cookers are skipped
+			continue;
+		}
+		const uint32_t stride = GetExpectedStride(section.type, *pHeader);
+		if (section.offset % MeshSectionAlignment != 0 || section.offset > m_size || section.size > m_size - section.offset)
+		{
+			ThrowInvalidMesh("section out of bounds");
+		}
+		if (section.stride != stride || section.size != GetExpectedCount(section.type, *pHeader) * stride)
+		{
+			ThrowInvalidMesh("section size does not match header");
+		}
+		if (m_pSections[uint32_t(section.type)] != nullptr)
+		{
+			ThrowInvalidMesh("duplicate section");
+		}
+		m_pSections[uint32_t(section.type)] = &section;
+	}
+
+	if (m_pSections[uint32_t(MeshSectionType::Positions)] == nullptr && m_pSections[uint32_t(MeshSectionType::QuantizedPositions)] == nullptr)
+	{
+		ThrowInvalidMesh("no position stream");
+	}
+	if (m_pSections[uint32_t(MeshSectionType::Indices)] == nullptr || m_pSections[uint32_t(MeshSectionType::Submeshes)] == nullptr)
+	{
+		ThrowInvalidMesh("missing index or submesh section");
+	}
+
+	const MeshSubmesh* pSubmeshes = reinterpret_cast<const MeshSubmesh*>(m_pData + m_pSections[uint32_t(MeshSectionType::Submeshes)]->offset);
+	for (uint32_t i = 0; i < pHeader->numSubmeshes; i++)
+	{
+		if (pSubmeshes[i].firstIndex > pHeader->numIndices || pSubmeshes[i].numIndices > pHeader->numIndices - pSubmeshes[i].firstIndex)
+		{
+			ThrowInvalidMesh("submesh index range out of bounds");
+		}
+	}
+
+	m_pHeader = pHeader;
+}
+
+Float3 MeshFile::GetPosition(uint32_t vertex) const
+{
+	if (const Float3* pPositions = GetPositions())
+	{
+		return pPositions[vertex];
+	}
+
+	const uint16_t* pQuantized = GetQuantizedPositions() + vertex * 4;
+	const MeshBounds& bounds = m_pHeader->bounds;
+	const float scale = 1.0f / 65535.0f;
+	return
+	{
+		bounds.min.x + (bounds.max.x - bounds.min.x) * (pQuantized[0] * scale),
+		bounds.min.y + (bounds.max.y - bounds.min.y) * (pQuantized[1] * scale),
+		bounds.min.z + (bounds.max.z - bounds.min.z) * (pQuantized[2] * scale),
+	};
+}
+
+const char* MeshFile::GetMaterialName(uint32_t material) const
+{
+	const char* pNames = GetSectionData<char>(MeshSectionType::MaterialNames);
+	return pNames && material < m_pHeader->numMaterials ? pNames + material * MeshMaterialNameSize : "";
+}
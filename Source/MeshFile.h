@@ -0,0 +1,122 @@
+#pragma once
+
+// Binary mesh container (.mesh), used in place without a parsing step
+// Layout: MeshFileHeader, MeshSection table, then every section aligned to MeshSectionAlignment.
+// Opening only validates the header and the section table, vertex/index data is read straight from the mapping.
+// Files are written by MeshBuilder.h (MeshCooker tool), little endian.
+
+#include "Platform.h"
+#include "EngineMath.h"
+#include "FileView.h"
+
+enum : uint32_t
+{
+	MeshFileMagic = 0x4853454d,	// "MESH"
+	MeshFileVersion = 1,
+	MeshSectionAlignment = 64,
+	MeshMaterialNameSize = 64,
+};
+
+enum class MeshSectionType : uint32_t
+{
+	Positions,				// Float3
+	Normals,				// Float3
+	TexCoords,				// Float2
+	QuantizedPositions,		// uint16_t x4, unorm within MeshFileHeader::bounds, w unused
+	QuantizedNormals,		// int8_t x4, snorm, w unused
+	Indices,				// uint16_t or uint32_t, see MeshFileHeader::indexSize
+	Submeshes,				// MeshSubmesh
+	MaterialNames,			// char[MeshMaterialNameSize], null terminated
+	Count,
+};
+
+struct MeshBounds
+{
+	Float3 min;
+	Float3 max;
+};
+
+struct MeshSubmesh
+{
+	uint32_t	firstIndex;
+	uint32_t	numIndices;
+	uint32_t	materialIndex;
+	uint32_t	reserved;
+	MeshBounds	bounds;
+};
+
+struct MeshSection
+{
+	MeshSectionType	type;
+	uint32_t		stride;		// Bytes per element
+	uint64_t		offset;		// From the start of the file
+	uint64_t		size;
+};
+
+struct MeshFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	fileSize;
+	uint32_t	numVertices;
+	uint32_t	numIndices;
+	uint32_t	numSubmeshes;
+	uint32_t	numMaterials;
+	uint32_t	numSections;
+	uint32_t	indexSize;		// 2 or 4
+	MeshBounds	bounds;
+};
+
+static_assert(sizeof(MeshSubmesh) == 40, "MeshSubmesh is part of the file format");
+static_assert(sizeof(MeshSection) == 24, "MeshSection is part of the file format");
+static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader is part of the file format");
+
+class MeshFile
+{
+public:
+	// Maps the file. Throws FileIOException if it can not be opened, std::runtime_error if it is malformed
+	void Open(const std::wstring& fileName);
+	// Uses `pData` in place, it must stay valid while the MeshFile is used
+	void OpenFromMemory(const uint8_t* pData, uint64_t size);
+
+	const MeshFileHeader& GetHeader() const { return *m_pHeader; }
+	uint32_t GetNumVertices() const { return m_pHeader->numVertices; }
+	uint32_t GetNumIndices() const { return m_pHeader->numIndices; }
+	bool HasSection(MeshSectionType type) const { return m_pSections[uint32_t(type)] != nullptr; }
+	// nullptr if the section is not present
+	const MeshSection* GetSection(MeshSectionType type) const { return m_pSections[uint32_t(type)]; }
+
+	// Element pointers into the file, nullptr if the stream is not present
+	const Float3* GetPositions() const { return GetSectionData<Float3>(MeshSectionType::Positions); }
+	const Float3* GetNormals() const { return GetSectionData<Float3>(MeshSectionType::Normals); }
+	const Float2* GetTexCoords() const { return GetSectionData<Float2>(MeshSectionType::TexCoords); }
+	const uint16_t* GetQuantizedPositions() const { return GetSectionData<uint16_t>(MeshSectionType::QuantizedPositions); }
+	const int8_t* GetQuantizedNormals() const { return GetSectionData<int8_t>(MeshSectionType::QuantizedNormals); }
+	const void* GetIndexData() const { return GetSectionData<uint8_t>(MeshSectionType::Indices); }
+	const MeshSubmesh* GetSubmeshes() const { return GetSectionData<MeshSubmesh>(MeshSectionType::Submeshes); }
+	uint32_t GetNumSubmeshes() const { return m_pHeader->numSubmeshes; }
+
+	uint32_t GetIndex(uint32_t i) const
+	{
+		return m_pHeader->indexSize == 2 ? static_cast<const uint16_t*>(GetIndexData())[i] : static_cast<const uint32_t*>(GetIndexData())[i];
+	}
+	// Decodes either the float or the quantized stream
+	Float3 GetPosition(uint32_t vertex) const;
+	const char* GetMaterialName(uint32_t material) const;
+
+private:
+	template <typename T>
+	const T* GetSectionData(MeshSectionType type) const
+	{
+		const MeshSection* pSection = m_pSections[uint32_t(type)];
+		return pSection ? reinterpret_cast<const T*>(m_pData + pSection->offset) : nullptr;
+	}
+
+	void Validate();
+
+	FileView				m_view;
+	const uint8_t*			m_pData = nullptr;
+	uint64_t				m_size = 0;
+	const MeshFileHeader*	m_pHeader = nullptr;
+	const MeshSection*		m_pSections[uint32_t(MeshSectionType::Count)] = {};
+};
@@ -0,0 +1,433 @@
+#include "NullRHI.h"
+#include "Profiler.h"
+
+static uint8_t* AlignHostMemory(std::vector<uint8_t>& memory, size_t size)
+{
+	memory.resize(size + NullResource::MemoryAlignment);
+	return reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(memory.data()) + NullResource::MemoryAlignment - 1) & ~uintptr_t(NullResource::MemoryAlignment - 1));
+}
+
+NullHeap::NullHeap(uint64_t size)
+	: RHIHeap(size)
+{
+	m_pData = AlignHostMemory(m_memory, size_t(size));
+}
+
+NullResource::NullResource(const RHIResourceDesc& desc)
+	: RHIResource(desc)
+	, m_trackedState(desc.initialState)
+{
+	m_size = GetSizeInBytes(desc);
+	m_pData = AlignHostMemory(m_memory, m_size);
+}
+
+NullResource::NullResource(const RHIResourceDesc& desc, NullHeap* pHeap, uint64_t offset)
+	: RHIResource(desc)
+	, m_trackedState(desc.initialState)
+{
+	m_size = GetSizeInBytes(desc);
+	check(offset % PlacementAlignment != 0 || offset + m_size > pHeap->GetSize());
+	m_pData = pHeap->GetData() + offset;
+}
+
+size_t NullResource::GetSizeInBytes(const RHIResourceDesc& desc)
+{
+	if (desc.dimension == RHIResourceDimension::Buffer)
+	{
+		return size_t(desc.width);
+	}
+	return size_t(desc.width) * desc.height * GetFormatSize(desc.format);
+}
+
+uint32_t NullResource::GetRowPitch() const
+{
+	if (m_desc.dimension == RHIResourceDimension::Buffer)
+	{
+		return uint32_t(m_desc.width);
+	}
+	return uint32_t(m_desc.width) * GetFormatSize(m_desc.format);
+}
+
+void NullFence::Wait(uint64_t value)
+{
+	if (GetCompletedValue() >= value)
+	{
+		return;
+	}
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this, value]() { return GetCompletedValue() >= value; });
+}
+
+void NullFence::SetCompletedValue(uint64_t value)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_completedValue.store(value, std::memory_order_release);
+	}
+	m_condition.notify_all();
+}
+
+void NullCommandAllocator::Reset()
+{
+	// Same rule as D3D12, the memory may still be read by the GPU
+	check(GetPendingExecutions() != 0);
+	for (size_t i = 0; i < m_numUsedStreams; i++)
+	{
+		m_streams[i]->Clear();
+	}
+	m_numUsedStreams = 0;
+}
+
+NullCommandStream* NullCommandAllocator::AcquireStream()
+{
+	if (m_numUsedStreams == m_streams.size())
+	{
+		m_streams.push_back(std::make_unique<NullCommandStream>());
+	}
+	return m_streams[m_numUsedStreams++].get();
+}
+
+void NullCommandList::Begin(RHICommandAllocator* pAllocator, RHIPipelineState* pInitialState)
+{
+	check(m_bRecording);
+	check(pAllocator == nullptr);
+	m_pAllocator = static_cast<NullCommandAllocator*>(pAllocator);
+	m_pStream = m_pAllocator->AcquireStream();
+	m_bRecording = true;
+	if (pInitialState)
+	{
+		SetPipelineState(pInitialState);
+	}
+}
+
+void NullCommandList::Close()
+{
+	check(!m_bRecording);
+	m_bRecording = false;
+}
+
+void NullCommandList::SetPipelineState(RHIPipelineState* pPipelineState)
+{
+	m_pStream->Push<NullCmdSetPipelineState>(NullCommandType::SetPipelineState)->pPipelineState = pPipelineState;
+}
+
+void NullCommandList::SetViewport(const RHIViewport& viewport)
+{
+	m_pStream->Push<NullCmdSetViewport>(NullCommandType::SetViewport)->viewport = viewport;
+}
+
+void NullCommandList::SetScissorRect(const RHIRect& rect)
+{
+	m_pStream->Push<NullCmdSetScissorRect>(NullCommandType::SetScissorRect)->rect = rect;
+}
+
+void NullCommandList::ResourceBarrier(uint32_t numBarriers, const RHIResourceBarrier* pBarriers)
+{
+	const uint32_t barriersSize = uint32_t(sizeof(RHIResourceBarrier) * numBarriers);
+	NullCmdResourceBarrier* pCmd = m_pStream->Push<NullCmdResourceBarrier>(NullCommandType::ResourceBarrier, barriersSize);
+	pCmd->numBarriers = numBarriers;
+	memcpy(pCmd + 1, pBarriers, barriersSize);
+}
+
+void NullCommandList::SetRenderTarget(RHIResource* pRenderTarget)
+{
+	m_pStream->Push<NullCmdSetRenderTarget>(NullCommandType::SetRenderTarget)->pRenderTarget = pRenderTarget;
+}
+
+void NullCommandList::ClearRenderTarget(RHIResource* pRenderTarget, const float color[4])
+{
+	NullCmdClearRenderTarget* pCmd = m_pStream->Push<NullCmdClearRenderTarget>(NullCommandType::ClearRenderTarget);
+	pCmd->pRenderTarget = pRenderTarget;
+	memcpy(pCmd->color, color, sizeof(pCmd->color));
+}
+
+void NullCommandList::DiscardResource(RHIResource* pResource)
+{
+	m_pStream->Push<NullCmdDiscardResource>(NullCommandType::DiscardResource)->pResource = pResource;
+}
+
+void NullCommandList::SetPrimitiveTopology(RHIPrimitiveTopology topology)
+{
+	m_pStream->Push<NullCmdSetPrimitiveTopology>(NullCommandType::SetPrimitiveTopology)->topology = topology;
+}
+
+void NullCommandList::SetVertexBuffer(uint32_t slot, const RHIVertexBufferView& view)
+{
+	NullCmdSetVertexBuffer* pCmd = m_pStream->Push<NullCmdSetVertexBuffer>(NullCommandType::SetVertexBuffer);
+	pCmd->slot = slot;
+	pCmd->view = view;
+}
+
+void NullCommandList::DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance)
+{
+	*m_pStream->Push<NullCmdDrawInstanced>(NullCommandType::DrawInstanced) = { vertexCountPerInstance, instanceCount, startVertex, startInstance };
+}
+
+void NullCommandList::UpscaleTexture(RHIResource* pDest, const RHIRect& destRect, RHIResource* pSource, const RHIRect& sourceRect, RHIUpscaleFilter filter)
+{
+	*m_pStream->Push<NullCmdUpscaleTexture>(NullCommandType::UpscaleTexture) = { pDest, pSource, destRect, sourceRect, filter };
+}
+
+NullCommandQueue::NullCommandQueue()
+{
+	m_gpuThread = std::thread(&NullCommandQueue::GpuThreadMain, this);
+}
+
+NullCommandQueue::~NullCommandQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bExit = true;
+	}
+	m_workAvailable.notify_one();
+	m_gpuThread.join();
+}
+
+void NullCommandQueue::ExecuteCommandLists(uint32_t numCommandLists, RHICommandList* const* ppCommandLists)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (uint32_t i = 0; i < numCommandLists; i++)
+		{
+			NullCommandList* pCommandList = static_cast<NullCommandList*>(ppCommandLists[i]);
+			// Executing a command list which is still recording is an error in D3D12 too
+			check(pCommandList->IsRecording());
+			pCommandList->GetAllocator()->AddPendingExecution();
+			m_workItems.push_back({ pCommandList->GetStream(), pCommandList->GetAllocator(), nullptr, 0 });
+		}
+	}
+	m_workAvailable.notify_one();
+}
+
+void NullCommandQueue::Signal(RHIFence* pFence, uint64_t value)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_workItems.push_back({ nullptr, nullptr, static_cast<NullFence*>(pFence), value });
+	}
+	m_workAvailable.notify_one();
+}
+
+void NullCommandQueue::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_workItems.empty() && !m_bBusy; });
+}
+
+void NullCommandQueue::SetCostModel(const NullGpuCostModel& costModel)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_costModel = costModel;
+}
+
+void NullCommandQueue::SetExecutor(NullCommandExecutor* pExecutor)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pExecutor = pExecutor;
+}
+
+NullQueueStatistics NullCommandQueue::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+void NullCommandQueue::GpuThreadMain()
+{
+	PROFILE_THREAD("Null GPU");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_workAvailable.wait(lock, [this]() { return m_bExit || !m_workItems.empty(); });
+		if (m_workItems.empty() && m_bExit)
+		{
+			break;
+		}
+
+		WorkItem item = m_workItems.front();
+		m_workItems.pop_front();
+		m_bBusy = true;
+		NullCommandExecutor* pExecutor = m_pExecutor;
+		NullGpuCostModel costModel = m_costModel;
+		lock.unlock();
+
+		if (item.pStream)
+		{
+			PROFILE_SCOPE("ExecuteCommandList");
+			ExecuteStream(*item.pStream, pExecutor, costModel);
+			item.pAllocator->RemovePendingExecution();
+		}
+		else if (item.pFence)
+		{
+			item.pFence->SetCompletedValue(item.fenceValue);
+		}
+
+		lock.lock();
+		m_bBusy = false;
+		if (m_workItems.empty())
+		{
+			m_idle.notify_all();
+		}
+	}
+}
+
+void NullCommandQueue::ExecuteStream(const NullCommandStream& stream, NullCommandExecutor* pExecutor, const NullGpuCostModel& costModel)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	uint64_t numDraws = 0;
+	uint64_t numBarriers = 0;
+	uint64_t numAliasingBarriers = 0;
+	uint64_t numUnorderedAccessBarriers = 0;
+	uint64_t numDiscards = 0;
+	uint64_t numMismatches = 0;
+	stream.ForEach([&](const NullCommandHeader& header, const void* pPayload)
+	{
+		if (header.type == NullCommandType::DrawInstanced)
+		{
+			numDraws++;
+		}
+		else if (header.type == NullCommandType::ResourceBarrier)
+		{
+			const NullCmdResourceBarrier* pCmd = static_cast<const NullCmdResourceBarrier*>(pPayload);
+			const RHIResourceBarrier* pBarriers = reinterpret_cast<const RHIResourceBarrier*>(pCmd + 1);
+			for (uint32_t i = 0; i < pCmd->numBarriers; i++)
+			{
+				if (pBarriers[i].type == RHIBarrierType::Aliasing)
+				{
+					numAliasingBarriers++;
+					continue;
+				}
+				if (pBarriers[i].type == RHIBarrierType::UnorderedAccess)
+				{
+					numUnorderedAccessBarriers++;
+					numMismatches += static_cast<NullResource*>(pBarriers[i].pResource)->GetTrackedState() != RHIResourceState::UnorderedAccess;
+					continue;
+				}
+				NullResource* pResource = static_cast<NullResource*>(pBarriers[i].pResource);
+				if (pResource->GetTrackedState() != pBarriers[i].stateBefore)
+				{
+					numMismatches++;
+				}
+				pResource->SetTrackedState(pBarriers[i].stateAfter);
+			}
+			numBarriers += pCmd->numBarriers;
+		}
+		else if (header.type == NullCommandType::DiscardResource)
+		{
+			const NullResource* pResource = static_cast<const NullResource*>(static_cast<const NullCmdDiscardResource*>(pPayload)->pResource);
+			numDiscards++;
+			numMismatches += pResource->GetDesc().bRenderTarget && pResource->GetTrackedState() != RHIResourceState::RenderTarget;
+		}
+	});
+
+	if (pExecutor)
+	{
+		pExecutor->Execute(stream);
+	}
+
+	// Simulated cost, spin so short costs are still honored
+	const auto cost = costModel.perCommandList + costModel.perDraw * numDraws + costModel.perBarrier * numBarriers;
+	if (cost.count() > 0)
+	{
+		const auto endTime = startTime + cost;
+		if (cost > std::chrono::milliseconds(1))
+		{
+			std::this_thread::sleep_until(endTime - std::chrono::microseconds(200));
+		}
+		while (std::chrono::steady_clock::now() < endTime)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	const double busySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics.executedCommandLists++;
+	m_statistics.executedCommands += stream.GetNumCommands();
+	m_statistics.executedDraws += numDraws;
+	m_statistics.executedBarriers += numBarriers;
+	m_statistics.executedAliasingBarriers += numAliasingBarriers;
+	m_statistics.executedUnorderedAccessBarriers += numUnorderedAccessBarriers;
+	m_statistics.executedDiscards += numDiscards;
+	m_statistics.barrierMismatches += numMismatches;
+	m_statistics.gpuBusySeconds += busySeconds;
+}
+
+NullSwapChain::NullSwapChain(NullRHIDevice*, uint32_t bufferCount, uint32_t width, uint32_t height, RHIFormat format)
+	: m_format(format)
+{
+	CreateBackBuffers(bufferCount, width, height);
+}
+
+void NullSwapChain::CreateBackBuffers(uint32_t bufferCount, uint32_t width, uint32_t height)
+{
+	m_backBuffers.clear();
+	for (uint32_t i = 0; i < bufferCount; i++)
+	{
+		RHIResourceDesc desc = RHIResourceDesc::Texture2D(width, height, m_format, true);
+		desc.initialState = RHIResourceState::Present;
+		m_backBuffers.push_back(std::make_unique<NullResource>(desc));
+	}
+}
+
+void NullSwapChain::Resize(uint32_t width, uint32_t height)
+{
+	// Like DXGI, presenting starts over at the first buffer
+	CreateBackBuffers(GetBufferCount(), width, height);
+	m_currentIndex = 0;
+}
+
+void NullSwapChain::Present(uint32_t, uint32_t)
+{
+	m_presentCount++;
+	m_currentIndex = (m_currentIndex + 1) % GetBufferCount();
+}
+
+std::unique_ptr<RHISwapChain> NullRHIDevice::CreateSwapChain(void*, uint32_t bufferCount, uint32_t width, uint32_t height, RHIFormat format)
+{
+	return std::make_unique<NullSwapChain>(this, bufferCount, width, height, format);
+}
+
+std::unique_ptr<RHIResource> NullRHIDevice::CreateResource(const RHIResourceDesc& desc)
+{
+	return std::make_unique<NullResource>(desc);
+}
+
+std::unique_ptr<RHIHeap> NullRHIDevice::CreateHeap(uint64_t size)
+{
+	return std::make_unique<NullHeap>(size);
+}
+
+std::unique_ptr<RHIResource> NullRHIDevice::CreatePlacedResource(RHIHeap* pHeap, uint64_t offset, const RHIResourceDesc& desc)
+{
+	return std::make_unique<NullResource>(desc, static_cast<NullHeap*>(pHeap), offset);
+}
+
+RHIResourceAllocationInfo NullRHIDevice::GetResourceAllocationInfo(const RHIResourceDesc& desc)
+{
+	const uint64_t alignment = NullResource::PlacementAlignment;
+	return { (uint64_t(NullResource::GetSizeInBytes(desc)) + alignment - 1) & ~(alignment - 1), alignment };
+}
+
+std::unique_ptr<RHIPipelineState> NullRHIDevice::CreateGraphicsPipelineState(const RHIGraphicsPipelineDesc& desc, const std::vector<uint8_t>*)
+{
+	// Nothing to compile, shaders are only referenced by name
+	return std::make_unique<RHIPipelineState>(desc);
+}
+
+std::unique_ptr<RHIFence> NullRHIDevice::CreateFence(uint64_t initialValue)
+{
+	return std::make_unique<NullFence>(initialValue);
+}
+
+std::unique_ptr<RHICommandAllocator> NullRHIDevice::CreateCommandAllocator()
+{
+	return std::make_unique<NullCommandAllocator>();
+}
+
+std::unique_ptr<RHICommandList> NullRHIDevice::CreateCommandList()
+{
+	return std::make_unique<NullCommandList>();
+}
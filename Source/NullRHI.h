@@ -0,0 +1,326 @@
+#pragma once
+
+// Headless RHI backend
+// Command lists are recorded into plain byte streams owned by the allocator, and a worker thread plays
+// the role of GPU: it walks submitted streams in order, optionally burns a simulated cost, and signals fences.
+
+#include "RHI.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+enum class NullCommandType : uint32_t
+{
+	SetPipelineState,
+	SetViewport,
+	SetScissorRect,
+	ResourceBarrier,
+	SetRenderTarget,
+	ClearRenderTarget,
+	DiscardResource,
+	SetPrimitiveTopology,
+	SetVertexBuffer,
+	DrawInstanced,
+	UpscaleTexture,
+};
+
+// Every packet starts with a header and is padded to 8 bytes
+struct NullCommandHeader
+{
+	NullCommandType	type;
+	uint32_t		size;	// Including header
+};
+
+struct NullCmdSetPipelineState		{ RHIPipelineState* pPipelineState; };
+struct NullCmdSetViewport			{ RHIViewport viewport; };
+struct NullCmdSetScissorRect		{ RHIRect rect; };
+struct NullCmdResourceBarrier		{ uint32_t numBarriers; uint32_t padding; /* RHIResourceBarrier[numBarriers] follows */ };
+struct NullCmdSetRenderTarget		{ RHIResource* pRenderTarget; };
+struct NullCmdClearRenderTarget		{ RHIResource* pRenderTarget; float color[4]; };
+struct NullCmdDiscardResource		{ RHIResource* pResource; };
+struct NullCmdSetPrimitiveTopology	{ RHIPrimitiveTopology topology; };
+struct NullCmdSetVertexBuffer		{ uint32_t slot; uint32_t padding; RHIVertexBufferView view; };
+struct NullCmdDrawInstanced			{ uint32_t vertexCountPerInstance; uint32_t instanceCount; uint32_t startVertex; uint32_t startInstance; };
+struct NullCmdUpscaleTexture		{ RHIResource* pDest; RHIResource* pSource; RHIRect destRect; RHIRect sourceRect; RHIUpscaleFilter filter; };
+
+class NullCommandStream
+{
+public:
+	static constexpr uint32_t PacketAlignment = 8;
+
+	template <typename T>
+	T* Push(NullCommandType type, uint32_t extraBytes = 0)
+	{
+		const uint32_t size = AlignPacketSize(uint32_t(sizeof(NullCommandHeader) + sizeof(T) + extraBytes));
+		const size_t offset = m_data.size();
+		m_data.resize(offset + size);
+		NullCommandHeader* pHeader = reinterpret_cast<NullCommandHeader*>(m_data.data() + offset);
+		pHeader->type = type;
+		pHeader->size = size;
+		m_numCommands++;
+		return reinterpret_cast<T*>(pHeader + 1);
+	}
+
+	// Visitor is called with (const NullCommandHeader&, const void* payload)
+	template <typename Visitor>
+	void ForEach(Visitor&& visitor) const
+	{
+		size_t offset = 0;
+		while (offset < m_data.size())
+		{
+			const NullCommandHeader* pHeader = reinterpret_cast<const NullCommandHeader*>(m_data.data() + offset);
+			visitor(*pHeader, static_cast<const void*>(pHeader + 1));
+			offset += pHeader->size;
+		}
+	}
+
+	// Keeps capacity, steady state recording does not allocate
+	void Clear()
+	{
+		m_data.clear();
+		m_numCommands = 0;
+	}
+
+	size_t GetSizeInBytes() const { return m_data.size(); }
+	uint32_t GetNumCommands() const { return m_numCommands; }
+
+private:
+	static uint32_t AlignPacketSize(uint32_t size) { return (size + PacketAlignment - 1) & ~(PacketAlignment - 1); }
+
+	std::vector<uint8_t>	m_data;
+	uint32_t				m_numCommands = 0;
+};
+
+// Hook for backends that actually consume the recorded streams (e.g. a software rasterizer).
+// Called on the simulated GPU thread, in submission order
+class NullCommandExecutor
+{
+public:
+	virtual ~NullCommandExecutor() {}
+
+	virtual void Execute(const NullCommandStream& stream) = 0;
+};
+
+class NullHeap : public RHIHeap
+{
+public:
+	explicit NullHeap(uint64_t size);
+
+	uint8_t* GetData() { return m_pData; }
+
+private:
+	std::vector<uint8_t>	m_memory;
+	uint8_t*				m_pData;
+};
+
+class NullResource : public RHIResource
+{
+public:
+	explicit NullResource(const RHIResourceDesc& desc);
+	// Placed, the memory belongs to the heap
+	NullResource(const RHIResourceDesc& desc, NullHeap* pHeap, uint64_t offset);
+
+	// Placement alignment of the host memory, like D3D12 buffers it satisfies any upload alignment
+	static constexpr size_t MemoryAlignment = 4096;
+	// Same as the default D3D12 placement alignment, so heap sizes match what the GPU would need
+	static constexpr uint64_t PlacementAlignment = 65536;
+
+	static size_t GetSizeInBytes(const RHIResourceDesc& desc);
+
+	void* Map() override { return m_pData; }
+	void Unmap() override {}
+	// Host address doubles as GPU address, so executors can dereference vertex buffer views directly
+	uint64_t GetGpuVirtualAddress() const override { return reinterpret_cast<uint64_t>(m_pData); }
+
+	uint8_t* GetData() { return m_pData; }
+	const uint8_t* GetData() const { return m_pData; }
+	size_t GetSizeInBytes() const { return m_size; }
+	uint32_t GetRowPitch() const;
+
+	// State as seen by the simulated GPU, used to validate barriers
+	RHIResourceState GetTrackedState() const { return m_trackedState; }
+	void SetTrackedState(RHIResourceState state) { m_trackedState = state; }
+
+private:
+	std::vector<uint8_t>	m_memory;
+	uint8_t*				m_pData;
+	size_t					m_size;
+	RHIResourceState		m_trackedState;
+};
+
+class NullFence : public RHIFence
+{
+public:
+	explicit NullFence(uint64_t initialValue) : m_completedValue(initialValue) {}
+
+	uint64_t GetCompletedValue() const override { return m_completedValue.load(std::memory_order_acquire); }
+	void Wait(uint64_t value) override;
+
+	// Called from simulated GPU
+	void SetCompletedValue(uint64_t value);
+
+private:
+	std::atomic<uint64_t>	m_completedValue;
+	std::mutex				m_mutex;
+	std::condition_variable	m_condition;
+};
+
+class NullCommandAllocator : public RHICommandAllocator
+{
+public:
+	void Reset() override;
+
+	NullCommandStream* AcquireStream();
+
+	void AddPendingExecution() { m_pendingExecutions.fetch_add(1, std::memory_order_relaxed); }
+	void RemovePendingExecution() { m_pendingExecutions.fetch_sub(1, std::memory_order_release); }
+	uint32_t GetPendingExecutions() const { return m_pendingExecutions.load(std::memory_order_acquire); }
+
+private:
+	std::vector<std::unique_ptr<NullCommandStream>>	m_streams;
+	size_t											m_numUsedStreams = 0;
+	std::atomic<uint32_t>							m_pendingExecutions = 0;
+};
+
+class NullCommandList : public RHICommandList
+{
+public:
+	void Begin(RHICommandAllocator* pAllocator, RHIPipelineState* pInitialState = nullptr) override;
+	void Close() override;
+
+	void SetPipelineState(RHIPipelineState* pPipelineState) override;
+	void SetViewport(const RHIViewport& viewport) override;
+	void SetScissorRect(const RHIRect& rect) override;
+	void ResourceBarrier(uint32_t numBarriers, const RHIResourceBarrier* pBarriers) override;
+	void SetRenderTarget(RHIResource* pRenderTarget) override;
+	void ClearRenderTarget(RHIResource* pRenderTarget, const float color[4]) override;
+	void DiscardResource(RHIResource* pResource) override;
+	void SetPrimitiveTopology(RHIPrimitiveTopology topology) override;
+	void SetVertexBuffer(uint32_t slot, const RHIVertexBufferView& view) override;
+	void DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance) override;
+	void UpscaleTexture(RHIResource* pDest, const RHIRect& destRect, RHIResource* pSource, const RHIRect& sourceRect, RHIUpscaleFilter filter) override;
+
+	bool IsRecording() const { return m_bRecording; }
+	NullCommandStream* GetStream() const { return m_pStream; }
+	NullCommandAllocator* GetAllocator() const { return m_pAllocator; }
+
+private:
+	NullCommandAllocator*	m_pAllocator = nullptr;
+	NullCommandStream*		m_pStream = nullptr;
+	bool					m_bRecording = false;
+};
+
+// Cost model of the simulated GPU, zero means work retires as soon as the GPU thread sees it
+struct NullGpuCostModel
+{
+	std::chrono::nanoseconds perCommandList{ 0 };
+	std::chrono::nanoseconds perDraw{ 0 };
+	std::chrono::nanoseconds perBarrier{ 0 };
+};
+
+struct NullQueueStatistics
+{
+	uint64_t	executedCommandLists = 0;
+	uint64_t	executedCommands = 0;
+	uint64_t	executedDraws = 0;
+	uint64_t	executedBarriers = 0;
+	uint64_t	executedAliasingBarriers = 0;
+	uint64_t	executedUnorderedAccessBarriers = 0;
+	uint64_t	executedDiscards = 0;
+	uint64_t	barrierMismatches = 0;	// stateBefore did not match the tracked state, or a discarded render target was not in RenderTarget
+	double		gpuBusySeconds = 0.0;
+};
+
+class NullCommandQueue : public RHICommandQueue
+{
+public:
+	NullCommandQueue();
+	~NullCommandQueue();
+
+	void ExecuteCommandLists(uint32_t numCommandLists, RHICommandList* const* ppCommandLists) override;
+	void Signal(RHIFence* pFence, uint64_t value) override;
+
+	// Block until every submitted item has retired
+	void Flush();
+
+	void SetCostModel(const NullGpuCostModel& costModel);
+	void SetExecutor(NullCommandExecutor* pExecutor);
+	NullQueueStatistics GetStatistics();
+
+private:
+	struct WorkItem
+	{
+		const NullCommandStream*	pStream;
+		NullCommandAllocator*		pAllocator;
+		NullFence*					pFence;
+		uint64_t					fenceValue;
+	};
+
+	void GpuThreadMain();
+	void ExecuteStream(const NullCommandStream& stream, NullCommandExecutor* pExecutor, const NullGpuCostModel& costModel);
+
+	std::thread					m_gpuThread;
+	std::mutex					m_mutex;
+	std::condition_variable		m_workAvailable;
+	std::condition_variable		m_idle;
+	std::deque<WorkItem>		m_workItems;
+	bool						m_bBusy = false;
+	bool						m_bExit = false;
+
+	NullGpuCostModel			m_costModel;
+	NullCommandExecutor*		m_pExecutor = nullptr;
+	NullQueueStatistics			m_statistics;
+};
+
+class NullSwapChain : public RHISwapChain
+{
+public:
+	NullSwapChain(class NullRHIDevice* pDevice, uint32_t bufferCount, uint32_t width, uint32_t height, RHIFormat format);
+
+	uint32_t GetBufferCount() const override { return uint32_t(m_backBuffers.size()); }
+	RHIResource* GetBackBuffer(uint32_t index) override { return m_backBuffers[index].get(); }
+	uint32_t GetCurrentBackBufferIndex() const override { return m_currentIndex; }
+	void Present(uint32_t syncInterval, uint32_t flags) override;
+	void Resize(uint32_t width, uint32_t height) override;
+
+	// There is no display, FramePacer models one when frames need pacing
+	bool IsTearingSupported() const override { return true; }
+	void SetMaximumFrameLatency(uint32_t) override {}
+	void WaitForFrameLatency() override {}
+
+	uint64_t GetPresentCount() const { return m_presentCount; }
+
+private:
+	void CreateBackBuffers(uint32_t bufferCount, uint32_t width, uint32_t height);
+
+	RHIFormat									m_format;
+	std::vector<std::unique_ptr<NullResource>>	m_backBuffers;
+	uint32_t									m_currentIndex = 0;
+	uint64_t									m_presentCount = 0;
+};
+
+class NullRHIDevice : public RHIDevice
+{
+public:
+	RHIBackend GetBackend() const override { return RHIBackend::Null; }
+	RHICommandQueue* GetGraphicsQueue() override { return &m_graphicsQueue; }
+
+	std::unique_ptr<RHISwapChain> CreateSwapChain(void* nativeWindow, uint32_t bufferCount, uint32_t width, uint32_t height, RHIFormat format) override;
+	std::unique_ptr<RHIResource> CreateResource(const RHIResourceDesc& desc) override;
+	std::unique_ptr<RHIHeap> CreateHeap(uint64_t size) override;
+	std::unique_ptr<RHIResource> CreatePlacedResource(RHIHeap* pHeap, uint64_t offset, const RHIResourceDesc& desc) override;
+	RHIResourceAllocationInfo GetResourceAllocationInfo(const RHIResourceDesc& desc) override;
+	std::unique_ptr<RHIPipelineState> CreateGraphicsPipelineState(const RHIGraphicsPipelineDesc& desc, const std::vector<uint8_t>* pCachedBlob = nullptr) override;
+	std::unique_ptr<RHIFence> CreateFence(uint64_t initialValue) override;
+	std::unique_ptr<RHICommandAllocator> CreateCommandAllocator() override;
+	std::unique_ptr<RHICommandList> CreateCommandList() override;
+
+	NullCommandQueue& GetNullGraphicsQueue() { return m_graphicsQueue; }
+
+private:
+	NullCommandQueue m_graphicsQueue;
+};
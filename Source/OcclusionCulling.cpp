@@ -0,0 +1,580 @@
+#include "OcclusionCulling.h"
+#include "Simd.h"
+
+#include <algorithm>
+
+namespace
+{
+	enum : uint32_t
+	{
+		MaxClipVertices = 8,	// Triangle clipped by 5 planes
+		NumClipPlanes = 5,
+	};
+
+	// Beyond the guard band triangles are clipped so the float edge functions keep their precision
+	const float GuardBand = 4.0f;
+
+	float ClipPlaneDistance(const Float4& p, uint32_t plane)
+	{
+		switch (plane)
+		{
+		case 0:		return p.z;
+		case 1:		return GuardBand * p.w + p.x;
+		case 2:		return GuardBand * p.w - p.x;
+		case 3:		return GuardBand * p.w + p.y;
+		default:	return GuardBand * p.w - p.y;
+		}
+	}
+
+	Float4 Lerp(const Float4& a, const Float4& b, float t)
+	{
+		return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+	}
+
+	uint32_t RoundUp(uint32_t value, uint32_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+}
+
+void OccluderMesh::AddBox(const BoundingBox& box)
+{
+	// Face with outward normal sign * axis a spans u = a + 1 and v = a + 2, Cross(u, v) = -normal is clockwise
+	const float corner[2][3] = { { box.min.x, box.min.y, box.min.z }, { box.max.x, box.max.y, box.max.z } };
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		for (uint32_t side = 0; side < 2; side++)
+		{
+			uint32_t u = (axis + 1) % 3;
+			uint32_t v = (axis + 2) % 3;
+			if (side == 1)
+			{
+				std::swap(u, v);
+			}
+			const uint32_t first = uint32_t(positions.size());
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				// (0, 0), (0, 1), (1, 1), (1, 0) in (u, v)
+				const uint32_t uSide = i >= 2 ? 1 : 0;
+				const uint32_t vSide = (i == 1 || i == 2) ? 1 : 0;
+				float p[3];
+				p[axis] = corner[side][axis];
+				p[u] = corner[uSide][u];
+				p[v] = corner[vSide][v];
+				positions.push_back({ p[0], p[1], p[2] });
+			}
+			indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+		}
+	}
+}
+
+void OccluderMesh::Clear()
+{
+	positions.clear();
+	indices.clear();
+}
+
+OcclusionCuller::OcclusionCuller(JobSystem* pJobSystem, uint32_t width, uint32_t height)
+	: m_pJobSystem(pJobSystem)
+{
+	SetResolution(width, height);
+}
+
+void OcclusionCuller::SetResolution(uint32_t width, uint32_t height)
+{
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+	m_pitch = RoundUp(m_width, BlockSize);
+	m_numBlocksX = m_pitch / BlockSize;
+	m_numBlocksY = RoundUp(m_height, BlockSize) / BlockSize;
+	m_numTilesX = (m_width + TileWidth - 1) / TileWidth;
+	m_numTilesY = (m_height + TileHeight - 1) / TileHeight;
+
+	// Padding never receives occluders and stays at the far plane
+	m_depth.assign(size_t(m_pitch) * m_numBlocksY * BlockSize, 1.0f);
+	m_blockMaxDepth.assign(size_t(m_numBlocksX) * m_numBlocksY, 1.0f);
+}
+
+void OcclusionCuller::BeginFrame(const Float4x4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	m_occluders.clear();
+	m_statistics = {};
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const Float4x4& world)
+{
+	m_occluders.push_back({ &mesh, MatrixMultiply(world, m_viewProjection) });
+}
+
+void OcclusionCuller::RenderOccluders()
+{
+	// Batches of triangles, none of them spans two occluders
+	m_numBatches = 0;
+	for (uint32_t occluder = 0; occluder < m_occluders.size(); occluder++)
+	{
+		const uint32_t numTriangles = m_occluders[occluder].pMesh->GetNumTriangles();
+		m_statistics.numOccluderTriangles += numTriangles;
+		for (uint32_t first = 0; first < numTriangles; first += TriangleBatchSize)
+		{
+			if (m_numBatches == m_batches.size())
+			{
+				m_batches.push_back(std::make_unique<TriangleBatch>());
+			}
+			TriangleBatch& batch = *m_batches[m_numBatches++];
+			batch.occluder = occluder;
+			batch.firstTriangle = first;
+			batch.numTriangles = std::min(uint32_t(TriangleBatchSize), numTriangles - first);
+		}
+	}
+
+	{
+		JobCounter counter;
+		auto setupBatches = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t batch = begin; batch < end; batch++)
+			{
+				SetupTriangles(*m_batches[batch]);
+				BinBatch(*m_batches[batch]);
+			}
+		};
+		m_pJobSystem->ParallelFor(uint32_t(m_numBatches), 1, setupBatches, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+	for (size_t batch = 0; batch < m_numBatches; batch++)
+	{
+		m_statistics.numRasterizedTriangles += uint32_t(m_batches[batch]->triangles.size());
+	}
+
+	{
+		JobCounter counter;
+		auto rasterizeTiles = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t tile = begin; tile < end; tile++)
+			{
+				RasterizeTile(tile);
+			}
+		};
+		m_pJobSystem->ParallelFor(m_numTilesX * m_numTilesY, 1, rasterizeTiles, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+}
+
+void OcclusionCuller::SetupTriangles(TriangleBatch& batch)
+{
+	batch.triangles.clear();
+	const Occluder& occluder = m_occluders[batch.occluder];
+	const OccluderMesh& mesh = *occluder.pMesh;
+	for (uint32_t triangle = batch.firstTriangle; triangle < batch.firstTriangle + batch.numTriangles; triangle++)
+	{
+		Float4 clip[3];
+		uint32_t outsideAll = (1u << NumClipPlanes) - 1;
+		uint32_t outsideAny = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const Float3& position = mesh.positions[mesh.indices[size_t(triangle) * 3 + i]];
+			clip[i] = Transform({ position.x, position.y, position.z, 1.0f }, occluder.worldViewProjection);
+			uint32_t outside = 0;
+			for (uint32_t plane = 0; plane < NumClipPlanes; plane++)
+			{
+				outside |= uint32_t(ClipPlaneDistance(clip[i], plane) < 0.0f) << plane;
+			}
+			outsideAll &= outside;
+			outsideAny |= outside;
+		}
+		if (outsideAll != 0)
+		{
+			continue;
+		}
+		if (outsideAny == 0)
+		{
+			EmitTriangle(batch, clip);
+			continue;
+		}
+
+		// Sutherland-Hodgman against the planes the triangle crosses, then fan the polygon
+		Float4 vertices[2][MaxClipVertices];
+		Float4* pInput = vertices[0];
+		Float4* pOutput = vertices[1];
+		uint32_t numInput = 3;
+		std::copy_n(clip, 3, pInput);
+		for (uint32_t plane = 0; plane < NumClipPlanes && numInput >= 3; plane++)
+		{
+			if ((outsideAny & (1u << plane)) == 0)
+			{
+				continue;
+			}
+			uint32_t numOutput = 0;
+			for (uint32_t i = 0; i < numInput; i++)
+			{
+				const Float4& current = pInput[i];
+				const Float4& next = pInput[(i + 1) % numInput];
+				const float currentDistance = ClipPlaneDistance(current, plane);
+				const float nextDistance = ClipPlaneDistance(next, plane);
+				if (currentDistance >= 0.0f)
+				{
+					pOutput[numOutput++] = current;
+				}
+				if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+				{
+					pOutput[numOutput++] = Lerp(current, next, currentDistance / (currentDistance - nextDistance));
+				}
+			}
+			std::swap(pInput, pOutput);
+			numInput = numOutput;
+		}
+		for (uint32_t i = 2; i < numInput; i++)
+		{
+			const Float4 fan[3] = { pInput[0], pInput[i - 1], pInput[i] };
+			EmitTriangle(batch, fan);
+		}
+	}
+}
+
+void OcclusionCuller::EmitTriangle(TriangleBatch& batch, const Float4* pClip)
+{
+	float x[3], y[3], z[3];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const float invW = 1.0f / pClip[i].w;
+		x[i] = (pClip[i].x * invW + 1.0f) * 0.5f * float(m_width);
+		y[i] = (1.0f - pClip[i].y * invW) * 0.5f * float(m_height);
+		z[i] = pClip[i].z * invW;
+	}
+
+	// Clockwise on screen is front facing, counter-clockwise and degenerate triangles are culled
+	const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f))
+	{
+		return;
+	}
+
+	// Pixels whose center may be covered
+	Triangle triangle;
+	triangle.minX = std::max(int32_t(std::floor(std::min({ x[0], x[1], x[2] }) - 0.5f)) + 1, 0);
+	triangle.minY = std::max(int32_t(std::floor(std::min({ y[0], y[1], y[2] }) - 0.5f)) + 1, 0);
+	triangle.maxX = std::min(int32_t(std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f)) + 1, int32_t(m_width));
+	triangle.maxY = std::min(int32_t(std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f)) + 1, int32_t(m_height));
+	if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY || std::min({ z[0], z[1], z[2] }) >= 1.0f)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const uint32_t j = (i + 1) % 3;
+		triangle.edgeA[i] = y[i] - y[j];
+		triangle.edgeB[i] = x[j] - x[i];
+		triangle.edgeC[i] = -(triangle.edgeA[i] * x[i] + triangle.edgeB[i] * y[i]);
+	}
+
+	const float invArea = 1.0f / area;
+	const float d1 = z[1] - z[0];
+	const float d2 = z[2] - z[0];
+	triangle.depthA = (d1 * (y[2] - y[0]) - d2 * (y[1] - y[0])) * invArea;
+	triangle.depthB = (d2 * (x[1] - x[0]) - d1 * (x[2] - x[0])) * invArea;
+	triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+	batch.triangles.push_back(triangle);
+}
+
+void OcclusionCuller::BinBatch(TriangleBatch& batch)
+{
+	// Counting sort of (tile, triangle) pairs
+	const uint32_t numTiles = m_numTilesX * m_numTilesY;
+	batch.tileOffsets.assign(numTiles + 1, 0);
+	for (const Triangle& triangle : batch.triangles)
+	{
+		for (int32_t tileY = triangle.minY / TileHeight; tileY <= (triangle.maxY - 1) / TileHeight; tileY++)
+		{
+			for (int32_t tileX = triangle.minX / TileWidth; tileX <= (triangle.maxX - 1) / TileWidth; tileX++)
+			{
+				batch.tileOffsets[tileY * m_numTilesX + tileX + 1]++;
+			}
+		}
+	}
+	for (uint32_t tile = 0; tile < numTiles; tile++)
+	{
+		batch.tileOffsets[tile + 1] += batch.tileOffsets[tile];
+	}
+	batch.tileTriangles.resize(batch.tileOffsets[numTiles]);
+	batch.tileCursors.assign(batch.tileOffsets.begin(), batch.tileOffsets.end() - 1);
+	for (uint32_t index = 0; index < batch.triangles.size(); index++)
+	{
+		const Triangle& triangle = batch.triangles[index];
+		for (int32_t tileY = triangle.minY / TileHeight; tileY <= (triangle.maxY - 1) / TileHeight; tileY++)
+		{
+			for (int32_t tileX = triangle.minX / TileWidth; tileX <= (triangle.maxX - 1) / TileWidth; tileX++)
+			{
+				batch.tileTriangles[batch.tileCursors[tileY * m_numTilesX + tileX]++] = index;
+			}
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTile(uint32_t tile)
+{
+	const int32_t tileX = int32_t(tile % m_numTilesX) * TileWidth;
+	const int32_t tileY = int32_t(tile / m_numTilesX) * TileHeight;
+	const int32_t tileMaxX = std::min(tileX + int32_t(TileWidth), int32_t(m_pitch));
+	const int32_t tileMaxY = std::min(tileY + int32_t(TileHeight), int32_t(m_numBlocksY * BlockSize));
+	for (int32_t y = tileY; y < tileMaxY; y++)
+	{
+		std::fill_n(&m_depth[size_t(y) * m_pitch + tileX], tileMaxX - tileX, 1.0f);
+	}
+
+	for (size_t batchIndex = 0; batchIndex < m_numBatches; batchIndex++)
+	{
+		const TriangleBatch& batch = *m_batches[batchIndex];
+		for (uint32_t i = batch.tileOffsets[tile]; i < batch.tileOffsets[tile + 1]; i++)
+		{
+			const Triangle& triangle = batch.triangles[batch.tileTriangles[i]];
+			// Groups of 4 pixels, the pitch is a multiple of 4 so groups never cross the tile
+			const int32_t minX = std::max(triangle.minX, tileX) & ~3;
+			const int32_t maxX = std::min(triangle.maxX, tileMaxX);
+			const int32_t minY = std::max(triangle.minY, tileY);
+			const int32_t maxY = std::min(triangle.maxY, tileMaxY);
+#if ENGINE_SIMD_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 laneX = _mm_add_ps(_mm_set1_ps(float(minX) + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+			__m128 stepX[3], rowStart[3];
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				stepX[e] = _mm_set1_ps(triangle.edgeA[e] * 4.0f);
+				rowStart[e] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[e]), laneX), _mm_set1_ps(triangle.edgeB[e] * (float(minY) + 0.5f) + triangle.edgeC[e]));
+			}
+			const __m128 depthStepX = _mm_set1_ps(triangle.depthA * 4.0f);
+			__m128 depthRowStart = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthA), laneX), _mm_set1_ps(triangle.depthB * (float(minY) + 0.5f) + triangle.depthC));
+
+			for (int32_t y = minY; y < maxY; y++)
+			{
+				float* pRow = &m_depth[size_t(y) * m_pitch];
+				__m128 edge0 = rowStart[0];
+				__m128 edge1 = rowStart[1];
+				__m128 edge2 = rowStart[2];
+				__m128 depth = depthRowStart;
+				for (int32_t x = minX; x < maxX; x += 4)
+				{
+					// Inside when no edge is negative, the sign bits of all three say it at once
+					const __m128 outside = _mm_cmplt_ps(_mm_min_ps(_mm_min_ps(edge0, edge1), edge2), zero);
+					const __m128 current = _mm_loadu_ps(pRow + x);
+					const __m128 nearer = _mm_min_ps(current, depth);
+					_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(outside, current), _mm_andnot_ps(outside, nearer)));
+					edge0 = _mm_add_ps(edge0, stepX[0]);
+					edge1 = _mm_add_ps(edge1, stepX[1]);
+					edge2 = _mm_add_ps(edge2, stepX[2]);
+					depth = _mm_add_ps(depth, depthStepX);
+				}
+				for (uint32_t e = 0; e < 3; e++)
+				{
+					rowStart[e] = _mm_add_ps(rowStart[e], _mm_set1_ps(triangle.edgeB[e]));
+				}
+				depthRowStart = _mm_add_ps(depthRowStart, _mm_set1_ps(triangle.depthB));
+			}
+#else
+			for (int32_t y = minY; y < maxY; y++)
+			{
+				float* pRow = &m_depth[size_t(y) * m_pitch];
+				const float py = float(y) + 0.5f;
+				for (int32_t x = minX; x < maxX; x++)
+				{
+					const float px = float(x) + 0.5f;
+					bool bInside = true;
+					for (uint32_t e = 0; e < 3; e++)
+					{
+						bInside &= triangle.edgeA[e] * px + triangle.edgeB[e] * py + triangle.edgeC[e] >= 0.0f;
+					}
+					if (bInside)
+					{
+						pRow[x] = std::min(pRow[x], triangle.depthA * px + triangle.depthB * py + triangle.depthC);
+					}
+				}
+			}
+#endif
+		}
+	}
+
+	// Tiles are made of whole blocks
+	for (int32_t blockY = tileY / BlockSize; blockY < tileMaxY / BlockSize; blockY++)
+	{
+		for (int32_t blockX = tileX / BlockSize; blockX < tileMaxX / BlockSize; blockX++)
+		{
+			float maxDepth = 0.0f;
+			for (int32_t y = blockY * BlockSize; y < (blockY + 1) * BlockSize; y++)
+			{
+				const float* pRow = &m_depth[size_t(y) * m_pitch + blockX * BlockSize];
+				for (int32_t x = 0; x < BlockSize; x++)
+				{
+					maxDepth = std::max(maxDepth, pRow[x]);
+				}
+			}
+			m_blockMaxDepth[blockY * m_numBlocksX + blockX] = maxDepth;
+		}
+	}
+}
+
+void OcclusionCuller::TestOccludees(const CullingBounds& bounds, const std::vector<uint32_t>& candidates)
+{
+	const uint32_t numCandidates = uint32_t(candidates.size());
+	m_bCandidateVisible.resize(numCandidates);
+	{
+		JobCounter counter;
+		auto testCandidates = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const uint32_t object = candidates[i];
+				const Float3 center = { bounds.fields[CullingBoxCenterX][object], bounds.fields[CullingBoxCenterY][object], bounds.fields[CullingBoxCenterZ][object] };
+				const Float3 extent = { bounds.fields[CullingBoxExtentX][object], bounds.fields[CullingBoxExtentY][object], bounds.fields[CullingBoxExtentZ][object] };
+				m_bCandidateVisible[i] = TestBox(center, extent) ? 1 : 0;
+			}
+		};
+		m_pJobSystem->ParallelFor(numCandidates, TestBatchSize, testCandidates, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+
+	m_visibleIndices.clear();
+	for (uint32_t i = 0; i < numCandidates; i++)
+	{
+		if (m_bCandidateVisible[i])
+		{
+			m_visibleIndices.push_back(candidates[i]);
+		}
+	}
+	m_statistics.numTestedObjects = numCandidates;
+	m_statistics.numOccludedObjects = numCandidates - uint32_t(m_visibleIndices.size());
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& box) const
+{
+	const Float3 center = (box.min + box.max) * 0.5f;
+	return TestBox(center, box.max - center);
+}
+
+bool OcclusionCuller::TestBox(const Float3& center, const Float3& extent) const
+{
+	// Corners are the projected center plus or minus the projected axes
+	const Float4x4& m = m_viewProjection;
+	const Float4 clipCenter = Transform({ center.x, center.y, center.z, 1.0f }, m);
+	const Float4 axes[3] =
+	{
+		{ m.m[0][0] * extent.x, m.m[0][1] * extent.x, m.m[0][2] * extent.x, m.m[0][3] * extent.x },
+		{ m.m[1][0] * extent.y, m.m[1][1] * extent.y, m.m[1][2] * extent.y, m.m[1][3] * extent.y },
+		{ m.m[2][0] * extent.z, m.m[2][1] * extent.z, m.m[2][2] * extent.z, m.m[2][3] * extent.z },
+	};
+#if ENGINE_SIMD_SSE2
+	// 8 corners in two groups of 4, corner i has the sign of axis a from bit a of i
+	const __m128 signX = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+	const __m128 signY = _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+	__m128 clip[2][4];
+	for (uint32_t component = 0; component < 4; component++)
+	{
+		const float* pCenter = &clipCenter.x;
+		const __m128 xy = _mm_add_ps(_mm_set1_ps(pCenter[component]), _mm_add_ps(_mm_mul_ps(signX, _mm_set1_ps((&axes[0].x)[component])), _mm_mul_ps(signY, _mm_set1_ps((&axes[1].x)[component]))));
+		const __m128 z = _mm_set1_ps((&axes[2].x)[component]);
+		clip[0][component] = _mm_sub_ps(xy, z);
+		clip[1][component] = _mm_add_ps(xy, z);
+	}
+	// Crossing the near plane, the box reaches the camera
+	if (_mm_movemask_ps(_mm_or_ps(_mm_cmple_ps(clip[0][2], _mm_setzero_ps()), _mm_cmple_ps(clip[1][2], _mm_setzero_ps()))) != 0)
+	{
+		return true;
+	}
+	const __m128 invW0 = _mm_div_ps(_mm_set1_ps(1.0f), clip[0][3]);
+	const __m128 invW1 = _mm_div_ps(_mm_set1_ps(1.0f), clip[1][3]);
+	float projected[3][2][4];
+	for (uint32_t component = 0; component < 3; component++)
+	{
+		const __m128 p0 = _mm_mul_ps(clip[0][component], invW0);
+		const __m128 p1 = _mm_mul_ps(clip[1][component], invW1);
+		_mm_storeu_ps(projected[component][0], _mm_min_ps(p0, p1));
+		_mm_storeu_ps(projected[component][1], _mm_max_ps(p0, p1));
+	}
+	const float minX = std::min(std::min(projected[0][0][0], projected[0][0][1]), std::min(projected[0][0][2], projected[0][0][3]));
+	const float maxX = std::max(std::max(projected[0][1][0], projected[0][1][1]), std::max(projected[0][1][2], projected[0][1][3]));
+	const float minY = std::min(std::min(projected[1][0][0], projected[1][0][1]), std::min(projected[1][0][2], projected[1][0][3]));
+	const float maxY = std::max(std::max(projected[1][1][0], projected[1][1][1]), std::max(projected[1][1][2], projected[1][1][3]));
+	const float minZ = std::min(std::min(projected[2][0][0], projected[2][0][1]), std::min(projected[2][0][2], projected[2][0][3]));
+#else
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		Float4 clip = clipCenter;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const float sign = (corner & (1u << axis)) ? 1.0f : -1.0f;
+			clip = { clip.x + axes[axis].x * sign, clip.y + axes[axis].y * sign, clip.z + axes[axis].z * sign, clip.w + axes[axis].w * sign };
+		}
+		// Crossing the near plane, the box reaches the camera
+		if (clip.z <= 0.0f)
+		{
+			return true;
+		}
+		const float invW = 1.0f / clip.w;
+		minX = std::min(minX, clip.x * invW);
+		maxX = std::max(maxX, clip.x * invW);
+		minY = std::min(minY, clip.y * invW);
+		maxY = std::max(maxY, clip.y * invW);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+#endif
+
+	// Every pixel the rectangle touches, a little wider than the box so the test stays conservative
+	const int32_t x0 = std::max(int32_t(std::floor((minX + 1.0f) * 0.5f * float(m_width))), 0);
+	const int32_t x1 = std::min(int32_t(std::ceil((maxX + 1.0f) * 0.5f * float(m_width))), int32_t(m_width));
+	const int32_t y0 = std::max(int32_t(std::floor((1.0f - maxY) * 0.5f * float(m_height))), 0);
+	const int32_t y1 = std::min(int32_t(std::ceil((1.0f - minY) * 0.5f * float(m_height))), int32_t(m_height));
+	if (x0 >= x1 || y0 >= y1)
+	{
+		return false;
+	}
+
+	for (int32_t blockY = y0 / BlockSize; blockY <= (y1 - 1) / BlockSize; blockY++)
+	{
+		for (int32_t blockX = x0 / BlockSize; blockX <= (x1 - 1) / BlockSize; blockX++)
+		{
+			// Every occluder pixel of the block is nearer than the box
+			if (m_blockMaxDepth[blockY * m_numBlocksX + blockX] < minZ)
+			{
+				continue;
+			}
+
+			const int32_t blockMinX = std::max(x0, blockX * int32_t(BlockSize));
+			const int32_t blockMaxX = std::min(x1, (blockX + 1) * int32_t(BlockSize));
+			const int32_t blockMinY = std::max(y0, blockY * int32_t(BlockSize));
+			const int32_t blockMaxY = std::min(y1, (blockY + 1) * int32_t(BlockSize));
+#if ENGINE_SIMD_SSE2
+			// Both halves of the block row, lanes outside the rectangle are masked off
+			const __m128i laneX0 = _mm_add_epi32(_mm_set1_epi32(blockX * BlockSize), _mm_setr_epi32(0, 1, 2, 3));
+			const __m128i laneX1 = _mm_add_epi32(laneX0, _mm_set1_epi32(4));
+			const __m128i minXMinusOne = _mm_set1_epi32(blockMinX - 1);
+			const __m128i maxXValue = _mm_set1_epi32(blockMaxX);
+			const __m128 inside0 = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(laneX0, minXMinusOne), _mm_cmplt_epi32(laneX0, maxXValue)));
+			const __m128 inside1 = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(laneX1, minXMinusOne), _mm_cmplt_epi32(laneX1, maxXValue)));
+			const __m128 boxDepth = _mm_set1_ps(minZ);
+			for (int32_t y = blockMinY; y < blockMaxY; y++)
+			{
+				const float* pRow = &m_depth[size_t(y) * m_pitch + blockX * BlockSize];
+				const __m128 visible0 = _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(pRow), boxDepth), inside0);
+				const __m128 visible1 = _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(pRow + 4), boxDepth), inside1);
+				if (_mm_movemask_ps(_mm_or_ps(visible0, visible1)) != 0)
+				{
+					return true;
+				}
+			}
+#else
+			for (int32_t y = blockMinY; y < blockMaxY; y++)
+			{
+				const float* pRow = &m_depth[size_t(y) * m_pitch];
+				for (int32_t x = blockMinX; x < blockMaxX; x++)
+				{
+					if (pRow[x] >= minZ)
+					{
+						return true;
+					}
+				}
+			}
+#endif
+		}
+	}
+	return false;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+// Occlusion culling against a low resolution depth buffer on the CPU
+// Selected occluder meshes (simplified, closed, usually static) are rasterized every frame into a small depth
+// buffer with a hierarchy of 8x8 pixel blocks on top holding the farthest depth of each block. Occludee AABBs are
+// projected to a screen rectangle at their nearest depth and are hidden when every occluder in the rectangle is
+// nearer: whole blocks are accepted from the hierarchy, the remaining ones are compared 4 pixels at a time.
+//
+// Occluder triangles are set up in parallel batches and binned into screen tiles, the tiles are rasterized on the
+// JobSystem. Coverage is sampled at pixel centers like the GPU, so an object only peeking through a gap smaller than
+// a pixel of the low resolution buffer may be culled.
+
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+#include <memory>
+#include <vector>
+
+// Triangle list, clockwise front faces like the D3D12 default rasterizer state. Back faces are not rasterized
+struct OccluderMesh
+{
+	// 12 outward facing triangles
+	void AddBox(const BoundingBox& box);
+	void Clear();
+
+	uint32_t GetNumTriangles() const { return uint32_t(indices.size() / 3); }
+
+	std::vector<Float3>		positions;
+	std::vector<uint32_t>	indices;
+};
+
+struct OcclusionCullingStatistics
+{
+	uint32_t numOccluderTriangles = 0;
+	uint32_t numRasterizedTriangles = 0;	// Front facing and on screen, after near plane clipping
+	uint32_t numTestedObjects = 0;
+	uint32_t numOccludedObjects = 0;
+};
+
+class OcclusionCuller
+{
+public:
+	enum
+	{
+		BlockSize = 8,			// Pixels per side of a hierarchy block
+		TileWidth = 64,			// Screen tiles rasterized by one job
+		TileHeight = 32,
+		TriangleBatchSize = 1024,
+		TestBatchSize = 256,	// Occludees per job
+	};
+
+	OcclusionCuller(JobSystem* pJobSystem, uint32_t width = 320, uint32_t height = 192);
+
+	void SetResolution(uint32_t width, uint32_t height);
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+
+	// Starts a frame, clears the occluders of the last one
+	void BeginFrame(const Float4x4& viewProjection);
+	// `mesh` is referenced until RenderOccluders()
+	void AddOccluder(const OccluderMesh& mesh, const Float4x4& world);
+	// Blocks until the depth buffer is complete, the calling thread helps the workers
+	void RenderOccluders();
+
+	// Keeps the objects of `candidates` (e.g. FrustumCuller::GetVisibleIndices()) that may be visible, in order
+	void TestOccludees(const CullingBounds& bounds, const std::vector<uint32_t>& candidates);
+	// Single box, world space
+	bool IsVisible(const BoundingBox& box) const;
+
+	const std::vector<uint32_t>& GetVisibleIndices() const { return m_visibleIndices; }
+	const OcclusionCullingStatistics& GetStatistics() const { return m_statistics; }
+
+	// Post projection z, 1 where no occluder was rasterized. Rows are GetPitch() floats apart
+	const float* GetDepth() const { return m_depth.data(); }
+	uint32_t GetPitch() const { return m_pitch; }
+
+private:
+	struct Occluder
+	{
+		const OccluderMesh*	pMesh;
+		Float4x4			worldViewProjection;
+	};
+
+	// Screen space triangle, edge i is A * x + B * y + C >= 0 inside, depth is z = A * x + B * y + C too
+	struct Triangle
+	{
+		int32_t		minX, minY, maxX, maxY;		// Pixel bounds, exclusive max, clipped to the screen
+		float		edgeA[3];
+		float		edgeB[3];
+		float		edgeC[3];
+		float		depthA, depthB, depthC;
+	};
+
+	struct TriangleBatch
+	{
+		uint32_t					occluder;
+		uint32_t					firstTriangle;
+		uint32_t					numTriangles;
+		std::vector<Triangle>		triangles;
+		std::vector<uint32_t>		tileOffsets;
+		std::vector<uint32_t>		tileTriangles;
+		std::vector<uint32_t>		tileCursors;
+	};
+
+	void SetupTriangles(TriangleBatch& batch);
+	void EmitTriangle(TriangleBatch& batch, const Float4* pClip);
+	void BinBatch(TriangleBatch& batch);
+	void RasterizeTile(uint32_t tile);
+	bool TestBox(const Float3& center, const Float3& extent) const;
+
+	JobSystem*	m_pJobSystem;
+
+	uint32_t	m_width = 0;
+	uint32_t	m_height = 0;
+	uint32_t	m_pitch = 0;			// Width rounded up to BlockSize
+	uint32_t	m_numBlocksX = 0;
+	uint32_t	m_numBlocksY = 0;
+	uint32_t	m_numTilesX = 0;
+	uint32_t	m_numTilesY = 0;
+
+	Float4x4									m_viewProjection = {};
+	std::vector<Occluder>						m_occluders;
+	std::vector<std::unique_ptr<TriangleBatch>>	m_batches;
+	size_t										m_numBatches = 0;
+
+	std::vector<float>		m_depth;			// m_pitch x m_numBlocksY * BlockSize
+	std::vector<float>		m_blockMaxDepth;	// Farthest depth of each block
+
+	std::vector<uint8_t>	m_bCandidateVisible;
+	std::vector<uint32_t>	m_visibleIndices;
+
+	OcclusionCullingStatistics	m_statistics;
+};
@@ -0,0 +1,55 @@
+#include "ParallelCommandRecorder.h"
+
+ParallelCommandRecorder::ParallelCommandRecorder(RHIDevice* pDevice, JobSystem* pJobSystem, uint32_t maxPasses)
+	: m_pJobSystem(pJobSystem)
+	, m_errors(maxPasses)
+{
+	for (uint32_t i = 0; i < maxPasses; i++)
+	{
+		m_commandLists.push_back(pDevice->CreateCommandList());
+	}
+}
+
+void ParallelCommandRecorder::RecordAndSubmit(FramePipeline* pFramePipeline, RHICommandQueue* pQueue, uint32_t numPasses, const RecordFunction& record, RHIPipelineState* pInitialState)
+{
+	check(numPasses > GetMaxPasses() || numPasses > pFramePipeline->GetNumCommandAllocators());
+
+	// One job per pass, every list and allocator is touched by a single job only
+	JobCounter counter;
+	for (uint32_t pass = 0; pass < numPasses; pass++)
+	{
+		m_pJobSystem->Run([this, pFramePipeline, pInitialState, &record, pass]
+		{
+			RHICommandList* pCommandList = m_commandLists[pass].get();
+			try
+			{
+				pCommandList->Begin(pFramePipeline->GetCommandAllocator(pass), pInitialState);
+				record(pass, pCommandList);
+				pCommandList->Close();
+			}
+			catch (...)
+			{
+				m_errors[pass] = std::current_exception();
+			}
+		}, &counter);
+	}
+	m_pJobSystem->Wait(&counter);
+
+	for (uint32_t pass = 0; pass < numPasses; pass++)
+	{
+		if (m_errors[pass])
+		{
+			std::exception_ptr error = m_errors[pass];
+			std::fill(m_errors.begin(), m_errors.end(), nullptr);
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Submission order is the pass order, independent of which job finished first
+	m_submission.clear();
+	for (uint32_t pass = 0; pass < numPasses; pass++)
+	{
+		m_submission.push_back(m_commandLists[pass].get());
+	}
+	pQueue->ExecuteCommandLists(numPasses, m_submission.data());
+}
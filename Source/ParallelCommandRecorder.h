@@ -0,0 +1,32 @@
+#pragma once
+
+// Records passes into separate command lists on the job system and submits them in pass order,
+// so the GPU sees the same command order no matter which worker recorded which pass.
+
+#include "RHI.h"
+#include "FramePipeline.h"
+#include "JobSystem.h"
+
+#include <exception>
+#include <functional>
+
+class ParallelCommandRecorder
+{
+public:
+	using RecordFunction = std::function<void(uint32_t passIndex, RHICommandList* pCommandList)>;
+
+	ParallelCommandRecorder(RHIDevice* pDevice, JobSystem* pJobSystem, uint32_t maxPasses);
+
+	// Pass i is recorded into command list i with allocator i of the current frame slot, `pFramePipeline` needs
+	// at least `numPasses` allocators. Command lists are opened/closed here. Exceptions of a pass are rethrown
+	void RecordAndSubmit(FramePipeline* pFramePipeline, RHICommandQueue* pQueue, uint32_t numPasses, const RecordFunction& record, RHIPipelineState* pInitialState = nullptr);
+
+	uint32_t GetMaxPasses() const { return uint32_t(m_commandLists.size()); }
+	RHICommandList* GetCommandList(uint32_t passIndex) { return m_commandLists[passIndex].get(); }
+
+private:
+	JobSystem*									m_pJobSystem;
+	std::vector<std::unique_ptr<RHICommandList>> m_commandLists;
+	std::vector<RHICommandList*>				m_submission;
+	std::vector<std::exception_ptr>				m_errors;
+};
@@ -0,0 +1,403 @@
+#include "PathTracer.h"
+#include "ImageBasedLighting.h"
+
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	enum : uint32_t
+	{
+		MaxLightsSampledTogether = 16,		// More lights than this are sampled one at a time, picked uniformly
+	};
+
+	constexpr float Pi = 3.14159265f;
+
+	Float3 Multiply(const Float3& a, const Float3& b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	float MaxComponent(const Float3& a) { return std::max({ a.x, a.y, a.z }); }
+
+	// Offset along the normal that keeps secondary rays off their own surface, relative to the position's magnitude
+	float GetRayOffset(const Float3& position)
+	{
+		return 1e-4f * std::max({ 1.0f, std::fabs(position.x), std::fabs(position.y), std::fabs(position.z) });
+	}
+
+	// Cosine weighted around `normal`, with the branchless orthonormal basis of Duff et al.
+	Float3 SampleCosineHemisphere(const Float3& normal, float u1, float u2)
+	{
+		const float sign = std::copysign(1.0f, normal.z);
+		const float a = -1.0f / (sign + normal.z);
+		const float b = normal.x * normal.y * a;
+		const Float3 tangent = { 1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+		const Float3 bitangent = { b, sign + normal.y * normal.y * a, -normal.y };
+		const float radius = std::sqrt(u1);
+		const float phi = 2.0f * Pi * u2;
+		return tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) + normal * std::sqrt(std::max(1.0f - u1, 0.0f));
+	}
+}
+
+// PCG32, one stream per (pixel, sample)
+class PathTracer::Random
+{
+public:
+	Random(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t seed)
+	{
+		uint64_t key = (uint64_t(pixelIndex) << 32 | sampleIndex) ^ (uint64_t(seed) * 0x9e3779b97f4a7c15ull);
+		// SplitMix64 finalizer, neighboring pixels must not start with correlated states
+		key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+		key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+		m_state = key ^ (key >> 31);
+		NextUint();
+	}
+
+	uint32_t NextUint()
+	{
+		const uint64_t state = m_state;
+		m_state = state * 6364136223846793005ull + 1442695040888963407ull;
+		const uint32_t xorShifted = uint32_t(((state >> 18) ^ state) >> 27);
+		const uint32_t rotation = uint32_t(state >> 59);
+		return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+	}
+
+	// [0, 1)
+	float NextFloat() { return float(NextUint() >> 8) * (1.0f / 16777216.0f); }
+
+private:
+	uint64_t m_state;
+};
+
+uint32_t PathTracerScene::AddMaterial(const PathTracerMaterial& material)
+{
+	materials.push_back(material);
+	return uint32_t(materials.size() - 1);
+}
+
+void PathTracerScene::AddTriangles(const Float3* pPositions, const ColorRGBA8* pColors, uint32_t numVertices, const uint32_t* pIndices, uint32_t numIndices, uint32_t material)
+{
+	const uint32_t baseVertex = uint32_t(positions.size());
+	positions.insert(positions.end(), pPositions, pPositions + numVertices);
+	for (uint32_t i = 0; i < numVertices; i++)
+	{
+		const Float4 color = pColors ? UnpackColorRGBA8(pColors[i]) : Float4{ 1.0f, 1.0f, 1.0f, 1.0f };
+		colors.push_back({ color.x, color.y, color.z });
+	}
+	for (uint32_t i = 0; i < numIndices; i++)
+	{
+		indices.push_back(baseVertex + pIndices[i]);
+	}
+	triangleMaterials.insert(triangleMaterials.end(), numIndices / 3, material);
+}
+
+void PathTracerScene::AddBox(const BoundingBox& box, uint32_t material)
+{
+	const Float3 corners[8] =
+	{
+		{ box.min.x, box.min.y, box.min.z }, { box.max.x, box.min.y, box.min.z }, { box.min.x, box.max.y, box.min.z }, { box.max.x, box.max.y, box.min.z },
+		{ box.min.x, box.min.y, box.max.z }, { box.max.x, box.min.y, box.max.z }, { box.min.x, box.max.y, box.max.z }, { box.max.x, box.max.y, box.max.z },
+	};
+	const uint32_t boxIndices[36] =
+	{
+		0, 2, 1, 1, 2, 3,	// -z
+		4, 5, 6, 5, 7, 6,	// +z
+		0, 4, 2, 2, 4, 6,	// -x
+		1, 3, 5, 3, 7, 5,	// +x
+		0, 1, 4, 1, 5, 4,	// -y
+		2, 6, 3, 3, 6, 7,	// +y
+	};
+	AddTriangles(corners, nullptr, 8, boxIndices, 36, material);
+}
+
+void PathTracerScene::Clear()
+{
+	positions.clear();
+	colors.clear();
+	indices.clear();
+	triangleMaterials.clear();
+	materials.clear();
+	lights.Clear();
+}
+
+PathTracer::PathTracer(JobSystem* pJobSystem, const PathTracerSettings& settings)
+	: m_pJobSystem(pJobSystem)
+	, m_settings(settings)
+	, m_bvh(pJobSystem)
+{
+	m_settings.tileSize = std::max(m_settings.tileSize, 1u);
+}
+
+void PathTracer::SetScene(const PathTracerScene& scene)
+{
+	const uint32_t numTriangles = scene.GetNumTriangles();
+	if (scene.colors.size() != scene.positions.size() || scene.triangleMaterials.size() != numTriangles ||
+		std::any_of(scene.triangleMaterials.begin(), scene.triangleMaterials.end(), [&](uint32_t material) { return material >= scene.materials.size(); }) ||
+		std::any_of(scene.indices.begin(), scene.indices.end(), [&](uint32_t index) { return index >= scene.positions.size(); }))
+	{
+		throw std::runtime_error("Invalid path tracer scene: streams, indices or materials are inconsistent");
+	}
+
+	m_pScene = &scene;
+	m_bvh.Build(scene.positions.data(), scene.indices.data(), numTriangles);
+	m_triangleNormals.resize(numTriangles);
+	for (uint32_t i = 0; i < numTriangles; i++)
+	{
+		const Float3& p0 = scene.positions[scene.indices[i * 3 + 0]];
+		const Float3 normal = Cross(scene.positions[scene.indices[i * 3 + 1]] - p0, scene.positions[scene.indices[i * 3 + 2]] - p0);
+		const float length = Length(normal);
+		m_triangleNormals[i] = length > 0.0f ? normal * (1.0f / length) : Float3{ 0.0f, 0.0f, 1.0f };
+	}
+	Reset(m_width, m_height);
+}
+
+void PathTracer::Reset(uint32_t width, uint32_t height)
+{
+	m_width = width;
+	m_height = height;
+	m_numTilesX = (width + m_settings.tileSize - 1) / m_settings.tileSize;
+	m_numTilesY = (height + m_settings.tileSize - 1) / m_settings.tileSize;
+	m_accumulation.assign(size_t(width) * height, { 0.0f, 0.0f, 0.0f });
+	m_numSamplesPerPixel = 0;
+	m_numRays = 0;
+	m_statistics = {};
+}
+
+void PathTracer::Render(const Camera& camera, uint32_t numSamples)
+{
+	if (!m_pScene)
+	{
+		throw std::runtime_error("PathTracer::Render() without a scene");
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+	const uint32_t firstSample = m_numSamplesPerPixel;
+	auto renderTiles = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t tile = begin; tile < end; tile++)
+		{
+			RenderTile(camera, tile, firstSample, numSamples);
+		}
+	};
+	JobCounter counter;
+	m_pJobSystem->ParallelFor(m_numTilesX * m_numTilesY, 1, renderTiles, &counter);
+	m_pJobSystem->Wait(&counter);
+
+	m_numSamplesPerPixel += numSamples;
+	m_statistics.numSamples += uint64_t(m_width) * m_height * numSamples;
+	m_statistics.numRays = m_numRays;
+	m_statistics.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	m_statistics.numThreads = m_pJobSystem->GetNumWorkerThreads() + 1;
+}
+
+void PathTracer::RenderTile(const Camera& camera, uint32_t tile, uint32_t firstSample, uint32_t numSamples)
+{
+	const float tanHalfFovY = std::tan(camera.fovY * 0.5f);
+	const Float3 forward = Normalize(camera.forward);
+	const Float3 right = Normalize(Cross(camera.up, forward)) * (tanHalfFovY * camera.aspectRatio);
+	const Float3 up = Normalize(Cross(forward, right)) * tanHalfFovY;
+
+	const uint32_t x0 = tile % m_numTilesX * m_settings.tileSize;
+	const uint32_t y0 = tile / m_numTilesX * m_settings.tileSize;
+	const uint32_t x1 = std::min(x0 + m_settings.tileSize, m_width);
+	const uint32_t y1 = std::min(y0 + m_settings.tileSize, m_height);
+	uint64_t numRays = 0;
+	for (uint32_t y = y0; y < y1; y++)
+	{
+		for (uint32_t x = x0; x < x1; x++)
+		{
+			const uint32_t pixelIndex = y * m_width + x;
+			Float3 sum = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t sample = firstSample; sample < firstSample + numSamples; sample++)
+			{
+				// Box filtered: uniform jitter within the pixel
+				Random random(pixelIndex, sample, m_settings.seed);
+				const float ndcX = (float(x) + random.NextFloat()) / float(m_width) * 2.0f - 1.0f;
+				const float ndcY = 1.0f - (float(y) + random.NextFloat()) / float(m_height) * 2.0f;
+				BvhRay ray;
+				ray.origin = camera.position;
+				ray.direction = Normalize(forward + right * ndcX + up * ndcY);
+				sum = sum + Trace(ray, random, numRays);
+			}
+			m_accumulation[pixelIndex] = m_accumulation[pixelIndex] + sum;
+		}
+	}
+	m_numRays += numRays;
+}
+
+Float3 PathTracer::TracePath(const BvhRay& ray, uint32_t pixelIndex, uint32_t sampleIndex, uint64_t& numRays) const
+{
+	Random random(pixelIndex, sampleIndex, m_settings.seed);
+	return Trace(ray, random, numRays);
+}
+
+void PathTracer::GatherIrradiance(const Float3& position, const Float3& normal, uint32_t sequenceIndex, uint32_t numSamples, Float3& direct, Float3& indirect, uint64_t& numRays) const
+{
+	// Up to MaxLightsSampledTogether candidates the light sampling has no noise, once is enough
+	const uint32_t numCandidates = m_pScene->lights.GetNumLights() + (MaxComponent(m_pScene->sunIlluminance) > 0.0f ? 1 : 0);
+	const uint32_t numLightSamples = numCandidates > MaxLightsSampledTogether ? std::max(numSamples, 1u) : 1;
+	direct = { 0.0f, 0.0f, 0.0f };
+	indirect = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t sample = 0; sample < std::max(numSamples, numLightSamples); sample++)
+	{
+		Random random(sequenceIndex, sample, m_settings.seed);
+		if (sample < numLightSamples)
+		{
+			direct = direct + SampleLights(position, normal, random, numRays);
+		}
+		if (sample < numSamples)
+		{
+			const float u1 = random.NextFloat();
+			const float u2 = random.NextFloat();
+			indirect = indirect + Trace({ position + normal * GetRayOffset(position), SampleCosineHemisphere(normal, u1, u2) }, random, numRays);
+		}
+	}
+	direct = direct * (1.0f / float(numLightSamples));
+	// Cosine weighted radiance samples: irradiance = pi * mean
+	indirect = numSamples > 0 ? indirect * (Pi / float(numSamples)) : indirect;
+}
+
+Float3 PathTracer::Trace(const BvhRay& cameraRay, Random& random, uint64_t& numRays) const
+{
+	const PathTracerScene& scene = *m_pScene;
+	Float3 radiance = { 0.0f, 0.0f, 0.0f };
+	Float3 throughput = { 1.0f, 1.0f, 1.0f };
+	BvhRay ray = cameraRay;
+	for (uint32_t bounce = 0;; bounce++)
+	{
+		BvhHit hit;
+		numRays++;
+		if (!m_bvh.Intersect(ray, hit))
+		{
+			radiance = radiance + Multiply(throughput, GetEnvironmentRadiance(ray.direction));
+			break;
+		}
+
+		const PathTracerMaterial& material = scene.materials[scene.triangleMaterials[hit.triangle]];
+		radiance = radiance + Multiply(throughput, material.emission);
+		if (bounce == m_settings.maxBounces)
+		{
+			break;
+		}
+
+		const uint32_t* pIndices = &scene.indices[hit.triangle * 3];
+		const Float3 vertexColor = scene.colors[pIndices[0]] * (1.0f - hit.u - hit.v) + scene.colors[pIndices[1]] * hit.u + scene.colors[pIndices[2]] * hit.v;
+		const Float3 albedo = Multiply(material.albedo, vertexColor);
+		const Float3 position = ray.origin + ray.direction * hit.t;
+		Float3 normal = m_triangleNormals[hit.triangle];
+		if (Dot(normal, ray.direction) > 0.0f)
+		{
+			normal = normal * -1.0f;
+		}
+
+		// Lambert: albedo / pi * irradiance, and the cosine weighted bounce carries exactly `albedo`
+		radiance = radiance + Multiply(throughput, Multiply(albedo, SampleLights(position, normal, random, numRays))) * (1.0f / Pi);
+		throughput = Multiply(throughput, albedo);
+		if (bounce + 1 >= m_settings.russianRouletteBounce)
+		{
+			const float survival = std::min(MaxComponent(throughput), 1.0f);
+			if (random.NextFloat() >= survival)
+			{
+				break;
+			}
+			throughput = throughput * (1.0f / survival);
+		}
+		if (MaxComponent(throughput) <= 0.0f)
+		{
+			break;
+		}
+
+		const float u1 = random.NextFloat();
+		const float u2 = random.NextFloat();
+		ray.origin = position + normal * GetRayOffset(position);
+		ray.direction = SampleCosineHemisphere(normal, u1, u2);
+		ray.tMin = 0.0f;
+		ray.tMax = 1e30f;
+	}
+	return radiance;
+}
+
+Float3 PathTracer::SampleLights(const Float3& position, const Float3& normal, Random& random, uint64_t& numRays) const
+{
+	const PathTracerScene& scene = *m_pScene;
+	const LightList& lights = scene.lights;
+	const bool bSun = MaxComponent(scene.sunIlluminance) > 0.0f;
+	const uint32_t numCandidates = lights.GetNumLights() + (bSun ? 1 : 0);
+	if (numCandidates == 0)
+	{
+		return { 0.0f, 0.0f, 0.0f };
+	}
+
+	uint32_t begin = 0;
+	uint32_t end = numCandidates;
+	float scale = 1.0f;
+	if (numCandidates > MaxLightsSampledTogether)
+	{
+		begin = std::min(uint32_t(random.NextFloat() * float(numCandidates)), numCandidates - 1);
+		end = begin + 1;
+		scale = float(numCandidates);
+	}
+
+	const Float3 origin = position + normal * GetRayOffset(position);
+	Float3 irradiance = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t light = begin; light < end; light++)
+	{
+		if (light == lights.GetNumLights())
+		{
+			const Float3 toSun = Normalize(scene.sunDirection) * -1.0f;
+			const float cosTheta = Dot(normal, toSun);
+			if (cosTheta <= 0.0f)
+			{
+				continue;
+			}
+			numRays++;
+			if (!m_bvh.IsOccluded({ origin, toSun, 0.0f, 1e30f }))
+			{
+				irradiance = irradiance + scene.sunIlluminance * cosTheta;
+			}
+			continue;
+		}
+
+		const Float3 toLight = Float3{ lights.positionX[light], lights.positionY[light], lights.positionZ[light] } - position;
+		const float distanceSquared = Dot(toLight, toLight);
+		const float radius = lights.radius[light];
+		if (distanceSquared >= radius * radius)
+		{
+			continue;
+		}
+		const Float3 direction = toLight * (1.0f / std::sqrt(distanceSquared));
+		const float cosTheta = Dot(normal, direction);
+		if (cosTheta <= 0.0f)
+		{
+			continue;
+		}
+		float attenuation = GetLightDistanceAttenuation(distanceSquared, radius);
+		if (lights.bIsSpot[light])
+		{
+			const float cosAngle = -Dot(direction, { lights.directionX[light], lights.directionY[light], lights.directionZ[light] });
+			attenuation *= GetSpotConeAttenuation(cosAngle, lights.cosOuterAngle[light]);
+		}
+		if (attenuation <= 0.0f)
+		{
+			continue;
+		}
+		numRays++;
+		if (!m_bvh.IsOccluded({ origin, toLight, 0.0f, 1.0f - 1e-4f }))
+		{
+			irradiance = irradiance + Float3{ lights.intensityR[light], lights.intensityG[light], lights.intensityB[light] } * (attenuation * cosTheta);
+		}
+	}
+	return irradiance * scale;
+}
+
+Float3 PathTracer::GetEnvironmentRadiance(const Float3& direction) const
+{
+	return m_pScene->pEnvironment ? IBLPrefilter::SampleCubemap(*m_pScene->pEnvironment, Normalize(direction)) : m_pScene->skyRadiance;
+}
+
+void PathTracer::ResolveImage(HdrImage& image) const
+{
+	image.Resize(m_width, m_height);
+	const float scale = m_numSamplesPerPixel > 0 ? 1.0f / float(m_numSamplesPerPixel) : 0.0f;
+	for (size_t i = 0; i < m_accumulation.size(); i++)
+	{
+		image.pixels[i] = m_accumulation[i] * scale;
+	}
+}
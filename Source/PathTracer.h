@@ -0,0 +1,122 @@
+#pragma once
+
+// Progressive CPU path tracer, the ground truth the raster lighting is compared against
+// Shares the raster path's scene description: vertex colored triangles, LightList point and spot lights with the
+// falloff of ClusteredLighting.h, a sun and an environment RadianceCubemap. Surfaces are Lambertian with the vertex
+// color times the material albedo, plus optional emission.
+//
+// Render() adds samples to an accumulation buffer, image tiles are rendered as jobs. Every sample draws its random
+// numbers from a generator seeded by (pixel, sample index), so images are bit exact for any number of workers. Splitting
+// the samples differently over Render() calls changes the float accumulation order, images then agree within rounding.
+// Lights are sampled directly (next event estimation), the environment and emissive surfaces are found by the cosine
+// weighted bounce rays.
+
+#include "Bvh.h"
+#include "Camera.h"
+#include "ClusteredLighting.h"
+#include "HdrImage.h"
+#include "SphericalHarmonics.h"
+#include "VertexPacking.h"
+
+#include <atomic>
+#include <vector>
+
+struct PathTracerMaterial
+{
+	Float3 albedo = { 0.8f, 0.8f, 0.8f };
+	Float3 emission = { 0.0f, 0.0f, 0.0f };		// Radiance
+};
+
+struct PathTracerScene
+{
+	uint32_t AddMaterial(const PathTracerMaterial& material);
+	// `pColors` (one per vertex, nullptr for white) is multiplied with the material albedo
+	void AddTriangles(const Float3* pPositions, const ColorRGBA8* pColors, uint32_t numVertices, const uint32_t* pIndices, uint32_t numIndices, uint32_t material);
+	// Closed box facing outwards
+	void AddBox(const BoundingBox& box, uint32_t material);
+	void Clear();
+
+	uint32_t GetNumTriangles() const { return uint32_t(indices.size() / 3); }
+
+	std::vector<Float3>				positions;
+	std::vector<Float3>				colors;
+	std::vector<uint32_t>			indices;
+	std::vector<uint32_t>			triangleMaterials;
+	std::vector<PathTracerMaterial>	materials;
+
+	LightList				lights;
+	Float3					sunDirection = { 0.0f, -1.0f, 0.0f };	// Direction the light travels
+	Float3					sunIlluminance = { 0.0f, 0.0f, 0.0f };	// Perpendicular to the sun direction, 0 disables the sun
+	// Radiance of rays leaving the scene, `skyRadiance` when there is no environment. Must outlive the PathTracer
+	const RadianceCubemap*	pEnvironment = nullptr;
+	Float3					skyRadiance = { 0.0f, 0.0f, 0.0f };
+};
+
+struct PathTracerSettings
+{
+	uint32_t	maxBounces = 8;
+	uint32_t	russianRouletteBounce = 3;		// First bounce that may terminate paths early
+	uint32_t	tileSize = 16;
+	uint32_t	seed = 0;
+};
+
+struct PathTracerStatistics
+{
+	uint64_t	numSamples = 0;		// Camera paths, over all Render() calls since Reset()
+	uint64_t	numRays = 0;		// Including shadow rays
+	double		seconds = 0.0;
+	uint32_t	numThreads = 1;		// Workers plus the calling thread
+
+	double GetSamplesPerSecond() const { return seconds > 0.0 ? double(numSamples) / seconds : 0.0; }
+	double GetSamplesPerSecondPerThread() const { return GetSamplesPerSecond() / numThreads; }
+};
+
+class PathTracer
+{
+public:
+	explicit PathTracer(JobSystem* pJobSystem, const PathTracerSettings& settings = {});
+
+	// Builds the BVH, the scene must outlive the PathTracer. Resets the accumulation
+	void SetScene(const PathTracerScene& scene);
+	// Clears the accumulation, e.g. when the camera moves
+	void Reset(uint32_t width, uint32_t height);
+
+	// Adds `numSamples` samples per pixel, blocks until done
+	void Render(const Camera& camera, uint32_t numSamples);
+
+	// Average of the accumulated samples, linear radiance
+	void ResolveImage(HdrImage& image) const;
+	uint32_t GetNumSamplesPerPixel() const { return m_numSamplesPerPixel; }
+	const PathTracerStatistics& GetStatistics() const { return m_statistics; }
+	const Bvh& GetBvh() const { return m_bvh; }
+
+	// One path, for tests. `sampleIndex` selects the random sequence
+	Float3 TracePath(const BvhRay& ray, uint32_t pixelIndex, uint32_t sampleIndex, uint64_t& numRays) const;
+	// Irradiance at a surface point, for bakers. `direct` is from the lights and the sun, with shadow rays, `indirect`
+	// from everything else (environment, emission, bounces) gathered with `numSamples` cosine weighted paths.
+	// `sequenceIndex` selects the random sequences like the pixel index of TracePath()
+	void GatherIrradiance(const Float3& position, const Float3& normal, uint32_t sequenceIndex, uint32_t numSamples, Float3& direct, Float3& indirect, uint64_t& numRays) const;
+
+private:
+	class Random;
+
+	void RenderTile(const Camera& camera, uint32_t tile, uint32_t firstSample, uint32_t numSamples);
+	Float3 Trace(const BvhRay& cameraRay, Random& random, uint64_t& numRays) const;
+	Float3 SampleLights(const Float3& position, const Float3& normal, Random& random, uint64_t& numRays) const;
+	Float3 GetEnvironmentRadiance(const Float3& direction) const;
+
+	JobSystem*					m_pJobSystem;
+	PathTracerSettings			m_settings;
+	const PathTracerScene*		m_pScene = nullptr;
+	Bvh							m_bvh;
+	std::vector<Float3>			m_triangleNormals;
+
+	uint32_t					m_width = 0;
+	uint32_t					m_height = 0;
+	uint32_t					m_numTilesX = 0;
+	uint32_t					m_numTilesY = 0;
+	std::vector<Float3>			m_accumulation;		// Sum of the samples
+	uint32_t					m_numSamplesPerPixel = 0;
+	std::atomic<uint64_t>		m_numRays = 0;
+	PathTracerStatistics		m_statistics;
+};
@@ -0,0 +1,482 @@
+#include "PipelineCache.h"
+#include "FileIO.h"
+#include "FileView.h"
+#include "Hash.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace
+{
+	enum : uint32_t
+	{
+		PipelineCacheMagic = 0x434f5350,	// "PSOC"
+		PipelineCacheVersion = 1,
+	};
+
+	class BinaryWriter
+	{
+	public:
+		template <typename T>
+		void Write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&value);
+			m_data.insert(m_data.end(), pBytes, pBytes + sizeof(T));
+		}
+		void WriteBytes(const void* pData, size_t size)
+		{
+			Write(uint32_t(size));
+			const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+			m_data.insert(m_data.end(), pBytes, pBytes + size);
+		}
+		void WriteString(const std::string& value) { WriteBytes(value.data(), value.size()); }
+		// wchar_t is 2 bytes on Windows and 4 on Linux, always stored as 32 bit
+		void WriteWideString(const std::wstring& value)
+		{
+			Write(uint32_t(value.size()));
+			for (wchar_t c : value)
+			{
+				Write(uint32_t(c));
+			}
+		}
+
+		const std::vector<uint8_t>& GetData() const { return m_data; }
+
+	private:
+		std::vector<uint8_t> m_data;
+	};
+
+	// Every read is bounds checked, a truncated file fails instead of crashing
+	class BinaryReader
+	{
+	public:
+		BinaryReader(const uint8_t* pData, uint64_t size) : m_pData(pData), m_size(size) {}
+
+		template <typename T>
+		bool Read(T& value)
+		{
+			if (m_size - m_offset < sizeof(T))
+			{
+				return false;
+			}
+			memcpy(&value, m_pData + m_offset, sizeof(T));
+			m_offset += sizeof(T);
+			return true;
+		}
+		bool ReadBytes(std::vector<uint8_t>& bytes)
+		{
+			uint32_t size = 0;
+			if (!Read(size) || m_size - m_offset < size)
+			{
+				return false;
+			}
+			bytes.assign(m_pData + m_offset, m_pData + m_offset + size);
+			m_offset += size;
+			return true;
+		}
+		bool ReadString(std::string& value)
+		{
+			uint32_t size = 0;
+			if (!Read(size) || m_size - m_offset < size)
+			{
+				return false;
+			}
+			value.assign(reinterpret_cast<const char*>(m_pData + m_offset), size);
+			m_offset += size;
+			return true;
+		}
+		bool ReadWideString(std::wstring& value)
+		{
+			uint32_t size = 0;
+			if (!Read(size) || (m_size - m_offset) / sizeof(uint32_t) < size)
+			{
+				return false;
+			}
+			value.resize(size);
+			for (wchar_t& c : value)
+			{
+				uint32_t character = 0;
+				if (!Read(character))
+				{
+					return false;
+				}
+				c = wchar_t(character);
+			}
+			return true;
+		}
+
+	private:
+		const uint8_t*	m_pData;
+		uint64_t		m_size;
+		uint64_t		m_offset = 0;
+	};
+
+	uint64_t HashShaderDesc(const RHIShaderDesc& shader, uint64_t seed)
+	{
+		seed = HashBytes(shader.fileName.data(), shader.fileName.size() * sizeof(wchar_t), seed);
+		seed = HashString(shader.entryPoint, seed);
+		return HashString(shader.target, seed);
+	}
+
+	bool AreShaderDescsEqual(const RHIShaderDesc& a, const RHIShaderDesc& b)
+	{
+		return a.fileName == b.fileName && a.entryPoint == b.entryPoint && a.target == b.target;
+	}
+
+	void WriteShaderDesc(BinaryWriter& writer, const RHIShaderDesc& shader)
+	{
+		writer.WriteWideString(shader.fileName);
+		writer.WriteString(shader.entryPoint);
+		writer.WriteString(shader.target);
+	}
+
+	bool ReadShaderDesc(BinaryReader& reader, RHIShaderDesc& shader)
+	{
+		return reader.ReadWideString(shader.fileName) && reader.ReadString(shader.entryPoint) && reader.ReadString(shader.target);
+	}
+
+	// Enums come straight from the file, values this build does not know would reach the driver
+	bool IsValidPipelineDesc(const RHIGraphicsPipelineDesc& desc)
+	{
+		const bool bValidLayout = std::all_of(desc.inputLayout.begin(), desc.inputLayout.end(), [](const RHIInputElementDesc& element) { return GetFormatSize(element.format) != 0; });
+		const bool bValidTarget = desc.renderTargetFormat == RHIFormat::Unknown || GetFormatSize(desc.renderTargetFormat) != 0;
+		return bValidLayout && bValidTarget && desc.topology == RHIPrimitiveTopology::TriangleList;
+	}
+}
+
+RHIGraphicsPipelineDesc CanonicalizePipelineDesc(const RHIGraphicsPipelineDesc& desc)
+{
+	RHIGraphicsPipelineDesc canonical = desc;
+
+	std::replace(canonical.vertexShader.fileName.begin(), canonical.vertexShader.fileName.end(), L'\\', L'/');
+	std::replace(canonical.pixelShader.fileName.begin(), canonical.pixelShader.fileName.end(), L'\\', L'/');
+
+	// Same rule as D3D12_APPEND_ALIGNED_ELEMENT, offsets follow the declaration order per slot
+	std::vector<uint32_t> slotOffsets;
+	for (RHIInputElementDesc& element : canonical.inputLayout)
+	{
+		if (element.inputSlot >= slotOffsets.size())
+		{
+			slotOffsets.resize(element.inputSlot + 1, 0);
+		}
+		if (element.alignedByteOffset == RHIAppendAlignedElement)
+		{
+			element.alignedByteOffset = slotOffsets[element.inputSlot];
+		}
+		slotOffsets[element.inputSlot] = element.alignedByteOffset + GetFormatSize(element.format);
+	}
+
+	// Elements are matched by semantic, declaration order does not change the pipeline
+	std::sort(canonical.inputLayout.begin(), canonical.inputLayout.end(), [](const RHIInputElementDesc& a, const RHIInputElementDesc& b)
+	{
+		return a.inputSlot != b.inputSlot ? a.inputSlot < b.inputSlot : a.alignedByteOffset < b.alignedByteOffset;
+	});
+	return canonical;
+}
+
+uint64_t HashPipelineDesc(const RHIGraphicsPipelineDesc& desc)
+{
+	uint64_t hash = HashShaderDesc(desc.vertexShader, 0);
+	hash = HashShaderDesc(desc.pixelShader, hash);
+	for (const RHIInputElementDesc& element : desc.inputLayout)
+	{
+		hash = HashBytes(element.semanticName, strlen(element.semanticName), hash);
+		const uint32_t fields[] = { element.semanticIndex, uint32_t(element.format), element.inputSlot, element.alignedByteOffset };
+		hash = HashBytes(fields, sizeof(fields), hash);
+	}
+	const uint32_t states[] = { uint32_t(desc.topology), uint32_t(desc.renderTargetFormat), uint32_t(desc.bDepthEnable) };
+	return HashBytes(states, sizeof(states), hash);
+}
+
+bool ArePipelineDescsEqual(const RHIGraphicsPipelineDesc& a, const RHIGraphicsPipelineDesc& b)
+{
+	if (!AreShaderDescsEqual(a.vertexShader, b.vertexShader) || !AreShaderDescsEqual(a.pixelShader, b.pixelShader) ||
+		a.topology != b.topology || a.renderTargetFormat != b.renderTargetFormat || a.bDepthEnable != b.bDepthEnable ||
+		a.inputLayout.size() != b.inputLayout.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < a.inputLayout.size(); i++)
+	{
+		const RHIInputElementDesc& elementA = a.inputLayout[i];
+		const RHIInputElementDesc& elementB = b.inputLayout[i];
+		if (strcmp(elementA.semanticName, elementB.semanticName) != 0 || elementA.semanticIndex != elementB.semanticIndex ||
+			elementA.format != elementB.format || elementA.inputSlot != elementB.inputSlot || elementA.alignedByteOffset != elementB.alignedByteOffset)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+PipelineCache::PipelineCache(RHIDevice* pDevice, uint32_t numWorkers)
+	: m_pDevice(pDevice)
+{
+	for (uint32_t i = 0; i < std::max(numWorkers, 1u); i++)
+	{
+		m_workers.emplace_back(&PipelineCache::WorkerMain, this);
+	}
+}
+
+PipelineCache::~PipelineCache()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_workDone.wait(lock, [this] { return m_numPending == 0; });
+		m_bExit = true;
+	}
+	m_workAvailable.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+PipelineCache::PipelineFuture PipelineCache::RequestAsync(const RHIGraphicsPipelineDesc& desc)
+{
+	m_statistics.requests++;
+
+	RHIGraphicsPipelineDesc canonicalDesc = CanonicalizePipelineDesc(desc);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	bool bInserted = false;
+	Entry* pEntry = FindOrInsert(std::move(canonicalDesc), bInserted);
+	if (bInserted)
+	{
+		Enqueue(pEntry);
+	}
+	else
+	{
+		m_statistics.hits++;
+	}
+	return pEntry->future;
+}
+
+PipelineCache::Entry* PipelineCache::FindOrInsert(RHIGraphicsPipelineDesc&& canonicalDesc, bool& bInserted)
+{
+	const uint64_t hash = HashPipelineDesc(canonicalDesc);
+
+	// Full compare guards against hash collisions
+	auto range = m_entries.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (ArePipelineDescsEqual(it->second->desc, canonicalDesc))
+		{
+			bInserted = false;
+			return it->second.get();
+		}
+	}
+
+	for (RHIInputElementDesc& element : canonicalDesc.inputLayout)
+	{
+		element.semanticName = m_semanticNames.insert(element.semanticName).first->c_str();
+	}
+
+	std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+	entry->desc = std::move(canonicalDesc);
+	entry->future = entry->promise.get_future().share();
+	Entry* pEntry = entry.get();
+	m_entries.emplace(hash, std::move(entry));
+	bInserted = true;
+	return pEntry;
+}
+
+void PipelineCache::Enqueue(Entry* pEntry)
+{
+	m_queue.push_back(pEntry);
+	m_numPending++;
+	m_workAvailable.notify_one();
+}
+
+void PipelineCache::WorkerMain()
+{
+	PROFILE_THREAD("Pipeline compiler");
+	for (;;)
+	{
+		Entry* pEntry = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workAvailable.wait(lock, [this] { return m_bExit || !m_queue.empty(); });
+			if (m_queue.empty())
+			{
+				return;
+			}
+			pEntry = m_queue.front();
+			m_queue.pop_front();
+		}
+
+		CreatePipeline(pEntry);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_numPending--;
+		}
+		m_workDone.notify_all();
+	}
+}
+
+void PipelineCache::CreatePipeline(Entry* pEntry)
+{
+	PROFILE_SCOPE("PipelineCache::CreatePipeline");
+	// Entry fields are only written here until the promise is fulfilled
+	try
+	{
+		pEntry->pipelineState = m_pDevice->CreateGraphicsPipelineState(pEntry->desc, pEntry->cachedBlob.empty() ? nullptr : &pEntry->cachedBlob);
+		pEntry->cachedBlob.clear();
+		pEntry->pipelineState->GetCachedBlob(pEntry->cachedBlob);
+		m_statistics.creations++;
+		pEntry->promise.set_value(pEntry->pipelineState.get());
+	}
+	catch (...)
+	{
+		m_statistics.failures++;
+		pEntry->promise.set_exception(std::current_exception());
+	}
+}
+
+void PipelineCache::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_workDone.wait(lock, [this] { return m_numPending == 0; });
+}
+
+size_t PipelineCache::GetNumPipelines() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+bool PipelineCache::Load(const std::wstring& fileName)
+{
+	PROFILE_SCOPE("PipelineCache::Load");
+	FileView view;
+	if (!view.Open(fileName))
+	{
+		return false;
+	}
+
+	BinaryReader reader(view.GetData(), view.GetSize());
+	uint32_t magic = 0, version = 0, backend = 0, numEntries = 0;
+	if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(backend) || !reader.Read(numEntries) ||
+		magic != PipelineCacheMagic || version != PipelineCacheVersion || backend != uint32_t(m_pDevice->GetBackend()))
+	{
+		return false;
+	}
+
+	// Parse everything first, a truncated file adds nothing. Counts come from the file, entries and elements are
+	// appended as they are read so a corrupt count runs out of bytes instead of allocating it up front
+	std::vector<RHIGraphicsPipelineDesc> descs;
+	std::vector<std::vector<uint8_t>> blobs;
+	std::vector<std::string> semanticNames;
+	std::vector<std::vector<uint32_t>> semanticNameIndices;
+	for (uint32_t i = 0; i < numEntries; i++)
+	{
+		RHIGraphicsPipelineDesc& desc = descs.emplace_back();
+		semanticNameIndices.emplace_back();
+		uint32_t numElements = 0;
+		if (!ReadShaderDesc(reader, desc.vertexShader) || !ReadShaderDesc(reader, desc.pixelShader) || !reader.Read(numElements))
+		{
+			return false;
+		}
+		for (uint32_t element = 0; element < numElements; element++)
+		{
+			RHIInputElementDesc& elementDesc = desc.inputLayout.emplace_back();
+			std::string semanticName;
+			if (!reader.ReadString(semanticName) || !reader.Read(elementDesc.semanticIndex) || !reader.Read(elementDesc.format) ||
+				!reader.Read(elementDesc.inputSlot) || !reader.Read(elementDesc.alignedByteOffset))
+			{
+				return false;
+			}
+			semanticNameIndices[i].push_back(uint32_t(semanticNames.size()));
+			semanticNames.push_back(std::move(semanticName));
+		}
+		uint8_t bDepthEnable = 0;
+		if (!reader.Read(desc.topology) || !reader.Read(desc.renderTargetFormat) || !reader.Read(bDepthEnable) || !reader.ReadBytes(blobs.emplace_back()))
+		{
+			return false;
+		}
+		desc.bDepthEnable = bDepthEnable != 0;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < descs.size(); i++)
+	{
+		// Only this entry is dropped, the rest of the file parsed fine
+		if (!IsValidPipelineDesc(descs[i]))
+		{
+			continue;
+		}
+		for (size_t element = 0; element < descs[i].inputLayout.size(); element++)
+		{
+			descs[i].inputLayout[element].semanticName = semanticNames[semanticNameIndices[i][element]].c_str();
+		}
+
+		bool bInserted = false;
+		Entry* pEntry = FindOrInsert(std::move(descs[i]), bInserted);
+		if (bInserted)
+		{
+			pEntry->cachedBlob = std::move(blobs[i]);
+			m_statistics.prewarmed++;
+			Enqueue(pEntry);
+		}
+	}
+	return true;
+}
+
+bool PipelineCache::Save(const std::wstring& fileName)
+{
+	PROFILE_SCOPE("PipelineCache::Save");
+	WaitForAll();
+
+	BinaryWriter writer;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Requests racing with Save() are skipped, their entries are still being written by the workers
+		std::vector<const Entry*> entries;
+		for (const auto& it : m_entries)
+		{
+			if (it.second->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready && it.second->pipelineState)
+			{
+				entries.push_back(it.second.get());
+			}
+		}
+		const uint32_t numEntries = uint32_t(entries.size());
+		writer.Write(uint32_t(PipelineCacheMagic));
+		writer.Write(uint32_t(PipelineCacheVersion));
+		writer.Write(uint32_t(m_pDevice->GetBackend()));
+		writer.Write(numEntries);
+
+		for (const Entry* pEntry : entries)
+		{
+			const Entry& entry = *pEntry;
+			WriteShaderDesc(writer, entry.desc.vertexShader);
+			WriteShaderDesc(writer, entry.desc.pixelShader);
+			writer.Write(uint32_t(entry.desc.inputLayout.size()));
+			for (const RHIInputElementDesc& element : entry.desc.inputLayout)
+			{
+				writer.WriteString(element.semanticName);
+				writer.Write(element.semanticIndex);
+				writer.Write(element.format);
+				writer.Write(element.inputSlot);
+				writer.Write(element.alignedByteOffset);
+			}
+			writer.Write(entry.desc.topology);
+			writer.Write(entry.desc.renderTargetFormat);
+			writer.Write(uint8_t(entry.desc.bDepthEnable));
+			writer.WriteBytes(entry.cachedBlob.data(), entry.cachedBlob.size());
+		}
+	}
+
+	// A crash while saving keeps the previous file
+	try
+	{
+		WriteFileAtomically(fileName, writer.GetData().data(), writer.GetData().size());
+	}
+	catch (const FileIOException&)
+	{
+		return false;
+	}
+	return true;
+}
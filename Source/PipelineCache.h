@@ -0,0 +1,88 @@
+#pragma once
+
+// Pipeline state object cache
+// Descriptors are canonicalized and hashed, identical requests share one PSO. Creation runs on background
+// threads and callers get a future. The set of known descriptors (plus driver blobs when the backend has them)
+// is saved to disk, so the next launch can create every PSO ahead of the first request.
+
+#include "RHI.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+// Resolves RHIAppendAlignedElement, orders the input layout by slot/offset and unifies shader path separators.
+// Semantic names still point to the caller's strings.
+RHIGraphicsPipelineDesc CanonicalizePipelineDesc(const RHIGraphicsPipelineDesc& desc);
+// Expects a canonical descriptor. Semantic names are hashed by content
+uint64_t HashPipelineDesc(const RHIGraphicsPipelineDesc& desc);
+bool ArePipelineDescsEqual(const RHIGraphicsPipelineDesc& a, const RHIGraphicsPipelineDesc& b);
+
+struct PipelineCacheStatistics
+{
+	std::atomic<uint32_t> requests = 0;
+	std::atomic<uint32_t> hits = 0;			// Request deduplicated against an existing entry
+	std::atomic<uint32_t> creations = 0;
+	std::atomic<uint32_t> prewarmed = 0;	// Entries loaded from disk
+	std::atomic<uint32_t> failures = 0;
+};
+
+class PipelineCache
+{
+public:
+	using PipelineFuture = std::shared_future<RHIPipelineState*>;
+
+	PipelineCache(RHIDevice* pDevice, uint32_t numWorkers = 1);
+	// Waits for pending creations
+	~PipelineCache();
+
+	// Thread safe. The future rethrows creation errors. Returned pipelines live as long as the cache
+	PipelineFuture RequestAsync(const RHIGraphicsPipelineDesc& desc);
+	RHIPipelineState* GetOrCreate(const RHIGraphicsPipelineDesc& desc) { return RequestAsync(desc).get(); }
+	void WaitForAll();
+
+	// Load queues creation of every stored descriptor. Files from another backend or version are ignored, entries with
+	// formats or topologies this build does not know are dropped
+	bool Load(const std::wstring& fileName);
+	// Waits for pending creations, failed entries are not stored
+	bool Save(const std::wstring& fileName);
+
+	size_t GetNumPipelines() const;
+	const PipelineCacheStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+	struct Entry
+	{
+		RHIGraphicsPipelineDesc				desc;
+		std::vector<uint8_t>				cachedBlob;
+		std::unique_ptr<RHIPipelineState>	pipelineState;
+		std::promise<RHIPipelineState*>		promise;
+		PipelineFuture						future;
+	};
+
+	// Called with m_mutex held. Semantic names are moved to m_semanticNames so entries outlive the request
+	Entry* FindOrInsert(RHIGraphicsPipelineDesc&& canonicalDesc, bool& bInserted);
+	void Enqueue(Entry* pEntry);
+	void CreatePipeline(Entry* pEntry);
+	void WorkerMain();
+
+	RHIDevice*											m_pDevice;
+
+	mutable std::mutex									m_mutex;
+	std::unordered_multimap<uint64_t, std::unique_ptr<Entry>>	m_entries;
+	std::set<std::string>								m_semanticNames;
+
+	std::condition_variable								m_workAvailable;
+	std::condition_variable								m_workDone;
+	std::deque<Entry*>									m_queue;
+	uint32_t											m_numPending = 0;
+	bool												m_bExit = false;
+	std::vector<std::thread>							m_workers;
+
+	PipelineCacheStatistics								m_statistics;
+};
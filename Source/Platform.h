@@ -0,0 +1,99 @@
+#pragma once
+
+// Platform independent helpers, safe to include from code that should also build without Windows SDK
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <unistd.h>
+	#include <limits.h>
+	// SAL annotations are MSVC only
+	#define _In_
+	#define _Out_
+	#define _In_reads_(x)
+	#define _Out_writes_(x)
+	#define _Use_decl_annotations_
+#endif
+
+#if defined(_DEBUG) || defined(DBG) || defined(DEBUG)
+	#define BUILD_DEBUG 1
+#else
+	#define BUILD_DEBUG 0
+#endif
+
+// 2 indirection, to avoid creating "__LINE__"
+#define __to_string_helper(x)			#x
+#define __to_string(x)					__to_string_helper(x)
+
+#define check(x) if (x) { throw std::runtime_error("file: " __FILE__ ", " __to_string(__LINE__) ": " #x); }
+
+// Folder containing the running executable, with trailing separator
+inline std::wstring GetExecutableDirectory()
+{
+#if defined(_WIN32)
+	wchar_t path[512];
+	uint32_t size = GetModuleFileName(nullptr, path, _countof(path));
+	if (size == 0 || size == _countof(path))
+	{
+		// size == pathSize means buffer (path) is too small to hold the string
+		throw std::exception();
+	}
+	std::wstring directory(path, size);
+	return directory.substr(0, directory.find_last_of(L'\\') + 1);
+#else
+	char exePath[PATH_MAX]{};
+	ssize_t size = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+	if (size <= 0)
+	{
+		throw std::exception();
+	}
+	std::string directory(exePath, size_t(size));
+	directory = directory.substr(0, directory.find_last_of('/') + 1);
+
+	std::wstring result(directory.size() + 1, L'\0');
+	size_t converted = mbstowcs(result.data(), directory.c_str(), result.size());
+	if (converted == static_cast<size_t>(-1))
+	{
+		throw std::exception();
+	}
+	result.resize(converted);
+	return result;
+#endif
+}
+
+// Folder of the engine sources (this header), shaders are compiled from the source tree
+inline std::wstring GetSourceDirectory()
+{
+	const std::string file = __FILE__;
+	return std::wstring(file.begin(), file.begin() + file.find_last_of("\\/") + 1);
+}
+
+inline void GetAssetsPath(_Out_writes_(pathSize) wchar_t* path, uint32_t pathSize)
+{
+	if (path == nullptr)
+	{
+		throw std::exception();
+	}
+
+	// Binaries are in Build/<Config>/ on Windows, single config generators put them directly in the build folder
+#if defined(_WIN32)
+	const std::wstring assetsPath = GetExecutableDirectory() + L"..\\..\\Source\\";
+#else
+	const std::wstring assetsPath = GetExecutableDirectory() + L"../Source/";
+#endif
+	if (assetsPath.size() + 1 > pathSize)
+	{
+		throw std::exception();
+	}
+	path[assetsPath.copy(path, pathSize - 1)] = L'\0';
+}
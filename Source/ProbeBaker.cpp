@@ -0,0 +1,94 @@
+#include "ProbeBaker.h"
+#include "FileIO.h"
+
+#include <cstring>
+
+Float3 ProbeGridDesc::GetProbePosition(uint32_t index) const
+{
+	const uint32_t coordinates[3] = { index % size[0], index / size[0] % size[1], index / (size[0] * size[1]) };
+	const float boundsMin[3] = { bounds.min.x, bounds.min.y, bounds.min.z };
+	const float boundsMax[3] = { bounds.max.x, bounds.max.y, bounds.max.z };
+	float position[3];
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const float t = size[axis] > 1 ? float(coordinates[axis]) / float(size[axis] - 1) : 0.5f;
+		position[axis] = boundsMin[axis] + (boundsMax[axis] - boundsMin[axis]) * t;
+	}
+	return { position[0], position[1], position[2] };
+}
+
+ProbeBaker::ProbeBaker(JobSystem* pJobSystem, uint32_t captureSize)
+	: m_pJobSystem(pJobSystem)
+	, m_projector(captureSize)
+{
+}
+
+std::vector<SHColor> ProbeBaker::Bake(const ProbeGridDesc& grid, const ProbeRadianceCapture& capture)
+{
+	if (grid.GetNumProbes() > UINT32_MAX)
+	{
+		throw std::runtime_error("Can not bake probe volume: too many probes");
+	}
+	std::vector<SHColor> probes(size_t(grid.GetNumProbes()));
+	auto bakeProbes = [&](uint32_t begin, uint32_t end)
+	{
+		RadianceCubemap cubemap;
+		cubemap.Resize(m_projector.GetCubemapSize());
+		for (uint32_t i = begin; i < end; i++)
+		{
+			capture(grid.GetProbePosition(i), cubemap);
+			probes[i] = ConvolveSHCosine(m_projector.Project(cubemap));
+		}
+	};
+	JobCounter counter;
+	m_pJobSystem->ParallelFor(uint32_t(probes.size()), ProbeBatchSize, bakeProbes, &counter);
+	m_pJobSystem->Wait(&counter);
+	return probes;
+}
+
+SHColor ProbeBaker::BakeEnvironment(const RadianceCubemap& environment)
+{
+	return ConvolveSHCosine(SHProjector(environment.size).Project(environment));
+}
+
+std::vector<uint8_t> CookProbeVolume(const ProbeGridDesc& grid, const std::vector<SHColor>& probes)
+{
+	const uint64_t numProbes = grid.GetNumProbes();
+	if (numProbes > UINT32_MAX)
+	{
+		throw std::runtime_error("Can not cook probe volume: too many probes");
+	}
+	if (numProbes == 0 || numProbes != probes.size())
+	{
+		throw std::runtime_error("Can not cook probe volume: probe count does not match the grid");
+	}
+
+	ProbeVolumeHeader header = {};
+	header.magic = ProbeVolumeMagic;
+	header.version = ProbeVolumeVersion;
+	memcpy(header.gridSize, grid.size, sizeof(header.gridSize));
+	header.numCoefficients = SHNumCoefficients;
+	header.bounds = grid.bounds;
+	header.planeOffset = ProbeVolumePlaneAlignment;
+	const uint64_t planeStride = GetProbeVolumePlaneStride(numProbes);
+	header.fileSize = header.planeOffset + planeStride * SHNumCoefficients;
+	static_assert(sizeof(ProbeVolumeHeader) <= ProbeVolumePlaneAlignment, "Header must fit before the first plane");
+
+	std::vector<uint8_t> data(header.fileSize, 0);
+	memcpy(data.data(), &header, sizeof(header));
+	for (uint32_t i = 0; i < SHNumCoefficients; i++)
+	{
+		Half4* pPlane = reinterpret_cast<Half4*>(data.data() + header.planeOffset + i * planeStride);
+		for (size_t probe = 0; probe < probes.size(); probe++)
+		{
+			const Float3& value = probes[probe].coefficients[i];
+			pPlane[probe] = { FloatToHalf(value.x), FloatToHalf(value.y), FloatToHalf(value.z), 0 };
+		}
+	}
+	return data;
+}
+
+void WriteProbeVolumeFile(const std::wstring& fileName, const std::vector<uint8_t>& cookedVolume)
+{
+	WriteFileAtomically(fileName, cookedVolume.data(), cookedVolume.size());
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Offline side of ProbeVolume.h: bakes L2 SH irradiance for a grid of probes and cooks the .probes file
+// Every probe captures a small radiance cubemap at its position through a callback (a scene render, a ray caster,
+// or an environment lookup), which is projected with the SIMD SHProjector. Probes are baked in batches on the
+// JobSystem, each batch reuses one capture cubemap.
+
+#include "JobSystem.h"
+#include "ProbeVolume.h"
+
+#include <functional>
+#include <vector>
+
+struct ProbeGridDesc
+{
+	uint32_t	size[3] = { 16, 16, 16 };
+	BoundingBox	bounds = { { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f } };
+
+	// 64 bit, grids of more than UINT32_MAX probes are rejected by Bake() and CookProbeVolume()
+	uint64_t GetNumProbes() const { return uint64_t(size[0]) * size[1] * size[2]; }
+	// x fastest then y then z, like the file
+	Float3 GetProbePosition(uint32_t index) const;
+};
+
+// Fills every texel of `cubemap` (already sized) with the radiance seen from `position`. Called from worker threads
+using ProbeRadianceCapture = std::function<void(const Float3& position, RadianceCubemap& cubemap)>;
+
+class ProbeBaker
+{
+public:
+	enum : uint32_t
+	{
+		DefaultCaptureSize = 8,		// L2 only keeps low frequencies, 8x8 faces are plenty
+		ProbeBatchSize = 64,
+	};
+
+	explicit ProbeBaker(JobSystem* pJobSystem, uint32_t captureSize = DefaultCaptureSize);
+
+	// Irradiance SH per probe, in grid order
+	std::vector<SHColor> Bake(const ProbeGridDesc& grid, const ProbeRadianceCapture& capture);
+	// Irradiance SH of a distant environment, any cubemap size
+	static SHColor BakeEnvironment(const RadianceCubemap& environment);
+
+	uint32_t GetCaptureSize() const { return m_projector.GetCubemapSize(); }
+
+private:
+	JobSystem*	m_pJobSystem;
+	SHProjector	m_projector;
+};
+
+// Throws std::runtime_error if the probe count does not match the grid
+std::vector<uint8_t> CookProbeVolume(const ProbeGridDesc& grid, const std::vector<SHColor>& probes);
+// Writes a temporary and renames it, readers never see a partial file. Throws FileIOException
+void WriteProbeVolumeFile(const std::wstring& fileName, const std::vector<uint8_t>& cookedVolume);
@@ -0,0 +1,135 @@
+#include "ProbeVolume.h"
+
+#include <algorithm>
+
+namespace
+{
+	[[noreturn]] void ThrowInvalidProbeVolume(const char* reason)
+	{
+		throw std::runtime_error(std::string("Invalid probe volume: ") + reason);
+	}
+}
+
+void ProbeVolume::Open(const std::wstring& fileName)
+{
+	m_view.OpenOrThrow(fileName);
+	m_pData = m_view.GetData();
+	m_size = m_view.GetSize();
+	Validate();
+}
+
+void ProbeVolume::OpenFromMemory(const uint8_t* pData, uint64_t size)
+{
+	m_view.Close();
+	m_pData = pData;
+	m_size = size;
+	Validate();
+}
+
+void ProbeVolume::Close()
+{
+	m_view.Close();
+	m_pData = nullptr;
+	m_size = 0;
+	m_pHeader = nullptr;
+	m_numProbes = 0;
+}
+
+void ProbeVolume::Validate()
+{
+	m_pHeader = nullptr;
+
+	if (m_pData == nullptr || m_size < sizeof(ProbeVolumeHeader))
+	{
+		ThrowInvalidProbeVolume("truncated header");
+	}
+	const ProbeVolumeHeader* pHeader = reinterpret_cast<const ProbeVolumeHeader*>(m_pData);
+	if (pHeader->magic != ProbeVolumeMagic)
+	{
+		ThrowInvalidProbeVolume("bad magic");
+	}
+	if (pHeader->version != ProbeVolumeVersion)
+	{
+		ThrowInvalidProbeVolume("unsupported version");
+	}
+	if (pHeader->fileSize != m_size)
+	{
+		ThrowInvalidProbeVolume("size mismatch, file truncated");
+	}
+	if (pHeader->numCoefficients != SHNumCoefficients)
+	{
+		ThrowInvalidProbeVolume("unsupported SH order");
+	}
+	// Checked after every multiply, the full product of three uint32_t sizes can wrap
+	uint64_t numProbes = 1;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		numProbes *= pHeader->gridSize[axis];
+		if (numProbes == 0 || numProbes > UINT32_MAX)
+		{
+			ThrowInvalidProbeVolume("bad grid size");
+		}
+	}
+	const uint64_t planeStride = GetProbeVolumePlaneStride(numProbes);
+	if (pHeader->planeOffset % ProbeVolumePlaneAlignment != 0 || pHeader->planeOffset > m_size || planeStride * SHNumCoefficients > m_size - pHeader->planeOffset)
+	{
+		ThrowInvalidProbeVolume("planes out of bounds");
+	}
+
+	m_pHeader = pHeader;
+	m_numProbes = uint32_t(numProbes);
+	m_planeStride = planeStride;
+}
+
+SHColor ProbeVolume::GetProbe(size_t index) const
+{
+	SHColor sh;
+	for (uint32_t i = 0; i < SHNumCoefficients; i++)
+	{
+		const Half4& value = GetPlane(i)[index];
+		sh.coefficients[i] = { HalfToFloat(value.x), HalfToFloat(value.y), HalfToFloat(value.z) };
+	}
+	return sh;
+}
+
+SHColor ProbeVolume::SampleSH(const Float3& position) const
+{
+	const ProbeVolumeHeader& header = *m_pHeader;
+	const float point[3] = { position.x, position.y, position.z };
+	const float boundsMin[3] = { header.bounds.min.x, header.bounds.min.y, header.bounds.min.z };
+	const float boundsMax[3] = { header.bounds.max.x, header.bounds.max.y, header.bounds.max.z };
+	uint32_t cell[3];
+	float fraction[3];
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const uint32_t lastProbe = header.gridSize[axis] - 1;
+		const float extent = boundsMax[axis] - boundsMin[axis];
+		const float coordinate = extent > 0.0f ? std::clamp((point[axis] - boundsMin[axis]) / extent, 0.0f, 1.0f) * float(lastProbe) : 0.0f;
+		cell[axis] = std::min(uint32_t(coordinate), lastProbe > 0 ? lastProbe - 1 : 0);
+		fraction[axis] = lastProbe > 0 ? coordinate - float(cell[axis]) : 0.0f;
+	}
+
+	SHColor result = {};
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		float weight = 1.0f;
+		uint32_t probe[3];
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const uint32_t offset = (corner >> axis) & 1;
+			weight *= offset ? fraction[axis] : 1.0f - fraction[axis];
+			probe[axis] = std::min(cell[axis] + offset, header.gridSize[axis] - 1);
+		}
+		if (weight == 0.0f)
+		{
+			continue;
+		}
+		const size_t index = GetProbeIndex(probe[0], probe[1], probe[2]);
+		for (uint32_t i = 0; i < SHNumCoefficients; i++)
+		{
+			const Half4& value = GetPlane(i)[index];
+			result.coefficients[i] = result.coefficients[i] + Float3{ HalfToFloat(value.x), HalfToFloat(value.y), HalfToFloat(value.z) } * weight;
+		}
+	}
+	return result;
+}
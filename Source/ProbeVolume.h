@@ -0,0 +1,71 @@
+#pragma once
+
+// Baked irradiance probe grid (.probes), used in place without a parsing step
+// Layout: ProbeVolumeHeader, then one plane per SH coefficient, each aligned to ProbeVolumePlaneAlignment.
+// A plane holds a Half4 (rgb, w unused) per probe, x fastest then y then z, so it uploads as-is as an RGBA16F 3D
+// texture. Coefficients are irradiance (cosine convolved), diffuse lighting is albedo / pi * irradiance.
+// Files are written by ProbeBaker.h, little endian.
+
+#include "Platform.h"
+#include "EngineMath.h"
+#include "FileView.h"
+#include "SphericalHarmonics.h"
+#include "VertexPacking.h"
+
+enum : uint32_t
+{
+	ProbeVolumeMagic = 0x56425250,	// "PRBV"
+	ProbeVolumeVersion = 1,
+	ProbeVolumePlaneAlignment = 64,
+};
+
+struct ProbeVolumeHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	fileSize;
+	uint32_t	gridSize[3];
+	uint32_t	numCoefficients;	// SHNumCoefficients
+	BoundingBox	bounds;				// The corner probes sit on the box corners
+	uint64_t	planeOffset;		// First plane, from the start of the file
+};
+
+static_assert(sizeof(ProbeVolumeHeader) == 64, "ProbeVolumeHeader is part of the file format");
+
+inline uint64_t GetProbeVolumePlaneStride(uint64_t numProbes)
+{
+	return (numProbes * sizeof(Half4) + ProbeVolumePlaneAlignment - 1) / ProbeVolumePlaneAlignment * ProbeVolumePlaneAlignment;
+}
+
+class ProbeVolume
+{
+public:
+	// Maps the file. Throws FileIOException if it can not be opened, std::runtime_error if it is malformed
+	void Open(const std::wstring& fileName);
+	// Uses `pData` in place, it must stay valid while the ProbeVolume is used
+	void OpenFromMemory(const uint8_t* pData, uint64_t size);
+	void Close();
+
+	bool IsOpen() const { return m_pHeader != nullptr; }
+	const ProbeVolumeHeader& GetHeader() const { return *m_pHeader; }
+	uint32_t GetNumProbes() const { return m_numProbes; }
+	size_t GetProbeIndex(uint32_t x, uint32_t y, uint32_t z) const { return (size_t(z) * m_pHeader->gridSize[1] + y) * m_pHeader->gridSize[0] + x; }
+
+	// Probe per element, pointer into the file
+	const Half4* GetPlane(uint32_t coefficient) const { return reinterpret_cast<const Half4*>(m_pData + m_pHeader->planeOffset + coefficient * m_planeStride); }
+	SHColor GetProbe(size_t index) const;
+
+	// Trilinear blend of the 8 surrounding probes, clamped to the volume
+	SHColor SampleSH(const Float3& position) const;
+	Float3 SampleIrradiance(const Float3& position, const Float3& normal) const { return EvaluateSH(SampleSH(position), normal); }
+
+private:
+	void Validate();
+
+	FileView					m_view;
+	const uint8_t*				m_pData = nullptr;
+	uint64_t					m_size = 0;
+	const ProbeVolumeHeader*	m_pHeader = nullptr;
+	uint32_t					m_numProbes = 0;
+	uint64_t					m_planeStride = 0;
+};
@@ -0,0 +1,566 @@
+#include "Profiler.h"
+#include "FileIO.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+	struct ScopeHistory
+	{
+		const char*				name;
+		uint32_t				depth;
+		uint64_t				frameTicks = 0;		// Frame in progress
+		uint32_t				frameCalls = 0;
+		uint64_t				numSamples = 0;		// Frames the scope ran in, the history keeps the last ones
+		std::vector<uint64_t>	ticks;
+		std::vector<uint32_t>	calls;
+	};
+
+	struct ProfilerState
+	{
+		std::mutex											registryMutex;
+		std::vector<std::unique_ptr<ProfilerThreadBuffer>>	buffers;
+
+		// Consumer side
+		std::mutex											collectMutex;
+		std::vector<ScopeHistory>							scopes;
+		std::unordered_map<const char*, uint32_t>			scopesByPointer;
+		std::unordered_map<std::string, uint32_t>			scopesByName;	// Same name from different translation units
+		uint64_t											frameCount = 0;
+		uint64_t											droppedAtReset = 0;
+		bool												bCapturing = false;
+		ProfilerCapture										capture;
+
+		// Ticks against steady_clock since static initialization
+		std::mutex											clockMutex;
+		std::chrono::steady_clock::time_point				anchorTime = std::chrono::steady_clock::now();
+		uint64_t											anchorTicks = Profiler::GetTicks();
+		double												ticksPerSecond = 0.0;
+	};
+
+	// Never destroyed, threads may still exit after static destruction
+	ProfilerState& GetState()
+	{
+		static ProfilerState* pState = new ProfilerState;
+		return *pState;
+	}
+
+	const ProfilerState& g_initializeState = GetState();
+
+	// Gives the ring back when the thread exits, a later thread reuses it once it is drained
+	struct ThreadSlot
+	{
+		ProfilerThreadBuffer*	pBuffer = nullptr;
+		const char*				name = nullptr;
+
+		~ThreadSlot()
+		{
+			if (pBuffer)
+			{
+				ProfilerState& state = GetState();
+				std::lock_guard lock(state.registryMutex);
+				pBuffer->bOwned = false;
+			}
+		}
+	};
+
+	thread_local ThreadSlot t_threadSlot;
+
+	ProfilerThreadBuffer* RegisterThread()
+	{
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.registryMutex);
+		ProfilerThreadBuffer* pBuffer = nullptr;
+		for (const std::unique_ptr<ProfilerThreadBuffer>& buffer : state.buffers)
+		{
+			if (!buffer->bOwned && buffer->IsEmpty())
+			{
+				pBuffer = buffer.get();
+				break;
+			}
+		}
+		if (!pBuffer)
+		{
+			state.buffers.push_back(std::make_unique<ProfilerThreadBuffer>());
+			pBuffer = state.buffers.back().get();
+			pBuffer->index = uint32_t(state.buffers.size() - 1);
+		}
+		pBuffer->bOwned = true;
+		pBuffer->depth = 0;
+		pBuffer->threadName = t_threadSlot.name ? t_threadSlot.name : "";
+		t_threadSlot.pBuffer = pBuffer;
+		return pBuffer;
+	}
+
+	uint32_t FindScope(ProfilerState& state, const ProfilerEvent& event)
+	{
+		auto it = state.scopesByPointer.find(event.name);
+		if (it != state.scopesByPointer.end())
+		{
+			return it->second;
+		}
+		auto [nameIt, bInserted] = state.scopesByName.emplace(event.name, uint32_t(state.scopes.size()));
+		if (bInserted)
+		{
+			ScopeHistory& scope = state.scopes.emplace_back();
+			scope.name = event.name;
+			scope.depth = event.depth;
+			scope.ticks.resize(ProfilerFrameHistorySize);
+			scope.calls.resize(ProfilerFrameHistorySize);
+		}
+		state.scopesByPointer.emplace(event.name, nameIt->second);
+		return nameIt->second;
+	}
+
+	std::vector<ProfilerThreadBuffer*> GetBuffers(ProfilerState& state)
+	{
+		std::lock_guard lock(state.registryMutex);
+		std::vector<ProfilerThreadBuffer*> buffers(state.buffers.size());
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			buffers[i] = state.buffers[i].get();
+		}
+		return buffers;
+	}
+
+	// Adds every pending event to the frame in progress, collectMutex held
+	void Collect(ProfilerState& state)
+	{
+		for (ProfilerThreadBuffer* pBuffer : GetBuffers(state))
+		{
+			const uint16_t thread = uint16_t(pBuffer->index);
+			pBuffer->Drain([&](const ProfilerEvent& event)
+			{
+				const uint32_t scopeIndex = FindScope(state, event);
+				ScopeHistory& scope = state.scopes[scopeIndex];
+				scope.frameTicks += event.endTicks - event.beginTicks;
+				scope.frameCalls++;
+				if (state.bCapturing)
+				{
+					state.capture.events.push_back({ event.beginTicks, event.endTicks, scopeIndex, thread, uint16_t(event.depth) });
+				}
+			});
+		}
+	}
+
+	uint64_t SumDroppedEvents(ProfilerState& state)
+	{
+		std::lock_guard lock(state.registryMutex);
+		uint64_t dropped = 0;
+		for (const std::unique_ptr<ProfilerThreadBuffer>& buffer : state.buffers)
+		{
+			dropped += buffer->GetDroppedEvents();
+		}
+		return dropped;
+	}
+
+	void AppendJsonString(std::string& json, const std::string& string)
+	{
+		json += '"';
+		for (char c : string)
+		{
+			if (c == '"' || c == '\\')
+			{
+				json += '\\';
+				json += c;
+			}
+			else if (uint8_t(c) < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", uint32_t(uint8_t(c)));
+				json += escaped;
+			}
+			else
+			{
+				json += c;
+			}
+		}
+		json += '"';
+	}
+
+	template <typename T>
+	void AppendBytes(std::vector<uint8_t>& data, const T* pValues, size_t count)
+	{
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pValues);
+		data.insert(data.end(), pBytes, pBytes + count * sizeof(T));
+	}
+
+	void AppendString(std::vector<uint8_t>& data, const std::string& string)
+	{
+		const uint32_t length = uint32_t(string.size());
+		AppendBytes(data, &length, 1);
+		AppendBytes(data, string.data(), string.size());
+	}
+
+	[[noreturn]] void ThrowInvalidCapture(const char* reason)
+	{
+		throw std::runtime_error(std::string("Invalid profiler capture: ") + reason);
+	}
+
+	struct CaptureReader
+	{
+		const std::vector<uint8_t>&	data;
+		size_t						offset = 0;
+
+		const uint8_t* Read(uint64_t size)
+		{
+			if (size > data.size() - offset)
+			{
+				ThrowInvalidCapture("truncated");
+			}
+			const uint8_t* pData = data.data() + offset;
+			offset += size_t(size);
+			return pData;
+		}
+
+		std::string ReadString()
+		{
+			uint32_t length;
+			memcpy(&length, Read(sizeof(length)), sizeof(length));
+			return std::string(reinterpret_cast<const char*>(Read(length)), length);
+		}
+	};
+}
+
+namespace Profiler
+{
+	double GetTicksPerSecond()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.clockMutex);
+		if (state.ticksPerSecond == 0.0)
+		{
+			// A too short interval gives a poor estimate, wait for 10 ms worth of ticks
+			const std::chrono::duration<double> minInterval = std::chrono::milliseconds(10);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - state.anchorTime;
+			if (elapsed < minInterval)
+			{
+				std::this_thread::sleep_for(minInterval - elapsed);
+			}
+			const uint64_t ticks = GetTicks();
+			elapsed = std::chrono::steady_clock::now() - state.anchorTime;
+			const double ticksPerSecond = double(ticks - state.anchorTicks) / elapsed.count();
+			if (elapsed >= std::chrono::seconds(1))
+			{
+				state.ticksPerSecond = ticksPerSecond;
+			}
+			return ticksPerSecond;
+		}
+		return state.ticksPerSecond;
+#else
+		return double(std::chrono::steady_clock::period::den) / double(std::chrono::steady_clock::period::num);
+#endif
+	}
+
+	ProfilerThreadBuffer* GetThreadBuffer()
+	{
+		ProfilerThreadBuffer* pBuffer = t_threadSlot.pBuffer;
+		return pBuffer ? pBuffer : RegisterThread();
+	}
+
+	void SetThreadName(const char* name)
+	{
+		t_threadSlot.name = name;
+		if (t_threadSlot.pBuffer)
+		{
+			ProfilerState& state = GetState();
+			std::lock_guard lock(state.registryMutex);
+			t_threadSlot.pBuffer->threadName = name;
+		}
+	}
+
+	void EndFrame()
+	{
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		Collect(state);
+		for (ScopeHistory& scope : state.scopes)
+		{
+			if (scope.frameCalls == 0)
+			{
+				continue;
+			}
+			const size_t slot = size_t(scope.numSamples % ProfilerFrameHistorySize);
+			scope.ticks[slot] = scope.frameTicks;
+			scope.calls[slot] = scope.frameCalls;
+			scope.numSamples++;
+			scope.frameTicks = 0;
+			scope.frameCalls = 0;
+		}
+		state.frameCount++;
+		if (state.bCapturing)
+		{
+			state.capture.frameEnds.push_back(GetTicks());
+		}
+	}
+
+	void Reset()
+	{
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		for (ProfilerThreadBuffer* pBuffer : GetBuffers(state))
+		{
+			pBuffer->Drain([](const ProfilerEvent&) {});
+		}
+		state.scopes.clear();
+		state.scopesByPointer.clear();
+		state.scopesByName.clear();
+		state.frameCount = 0;
+		state.droppedAtReset = SumDroppedEvents(state);
+		state.bCapturing = false;
+		state.capture = {};
+	}
+
+	uint64_t GetFrameCount()
+	{
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		return state.frameCount;
+	}
+
+	uint64_t GetDroppedEvents()
+	{
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		return SumDroppedEvents(state) - state.droppedAtReset;
+	}
+
+	std::vector<ProfilerScopeStatistics> GetScopeStatistics()
+	{
+		const double secondsPerTick = 1.0 / GetTicksPerSecond();
+
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		std::vector<ProfilerScopeStatistics> statistics;
+		std::vector<uint64_t> sorted;
+		for (const ScopeHistory& scope : state.scopes)
+		{
+			const uint32_t numFrames = uint32_t(std::min<uint64_t>(scope.numSamples, ProfilerFrameHistorySize));
+			if (numFrames == 0)
+			{
+				continue;
+			}
+			sorted.assign(scope.ticks.begin(), scope.ticks.begin() + numFrames);
+			std::sort(sorted.begin(), sorted.end());
+			uint64_t totalTicks = 0;
+			uint64_t totalCalls = 0;
+			for (uint32_t i = 0; i < numFrames; i++)
+			{
+				totalTicks += sorted[i];
+				totalCalls += scope.calls[i];
+			}
+			// Nearest rank
+			const uint32_t p99Rank = uint32_t(std::ceil(0.99 * numFrames));
+
+			ProfilerScopeStatistics& scopeStatistics = statistics.emplace_back();
+			scopeStatistics.name = scope.name;
+			scopeStatistics.depth = scope.depth;
+			scopeStatistics.numFrames = numFrames;
+			scopeStatistics.callsPerFrame = double(totalCalls) / numFrames;
+			scopeStatistics.minSeconds = double(sorted.front()) * secondsPerTick;
+			scopeStatistics.averageSeconds = double(totalTicks) / numFrames * secondsPerTick;
+			scopeStatistics.p99Seconds = double(sorted[p99Rank - 1]) * secondsPerTick;
+			scopeStatistics.maxSeconds = double(sorted.back()) * secondsPerTick;
+		}
+		return statistics;
+	}
+
+	std::string FormatReport()
+	{
+		std::string report;
+		char line[256];
+		snprintf(line, sizeof(line), "%-40s %9s %9s %9s %9s %7s\n", "Scope (ms per frame)", "min", "avg", "p99", "max", "calls");
+		report += line;
+		for (const ProfilerScopeStatistics& scope : GetScopeStatistics())
+		{
+			const std::string name = std::string(std::min<size_t>(scope.depth, 8) * 2, ' ') + scope.name;
+			snprintf(line, sizeof(line), "%-40.40s %9.3f %9.3f %9.3f %9.3f %7.1f\n", name.c_str(), scope.minSeconds * 1e3,
+				scope.averageSeconds * 1e3, scope.p99Seconds * 1e3, scope.maxSeconds * 1e3, scope.callsPerFrame);
+			report += line;
+		}
+		return report;
+	}
+
+	void BeginCapture()
+	{
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		// Events recorded before the capture started are not part of it
+		Collect(state);
+		state.capture = {};
+		state.bCapturing = true;
+	}
+
+	ProfilerCapture EndCapture()
+	{
+		const double ticksPerSecond = GetTicksPerSecond();
+
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		Collect(state);
+		ProfilerCapture capture = std::move(state.capture);
+		state.capture = {};
+		state.bCapturing = false;
+
+		capture.ticksPerSecond = ticksPerSecond;
+		capture.names.reserve(state.scopes.size());
+		for (const ScopeHistory& scope : state.scopes)
+		{
+			capture.names.push_back(scope.name);
+		}
+		{
+			std::lock_guard registryLock(state.registryMutex);
+			for (const std::unique_ptr<ProfilerThreadBuffer>& buffer : state.buffers)
+			{
+				capture.threadNames.push_back(buffer->threadName);
+			}
+		}
+		capture.droppedEvents = SumDroppedEvents(state) - state.droppedAtReset;
+		return capture;
+	}
+
+	bool IsCapturing()
+	{
+		ProfilerState& state = GetState();
+		std::lock_guard lock(state.collectMutex);
+		return state.bCapturing;
+	}
+
+	void WriteChromeTrace(const std::wstring& fileName, const ProfilerCapture& capture)
+	{
+		// Timestamps in microseconds from the earliest event
+		uint64_t baseTicks = ~0ull;
+		for (const ProfilerCaptureEvent& event : capture.events)
+		{
+			baseTicks = std::min(baseTicks, event.beginTicks);
+		}
+		for (uint64_t frameEnd : capture.frameEnds)
+		{
+			baseTicks = std::min(baseTicks, frameEnd);
+		}
+		const double microsecondsPerTick = capture.ticksPerSecond > 0.0 ? 1e6 / capture.ticksPerSecond : 0.0;
+
+		std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		char line[256];
+		bool bFirst = true;
+		auto BeginEntry = [&]()
+		{
+			json += bFirst ? "" : ",\n";
+			bFirst = false;
+		};
+
+		for (size_t thread = 0; thread < capture.threadNames.size(); thread++)
+		{
+			const std::string threadName = capture.threadNames[thread].empty() ? "Thread " + std::to_string(thread) : capture.threadNames[thread];
+			BeginEntry();
+			snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", thread);
+			json += line;
+			AppendJsonString(json, threadName);
+			json += "}}";
+		}
+		for (const ProfilerCaptureEvent& event : capture.events)
+		{
+			BeginEntry();
+			json += "{\"name\":";
+			AppendJsonString(json, event.name < capture.names.size() ? capture.names[event.name] : std::string());
+			snprintf(line, sizeof(line), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", uint32_t(event.thread),
+				double(event.beginTicks - baseTicks) * microsecondsPerTick, double(event.endTicks - event.beginTicks) * microsecondsPerTick);
+			json += line;
+		}
+		for (uint64_t frameEnd : capture.frameEnds)
+		{
+			BeginEntry();
+			snprintf(line, sizeof(line), "{\"name\":\"EndFrame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}",
+				double(frameEnd - baseTicks) * microsecondsPerTick);
+			json += line;
+		}
+		json += "\n]}\n";
+
+		WriteFileAtomically(fileName, json.data(), json.size());
+	}
+
+	void WriteCapture(const std::wstring& fileName, const ProfilerCapture& capture)
+	{
+		ProfilerCaptureFileHeader header = {};
+		header.magic = ProfilerCaptureMagic;
+		header.version = ProfilerCaptureVersion;
+		header.ticksPerSecond = capture.ticksPerSecond;
+		header.numNames = uint32_t(capture.names.size());
+		header.numThreads = uint32_t(capture.threadNames.size());
+		header.numEvents = uint32_t(capture.events.size());
+		header.numFrames = uint32_t(capture.frameEnds.size());
+		header.droppedEvents = capture.droppedEvents;
+
+		std::vector<uint8_t> data;
+		AppendBytes(data, &header, 1);
+		AppendBytes(data, capture.events.data(), capture.events.size());
+		AppendBytes(data, capture.frameEnds.data(), capture.frameEnds.size());
+		for (const std::string& name : capture.names)
+		{
+			AppendString(data, name);
+		}
+		for (const std::string& threadName : capture.threadNames)
+		{
+			AppendString(data, threadName);
+		}
+
+		WriteFileAtomically(fileName, data.data(), data.size());
+	}
+
+	ProfilerCapture ReadCapture(const std::wstring& fileName)
+	{
+		const std::vector<uint8_t> data = ReadWholeFile(fileName);
+		CaptureReader reader{ data };
+
+		ProfilerCaptureFileHeader header;
+		memcpy(&header, reader.Read(sizeof(header)), sizeof(header));
+		if (header.magic != ProfilerCaptureMagic)
+		{
+			ThrowInvalidCapture("bad magic");
+		}
+		if (header.version != ProfilerCaptureVersion)
+		{
+			ThrowInvalidCapture("unsupported version");
+		}
+
+		ProfilerCapture capture;
+		capture.ticksPerSecond = header.ticksPerSecond;
+		capture.droppedEvents = header.droppedEvents;
+		// Bounds checked before sizing anything
+		const uint8_t* pEvents = reader.Read(uint64_t(header.numEvents) * sizeof(ProfilerCaptureEvent));
+		capture.events.resize(header.numEvents);
+		memcpy(capture.events.data(), pEvents, capture.events.size() * sizeof(ProfilerCaptureEvent));
+		const uint8_t* pFrameEnds = reader.Read(uint64_t(header.numFrames) * sizeof(uint64_t));
+		capture.frameEnds.resize(header.numFrames);
+		memcpy(capture.frameEnds.data(), pFrameEnds, capture.frameEnds.size() * sizeof(uint64_t));
+		// Every string takes at least its length, which bounds the counts before reserving
+		if (uint64_t(header.numNames) + header.numThreads > (data.size() - reader.offset) / sizeof(uint32_t))
+		{
+			ThrowInvalidCapture("truncated");
+		}
+		capture.names.reserve(header.numNames);
+		for (uint32_t i = 0; i < header.numNames; i++)
+		{
+			capture.names.push_back(reader.ReadString());
+		}
+		capture.threadNames.reserve(header.numThreads);
+		for (uint32_t i = 0; i < header.numThreads; i++)
+		{
+			capture.threadNames.push_back(reader.ReadString());
+		}
+		for (const ProfilerCaptureEvent& event : capture.events)
+		{
+			if (event.name >= header.numNames || event.thread >= header.numThreads || event.endTicks < event.beginTicks)
+			{
+				ThrowInvalidCapture("bad event");
+			}
+		}
+		return capture;
+	}
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+// Hierarchical CPU profiler
+// PROFILE_SCOPE(name) records begin and end ticks into a ring owned by the calling thread, a single producer
+// single consumer queue without locks or allocations. Profiler::EndFrame() drains every ring on the calling thread
+// and adds the inclusive time of each scope to a per-frame history, for min/avg/p99 over the last frames.
+// Between BeginCapture() and EndCapture() the drained events are also kept, for Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev) and a compact binary capture.
+// Building with ENABLE_PROFILER=0 turns the markers into nothing.
+
+#include "Platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#ifndef ENABLE_PROFILER
+	#define ENABLE_PROFILER 1
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#endif
+
+enum : uint32_t
+{
+	ProfilerRingCapacity = 8192,		// Events per thread between two drains, power of two
+	ProfilerFrameHistorySize = 256,		// Frames kept per scope for statistics
+	ProfilerCaptureMagic = 0x464f5250,	// "PROF"
+	ProfilerCaptureVersion = 1,
+};
+
+struct ProfilerEvent
+{
+	const char*	name;		// Must stay valid while the process runs, string literals
+	uint64_t	beginTicks;
+	uint64_t	endTicks;
+	uint32_t	depth;		// Nesting level on the recording thread
+	uint32_t	reserved;
+};
+
+// Lock free ring, written only by its thread and read only by the thread calling Profiler::EndFrame()
+class ProfilerThreadBuffer
+{
+public:
+	void Push(const ProfilerEvent& event)
+	{
+		const uint32_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) == ProfilerRingCapacity)
+		{
+			// Nobody drains, losing events is better than stalling the frame
+			m_droppedEvents.store(m_droppedEvents.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+		m_events[head & (ProfilerRingCapacity - 1)] = event;
+		m_head.store(head + 1, std::memory_order_release);
+	}
+
+	// Consumer side, visitor is called with (const ProfilerEvent&)
+	template <typename Visitor>
+	void Drain(Visitor&& visitor)
+	{
+		const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		const uint32_t head = m_head.load(std::memory_order_acquire);
+		for (uint32_t i = tail; i != head; i++)
+		{
+			visitor(m_events[i & (ProfilerRingCapacity - 1)]);
+		}
+		m_tail.store(head, std::memory_order_release);
+	}
+
+	bool IsEmpty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+	uint64_t GetDroppedEvents() const { return m_droppedEvents.load(std::memory_order_relaxed); }
+
+	uint32_t	depth = 0;		// Owner thread only
+	uint32_t	index = 0;		// In the registry, doubles as thread id of captures
+	std::string	threadName;		// Guarded by the registry
+	bool		bOwned = true;	// Guarded by the registry, released when the thread exits
+
+private:
+	// Separate cache lines, the producer and the consumer each write one of them
+	alignas(64) std::atomic<uint32_t>	m_head = 0;
+	alignas(64) std::atomic<uint32_t>	m_tail = 0;
+	std::atomic<uint64_t>				m_droppedEvents = 0;
+	ProfilerEvent						m_events[ProfilerRingCapacity];
+};
+
+struct ProfilerScopeStatistics
+{
+	const char*	name;
+	uint32_t	depth;				// Nesting level the scope was first seen at
+	uint32_t	numFrames;			// Frames the scope ran in, within the history
+	double		callsPerFrame;		// Averaged over those frames
+	double		minSeconds;			// Inclusive time per frame, all calls and threads summed
+	double		averageSeconds;
+	double		p99Seconds;
+	double		maxSeconds;
+};
+
+struct ProfilerCaptureEvent
+{
+	uint64_t	beginTicks;
+	uint64_t	endTicks;
+	uint32_t	name;		// Into ProfilerCapture::names
+	uint16_t	thread;		// Into ProfilerCapture::threadNames
+	uint16_t	depth;
+};
+
+static_assert(sizeof(ProfilerCaptureEvent) == 24, "ProfilerCaptureEvent is part of the file format");
+
+struct ProfilerCapture
+{
+	double						ticksPerSecond = 0.0;
+	std::vector<std::string>	names;
+	std::vector<std::string>	threadNames;	// Empty for threads that never named themselves
+	std::vector<ProfilerCaptureEvent>	events;	// In drain order, the events of a thread are ordered by end
+	std::vector<uint64_t>		frameEnds;		// Ticks of each EndFrame() during the capture
+	uint64_t					droppedEvents = 0;
+};
+
+// Binary capture (.profile), little endian: header, events, frame ends, then names and thread names,
+// each a uint32_t length followed by the characters
+struct ProfilerCaptureFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	double		ticksPerSecond;
+	uint32_t	numNames;
+	uint32_t	numThreads;
+	uint32_t	numEvents;
+	uint32_t	numFrames;
+	uint64_t	droppedEvents;
+};
+
+static_assert(sizeof(ProfilerCaptureFileHeader) == 40, "ProfilerCaptureFileHeader is part of the file format");
+
+namespace Profiler
+{
+	// Invariant TSC where available, it costs a few cycles where steady_clock costs a system call on some platforms
+	inline uint64_t GetTicks()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return __rdtsc();
+#else
+		return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+	// Measured against steady_clock, the estimate improves during the first second
+	double GetTicksPerSecond();
+
+	// Ring of the calling thread, registered on first use
+	ProfilerThreadBuffer* GetThreadBuffer();
+	// Shown in captures, `name` must stay valid while the thread runs. Costs nothing until the thread records
+	void SetThreadName(const char* name);
+
+	// Drains every thread and closes the frame. Call from one thread, once per frame
+	void EndFrame();
+	// Drops the history and any pending event, e.g. before measuring something specific
+	void Reset();
+
+	uint64_t GetFrameCount();
+	// Events lost to full rings since Reset()
+	uint64_t GetDroppedEvents();
+	// Scopes in order of first appearance
+	std::vector<ProfilerScopeStatistics> GetScopeStatistics();
+	// Table of GetScopeStatistics(), in milliseconds, nested scopes indented
+	std::string FormatReport();
+
+	// Keeps every event drained until EndCapture(), which drains once more
+	void BeginCapture();
+	ProfilerCapture EndCapture();
+	bool IsCapturing();
+
+	// Temporary then rename, readers never see a partial file. Throw FileIOException
+	void WriteChromeTrace(const std::wstring& fileName, const ProfilerCapture& capture);
+	void WriteCapture(const std::wstring& fileName, const ProfilerCapture& capture);
+	// Throws FileIOException if the file can not be read, std::runtime_error if it is malformed
+	ProfilerCapture ReadCapture(const std::wstring& fileName);
+}
+
+#if ENABLE_PROFILER
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+		: m_pBuffer(Profiler::GetThreadBuffer())
+		, m_name(name)
+		, m_depth(m_pBuffer->depth++)
+		, m_beginTicks(Profiler::GetTicks())
+	{
+	}
+
+	~ProfileScope()
+	{
+		const uint64_t endTicks = Profiler::GetTicks();
+		m_pBuffer->depth--;
+		m_pBuffer->Push({ m_name, m_beginTicks, endTicks, m_depth, 0 });
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	ProfilerThreadBuffer*	m_pBuffer;
+	const char*				m_name;
+	uint32_t				m_depth;
+	uint64_t				m_beginTicks;
+};
+
+#define PROFILE_CONCAT_INNER(a, b)		a##b
+#define PROFILE_CONCAT(a, b)			PROFILE_CONCAT_INNER(a, b)
+
+// Until the end of the enclosing block
+#define PROFILE_SCOPE(name)			ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD(name)		Profiler::SetThreadName(name)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_THREAD(name)
+
+#endif
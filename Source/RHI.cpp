@@ -0,0 +1,39 @@
+#include "RHI.h"
+#include "NullRHI.h"
+
+#if defined(_WIN32)
+	#include "D3D12RHI.h"
+#endif
+
+bool IsRHIBackendSupported(RHIBackend backend)
+{
+	switch (backend)
+	{
+#if defined(_WIN32)
+	case RHIBackend::D3D12:	return true;
+#endif
+	case RHIBackend::Null:	return true;
+	default:				return false;
+	}
+}
+
+RHIBackend GetDefaultRHIBackend()
+{
+#if defined(_WIN32)
+	return RHIBackend::D3D12;
+#else
+	return RHIBackend::Null;
+#endif
+}
+
+std::unique_ptr<RHIDevice> CreateRHIDevice(RHIBackend backend)
+{
+	check(!IsRHIBackendSupported(backend));
+	switch (backend)
+	{
+#if defined(_WIN32)
+	case RHIBackend::D3D12:	return std::make_unique<D3D12RHIDevice>();
+#endif
+	default:				return std::make_unique<NullRHIDevice>();
+	}
+}
@@ -0,0 +1,371 @@
+#pragma once
+
+// Rendering hardware interface
+// Engine only talks to types declared here, each backend (D3D12, Null) implements them.
+// Kept close to D3D12 semantics so the D3D12 backend stays a thin wrapper.
+
+#include "Platform.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class RHIBackend : uint8_t
+{
+	D3D12,
+	Null,		// Headless, records command streams in host memory and simulates queue/fence
+};
+
+enum class RHIFormat : uint8_t
+{
+	Unknown,
+	R8G8B8A8_UNORM,
+	R16G16B16A16_FLOAT,
+	R32_FLOAT,
+	R32G32_FLOAT,
+	R32G32B32_FLOAT,
+	R32G32B32A32_FLOAT,
+	D32_FLOAT,
+	// Packed vertex attributes, see VertexPacking.h
+	R16G16_FLOAT,
+	R16G16_SNORM,
+};
+
+constexpr uint32_t GetFormatSize(RHIFormat format)
+{
+	switch (format)
+	{
+	case RHIFormat::R8G8B8A8_UNORM:		return 4;
+	case RHIFormat::R16G16B16A16_FLOAT:	return 8;
+	case RHIFormat::R32_FLOAT:			return 4;
+	case RHIFormat::R32G32_FLOAT:		return 8;
+	case RHIFormat::R32G32B32_FLOAT:	return 12;
+	case RHIFormat::R32G32B32A32_FLOAT:	return 16;
+	case RHIFormat::D32_FLOAT:			return 4;
+	case RHIFormat::R16G16_FLOAT:		return 4;
+	case RHIFormat::R16G16_SNORM:		return 4;
+	default:							return 0;
+	}
+}
+
+enum class RHIResourceState : uint32_t
+{
+	Common,
+	Present,
+	RenderTarget,
+	GenericRead,
+	VertexAndConstantBuffer,
+	IndexBuffer,
+	ShaderResource,
+	UnorderedAccess,
+	DepthWrite,
+	CopyDest,
+	CopySource,
+};
+
+enum class RHIHeapType : uint8_t
+{
+	Default,
+	Upload,
+	Readback,
+};
+
+enum class RHIResourceDimension : uint8_t
+{
+	Buffer,
+	Texture2D,
+};
+
+enum class RHIPrimitiveTopology : uint8_t
+{
+	TriangleList,
+};
+
+// Resampling of RHICommandList::UpscaleTexture()
+enum class RHIUpscaleFilter : uint8_t
+{
+	Bilinear,
+	CatmullRom,		// Bicubic, sharper, the negative lobes are clamped to the representable range
+};
+
+struct RHIViewport
+{
+	float topLeftX;
+	float topLeftY;
+	float width;
+	float height;
+	float minDepth;
+	float maxDepth;
+};
+
+struct RHIRect
+{
+	int32_t left;
+	int32_t top;
+	int32_t right;
+	int32_t bottom;
+};
+
+struct RHIResourceDesc
+{
+	RHIResourceDimension	dimension = RHIResourceDimension::Buffer;
+	RHIHeapType				heapType = RHIHeapType::Default;
+	uint64_t				width = 0;		// Size in bytes for buffers
+	uint32_t				height = 1;
+	RHIFormat				format = RHIFormat::Unknown;
+	RHIResourceState		initialState = RHIResourceState::Common;
+	bool					bRenderTarget = false;
+
+	static RHIResourceDesc Buffer(uint64_t size, RHIHeapType heapType = RHIHeapType::Upload)
+	{
+		RHIResourceDesc desc;
+		desc.dimension = RHIResourceDimension::Buffer;
+		desc.heapType = heapType;
+		desc.width = size;
+		// Upload heap resources must stay in generic read state
+		desc.initialState = heapType == RHIHeapType::Upload ? RHIResourceState::GenericRead : RHIResourceState::Common;
+		return desc;
+	}
+
+	static RHIResourceDesc Texture2D(uint32_t width, uint32_t height, RHIFormat format, bool bRenderTarget = false)
+	{
+		RHIResourceDesc desc;
+		desc.dimension = RHIResourceDimension::Texture2D;
+		desc.heapType = RHIHeapType::Default;
+		desc.width = width;
+		desc.height = height;
+		desc.format = format;
+		desc.bRenderTarget = bRenderTarget;
+		desc.initialState = bRenderTarget ? RHIResourceState::RenderTarget : RHIResourceState::Common;
+		return desc;
+	}
+};
+
+class RHIResource
+{
+public:
+	explicit RHIResource(const RHIResourceDesc& desc) : m_desc(desc) {}
+	virtual ~RHIResource() {}
+
+	// Only valid for upload and readback heaps
+	virtual void* Map() = 0;
+	virtual void Unmap() = 0;
+	virtual uint64_t GetGpuVirtualAddress() const = 0;
+
+	const RHIResourceDesc& GetDesc() const { return m_desc; }
+
+protected:
+	RHIResourceDesc m_desc;
+};
+
+// Memory placed resources are sub-allocated from, resources placed at overlapping ranges alias each other
+class RHIHeap
+{
+public:
+	explicit RHIHeap(uint64_t size) : m_size(size) {}
+	virtual ~RHIHeap() {}
+
+	uint64_t GetSize() const { return m_size; }
+
+protected:
+	uint64_t m_size;
+};
+
+struct RHIResourceAllocationInfo
+{
+	uint64_t	size;
+	uint64_t	alignment;
+};
+
+struct RHIVertexBufferView
+{
+	uint64_t bufferLocation;
+	uint32_t sizeInBytes;
+	uint32_t strideInBytes;
+};
+
+enum class RHIBarrierType : uint8_t
+{
+	Transition,
+	Aliasing,			// `pResource` starts using heap memory last used by `pResourceBefore`, null for any
+	UnorderedAccess,	// Unordered accesses to `pResource` finish before the next ones start
+};
+
+struct RHIResourceBarrier
+{
+	RHIBarrierType		type;
+	RHIResource*		pResource;
+	RHIResource*		pResourceBefore;
+	RHIResourceState	stateBefore;
+	RHIResourceState	stateAfter;
+
+	static RHIResourceBarrier Transition(RHIResource* pResource, RHIResourceState stateBefore, RHIResourceState stateAfter)
+	{
+		return { RHIBarrierType::Transition, pResource, nullptr, stateBefore, stateAfter };
+	}
+
+	// `pResourceAfter` must be discarded, cleared or copied to before anything else uses it, see DiscardResource()
+	static RHIResourceBarrier Aliasing(RHIResource* pResourceBefore, RHIResource* pResourceAfter)
+	{
+		return { RHIBarrierType::Aliasing, pResourceAfter, pResourceBefore, RHIResourceState::Common, RHIResourceState::Common };
+	}
+
+	// Between accesses in UnorderedAccess state when either one writes, the state does not change
+	static RHIResourceBarrier UnorderedAccess(RHIResource* pResource)
+	{
+		return { RHIBarrierType::UnorderedAccess, pResource, nullptr, RHIResourceState::Common, RHIResourceState::Common };
+	}
+};
+
+// Offset placed right after the previous element of the same slot, resolved by CanonicalizePipelineDesc()
+constexpr uint32_t RHIAppendAlignedElement = 0xffffffff;
+
+struct RHIInputElementDesc
+{
+	const char*	semanticName;
+	uint32_t	semanticIndex;
+	RHIFormat	format;
+	uint32_t	inputSlot;
+	uint32_t	alignedByteOffset;
+};
+
+struct RHIShaderDesc
+{
+	std::wstring	fileName;
+	std::string		entryPoint;
+	std::string		target;
+};
+
+struct RHIGraphicsPipelineDesc
+{
+	RHIShaderDesc						vertexShader;
+	RHIShaderDesc						pixelShader;
+	std::vector<RHIInputElementDesc>	inputLayout;
+	RHIPrimitiveTopology				topology = RHIPrimitiveTopology::TriangleList;
+	RHIFormat							renderTargetFormat = RHIFormat::R8G8B8A8_UNORM;
+	bool								bDepthEnable = false;
+};
+
+class RHIPipelineState
+{
+public:
+	explicit RHIPipelineState(const RHIGraphicsPipelineDesc& desc) : m_desc(desc) {}
+	virtual ~RHIPipelineState() {}
+
+	const RHIGraphicsPipelineDesc& GetDesc() const { return m_desc; }
+	// Driver specific compiled form, fed back to CreateGraphicsPipelineState() on the next launch
+	virtual bool GetCachedBlob(std::vector<uint8_t>&) const { return false; }
+
+protected:
+	RHIGraphicsPipelineDesc m_desc;
+};
+
+class RHIFence
+{
+public:
+	virtual ~RHIFence() {}
+
+	virtual uint64_t GetCompletedValue() const = 0;
+	// Block calling thread until fence reaches `value`
+	virtual void Wait(uint64_t value) = 0;
+};
+
+// Owns the memory command lists are recorded into.
+// Can be reset only if associated command lists have finished excution
+class RHICommandAllocator
+{
+public:
+	virtual ~RHICommandAllocator() {}
+
+	virtual void Reset() = 0;
+};
+
+class RHICommandList
+{
+public:
+	virtual ~RHICommandList() {}
+
+	// Reset command list before re-recording, after ExecuteCommandLists is called
+	virtual void Begin(RHICommandAllocator* pAllocator, RHIPipelineState* pInitialState = nullptr) = 0;
+	virtual void Close() = 0;
+
+	virtual void SetPipelineState(RHIPipelineState* pPipelineState) = 0;
+	virtual void SetViewport(const RHIViewport& viewport) = 0;
+	virtual void SetScissorRect(const RHIRect& rect) = 0;
+	virtual void ResourceBarrier(uint32_t numBarriers, const RHIResourceBarrier* pBarriers) = 0;
+	virtual void SetRenderTarget(RHIResource* pRenderTarget) = 0;
+	virtual void ClearRenderTarget(RHIResource* pRenderTarget, const float color[4]) = 0;
+	// Contents become undefined. Initializes placed resources after their aliasing barrier or creation, render
+	// targets must be in RenderTarget state
+	virtual void DiscardResource(RHIResource* pResource) = 0;
+	virtual void SetPrimitiveTopology(RHIPrimitiveTopology topology) = 0;
+	virtual void SetVertexBuffer(uint32_t slot, const RHIVertexBufferView& view) = 0;
+	virtual void DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance) = 0;
+	// Resamples `sourceRect` of pSource, in ShaderResource state, to cover `destRect` of pDest, in RenderTarget state.
+	// Texels outside of `sourceRect` are never read. Changes the bound pipeline, viewport, scissor and render target
+	virtual void UpscaleTexture(RHIResource* pDest, const RHIRect& destRect, RHIResource* pSource, const RHIRect& sourceRect, RHIUpscaleFilter filter) = 0;
+};
+
+class RHICommandQueue
+{
+public:
+	virtual ~RHICommandQueue() {}
+
+	virtual void ExecuteCommandLists(uint32_t numCommandLists, RHICommandList* const* ppCommandLists) = 0;
+	// After commands in the queue before `Signal` are finished, fence will be set to `value`
+	virtual void Signal(RHIFence* pFence, uint64_t value) = 0;
+};
+
+// Combined into the `flags` of RHISwapChain::Present()
+enum RHIPresentFlags : uint32_t
+{
+	RHIPresentFlagNone = 0,
+	RHIPresentFlagAllowTearing = 1 << 0,	// Sync interval 0 only, and only where IsTearingSupported()
+};
+
+class RHISwapChain
+{
+public:
+	virtual ~RHISwapChain() {}
+
+	virtual uint32_t GetBufferCount() const = 0;
+	virtual RHIResource* GetBackBuffer(uint32_t index) = 0;
+	virtual uint32_t GetCurrentBackBufferIndex() const = 0;
+	virtual void Present(uint32_t syncInterval, uint32_t flags) = 0;
+	// The GPU must be done with the back buffers, GetBackBuffer() returns new resources afterwards
+	virtual void Resize(uint32_t width, uint32_t height) = 0;
+
+	// Variable refresh displays show unsynchronized presents immediately instead of at the next vblank
+	virtual bool IsTearingSupported() const = 0;
+	// Frames queued for display before WaitForFrameLatency() blocks
+	virtual void SetMaximumFrameLatency(uint32_t maxLatency) = 0;
+	// Blocks until the display queue has room for another frame, call before sampling input
+	virtual void WaitForFrameLatency() = 0;
+};
+
+class RHIDevice
+{
+public:
+	virtual ~RHIDevice() {}
+
+	virtual RHIBackend GetBackend() const = 0;
+	virtual RHICommandQueue* GetGraphicsQueue() = 0;
+
+	// `nativeWindow` is a HWND on Windows, ignored by headless backends
+	virtual std::unique_ptr<RHISwapChain> CreateSwapChain(void* nativeWindow, uint32_t bufferCount, uint32_t width, uint32_t height, RHIFormat format) = 0;
+	virtual std::unique_ptr<RHIResource> CreateResource(const RHIResourceDesc& desc) = 0;
+	// Default heap for render target textures. Placed resources must not outlive their heap
+	virtual std::unique_ptr<RHIHeap> CreateHeap(uint64_t size) = 0;
+	virtual std::unique_ptr<RHIResource> CreatePlacedResource(RHIHeap* pHeap, uint64_t offset, const RHIResourceDesc& desc) = 0;
+	virtual RHIResourceAllocationInfo GetResourceAllocationInfo(const RHIResourceDesc& desc) = 0;
+	// Thread safe. `pCachedBlob` comes from RHIPipelineState::GetCachedBlob(), stale blobs are ignored
+	virtual std::unique_ptr<RHIPipelineState> CreateGraphicsPipelineState(const RHIGraphicsPipelineDesc& desc, const std::vector<uint8_t>* pCachedBlob = nullptr) = 0;
+	virtual std::unique_ptr<RHIFence> CreateFence(uint64_t initialValue) = 0;
+	virtual std::unique_ptr<RHICommandAllocator> CreateCommandAllocator() = 0;
+	virtual std::unique_ptr<RHICommandList> CreateCommandList() = 0;
+};
+
+bool IsRHIBackendSupported(RHIBackend backend);
+RHIBackend GetDefaultRHIBackend();
+std::unique_ptr<RHIDevice> CreateRHIDevice(RHIBackend backend);
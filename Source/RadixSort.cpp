@@ -0,0 +1,84 @@
+#include "RadixSort.h"
+
+namespace
+{
+	enum : uint32_t
+	{
+		DigitBits = 8,
+		NumDigits = 1 << DigitBits,
+	};
+}
+
+void RadixSortPairs(JobSystem* pJobSystem, std::vector<uint32_t>& keys, std::vector<uint32_t>& values, uint32_t numKeyBits)
+{
+	check(keys.size() != values.size());
+	const uint32_t count = uint32_t(keys.size());
+	if (count <= 1)
+	{
+		return;
+	}
+
+	const uint32_t numChunks = (count + RadixSortChunkSize - 1) / RadixSortChunkSize;
+	std::vector<uint32_t> offsets(size_t(numChunks) * NumDigits);	// [chunk][digit]
+	std::vector<uint32_t> scratchKeys(count);
+	std::vector<uint32_t> scratchValues(count);
+	for (uint32_t shift = 0; shift < std::min(numKeyBits, 32u); shift += DigitBits)
+	{
+		auto countDigits = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t chunk = begin; chunk < end; chunk++)
+			{
+				uint32_t* pCounts = &offsets[size_t(chunk) * NumDigits];
+				std::fill(pCounts, pCounts + NumDigits, 0u);
+				const uint32_t chunkEnd = std::min(count, (chunk + 1) * RadixSortChunkSize);
+				for (uint32_t i = chunk * RadixSortChunkSize; i < chunkEnd; i++)
+				{
+					pCounts[(keys[i] >> shift) & (NumDigits - 1)]++;
+				}
+			}
+		};
+		JobCounter countCounter;
+		pJobSystem->ParallelFor(numChunks, 1, countDigits, &countCounter);
+		pJobSystem->Wait(&countCounter);
+
+		// Exclusive prefix sum, digit major so each chunk writes after the same digit of the chunks before it
+		uint32_t sum = 0;
+		bool bSingleDigit = false;
+		for (uint32_t digit = 0; digit < NumDigits; digit++)
+		{
+			const uint32_t digitStart = sum;
+			for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+			{
+				uint32_t& offset = offsets[size_t(chunk) * NumDigits + digit];
+				const uint32_t chunkCount = offset;
+				offset = sum;
+				sum += chunkCount;
+			}
+			bSingleDigit |= sum - digitStart == count;
+		}
+		if (bSingleDigit)
+		{
+			continue;
+		}
+
+		auto scatter = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t chunk = begin; chunk < end; chunk++)
+			{
+				uint32_t* pOffsets = &offsets[size_t(chunk) * NumDigits];
+				const uint32_t chunkEnd = std::min(count, (chunk + 1) * RadixSortChunkSize);
+				for (uint32_t i = chunk * RadixSortChunkSize; i < chunkEnd; i++)
+				{
+					const uint32_t destination = pOffsets[(keys[i] >> shift) & (NumDigits - 1)]++;
+					scratchKeys[destination] = keys[i];
+					scratchValues[destination] = values[i];
+				}
+			}
+		};
+		JobCounter scatterCounter;
+		pJobSystem->ParallelFor(numChunks, 1, scatter, &scatterCounter);
+		pJobSystem->Wait(&scatterCounter);
+		keys.swap(scratchKeys);
+		values.swap(scratchValues);
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Parallel least significant digit radix sort of 32 bit keys with 32 bit values, 8 bits per pass
+// Every pass counts the digits of fixed size chunks in parallel, turns the counts into per chunk offsets and
+// scatters the chunks in parallel. Chunks keep their order, so the sort is stable. Passes where all keys share
+// the digit are skipped.
+
+#include "JobSystem.h"
+
+#include <vector>
+
+enum : uint32_t
+{
+	RadixSortChunkSize = 16384,
+};
+
+// Sorts by the low `numKeyBits` bits of the keys, `values` are moved along. Both must have the same size
+void RadixSortPairs(JobSystem* pJobSystem, std::vector<uint32_t>& keys, std::vector<uint32_t>& values, uint32_t numKeyBits = 32);
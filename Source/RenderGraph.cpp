@@ -0,0 +1,404 @@
+#include "RenderGraph.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+RenderGraph::RenderGraph(RHIDevice* pDevice)
+	: m_pDevice(pDevice)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+}
+
+void RenderGraph::Reset()
+{
+	m_passes.clear();
+	m_accesses.clear();
+	m_textures.clear();
+	m_compiledPasses.clear();
+	m_barriers.clear();
+	m_discards.clear();
+	m_statistics = {};
+	m_frame++;
+	ReleaseRetiredResources();
+}
+
+RenderGraphTexture RenderGraph::CreateTexture(const char* name, uint32_t width, uint32_t height, RHIFormat format)
+{
+	check(width == 0 || height == 0 || GetFormatSize(format) == 0);
+	Texture& texture = m_textures.emplace_back();
+	texture.name = name;
+	texture.desc = RHIResourceDesc::Texture2D(width, height, format, true);
+	return { uint32_t(m_textures.size() - 1) };
+}
+
+RenderGraphTexture RenderGraph::ImportTexture(const char* name, RHIResource* pResource, RHIResourceState state, RHIResourceState finalState)
+{
+	check(pResource == nullptr);
+	Texture& texture = m_textures.emplace_back();
+	texture.name = name;
+	texture.desc = pResource->GetDesc();
+	texture.pResource = pResource;
+	texture.state = state;
+	texture.finalState = finalState;
+	texture.bImported = true;
+	return { uint32_t(m_textures.size() - 1) };
+}
+
+uint32_t RenderGraph::AddPass(const char* name, RenderGraphExecuteFunction execute)
+{
+	Pass& pass = m_passes.emplace_back();
+	pass.name = name;
+	pass.execute = std::move(execute);
+	return uint32_t(m_passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t pass, RenderGraphTexture texture, RHIResourceState state)
+{
+	check(pass >= m_passes.size() || texture.index >= m_textures.size());
+	m_accesses.push_back({ pass, texture.index, state, false, ~0u });
+}
+
+void RenderGraph::Write(uint32_t pass, RenderGraphTexture texture, RHIResourceState state)
+{
+	check(pass >= m_passes.size() || texture.index >= m_textures.size());
+	m_accesses.push_back({ pass, texture.index, state, true, ~0u });
+}
+
+void RenderGraph::SetSideEffects(uint32_t pass)
+{
+	check(pass >= m_passes.size());
+	m_passes[pass].bSideEffects = true;
+}
+
+void RenderGraph::Compile()
+{
+	PROFILE_SCOPE("RenderGraph::Compile");
+	// Accesses are usually declared pass by pass already
+	auto byPass = [](const Access& a, const Access& b) { return a.pass < b.pass; };
+	if (!std::is_sorted(m_accesses.begin(), m_accesses.end(), byPass))
+	{
+		std::stable_sort(m_accesses.begin(), m_accesses.end(), byPass);
+	}
+	uint32_t access = 0;
+	for (uint32_t pass = 0; pass < m_passes.size(); pass++)
+	{
+		m_passes[pass].firstAccess = access;
+		while (access < m_accesses.size() && m_accesses[access].pass == pass)
+		{
+			access++;
+		}
+	}
+
+	CullPasses();
+	PlaceTransientTextures();
+	AllocateTransientTextures();
+	BuildBarriers();
+}
+
+void RenderGraph::CullPasses()
+{
+	const uint32_t numPasses = uint32_t(m_passes.size());
+	auto accessEnd = [&](uint32_t pass) { return pass + 1 < numPasses ? m_passes[pass + 1].firstAccess : uint32_t(m_accesses.size()); };
+
+	// Producer of every access, a texture has one state per pass
+	m_lastWriters.assign(m_textures.size(), ~0u);
+	for (uint32_t pass = 0; pass < numPasses; pass++)
+	{
+		Pass& source = m_passes[pass];
+		source.bAlive = source.bSideEffects;
+		for (uint32_t i = source.firstAccess; i < accessEnd(pass); i++)
+		{
+			Access& current = m_accesses[i];
+			current.producer = m_lastWriters[current.texture];
+			source.bAlive |= current.bWrite && m_textures[current.texture].bImported;
+			for (uint32_t j = source.firstAccess; j < i; j++)
+			{
+				check(m_accesses[j].texture == current.texture && (m_accesses[j].state != current.state || m_accesses[j].bWrite != current.bWrite));
+			}
+		}
+		for (uint32_t i = source.firstAccess; i < accessEnd(pass); i++)
+		{
+			if (m_accesses[i].bWrite)
+			{
+				m_lastWriters[m_accesses[i].texture] = pass;
+			}
+		}
+	}
+
+	// Producers only come before their consumers, one backward sweep finds everything live passes depend on
+	for (uint32_t pass = numPasses; pass-- > 0;)
+	{
+		if (m_passes[pass].bAlive)
+		{
+			for (uint32_t i = m_passes[pass].firstAccess; i < accessEnd(pass); i++)
+			{
+				if (m_accesses[i].producer != ~0u)
+				{
+					m_passes[m_accesses[i].producer].bAlive = true;
+				}
+			}
+		}
+	}
+
+	for (uint32_t pass = 0; pass < numPasses; pass++)
+	{
+		Pass& source = m_passes[pass];
+		if (!source.bAlive)
+		{
+			continue;
+		}
+		source.compiledIndex = uint32_t(m_compiledPasses.size());
+		m_compiledPasses.push_back({ pass, 0, 0, 0, 0, 0, 0 });
+		for (uint32_t i = source.firstAccess; i < accessEnd(pass); i++)
+		{
+			Texture& texture = m_textures[m_accesses[i].texture];
+			texture.firstUse = std::min(texture.firstUse, source.compiledIndex);
+			texture.lastUse = source.compiledIndex;
+		}
+	}
+	m_statistics.numPasses = numPasses;
+	m_statistics.numCulledPasses = numPasses - uint32_t(m_compiledPasses.size());
+}
+
+void RenderGraph::PlaceTransientTextures()
+{
+	m_placementOrder.clear();
+	for (uint32_t i = 0; i < m_textures.size(); i++)
+	{
+		Texture& texture = m_textures[i];
+		if (!texture.bImported && texture.firstUse != ~0u)
+		{
+			const RHIResourceAllocationInfo info = m_pDevice->GetResourceAllocationInfo(texture.desc);
+			texture.size = info.size;
+			texture.alignment = std::max<uint64_t>(info.alignment, 1);
+			m_statistics.transientBytes += texture.size;
+			m_placementOrder.push_back(i);
+		}
+	}
+	m_statistics.numTransientTextures = uint32_t(m_placementOrder.size());
+
+	// Largest first, each one at the lowest offset clear of every placed texture alive at the same time
+	std::sort(m_placementOrder.begin(), m_placementOrder.end(), [&](uint32_t a, uint32_t b)
+	{
+		return m_textures[a].size != m_textures[b].size ? m_textures[a].size > m_textures[b].size : m_textures[a].firstUse < m_textures[b].firstUse;
+	});
+	uint64_t heapBytes = 0;
+	for (uint32_t i = 0; i < m_placementOrder.size(); i++)
+	{
+		Texture& texture = m_textures[m_placementOrder[i]];
+		texture.offset = 0;
+		for (bool bMoved = true; bMoved;)
+		{
+			bMoved = false;
+			for (uint32_t j = 0; j < i; j++)
+			{
+				const Texture& placed = m_textures[m_placementOrder[j]];
+				const bool bLifetimesOverlap = placed.firstUse <= texture.lastUse && texture.firstUse <= placed.lastUse;
+				const bool bMemoryOverlaps = placed.offset < texture.offset + texture.size && texture.offset < placed.offset + placed.size;
+				if (bLifetimesOverlap && bMemoryOverlaps)
+				{
+					texture.offset = AlignUp(placed.offset + placed.size, texture.alignment);
+					bMoved = true;
+				}
+			}
+		}
+		heapBytes = std::max(heapBytes, texture.offset + texture.size);
+	}
+	m_statistics.heapBytes = heapBytes;
+}
+
+void RenderGraph::AllocateTransientTextures()
+{
+	if (m_statistics.heapBytes > GetHeapSize())
+	{
+		// Frames in flight may still use the old heap
+		if (m_heap.heap)
+		{
+			m_heap.retiredFrame = m_frame;
+			m_retiredHeaps.push_back(std::move(m_heap));
+			m_heap = {};
+		}
+		m_heap.heap = m_pDevice->CreateHeap(m_statistics.heapBytes);
+	}
+
+	for (uint32_t index : m_placementOrder)
+	{
+		Texture& texture = m_textures[index];
+		texture.placedTexture = AcquirePlacedTexture(texture);
+		texture.pResource = m_heap.textures[texture.placedTexture].resource.get();
+	}
+}
+
+uint32_t RenderGraph::AcquirePlacedTexture(const Texture& texture)
+{
+	// Same placement and description as an earlier frame, or an earlier texture of this frame with a disjoint lifetime
+	for (uint32_t i = 0; i < m_heap.textures.size(); i++)
+	{
+		PlacedTexture& placed = m_heap.textures[i];
+		const RHIResourceDesc& desc = placed.resource->GetDesc();
+		if (placed.offset == texture.offset && desc.width == texture.desc.width && desc.height == texture.desc.height && desc.format == texture.desc.format)
+		{
+			placed.lastUsedFrame = m_frame;
+			return i;
+		}
+	}
+	m_heap.textures.push_back({ m_pDevice->CreatePlacedResource(m_heap.heap.get(), texture.offset, texture.desc), texture.offset, texture.size, texture.desc.initialState, m_frame, false });
+	return uint32_t(m_heap.textures.size() - 1);
+}
+
+RHIResourceState& RenderGraph::GetTrackedState(Texture& texture)
+{
+	// Transient textures sharing a placed resource share its state
+	return texture.bImported ? texture.state : m_heap.textures[texture.placedTexture].state;
+}
+
+void RenderGraph::BuildBarriers()
+{
+	for (CompiledPass& compiled : m_compiledPasses)
+	{
+		const Pass& pass = m_passes[compiled.pass];
+		const uint32_t accessEnd = compiled.pass + 1 < m_passes.size() ? m_passes[compiled.pass + 1].firstAccess : uint32_t(m_accesses.size());
+		compiled.firstBarrier = uint32_t(m_barriers.size());
+		compiled.firstDiscard = uint32_t(m_discards.size());
+		m_discardBarriers.clear();
+		for (uint32_t i = pass.firstAccess; i < accessEnd; i++)
+		{
+			const Access& access = m_accesses[i];
+			Texture& texture = m_textures[access.texture];
+			RHIResourceState& state = GetTrackedState(texture);
+			bool bDiscarded = false;
+			if (!texture.bImported && !texture.bActive)
+			{
+				// Memory last used by another resource: the latest texture of this frame ending before this one starts,
+				// or any resource of an earlier frame
+				texture.bActive = true;
+				RHIResource* pResourceBefore = nullptr;
+				uint32_t latestUse = 0;
+				bool bShared = false;
+				for (const Texture& other : m_textures)
+				{
+					if (&other != &texture && !other.bImported && other.firstUse != ~0u && other.lastUse < texture.firstUse &&
+						other.offset < texture.offset + texture.size && texture.offset < other.offset + other.size && other.lastUse >= latestUse)
+					{
+						pResourceBefore = other.pResource;
+						latestUse = other.lastUse;
+					}
+				}
+				for (const PlacedTexture& placed : m_heap.textures)
+				{
+					bShared |= placed.resource.get() != texture.pResource && placed.offset < texture.offset + texture.size && texture.offset < placed.offset + placed.size;
+				}
+				const bool bAliased = pResourceBefore != texture.pResource && (pResourceBefore || bShared);
+				if (bAliased)
+				{
+					m_barriers.push_back(RHIResourceBarrier::Aliasing(pResourceBefore, texture.pResource));
+				}
+
+				// Discarded in RenderTarget state, the transition to the state of the access follows the discards
+				PlacedTexture& placed = m_heap.textures[texture.placedTexture];
+				if (bAliased || !placed.bInitialized)
+				{
+					if (state != RHIResourceState::RenderTarget)
+					{
+						m_barriers.push_back(RHIResourceBarrier::Transition(texture.pResource, state, RHIResourceState::RenderTarget));
+						state = RHIResourceState::RenderTarget;
+					}
+					m_discards.push_back(texture.pResource);
+					placed.bInitialized = true;
+					bDiscarded = true;
+				}
+			}
+			if (state != access.state)
+			{
+				(bDiscarded ? m_discardBarriers : m_barriers).push_back(RHIResourceBarrier::Transition(texture.pResource, state, access.state));
+				state = access.state;
+			}
+			else if (state == RHIResourceState::UnorderedAccess && texture.lastAccess < pass.compiledIndex && (access.bWrite || texture.lastWrite == texture.lastAccess))
+			{
+				// Without a transition nothing orders the unordered accesses of two passes
+				m_barriers.push_back(RHIResourceBarrier::UnorderedAccess(texture.pResource));
+			}
+			texture.lastAccess = pass.compiledIndex;
+			texture.lastWrite = access.bWrite ? pass.compiledIndex : texture.lastWrite;
+		}
+		compiled.numBarriers = uint32_t(m_barriers.size()) - compiled.firstBarrier;
+		compiled.numDiscards = uint32_t(m_discards.size()) - compiled.firstDiscard;
+		compiled.numDiscardBarriers = uint32_t(m_discardBarriers.size());
+		m_barriers.insert(m_barriers.end(), m_discardBarriers.begin(), m_discardBarriers.end());
+
+		// Imported textures go back to where the caller expects them after their last pass
+		for (uint32_t i = pass.firstAccess; i < accessEnd; i++)
+		{
+			Texture& texture = m_textures[m_accesses[i].texture];
+			if (texture.bImported && texture.lastUse == pass.compiledIndex && texture.state != texture.finalState)
+			{
+				m_barriers.push_back(RHIResourceBarrier::Transition(texture.pResource, texture.state, texture.finalState));
+				texture.state = texture.finalState;
+			}
+		}
+		compiled.numFinalBarriers = uint32_t(m_barriers.size()) - compiled.firstBarrier - compiled.numBarriers - compiled.numDiscardBarriers;
+		m_statistics.numBarrierBatches += (compiled.numBarriers != 0) + (compiled.numDiscardBarriers != 0) + (compiled.numFinalBarriers != 0);
+	}
+
+	// Imported textures no compiled pass uses join the final barriers of the last pass, the last barriers so far
+	if (!m_compiledPasses.empty())
+	{
+		CompiledPass& last = m_compiledPasses.back();
+		const bool bHadFinalBarriers = last.numFinalBarriers != 0;
+		for (Texture& texture : m_textures)
+		{
+			if (texture.bImported && texture.firstUse == ~0u && texture.state != texture.finalState)
+			{
+				m_barriers.push_back(RHIResourceBarrier::Transition(texture.pResource, texture.state, texture.finalState));
+				texture.state = texture.finalState;
+				last.numFinalBarriers++;
+			}
+		}
+		m_statistics.numBarrierBatches += !bHadFinalBarriers && last.numFinalBarriers != 0;
+	}
+	m_statistics.numBarriers = uint32_t(m_barriers.size());
+	m_statistics.numDiscards = uint32_t(m_discards.size());
+}
+
+void RenderGraph::RecordPass(uint32_t compiledPass, RHICommandList* pCommandList) const
+{
+	const CompiledPass& compiled = m_compiledPasses[compiledPass];
+	PROFILE_SCOPE(m_passes[compiled.pass].name);
+	if (compiled.numBarriers != 0)
+	{
+		pCommandList->ResourceBarrier(compiled.numBarriers, &m_barriers[compiled.firstBarrier]);
+	}
+	for (uint32_t i = 0; i < compiled.numDiscards; i++)
+	{
+		pCommandList->DiscardResource(m_discards[compiled.firstDiscard + i]);
+	}
+	if (compiled.numDiscardBarriers != 0)
+	{
+		pCommandList->ResourceBarrier(compiled.numDiscardBarriers, &m_barriers[compiled.firstBarrier + compiled.numBarriers]);
+	}
+	const Pass& pass = m_passes[compiled.pass];
+	if (pass.execute)
+	{
+		pass.execute(pCommandList, *this);
+	}
+	if (compiled.numFinalBarriers != 0)
+	{
+		pCommandList->ResourceBarrier(compiled.numFinalBarriers, &m_barriers[compiled.firstBarrier + compiled.numBarriers + compiled.numDiscardBarriers]);
+	}
+}
+
+void RenderGraph::ReleaseRetiredResources()
+{
+	// No frame stays in flight longer than MaxFramesInFlightLimit frames
+	auto expired = [this](uint64_t frame) { return frame + MaxFramesInFlightLimit < m_frame; };
+	m_retiredHeaps.erase(std::remove_if(m_retiredHeaps.begin(), m_retiredHeaps.end(), [&](const Heap& heap) { return expired(heap.retiredFrame); }), m_retiredHeaps.end());
+	m_heap.textures.erase(std::remove_if(m_heap.textures.begin(), m_heap.textures.end(), [&](const PlacedTexture& placed) { return expired(placed.lastUsedFrame); }), m_heap.textures.end());
+}
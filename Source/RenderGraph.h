@@ -0,0 +1,166 @@
+#pragma once
+
+// Frame graph
+// Passes declare the textures they read and write. Compile() culls passes nothing depends on, derives the state
+// transitions between passes, one barrier batch per pass, and places the transient textures in a shared heap where
+// textures with disjoint lifetimes alias the same memory. Transient textures are discarded before their first pass
+// whenever their memory was last used by another resource, or never used.
+// The graph is declared again every frame, the heap and the placed resources persist across frames.
+
+#include "RHI.h"
+#include "FramePipeline.h"
+
+#include <functional>
+
+struct RenderGraphTexture
+{
+	uint32_t index = ~0u;
+
+	bool IsValid() const { return index != ~0u; }
+};
+
+class RenderGraph;
+using RenderGraphExecuteFunction = std::function<void(RHICommandList* pCommandList, const RenderGraph& graph)>;
+
+struct RenderGraphStatistics
+{
+	uint32_t	numPasses = 0;
+	uint32_t	numCulledPasses = 0;
+	uint32_t	numTransientTextures = 0;	// Used by the remaining passes
+	uint32_t	numBarriers = 0;			// Transitions, aliasing and unordered access barriers
+	uint32_t	numBarrierBatches = 0;		// ResourceBarrier() calls
+	uint32_t	numDiscards = 0;
+	uint64_t	transientBytes = 0;			// Every transient texture in its own allocation
+	uint64_t	heapBytes = 0;				// Aliased in the heap
+};
+
+class RenderGraph
+{
+public:
+	explicit RenderGraph(RHIDevice* pDevice);
+	~RenderGraph();
+
+	// Starts declaring a new frame, handles and compiled passes of the previous one become invalid
+	void Reset();
+
+	// Render target owned by the graph, its contents are undefined until the first write of the frame
+	RenderGraphTexture CreateTexture(const char* name, uint32_t width, uint32_t height, RHIFormat format);
+	// Owned outside the graph, in `state` before the first pass and back in `finalState` after the last one. Without
+	// any compiled pass using it, after the last compiled pass. Passes writing imported textures are never culled
+	RenderGraphTexture ImportTexture(const char* name, RHIResource* pResource, RHIResourceState state, RHIResourceState finalState);
+
+	// `name` also names the profiler scope of the pass, it must stay valid while the process runs
+	uint32_t AddPass(const char* name, RenderGraphExecuteFunction execute);
+	void Read(uint32_t pass, RenderGraphTexture texture, RHIResourceState state = RHIResourceState::ShaderResource);
+	// Keeps what earlier passes wrote, they stay alive as long as this pass does
+	void Write(uint32_t pass, RenderGraphTexture texture, RHIResourceState state = RHIResourceState::RenderTarget);
+	// Kept without consumers, e.g. readbacks
+	void SetSideEffects(uint32_t pass);
+
+	void Compile();
+
+	// Compiled passes are the surviving ones in declaration order. Each one records its own barriers,
+	// so they can be recorded in parallel into separate command lists submitted in order
+	uint32_t GetNumCompiledPasses() const { return uint32_t(m_compiledPasses.size()); }
+	const char* GetCompiledPassName(uint32_t compiledPass) const { return m_passes[m_compiledPasses[compiledPass].pass].name; }
+	void RecordPass(uint32_t compiledPass, RHICommandList* pCommandList) const;
+
+	bool IsPassCulled(uint32_t pass) const { return !m_passes[pass].bAlive; }
+	// Null for transient textures only culled passes use
+	RHIResource* GetResource(RenderGraphTexture texture) const { return m_textures[texture.index].pResource; }
+	const RenderGraphStatistics& GetStatistics() const { return m_statistics; }
+	uint64_t GetHeapSize() const { return m_heap.heap ? m_heap.heap->GetSize() : 0; }
+
+private:
+	struct Pass
+	{
+		const char*					name;
+		RenderGraphExecuteFunction	execute;
+		uint32_t					firstAccess = 0;	// Accesses are sorted by pass when compiling
+		uint32_t					compiledIndex = 0;
+		bool						bSideEffects = false;
+		bool						bAlive = false;
+	};
+
+	struct Access
+	{
+		uint32_t			pass;
+		uint32_t			texture;
+		RHIResourceState	state;
+		bool				bWrite;
+		uint32_t			producer;	// Last pass writing the texture before this access
+	};
+
+	struct Texture
+	{
+		const char*			name;
+		RHIResourceDesc		desc;
+		RHIResource*		pResource = nullptr;
+		RHIResourceState	state = RHIResourceState::Common;	// While compiling, the state after the last pass so far
+		RHIResourceState	finalState = RHIResourceState::Common;
+		bool				bImported = false;
+		uint32_t			firstUse = ~0u;		// Compiled pass indices
+		uint32_t			lastUse = 0;
+		uint64_t			offset = 0;
+		uint64_t			size = 0;
+		uint64_t			alignment = 0;
+		uint32_t			placedTexture = ~0u;	// In the current heap
+		bool				bActive = false;		// Aliasing barrier issued
+		uint32_t			lastAccess = ~0u;		// Compiled pass indices, while building barriers
+		uint32_t			lastWrite = ~0u;
+	};
+
+	struct CompiledPass
+	{
+		uint32_t	pass;
+		uint32_t	firstBarrier;
+		uint32_t	numBarriers;		// Before the pass
+		uint32_t	firstDiscard;
+		uint32_t	numDiscards;		// After those barriers, in RenderTarget state
+		uint32_t	numDiscardBarriers;	// After the discards, to the state of the first access
+		uint32_t	numFinalBarriers;	// After the pass, imported textures back to their final state
+	};
+
+	// Placed in the heap, reused by later frames declaring a texture with the same placement
+	struct PlacedTexture
+	{
+		std::unique_ptr<RHIResource>	resource;
+		uint64_t						offset;
+		uint64_t						size;
+		RHIResourceState				state;			// As the previous frame left it
+		uint64_t						lastUsedFrame;
+		bool							bInitialized;	// Discarded once, placed resources must be before their first use
+	};
+
+	struct Heap
+	{
+		std::unique_ptr<RHIHeap>	heap;
+		std::vector<PlacedTexture>	textures;
+		uint64_t					retiredFrame = 0;
+	};
+
+	void CullPasses();
+	void PlaceTransientTextures();
+	void AllocateTransientTextures();
+	void BuildBarriers();
+	uint32_t AcquirePlacedTexture(const Texture& texture);
+	RHIResourceState& GetTrackedState(Texture& texture);
+	void ReleaseRetiredResources();
+
+	RHIDevice*							m_pDevice;
+	std::vector<Pass>					m_passes;
+	std::vector<Access>					m_accesses;
+	std::vector<Texture>				m_textures;
+	std::vector<CompiledPass>			m_compiledPasses;
+	std::vector<RHIResourceBarrier>		m_barriers;
+	std::vector<RHIResourceBarrier>		m_discardBarriers;	// Of the pass building its barriers
+	std::vector<RHIResource*>			m_discards;
+	std::vector<uint32_t>				m_placementOrder;
+	std::vector<uint32_t>				m_lastWriters;
+	RenderGraphStatistics				m_statistics;
+
+	// Replaced heaps stay alive until no frame in flight can use them
+	Heap								m_heap;
+	std::vector<Heap>					m_retiredHeaps;
+	uint64_t							m_frame = 0;
+};
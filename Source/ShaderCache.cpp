@@ -0,0 +1,221 @@
+#include "ShaderCache.h"
+#include "FileIO.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	enum : uint32_t
+	{
+		ShaderCacheMagic = 0x43444853,	// "SHDC"
+		ShaderCacheVersion = 1,
+	};
+
+	struct ShaderCacheEntryHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint64_t bytecodeSize;
+	};
+
+	bool ReadTextFile(const std::filesystem::path& path, std::string& content)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		content = stream.str();
+		return true;
+	}
+
+	// Collects the names of `#include "name"` and `#include <name>` directives
+	void FindIncludes(const std::string& source, std::vector<std::string>& includes)
+	{
+		size_t position = 0;
+		while ((position = source.find("#include", position)) != std::string::npos)
+		{
+			position += 8;
+			const size_t open = source.find_first_of("\"<\n", position);
+			if (open == std::string::npos || source[open] == '\n')
+			{
+				continue;
+			}
+			const size_t close = source.find_first_of(source[open] == '"' ? "\"\n" : ">\n", open + 1);
+			if (close == std::string::npos || source[close] == '\n')
+			{
+				continue;
+			}
+			includes.push_back(source.substr(open + 1, close - open - 1));
+			position = close;
+		}
+	}
+}
+
+bool StubShaderCompiler::Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+	m_numCompilations++;
+
+	std::string source;
+	if (!ReadTextFile(request.filePath, source))
+	{
+		errors = "StubShaderCompiler: can not open source file";
+		return false;
+	}
+	if (source.find(request.entryPoint) == std::string::npos)
+	{
+		errors = "StubShaderCompiler: entry point " + request.entryPoint + " not found";
+		return false;
+	}
+
+	// Fake but deterministic bytecode
+	const std::string blob = "STUB:" + request.target + ":" + request.entryPoint + ":" + HashToString(HashString(source));
+	bytecode.assign(blob.begin(), blob.end());
+	return true;
+}
+
+ShaderCache::ShaderCache(const std::wstring& cacheDirectory, ShaderCompiler* pCompiler)
+	: m_cacheDirectory(cacheDirectory)
+	, m_pCompiler(pCompiler)
+{
+	std::error_code error;
+	std::filesystem::create_directories(m_cacheDirectory, error);
+}
+
+uint64_t ShaderCache::ComputeKey(const ShaderCompileRequest& request) const
+{
+	uint64_t key = HashCombine(ShaderCacheVersion, m_pCompiler->GetVersionHash());
+
+	std::set<std::filesystem::path> visited;
+	key = HashSourceFile(std::filesystem::path(request.filePath), visited, key);
+
+	for (const ShaderDefine& define : request.defines)
+	{
+		key = HashString(define.name, key);
+		key = HashString(define.value, key);
+	}
+	key = HashString(request.entryPoint, key);
+	key = HashString(request.target, key);
+	key = HashCombine(key, (uint64_t(request.flags2) << 32) | request.flags1);
+	return key;
+}
+
+uint64_t ShaderCache::HashSourceFile(const std::filesystem::path& path, std::set<std::filesystem::path>& visited, uint64_t seed) const
+{
+	const std::filesystem::path normalizedPath = path.lexically_normal();
+	if (!visited.insert(normalizedPath).second)
+	{
+		return seed;
+	}
+
+	std::string source;
+	if (!ReadTextFile(normalizedPath, source))
+	{
+		// Missing file, compiler reports the error, still hash the name so the key is stable
+		return HashString(normalizedPath.string(), seed);
+	}
+
+	uint64_t hash = HashString(source, seed);
+
+	std::vector<std::string> includes;
+	FindIncludes(source, includes);
+	for (const std::string& include : includes)
+	{
+		hash = HashSourceFile(normalizedPath.parent_path() / include, visited, hash);
+	}
+	return hash;
+}
+
+std::filesystem::path ShaderCache::GetEntryPath(uint64_t key) const
+{
+	return m_cacheDirectory / (HashToString(key) + ".cso");
+}
+
+ShaderBytecode ShaderCache::GetOrCompile(const ShaderCompileRequest& request)
+{
+	const uint64_t key = ComputeKey(request);
+
+	ShaderBytecode bytecode;
+	if (LoadEntry(key, bytecode))
+	{
+		m_statistics.hits++;
+		return bytecode;
+	}
+	m_statistics.misses++;
+
+	std::string errors;
+	if (!m_pCompiler->Compile(request, bytecode.m_owned, errors))
+	{
+		throw std::runtime_error("Failed to compile shader " + std::filesystem::path(request.filePath).string() + " (" + request.entryPoint + "): " + errors);
+	}
+
+	// Prefer the mapped copy, keeps one code path for hits and misses
+	if (StoreEntry(key, bytecode.m_owned) && LoadEntry(key, bytecode))
+	{
+		bytecode.m_owned.clear();
+		return bytecode;
+	}
+
+	m_statistics.writeFailures++;
+	bytecode.m_pData = bytecode.m_owned.data();
+	bytecode.m_size = bytecode.m_owned.size();
+	return bytecode;
+}
+
+bool ShaderCache::LoadEntry(uint64_t key, ShaderBytecode& bytecode) const
+{
+	if (!bytecode.m_view.Open(GetEntryPath(key).wstring()))
+	{
+		return false;
+	}
+
+	// Truncated or foreign files are treated as misses and overwritten
+	ShaderCacheEntryHeader header;
+	if (bytecode.m_view.GetSize() < sizeof(header))
+	{
+		bytecode.m_view.Close();
+		return false;
+	}
+	memcpy(&header, bytecode.m_view.GetData(), sizeof(header));
+	if (header.magic != ShaderCacheMagic || header.version != ShaderCacheVersion || header.key != key ||
+		header.bytecodeSize != bytecode.m_view.GetSize() - sizeof(header))
+	{
+		bytecode.m_view.Close();
+		return false;
+	}
+
+	bytecode.m_pData = bytecode.m_view.GetData() + sizeof(header);
+	bytecode.m_size = size_t(header.bytecodeSize);
+	return true;
+}
+
+bool ShaderCache::StoreEntry(uint64_t key, const std::vector<uint8_t>& bytecode) const
+{
+	ShaderCacheEntryHeader header;
+	header.magic = ShaderCacheMagic;
+	header.version = ShaderCacheVersion;
+	header.key = key;
+	header.bytecodeSize = bytecode.size();
+
+	std::vector<uint8_t> data(sizeof(header) + bytecode.size());
+	memcpy(data.data(), &header, sizeof(header));
+	memcpy(data.data() + sizeof(header), bytecode.data(), bytecode.size());
+	const std::filesystem::path entryPath = GetEntryPath(key);
+	try
+	{
+		WriteFileAtomically(entryPath.wstring(), data.data(), data.size());
+	}
+	catch (const FileIOException&)
+	{
+		// Another thread or process may have stored the same entry first
+		std::error_code error;
+		return std::filesystem::exists(entryPath, error);
+	}
+	return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+// Persistent shader bytecode cache
+// Entries are keyed by a hash of the source and every file it includes (transitively), the defines,
+// the entry point/target, the compile flags and the compiler identity. One file per entry in the cache
+// folder, hits are returned as memory mapped views so nothing is copied.
+
+#include "Platform.h"
+#include "FileView.h"
+
+#include <atomic>
+#include <filesystem>
+#include <set>
+#include <vector>
+
+struct ShaderDefine
+{
+	std::string name;
+	std::string value;
+};
+
+struct ShaderCompileRequest
+{
+	std::wstring				filePath;	// Full path
+	std::string					entryPoint;
+	std::string					target;
+	std::vector<ShaderDefine>	defines;
+	uint32_t					flags1 = 0;
+	uint32_t					flags2 = 0;
+};
+
+class ShaderCompiler
+{
+public:
+	virtual ~ShaderCompiler() {}
+
+	// Identifies compiler build and settings, part of every cache key
+	virtual uint64_t GetVersionHash() const = 0;
+	// Returns false and fills `errors` on failure
+	virtual bool Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors) = 0;
+};
+
+// Deterministic stand-in for the real compiler, cache hit/miss behaviour can be tested without D3DCompiler
+class StubShaderCompiler : public ShaderCompiler
+{
+public:
+	uint64_t GetVersionHash() const override { return 0x5354554253484452ull; }
+	bool Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors) override;
+
+	uint32_t GetNumCompilations() const { return m_numCompilations.load(); }
+
+private:
+	std::atomic<uint32_t> m_numCompilations = 0;
+};
+
+// Either a mapped cache entry or an owned blob (when the cache folder is not writable)
+class ShaderBytecode
+{
+public:
+	const uint8_t* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+	bool IsMapped() const { return m_view.IsOpen(); }
+
+private:
+	friend class ShaderCache;
+
+	FileView				m_view;
+	std::vector<uint8_t>	m_owned;
+	const uint8_t*			m_pData = nullptr;
+	size_t					m_size = 0;
+};
+
+struct ShaderCacheStatistics
+{
+	std::atomic<uint32_t> hits = 0;
+	std::atomic<uint32_t> misses = 0;
+	std::atomic<uint32_t> writeFailures = 0;
+};
+
+class ShaderCache
+{
+public:
+	ShaderCache(const std::wstring& cacheDirectory, ShaderCompiler* pCompiler);
+
+	uint64_t ComputeKey(const ShaderCompileRequest& request) const;
+	// Throws std::runtime_error with the compiler output on failure. Thread safe
+	ShaderBytecode GetOrCompile(const ShaderCompileRequest& request);
+
+	std::filesystem::path GetEntryPath(uint64_t key) const;
+	const ShaderCacheStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+	uint64_t HashSourceFile(const std::filesystem::path& path, std::set<std::filesystem::path>& visited, uint64_t seed) const;
+	bool LoadEntry(uint64_t key, ShaderBytecode& bytecode) const;
+	bool StoreEntry(uint64_t key, const std::vector<uint8_t>& bytecode) const;
+
+	std::filesystem::path	m_cacheDirectory;
+	ShaderCompiler*			m_pCompiler;
+	ShaderCacheStatistics	m_statistics;
+};
@@ -0,0 +1,133 @@
+#include "ShadowAtlas.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <bit>
+
+ShadowAtlas::ShadowAtlas(uint32_t size, uint32_t minTileSize)
+	: m_size(size)
+{
+	check(!std::has_single_bit(size) || !std::has_single_bit(minTileSize) || minTileSize > size);
+	m_numLevels = uint32_t(std::countr_zero(size) - std::countr_zero(minTileSize)) + 1;
+	Reset();
+}
+
+void ShadowAtlas::Reset()
+{
+	const uint32_t numNodes = GetLevelOffset(m_numLevels);
+	m_states.assign(numNodes, NodeState::Unused);
+	m_freeListPositions.assign(numNodes, 0);
+	m_freeNodes.assign(m_numLevels, {});
+	m_allocatedArea = 0;
+	PushFree(0, 0);
+}
+
+uint32_t ShadowAtlas::GetLevel(uint32_t node) const
+{
+	uint32_t level = 0;
+	while (GetLevelOffset(level + 1) <= node)
+	{
+		level++;
+	}
+	return level;
+}
+
+ShadowAtlasRect ShadowAtlas::GetRect(uint32_t node) const
+{
+	const uint32_t level = GetLevel(node);
+	const uint32_t index = node - GetLevelOffset(level);
+	const uint32_t tileSize = m_size >> level;
+	const uint32_t nodesPerRow = 1u << level;
+	return { (index % nodesPerRow) * tileSize, (index / nodesPerRow) * tileSize, tileSize };
+}
+
+uint32_t ShadowAtlas::Allocate(uint32_t tileSize)
+{
+	tileSize = std::clamp(std::bit_ceil(std::max(tileSize, 1u)), GetMinTileSize(), m_size);
+	const uint32_t level = uint32_t(std::countr_zero(m_size) - std::countr_zero(tileSize));
+
+	// Smallest free node that fits, split down to the requested level
+	int32_t freeLevel = int32_t(level);
+	while (freeLevel >= 0 && m_freeNodes[freeLevel].empty())
+	{
+		freeLevel--;
+	}
+	if (freeLevel < 0)
+	{
+		return InvalidNode;
+	}
+
+	uint32_t node = m_freeNodes[freeLevel].back();
+	RemoveFree(uint32_t(freeLevel), node);
+	for (uint32_t splitLevel = uint32_t(freeLevel); splitLevel < level; splitLevel++)
+	{
+		m_states[node] = NodeState::Split;
+		const uint32_t index = node - GetLevelOffset(splitLevel);
+		const uint32_t nodesPerRow = 1u << splitLevel;
+		const uint32_t childX = (index % nodesPerRow) * 2;
+		const uint32_t childY = (index / nodesPerRow) * 2;
+		const uint32_t childRow = GetLevelOffset(splitLevel + 1) + childY * nodesPerRow * 2 + childX;
+		// Keep the top left child, the others become free
+		PushFree(splitLevel + 1, childRow + 1);
+		PushFree(splitLevel + 1, childRow + nodesPerRow * 2);
+		PushFree(splitLevel + 1, childRow + nodesPerRow * 2 + 1);
+		node = childRow;
+	}
+	m_states[node] = NodeState::Allocated;
+	m_allocatedArea += uint64_t(tileSize) * tileSize;
+	return node;
+}
+
+void ShadowAtlas::Free(uint32_t node)
+{
+	check(node >= m_states.size() || m_states[node] != NodeState::Allocated);
+	uint32_t level = GetLevel(node);
+	const uint64_t tileSize = m_size >> level;
+	m_allocatedArea -= tileSize * tileSize;
+
+	// Merge with the siblings as long as all 4 are free
+	while (level > 0)
+	{
+		const uint32_t index = node - GetLevelOffset(level);
+		const uint32_t nodesPerRow = 1u << level;
+		const uint32_t firstSibling = GetLevelOffset(level) + (index / nodesPerRow & ~1u) * nodesPerRow + (index % nodesPerRow & ~1u);
+		const uint32_t siblings[4] = { firstSibling, firstSibling + 1, firstSibling + nodesPerRow, firstSibling + nodesPerRow + 1 };
+		bool bAllFree = true;
+		for (const uint32_t sibling : siblings)
+		{
+			bAllFree &= sibling == node || m_states[sibling] == NodeState::Free;
+		}
+		if (!bAllFree)
+		{
+			break;
+		}
+		for (const uint32_t sibling : siblings)
+		{
+			if (sibling != node)
+			{
+				RemoveFree(level, sibling);
+			}
+			m_states[sibling] = NodeState::Unused;
+		}
+		const uint32_t parentIndex = (index / nodesPerRow / 2) * (nodesPerRow / 2) + (index % nodesPerRow / 2);
+		node = GetLevelOffset(level - 1) + parentIndex;
+		level--;
+	}
+	PushFree(level, node);
+}
+
+void ShadowAtlas::PushFree(uint32_t level, uint32_t node)
+{
+	m_states[node] = NodeState::Free;
+	m_freeListPositions[node] = uint32_t(m_freeNodes[level].size());
+	m_freeNodes[level].push_back(node);
+}
+
+void ShadowAtlas::RemoveFree(uint32_t level, uint32_t node)
+{
+	std::vector<uint32_t>& freeNodes = m_freeNodes[level];
+	const uint32_t position = m_freeListPositions[node];
+	freeNodes[position] = freeNodes.back();
+	m_freeListPositions[freeNodes[position]] = position;
+	freeNodes.pop_back();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Quadtree allocator for the tiles of a square shadow atlas
+// Tiles are power of two sized nodes of a quadtree over the atlas. Free nodes are kept in one list per level, an
+// allocation takes a free node of its level or splits the smallest larger one, a freed node merges with its 3
+// siblings back into their parent once they are all free. Both are O(levels).
+
+#include <cstdint>
+#include <vector>
+
+struct ShadowAtlasRect
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t size;
+};
+
+class ShadowAtlas
+{
+public:
+	enum : uint32_t { InvalidNode = ~0u };
+
+	// Both powers of two
+	explicit ShadowAtlas(uint32_t size = 8192, uint32_t minTileSize = 128);
+
+	// `tileSize` is rounded up to a power of two and clamped to [minTileSize, size], InvalidNode when full
+	uint32_t Allocate(uint32_t tileSize);
+	void Free(uint32_t node);
+	void Reset();
+
+	ShadowAtlasRect GetRect(uint32_t node) const;
+	uint32_t GetSize() const { return m_size; }
+	uint32_t GetMinTileSize() const { return m_size >> (m_numLevels - 1); }
+	uint32_t GetNumLevels() const { return m_numLevels; }
+	uint64_t GetAllocatedArea() const { return m_allocatedArea; }
+	float GetOccupancy() const { return float(double(m_allocatedArea) / (double(m_size) * m_size)); }
+
+private:
+	enum class NodeState : uint8_t
+	{
+		Unused,		// Part of a larger free or allocated node
+		Free,
+		Split,
+		Allocated,
+	};
+
+	// Nodes of level l are numbered row major after those of the levels above, (4^l - 1) / 3 of them
+	static uint32_t GetLevelOffset(uint32_t level) { return ((1u << (2 * level)) - 1) / 3; }
+	uint32_t GetLevel(uint32_t node) const;
+
+	void PushFree(uint32_t level, uint32_t node);
+	void RemoveFree(uint32_t level, uint32_t node);
+
+	uint32_t	m_size;
+	uint32_t	m_numLevels;
+	uint64_t	m_allocatedArea = 0;
+
+	std::vector<NodeState>				m_states;
+	std::vector<std::vector<uint32_t>>	m_freeNodes;			// Per level
+	std::vector<uint32_t>				m_freeListPositions;	// Of free nodes in their level's list
+};
@@ -0,0 +1,289 @@
+#include "ShadowSetup.h"
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+	Float3 GetStableUp(const Float3& direction)
+	{
+		return std::abs(Normalize(direction).y) < 0.99f ? Float3{ 0.0f, 1.0f, 0.0f } : Float3{ 1.0f, 0.0f, 0.0f };
+	}
+
+	bool IsSameLight(const ShadowedLight& a, const ShadowedLight& b)
+	{
+		return a.type == b.type && a.range == b.range && a.outerAngle == b.outerAngle
+			&& memcmp(&a.position, &b.position, sizeof(Float3)) == 0 && memcmp(&a.direction, &b.direction, sizeof(Float3)) == 0;
+	}
+
+	Float4x4 GetLightFaceViewProjection(const ShadowedLight& light, uint32_t face)
+	{
+		const float nearZ = light.range * 0.01f;
+		if (light.type == ShadowLightType::Spot)
+		{
+			const Float4x4 view = MatrixLookToLH(light.position, light.direction, GetStableUp(light.direction));
+			return MatrixMultiply(view, MatrixPerspectiveFovLH(2.0f * light.outerAngle, 1.0f, nearZ, light.range));
+		}
+
+		// Cube faces +x, -x, +y, -y, +z, -z with the usual up vectors
+		static const Float3 directions[6] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+		static const Float3 ups[6] = { { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+		const Float4x4 view = MatrixLookToLH(light.position, directions[face], ups[face]);
+		return MatrixMultiply(view, MatrixPerspectiveFovLH(1.5707964f, 1.0f, nearZ, light.range));
+	}
+
+	bool SphereIntersectsFrustum(const Frustum& frustum, const Float3& center, float radius)
+	{
+		for (const Float4& plane : frustum.planes)
+		{
+			if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void ComputeShadowCascades(const Camera& camera, const Float3& lightDirection, const ShadowCascadeDesc& desc, std::vector<ShadowCascade>& cascades)
+{
+	cascades.resize(desc.numCascades);
+	const float nearZ = camera.nearZ;
+	const float farZ = std::min(desc.maxDistance, camera.farZ);
+	const float tanHalfY = std::tan(camera.fovY * 0.5f);
+	const float tanHalfX = tanHalfY * camera.aspectRatio;
+	const float diagonalSquared = tanHalfX * tanHalfX + tanHalfY * tanHalfY;
+	const Float3 forward = Normalize(camera.forward);
+	const Float4x4 lightView = MatrixLookToLH({ 0.0f, 0.0f, 0.0f }, lightDirection, GetStableUp(lightDirection));
+
+	for (uint32_t i = 0; i < desc.numCascades; i++)
+	{
+		ShadowCascade& cascade = cascades[i];
+		// Practical split scheme, a blend of logarithmic and uniform
+		auto split = [&](uint32_t index)
+		{
+			const float t = float(index) / float(desc.numCascades);
+			const float logarithmic = nearZ * std::pow(farZ / nearZ, t);
+			const float uniform = nearZ + (farZ - nearZ) * t;
+			return desc.splitLambda * logarithmic + (1.0f - desc.splitLambda) * uniform;
+		};
+		cascade.splitNear = i == 0 ? nearZ : split(i);
+		cascade.splitFar = i + 1 == desc.numCascades ? farZ : split(i + 1);
+
+		// Smallest sphere around the slice, centered on the view axis so it does not depend on the rotation:
+		// equidistant to the near and far corners, or around the far cap when that is closer
+		const float n = cascade.splitNear;
+		const float f = cascade.splitFar;
+		const float centerDistance = std::min((f + n) * (1.0f + diagonalSquared) * 0.5f, f);
+		const float farDistance = f - centerDistance;
+		const float nearDistance = centerDistance - n;
+		float radius = std::sqrt(std::max(farDistance * farDistance + f * f * diagonalSquared, nearDistance * nearDistance + n * n * diagonalSquared));
+		// Rounded up so float noise in the camera parameters does not change the texel size
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+		cascade.bounds = { camera.position + forward * centerDistance, radius };
+
+		// Light space center snapped to whole texels, the depth range as well so the projection, and the cached
+		// static casters with it, stays the same for sub-texel camera motion
+		cascade.texelSize = 2.0f * radius / float(desc.resolution);
+		Float3 center = TransformPoint(cascade.bounds.center, lightView);
+		center.x = std::floor(center.x / cascade.texelSize) * cascade.texelSize;
+		center.y = std::floor(center.y / cascade.texelSize) * cascade.texelSize;
+		center.z = std::floor(center.z / cascade.texelSize) * cascade.texelSize;
+		const Float4x4 projection = MatrixOrthographicOffCenterLH(center.x - radius, center.x + radius, center.y - radius, center.y + radius, center.z - radius - desc.casterDistance, center.z + radius);
+		cascade.view = lightView;
+		cascade.viewProjection = MatrixMultiply(lightView, projection);
+	}
+}
+
+ShadowSetup::ShadowSetup(const ShadowSetupDesc& desc)
+	: m_desc(desc)
+	, m_atlas(desc.atlasSize, desc.minTileSize)
+{
+}
+
+void ShadowSetup::Update(const Camera& camera, const Float3& sunDirection, const std::vector<ShadowedLight>& lights)
+{
+	m_frame++;
+	m_statistics = {};
+
+	// Cascades keep their static casters while the snapped projection stays the same
+	ComputeShadowCascades(camera, sunDirection, m_desc.cascades, m_cascades);
+	m_lastCascadeViewProjections.resize(m_cascades.size());
+	m_cascadeStaticValid.resize(m_cascades.size(), 0);
+	for (uint32_t i = 0; i < m_cascades.size(); i++)
+	{
+		ShadowCascade& cascade = m_cascades[i];
+		const bool bSameProjection = memcmp(&cascade.viewProjection, &m_lastCascadeViewProjections[i], sizeof(Float4x4)) == 0;
+		cascade.bRenderStatic = !bSameProjection || !m_cascadeStaticValid[i];
+		m_lastCascadeViewProjections[i] = cascade.viewProjection;
+		m_cascadeStaticValid[i] = 1;
+		m_statistics.numStaticRenders += cascade.bRenderStatic ? 1 : 0;
+	}
+
+	// Importance is the fraction of the screen height covered by the light's sphere
+	const Frustum frustum = ExtractFrustumPlanes(camera.GetViewProjectionMatrix());
+	const float tanHalfY = std::tan(camera.fovY * 0.5f);
+	m_candidates.clear();
+	for (uint32_t i = 0; i < lights.size(); i++)
+	{
+		const ShadowedLight& light = lights[i];
+		if (!SphereIntersectsFrustum(frustum, light.position, light.range))
+		{
+			m_statistics.numUnshadowedLights++;
+			continue;
+		}
+		const float distance = Length(light.position - camera.position);
+		const float importance = distance <= light.range ? 1.0f : std::min(light.range / (distance * tanHalfY), 1.0f);
+		m_candidates.push_back({ i, importance, 0 });
+	}
+	std::stable_sort(m_candidates.begin(), m_candidates.end(), [](const Candidate& a, const Candidate& b) { return a.importance > b.importance; });
+
+	// Lights that kept a fitting tile size hold on to their tiles, the others give them back before anything is
+	// placed so the most important lights find the room
+	for (Candidate& candidate : m_candidates)
+	{
+		const ShadowedLight& light = lights[candidate.light];
+		const float idealSize = candidate.importance * float(m_desc.maxTileSize);
+		const uint32_t tileSize = std::clamp(std::bit_ceil(uint32_t(std::max(idealSize, 1.0f))), m_desc.minTileSize, m_desc.maxTileSize);
+
+		CachedLight& cached = m_cache[light.id];
+		cached.frame = m_frame;
+		if (cached.tileSize != 0)
+		{
+			// Hysteresis so lights near a size boundary do not flip between two tile sizes
+			const float requestedSize = float(cached.requestedTileSize);
+			const bool bFits = idealSize <= requestedSize * 1.25f && (idealSize >= requestedSize * 0.4f || cached.requestedTileSize == m_desc.minTileSize);
+			if (bFits && GetNumFaces(cached.light) == GetNumFaces(light))
+			{
+				continue;
+			}
+			FreeTiles(cached);
+		}
+		candidate.pendingTileSize = tileSize;
+	}
+	for (auto it = m_cache.begin(); it != m_cache.end();)
+	{
+		if (it->second.frame != m_frame)
+		{
+			FreeTiles(it->second);
+			it = m_cache.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// New tiles in order of importance, smaller ones when the atlas runs out of room
+	m_views.clear();
+	for (const Candidate& candidate : m_candidates)
+	{
+		const ShadowedLight& light = lights[candidate.light];
+		CachedLight& cached = m_cache[light.id];
+		if (candidate.pendingTileSize != 0)
+		{
+			cached.requestedTileSize = candidate.pendingTileSize;
+			if (!AllocateTiles(cached, GetNumFaces(light), candidate.pendingTileSize))
+			{
+				m_cache.erase(light.id);
+				m_statistics.numUnshadowedLights++;
+				continue;
+			}
+			m_statistics.numAllocations++;
+		}
+		if (!IsSameLight(cached.light, light))
+		{
+			cached.light = light;
+			cached.bStaticValid = false;
+		}
+
+		for (uint32_t face = 0; face < GetNumFaces(light); face++)
+		{
+			m_views.push_back({ light.id, face, m_atlas.GetRect(cached.nodes[face]), GetLightFaceViewProjection(light, face), !cached.bStaticValid });
+			m_statistics.numStaticRenders += cached.bStaticValid ? 0 : 1;
+		}
+		cached.bStaticValid = true;
+		m_statistics.numShadowedLights++;
+	}
+
+	m_statistics.numViews = uint32_t(m_views.size());
+	m_statistics.atlasOccupancy = m_atlas.GetOccupancy();
+}
+
+bool ShadowSetup::AllocateTiles(CachedLight& cached, uint32_t numFaces, uint32_t tileSize)
+{
+	for (; tileSize >= m_desc.minTileSize; tileSize /= 2)
+	{
+		uint32_t face = 0;
+		for (; face < numFaces; face++)
+		{
+			cached.nodes[face] = m_atlas.Allocate(tileSize);
+			if (cached.nodes[face] == ShadowAtlas::InvalidNode)
+			{
+				break;
+			}
+		}
+		if (face == numFaces)
+		{
+			std::fill(cached.nodes + numFaces, cached.nodes + 6, uint32_t(ShadowAtlas::InvalidNode));
+			cached.tileSize = tileSize;
+			cached.bStaticValid = false;
+			return true;
+		}
+		while (face > 0)
+		{
+			m_atlas.Free(cached.nodes[--face]);
+		}
+	}
+	return false;
+}
+
+void ShadowSetup::FreeTiles(CachedLight& cached)
+{
+	for (uint32_t face = 0; face < 6 && cached.tileSize != 0; face++)
+	{
+		if (cached.nodes[face] != ShadowAtlas::InvalidNode)
+		{
+			m_atlas.Free(cached.nodes[face]);
+		}
+	}
+	cached.tileSize = 0;
+	cached.bStaticValid = false;
+}
+
+void ShadowSetup::InvalidateStatic(const BoundingSphere& bounds)
+{
+	for (auto& [id, cached] : m_cache)
+	{
+		const float distance = Length(cached.light.position - bounds.center);
+		if (distance <= cached.light.range + bounds.radius)
+		{
+			cached.bStaticValid = false;
+		}
+	}
+
+	// Casters anywhere in the column from the cascade towards the light
+	for (uint32_t i = 0; i < m_cascades.size() && i < m_cascadeStaticValid.size(); i++)
+	{
+		const ShadowCascade& cascade = m_cascades[i];
+		const Float3 center = TransformPoint(cascade.bounds.center, cascade.view);
+		const Float3 p = TransformPoint(bounds.center, cascade.view);
+		const float reach = cascade.bounds.radius + bounds.radius;
+		const bool bInDepthRange = p.z - bounds.radius <= center.z + cascade.bounds.radius && p.z + bounds.radius >= center.z - cascade.bounds.radius - m_desc.cascades.casterDistance;
+		if (std::abs(p.x - center.x) <= reach && std::abs(p.y - center.y) <= reach && bInDepthRange)
+		{
+			m_cascadeStaticValid[i] = 0;
+		}
+	}
+}
+
+void ShadowSetup::InvalidateAllStatic()
+{
+	for (auto& [id, cached] : m_cache)
+	{
+		cached.bStaticValid = false;
+	}
+	std::fill(m_cascadeStaticValid.begin(), m_cascadeStaticValid.end(), uint8_t(0));
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+// CPU side shadow setup, run once per frame before command recording
+// The directional light gets cascades fitted to bounding spheres of the view frustum slices. A sphere does not change
+// with the camera's rotation, and its light space center is snapped to whole shadow map texels, so cascades only move
+// in texel steps and do not shimmer.
+//
+// Spot and point lights (one tile per cube face) share a quadtree ShadowAtlas. Tile sizes follow the screen space
+// importance of the light, the most important lights are placed first. Lights keep their tiles from frame to frame
+// while the size still fits, which lets the static casters of a tile be cached: bRenderStatic is only set when the
+// tile, the light or the static geometry around it changed. Dynamic casters are rendered on top every frame.
+
+#include "Camera.h"
+#include "ShadowAtlas.h"
+
+#include <unordered_map>
+#include <vector>
+
+enum class ShadowLightType : uint8_t
+{
+	Spot,
+	Point,
+};
+
+struct ShadowedLight
+{
+	uint32_t		id;				// Stable across frames, the cache key
+	ShadowLightType	type;
+	Float3			position;
+	Float3			direction;		// Spot lights only
+	float			range;
+	float			outerAngle;		// Half angle of the cone in radians, spot lights only
+};
+
+struct ShadowCascadeDesc
+{
+	uint32_t	numCascades = 4;
+	uint32_t	resolution = 2048;
+	float		maxDistance = 150.0f;
+	float		splitLambda = 0.8f;			// 0 uniform, 1 logarithmic splits
+	float		casterDistance = 100.0f;	// Casters this far towards the light still render into a cascade
+};
+
+struct ShadowSetupDesc
+{
+	ShadowCascadeDesc	cascades;
+	uint32_t			atlasSize = 8192;
+	uint32_t			minTileSize = 128;
+	uint32_t			maxTileSize = 2048;
+};
+
+struct ShadowCascade
+{
+	float			splitNear;			// View depth range covered
+	float			splitFar;
+	BoundingSphere	bounds;				// World space, encloses the frustum slice
+	Float4x4		view;				// Rotation into light space
+	Float4x4		viewProjection;
+	float			texelSize;			// World units
+	bool			bRenderStatic;		// Static casters must be re-rendered this frame
+};
+
+// One atlas tile, a spot light or a point light face
+struct ShadowMapView
+{
+	uint32_t		lightId;
+	uint32_t		face;
+	ShadowAtlasRect	rect;
+	Float4x4		viewProjection;
+	bool			bRenderStatic;
+};
+
+struct ShadowStatistics
+{
+	uint32_t	numShadowedLights = 0;
+	uint32_t	numUnshadowedLights = 0;	// Off screen or no room left in the atlas
+	uint32_t	numViews = 0;
+	uint32_t	numStaticRenders = 0;		// Views and cascades with bRenderStatic
+	uint32_t	numAllocations = 0;			// Lights that got new tiles this frame
+	float		atlasOccupancy = 0.0f;
+};
+
+// Fills `cascades` with desc.numCascades entries
+void ComputeShadowCascades(const Camera& camera, const Float3& lightDirection, const ShadowCascadeDesc& desc, std::vector<ShadowCascade>& cascades);
+
+class ShadowSetup
+{
+public:
+	explicit ShadowSetup(const ShadowSetupDesc& desc = {});
+
+	void Update(const Camera& camera, const Float3& sunDirection, const std::vector<ShadowedLight>& lights);
+
+	// Static geometry within `bounds` changed, the cached shadows it may touch are re-rendered on the next Update()
+	void InvalidateStatic(const BoundingSphere& bounds);
+	void InvalidateAllStatic();
+
+	const std::vector<ShadowCascade>& GetCascades() const { return m_cascades; }
+	const std::vector<ShadowMapView>& GetViews() const { return m_views; }
+	const ShadowAtlas& GetAtlas() const { return m_atlas; }
+	const ShadowStatistics& GetStatistics() const { return m_statistics; }
+	const ShadowSetupDesc& GetDesc() const { return m_desc; }
+
+private:
+	struct CachedLight
+	{
+		ShadowedLight	light = {};
+		uint32_t		requestedTileSize = 0;	// Before falling back to smaller tiles
+		uint32_t		tileSize = 0;
+		uint32_t		nodes[6] = {};
+		uint32_t		frame = 0;			// Last frame the light was shadowed
+		bool			bStaticValid = false;
+	};
+
+	struct Candidate
+	{
+		uint32_t	light;
+		float		importance;
+		uint32_t	pendingTileSize;	// 0 when the light keeps its tiles
+	};
+
+	static uint32_t GetNumFaces(const ShadowedLight& light) { return light.type == ShadowLightType::Point ? 6 : 1; }
+	// Falls back to smaller tiles down to minTileSize
+	bool AllocateTiles(CachedLight& cached, uint32_t numFaces, uint32_t tileSize);
+	void FreeTiles(CachedLight& cached);
+
+	ShadowSetupDesc									m_desc;
+	ShadowAtlas										m_atlas;
+	std::unordered_map<uint32_t, CachedLight>		m_cache;
+	uint32_t										m_frame = 0;
+
+	std::vector<ShadowCascade>	m_cascades;
+	std::vector<Float4x4>		m_lastCascadeViewProjections;
+	std::vector<uint8_t>		m_cascadeStaticValid;
+
+	std::vector<Candidate>		m_candidates;
+	std::vector<ShadowMapView>	m_views;
+	ShadowStatistics			m_statistics;
+};
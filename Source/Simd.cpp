@@ -0,0 +1,107 @@
+#include "Simd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define ENGINE_SIMD_X86 1
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#else
+	#define ENGINE_SIMD_X86 0
+#endif
+
+namespace
+{
+#if ENGINE_SIMD_X86
+	void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t (&registers)[4])
+	{
+	#if defined(_MSC_VER)
+		int values[4];
+		__cpuidex(values, int(leaf), int(subleaf));
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			registers[i] = uint32_t(values[i]);
+		}
+	#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+	#endif
+	}
+
+	// Register state the OS saves on context switches, XCR0
+	uint64_t GetEnabledRegisterState()
+	{
+	#if defined(_MSC_VER)
+		return _xgetbv(0);
+	#else
+		uint32_t low, high;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (uint64_t(high) << 32) | low;
+	#endif
+	}
+#endif
+
+	SimdLevel DetectSimdLevel()
+	{
+#if ENGINE_SIMD_X86
+		enum : uint64_t
+		{
+			StateAVX = 0x6,			// XMM, YMM
+			StateAVX512 = 0xE0,		// Opmask, ZMM 0-15 upper halves, ZMM 16-31
+		};
+
+		uint32_t registers[4];
+		Cpuid(0, 0, registers);
+		const uint32_t maxLeaf = registers[0];
+
+		Cpuid(1, 0, registers);
+		const bool bSSE2 = (registers[3] & (1u << 26)) != 0;
+		const bool bOSXSave = (registers[2] & (1u << 27)) != 0;
+		const bool bAVX = (registers[2] & (1u << 28)) != 0;
+		const bool bFMA = (registers[2] & (1u << 12)) != 0;
+		if (!bSSE2)
+		{
+			return SimdLevel::Scalar;
+		}
+		if (!bOSXSave || !bAVX || !bFMA || maxLeaf < 7)
+		{
+			return SimdLevel::SSE2;
+		}
+
+		const uint64_t state = GetEnabledRegisterState();
+		Cpuid(7, 0, registers);
+		const bool bAVX2 = (registers[1] & (1u << 5)) != 0;
+		const bool bAVX512F = (registers[1] & (1u << 16)) != 0;
+		if (!bAVX2 || (state & StateAVX) != StateAVX)
+		{
+			return SimdLevel::SSE2;
+		}
+		if (!bAVX512F || (state & StateAVX512) != StateAVX512)
+		{
+			return SimdLevel::AVX2;
+		}
+		return SimdLevel::AVX512;
+#elif ENGINE_SIMD_SSE2
+		return SimdLevel::SSE2;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+}
+
+SimdLevel GetSupportedSimdLevel()
+{
+	static const SimdLevel s_level = DetectSimdLevel();
+	return s_level;
+}
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::SSE2:	return "SSE2";
+	case SimdLevel::AVX2:	return "AVX2";
+	case SimdLevel::AVX512:	return "AVX-512";
+	default:				return "Scalar";
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// SIMD availability. SSE2 is the x64 baseline and is used wherever it is present, other targets take the scalar paths
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define ENGINE_SIMD_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define ENGINE_SIMD_SSE2 0
+#endif
+
+#include <cstdint>
+
+// Wider instruction sets are only used by kernels built with their own compiler flags and picked at runtime
+enum class SimdLevel : uint8_t
+{
+	Scalar,
+	SSE2,
+	AVX2,		// Includes FMA
+	AVX512,		// AVX-512F
+};
+
+// Highest level supported by both the CPU and the OS, detected once
+SimdLevel GetSupportedSimdLevel();
+const char* GetSimdLevelName(SimdLevel level);
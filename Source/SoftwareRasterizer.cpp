@@ -0,0 +1,856 @@
+#include "SoftwareRasterizer.h"
+#include "Profiler.h"
+#include "Simd.h"
+#include "Upscale.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+
+namespace
+{
+	enum : int32_t
+	{
+		SubpixelScale = 1 << SoftwareRasterizer::SubpixelBits,
+		HalfPixel = SubpixelScale / 2,
+		// Clamp for edge values at a tile corner, beyond it the sign cannot change within the tile
+		EdgeClamp = 1 << 30,
+	};
+
+	enum : uint32_t
+	{
+		VertexBatchSize = 1024,
+		MaxClipVertices = 3 + 7,
+	};
+
+	enum InterpolantPlane
+	{
+		PlaneColorR,
+		PlaneColorG,
+		PlaneColorB,
+		PlaneColorA,
+		PlaneInvW,
+		PlaneDepth,
+		NumPlanes,
+	};
+
+	// Shader.hlsl
+	void VSMain(const Float4* pInputs, SoftwareVaryings& output)
+	{
+		output.position = { pInputs[0].x, pInputs[0].y, pInputs[0].z, 1.0f };
+		output.color = pInputs[1];
+	}
+
+	void PSMain(const SoftwarePixelGroup& input, float (&outColor)[4][4])
+	{
+		memcpy(outColor, input.color, sizeof(outColor));
+	}
+
+	bool IsSameSemantic(const char* pA, const char* pB)
+	{
+		// HLSL semantics are case insensitive
+		for (; *pA && *pB; pA++, pB++)
+		{
+			if (std::tolower(uint8_t(*pA)) != std::tolower(uint8_t(*pB)))
+			{
+				return false;
+			}
+		}
+		return *pA == *pB;
+	}
+
+	Float4 DecodeVertexElement(const uint8_t* pData, RHIFormat format)
+	{
+		Float4 value = { 0.0f, 0.0f, 0.0f, 1.0f };
+		switch (format)
+		{
+		case RHIFormat::R32_FLOAT:
+		case RHIFormat::D32_FLOAT:			memcpy(&value.x, pData, 4); break;
+		case RHIFormat::R32G32_FLOAT:		memcpy(&value.x, pData, 8); break;
+		case RHIFormat::R32G32B32_FLOAT:	memcpy(&value.x, pData, 12); break;
+		case RHIFormat::R32G32B32A32_FLOAT:	memcpy(&value.x, pData, 16); break;
+		case RHIFormat::R8G8B8A8_UNORM:
+		{
+			ColorRGBA8 color;
+			memcpy(&color, pData, sizeof(color));
+			value = UnpackColorRGBA8(color);
+			break;
+		}
+		case RHIFormat::R16G16B16A16_FLOAT:
+		{
+			uint16_t halves[4];
+			memcpy(halves, pData, sizeof(halves));
+			value = { HalfToFloat(halves[0]), HalfToFloat(halves[1]), HalfToFloat(halves[2]), HalfToFloat(halves[3]) };
+			break;
+		}
+		case RHIFormat::R16G16_FLOAT:
+		{
+			uint16_t halves[2];
+			memcpy(halves, pData, sizeof(halves));
+			value.x = HalfToFloat(halves[0]);
+			value.y = HalfToFloat(halves[1]);
+			break;
+		}
+		case RHIFormat::R16G16_SNORM:
+		{
+			int16_t snorms[2];
+			memcpy(snorms, pData, sizeof(snorms));
+			value.x = std::max(float(snorms[0]) / 32767.0f, -1.0f);
+			value.y = std::max(float(snorms[1]) / 32767.0f, -1.0f);
+			break;
+		}
+		default:
+			break;
+		}
+		return value;
+	}
+
+	SoftwareVaryings LerpVaryings(const SoftwareVaryings& a, const SoftwareVaryings& b, float t)
+	{
+		auto lerp = [t](const Float4& x, const Float4& y) -> Float4
+		{
+			return { x.x + (y.x - x.x) * t, x.y + (y.y - x.y) * t, x.z + (y.z - x.z) * t, x.w + (y.w - x.w) * t };
+		};
+		return { lerp(a.position, b.position), lerp(a.color, b.color) };
+	}
+
+	RHIRect IntersectRects(const RHIRect& a, const RHIRect& b)
+	{
+		return { std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right), std::min(a.bottom, b.bottom) };
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer(JobSystem* pJobSystem)
+	: m_pJobSystem(pJobSystem)
+{
+	SoftwareVertexShader vertexShader;
+	vertexShader.inputs = { { "POSITION", 0 }, { "COLOR", 0 } };
+	vertexShader.function = VSMain;
+	RegisterVertexShader(L"Shader.hlsl", "VSMain", vertexShader);
+	RegisterPixelShader(L"Shader.hlsl", "PSMain", PSMain);
+}
+
+void SoftwareRasterizer::RegisterVertexShader(const std::wstring& fileName, const std::string& entryPoint, const SoftwareVertexShader& shader)
+{
+	m_vertexShaders[{ fileName, entryPoint }] = shader;
+}
+
+void SoftwareRasterizer::RegisterPixelShader(const std::wstring& fileName, const std::string& entryPoint, SoftwarePixelShader shader)
+{
+	m_pixelShaders[{ fileName, entryPoint }] = shader;
+}
+
+void SoftwareRasterizer::Execute(const NullCommandStream& stream)
+{
+	PROFILE_SCOPE("SoftwareRasterizer::Execute");
+	const auto startTime = std::chrono::steady_clock::now();
+
+	// Command lists do not inherit state
+	m_state = {};
+	m_program = {};
+	stream.ForEach([&](const NullCommandHeader& header, const void* pPayload)
+	{
+		switch (header.type)
+		{
+		case NullCommandType::SetPipelineState:
+			SetPipelineState(static_cast<const NullCmdSetPipelineState*>(pPayload)->pPipelineState);
+			break;
+		case NullCommandType::SetViewport:
+			m_state.viewport = static_cast<const NullCmdSetViewport*>(pPayload)->viewport;
+			break;
+		case NullCommandType::SetScissorRect:
+			m_state.scissorRect = static_cast<const NullCmdSetScissorRect*>(pPayload)->rect;
+			break;
+		case NullCommandType::ResourceBarrier:
+		{
+			// Pending output has to land before the target is used as anything else
+			const NullCmdResourceBarrier* pCmd = static_cast<const NullCmdResourceBarrier*>(pPayload);
+			const RHIResourceBarrier* pBarriers = reinterpret_cast<const RHIResourceBarrier*>(pCmd + 1);
+			for (uint32_t i = 0; i < pCmd->numBarriers; i++)
+			{
+				if (pBarriers[i].pResource == m_pPendingTarget || pBarriers[i].pResourceBefore == m_pPendingTarget)
+				{
+					Flush();
+				}
+			}
+			break;
+		}
+		case NullCommandType::SetRenderTarget:
+			m_state.pRenderTarget = static_cast<NullResource*>(static_cast<const NullCmdSetRenderTarget*>(pPayload)->pRenderTarget);
+			break;
+		case NullCommandType::ClearRenderTarget:
+		{
+			const NullCmdClearRenderTarget* pCmd = static_cast<const NullCmdClearRenderTarget*>(pPayload);
+			ClearRenderTarget(static_cast<NullResource*>(pCmd->pRenderTarget), pCmd->color);
+			break;
+		}
+		case NullCommandType::SetVertexBuffer:
+		{
+			const NullCmdSetVertexBuffer* pCmd = static_cast<const NullCmdSetVertexBuffer*>(pPayload);
+			if (pCmd->slot < MaxVertexBuffers)
+			{
+				m_state.vertexBuffers[pCmd->slot] = pCmd->view;
+			}
+			break;
+		}
+		case NullCommandType::DrawInstanced:
+			Draw(*static_cast<const NullCmdDrawInstanced*>(pPayload));
+			break;
+		case NullCommandType::UpscaleTexture:
+			UpscaleTexture(*static_cast<const NullCmdUpscaleTexture*>(pPayload));
+			break;
+		default:
+			break;
+		}
+	});
+	Flush();
+
+	m_statistics.rasterSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void SoftwareRasterizer::SetPipelineState(RHIPipelineState* pPipelineState)
+{
+	m_state.pPipelineState = pPipelineState;
+	m_program = {};
+	if (pPipelineState == nullptr)
+	{
+		return;
+	}
+
+	const RHIGraphicsPipelineDesc& desc = pPipelineState->GetDesc();
+	auto vertexShader = m_vertexShaders.find({ desc.vertexShader.fileName, desc.vertexShader.entryPoint });
+	auto pixelShader = m_pixelShaders.find({ desc.pixelShader.fileName, desc.pixelShader.entryPoint });
+	if (vertexShader == m_vertexShaders.end() || pixelShader == m_pixelShaders.end())
+	{
+		return;
+	}
+	m_program.pVertexShader = &vertexShader->second;
+	m_program.pixelShader = pixelShader->second;
+
+	// Resolve appended offsets per slot, then bind the shader inputs by semantic
+	std::vector<uint32_t> offsets(desc.inputLayout.size());
+	uint32_t slotOffsets[MaxVertexBuffers] = {};
+	for (size_t i = 0; i < desc.inputLayout.size(); i++)
+	{
+		const RHIInputElementDesc& element = desc.inputLayout[i];
+		const uint32_t slot = std::min(element.inputSlot, uint32_t(std::size(slotOffsets) - 1));
+		offsets[i] = element.alignedByteOffset == RHIAppendAlignedElement ? slotOffsets[slot] : element.alignedByteOffset;
+		slotOffsets[slot] = offsets[i] + GetFormatSize(element.format);
+	}
+	for (const SoftwareShaderInput& input : m_program.pVertexShader->inputs)
+	{
+		InputBinding binding = { 0, 0, RHIFormat::Unknown, false };
+		for (size_t i = 0; i < desc.inputLayout.size(); i++)
+		{
+			const RHIInputElementDesc& element = desc.inputLayout[i];
+			if (element.semanticIndex == input.semanticIndex && IsSameSemantic(element.semanticName, input.semanticName))
+			{
+				binding = { element.inputSlot, offsets[i], element.format, element.inputSlot < MaxVertexBuffers };
+				break;
+			}
+		}
+		m_program.bindings.push_back(binding);
+	}
+}
+
+void SoftwareRasterizer::SetPendingTarget(NullResource* pRenderTarget)
+{
+	if (m_pPendingTarget != nullptr && m_pPendingTarget != pRenderTarget)
+	{
+		Flush();
+	}
+	m_pPendingTarget = pRenderTarget;
+	const RHIResourceDesc& desc = pRenderTarget->GetDesc();
+	m_numTilesX = (uint32_t(desc.width) + TileSize - 1) / TileSize;
+	m_numTilesY = (desc.height + TileSize - 1) / TileSize;
+}
+
+void SoftwareRasterizer::ClearRenderTarget(NullResource* pRenderTarget, const float color[4])
+{
+	if (pRenderTarget == nullptr || pRenderTarget->GetDesc().format != RHIFormat::R8G8B8A8_UNORM)
+	{
+		return;
+	}
+	// Triangles before the clear are overwritten, but still run so the statistics stay honest
+	if (m_numPendingBatches > 0)
+	{
+		Flush();
+	}
+	SetPendingTarget(pRenderTarget);
+	m_bPendingClear = true;
+	m_pendingClearColor = PackColorRGBA8({ color[0], color[1], color[2], color[3] }).rgba;
+}
+
+void SoftwareRasterizer::UpscaleTexture(const NullCmdUpscaleTexture& upscale)
+{
+	NullResource* pDest = static_cast<NullResource*>(upscale.pDest);
+	NullResource* pSource = static_cast<NullResource*>(upscale.pSource);
+	if (pDest->GetDesc().format != RHIFormat::R8G8B8A8_UNORM || pSource->GetDesc().format != RHIFormat::R8G8B8A8_UNORM)
+	{
+		return;
+	}
+	// Barriers already flushed the source, earlier output to the destination lands first
+	if (m_pPendingTarget == pDest || m_pPendingTarget == pSource)
+	{
+		Flush();
+	}
+
+	// Rectangles outside of the resources are invalid, like on the GPU nothing defined comes out
+	auto isInside = [](const RHIRect& rect, const RHIResourceDesc& desc)
+	{
+		return rect.left >= 0 && rect.top >= 0 && rect.right <= int32_t(desc.width) && rect.bottom <= int32_t(desc.height) &&
+			rect.left < rect.right && rect.top < rect.bottom;
+	};
+	const RHIRect& sourceRect = upscale.sourceRect;
+	const RHIRect& destRect = upscale.destRect;
+	if (!isInside(sourceRect, pSource->GetDesc()) || !isInside(destRect, pDest->GetDesc()))
+	{
+		return;
+	}
+	UpscaleRGBA8(pSource->GetData(), pSource->GetRowPitch(), sourceRect, pDest->GetData(), pDest->GetRowPitch(), destRect, upscale.filter, m_pJobSystem);
+	m_statistics.numUpscaledPixels += uint64_t(destRect.right - destRect.left) * uint64_t(destRect.bottom - destRect.top);
+}
+
+void SoftwareRasterizer::Draw(const NullCmdDrawInstanced& draw)
+{
+	m_statistics.numDraws++;
+	NullResource* pRenderTarget = m_state.pRenderTarget;
+	if (m_program.pVertexShader == nullptr || pRenderTarget == nullptr || pRenderTarget->GetDesc().format != RHIFormat::R8G8B8A8_UNORM ||
+		pRenderTarget->GetDesc().width > MaxRenderTargetSize || pRenderTarget->GetDesc().height > MaxRenderTargetSize ||
+		m_state.pPipelineState->GetDesc().topology != RHIPrimitiveTopology::TriangleList)
+	{
+		m_statistics.numSkippedDraws++;
+		return;
+	}
+
+	const uint32_t numTriangles = draw.vertexCountPerInstance / 3;
+	m_statistics.numTriangles += uint64_t(numTriangles) * draw.instanceCount;
+
+	// Like D3D12 the scissor test is always on
+	const RHIViewport& viewport = m_state.viewport;
+	const RHIRect viewportRect = { int32_t(std::floor(viewport.topLeftX)), int32_t(std::floor(viewport.topLeftY)),
+		int32_t(std::ceil(viewport.topLeftX + viewport.width)), int32_t(std::ceil(viewport.topLeftY + viewport.height)) };
+	const RHIRect targetRect = { 0, 0, int32_t(pRenderTarget->GetDesc().width), int32_t(pRenderTarget->GetDesc().height) };
+	m_drawBounds = IntersectRects(IntersectRects(viewportRect, m_state.scissorRect), targetRect);
+	if (numTriangles == 0 || draw.instanceCount == 0 || m_drawBounds.left >= m_drawBounds.right || m_drawBounds.top >= m_drawBounds.bottom)
+	{
+		return;
+	}
+	SetPendingTarget(pRenderTarget);
+
+	// Input assembly and vertex shader, there is no per instance data so every instance shades the same vertices
+	const uint32_t numVertices = numTriangles * 3;
+	m_vertices.resize(numVertices);
+	{
+		JobCounter counter;
+		auto shadeVertices = [&](uint32_t begin, uint32_t end)
+		{
+			Float4 inputs[16];
+			const size_t numInputs = std::min(m_program.bindings.size(), std::size(inputs));
+			for (uint32_t vertex = begin; vertex < end; vertex++)
+			{
+				for (size_t i = 0; i < numInputs; i++)
+				{
+					const InputBinding& binding = m_program.bindings[i];
+					inputs[i] = { 0.0f, 0.0f, 0.0f, 1.0f };
+					if (!binding.bBound)
+					{
+						continue;
+					}
+					// Out of bounds reads return 0
+					const RHIVertexBufferView& view = m_state.vertexBuffers[binding.slot];
+					const uint64_t byteOffset = uint64_t(draw.startVertex + vertex) * view.strideInBytes + binding.offset;
+					if (view.bufferLocation == 0 || byteOffset + GetFormatSize(binding.format) > view.sizeInBytes)
+					{
+						inputs[i] = {};
+						continue;
+					}
+					inputs[i] = DecodeVertexElement(reinterpret_cast<const uint8_t*>(view.bufferLocation) + byteOffset, binding.format);
+				}
+				m_program.pVertexShader->function(inputs, m_vertices[vertex]);
+			}
+		};
+		m_pJobSystem->ParallelFor(numVertices, VertexBatchSize, shadeVertices, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+
+	// Triangle setup and binning, one job per batch
+	const uint32_t numBatches = (numTriangles + TriangleBatchSize - 1) / TriangleBatchSize;
+	for (uint32_t instance = 0; instance < draw.instanceCount; instance++)
+	{
+		for (uint32_t firstBatch = 0; firstBatch < numBatches; )
+		{
+			if (m_numPendingBatches >= MaxPendingBatches)
+			{
+				Flush();
+				SetPendingTarget(pRenderTarget);
+			}
+			const uint32_t numNewBatches = std::min(numBatches - firstBatch, uint32_t(MaxPendingBatches - m_numPendingBatches));
+			while (m_batches.size() < m_numPendingBatches + numNewBatches)
+			{
+				m_batches.push_back(std::make_unique<TriangleBatch>());
+			}
+
+			JobCounter counter;
+			const size_t batchBase = m_numPendingBatches;
+			auto setup = [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					TriangleBatch& batch = *m_batches[batchBase + i];
+					const uint32_t firstTriangle = (firstBatch + i) * TriangleBatchSize;
+					SetupTriangles(batch, firstTriangle, std::min(uint32_t(TriangleBatchSize), numTriangles - firstTriangle));
+					BinBatch(batch);
+				}
+			};
+			m_pJobSystem->ParallelFor(numNewBatches, 1, setup, &counter);
+			m_pJobSystem->Wait(&counter);
+
+			for (uint32_t i = 0; i < numNewBatches; i++)
+			{
+				m_statistics.numRasterizedTriangles += m_batches[batchBase + i]->triangles.size();
+			}
+			m_numPendingBatches += numNewBatches;
+			firstBatch += numNewBatches;
+		}
+	}
+}
+
+void SoftwareRasterizer::SetupTriangles(TriangleBatch& batch, uint32_t firstTriangle, uint32_t numTriangles)
+{
+	batch.triangles.clear();
+	batch.clipVertices.resize(MaxClipVertices * 2);
+
+	// Homogeneous clip planes: near, far, w > 0 and the guard band. Beyond the guard band the fixed point
+	// coordinates would overflow, within it the scissor rectangle does the clipping
+	const RHIViewport& viewport = m_state.viewport;
+	const float guardX = 1.0f + 2.0f * float(GuardBandPixels) / std::max(viewport.width, 1.0f);
+	const float guardY = 1.0f + 2.0f * float(GuardBandPixels) / std::max(viewport.height, 1.0f);
+	auto planeDistance = [&](const Float4& p, uint32_t plane) -> float
+	{
+		switch (plane)
+		{
+		case 0:		return p.z;
+		case 1:		return p.w - p.z;
+		case 2:		return p.w - 1e-6f;
+		case 3:		return guardX * p.w + p.x;
+		case 4:		return guardX * p.w - p.x;
+		case 5:		return guardY * p.w + p.y;
+		default:	return guardY * p.w - p.y;
+		}
+	};
+	const uint32_t numClipPlanes = 7;
+
+	for (uint32_t triangle = firstTriangle; triangle < firstTriangle + numTriangles; triangle++)
+	{
+		const SoftwareVaryings* pVertices = &m_vertices[size_t(triangle) * 3];
+		uint32_t outsideAll = 0x7f;
+		uint32_t outsideAny = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			uint32_t outside = 0;
+			for (uint32_t plane = 0; plane < numClipPlanes; plane++)
+			{
+				outside |= uint32_t(planeDistance(pVertices[i].position, plane) < 0.0f) << plane;
+			}
+			outsideAll &= outside;
+			outsideAny |= outside;
+		}
+		if (outsideAll != 0)
+		{
+			continue;
+		}
+		if (outsideAny == 0)
+		{
+			EmitTriangle(batch, pVertices[0], pVertices[1], pVertices[2]);
+			continue;
+		}
+
+		// Sutherland-Hodgman against the planes the triangle crosses, then fan the polygon
+		SoftwareVaryings* pInput = &batch.clipVertices[0];
+		SoftwareVaryings* pOutput = &batch.clipVertices[MaxClipVertices];
+		uint32_t numInput = 3;
+		std::copy_n(pVertices, 3, pInput);
+		for (uint32_t plane = 0; plane < numClipPlanes && numInput >= 3; plane++)
+		{
+			if ((outsideAny & (1u << plane)) == 0)
+			{
+				continue;
+			}
+			uint32_t numOutput = 0;
+			for (uint32_t i = 0; i < numInput; i++)
+			{
+				const SoftwareVaryings& current = pInput[i];
+				const SoftwareVaryings& next = pInput[(i + 1) % numInput];
+				const float currentDistance = planeDistance(current.position, plane);
+				const float nextDistance = planeDistance(next.position, plane);
+				if (currentDistance >= 0.0f)
+				{
+					pOutput[numOutput++] = current;
+				}
+				if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+				{
+					pOutput[numOutput++] = LerpVaryings(current, next, currentDistance / (currentDistance - nextDistance));
+				}
+			}
+			std::swap(pInput, pOutput);
+			numInput = numOutput;
+		}
+		for (uint32_t i = 2; i < numInput; i++)
+		{
+			EmitTriangle(batch, pInput[0], pInput[i - 1], pInput[i]);
+		}
+	}
+}
+
+void SoftwareRasterizer::EmitTriangle(TriangleBatch& batch, const SoftwareVaryings& v0, const SoftwareVaryings& v1, const SoftwareVaryings& v2)
+{
+	const RHIViewport& viewport = m_state.viewport;
+	const SoftwareVaryings* pVertices[3] = { &v0, &v1, &v2 };
+	int32_t x[3], y[3];
+	float screenX[3], screenY[3], invW[3], depth[3];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const Float4& position = pVertices[i]->position;
+		invW[i] = 1.0f / position.w;
+		const float sx = viewport.topLeftX + (position.x * invW[i] + 1.0f) * 0.5f * viewport.width;
+		const float sy = viewport.topLeftY + (1.0f - position.y * invW[i]) * 0.5f * viewport.height;
+		depth[i] = viewport.minDepth + position.z * invW[i] * (viewport.maxDepth - viewport.minDepth);
+		x[i] = int32_t(std::lrint(sx * float(SubpixelScale)));
+		y[i] = int32_t(std::lrint(sy * float(SubpixelScale)));
+		screenX[i] = float(x[i]) / float(SubpixelScale);
+		screenY[i] = float(y[i]) / float(SubpixelScale);
+	}
+
+	// Clockwise on screen is front facing, counter-clockwise and degenerate triangles are culled
+	const int64_t area = int64_t(x[1] - x[0]) * (y[2] - y[0]) - int64_t(x[2] - x[0]) * (y[1] - y[0]);
+	if (area <= 0)
+	{
+		return;
+	}
+
+	Triangle triangle;
+	triangle.minX = std::max(std::min({ x[0], x[1], x[2] }) >> SubpixelBits, m_drawBounds.left);
+	triangle.minY = std::max(std::min({ y[0], y[1], y[2] }) >> SubpixelBits, m_drawBounds.top);
+	triangle.maxX = std::min((std::max({ x[0], x[1], x[2] }) >> SubpixelBits) + 1, m_drawBounds.right);
+	triangle.maxY = std::min((std::max({ y[0], y[1], y[2] }) >> SubpixelBits) + 1, m_drawBounds.bottom);
+	if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const uint32_t j = (i + 1) % 3;
+		const int32_t a = y[i] - y[j];
+		const int32_t b = x[j] - x[i];
+		// Top-left rule: pixels exactly on an edge belong to top and left edges only
+		const bool bTopLeft = a > 0 || (a == 0 && b > 0);
+		triangle.edgeA[i] = a;
+		triangle.edgeB[i] = b;
+		triangle.edgeC[i] = -(int64_t(a) * x[i] + int64_t(b) * y[i]) - (bTopLeft ? 0 : 1);
+	}
+
+	// Attribute planes in screen space, color / w and 1 / w for perspective correction, z is linear already
+	const float areaF = (screenX[1] - screenX[0]) * (screenY[2] - screenY[0]) - (screenX[2] - screenX[0]) * (screenY[1] - screenY[0]);
+	const float invArea = 1.0f / areaF;
+	triangle.originX = screenX[0];
+	triangle.originY = screenY[0];
+	for (uint32_t plane = 0; plane < NumPlanes; plane++)
+	{
+		float values[3];
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const Float4& color = pVertices[i]->color;
+			switch (plane)
+			{
+			case PlaneColorR:	values[i] = color.x * invW[i]; break;
+			case PlaneColorG:	values[i] = color.y * invW[i]; break;
+			case PlaneColorB:	values[i] = color.z * invW[i]; break;
+			case PlaneColorA:	values[i] = color.w * invW[i]; break;
+			case PlaneInvW:		values[i] = invW[i]; break;
+			default:			values[i] = depth[i]; break;
+			}
+		}
+		const float d1 = values[1] - values[0];
+		const float d2 = values[2] - values[0];
+		triangle.planes[plane][0] = values[0];
+		triangle.planes[plane][1] = (d1 * (screenY[2] - screenY[0]) - d2 * (screenY[1] - screenY[0])) * invArea;
+		triangle.planes[plane][2] = (d2 * (screenX[1] - screenX[0]) - d1 * (screenX[2] - screenX[0])) * invArea;
+	}
+	batch.triangles.push_back(triangle);
+}
+
+void SoftwareRasterizer::BinBatch(TriangleBatch& batch)
+{
+	// Counting sort of (tile, triangle) pairs, triangles stay in submission order within a tile
+	const uint32_t numTiles = m_numTilesX * m_numTilesY;
+	batch.tileOffsets.assign(numTiles + 1, 0);
+	for (const Triangle& triangle : batch.triangles)
+	{
+		for (int32_t tileY = triangle.minY / TileSize; tileY <= (triangle.maxY - 1) / TileSize; tileY++)
+		{
+			for (int32_t tileX = triangle.minX / TileSize; tileX <= (triangle.maxX - 1) / TileSize; tileX++)
+			{
+				batch.tileOffsets[tileY * m_numTilesX + tileX + 1]++;
+			}
+		}
+	}
+	for (uint32_t tile = 0; tile < numTiles; tile++)
+	{
+		batch.tileOffsets[tile + 1] += batch.tileOffsets[tile];
+	}
+	batch.tileTriangles.resize(batch.tileOffsets[numTiles]);
+	batch.tileCursors.assign(batch.tileOffsets.begin(), batch.tileOffsets.end() - 1);
+	for (uint32_t index = 0; index < batch.triangles.size(); index++)
+	{
+		const Triangle& triangle = batch.triangles[index];
+		for (int32_t tileY = triangle.minY / TileSize; tileY <= (triangle.maxY - 1) / TileSize; tileY++)
+		{
+			for (int32_t tileX = triangle.minX / TileSize; tileX <= (triangle.maxX - 1) / TileSize; tileX++)
+			{
+				batch.tileTriangles[batch.tileCursors[tileY * m_numTilesX + tileX]++] = index;
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::Flush()
+{
+	if (m_pPendingTarget == nullptr || (m_numPendingBatches == 0 && !m_bPendingClear))
+	{
+		m_pPendingTarget = nullptr;
+		return;
+	}
+
+	const uint32_t numTiles = m_numTilesX * m_numTilesY;
+	m_tilePixels.assign(numTiles, 0);
+	{
+		JobCounter counter;
+		auto rasterizeTiles = [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t tile = begin; tile < end; tile++)
+			{
+				RasterizeTile(tile);
+			}
+		};
+		m_pJobSystem->ParallelFor(numTiles, 1, rasterizeTiles, &counter);
+		m_pJobSystem->Wait(&counter);
+	}
+	for (uint64_t numPixels : m_tilePixels)
+	{
+		m_statistics.numPixels += numPixels;
+	}
+
+	m_numPendingBatches = 0;
+	m_pPendingTarget = nullptr;
+	m_bPendingClear = false;
+}
+
+void SoftwareRasterizer::RasterizeTile(uint32_t tile)
+{
+	bool bHasTriangles = false;
+	for (size_t i = 0; i < m_numPendingBatches && !bHasTriangles; i++)
+	{
+		bHasTriangles = m_batches[i]->tileOffsets[tile] != m_batches[i]->tileOffsets[tile + 1];
+	}
+	if (!bHasTriangles && !m_bPendingClear)
+	{
+		return;
+	}
+
+	// The tile is shaded in a local buffer, the render target is touched once on the way in and out
+	const int32_t tileX = int32_t(tile % m_numTilesX) * TileSize;
+	const int32_t tileY = int32_t(tile / m_numTilesX) * TileSize;
+	const uint32_t width = std::min(uint32_t(TileSize), uint32_t(m_pPendingTarget->GetDesc().width) - tileX);
+	const uint32_t height = std::min(uint32_t(TileSize), m_pPendingTarget->GetDesc().height - tileY);
+	const uint32_t rowPitch = m_pPendingTarget->GetRowPitch();
+	uint8_t* pTarget = m_pPendingTarget->GetData() + size_t(tileY) * rowPitch + size_t(tileX) * sizeof(uint32_t);
+
+	alignas(16) uint32_t pixels[TileSize * TileSize];
+	if (m_bPendingClear)
+	{
+		std::fill_n(pixels, TileSize * TileSize, m_pendingClearColor);
+	}
+	else
+	{
+		for (uint32_t row = 0; row < height; row++)
+		{
+			memcpy(&pixels[row * TileSize], pTarget + size_t(row) * rowPitch, width * sizeof(uint32_t));
+		}
+	}
+
+	uint64_t numPixels = 0;
+	for (size_t i = 0; i < m_numPendingBatches; i++)
+	{
+		const TriangleBatch& batch = *m_batches[i];
+		for (uint32_t index = batch.tileOffsets[tile]; index < batch.tileOffsets[tile + 1]; index++)
+		{
+			numPixels += RasterizeTriangle(batch.triangles[batch.tileTriangles[index]], tileX, tileY, pixels);
+		}
+	}
+	m_tilePixels[tile] = numPixels;
+
+	for (uint32_t row = 0; row < height; row++)
+	{
+		memcpy(pTarget + size_t(row) * rowPitch, &pixels[row * TileSize], width * sizeof(uint32_t));
+	}
+}
+
+uint64_t SoftwareRasterizer::RasterizeTriangle(const Triangle& triangle, int32_t tileX, int32_t tileY, uint32_t* pTile)
+{
+	const int32_t minX = std::max(triangle.minX, tileX);
+	const int32_t maxX = std::min(triangle.maxX, tileX + int32_t(TileSize));
+	const int32_t minY = std::max(triangle.minY, tileY);
+	const int32_t maxY = std::min(triangle.maxY, tileY + int32_t(TileSize));
+	if (minX >= maxX || minY >= maxY)
+	{
+		return 0;
+	}
+	// Groups of 4 pixels start at multiples of 4, tiles are aligned to them
+	const int32_t startX = minX & ~3;
+
+	// Edge values at the first pixel center, clamped so the per pixel steps stay in 32 bits
+	int32_t edgeStart[3];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const int64_t value = int64_t(triangle.edgeA[i]) * (startX * SubpixelScale + HalfPixel) +
+			int64_t(triangle.edgeB[i]) * (minY * SubpixelScale + HalfPixel) + triangle.edgeC[i];
+		edgeStart[i] = int32_t(std::clamp<int64_t>(value, -EdgeClamp, EdgeClamp));
+	}
+
+	SoftwarePixelGroup input;
+	float outColor[4][4];
+	uint64_t numPixels = 0;
+	auto shade = [&](int32_t x, int32_t y, uint32_t coverage)
+	{
+		numPixels += std::popcount(coverage);
+		const float dy = float(y) + 0.5f - triangle.originY;
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			input.position[0][lane] = float(x + int32_t(lane)) + 0.5f;
+			input.position[1][lane] = float(y) + 0.5f;
+		}
+#if ENGINE_SIMD_SSE2
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(input.position[0]), _mm_set1_ps(triangle.originX));
+		auto plane = [&](uint32_t index)
+		{
+			const float* pPlane = triangle.planes[index];
+			return _mm_add_ps(_mm_set1_ps(pPlane[0] + pPlane[2] * dy), _mm_mul_ps(_mm_set1_ps(pPlane[1]), dx));
+		};
+		const __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), plane(PlaneInvW));
+		_mm_storeu_ps(input.position[2], plane(PlaneDepth));
+		_mm_storeu_ps(input.position[3], w);
+		for (uint32_t component = 0; component < 4; component++)
+		{
+			_mm_storeu_ps(input.color[component], _mm_mul_ps(plane(PlaneColorR + component), w));
+		}
+
+		m_program.pixelShader(input, outColor);
+
+		// Same conversion as PackColorsRGBA8(), NaN goes to 0
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(255.0f);
+		__m128i packed = _mm_setzero_si128();
+		for (uint32_t component = 0; component < 4; component++)
+		{
+			const __m128 value = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(outColor[component]), zero), one), scale);
+			packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvtps_epi32(value), int(component * 8)));
+		}
+		const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+		const __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(int32_t(coverage)), laneBits), laneBits);
+		__m128i* pPixels = reinterpret_cast<__m128i*>(&pTile[(y - tileY) * TileSize + (x - tileX)]);
+		_mm_store_si128(pPixels, _mm_or_si128(_mm_and_si128(mask, packed), _mm_andnot_si128(mask, _mm_load_si128(pPixels))));
+#else
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			const float dx = input.position[0][lane] - triangle.originX;
+			auto plane = [&](uint32_t index) { return triangle.planes[index][0] + triangle.planes[index][1] * dx + triangle.planes[index][2] * dy; };
+			const float w = 1.0f / plane(PlaneInvW);
+			input.position[2][lane] = plane(PlaneDepth);
+			input.position[3][lane] = w;
+			for (uint32_t component = 0; component < 4; component++)
+			{
+				input.color[component][lane] = plane(PlaneColorR + component) * w;
+			}
+		}
+
+		m_program.pixelShader(input, outColor);
+
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if (coverage & (1u << lane))
+			{
+				const Float4 color = { outColor[0][lane], outColor[1][lane], outColor[2][lane], outColor[3][lane] };
+				pTile[(y - tileY) * TileSize + (x - tileX) + lane] = PackColorRGBA8(color).rgba;
+			}
+		}
+#endif
+	};
+
+#if ENGINE_SIMD_SSE2
+	// Edge values of 4 adjacent pixels, a lane is covered when no edge is negative
+	__m128i rowEdges[3];
+	__m128i stepX[3];
+	__m128i stepY[3];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const int32_t a = triangle.edgeA[i] * SubpixelScale;
+		rowEdges[i] = _mm_add_epi32(_mm_set1_epi32(edgeStart[i]), _mm_set_epi32(3 * a, 2 * a, a, 0));
+		stepX[i] = _mm_set1_epi32(4 * a);
+		stepY[i] = _mm_set1_epi32(triangle.edgeB[i] * SubpixelScale);
+	}
+	const __m128i laneOffsets = _mm_set_epi32(3, 2, 1, 0);
+	for (int32_t y = minY; y < maxY; y++)
+	{
+		__m128i edges[3] = { rowEdges[0], rowEdges[1], rowEdges[2] };
+		for (int32_t x = startX; x < maxX; x += 4)
+		{
+			// Lanes left of minX or right of maxX belong to other triangles or the scissor
+			const __m128i laneX = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+			const __m128i bOutside = _mm_or_si128(_mm_cmplt_epi32(laneX, _mm_set1_epi32(minX)), _mm_cmpgt_epi32(laneX, _mm_set1_epi32(maxX - 1)));
+			const __m128i negative = _mm_or_si128(_mm_or_si128(edges[0], edges[1]), _mm_or_si128(edges[2], bOutside));
+			const uint32_t coverage = ~uint32_t(_mm_movemask_ps(_mm_castsi128_ps(negative))) & 0xf;
+			if (coverage != 0)
+			{
+				shade(x, y, coverage);
+			}
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				edges[i] = _mm_add_epi32(edges[i], stepX[i]);
+			}
+		}
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			rowEdges[i] = _mm_add_epi32(rowEdges[i], stepY[i]);
+		}
+	}
+#else
+	for (int32_t y = minY; y < maxY; y++)
+	{
+		const int32_t row = y - minY;
+		for (int32_t x = startX; x < maxX; x += 4)
+		{
+			uint32_t coverage = 0;
+			for (int32_t lane = 0; lane < 4; lane++)
+			{
+				const int32_t column = x + lane - startX;
+				bool bInside = x + lane >= minX && x + lane < maxX;
+				for (uint32_t i = 0; i < 3 && bInside; i++)
+				{
+					bInside = edgeStart[i] + triangle.edgeA[i] * SubpixelScale * column + triangle.edgeB[i] * SubpixelScale * row >= 0;
+				}
+				coverage |= uint32_t(bInside) << lane;
+			}
+			if (coverage != 0)
+			{
+				shade(x, y, coverage);
+			}
+		}
+	}
+#endif
+	return numPixels;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+// CPU rasterizer, executes Null RHI command streams
+// Runs the same pipeline as the GPU for the shaders it knows: input assembly from the vertex buffer views and the
+// pipeline's input layout, a C++ port of the vertex shader, clipping in homogeneous space, half-space rasterization
+// with a 4 bit sub-pixel grid and the top-left fill rule, perspective correct interpolation of PSInput and a C++ port
+// of the pixel shader. Rasterizer state matches the D3D12 defaults the D3D12 backend uses: back face culling of
+// counter-clockwise triangles, no blending, no depth test.
+//
+// Draws are set up in parallel batches of triangles, binned into screen tiles and the tiles are rasterized on the
+// JobSystem, each tile walks the batches in submission order. Edge functions are evaluated 4 pixels at a time.
+// UpscaleTexture() runs the CPU reference of the upscale shader, see Upscale.h.
+
+#include "NullRHI.h"
+#include "EngineMath.h"
+#include "JobSystem.h"
+
+#include <map>
+
+// PSInput of Shader.hlsl, output of the vertex shader
+struct SoftwareVaryings
+{
+	Float4 position;	// Clip space
+	Float4 color;
+};
+
+// 4 horizontally adjacent pixels, [component][lane]. Lanes outside of the triangle are shaded and discarded
+struct SoftwarePixelGroup
+{
+	float position[4][4];	// Pixel center, depth and w like SV_POSITION
+	float color[4][4];
+};
+
+struct SoftwareShaderInput
+{
+	const char*	semanticName;
+	uint32_t	semanticIndex;
+};
+
+struct SoftwareVertexShader
+{
+	// Matched against the pipeline's input layout, pInputs follow this order. Missing components read as (0, 0, 0, 1)
+	std::vector<SoftwareShaderInput> inputs;
+	void (*function)(const Float4* pInputs, SoftwareVaryings& output) = nullptr;
+};
+
+using SoftwarePixelShader = void (*)(const SoftwarePixelGroup& input, float (&outColor)[4][4]);
+
+struct SoftwareRasterizerStatistics
+{
+	uint64_t	numDraws = 0;
+	uint64_t	numSkippedDraws = 0;		// Unknown shaders or unsupported state
+	uint64_t	numTriangles = 0;			// Input primitives
+	uint64_t	numRasterizedTriangles = 0;	// After clipping and culling
+	uint64_t	numPixels = 0;				// Covered samples written
+	uint64_t	numUpscaledPixels = 0;		// Written by UpscaleTexture()
+	double		rasterSeconds = 0.0;		// Spent in Execute()
+};
+
+class SoftwareRasterizer : public NullCommandExecutor
+{
+public:
+	enum
+	{
+		TileSize = 64,
+		SubpixelBits = 4,
+		GuardBandPixels = 2048,
+		MaxRenderTargetSize = 6144,		// Fixed point coordinates plus guard band stay within 13 bits
+		TriangleBatchSize = 1024,
+		MaxPendingBatches = 256,		// Bounds the memory of binned triangles, flushes early beyond
+	};
+
+	// VSMain and PSMain of Shader.hlsl are registered by default
+	explicit SoftwareRasterizer(JobSystem* pJobSystem);
+
+	// Before executing streams that use them
+	void RegisterVertexShader(const std::wstring& fileName, const std::string& entryPoint, const SoftwareVertexShader& shader);
+	void RegisterPixelShader(const std::wstring& fileName, const std::string& entryPoint, SoftwarePixelShader shader);
+
+	void Execute(const NullCommandStream& stream) override;
+
+	// Only stable while the queue is idle
+	const SoftwareRasterizerStatistics& GetStatistics() const { return m_statistics; }
+	void ResetStatistics() { m_statistics = {}; }
+
+private:
+	enum { MaxVertexBuffers = 8 };
+
+	struct InputBinding
+	{
+		uint32_t	slot;
+		uint32_t	offset;
+		RHIFormat	format;
+		bool		bBound;
+	};
+
+	struct Program
+	{
+		const SoftwareVertexShader*	pVertexShader = nullptr;
+		SoftwarePixelShader			pixelShader = nullptr;
+		std::vector<InputBinding>	bindings;	// Per vertex shader input
+	};
+
+	// Screen space triangle ready for the tile loops
+	struct Triangle
+	{
+		int32_t		minX, minY, maxX, maxY;		// Pixel bounds, exclusive max, clipped to scissor and target
+		int32_t		edgeA[3];					// Edge i: A * x + B * y + C >= 0 inside, sub-pixel units
+		int32_t		edgeB[3];
+		int64_t		edgeC[3];					// Fill rule bias included
+		float		originX, originY;			// Planes are relative to vertex 0
+		float		planes[6][3];				// value, d/dx, d/dy of color / w, 1 / w, z
+	};
+
+	// Triangles of one batch and their tile bins, tileTriangles[tileOffsets[t], tileOffsets[t + 1])
+	struct TriangleBatch
+	{
+		std::vector<Triangle>		triangles;
+		std::vector<uint32_t>		tileOffsets;
+		std::vector<uint32_t>		tileTriangles;
+		std::vector<uint32_t>		tileCursors;
+		std::vector<SoftwareVaryings> clipVertices;	// Scratch
+	};
+
+	struct State
+	{
+		RHIPipelineState*		pPipelineState = nullptr;
+		RHIViewport				viewport = {};
+		RHIRect					scissorRect = {};
+		NullResource*			pRenderTarget = nullptr;
+		RHIVertexBufferView		vertexBuffers[MaxVertexBuffers] = {};
+	};
+
+	void SetPipelineState(RHIPipelineState* pPipelineState);
+	void SetPendingTarget(NullResource* pRenderTarget);
+	void Draw(const NullCmdDrawInstanced& draw);
+	void SetupTriangles(TriangleBatch& batch, uint32_t firstTriangle, uint32_t numTriangles);
+	void EmitTriangle(TriangleBatch& batch, const SoftwareVaryings& v0, const SoftwareVaryings& v1, const SoftwareVaryings& v2);
+	void BinBatch(TriangleBatch& batch);
+	void ClearRenderTarget(NullResource* pRenderTarget, const float color[4]);
+	void UpscaleTexture(const NullCmdUpscaleTexture& upscale);
+	void Flush();
+	void RasterizeTile(uint32_t tile);
+	uint64_t RasterizeTriangle(const Triangle& triangle, int32_t tileX, int32_t tileY, uint32_t* pTile);
+
+	JobSystem*	m_pJobSystem;
+
+	std::map<std::pair<std::wstring, std::string>, SoftwareVertexShader>	m_vertexShaders;
+	std::map<std::pair<std::wstring, std::string>, SoftwarePixelShader>	m_pixelShaders;
+
+	State			m_state;
+	Program			m_program;		// Of m_state.pPipelineState
+
+	// Current draw
+	std::vector<SoftwareVaryings>	m_vertices;
+	RHIRect							m_drawBounds = {};		// Scissor & viewport & target
+
+	// Work binned since the last flush, all for one render target
+	std::vector<std::unique_ptr<TriangleBatch>>	m_batches;
+	size_t										m_numPendingBatches = 0;
+	NullResource*								m_pPendingTarget = nullptr;
+	uint32_t									m_numTilesX = 0;
+	uint32_t									m_numTilesY = 0;
+	bool										m_bPendingClear = false;
+	uint32_t									m_pendingClearColor = 0;
+	std::vector<uint64_t>						m_tilePixels;
+
+	SoftwareRasterizerStatistics	m_statistics;
+};
@@ -0,0 +1,195 @@
+#include "SphericalHarmonics.h"
+#include "Platform.h"
+#include "Simd.h"
+
+#include <cmath>
+
+namespace
+{
+	constexpr float Pi = 3.14159265358979f;
+
+	// Integral of the solid angle from the face center to (x, y) on the unit cube face
+	float CubemapAreaElement(float x, float y)
+	{
+		return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+	}
+
+#if ENGINE_SIMD_SSE2
+	inline float HorizontalSum(__m128 v)
+	{
+		const __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		const __m128 sums = _mm_add_ps(v, shuffled);
+		return _mm_cvtss_f32(_mm_add_ss(sums, _mm_movehl_ps(shuffled, sums)));
+	}
+#endif
+}
+
+void EvaluateSHBasis(const Float3& direction, float basis[SHNumCoefficients])
+{
+	const float x = direction.x;
+	const float y = direction.y;
+	const float z = direction.z;
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * y;
+	basis[2] = 0.488603f * z;
+	basis[3] = 0.488603f * x;
+	basis[4] = 1.092548f * x * y;
+	basis[5] = 1.092548f * y * z;
+	basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+	basis[7] = 1.092548f * x * z;
+	basis[8] = 0.546274f * (x * x - y * y);
+}
+
+Float3 EvaluateSH(const SHColor& sh, const Float3& direction)
+{
+	float basis[SHNumCoefficients];
+	EvaluateSHBasis(direction, basis);
+	Float3 result = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < SHNumCoefficients; i++)
+	{
+		result = result + sh.coefficients[i] * basis[i];
+	}
+	return result;
+}
+
+SHColor ConvolveSHCosine(const SHColor& radiance)
+{
+	// Zonal harmonics of the clamped cosine per band
+	const float bands[3] = { Pi, 2.0f * Pi / 3.0f, Pi / 4.0f };
+	SHColor irradiance;
+	for (uint32_t i = 0; i < SHNumCoefficients; i++)
+	{
+		irradiance.coefficients[i] = radiance.coefficients[i] * bands[i == 0 ? 0 : i < 4 ? 1 : 2];
+	}
+	return irradiance;
+}
+
+Float3 GetCubemapTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size)
+{
+	const float u = (float(x) + 0.5f) / float(size) * 2.0f - 1.0f;
+	const float v = (float(y) + 0.5f) / float(size) * 2.0f - 1.0f;
+	Float3 direction;
+	switch (face)
+	{
+	case 0:		direction = { 1.0f, -v, -u }; break;
+	case 1:		direction = { -1.0f, -v, u }; break;
+	case 2:		direction = { u, 1.0f, v }; break;
+	case 3:		direction = { u, -1.0f, -v }; break;
+	case 4:		direction = { u, -v, 1.0f }; break;
+	default:	direction = { -u, -v, -1.0f }; break;
+	}
+	return Normalize(direction);
+}
+
+void RadianceCubemap::Resize(uint32_t newSize)
+{
+	size = newSize;
+	for (std::vector<float>& channel : channels)
+	{
+		channel.resize(GetNumTexels());
+	}
+}
+
+SHProjector::SHProjector(uint32_t cubemapSize)
+	: m_size(cubemapSize)
+	, m_numTexels(CubemapNumFaces * cubemapSize * cubemapSize)
+{
+	check(cubemapSize == 0);
+
+	for (std::vector<float>& weights : m_weightedBasis)
+	{
+		weights.resize(m_numTexels);
+	}
+
+	// Every face has the same solid angle layout, only the directions differ
+	const float texelSize = 2.0f / float(cubemapSize);
+	for (uint32_t face = 0; face < CubemapNumFaces; face++)
+	{
+		for (uint32_t y = 0; y < cubemapSize; y++)
+		{
+			for (uint32_t x = 0; x < cubemapSize; x++)
+			{
+				const float u0 = float(x) * texelSize - 1.0f;
+				const float v0 = float(y) * texelSize - 1.0f;
+				const float u1 = u0 + texelSize;
+				const float v1 = v0 + texelSize;
+				const float solidAngle = CubemapAreaElement(u0, v0) - CubemapAreaElement(u0, v1) - CubemapAreaElement(u1, v0) + CubemapAreaElement(u1, v1);
+
+				float basis[SHNumCoefficients];
+				EvaluateSHBasis(GetCubemapTexelDirection(face, x, y, cubemapSize), basis);
+				const uint32_t texel = (face * cubemapSize + y) * cubemapSize + x;
+				for (uint32_t i = 0; i < SHNumCoefficients; i++)
+				{
+					m_weightedBasis[i][texel] = basis[i] * solidAngle;
+				}
+			}
+		}
+	}
+}
+
+SHColor SHProjector::Project(const RadianceCubemap& cubemap) const
+{
+	check(cubemap.size != m_size);
+
+	const float* pR = cubemap.channels[0].data();
+	const float* pG = cubemap.channels[1].data();
+	const float* pB = cubemap.channels[2].data();
+	SHColor result;
+
+	// Three coefficients per pass, 9 accumulators stay in registers and the radiance is reloaded from L1
+	for (uint32_t first = 0; first < SHNumCoefficients; first += 3)
+	{
+		const float* pBasis0 = m_weightedBasis[first].data();
+		const float* pBasis1 = m_weightedBasis[first + 1].data();
+		const float* pBasis2 = m_weightedBasis[first + 2].data();
+		float sums[3][3] = {};
+		uint32_t texel = 0;
+#if ENGINE_SIMD_SSE2
+		__m128 sum0r = _mm_setzero_ps(), sum0g = _mm_setzero_ps(), sum0b = _mm_setzero_ps();
+		__m128 sum1r = _mm_setzero_ps(), sum1g = _mm_setzero_ps(), sum1b = _mm_setzero_ps();
+		__m128 sum2r = _mm_setzero_ps(), sum2g = _mm_setzero_ps(), sum2b = _mm_setzero_ps();
+		for (; texel + 4 <= m_numTexels; texel += 4)
+		{
+			const __m128 r = _mm_loadu_ps(pR + texel);
+			const __m128 g = _mm_loadu_ps(pG + texel);
+			const __m128 b = _mm_loadu_ps(pB + texel);
+			const __m128 basis0 = _mm_loadu_ps(pBasis0 + texel);
+			const __m128 basis1 = _mm_loadu_ps(pBasis1 + texel);
+			const __m128 basis2 = _mm_loadu_ps(pBasis2 + texel);
+			sum0r = _mm_add_ps(sum0r, _mm_mul_ps(basis0, r));
+			sum0g = _mm_add_ps(sum0g, _mm_mul_ps(basis0, g));
+			sum0b = _mm_add_ps(sum0b, _mm_mul_ps(basis0, b));
+			sum1r = _mm_add_ps(sum1r, _mm_mul_ps(basis1, r));
+			sum1g = _mm_add_ps(sum1g, _mm_mul_ps(basis1, g));
+			sum1b = _mm_add_ps(sum1b, _mm_mul_ps(basis1, b));
+			sum2r = _mm_add_ps(sum2r, _mm_mul_ps(basis2, r));
+			sum2g = _mm_add_ps(sum2g, _mm_mul_ps(basis2, g));
+			sum2b = _mm_add_ps(sum2b, _mm_mul_ps(basis2, b));
+		}
+		sums[0][0] = HorizontalSum(sum0r);
+		sums[0][1] = HorizontalSum(sum0g);
+		sums[0][2] = HorizontalSum(sum0b);
+		sums[1][0] = HorizontalSum(sum1r);
+		sums[1][1] = HorizontalSum(sum1g);
+		sums[1][2] = HorizontalSum(sum1b);
+		sums[2][0] = HorizontalSum(sum2r);
+		sums[2][1] = HorizontalSum(sum2g);
+		sums[2][2] = HorizontalSum(sum2b);
+#endif
+		for (; texel < m_numTexels; texel++)
+		{
+			const float* pBases[3] = { pBasis0, pBasis1, pBasis2 };
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				sums[i][0] += pBases[i][texel] * pR[texel];
+				sums[i][1] += pBases[i][texel] * pG[texel];
+				sums[i][2] += pBases[i][texel] * pB[texel];
+			}
+		}
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			result.coefficients[first + i] = { sums[i][0], sums[i][1], sums[i][2] };
+		}
+	}
+	return result;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Order 2 (L2, 9 coefficients) real spherical harmonics for diffuse lighting
+// Radiance cubemaps are projected with SHProjector, the cosine lobe convolution turns radiance into irradiance which
+// is then evaluated per normal. Face order and orientation follow D3D cubemaps: +X, -X, +Y, -Y, +Z, -Z, v pointing down.
+
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+enum : uint32_t
+{
+	SHNumCoefficients = 9,
+	CubemapNumFaces = 6,
+};
+
+// RGB per coefficient, band major: l = 0, l = 1 (y, z, x), l = 2 (xy, yz, 3z^2 - 1, xz, x^2 - y^2)
+struct SHColor
+{
+	Float3 coefficients[SHNumCoefficients];
+};
+
+void EvaluateSHBasis(const Float3& direction, float basis[SHNumCoefficients]);
+Float3 EvaluateSH(const SHColor& sh, const Float3& direction);
+// Radiance to irradiance, evaluating the result with a normal gives the cosine weighted integral over the hemisphere
+SHColor ConvolveSHCosine(const SHColor& radiance);
+
+// Unit direction through the center of a texel
+Float3 GetCubemapTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size);
+
+// Planar float RGB, face after face, rows top to bottom. Planar channels keep the projection loads contiguous
+struct RadianceCubemap
+{
+	uint32_t			size = 0;
+	std::vector<float>	channels[3];
+
+	void Resize(uint32_t newSize);
+	uint32_t GetNumTexels() const { return CubemapNumFaces * size * size; }
+	uint32_t GetTexelIndex(uint32_t face, uint32_t x, uint32_t y) const { return (face * size + y) * size + x; }
+	void SetTexel(uint32_t index, const Float3& radiance) { channels[0][index] = radiance.x; channels[1][index] = radiance.y; channels[2][index] = radiance.z; }
+};
+
+// Projects cubemaps of one size, the basis weighted by texel solid angle is tabulated up front so a projection is
+// 27 dot products over the texels. Thread safe, Project() does not modify the projector
+class SHProjector
+{
+public:
+	explicit SHProjector(uint32_t cubemapSize);
+
+	uint32_t GetCubemapSize() const { return m_size; }
+	// Radiance SH, `cubemap.size` must match
+	SHColor Project(const RadianceCubemap& cubemap) const;
+
+private:
+	uint32_t			m_size;
+	uint32_t			m_numTexels;
+	std::vector<float>	m_weightedBasis[SHNumCoefficients];
+};
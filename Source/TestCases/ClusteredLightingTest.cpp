@@ -0,0 +1,196 @@
+#include "TestFramework.h"
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <random>
+
+static Camera MakeTestCamera(float aspectRatio)
+{
+	Camera camera;
+	camera.position = { 0.0f, 2.0f, -10.0f };
+	camera.forward = { 0.2f, -0.1f, 1.0f };
+	camera.aspectRatio = aspectRatio;
+	camera.farZ = 200.0f;
+	return camera;
+}
+
+// Lights scattered around the view frustum, some of them outside of it
+static LightList MakeRandomLights(uint32_t count, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> horizontal(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> vertical(-10.0f, 20.0f);
+	std::uniform_real_distribution<float> depth(-20.0f, 190.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 6.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(0.1f, 1.2f);
+
+	LightList lights;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Float3 position = { horizontal(random), vertical(random), depth(random) };
+		if (i % 3 == 0)
+		{
+			lights.AddSpotLight(position, { direction(random), direction(random), direction(random) }, radius(random) * 2.0f, angle(random));
+		}
+		else
+		{
+			lights.AddPointLight(position, radius(random));
+		}
+	}
+	return lights;
+}
+
+static bool SphereIntersectsBox(const Float3& center, float radius, const BoundingBox& box)
+{
+	const float dx = std::max(std::max(box.min.x - center.x, center.x - box.max.x), 0.0f);
+	const float dy = std::max(std::max(box.min.y - center.y, center.y - box.max.y), 0.0f);
+	const float dz = std::max(std::max(box.min.z - center.z, center.z - box.max.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+static bool ClusterContainsLight(const ClusteredLightBinner& binner, uint32_t cluster, uint32_t light)
+{
+	const ClusterLightRange range = binner.GetClusterRanges()[cluster];
+	const uint32_t* pBegin = binner.GetLightIndices().data() + range.offset;
+	return std::find(pBegin, pBegin + range.count, light) != pBegin + range.count;
+}
+
+TEST_CASE(ClusteredLighting_MatchesBruteForceBounds)
+{
+	JobSystem jobSystem(2);
+	ClusteredLightBinner binner(&jobSystem, { 640, 360, 32, 16 });
+	const Camera camera = MakeTestCamera(640.0f / 360.0f);
+	const LightList lights = MakeRandomLights(2000, 1);
+	binner.Bin(lights, camera);
+
+	TEST_EXPECT(binner.GetClusterRanges().size() == 20 * 12 * 16);
+	TEST_EXPECT(binner.GetStatistics().numLightIndices == binner.GetLightIndices().size());
+	TEST_EXPECT(binner.GetStatistics().numVisibleLights > 0 && binner.GetStatistics().numVisibleLights < lights.GetNumLights());
+
+	// Every binned light touches the AABB of its cluster, and the lists are packed back to back
+	const Float4x4 view = camera.GetViewMatrix();
+	uint32_t expectedOffset = 0;
+	for (uint32_t slice = 0; slice < 16; slice++)
+	{
+		for (uint32_t tileY = 0; tileY < binner.GetNumTilesY(); tileY++)
+		{
+			for (uint32_t tileX = 0; tileX < binner.GetNumTilesX(); tileX++)
+			{
+				const BoundingBox bounds = binner.GetClusterBounds(tileX, tileY, slice);
+				const ClusterLightRange range = binner.GetClusterRanges()[binner.GetClusterIndex(tileX, tileY, slice)];
+				TEST_EXPECT(range.offset == expectedOffset);
+				expectedOffset += range.count;
+				for (uint32_t i = 0; i < range.count; i++)
+				{
+					const uint32_t light = binner.GetLightIndices()[range.offset + i];
+					const Float3 center = TransformPoint({ lights.positionX[light], lights.positionY[light], lights.positionZ[light] }, view);
+					TEST_EXPECT(SphereIntersectsBox(center, lights.radius[light], bounds));
+				}
+			}
+		}
+	}
+	TEST_EXPECT(expectedOffset == binner.GetLightIndices().size());
+}
+
+TEST_CASE(ClusteredLighting_IsConservative)
+{
+	JobSystem jobSystem(2);
+	ClusteredLightBinner binner(&jobSystem, { 640, 360, 32, 16 });
+	const Camera camera = MakeTestCamera(640.0f / 360.0f);
+	const LightList lights = MakeRandomLights(500, 2);
+	binner.Bin(lights, camera);
+
+	// Points inside a light volume must find the light in the cluster they project to
+	const Float4x4 viewProjection = camera.GetViewProjectionMatrix();
+	const Float4x4 view = camera.GetViewMatrix();
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	uint32_t numSamplesTested = 0;
+	for (uint32_t light = 0; light < lights.GetNumLights(); light++)
+	{
+		const Float3 position = { lights.positionX[light], lights.positionY[light], lights.positionZ[light] };
+		const Float3 direction = { lights.directionX[light], lights.directionY[light], lights.directionZ[light] };
+		for (uint32_t sample = 0; sample < 64; sample++)
+		{
+			const Float3 offset = { unit(random), unit(random), unit(random) };
+			if (Length(offset) > 1.0f)
+			{
+				continue;
+			}
+			const Float3 point = position + offset * lights.radius[light];
+			if (lights.bIsSpot[light] && Dot(Normalize(offset), direction) < lights.cosOuterAngle[light])
+			{
+				continue;
+			}
+
+			const float viewZ = TransformPoint(point, view).z;
+			const int32_t slice = binner.GetSliceFromDepth(viewZ);
+			const Float4 clip = Transform({ point.x, point.y, point.z, 1.0f }, viewProjection);
+			const float ndcX = clip.x / clip.w;
+			const float ndcY = clip.y / clip.w;
+			if (slice < 0 || std::abs(ndcX) >= 1.0f || std::abs(ndcY) >= 1.0f)
+			{
+				continue;
+			}
+			const uint32_t tileX = uint32_t((ndcX * 0.5f + 0.5f) * 640.0f) / 32;
+			const uint32_t tileY = uint32_t((0.5f - ndcY * 0.5f) * 360.0f) / 32;
+			TEST_EXPECT(ClusterContainsLight(binner, binner.GetClusterIndex(tileX, tileY, uint32_t(slice)), light));
+			numSamplesTested++;
+		}
+	}
+	TEST_EXPECT(numSamplesTested > 1000);
+}
+
+TEST_CASE(ClusteredLighting_CullsLights)
+{
+	JobSystem jobSystem(1);
+	ClusteredLightBinner binner(&jobSystem, { 256, 256, 64, 32 });
+	Camera camera;
+	camera.aspectRatio = 1.0f;
+
+	LightList lights;
+	lights.AddPointLight({ 0.0f, 0.0f, -5.0f }, 2.0f);		// Behind the camera
+	lights.AddPointLight({ 0.0f, 0.0f, 2000.0f }, 10.0f);	// Beyond the far plane
+	lights.AddPointLight({ 100.0f, 0.0f, 10.0f }, 1.0f);	// Off screen
+	lights.AddSpotLight({ 0.0f, 0.0f, 10.0f }, { 0.0f, 0.0f, -1.0f }, 5.0f, 0.3f);
+	binner.Bin(lights, camera);
+
+	// Only the spot light is left, pointing back at the camera it misses the clusters behind its apex
+	TEST_EXPECT(binner.GetStatistics().numVisibleLights == 1);
+	const uint32_t farSlice = uint32_t(binner.GetSliceFromDepth(14.9f));
+	const uint32_t nearSlice = uint32_t(binner.GetSliceFromDepth(9.0f));
+	TEST_EXPECT(ClusterContainsLight(binner, binner.GetClusterIndex(1, 1, nearSlice), 3));
+	TEST_EXPECT(farSlice != nearSlice && !ClusterContainsLight(binner, binner.GetClusterIndex(1, 1, farSlice), 3));
+
+	const Float2 scaleBias = binner.GetClusterSliceScaleBias();
+	TEST_EXPECT(int32_t(std::log(9.0f) * scaleBias.x + scaleBias.y) == int32_t(nearSlice));
+	TEST_EXPECT(binner.GetSliceFromDepth(0.05f) == -1);
+}
+
+BENCHMARK_CASE(ClusteredLighting_Bin)
+{
+	JobSystem jobSystem;
+	for (const uint32_t numLights : { 10000u, 100000u })
+	{
+		const LightList lights = MakeRandomLights(numLights, 4);
+		for (const ClusterGridDesc desc : { ClusterGridDesc{ 1920, 1080, 64, 24 }, ClusterGridDesc{ 3840, 2160, 64, 24 } })
+		{
+			ClusteredLightBinner binner(&jobSystem, desc);
+			const Camera camera = MakeTestCamera(float(desc.width) / float(desc.height));
+			binner.Bin(lights, camera);
+
+			const uint32_t numIterations = 5;
+			BenchmarkTimer timer;
+			for (uint32_t i = 0; i < numIterations; i++)
+			{
+				binner.Bin(lights, camera);
+			}
+			const double seconds = timer.GetElapsedSeconds();
+			char name[128];
+			snprintf(name, sizeof(name), "%u lights, %ux%u, %u light/cluster pairs", numLights, desc.width, desc.height, binner.GetStatistics().numLightIndices);
+			ReportBenchmark(name, seconds, double(numLights) * numIterations, "light");
+			printf("    %.3f ms per frame, %u visible lights\n", seconds * 1000.0 / numIterations, binner.GetStatistics().numVisibleLights);
+		}
+	}
+}
@@ -0,0 +1,173 @@
+#include "TestFramework.h"
+#include "DescriptorAllocator.h"
+
+#include <random>
+
+TEST_CASE(DescriptorFreeList_CoalescesOnFree)
+{
+	DescriptorFreeListAllocator allocator(16);
+	DescriptorRange a = allocator.Allocate(4);
+	DescriptorRange b = allocator.Allocate(4);
+	DescriptorRange c = allocator.Allocate(8);
+	TEST_EXPECT(a.offset == 0 && b.offset == 4 && c.offset == 8);
+	TEST_EXPECT(!allocator.Allocate(1).IsValid());
+
+	allocator.Free(a);
+	allocator.Free(c);
+	TEST_EXPECT(allocator.GetNumFreeBlocks() == 2);
+	allocator.Free(b);
+	TEST_EXPECT(allocator.GetNumFreeBlocks() == 1);
+	TEST_EXPECT(allocator.GetNumFreeDescriptors() == 16);
+	TEST_EXPECT(allocator.Allocate(16).offset == 0);
+}
+
+TEST_CASE(DescriptorFreeList_DoubleFreeThrows)
+{
+	DescriptorFreeListAllocator allocator(8);
+	DescriptorRange a = allocator.Allocate(2);
+	allocator.Free(a);
+	bool bThrown = false;
+	try
+	{
+		allocator.Free(a);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+TEST_CASE(DescriptorFreeList_RandomStress)
+{
+	const uint32_t capacity = 1024;
+	DescriptorFreeListAllocator allocator(capacity);
+	std::vector<uint8_t> occupied(capacity, 0);
+	std::vector<DescriptorRange> live;
+	std::mt19937 random(7);
+
+	for (int i = 0; i < 100000; i++)
+	{
+		if (live.empty() || random() % 2 == 0)
+		{
+			DescriptorRange range = allocator.Allocate(1 + random() % 8);
+			if (range.IsValid())
+			{
+				for (uint32_t j = range.offset; j < range.offset + range.count; j++)
+				{
+					TEST_EXPECT(occupied[j] == 0);
+					occupied[j] = 1;
+				}
+				live.push_back(range);
+			}
+		}
+		else
+		{
+			size_t index = random() % live.size();
+			DescriptorRange range = live[index];
+			live[index] = live.back();
+			live.pop_back();
+			for (uint32_t j = range.offset; j < range.offset + range.count; j++)
+			{
+				occupied[j] = 0;
+			}
+			allocator.Free(range);
+		}
+	}
+
+	for (const DescriptorRange& range : live)
+	{
+		allocator.Free(range);
+	}
+	TEST_EXPECT(allocator.GetNumFreeDescriptors() == capacity);
+	TEST_EXPECT(allocator.GetNumFreeBlocks() == 1);
+}
+
+TEST_CASE(DescriptorRing_WrapsAndRetiresByFence)
+{
+	DescriptorRingAllocator ring(10);
+	TEST_EXPECT(ring.Allocate(6).offset == 0);
+	ring.EndFrame(1);
+	// Would wrap, 4 at the end are skipped but frame 1 still owns [0, 6)
+	TEST_EXPECT(!ring.Allocate(5).IsValid());
+	TEST_EXPECT(ring.Allocate(4).offset == 6);
+	ring.EndFrame(2);
+
+	ring.Retire(1);
+	DescriptorRange range = ring.Allocate(5);
+	TEST_EXPECT(range.IsValid() && range.offset == 0);
+	TEST_EXPECT(!ring.Allocate(2).IsValid());
+	ring.EndFrame(3);
+	ring.Retire(3);
+	TEST_EXPECT(ring.GetNumUsedDescriptors() == 0);
+}
+
+TEST_CASE(DescriptorHeap_FreeDeferredUntilFenceCompletes)
+{
+	DescriptorHeapAllocator allocator(4, 8);
+	uint64_t frameFence = 1;
+	allocator.BeginFrame(frameFence, 0);
+	DescriptorRange all = allocator.AllocatePersistent(4);
+	TEST_EXPECT(all.IsValid());
+	allocator.FreePersistent(all);
+	// Still owned by the GPU this frame
+	TEST_EXPECT(!allocator.AllocatePersistent(1).IsValid());
+	DescriptorRange transient = allocator.AllocateTransient(3);
+	TEST_EXPECT(transient.offset == 4);
+	allocator.EndFrame();
+
+	// Frame 1 not retired yet
+	allocator.BeginFrame(++frameFence, 0);
+	TEST_EXPECT(allocator.GetNumPendingFrees() == 1);
+	TEST_EXPECT(!allocator.AllocatePersistent(1).IsValid());
+	allocator.EndFrame();
+
+	allocator.BeginFrame(++frameFence, 1);
+	TEST_EXPECT(allocator.GetNumPendingFrees() == 0);
+	TEST_EXPECT(allocator.AllocatePersistent(4).IsValid());
+	allocator.EndFrame();
+}
+
+BENCHMARK_CASE(DescriptorFreeList_AllocateFree)
+{
+	const uint32_t capacity = 1 << 16;
+	DescriptorFreeListAllocator allocator(capacity);
+	std::vector<DescriptorRange> live;
+	live.reserve(capacity);
+	std::mt19937 random(11);
+
+	// Steady state around half occupancy, mixed sizes
+	for (uint32_t i = 0; i < capacity / 8; i++)
+	{
+		live.push_back(allocator.Allocate(1 + random() % 4));
+	}
+
+	const int numOperations = 4000000;
+	BenchmarkTimer timer;
+	for (int i = 0; i < numOperations; i += 2)
+	{
+		const size_t index = random() % live.size();
+		allocator.Free(live[index]);
+		live[index] = allocator.Allocate(1 + (i >> 1) % 4);
+	}
+	ReportBenchmark("Free list allocate + free (best fit)", timer.GetElapsedSeconds(), numOperations, "op");
+}
+
+BENCHMARK_CASE(DescriptorHeap_TransientRing)
+{
+	DescriptorHeapAllocator allocator(1024, 1 << 16);
+	const int numFrames = 1000;
+	const int allocationsPerFrame = 4096;
+	BenchmarkTimer timer;
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		// 2 frames in flight
+		allocator.BeginFrame(frame + 1, frame > 2 ? frame - 2 : 0);
+		for (int i = 0; i < allocationsPerFrame; i++)
+		{
+			allocator.AllocateTransient(1 + (i & 3));
+		}
+		allocator.EndFrame();
+	}
+	ReportBenchmark("Transient ring allocate", timer.GetElapsedSeconds(), double(numFrames) * allocationsPerFrame, "op");
+}
@@ -0,0 +1,429 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "DynamicResolution.h"
+#include "Engine.h"
+#include "Upscale.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
+// The frame-time traces are synthetic, generated by the tests below rather than captured from real runs: constant
+// loads, load steps and seeded jitter with hitches, which pin down the controller response exactly
+static const double TargetFrameSeconds = 1.0 / 60.0;
+// Share of a trace frame that does not depend on the resolution
+static const double FixedShare = 0.1;
+
+struct TraceReplay
+{
+	std::vector<double>	frameSeconds;	// As the controller measured them
+	std::vector<float>	scales;			// Each frame rendered at
+};
+
+// Trace frame times stand for the maximum scale, the resolution dependent share follows the pixel count of the replay
+static TraceReplay ReplayTrace(DynamicResolutionController& controller, const std::vector<double>& trace)
+{
+	TraceReplay replay;
+	const float maxScale = controller.GetSettings().maxScale;
+	for (double fullScaleSeconds : trace)
+	{
+		const float scale = controller.GetScale();
+		const double pixels = double(scale) * scale / (double(maxScale) * maxScale);
+		const double frameSeconds = fullScaleSeconds * (FixedShare + (1.0 - FixedShare) * pixels);
+		replay.frameSeconds.push_back(frameSeconds);
+		replay.scales.push_back(scale);
+		controller.Update(frameSeconds);
+	}
+	return replay;
+}
+
+static std::vector<double> ConstantTrace(double seconds, uint32_t numFrames)
+{
+	return std::vector<double>(numFrames, seconds);
+}
+
+static void AppendTrace(std::vector<double>& trace, const std::vector<double>& tail)
+{
+	trace.insert(trace.end(), tail.begin(), tail.end());
+}
+
+static bool RespectsRateLimit(const TraceReplay& replay, float maxScaleChange)
+{
+	for (size_t i = 1; i < replay.scales.size(); i++)
+	{
+		if (std::abs(replay.scales[i] - replay.scales[i - 1]) > maxScaleChange + 1e-6f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+TEST_CASE(DynamicResolution_ConvergesToTarget)
+{
+	DynamicResolutionController controller;
+	const TraceReplay replay = ReplayTrace(controller, ConstantTrace(25e-3, 120));
+	// 25 ms at full resolution fits 16.7 ms at about 63% of the pixels
+	TEST_EXPECT(std::abs(replay.frameSeconds.back() - TargetFrameSeconds) < 0.01 * TargetFrameSeconds);
+	TEST_EXPECT(std::abs(controller.GetScale() - 0.794f) < 0.01f);
+	// Settled without oscillating
+	float minScale = 1.0f;
+	float maxScale = 0.0f;
+	for (size_t i = 60; i < replay.scales.size(); i++)
+	{
+		minScale = std::min(minScale, replay.scales[i]);
+		maxScale = std::max(maxScale, replay.scales[i]);
+	}
+	TEST_EXPECT(maxScale - minScale < 0.005f);
+	TEST_EXPECT(RespectsRateLimit(replay, controller.GetSettings().maxScaleChange));
+
+	uint32_t width;
+	uint32_t height;
+	controller.GetRenderSize(1920, 1080, width, height);
+	TEST_EXPECT(width == GetScaledSize(1920, controller.GetScale()) && width < 1920 && height < 1080);
+	controller.GetMaxRenderSize(1920, 1080, width, height);
+	TEST_EXPECT(width == 1920 && height == 1080);
+}
+
+TEST_CASE(DynamicResolution_StaysWithinBounds)
+{
+	// Under budget stays at the maximum
+	DynamicResolutionController controller;
+	TraceReplay replay = ReplayTrace(controller, ConstantTrace(8e-3, 100));
+	TEST_EXPECT(*std::min_element(replay.scales.begin(), replay.scales.end()) == 1.0f);
+
+	// Far over budget ends at the minimum, in steps of at most maxScaleChange
+	DynamicResolutionSettings settings;
+	settings.minScale = 0.6f;
+	settings.maxScaleChange = 0.02f;
+	controller.SetSettings(settings);
+	TEST_EXPECT(controller.GetScale() == 1.0f);
+	replay = ReplayTrace(controller, ConstantTrace(0.2, 100));
+	TEST_EXPECT(controller.GetScale() == 0.6f && replay.scales[10] > 0.6f);
+	TEST_EXPECT(RespectsRateLimit(replay, settings.maxScaleChange));
+
+	// No windup at the bound, recovers as soon as the load goes away
+	replay = ReplayTrace(controller, ConstantTrace(8e-3, 40));
+	TEST_EXPECT(controller.GetScale() == 1.0f && replay.scales[3] > 0.6f);
+
+	TEST_EXPECT(GetScaledSize(1920, 0.5f) == 960 && GetScaledSize(1080, 0.333f) == 360 && GetScaledSize(3, 0.01f) == 1);
+}
+
+TEST_CASE(DynamicResolution_RejectsInvalidInput)
+{
+	const double Infinity = std::numeric_limits<double>::infinity();
+	// Settings that would divide by zero or never move the scale
+	for (double targetFrameSeconds : { 0.0, -1.0, std::nan(""), Infinity })
+	{
+		DynamicResolutionSettings settings;
+		settings.targetFrameSeconds = targetFrameSeconds;
+		bool bThrown = false;
+		try
+		{
+			DynamicResolutionController controller(settings);
+		}
+		catch (const std::runtime_error&)
+		{
+			bThrown = true;
+		}
+		TEST_EXPECT(bThrown);
+	}
+	DynamicResolutionSettings settings;
+	settings.maxScaleChange = std::nanf("");
+	bool bThrown = false;
+	try
+	{
+		DynamicResolutionController controller(settings);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+
+	// Broken frame time measurements leave the scale alone
+	DynamicResolutionController controller;
+	ReplayTrace(controller, ConstantTrace(0.2, 5));
+	const float scale = controller.GetScale();
+	TEST_EXPECT(scale < 1.0f);
+	for (double frameSeconds : { std::nan(""), Infinity, -Infinity, 0.0, -1e-3 })
+	{
+		TEST_EXPECT(controller.Update(frameSeconds) == scale);
+	}
+	TEST_EXPECT(std::isfinite(controller.Update(0.2)) && controller.GetScale() < scale);
+}
+
+TEST_CASE(DynamicResolution_FollowsLoadSteps)
+{
+	DynamicResolutionController controller;
+	std::vector<double> trace = ConstantTrace(10e-3, 100);
+	AppendTrace(trace, ConstantTrace(30e-3, 200));
+	AppendTrace(trace, ConstantTrace(10e-3, 200));
+	const TraceReplay replay = ReplayTrace(controller, trace);
+
+	// Over budget for a few frames after the load doubles, then back within 2%
+	uint32_t lastFrameOverBudget = 0;
+	for (uint32_t frame = 100; frame < 300; frame++)
+	{
+		if (replay.frameSeconds[frame] > 1.02 * TargetFrameSeconds)
+		{
+			lastFrameOverBudget = frame;
+		}
+	}
+	TEST_EXPECT(lastFrameOverBudget > 100 && lastFrameOverBudget < 100 + 30);
+	TEST_EXPECT(std::abs(replay.scales[299] - 0.711f) < 0.01f);
+	// Back to full resolution once the load drops
+	TEST_EXPECT(replay.scales[330] == 1.0f && replay.scales.back() == 1.0f);
+}
+
+TEST_CASE(DynamicResolution_NoisyTraceWithHitches)
+{
+	// Jittered frames around 22 ms with a long hitch every 100 frames
+	std::mt19937 random(3);
+	std::uniform_real_distribution<double> jitter(0.85, 1.15);
+	std::vector<double> trace;
+	for (uint32_t frame = 0; frame < 1000; frame++)
+	{
+		trace.push_back(frame % 100 == 50 ? 0.1 : 22e-3 * jitter(random));
+	}
+	DynamicResolutionController controller;
+	const TraceReplay replay = ReplayTrace(controller, trace);
+
+	double totalSeconds = 0.0;
+	double totalScale = 0.0;
+	double totalScaleSquared = 0.0;
+	uint32_t numFrames = 0;
+	for (uint32_t frame = 100; frame < 1000; frame++)
+	{
+		if (frame % 100 == 50)
+		{
+			// A single hitch costs at most one step
+			TEST_EXPECT(replay.scales[frame] - replay.scales[frame + 1] <= controller.GetSettings().maxScaleChange + 1e-6f);
+			continue;
+		}
+		totalSeconds += replay.frameSeconds[frame];
+		totalScale += replay.scales[frame];
+		totalScaleSquared += double(replay.scales[frame]) * replay.scales[frame];
+		numFrames++;
+	}
+	const double meanScale = totalScale / numFrames;
+	const double scaleDeviation = std::sqrt(std::max(totalScaleSquared / numFrames - meanScale * meanScale, 0.0));
+	TEST_EXPECT(std::abs(totalSeconds / numFrames - TargetFrameSeconds) < 0.05 * TargetFrameSeconds);
+	TEST_EXPECT(scaleDeviation < 0.04);
+}
+
+// Direct 2D evaluation of the filter in double precision
+static std::vector<uint32_t> UpscaleReference(const std::vector<uint32_t>& source, uint32_t sourceWidth, const RHIRect& sourceRect,
+	uint32_t destWidth, uint32_t destHeight, const RHIRect& destRect, RHIUpscaleFilter filter)
+{
+	auto weight = [filter](double distance)
+	{
+		const double x = std::abs(distance);
+		if (filter == RHIUpscaleFilter::Bilinear)
+		{
+			return std::max(1.0 - x, 0.0);
+		}
+		return x < 1.0 ? 1.5 * x * x * x - 2.5 * x * x + 1.0 : (x < 2.0 ? -0.5 * x * x * x + 2.5 * x * x - 4.0 * x + 2.0 : 0.0);
+	};
+
+	std::vector<uint32_t> dest(size_t(destWidth) * destHeight, 0);
+	const double stepX = double(sourceRect.right - sourceRect.left) / (destRect.right - destRect.left);
+	const double stepY = double(sourceRect.bottom - sourceRect.top) / (destRect.bottom - destRect.top);
+	for (int32_t y = destRect.top; y < destRect.bottom; y++)
+	{
+		for (int32_t x = destRect.left; x < destRect.right; x++)
+		{
+			const double sourceX = sourceRect.left + (x - destRect.left + 0.5) * stepX - 0.5;
+			const double sourceY = sourceRect.top + (y - destRect.top + 0.5) * stepY - 0.5;
+			double color[4] = {};
+			for (int32_t ty = int32_t(std::floor(sourceY)) - 1; ty <= int32_t(std::floor(sourceY)) + 2; ty++)
+			{
+				for (int32_t tx = int32_t(std::floor(sourceX)) - 1; tx <= int32_t(std::floor(sourceX)) + 2; tx++)
+				{
+					const double w = weight(sourceX - tx) * weight(sourceY - ty);
+					const int32_t cx = std::clamp(tx, sourceRect.left, sourceRect.right - 1);
+					const int32_t cy = std::clamp(ty, sourceRect.top, sourceRect.bottom - 1);
+					const uint32_t texel = source[size_t(cy) * sourceWidth + cx];
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						color[c] += w * double((texel >> (c * 8)) & 0xff);
+					}
+				}
+			}
+			uint32_t packed = 0;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				packed |= uint32_t(std::nearbyint(std::clamp(color[c], 0.0, 255.0))) << (c * 8);
+			}
+			dest[size_t(y) * destWidth + x] = packed;
+		}
+	}
+	return dest;
+}
+
+static uint32_t GetMaxChannelDifference(uint32_t a, uint32_t b)
+{
+	uint32_t difference = 0;
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		const int32_t ca = int32_t((a >> (c * 8)) & 0xff);
+		const int32_t cb = int32_t((b >> (c * 8)) & 0xff);
+		difference = std::max(difference, uint32_t(std::abs(ca - cb)));
+	}
+	return difference;
+}
+
+static std::vector<uint32_t> RandomImage(uint32_t width, uint32_t height, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::vector<uint32_t> image(size_t(width) * height);
+	for (uint32_t& texel : image)
+	{
+		texel = uint32_t(random());
+	}
+	return image;
+}
+
+TEST_CASE(Upscale_MatchesDirectFilter)
+{
+	const uint32_t sourceWidth = 97;
+	const uint32_t sourceHeight = 61;
+	const uint32_t destWidth = 150;
+	const uint32_t destHeight = 110;
+	const std::vector<uint32_t> source = RandomImage(sourceWidth, sourceHeight, 11);
+	// Part of the source, the texels around it must not bleed in
+	const RHIRect sourceRect = { 5, 3, 5 + 67, 3 + 45 };
+	const RHIRect destRect = { 10, 6, 10 + 128, 6 + 96 };
+	JobSystem jobSystem(3);
+	for (RHIUpscaleFilter filter : { RHIUpscaleFilter::Bilinear, RHIUpscaleFilter::CatmullRom })
+	{
+		const std::vector<uint32_t> reference = UpscaleReference(source, sourceWidth, sourceRect, destWidth, destHeight, destRect, filter);
+		std::vector<uint32_t> dest(size_t(destWidth) * destHeight, 0);
+		UpscaleRGBA8(reinterpret_cast<const uint8_t*>(source.data()), sourceWidth * 4, sourceRect,
+			reinterpret_cast<uint8_t*>(dest.data()), destWidth * 4, destRect, filter);
+		uint32_t maxDifference = 0;
+		for (size_t i = 0; i < dest.size(); i++)
+		{
+			maxDifference = std::max(maxDifference, GetMaxChannelDifference(dest[i], reference[i]));
+		}
+		TEST_EXPECT(maxDifference <= 1);
+		// Outside of the destination rectangle nothing was written
+		TEST_EXPECT(dest[0] == 0 && dest[size_t(destRect.bottom) * destWidth + destRect.right] == 0);
+
+		std::vector<uint32_t> parallelDest(dest.size(), 0);
+		UpscaleRGBA8(reinterpret_cast<const uint8_t*>(source.data()), sourceWidth * 4, sourceRect,
+			reinterpret_cast<uint8_t*>(parallelDest.data()), destWidth * 4, destRect, filter, &jobSystem);
+		TEST_EXPECT(parallelDest == dest);
+	}
+}
+
+TEST_CASE(Upscale_CopiesAtScaleOne)
+{
+	const uint32_t width = 40;
+	const uint32_t height = 30;
+	const std::vector<uint32_t> source = RandomImage(width, height, 5);
+	const RHIRect rect = { 0, 0, int32_t(width), int32_t(height) };
+	for (RHIUpscaleFilter filter : { RHIUpscaleFilter::Bilinear, RHIUpscaleFilter::CatmullRom })
+	{
+		std::vector<uint32_t> dest(source.size(), 0);
+		UpscaleRGBA8(reinterpret_cast<const uint8_t*>(source.data()), width * 4, rect, reinterpret_cast<uint8_t*>(dest.data()), width * 4, rect, filter);
+		TEST_EXPECT(dest == source);
+	}
+
+	// Weights sum to one, flat areas stay flat even under the negative lobes
+	const std::vector<uint32_t> flat(size_t(width) * height, 0x80ff4010u);
+	std::vector<uint32_t> dest(size_t(100) * 80, 0);
+	UpscaleRGBA8(reinterpret_cast<const uint8_t*>(flat.data()), width * 4, { 0, 0, 13, 7 }, reinterpret_cast<uint8_t*>(dest.data()), 100 * 4, { 0, 0, 100, 80 }, RHIUpscaleFilter::CatmullRom);
+	TEST_EXPECT(std::all_of(dest.begin(), dest.end(), [](uint32_t texel) { return texel == 0x80ff4010u; }));
+}
+
+TEST_CASE(DynamicResolution_EngineFrames)
+{
+	const uint32_t width = 320;
+	const uint32_t height = 240;
+	Engine engine(width, height, L"Headless", RHIBackend::Null);
+	engine.SetSoftwareRasterization(true);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("DynamicResolution_EngineFrames"));
+	engine.OnInit();
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetRenderWidth() == width && engine.GetRenderHeight() == height);
+	engine.WaitForGpuCommandCompletion();
+	const uint32_t* pPixels = reinterpret_cast<const uint32_t*>(static_cast<NullResource*>(engine.GetSwapChain()->GetBackBuffer(0))->GetData());
+	const uint32_t fullResolutionCenter = pPixels[(height / 2) * width + width / 2];
+
+	// No frame fits a microsecond, the scale goes down to the minimum
+	DynamicResolutionSettings settings;
+	settings.targetFrameSeconds = 1e-6;
+	settings.minScale = 0.5f;
+	settings.maxScaleChange = 0.25f;
+	engine.SetDynamicResolution(true, settings);
+	for (uint32_t frame = 0; frame < 6; frame++)
+	{
+		engine.OnUpdate();
+	}
+	TEST_EXPECT(engine.GetDynamicResolution().GetScale() == 0.5f && engine.GetRenderWidth() == width / 2 && engine.GetRenderHeight() == height / 2);
+	TEST_EXPECT(engine.GetLastFrameWorkSeconds() > 0.0);
+	engine.WaitForGpuCommandCompletion();
+	// The whole back buffer is written from the quarter of scene color, the triangle stays where it was
+	const uint32_t backBufferIndex = (engine.GetSwapChain()->GetCurrentBackBufferIndex() + engine.GetSwapChain()->GetBufferCount() - 1) % engine.GetSwapChain()->GetBufferCount();
+	pPixels = reinterpret_cast<const uint32_t*>(static_cast<NullResource*>(engine.GetSwapChain()->GetBackBuffer(backBufferIndex))->GetData());
+	TEST_EXPECT(GetMaxChannelDifference(pPixels[(height / 2) * width + width / 2], fullResolutionCenter) <= 8);
+	TEST_EXPECT(pPixels[0] == PackColorRGBA8({ 0.0f, 0.2f, 0.4f, 1.0f }).rgba && pPixels[width * height - 1] == pPixels[0]);
+
+	// Resizing replaces the back buffers, scene color follows
+	engine.OnResize(256, 192);
+	engine.SetDynamicResolution(false);
+	engine.GetSoftwareRasterizer()->ResetStatistics();
+	engine.OnUpdate();
+	engine.WaitForGpuCommandCompletion();
+	TEST_EXPECT(engine.GetSwapChain()->GetBackBuffer(0)->GetDesc().width == 256 && engine.GetRenderWidth() == 256 && engine.GetRenderHeight() == 192);
+	TEST_EXPECT(engine.GetSoftwareRasterizer()->GetStatistics().numUpscaledPixels == 256 * 192);
+	const NullQueueStatistics statistics = static_cast<NullRHIDevice*>(engine.GetDevice())->GetNullGraphicsQueue().GetStatistics();
+	TEST_EXPECT(statistics.barrierMismatches == 0);
+	engine.OnDestroy();
+}
+
+BENCHMARK_CASE(Upscale_Throughput)
+{
+	// 1280x720 rendered, 1920x1080 presented
+	const uint32_t sourceWidth = 1280;
+	const uint32_t sourceHeight = 720;
+	const uint32_t destWidth = 1920;
+	const uint32_t destHeight = 1080;
+	const std::vector<uint32_t> source = RandomImage(sourceWidth, sourceHeight, 1);
+	std::vector<uint32_t> dest(size_t(destWidth) * destHeight);
+	JobSystem jobSystem;
+	const uint32_t numIterations = 10;
+	for (RHIUpscaleFilter filter : { RHIUpscaleFilter::Bilinear, RHIUpscaleFilter::CatmullRom })
+	{
+		for (JobSystem* pJobSystem : { static_cast<JobSystem*>(nullptr), &jobSystem })
+		{
+			BenchmarkTimer timer;
+			for (uint32_t i = 0; i < numIterations; i++)
+			{
+				UpscaleRGBA8(reinterpret_cast<const uint8_t*>(source.data()), sourceWidth * 4, { 0, 0, int32_t(sourceWidth), int32_t(sourceHeight) },
+					reinterpret_cast<uint8_t*>(dest.data()), destWidth * 4, { 0, 0, int32_t(destWidth), int32_t(destHeight) }, filter, pJobSystem);
+			}
+			char label[128];
+			snprintf(label, sizeof(label), "Upscale 720p to 1080p, %s, %s", filter == RHIUpscaleFilter::Bilinear ? "bilinear" : "Catmull-Rom",
+				pJobSystem ? "job system" : "one thread");
+			ReportBenchmark(label, timer.GetElapsedSeconds(), double(numIterations) * destWidth * destHeight, "px");
+		}
+	}
+
+	// Controller cost per frame, replaying a long jittered trace
+	std::mt19937 random(9);
+	std::uniform_real_distribution<double> frameSeconds(10e-3, 30e-3);
+	std::vector<double> trace(1000000);
+	for (double& seconds : trace)
+	{
+		seconds = frameSeconds(random);
+	}
+	DynamicResolutionController controller;
+	BenchmarkTimer timer;
+	const TraceReplay replay = ReplayTrace(controller, trace);
+	ReportBenchmark("DynamicResolutionController::Update", timer.GetElapsedSeconds(), double(trace.size()), "frame");
+	printf("    Mean scale %.3f\n", std::accumulate(replay.scales.begin(), replay.scales.end(), 0.0) / double(replay.scales.size()));
+}
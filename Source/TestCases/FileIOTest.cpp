@@ -0,0 +1,214 @@
+#include "TestFramework.h"
+#include "FileIO.h"
+#include "FileView.h"
+
+#include <filesystem>
+
+// Deterministic content, every 8 byte word encodes its own offset
+static void FillPattern(std::vector<uint8_t>& data, uint64_t baseOffset)
+{
+	for (size_t i = 0; i < data.size(); i += 8)
+	{
+		const uint64_t value = (baseOffset + i) * 0x9e3779b97f4a7c15ull;
+		memcpy(data.data() + i, &value, std::min<size_t>(8, data.size() - i));
+	}
+}
+
+static std::wstring GetTestFilePath(const char* name)
+{
+	return (std::filesystem::temp_directory_path() / (std::string("FileIOTest_") + name + ".bin")).wstring();
+}
+
+// Writes `size` bytes of the pattern in large blocks, removes the file on destruction
+struct TestFile
+{
+	TestFile(const char* name, uint64_t size) : fileName(GetTestFilePath(name))
+	{
+		File file;
+		file.Create(fileName);
+		std::vector<uint8_t> block;
+		constexpr uint64_t BlockSize = 64 * 1024 * 1024;
+		for (uint64_t offset = 0; offset < size; offset += BlockSize)
+		{
+			block.resize(size_t(std::min(BlockSize, size - offset)));
+			FillPattern(block, offset);
+			file.WriteAt(offset, block.data(), block.size());
+		}
+	}
+	~TestFile()
+	{
+		std::error_code error;
+		std::filesystem::remove(fileName, error);
+	}
+
+	std::wstring fileName;
+};
+
+static std::vector<uint8_t> MakePattern(uint64_t offset, uint64_t size)
+{
+	// Pattern words are aligned to absolute offsets, generate from the preceding word boundary
+	const uint64_t alignedOffset = offset & ~7ull;
+	std::vector<uint8_t> data(size_t(size + (offset - alignedOffset) + 8));
+	FillPattern(data, alignedOffset);
+	return std::vector<uint8_t>(data.begin() + (offset - alignedOffset), data.begin() + (offset - alignedOffset) + size);
+}
+
+TEST_CASE(File_PositionalReadsAndErrors)
+{
+	TestFile testFile("Positional", 100000);
+	File file;
+	file.Open(testFile.fileName);
+	TEST_EXPECT(file.GetSize() == 100000);
+
+	std::vector<uint8_t> data(777);
+	file.ReadAt(12345, data.data(), data.size());
+	TEST_EXPECT(data == MakePattern(12345, 777));
+	TEST_EXPECT(ReadWholeFile(testFile.fileName) == MakePattern(0, 100000));
+
+	bool bPastEndThrown = false;
+	try
+	{
+		file.ReadAt(99990, data.data(), 20);
+	}
+	catch (const FileIOException&)
+	{
+		bPastEndThrown = true;
+	}
+	TEST_EXPECT(bPastEndThrown);
+
+	// Missing files report the path, no bare std::exception
+	const std::wstring missing = GetTestFilePath("Missing");
+	bool bOpenThrown = false;
+	try
+	{
+		File missingFile;
+		missingFile.Open(missing);
+	}
+	catch (const FileIOException& exception)
+	{
+		bOpenThrown = std::string(exception.what()).find("FileIOTest_Missing") != std::string::npos;
+	}
+	TEST_EXPECT(bOpenThrown);
+
+	bool bMapThrown = false;
+	try
+	{
+		FileView view;
+		view.OpenOrThrow(missing);
+	}
+	catch (const FileIOException& exception)
+	{
+		bMapThrown = exception.GetErrorCode() != 0;
+	}
+	TEST_EXPECT(bMapThrown);
+}
+
+TEST_CASE(FileView_MapsWholeFile)
+{
+	TestFile testFile("Mapped", 3 * 4096 + 17);
+	FileView view;
+	view.OpenOrThrow(testFile.fileName);
+	view.Prefetch(4096, 1 << 20);
+	TEST_EXPECT(view.GetSize() == 3 * 4096 + 17);
+	const std::vector<uint8_t> expected = MakePattern(0, view.GetSize());
+	TEST_EXPECT(memcmp(view.GetData(), expected.data(), expected.size()) == 0);
+}
+
+TEST_CASE(AsyncFileReader_ChunkedReads)
+{
+	TestFile testFile("Async", 1000003);
+	File file;
+	file.Open(testFile.fileName);
+
+	AsyncFileReader reader(3, 4096);
+	std::vector<uint8_t> data(900000);
+	std::future<void> read = reader.ReadAsync(file, 100003, data.size(), data.data());
+	read.get();
+	TEST_EXPECT(data == MakePattern(100003, data.size()));
+	TEST_EXPECT(reader.GetStatistics().chunksRead == (data.size() + 4095) / 4096);
+
+	// Chunks arrive in order through the consumer
+	uint64_t expectedOffset = 0;
+	bool bMatches = true;
+	reader.Stream(file, 0, file.GetSize(), [&](uint64_t offset, const uint8_t* pData, uint64_t size)
+	{
+		bMatches &= offset == expectedOffset && memcmp(pData, MakePattern(offset, size).data(), size_t(size)) == 0;
+		expectedOffset += size;
+	});
+	TEST_EXPECT(bMatches && expectedOffset == file.GetSize());
+
+	// A failing chunk fails the whole read
+	std::future<void> pastEnd = reader.ReadAsync(file, file.GetSize() - 100, 20000, data.data());
+	bool bThrown = false;
+	try
+	{
+		pastEnd.get();
+	}
+	catch (const FileIOException&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+// Size can be changed with MODULETEST_FILE_BENCH_MB, reads mostly hit the page cache right after writing
+BENCHMARK_CASE(FileIO_LargeFileThroughput)
+{
+	uint64_t sizeInMB = 2048;
+	if (const char* pSize = getenv("MODULETEST_FILE_BENCH_MB"))
+	{
+		sizeInMB = std::max<uint64_t>(strtoull(pSize, nullptr, 10), 1);
+	}
+	const uint64_t size = sizeInMB * 1024 * 1024;
+
+	TestFile testFile("Benchmark", size);
+	File file;
+	file.Open(testFile.fileName);
+	std::vector<uint8_t> destination(static_cast<size_t>(size));
+
+	auto checksum = [](const uint8_t* pData, uint64_t size)
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i + 8 <= size; i += 4096)
+		{
+			uint64_t value;
+			memcpy(&value, pData + i, 8);
+			sum += value;
+		}
+		return sum;
+	};
+
+	{
+		BenchmarkTimer timer;
+		constexpr uint64_t ChunkSize = 8 * 1024 * 1024;
+		for (uint64_t offset = 0; offset < size; offset += ChunkSize)
+		{
+			file.ReadAt(offset, destination.data() + offset, std::min(ChunkSize, size - offset));
+		}
+		ReportBenchmark("File::ReadAt, 8MB chunks, 1 thread", timer.GetElapsedSeconds(), double(size), "B");
+	}
+	for (uint32_t numThreads : { 1u, 2u, 4u })
+	{
+		AsyncFileReader reader(numThreads);
+		BenchmarkTimer timer;
+		reader.ReadAsync(file, 0, size, destination.data()).get();
+		const std::string name = "AsyncFileReader::ReadAsync, " + std::to_string(numThreads) + " threads";
+		ReportBenchmark(name.c_str(), timer.GetElapsedSeconds(), double(size), "B");
+	}
+	{
+		AsyncFileReader reader(2);
+		uint64_t sum = 0;
+		BenchmarkTimer timer;
+		reader.Stream(file, 0, size, [&](uint64_t, const uint8_t* pData, uint64_t chunkSize) { sum += checksum(pData, chunkSize); });
+		ReportBenchmark("AsyncFileReader::Stream + page checksum", timer.GetElapsedSeconds(), double(size), "B");
+		TEST_EXPECT(sum != 0);
+	}
+	{
+		BenchmarkTimer timer;
+		FileView view;
+		view.OpenOrThrow(testFile.fileName);
+		const uint64_t sum = checksum(view.GetData(), view.GetSize());
+		ReportBenchmark("FileView map + touch every page", timer.GetElapsedSeconds(), double(size), "B");
+		TEST_EXPECT(sum != 0);
+	}
+}
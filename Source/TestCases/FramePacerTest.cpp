@@ -0,0 +1,213 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "FramePacer.h"
+
+#include <cmath>
+#include <random>
+
+static const double RefreshInterval = 1.0 / 60.0;
+
+static bool IsNear(double value, double expected, double tolerance)
+{
+	return std::abs(value - expected) <= tolerance;
+}
+
+// Frames of constant CPU work on the simulated display, statistics of the frames after a warm up
+static FramePacerStatistics RunFrames(FramePacer& pacer, SimulatedFramePacerClock& clock, uint32_t numFrames, double workSeconds)
+{
+	for (uint32_t frame = 0; frame < numFrames + 20; frame++)
+	{
+		if (frame == 20)
+		{
+			pacer.ResetStatistics();
+		}
+		pacer.BeginFrame();
+		clock.Advance(workSeconds);
+		pacer.EndFrame();
+	}
+	return pacer.GetStatistics();
+}
+
+TEST_CASE(FramePacer_VsyncFillsTheFlipQueue)
+{
+	SimulatedFramePacerClock clock;
+	FramePacer pacer(&clock);
+	TEST_EXPECT(pacer.GetPresent().syncInterval == 1 && pacer.GetPresent().flags == RHIPresentFlagNone);
+
+	const FramePacerStatistics statistics = RunFrames(pacer, clock, 100, 2e-3);
+	TEST_EXPECT(statistics.numFrames == 100 && statistics.maxQueuedFrames == FramePacerDefaultFrameLatency);
+	TEST_EXPECT(IsNear(statistics.frameTimes.GetMeanSeconds(), RefreshInterval, 1e-6));
+	// Three frames ahead of the display
+	TEST_EXPECT(IsNear(statistics.latencies.GetMeanSeconds(), 3.0 * RefreshInterval, 1e-6));
+	TEST_EXPECT(statistics.numThrottledFrames == 100 && clock.GetSleptSeconds() > 0.0);
+}
+
+TEST_CASE(FramePacer_LatencyWaitableBoundsTheQueue)
+{
+	SimulatedFramePacerClock clock;
+	FramePacingSettings settings;
+	settings.mode = PresentMode::LatencyWaitable;
+	settings.maxFrameLatency = 1;
+	FramePacer pacer(&clock, settings);
+
+	FramePacerStatistics statistics = RunFrames(pacer, clock, 100, 2e-3);
+	TEST_EXPECT(statistics.maxQueuedFrames == 1);
+	TEST_EXPECT(IsNear(statistics.frameTimes.GetMeanSeconds(), RefreshInterval, 1e-6));
+	// Starts right at the vblank, scans out at the next one
+	TEST_EXPECT(IsNear(statistics.latencies.GetMeanSeconds(), RefreshInterval, 1e-6));
+
+	settings.maxFrameLatency = 2;
+	pacer.SetSettings(settings);
+	statistics = RunFrames(pacer, clock, 100, 2e-3);
+	TEST_EXPECT(statistics.maxQueuedFrames == 2 && IsNear(statistics.latencies.GetMeanSeconds(), 2.0 * RefreshInterval, 1e-6));
+}
+
+TEST_CASE(FramePacer_UncappedTears)
+{
+	SimulatedFramePacerClock clock;
+	FramePacingSettings settings;
+	settings.mode = PresentMode::Uncapped;
+	FramePacer pacer(&clock, settings);
+	pacer.BeginFrame();
+	TEST_EXPECT(pacer.GetPresent().syncInterval == 0 && pacer.GetPresent().flags == RHIPresentFlagAllowTearing);
+	pacer.EndFrame();
+
+	const FramePacerStatistics statistics = RunFrames(pacer, clock, 100, 2e-3);
+	TEST_EXPECT(statistics.numThrottledFrames == 0 && statistics.maxQueuedFrames == 0);
+	TEST_EXPECT(IsNear(statistics.frameTimes.GetMeanSeconds(), 2e-3, 1e-9) && IsNear(statistics.latencies.GetMaxSeconds(), 2e-3, 1e-9));
+}
+
+TEST_CASE(FramePacer_FrameCapKeepsCadence)
+{
+	SimulatedFramePacerClock clock;
+	FramePacingSettings settings;
+	settings.mode = PresentMode::FrameCap;
+	settings.frameCapRate = 100.0;
+	FramePacer pacer(&clock, settings);
+
+	FramePacerStatistics statistics = RunFrames(pacer, clock, 100, 2e-3);
+	TEST_EXPECT(IsNear(statistics.frameTimes.GetMeanSeconds(), 10e-3, 1e-9) && IsNear(statistics.frameTimes.GetMaxSeconds(), 10e-3, 1e-9));
+	TEST_EXPECT(IsNear(statistics.latencies.GetMeanSeconds(), 2e-3, 1e-9) && statistics.numThrottledFrames == 100);
+
+	// Over budget, frames run back to back instead of bursting to catch up
+	statistics = RunFrames(pacer, clock, 100, 25e-3);
+	TEST_EXPECT(IsNear(statistics.frameTimes.GetMinSeconds(), 25e-3, 1e-9) && IsNear(statistics.frameTimes.GetMaxSeconds(), 25e-3, 1e-9));
+}
+
+TEST_CASE(FramePacer_SwitchesModesAtRuntime)
+{
+	SimulatedFramePacerClock clock;
+	FramePacer pacer(&clock);
+	RunFrames(pacer, clock, 30, 1e-3);
+	TEST_EXPECT(pacer.GetQueuedFrames() == 3);
+
+	FramePacingSettings settings;
+	settings.mode = PresentMode::Uncapped;
+	pacer.SetSettings(settings);
+	// The frames already queued still scan out first
+	pacer.BeginFrame();
+	clock.Advance(1e-3);
+	pacer.EndFrame();
+	TEST_EXPECT(pacer.GetLastFrameLatency() > RefreshInterval);
+	clock.Advance(0.1);
+	const FramePacerStatistics statistics = RunFrames(pacer, clock, 100, 1e-3);
+	TEST_EXPECT(IsNear(statistics.latencies.GetMeanSeconds(), 1e-3, 1e-9) && pacer.GetQueuedFrames() == 0);
+}
+
+TEST_CASE(FramePacer_Histogram)
+{
+	FrameTimeHistogram histogram;
+	TEST_EXPECT(histogram.GetPercentileSeconds(99.0) == 0.0);
+	for (uint32_t i = 0; i < 98; i++)
+	{
+		histogram.Add(16.6e-3);
+	}
+	histogram.Add(33.3e-3);
+	histogram.Add(1.0);
+	TEST_EXPECT(histogram.GetCount() == 100 && histogram.GetBucketCount(66) == 98 && histogram.GetBucketCount(FrameTimeHistogram::NumBuckets - 1) == 1);
+	TEST_EXPECT(IsNear(histogram.GetPercentileSeconds(50.0), 16.75e-3, 1e-9) && IsNear(histogram.GetPercentileSeconds(99.0), 33.5e-3, 1e-9));
+	TEST_EXPECT(histogram.GetMaxSeconds() == 1.0 && histogram.GetPercentileSeconds(100.0) == 1.0 && histogram.GetMinSeconds() == 16.6e-3);
+	const std::string text = histogram.Format("Frame time");
+	TEST_EXPECT(text.find("16.50- 16.75 ms") != std::string::npos && text.find(">") != std::string::npos);
+}
+
+TEST_CASE(FramePacer_PreciseSleep)
+{
+	RealFramePacerClock clock;
+	double totalOvershoot = 0.0;
+	for (uint32_t i = 0; i < 20; i++)
+	{
+		const double target = clock.Now() + 3e-3;
+		clock.SleepUntil(target);
+		const double overshoot = clock.Now() - target;
+		TEST_EXPECT(overshoot >= 0.0);
+		totalOvershoot += overshoot;
+	}
+	// Spinning the last stretch, only preemption can delay the wake up
+	TEST_EXPECT(totalOvershoot / 20.0 < 2e-3);
+}
+
+TEST_CASE(FramePacer_PacesEngineFrames)
+{
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("FramePacer_PacesEngineFrames"));
+	engine.OnInit();
+	// Vsync by default, the simulated display makes it cost no real time
+	const auto start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < 30; frame++)
+	{
+		engine.OnUpdate();
+	}
+	const double realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const FramePacerStatistics& statistics = engine.GetFramePacer()->GetStatistics();
+	TEST_EXPECT(statistics.numFrames == 30 && statistics.maxQueuedFrames == FramePacerDefaultFrameLatency);
+	TEST_EXPECT(statistics.frameTimes.GetPercentileSeconds(50.0) >= RefreshInterval && realSeconds < 29 * RefreshInterval);
+
+	engine.OnKeyDown('P');
+	TEST_EXPECT(engine.GetFramePacer()->GetSettings().mode == PresentMode::Vsync);
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetFramePacer()->GetSettings().mode == PresentMode::Uncapped);
+	engine.OnDestroy();
+}
+
+// Jittered CPU work on the simulated display, the histograms of every mode side by side
+BENCHMARK_CASE(FramePacer_Modes)
+{
+	const PresentMode modes[] = { PresentMode::Vsync, PresentMode::LatencyWaitable, PresentMode::Uncapped, PresentMode::FrameCap };
+	for (PresentMode mode : modes)
+	{
+		SimulatedFramePacerClock clock;
+		FramePacingSettings settings;
+		settings.mode = mode;
+		settings.frameCapRate = 90.0;
+		FramePacer pacer(&clock, settings);
+		std::mt19937 random(7);
+		std::uniform_real_distribution<double> work(4e-3, 9e-3);
+		for (uint32_t frame = 0; frame < 2000; frame++)
+		{
+			pacer.BeginFrame();
+			// Occasional spikes over one refresh
+			clock.Advance(frame % 100 == 50 ? 24e-3 : work(random));
+			pacer.EndFrame();
+		}
+		printf("%s\n", pacer.FormatReport().c_str());
+	}
+
+	RealFramePacerClock realClock;
+	double maxOvershoot = 0.0;
+	double totalOvershoot = 0.0;
+	const uint32_t numSleeps = 200;
+	BenchmarkTimer timer;
+	for (uint32_t i = 0; i < numSleeps; i++)
+	{
+		const double target = realClock.Now() + 5e-3;
+		realClock.SleepUntil(target);
+		const double overshoot = realClock.Now() - target;
+		maxOvershoot = std::max(maxOvershoot, overshoot);
+		totalOvershoot += overshoot;
+	}
+	ReportBenchmark("Precise 5 ms sleeps", timer.GetElapsedSeconds(), double(numSleeps), "sleep");
+	printf("    Wake up late by %.1f us on average, %.1f us at most, sleeping while more than %.2f ms remain\n",
+		totalOvershoot / numSleeps * 1e6, maxOvershoot * 1e6, realClock.GetSleepEstimate() * 1e3);
+}
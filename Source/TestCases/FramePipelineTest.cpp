@@ -0,0 +1,109 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "NullRHI.h"
+#include "FramePipeline.h"
+#include "Engine.h"
+
+#include <thread>
+
+// Runs `numFrames` frames with simulated CPU and GPU cost
+static FramePipelineStatistics RunSimulatedFrames(uint32_t maxFramesInFlight, uint32_t numFrames, std::chrono::microseconds cpuCost, std::chrono::microseconds gpuCost)
+{
+	NullRHIDevice device;
+	NullGpuCostModel costModel;
+	costModel.perCommandList = gpuCost;
+	device.GetNullGraphicsQueue().SetCostModel(costModel);
+
+	FramePipeline pipeline(&device, maxFramesInFlight);
+	auto commandList = device.CreateCommandList();
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		pipeline.BeginFrame();
+		commandList->Begin(pipeline.GetCommandAllocator());
+		// Scene update and recording
+		std::this_thread::sleep_for(cpuCost);
+		commandList->DrawInstanced(3, 1, 0, 0);
+		commandList->Close();
+		RHICommandList* ppCommandLists[] = { commandList.get() };
+		device.GetGraphicsQueue()->ExecuteCommandLists(1, ppCommandLists);
+		pipeline.EndFrame(device.GetGraphicsQueue());
+		TEST_EXPECT(pipeline.GetFramesInFlight() <= maxFramesInFlight);
+	}
+	pipeline.WaitForIdle(device.GetGraphicsQueue());
+	return pipeline.GetStatistics();
+}
+
+TEST_CASE(FramePipeline_SlotReuseWaitsForFence)
+{
+	NullRHIDevice device;
+	NullGpuCostModel costModel;
+	costModel.perCommandList = std::chrono::milliseconds(5);
+	device.GetNullGraphicsQueue().SetCostModel(costModel);
+
+	FramePipeline pipeline(&device, 2);
+	auto commandList = device.CreateCommandList();
+	for (int frame = 0; frame < 6; frame++)
+	{
+		// Would throw inside if the allocator were still in flight
+		pipeline.BeginFrame();
+		commandList->Begin(pipeline.GetCommandAllocator());
+		commandList->Close();
+		RHICommandList* ppCommandLists[] = { commandList.get() };
+		device.GetGraphicsQueue()->ExecuteCommandLists(1, ppCommandLists);
+		pipeline.EndFrame(device.GetGraphicsQueue());
+	}
+	// CPU is much faster than the simulated GPU, so it must have been throttled
+	TEST_EXPECT(pipeline.GetStatistics().numStalls > 0);
+	pipeline.WaitForIdle(device.GetGraphicsQueue());
+	TEST_EXPECT(pipeline.GetFramesInFlight() == 0);
+}
+
+TEST_CASE(FramePipeline_OverlapsCpuAndGpu)
+{
+	const auto cost = std::chrono::milliseconds(3);
+	FramePipelineStatistics serialized = RunSimulatedFrames(1, 20, cost, cost);
+	FramePipelineStatistics pipelined = RunSimulatedFrames(2, 20, cost, cost);
+	// Ideal is 0.5, leave room for scheduler noise
+	TEST_EXPECT(pipelined.wallSeconds < serialized.wallSeconds * 0.8);
+}
+
+TEST_CASE(Engine_MaxFramesInFlight)
+{
+	for (uint32_t maxFramesInFlight = 1; maxFramesInFlight <= FrameCount; maxFramesInFlight++)
+	{
+		Engine engine(64, 64, L"Headless", RHIBackend::Null);
+		engine.SetMaxFramesInFlight(maxFramesInFlight);
+		engine.SetPipelineCachePath(GetTestPipelineCachePath("Engine_MaxFramesInFlight"));
+		engine.OnInit();
+		for (int i = 0; i < 10; i++)
+		{
+			engine.OnUpdate();
+		}
+		engine.OnDestroy();
+		TEST_EXPECT(engine.GetFramePipeline()->GetMaxFramesInFlight() == maxFramesInFlight);
+		TEST_EXPECT(engine.GetFramePipeline()->GetStatistics().numFrames == 10);
+	}
+}
+
+BENCHMARK_CASE(FramePipeline_CpuGpuOverlap)
+{
+	const auto cost = std::chrono::milliseconds(2);
+	const uint32_t numFrames = 100;
+	double serializedSeconds = 0.0;
+	for (uint32_t maxFramesInFlight = 1; maxFramesInFlight <= FrameCount; maxFramesInFlight++)
+	{
+		FramePipelineStatistics statistics = RunSimulatedFrames(maxFramesInFlight, numFrames, cost, cost);
+		if (maxFramesInFlight == 1)
+		{
+			serializedSeconds = statistics.wallSeconds;
+		}
+		// With equal CPU and GPU cost, 0% when they take turns and 100% when frame time halves
+		const double overlap = (serializedSeconds - statistics.wallSeconds) / (serializedSeconds * 0.5);
+		printf("    frames in flight %u: %8.3f ms/frame, stalls %4llu, cpu wait %8.3f ms, overlap %5.1f%%\n",
+			maxFramesInFlight,
+			statistics.wallSeconds / numFrames * 1000.0,
+			static_cast<unsigned long long>(statistics.numStalls),
+			statistics.cpuWaitSeconds * 1000.0,
+			overlap * 100.0);
+	}
+}
@@ -0,0 +1,215 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Camera.h"
+#include "Engine.h"
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <random>
+
+static Camera MakeTestCamera()
+{
+	Camera camera;
+	camera.position = { 0.0f, 2.0f, -10.0f };
+	camera.forward = { 0.3f, -0.1f, 1.0f };
+	camera.farZ = 300.0f;
+	return camera;
+}
+
+// Boxes and their enclosing spheres scattered around the view frustum, most of them outside of it
+static CullingBounds MakeRandomBounds(uint32_t count, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> horizontal(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> vertical(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> depth(-100.0f, 400.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 8.0f);
+
+	CullingBounds bounds;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Float3 center = { horizontal(random), vertical(random), depth(random) };
+		const Float3 halfSize = { extent(random), extent(random), extent(random) };
+		bounds.Add({ center, Length(halfSize) }, { center - halfSize, center + halfSize });
+	}
+	return bounds;
+}
+
+enum ReferenceResult
+{
+	ReferenceCulled,
+	ReferenceVisible,
+	ReferenceAmbiguous,		// Within rounding of a plane, kernels may go either way
+};
+
+static ReferenceResult CullReference(const CullingBounds& bounds, const Frustum& frustum, uint32_t object)
+{
+	auto field = [&](FrustumCullingField f) { return double(bounds.fields[f][object]); };
+	double minDistance = 1e30;
+	for (const Float4& plane : frustum.planes)
+	{
+		const double center = plane.x * field(CullingSphereX) + plane.y * field(CullingSphereY) + plane.z * field(CullingSphereZ) + plane.w;
+		const double boxCenter = plane.x * field(CullingBoxCenterX) + plane.y * field(CullingBoxCenterY) + plane.z * field(CullingBoxCenterZ) + plane.w;
+		const double boxExtent = std::abs(plane.x) * field(CullingBoxExtentX) + std::abs(plane.y) * field(CullingBoxExtentY) + std::abs(plane.z) * field(CullingBoxExtentZ);
+		minDistance = std::min({ minDistance, center + field(CullingSphereRadius), boxCenter + boxExtent });
+	}
+	if (std::abs(minDistance) < 1e-3)
+	{
+		return ReferenceAmbiguous;
+	}
+	return minDistance < 0.0 ? ReferenceCulled : ReferenceVisible;
+}
+
+static std::vector<SimdLevel> GetTestedSimdLevels()
+{
+	std::vector<SimdLevel> levels;
+	for (uint8_t level = 0; level <= uint8_t(GetSupportedSimdLevel()); level++)
+	{
+		levels.push_back(SimdLevel(level));
+	}
+	return levels;
+}
+
+TEST_CASE(FrustumCulling_ExtractsPlanes)
+{
+	Camera camera;
+	camera.aspectRatio = 1.0f;
+	camera.farZ = 100.0f;
+	const Frustum frustum = ExtractFrustumPlanes(camera.GetViewProjectionMatrix());
+	auto distance = [&](uint32_t plane, const Float3& p) { return Dot({ frustum.planes[plane].x, frustum.planes[plane].y, frustum.planes[plane].z }, p) + frustum.planes[plane].w; };
+
+	for (uint32_t plane = 0; plane < 6; plane++)
+	{
+		TEST_EXPECT(std::abs(Length({ frustum.planes[plane].x, frustum.planes[plane].y, frustum.planes[plane].z }) - 1.0f) < 1e-5f);
+		TEST_EXPECT(distance(plane, { 0.0f, 0.0f, 10.0f }) > 0.0f);
+	}
+	TEST_EXPECT(std::abs(distance(4, { 0.0f, 0.0f, 0.1f })) < 1e-4f);
+	TEST_EXPECT(std::abs(distance(5, { 0.0f, 0.0f, 100.0f })) < 1e-3f);
+	TEST_EXPECT(std::abs(distance(1, { std::tan(camera.fovY * 0.5f) * 10.0f, 0.0f, 10.0f })) < 1e-4f);
+	TEST_EXPECT(distance(0, { -20.0f, 0.0f, 10.0f }) < 0.0f);
+	TEST_EXPECT(distance(3, { 0.0f, 20.0f, 10.0f }) < 0.0f);
+}
+
+TEST_CASE(FrustumCulling_CullsObjects)
+{
+	JobSystem jobSystem(1);
+	Camera camera;
+	camera.aspectRatio = 1.0f;
+	camera.farZ = 100.0f;
+	const Frustum frustum = ExtractFrustumPlanes(camera.GetViewProjectionMatrix());
+
+	CullingBounds bounds;
+	auto add = [&](const Float3& center, float halfSize) { bounds.Add({ center, halfSize * 1.7320508f }, { center - Float3{ halfSize, halfSize, halfSize }, center + Float3{ halfSize, halfSize, halfSize } }); };
+	add({ 0.0f, 0.0f, 10.0f }, 1.0f);		// In front
+	add({ 0.0f, 0.0f, -10.0f }, 1.0f);		// Behind
+	add({ 0.0f, 0.0f, 150.0f }, 1.0f);		// Beyond the far plane
+	add({ 8.0f, 0.0f, 10.0f }, 1.0f);		// Off screen
+	add({ 6.2f, 0.0f, 10.0f }, 1.0f);		// Straddles the right plane
+	// Sphere touches the frustum near a corner but the box does not
+	const float edge = std::tan(camera.fovY * 0.5f) * 50.0f;
+	bounds.Add({ { edge + 3.0f, edge + 3.0f, 50.0f }, 5.0f }, { { edge + 1.0f, edge + 1.0f, 49.0f }, { edge + 5.0f, edge + 5.0f, 51.0f } });
+	TEST_EXPECT(bounds.GetNumObjects() == 6 && bounds.GetPaddedNumObjects() == CullingBounds::Padding);
+
+	for (const SimdLevel level : GetTestedSimdLevels())
+	{
+		FrustumCuller culler(&jobSystem);
+		culler.SetSimdLevel(level);
+		culler.Cull(bounds, frustum);
+		TEST_EXPECT(culler.GetVisibleIndices() == std::vector<uint32_t>({ 0, 4 }));
+
+		// Moved objects are picked up on the next cull
+		CullingBounds moved = bounds;
+		moved.Set(1, { { 0.0f, 0.0f, 20.0f }, 1.0f }, { { -0.5f, -0.5f, 19.5f }, { 0.5f, 0.5f, 20.5f } });
+		culler.Cull(moved, frustum);
+		TEST_EXPECT(culler.GetVisibleIndices() == std::vector<uint32_t>({ 0, 1, 4 }));
+
+		moved.Clear();
+		culler.Cull(moved, frustum);
+		TEST_EXPECT(culler.GetVisibleIndices().empty());
+	}
+}
+
+TEST_CASE(FrustumCulling_MatchesReference)
+{
+	// Several chunks and a partial last one, on multiple threads
+	JobSystem jobSystem(2);
+	const Camera camera = MakeTestCamera();
+	const Frustum frustum = ExtractFrustumPlanes(camera.GetViewProjectionMatrix());
+	const CullingBounds bounds = MakeRandomBounds(FrustumCuller::ChunkSize * 3 + 1234, 1);
+
+	std::vector<ReferenceResult> reference(bounds.GetNumObjects());
+	uint32_t numVisible = 0;
+	for (uint32_t object = 0; object < bounds.GetNumObjects(); object++)
+	{
+		reference[object] = CullReference(bounds, frustum, object);
+		numVisible += reference[object] == ReferenceVisible;
+	}
+	TEST_EXPECT(numVisible > 100 && numVisible < bounds.GetNumObjects() / 2);
+
+	for (const SimdLevel level : GetTestedSimdLevels())
+	{
+		FrustumCuller culler(&jobSystem);
+		culler.SetSimdLevel(level);
+		TEST_EXPECT(culler.GetSimdLevel() == level);
+		culler.Cull(bounds, frustum);
+
+		// Ascending, and every object the reference is sure about is where it belongs
+		const std::vector<uint32_t>& visible = culler.GetVisibleIndices();
+		TEST_EXPECT(std::adjacent_find(visible.begin(), visible.end(), std::greater_equal<uint32_t>()) == visible.end());
+		std::vector<bool> bVisible(bounds.GetNumObjects(), false);
+		for (const uint32_t object : visible)
+		{
+			TEST_EXPECT(object < bounds.GetNumObjects());
+			bVisible[object] = true;
+		}
+		for (uint32_t object = 0; object < bounds.GetNumObjects(); object++)
+		{
+			TEST_EXPECT(reference[object] == ReferenceAmbiguous || bVisible[object] == (reference[object] == ReferenceVisible));
+		}
+	}
+}
+
+TEST_CASE(FrustumCulling_EngineFrame)
+{
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("FrustumCulling_EngineFrame"));
+	engine.OnInit();
+	engine.GetObjectBounds().Add({ { 0.0f, 0.0f, 10.0f }, 1.0f }, { { -0.5f, -0.5f, 9.5f }, { 0.5f, 0.5f, 10.5f } });
+	engine.GetObjectBounds().Add({ { 0.0f, 0.0f, -10.0f }, 1.0f }, { { -0.5f, -0.5f, -10.5f }, { 0.5f, 0.5f, -9.5f } });
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetFrustumCuller()->GetVisibleIndices() == std::vector<uint32_t>({ 0 }));
+
+	engine.GetCamera().forward = { 0.0f, 0.0f, -1.0f };
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetFrustumCuller()->GetVisibleIndices() == std::vector<uint32_t>({ 1 }));
+	engine.OnDestroy();
+}
+
+BENCHMARK_CASE(FrustumCulling_Cull)
+{
+	JobSystem jobSystem;
+	const Camera camera = MakeTestCamera();
+	const Frustum frustum = ExtractFrustumPlanes(camera.GetViewProjectionMatrix());
+	for (const uint32_t numObjects : { 100000u, 1000000u })
+	{
+		const CullingBounds bounds = MakeRandomBounds(numObjects, 2);
+		for (const SimdLevel level : GetTestedSimdLevels())
+		{
+			FrustumCuller culler(&jobSystem);
+			culler.SetSimdLevel(level);
+			culler.Cull(bounds, frustum);
+
+			const uint32_t numIterations = 20;
+			BenchmarkTimer timer;
+			for (uint32_t i = 0; i < numIterations; i++)
+			{
+				culler.Cull(bounds, frustum);
+			}
+			const double seconds = timer.GetElapsedSeconds();
+			char name[128];
+			snprintf(name, sizeof(name), "%u objects, %s, %zu visible", numObjects, GetSimdLevelName(level), culler.GetVisibleIndices().size());
+			ReportBenchmark(name, seconds, double(numObjects) * numIterations, "object");
+			printf("    %.3f ms per frame\n", seconds * 1000.0 / numIterations);
+		}
+	}
+}
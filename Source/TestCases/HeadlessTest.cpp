@@ -0,0 +1,264 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "FileIO.h"
+#include "HdrImage.h"
+#include "ImageSequence.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+static std::filesystem::path MakeOutputDirectory(const char* name)
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / name;
+	std::filesystem::remove_all(directory);
+	return directory;
+}
+
+// Wide copies of literal arguments, argv[0] is the program
+struct TestCommandLine
+{
+	TestCommandLine(std::initializer_list<std::wstring> arguments)
+		: TestCommandLine(std::vector<std::wstring>(arguments))
+	{
+	}
+
+	explicit TestCommandLine(std::vector<std::wstring> arguments)
+		: args(std::move(arguments))
+	{
+		for (std::wstring& arg : args)
+		{
+			argv.push_back(arg.data());
+		}
+	}
+
+	TestCommandLine(const TestCommandLine&) = delete;
+	TestCommandLine& operator=(const TestCommandLine&) = delete;
+
+	std::vector<std::wstring>	args;
+	std::vector<wchar_t*>		argv;
+};
+
+TEST_CASE(ImageSequence_Paths)
+{
+	TEST_EXPECT(GetImageSequencePath(L"Frames/Preview_####.ppm", 7) == L"Frames/Preview_0007.ppm");
+	TEST_EXPECT(GetImageSequencePath(L"Frames/Preview_##.ppm", 1234) == L"Frames/Preview_1234.ppm");
+	// Only the last run of the file name is replaced
+	TEST_EXPECT(GetImageSequencePath(L"Take#1/Shot_#_###.hdr", 5) == L"Take#1/Shot_#_005.hdr");
+	TEST_EXPECT(GetImageSequencePath(L"Take#1/Shot.hdr", 12) == L"Take#1/Shot_0012.hdr");
+
+	TEST_EXPECT(GetImageFileFormat(L"a.PPM") == ImageFileFormat::Ppm);
+	TEST_EXPECT(GetImageFileFormat(L"a.hdr") == ImageFileFormat::Hdr);
+	bool bThrown = false;
+	try
+	{
+		GetImageFileFormat(L"a.png");
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+TEST_CASE(ImageSequence_WritesFormats)
+{
+	// 3x2 with padded rows, as render targets may have them
+	const uint32_t width = 3;
+	const uint32_t height = 2;
+	const uint32_t rowPitch = 16;
+	std::vector<uint8_t> pixels(rowPitch * height, 0xcd);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t rgba[] = { uint8_t(x * 100), uint8_t(y * 255), uint8_t(17 + x + y), 255 };
+			memcpy(&pixels[y * rowPitch + x * 4], rgba, 4);
+		}
+	}
+
+	const std::filesystem::path directory = MakeOutputDirectory("ImageSequenceTest");
+	JobSystem jobSystem(2);
+	{
+		ImageSequenceWriter writer(&jobSystem, (directory / "Frame_##.ppm").wstring());
+		writer.Write(3, pixels.data(), rowPitch, width, height);
+		writer.Flush();
+		TEST_EXPECT(writer.GetNumWritten() == 1);
+	}
+	const std::vector<uint8_t> ppm = ReadWholeFile((directory / "Frame_03.ppm").wstring());
+	const char header[] = "P6\n3 2\n255\n";
+	TEST_EXPECT(ppm.size() == strlen(header) + width * height * 3 && memcmp(ppm.data(), header, strlen(header)) == 0);
+	const uint8_t* pRgb = ppm.data() + strlen(header);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			TEST_EXPECT(memcmp(pRgb + (y * width + x) * 3, &pixels[y * rowPitch + x * 4], 3) == 0);
+		}
+	}
+
+	// Linear, RGBE keeps 8 bits of mantissa for the brightest channel
+	WriteImageRGBA8((directory / "Frame.hdr").wstring(), pixels.data(), rowPitch, width, height);
+	const HdrImage hdr = ReadHdrImage((directory / "Frame.hdr").wstring());
+	TEST_EXPECT(hdr.width == width && hdr.height == height);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t* pPixel = &pixels[y * rowPitch + x * 4];
+			const Float3& value = hdr.GetPixel(x, y);
+			TEST_EXPECT(std::fabs(value.x - pPixel[0] / 255.0f) < 0.01f && std::fabs(value.y - pPixel[1] / 255.0f) < 0.01f && std::fabs(value.z - pPixel[2] / 255.0f) < 0.01f);
+		}
+	}
+
+	// Failures of the jobs surface in Flush()
+	ImageSequenceWriter writer(&jobSystem, (directory / "Frame_##.ppm").wstring());
+	std::filesystem::remove_all(directory);
+	writer.Write(0, pixels.data(), rowPitch, width, height);
+	bool bThrown = false;
+	try
+	{
+		writer.Flush();
+	}
+	catch (const FileIOException&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown && writer.GetNumWritten() == 0);
+}
+
+TEST_CASE(Engine_CommandLine)
+{
+	TestCommandLine commandLine = { L"LightingEffects", L"--headless", L"--frames", L"12", L"--size", L"64x48", L"--scene", L"Baked", L"--output", L"Frames/Preview_####.ppm" };
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	TEST_EXPECT(engine.ParseCommandLineArgs(commandLine.argv.data(), int32_t(commandLine.argv.size())));
+	TEST_EXPECT(engine.IsHeadless());
+	TEST_EXPECT(engine.GetWidth() == 64 && engine.GetHeight() == 48);
+
+	Engine windowed(320, 240, L"Headless", RHIBackend::Null);
+	TestCommandLine noArguments = { L"LightingEffects" };
+	TEST_EXPECT(windowed.ParseCommandLineArgs(noArguments.argv.data(), int32_t(noArguments.argv.size())) && !windowed.IsHeadless());
+
+	// Unknown options, missing or malformed values
+	for (const wchar_t* pBadArgument : { L"--fullscreen", L"--frames", L"--size" })
+	{
+		TestCommandLine badCommandLine = { L"LightingEffects", pBadArgument };
+		TEST_EXPECT(!windowed.ParseCommandLineArgs(badCommandLine.argv.data(), int32_t(badCommandLine.argv.size())));
+	}
+	TestCommandLine zeroSize = { L"LightingEffects", L"--size", L"0x48" };
+	TEST_EXPECT(!windowed.ParseCommandLineArgs(zeroSize.argv.data(), int32_t(zeroSize.argv.size())));
+	TestCommandLine zeroFrames = { L"LightingEffects", L"--frames", L"0" };
+	TEST_EXPECT(!windowed.ParseCommandLineArgs(zeroFrames.argv.data(), int32_t(zeroFrames.argv.size())));
+	// Signs and trailing characters are not numbers, sizes beyond the software rasterizer range are rejected
+	for (const wchar_t* pBadFrames : { L"-1", L"+3", L" 3", L"3x", L"99999999999" })
+	{
+		TestCommandLine badFrames = { L"LightingEffects", L"--frames", pBadFrames };
+		TEST_EXPECT(!windowed.ParseCommandLineArgs(badFrames.argv.data(), int32_t(badFrames.argv.size())));
+	}
+	for (const wchar_t* pBadSize : { L"64x48junk", L"64x-48", L"-64x48", L"64", L"64x", L"7000x64", L"64x6145" })
+	{
+		TestCommandLine badSize = { L"LightingEffects", L"--size", pBadSize };
+		TEST_EXPECT(!windowed.ParseCommandLineArgs(badSize.argv.data(), int32_t(badSize.argv.size())));
+	}
+	TestCommandLine maxSize = { L"LightingEffects", L"--size", L"6144x6144" };
+	Engine largest(320, 240, L"Headless", RHIBackend::Null);
+	TEST_EXPECT(largest.ParseCommandLineArgs(maxSize.argv.data(), int32_t(maxSize.argv.size())));
+	TEST_EXPECT(largest.GetWidth() == 6144 && largest.GetHeight() == 6144);
+	TEST_EXPECT(windowed.GetWidth() == 320 && windowed.GetHeight() == 240);
+}
+
+TEST_CASE(Engine_HeadlessRun)
+{
+	// More frames than frames in flight, so targets are read back while rendering continues
+	const std::filesystem::path directory = MakeOutputDirectory("HeadlessTest");
+	const uint32_t numFrames = 7;
+	TestCommandLine commandLine = { L"LightingEffects", L"--headless", L"--frames", std::to_wstring(numFrames), L"--size", L"160x120",
+		L"--output", (directory / "Preview_###.ppm").wstring() };
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("Engine_HeadlessRun"));
+	TEST_EXPECT(engine.ParseCommandLineArgs(commandLine.argv.data(), int32_t(commandLine.argv.size())));
+	TEST_EXPECT(engine.RunHeadless() == 0);
+
+	TEST_EXPECT(engine.GetSwapChain() == nullptr);
+	TEST_EXPECT(engine.GetDevice()->GetBackend() == RHIBackend::Null);
+	TEST_EXPECT(engine.GetSoftwareRasterizer() != nullptr && engine.GetSoftwareRasterizer()->GetStatistics().numDraws == numFrames);
+	const NullQueueStatistics statistics = static_cast<NullRHIDevice*>(engine.GetDevice())->GetNullGraphicsQueue().GetStatistics();
+	TEST_EXPECT(statistics.barrierMismatches == 0);
+
+	const HeadlessStatistics& headless = engine.GetHeadlessStatistics();
+	TEST_EXPECT(headless.numFrames == numFrames && headless.numImagesWritten == numFrames);
+	TEST_EXPECT(headless.width == 160 && headless.height == 120);
+	TEST_EXPECT(headless.seconds > 0.0 && headless.GetFramesPerSecond() > 0.0);
+	const std::string report = headless.FormatReport();
+	TEST_EXPECT(report.find("7 frames at 160x120") != std::string::npos && report.find(" fps") != std::string::npos);
+#if ENABLE_PROFILER
+	TEST_EXPECT(report.find("RecordAndSubmit") != std::string::npos && report.find("ReadBackOutput") != std::string::npos);
+	TEST_EXPECT(report.find("Engine::OnInit") == std::string::npos);
+#endif
+
+	// Every frame has its file, the last one matches what is left in its target
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		TEST_EXPECT(std::filesystem::exists(GetImageSequencePath((directory / "Preview_###.ppm").wstring(), frame)));
+	}
+	const std::vector<uint8_t> ppm = ReadWholeFile((directory / "Preview_006.ppm").wstring());
+	const char header[] = "P6\n160 120\n255\n";
+	TEST_EXPECT(ppm.size() == strlen(header) + 160 * 120 * 3 && memcmp(ppm.data(), header, strlen(header)) == 0);
+	const uint8_t* pTarget = static_cast<NullResource*>(engine.GetOutputTarget())->GetData();
+	uint32_t numMismatches = 0;
+	for (uint32_t i = 0; i < 160 * 120; i++)
+	{
+		numMismatches += memcmp(ppm.data() + strlen(header) + i * 3, pTarget + i * 4, 3) != 0;
+	}
+	TEST_EXPECT(numMismatches == 0);
+	// Clear color in the corner, the triangle in the center
+	const uint8_t* pCorner = ppm.data() + strlen(header);
+	const uint8_t* pCenter = pCorner + (60 * 160 + 80) * 3;
+	TEST_EXPECT(pCorner[0] == 0 && pCorner[1] == 51 && pCorner[2] == 102);
+	TEST_EXPECT(pCenter[0] > pCenter[2]);
+}
+
+TEST_CASE(Engine_HeadlessResize)
+{
+	// Frames in flight at the old size are written at that size
+	const std::filesystem::path directory = MakeOutputDirectory("HeadlessResizeTest");
+	Engine engine(64, 48, L"Headless", RHIBackend::Null);
+	engine.SetHeadless(true);
+	engine.SetImageSequence((directory / "Frame_#.ppm").wstring());
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("Engine_HeadlessResize"));
+	engine.OnInit();
+	engine.OnUpdate();
+	engine.OnUpdate();
+	engine.OnResize(32, 16);
+	engine.OnUpdate();
+	engine.OnDestroy();
+
+	TEST_EXPECT(ReadWholeFile((directory / "Frame_0.ppm").wstring()).size() == strlen("P6\n64 48\n255\n") + 64 * 48 * 3);
+	TEST_EXPECT(ReadWholeFile((directory / "Frame_1.ppm").wstring()).size() == strlen("P6\n64 48\n255\n") + 64 * 48 * 3);
+	TEST_EXPECT(ReadWholeFile((directory / "Frame_2.ppm").wstring()).size() == strlen("P6\n32 16\n255\n") + 32 * 16 * 3);
+}
+
+BENCHMARK_CASE(Engine_HeadlessFrameRate)
+{
+	// 720p without output, then with a .ppm sequence
+	const std::filesystem::path directory = MakeOutputDirectory("HeadlessBenchmark");
+	for (bool bOutput : { false, true })
+	{
+		std::vector<std::wstring> arguments = { L"LightingEffects", L"--headless", L"--frames", L"60", L"--size", L"1280x720" };
+		if (bOutput)
+		{
+			arguments.push_back(L"--output");
+			arguments.push_back((directory / "Frame_####.ppm").wstring());
+		}
+		TestCommandLine commandLine(arguments);
+		Engine engine(1280, 720, L"Headless", RHIBackend::Null);
+		engine.SetPipelineCachePath(GetTestPipelineCachePath("Engine_HeadlessFrameRate"));
+		TEST_EXPECT(engine.ParseCommandLineArgs(commandLine.argv.data(), int32_t(commandLine.argv.size())));
+		TEST_EXPECT(engine.RunHeadless() == 0);
+		const HeadlessStatistics& statistics = engine.GetHeadlessStatistics();
+		ReportBenchmark(bOutput ? "Headless 720p, .ppm sequence" : "Headless 720p, no output", statistics.seconds, double(statistics.numFrames) * 1280 * 720, "px");
+		printf("    %.1f fps\n", statistics.GetFramesPerSecond());
+	}
+	std::filesystem::remove_all(directory);
+}
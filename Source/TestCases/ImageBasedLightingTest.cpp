@@ -0,0 +1,349 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "FileIO.h"
+#include "ImageBasedLighting.h"
+
+#include <cfloat>
+#include <filesystem>
+
+static Float3 ToFloat3(const Half4& value)
+{
+	return { HalfToFloat(value.x), HalfToFloat(value.y), HalfToFloat(value.z) };
+}
+
+// Blue sky, a small bright sun and a dark ground
+static RadianceCubemap MakeEnvironment(uint32_t size)
+{
+	RadianceCubemap environment;
+	environment.Resize(size);
+	const Float3 sunDirection = Normalize({ 0.4f, 0.7f, 0.6f });
+	for (uint32_t face = 0; face < CubemapNumFaces; face++)
+	{
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				const Float3 direction = GetCubemapTexelDirection(face, x, y, size);
+				const float sun = Dot(direction, sunDirection) > 0.98f ? 50.0f : 0.0f;
+				const Float3 radiance = direction.y > 0.0f ? Float3{ 0.3f + sun, 0.5f + sun, 1.0f + sun } : Float3{ 0.1f, 0.08f, 0.05f };
+				environment.SetTexel(environment.GetTexelIndex(face, x, y), radiance);
+			}
+		}
+	}
+	return environment;
+}
+
+static std::filesystem::path MakeCacheDirectory(const char* name)
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / name;
+	std::filesystem::remove_all(directory);
+	return directory;
+}
+
+TEST_CASE(ImageBasedLighting_SamplesCubemap)
+{
+	// Every texel center maps back to itself, whatever the face
+	const RadianceCubemap environment = MakeEnvironment(8);
+	for (uint32_t face = 0; face < CubemapNumFaces; face++)
+	{
+		for (uint32_t y = 0; y < environment.size; y++)
+		{
+			for (uint32_t x = 0; x < environment.size; x++)
+			{
+				const uint32_t index = environment.GetTexelIndex(face, x, y);
+				const Float3 expected = { environment.channels[0][index], environment.channels[1][index], environment.channels[2][index] };
+				TEST_EXPECT(NearlyEqualAbsolute(IBLPrefilter::SampleCubemap(environment, GetCubemapTexelDirection(face, x, y, environment.size)), expected, 1e-4f));
+			}
+		}
+	}
+
+	const std::vector<RadianceCubemap> mips = IBLPrefilter::BuildSourceMips(environment);
+	TEST_EXPECT(mips.size() == 4 && mips.back().size == 1);
+	// Box filtering keeps the average
+	for (uint32_t channel = 0; channel < 3; channel++)
+	{
+		double sum = 0.0;
+		for (const float value : environment.channels[channel])
+		{
+			sum += value;
+		}
+		double mipSum = 0.0;
+		for (const float value : mips.back().channels[channel])
+		{
+			mipSum += value;
+		}
+		TEST_EXPECT(std::abs(sum / environment.GetNumTexels() - mipSum / mips.back().GetNumTexels()) < 1e-3);
+	}
+}
+
+TEST_CASE(ImageBasedLighting_PrefiltersConstantEnvironment)
+{
+	JobSystem jobSystem(2);
+	IBLPrefilter prefilter(&jobSystem);
+	RadianceCubemap environment;
+	environment.Resize(32);
+	for (uint32_t i = 0; i < environment.GetNumTexels(); i++)
+	{
+		environment.SetTexel(i, { 0.25f, 1.0f, 2.0f });
+	}
+	IBLDesc desc;
+	desc.specularSize = 16;
+	desc.numSpecularMips = 5;
+	desc.specularSamples = 32;
+	desc.irradianceSize = 8;
+	desc.brdfLutSize = 16;
+	desc.brdfLutSamples = 64;
+	const IBLData data = prefilter.Prefilter(environment, desc);
+	TEST_EXPECT(data.IsValid() && !data.IsMapped());
+	TEST_EXPECT(data.GetSpecularSize(4) == 1 && data.GetHeader().desc.numSpecularMips == 5);
+
+	// A normalized filter of a constant is the constant, irradiance is pi times the radiance
+	for (uint32_t mip = 0; mip < desc.numSpecularMips; mip++)
+	{
+		const uint32_t size = data.GetSpecularSize(mip);
+		for (uint32_t face = 0; face < CubemapNumFaces; face++)
+		{
+			const Half4* pFace = data.GetSpecularFace(mip, face);
+			for (uint32_t i = 0; i < size * size; i++)
+			{
+				TEST_EXPECT(NearlyEqualAbsolute(ToFloat3(pFace[i]), { 0.25f, 1.0f, 2.0f }, 2e-3f) && HalfToFloat(pFace[i].w) == 1.0f);
+			}
+		}
+	}
+	for (uint32_t face = 0; face < CubemapNumFaces; face++)
+	{
+		const Half4* pFace = data.GetIrradianceFace(face);
+		for (uint32_t i = 0; i < desc.irradianceSize * desc.irradianceSize; i++)
+		{
+			TEST_EXPECT(NearlyEqualAbsolute(ToFloat3(pFace[i]), Float3{ 0.25f, 1.0f, 2.0f } * Pi, 1e-2f));
+		}
+	}
+
+	bool bThrown = false;
+	try
+	{
+		desc.numSpecularMips = 6;
+		prefilter.Prefilter(environment, desc);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+TEST_CASE(ImageBasedLighting_BrdfLut)
+{
+	JobSystem jobSystem(2);
+	IBLPrefilter prefilter(&jobSystem);
+	const uint32_t size = 32;
+	std::vector<Half2> lut(size * size);
+	prefilter.ComputeBrdfLut(size, 512, lut.data());
+
+	auto scale = [&](uint32_t x, uint32_t y) { return HalfToFloat(lut[y * size + x].x); };
+	auto bias = [&](uint32_t x, uint32_t y) { return HalfToFloat(lut[y * size + x].y); };
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			TEST_EXPECT(scale(x, y) >= 0.0f && bias(x, y) >= 0.0f && scale(x, y) + bias(x, y) <= 1.001f);
+		}
+	}
+	// Smooth surfaces reflect everything: F0 at normal incidence, rising to 1 at grazing angles
+	TEST_EXPECT(scale(size - 1, 0) > 0.97f && bias(size - 1, 0) < 0.01f);
+	TEST_EXPECT(scale(size - 1, 0) + bias(size - 1, 0) > 0.98f);
+	TEST_EXPECT(bias(0, 0) > bias(size - 1, 0));
+	// Rough surfaces lose energy at grazing angles through shadowing and masking
+	TEST_EXPECT(scale(0, size - 1) + bias(0, size - 1) < 0.8f * (scale(0, 0) + bias(0, 0)));
+	TEST_EXPECT(scale(size - 1, size - 1) < 0.5f);
+	TEST_EXPECT(scale(size / 2, size - 1) + bias(size / 2, size - 1) < scale(size / 2, 0) + bias(size / 2, 0));
+}
+
+TEST_CASE(ImageBasedLighting_RoughnessBlursSpecular)
+{
+	JobSystem jobSystem(2);
+	IBLPrefilter prefilter(&jobSystem);
+	const RadianceCubemap environment = MakeEnvironment(64);
+	IBLDesc desc;
+	desc.specularSize = 32;
+	desc.numSpecularMips = 5;
+	desc.brdfLutSize = 8;
+	const IBLData data = prefilter.Prefilter(environment, desc);
+
+	// The sun's peak spreads out with roughness while the total energy stays roughly the same
+	float previousPeak = FLT_MAX;
+	double firstAverage = 0.0;
+	for (uint32_t mip = 0; mip < desc.numSpecularMips; mip++)
+	{
+		const uint32_t size = data.GetSpecularSize(mip);
+		float peak = 0.0f;
+		double sum = 0.0;
+		for (uint32_t face = 0; face < CubemapNumFaces; face++)
+		{
+			const Half4* pFace = data.GetSpecularFace(mip, face);
+			for (uint32_t i = 0; i < size * size; i++)
+			{
+				peak = std::max(peak, HalfToFloat(pFace[i].x));
+				sum += HalfToFloat(pFace[i].x);
+			}
+		}
+		const double average = sum / (CubemapNumFaces * size * size);
+		firstAverage = mip == 0 ? average : firstAverage;
+		TEST_EXPECT(peak < previousPeak);
+		TEST_EXPECT(std::abs(average - firstAverage) < 0.25 * firstAverage);
+		previousPeak = peak;
+	}
+
+	// Mirror mip at the source resolution is the source
+	IBLDesc mirrorDesc = desc;
+	mirrorDesc.specularSize = 64;
+	mirrorDesc.numSpecularMips = 1;
+	const IBLData mirror = prefilter.Prefilter(environment, mirrorDesc);
+	for (uint32_t face = 0; face < CubemapNumFaces; face++)
+	{
+		const Half4* pFace = mirror.GetSpecularFace(0, face);
+		for (uint32_t i = 0; i < 64 * 64; i++)
+		{
+			const uint32_t index = face * 64 * 64 + i;
+			const Float3 expected = { environment.channels[0][index], environment.channels[1][index], environment.channels[2][index] };
+			TEST_EXPECT(NearlyEqualAbsolute(ToFloat3(pFace[i]), expected, 2e-3f * std::max(expected.x, 1.0f)));
+		}
+	}
+}
+
+TEST_CASE(ImageBasedLighting_CachesOnDisk)
+{
+	const std::filesystem::path directory = MakeCacheDirectory("IBLCacheTest");
+	JobSystem jobSystem(2);
+	RadianceCubemap environment = MakeEnvironment(32);
+	IBLDesc desc;
+	desc.specularSize = 16;
+	desc.numSpecularMips = 3;
+	desc.brdfLutSize = 16;
+
+	std::vector<uint8_t> first;
+	{
+		IBLCache cache(directory.wstring(), &jobSystem);
+		const IBLData data = cache.GetOrPrefilter(environment, desc);
+		TEST_EXPECT(data.IsValid() && data.IsMapped());
+		TEST_EXPECT(cache.GetStatistics().misses == 1 && cache.GetStatistics().hits == 0);
+		TEST_EXPECT(std::filesystem::exists(cache.GetEntryPath(IBLCache::ComputeKey(environment, desc))));
+		first.assign(data.GetData(), data.GetData() + data.GetSize());
+	}
+
+	// A later run maps the same bytes
+	{
+		IBLCache cache(directory.wstring(), &jobSystem);
+		const IBLData data = cache.GetOrPrefilter(environment, desc);
+		TEST_EXPECT(data.IsMapped() && cache.GetStatistics().hits == 1 && cache.GetStatistics().misses == 0);
+		TEST_EXPECT(data.GetSize() == first.size() && memcmp(data.GetData(), first.data(), first.size()) == 0);
+
+		// Other settings or a single changed texel are different entries
+		IBLDesc otherDesc = desc;
+		otherDesc.specularSamples = 16;
+		TEST_EXPECT(IBLCache::ComputeKey(environment, otherDesc) != IBLCache::ComputeKey(environment, desc));
+		RadianceCubemap changed = environment;
+		changed.channels[1][100] += 0.5f;
+		TEST_EXPECT(IBLCache::ComputeKey(changed, desc) != IBLCache::ComputeKey(environment, desc));
+		cache.GetOrPrefilter(changed, desc);
+		TEST_EXPECT(cache.GetStatistics().misses == 1);
+	}
+
+	// A truncated entry is a miss and gets rewritten
+	{
+		const uint64_t key = IBLCache::ComputeKey(environment, desc);
+		IBLCache cache(directory.wstring(), &jobSystem);
+		std::filesystem::resize_file(cache.GetEntryPath(key), first.size() / 2);
+		const IBLData data = cache.GetOrPrefilter(environment, desc);
+		TEST_EXPECT(data.IsMapped() && cache.GetStatistics().misses == 1);
+		TEST_EXPECT(data.GetSize() == first.size() && memcmp(data.GetData(), first.data(), first.size()) == 0);
+	}
+
+	// So is a header whose block size wraps to 0, 6 * (2^31)^2 * 8 bytes
+	{
+		const uint64_t key = IBLCache::ComputeKey(environment, desc);
+		IBLCache cache(directory.wstring(), &jobSystem);
+		std::vector<uint8_t> corrupt = first;
+		IBLFileHeader* pHeader = reinterpret_cast<IBLFileHeader*>(corrupt.data());
+		pHeader->desc.specularSize = 1u << 31;
+		pHeader->desc.numSpecularMips = 1;
+		WriteFileAtomically(cache.GetEntryPath(key).wstring(), corrupt.data(), corrupt.size());
+		const IBLData data = cache.GetOrPrefilter(environment, desc);
+		TEST_EXPECT(data.IsMapped() && cache.GetStatistics().misses == 1);
+		TEST_EXPECT(data.GetSize() == first.size() && memcmp(data.GetData(), first.data(), first.size()) == 0);
+	}
+
+	std::filesystem::remove_all(directory);
+}
+
+TEST_CASE(ImageBasedLighting_EngineEnvironment)
+{
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetIBLCachePath(MakeCacheDirectory("IBLEngineTest").wstring());
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("ImageBasedLighting_EngineEnvironment"));
+	engine.OnInit();
+	IBLDesc desc;
+	desc.specularSize = 8;
+	desc.numSpecularMips = 2;
+	desc.irradianceSize = 4;
+	desc.brdfLutSize = 8;
+	const RadianceCubemap environment = MakeEnvironment(8);
+	engine.SetEnvironment(environment, desc);
+	TEST_EXPECT(engine.GetEnvironmentLighting().IsValid() && engine.GetEnvironmentLighting().GetSpecularSize(1) == 4);
+	engine.SetEnvironment(environment, desc);
+	TEST_EXPECT(engine.GetIBLCache()->GetStatistics().hits >= 1);
+	engine.OnUpdate();
+	engine.OnDestroy();
+}
+
+BENCHMARK_CASE(ImageBasedLighting_Prefilter)
+{
+	JobSystem jobSystem;
+	IBLPrefilter prefilter(&jobSystem);
+	const RadianceCubemap environment = MakeEnvironment(256);
+	const IBLDesc desc;
+	printf("    %u worker threads, 256^2 source, %u GGX samples\n", jobSystem.GetNumWorkerThreads(), desc.specularSamples);
+
+	BenchmarkTimer mipTimer;
+	const std::vector<RadianceCubemap> sourceMips = IBLPrefilter::BuildSourceMips(environment);
+	ReportBenchmark("Source mips", mipTimer.GetElapsedSeconds(), double(environment.GetNumTexels()), "texel");
+
+	// Per face throughput of every specular mip
+	std::vector<Half4> faces(CubemapNumFaces * desc.specularSize * desc.specularSize);
+	for (uint32_t mip = 0; mip < desc.numSpecularMips; mip++)
+	{
+		const uint32_t size = desc.specularSize >> mip;
+		const float roughness = float(mip) / float(desc.numSpecularMips - 1);
+		BenchmarkTimer timer;
+		prefilter.PrefilterSpecularMip(sourceMips, roughness, size, desc.specularSamples, faces.data());
+		const double seconds = timer.GetElapsedSeconds();
+		char name[64];
+		snprintf(name, sizeof(name), "Specular mip %u, %ux%u, roughness %.2f", mip, size, size, roughness);
+		ReportBenchmark(name, seconds, double(CubemapNumFaces * size * size), "texel");
+		printf("    %.3f ms per face\n", seconds * 1000.0 / double(CubemapNumFaces));
+	}
+
+	BenchmarkTimer irradianceTimer;
+	prefilter.ComputeIrradiance(sourceMips, desc.irradianceSize, faces.data());
+	const double irradianceSeconds = irradianceTimer.GetElapsedSeconds();
+	ReportBenchmark("Irradiance 32x32", irradianceSeconds, double(CubemapNumFaces * desc.irradianceSize * desc.irradianceSize), "texel");
+	printf("    %.3f ms per face\n", irradianceSeconds * 1000.0 / double(CubemapNumFaces));
+
+	std::vector<Half2> lut(desc.brdfLutSize * desc.brdfLutSize);
+	BenchmarkTimer lutTimer;
+	prefilter.ComputeBrdfLut(desc.brdfLutSize, desc.brdfLutSamples, lut.data());
+	ReportBenchmark("BRDF LUT 128x128, 256 samples", lutTimer.GetElapsedSeconds(), double(desc.brdfLutSize) * desc.brdfLutSize, "texel");
+
+	// Cold start against a warm start that only maps the cache entry
+	const std::filesystem::path directory = MakeCacheDirectory("IBLCacheBenchmark");
+	IBLCache cache(directory.wstring(), &jobSystem);
+	BenchmarkTimer missTimer;
+	cache.GetOrPrefilter(environment, desc);
+	const double missSeconds = missTimer.GetElapsedSeconds();
+	BenchmarkTimer hitTimer;
+	const IBLData data = cache.GetOrPrefilter(environment, desc);
+	const double hitSeconds = hitTimer.GetElapsedSeconds();
+	printf("    Cache miss %.1f ms, hit %.3f ms (hash and map), %.1f KB entry\n", missSeconds * 1000.0, hitSeconds * 1000.0, data.GetSize() / 1024.0);
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,255 @@
+#include "TestFramework.h"
+#include "JobSystem.h"
+#include "ParallelCommandRecorder.h"
+#include "NullRHI.h"
+
+#include <cmath>
+#include <mutex>
+
+TEST_CASE(JobSystem_RunsEveryJobOnce)
+{
+	for (uint32_t numWorkerThreads : { 0u, 1u, 3u })
+	{
+		JobSystem jobSystem(numWorkerThreads);
+		std::vector<std::atomic<uint32_t>> runs(10000);
+		JobCounter counter;
+		jobSystem.ParallelFor(uint32_t(runs.size()), 7, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				runs[i]++;
+			}
+		}, &counter);
+		jobSystem.Wait(&counter);
+
+		for (const std::atomic<uint32_t>& run : runs)
+		{
+			TEST_EXPECT(run == 1);
+		}
+	}
+}
+
+TEST_CASE(JobSystem_NestedJobsAndWait)
+{
+	JobSystem jobSystem(2);
+	std::atomic<uint32_t> numLeaves = 0;
+	JobCounter root;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		// Waiting inside a job runs other jobs meanwhile, even with every worker blocked in a Wait()
+		jobSystem.Run([&]
+		{
+			JobCounter children;
+			for (uint32_t j = 0; j < 64; j++)
+			{
+				jobSystem.Run([&] { numLeaves++; }, &children);
+			}
+			jobSystem.Wait(&children);
+		}, &root);
+	}
+	jobSystem.Wait(&root);
+	TEST_EXPECT(numLeaves == 16 * 64);
+}
+
+TEST_CASE(JobSystem_DependencyRunsAfterCounter)
+{
+	JobSystem jobSystem(3);
+	for (int iteration = 0; iteration < 50; iteration++)
+	{
+		std::atomic<uint32_t> numProduced = 0;
+		std::atomic<uint32_t> numSeenByConsumers = 0;
+		JobCounter produced;
+		JobCounter consumed;
+		for (uint32_t i = 0; i < 32; i++)
+		{
+			jobSystem.Run([&] { numProduced++; }, &produced);
+		}
+		// Consumers submitted before producers finish still only start after all of them
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			jobSystem.Run([&] { numSeenByConsumers += numProduced; }, &consumed, &produced);
+		}
+		jobSystem.Wait(&consumed);
+		TEST_EXPECT(produced.IsDone());
+		TEST_EXPECT(numSeenByConsumers == 8 * 32);
+	}
+}
+
+TEST_CASE(JobSystem_DequeStealsFromTop)
+{
+	Job jobs[3];
+	WorkStealingQueue queue;
+	for (Job& job : jobs)
+	{
+		TEST_EXPECT(queue.Push(&job));
+	}
+	TEST_EXPECT(queue.Steal() == &jobs[0]);
+	TEST_EXPECT(queue.Pop() == &jobs[2]);
+	TEST_EXPECT(queue.Pop() == &jobs[1]);
+	TEST_EXPECT(queue.Pop() == nullptr && queue.Steal() == nullptr);
+}
+
+// Records the instance count of every draw, in GPU execution order
+class DrawOrderExecutor : public NullCommandExecutor
+{
+public:
+	void Execute(const NullCommandStream& stream) override
+	{
+		stream.ForEach([&](const NullCommandHeader& header, const void* pPayload)
+		{
+			if (header.type == NullCommandType::DrawInstanced)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				instanceCounts.push_back(static_cast<const NullCmdDrawInstanced*>(pPayload)->instanceCount);
+			}
+		});
+	}
+
+	std::mutex				mutex;
+	std::vector<uint32_t>	instanceCounts;
+};
+
+TEST_CASE(ParallelCommandRecorder_SubmitsInPassOrder)
+{
+	constexpr uint32_t NumPasses = 12;
+	NullRHIDevice device;
+	DrawOrderExecutor executor;
+	device.GetNullGraphicsQueue().SetExecutor(&executor);
+
+	JobSystem jobSystem(3);
+	FramePipeline framePipeline(&device, 2, NumPasses);
+	ParallelCommandRecorder recorder(&device, &jobSystem, NumPasses);
+	for (uint32_t frame = 0; frame < 4; frame++)
+	{
+		framePipeline.BeginFrame();
+		recorder.RecordAndSubmit(&framePipeline, device.GetGraphicsQueue(), NumPasses, [](uint32_t pass, RHICommandList* pCommandList)
+		{
+			// Uneven pass cost so jobs finish out of order
+			std::this_thread::sleep_for(std::chrono::microseconds((NumPasses - pass) * 50));
+			pCommandList->DrawInstanced(3, pass + 1, 0, 0);
+		});
+		framePipeline.EndFrame(device.GetGraphicsQueue());
+	}
+	framePipeline.WaitForIdle(device.GetGraphicsQueue());
+	device.GetNullGraphicsQueue().SetExecutor(nullptr);
+
+	TEST_EXPECT(executor.instanceCounts.size() == 4 * NumPasses);
+	for (size_t i = 0; i < executor.instanceCounts.size(); i++)
+	{
+		TEST_EXPECT(executor.instanceCounts[i] == i % NumPasses + 1);
+	}
+}
+
+TEST_CASE(ParallelCommandRecorder_RethrowsPassError)
+{
+	NullRHIDevice device;
+	JobSystem jobSystem(1);
+	FramePipeline framePipeline(&device, 1, 2);
+	ParallelCommandRecorder recorder(&device, &jobSystem, 2);
+	framePipeline.BeginFrame();
+	bool bThrown = false;
+	try
+	{
+		recorder.RecordAndSubmit(&framePipeline, device.GetGraphicsQueue(), 2, [](uint32_t pass, RHICommandList*)
+		{
+			if (pass == 1)
+			{
+				throw std::runtime_error("pass failed");
+			}
+		});
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+	TEST_EXPECT(device.GetNullGraphicsQueue().GetStatistics().executedCommandLists == 0);
+}
+
+// Roughly `iterations` * 4ns of dependent ALU work that can not be optimized away
+static float SpinWork(uint32_t iterations, float seed)
+{
+	float value = seed;
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		value = value * 0.999f + std::sqrt(value + 1.0f) * 0.001f;
+	}
+	return value;
+}
+
+BENCHMARK_CASE(JobSystem_Benchmark)
+{
+	printf("    hardware threads: %u (counts above that oversubscribe)\n", std::thread::hardware_concurrency());
+
+	// Fan-out/fan-in: latency of spawning N empty jobs and waiting for all of them
+	for (uint32_t numCores : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+	{
+		JobSystem jobSystem(numCores - 1);
+		constexpr uint32_t NumRounds = 200;
+		constexpr uint32_t NumJobs = 256;
+		BenchmarkTimer timer;
+		for (uint32_t round = 0; round < NumRounds; round++)
+		{
+			JobCounter counter;
+			for (uint32_t i = 0; i < NumJobs; i++)
+			{
+				jobSystem.Run([] {}, &counter);
+			}
+			jobSystem.Wait(&counter);
+		}
+		const double seconds = timer.GetElapsedSeconds();
+		printf("    fan-out/fan-in %3u jobs, %2u cores: %9.3f us per round, %8.1f ns per job\n",
+			NumJobs, numCores, seconds / NumRounds * 1e6, seconds / (double(NumRounds) * NumJobs) * 1e9);
+	}
+
+	// Scaling: fixed amount of compute split into small jobs
+	double oneCoreSeconds = 0.0;
+	for (uint32_t numCores : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+	{
+		JobSystem jobSystem(numCores - 1);
+		constexpr uint32_t NumItems = 4096;
+		std::vector<float> results(NumItems);
+		BenchmarkTimer timer;
+		JobCounter counter;
+		jobSystem.ParallelFor(NumItems, 16, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				results[i] = SpinWork(2000, float(i));
+			}
+		}, &counter);
+		jobSystem.Wait(&counter);
+		const double seconds = timer.GetElapsedSeconds();
+		oneCoreSeconds = numCores == 1 ? seconds : oneCoreSeconds;
+		printf("    scaling %2u cores: %9.3f ms, speedup %5.2fx\n", numCores, seconds * 1000.0, oneCoreSeconds / seconds);
+	}
+
+	// Parallel recording of 8 passes x 5000 draws on the Null backend
+	for (uint32_t numCores : { 1u, 2u, 4u, 8u })
+	{
+		constexpr uint32_t NumPasses = 8;
+		constexpr uint32_t NumDraws = 5000;
+		constexpr uint32_t NumFrames = 20;
+		NullRHIDevice device;
+		JobSystem jobSystem(numCores - 1);
+		FramePipeline framePipeline(&device, 2, NumPasses);
+		ParallelCommandRecorder recorder(&device, &jobSystem, NumPasses);
+		BenchmarkTimer timer;
+		for (uint32_t frame = 0; frame < NumFrames; frame++)
+		{
+			framePipeline.BeginFrame();
+			recorder.RecordAndSubmit(&framePipeline, device.GetGraphicsQueue(), NumPasses, [](uint32_t, RHICommandList* pCommandList)
+			{
+				for (uint32_t i = 0; i < NumDraws; i++)
+				{
+					pCommandList->DrawInstanced(3, 1, i, 0);
+				}
+			});
+			framePipeline.EndFrame(device.GetGraphicsQueue());
+		}
+		const double seconds = timer.GetElapsedSeconds();
+		framePipeline.WaitForIdle(device.GetGraphicsQueue());
+		const std::string name = "Parallel recording, " + std::to_string(numCores) + " cores";
+		ReportBenchmark(name.c_str(), seconds, double(NumFrames) * NumPasses * NumDraws, "draw");
+	}
+}
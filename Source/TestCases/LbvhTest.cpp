@@ -0,0 +1,394 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Lbvh.h"
+#include "RadixSort.h"
+
+#include <cfloat>
+#include <random>
+
+static std::vector<BvhRay> MakeRandomRays(std::mt19937& random, uint32_t count, float sceneSize, float maxDistance)
+{
+	std::uniform_real_distribution<float> position(-sceneSize, sceneSize);
+	std::normal_distribution<float> direction;
+	std::vector<BvhRay> rays(count);
+	for (BvhRay& ray : rays)
+	{
+		ray.origin = { position(random), position(random), position(random) };
+		ray.direction = Normalize({ direction(random), direction(random), direction(random) });
+		ray.tMax = maxDistance;
+	}
+	return rays;
+}
+
+// Scale, rotation about y then x, translation
+static Float4x4 MakeTransform(float scale, float yaw, float pitch, const Float3& translation)
+{
+	Float4x4 rotationY = MatrixIdentity();
+	rotationY.m[0][0] = std::cos(yaw);
+	rotationY.m[0][2] = -std::sin(yaw);
+	rotationY.m[2][0] = std::sin(yaw);
+	rotationY.m[2][2] = std::cos(yaw);
+	Float4x4 rotationX = MatrixIdentity();
+	rotationX.m[1][1] = std::cos(pitch);
+	rotationX.m[1][2] = std::sin(pitch);
+	rotationX.m[2][1] = -std::sin(pitch);
+	rotationX.m[2][2] = std::cos(pitch);
+	Float4x4 matrix = MatrixMultiply(rotationY, rotationX);
+	for (uint32_t row = 0; row < 3; row++)
+	{
+		for (uint32_t column = 0; column < 3; column++)
+		{
+			matrix.m[row][column] *= scale;
+		}
+	}
+	matrix.m[3][0] = translation.x;
+	matrix.m[3][1] = translation.y;
+	matrix.m[3][2] = translation.z;
+	return matrix;
+}
+
+static bool ContainsBounds(const BoundingBox& outer, const Float3& boundsMin, const Float3& boundsMax)
+{
+	return outer.min.x <= boundsMin.x && outer.min.y <= boundsMin.y && outer.min.z <= boundsMin.z &&
+		outer.max.x >= boundsMax.x && outer.max.y >= boundsMax.y && outer.max.z >= boundsMax.z;
+}
+
+TEST_CASE(RadixSort_SortsStable)
+{
+	for (uint32_t numWorkers : { 0u, 3u })
+	{
+		JobSystem jobSystem(numWorkers);
+		for (uint32_t count : { 0u, 1u, 1000u, uint32_t(RadixSortChunkSize) * 3 + 17 })
+		{
+			std::mt19937 random(count);
+			std::vector<uint32_t> keys(count);
+			std::vector<uint32_t> values(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				// Few distinct keys to test the stability, and an upper byte shared by all keys
+				keys[i] = (random() & 0x00ff00ffu) | 0x12000000u;
+				values[i] = i;
+			}
+			const std::vector<uint32_t> originalKeys = keys;
+			RadixSortPairs(&jobSystem, keys, values);
+
+			bool bSorted = true;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				bSorted &= originalKeys[values[i]] == keys[i];
+				if (i > 0)
+				{
+					bSorted &= keys[i - 1] < keys[i] || (keys[i - 1] == keys[i] && values[i - 1] < values[i]);
+				}
+			}
+			TEST_EXPECT(bSorted);
+		}
+	}
+}
+
+TEST_CASE(RadixSort_LowBitsOnly)
+{
+	JobSystem jobSystem(2);
+	std::vector<uint32_t> keys = { 0xff000003u, 0x00000001u, 0xaa000002u, 0x01000001u };
+	std::vector<uint32_t> values = { 0, 1, 2, 3 };
+	RadixSortPairs(&jobSystem, keys, values, 8);
+	TEST_EXPECT(values == std::vector<uint32_t>({ 1, 3, 2, 0 }));
+}
+
+TEST_CASE(Lbvh_MatchesBruteForce)
+{
+	std::mt19937 random(3);
+	std::vector<Float3> positions;
+	std::vector<uint32_t> indices;
+	AddRandomTriangles(random, 3000, 10.0f, 1.0f, positions, indices);
+	// Duplicates share their Morton code, degenerate triangles never hit
+	for (uint32_t i = 0; i < 20; i++)
+	{
+		for (uint32_t v = 0; v < 3; v++)
+		{
+			indices.push_back(uint32_t(positions.size()));
+			positions.push_back(i < 10 ? positions[v] : Float3{ 1.0f, 2.0f, 3.0f });
+		}
+	}
+
+	JobSystem jobSystem(2);
+	TriangleLbvh lbvh(&jobSystem);
+	lbvh.Build(positions.data(), indices.data(), uint32_t(indices.size() / 3));
+	TEST_EXPECT(lbvh.GetNumTriangles() == indices.size() / 3);
+	TEST_EXPECT(lbvh.GetHierarchy().GetNodes().size() == indices.size() / 3 - 1);
+
+	const std::vector<BvhRay> rays = MakeRandomRays(random, 500, 12.0f, 8.0f);
+	uint32_t numMismatches = 0;
+	uint32_t numHits = 0;
+	for (const BvhRay& ray : rays)
+	{
+		BvhHit hit, reference;
+		const bool bHit = lbvh.Intersect(ray, hit);
+		const bool bReference = IntersectBruteForce(positions, indices, ray, reference);
+		numHits += bReference;
+		numMismatches += bHit != bReference || (bHit && !IsSameHit(hit, reference));
+		numMismatches += lbvh.IsOccluded(ray) != bReference;
+	}
+	TEST_EXPECT(numMismatches == 0);
+	TEST_EXPECT(numHits > 50);
+
+	// Packets, with a count that leaves a partial last packet
+	std::vector<uint8_t> occluded(rays.size() - 3);
+	lbvh.QueryOcclusion(rays.data(), uint32_t(occluded.size()), occluded.data());
+	uint32_t numPacketMismatches = 0;
+	for (uint32_t i = 0; i < occluded.size(); i++)
+	{
+		numPacketMismatches += occluded[i] != uint8_t(lbvh.IsOccluded(rays[i]));
+	}
+	TEST_EXPECT(numPacketMismatches == 0);
+}
+
+TEST_CASE(Lbvh_SingleAndEmpty)
+{
+	JobSystem jobSystem(0);
+	TriangleLbvh lbvh(&jobSystem);
+	lbvh.Build(nullptr, nullptr, 0);
+	BvhHit hit;
+	BvhRay ray = { { 0.2f, 0.2f, -1.0f }, { 0.0f, 0.0f, 1.0f } };
+	TEST_EXPECT(!lbvh.Intersect(ray, hit));
+	TEST_EXPECT(!lbvh.IsOccluded(ray));
+
+	const Float3 positions[3] = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+	const uint32_t indices[3] = { 0, 1, 2 };
+	lbvh.Build(positions, indices, 1);
+	TEST_EXPECT(lbvh.Intersect(ray, hit) && hit.triangle == 0 && std::abs(hit.t - 1.0f) < 1e-6f);
+	uint8_t occluded[2] = {};
+	const BvhRay rays[2] = { ray, { { 2.0f, 2.0f, -1.0f }, { 0.0f, 0.0f, 1.0f } } };
+	lbvh.QueryOcclusion(rays, 2, occluded);
+	TEST_EXPECT(occluded[0] == 1 && occluded[1] == 0);
+
+	// Refit a single triangle
+	const Float3 moved[3] = { { 5.0f, 0.0f, 0.0f }, { 6.0f, 0.0f, 0.0f }, { 5.0f, 1.0f, 0.0f } };
+	lbvh.Refit(moved);
+	TEST_EXPECT(!lbvh.IsOccluded(ray));
+	TEST_EXPECT(lbvh.GetBounds().min.x == 5.0f && lbvh.GetBounds().max.x == 6.0f);
+}
+
+TEST_CASE(Lbvh_RefitMatchesBruteForce)
+{
+	std::mt19937 random(9);
+	std::vector<Float3> positions;
+	std::vector<uint32_t> indices;
+	AddRandomTriangles(random, 2000, 10.0f, 1.0f, positions, indices);
+	JobSystem jobSystem(3);
+	TriangleLbvh lbvh(&jobSystem);
+	lbvh.Build(positions.data(), indices.data(), uint32_t(indices.size() / 3));
+
+	// Wave deformation, far enough to move triangles across the old nodes
+	for (Float3& position : positions)
+	{
+		position.y += 3.0f * std::sin(position.x * 0.5f);
+		position.z *= 1.5f;
+	}
+	lbvh.Refit(positions.data());
+
+	// Every node contains its children
+	const Lbvh& hierarchy = lbvh.GetHierarchy();
+	const std::vector<LbvhNode>& nodes = hierarchy.GetNodes();
+	bool bContained = true;
+	for (const LbvhNode& node : nodes)
+	{
+		for (uint32_t child : { node.left, node.right })
+		{
+			const bool bLeaf = (child & Lbvh::LeafFlag) != 0;
+			const uint32_t index = child & ~Lbvh::LeafFlag;
+			bContained &= ContainsBounds({ node.boundsMin, node.boundsMax }, bLeaf ? hierarchy.GetLeafBoundsMin(index) : nodes[index].boundsMin,
+				bLeaf ? hierarchy.GetLeafBoundsMax(index) : nodes[index].boundsMax);
+		}
+	}
+	TEST_EXPECT(bContained);
+
+	TriangleLbvh rebuilt(&jobSystem);
+	rebuilt.Build(positions.data(), indices.data(), uint32_t(indices.size() / 3));
+	const BoundingBox bounds = lbvh.GetBounds();
+	const BoundingBox rebuiltBounds = rebuilt.GetBounds();
+	TEST_EXPECT(bounds.min.x == rebuiltBounds.min.x && bounds.min.y == rebuiltBounds.min.y && bounds.min.z == rebuiltBounds.min.z);
+	TEST_EXPECT(bounds.max.x == rebuiltBounds.max.x && bounds.max.y == rebuiltBounds.max.y && bounds.max.z == rebuiltBounds.max.z);
+
+	const std::vector<BvhRay> rays = MakeRandomRays(random, 400, 12.0f, 8.0f);
+	std::vector<uint8_t> occluded(rays.size());
+	lbvh.QueryOcclusion(rays.data(), uint32_t(rays.size()), occluded.data());
+	uint32_t numMismatches = 0;
+	for (uint32_t i = 0; i < rays.size(); i++)
+	{
+		BvhHit hit, reference;
+		const bool bHit = lbvh.Intersect(rays[i], hit);
+		const bool bReference = IntersectBruteForce(positions, indices, rays[i], reference);
+		numMismatches += bHit != bReference || (bHit && !IsSameHit(hit, reference));
+		numMismatches += occluded[i] != uint8_t(bReference);
+	}
+	TEST_EXPECT(numMismatches == 0);
+}
+
+TEST_CASE(InstanceLbvh_MatchesBruteForce)
+{
+	std::mt19937 random(21);
+	std::vector<Float3> meshPositions[2];
+	std::vector<uint32_t> meshIndices[2];
+	AddRandomTriangles(random, 300, 2.0f, 0.5f, meshPositions[0], meshIndices[0]);
+	AddRandomTriangles(random, 100, 1.0f, 0.8f, meshPositions[1], meshIndices[1]);
+	JobSystem jobSystem(2);
+	TriangleLbvh meshes[2] = { TriangleLbvh(&jobSystem), TriangleLbvh(&jobSystem) };
+	for (uint32_t mesh = 0; mesh < 2; mesh++)
+	{
+		meshes[mesh].Build(meshPositions[mesh].data(), meshIndices[mesh].data(), uint32_t(meshIndices[mesh].size() / 3));
+	}
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Float4x4> transforms;
+	InstanceLbvh scene(&jobSystem);
+	for (uint32_t i = 0; i < 30; i++)
+	{
+		transforms.push_back(MakeTransform(0.5f + unit(random) * 1.5f, unit(random) * 2.0f * Pi, unit(random) * Pi, { unit(random) * 20.0f - 10.0f, unit(random) * 20.0f - 10.0f, unit(random) * 20.0f - 10.0f }));
+		TEST_EXPECT(scene.AddInstance(&meshes[i % 2], transforms.back()) == i);
+	}
+	scene.Build();
+
+	// World space copy of every instance, with the first triangle index of each instance
+	auto checkAgainstBruteForce = [&]()
+	{
+		std::vector<Float3> positions;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> firstTriangles;
+		for (uint32_t i = 0; i < transforms.size(); i++)
+		{
+			firstTriangles.push_back(uint32_t(indices.size() / 3));
+			const uint32_t firstVertex = uint32_t(positions.size());
+			for (const Float3& position : meshPositions[i % 2])
+			{
+				positions.push_back(TransformPoint(position, transforms[i]));
+			}
+			for (uint32_t index : meshIndices[i % 2])
+			{
+				indices.push_back(firstVertex + index);
+			}
+		}
+
+		const std::vector<BvhRay> rays = MakeRandomRays(random, 300, 12.0f, 10.0f);
+		std::vector<uint8_t> occluded(rays.size() - 1);
+		scene.QueryOcclusion(rays.data(), uint32_t(occluded.size()), occluded.data());
+		uint32_t numMismatches = 0;
+		uint32_t numHits = 0;
+		for (uint32_t i = 0; i < rays.size(); i++)
+		{
+			LbvhInstanceHit hit;
+			BvhHit reference;
+			const bool bHit = scene.Intersect(rays[i], hit);
+			const bool bReference = IntersectBruteForce(positions, indices, rays[i], reference);
+			numHits += bReference;
+			numMismatches += bHit != bReference;
+			numMismatches += scene.IsOccluded(rays[i]) != bReference;
+			if (i < occluded.size())
+			{
+				numMismatches += occluded[i] != uint8_t(bReference);
+			}
+			if (bHit && bReference)
+			{
+				numMismatches += firstTriangles[hit.instance] + hit.hit.triangle != reference.triangle;
+				numMismatches += std::abs(hit.hit.t - reference.t) > 1e-3f * std::max(reference.t, 1.0f);
+			}
+		}
+		TEST_EXPECT(numMismatches == 0);
+		TEST_EXPECT(numHits > 20);
+	};
+	checkAgainstBruteForce();
+
+	// Small moves refit, then a rebuild after large ones
+	for (uint32_t i = 0; i < transforms.size(); i += 3)
+	{
+		transforms[i].m[3][1] += 0.5f;
+		scene.SetTransform(i, transforms[i]);
+	}
+	scene.Refit();
+	checkAgainstBruteForce();
+	for (uint32_t i = 0; i < transforms.size(); i += 2)
+	{
+		transforms[i] = MakeTransform(1.0f, unit(random) * Pi, 0.0f, { unit(random) * 20.0f - 10.0f, 0.0f, unit(random) * 20.0f - 10.0f });
+		scene.SetTransform(i, transforms[i]);
+	}
+	scene.Build();
+	checkAgainstBruteForce();
+
+	scene.Clear();
+	TEST_EXPECT(scene.GetNumInstances() == 0 && !scene.IsOccluded({ { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }));
+}
+
+BENCHMARK_CASE(Lbvh_BuildAndRefit)
+{
+	std::mt19937 random(11);
+	std::vector<Float3> positions;
+	std::vector<uint32_t> indices;
+	AddRandomTriangles(random, 1 << 20, 100.0f, 0.5f, positions, indices);
+	const uint32_t numTriangles = uint32_t(indices.size() / 3);
+	JobSystem jobSystem;
+
+	TriangleLbvh lbvh(&jobSystem);
+	BenchmarkTimer buildTimer;
+	lbvh.Build(positions.data(), indices.data(), numTriangles);
+	ReportBenchmark("Build 1M triangles, LBVH", buildTimer.GetElapsedSeconds(), double(numTriangles), "triangle");
+
+	Bvh bvh(&jobSystem);
+	BenchmarkTimer sahTimer;
+	bvh.Build(positions.data(), indices.data(), numTriangles);
+	ReportBenchmark("Build 1M triangles, binned SAH", sahTimer.GetElapsedSeconds(), double(numTriangles), "triangle");
+
+	for (Float3& position : positions)
+	{
+		position.y += 0.2f * std::sin(position.x);
+	}
+	BenchmarkTimer refitTimer;
+	lbvh.Refit(positions.data());
+	ReportBenchmark("Refit 1M triangles, LBVH", refitTimer.GetElapsedSeconds(), double(numTriangles), "triangle");
+}
+
+BENCHMARK_CASE(Lbvh_OcclusionRays)
+{
+	// Ambient occlusion like rays: short, starting on the surfaces of a dense scene
+	std::mt19937 random(13);
+	std::vector<Float3> positions;
+	std::vector<uint32_t> indices;
+	AddRandomTriangles(random, 200000, 30.0f, 0.5f, positions, indices);
+	JobSystem jobSystem;
+	TriangleLbvh lbvh(&jobSystem);
+	lbvh.Build(positions.data(), indices.data(), uint32_t(indices.size() / 3));
+
+	std::uniform_int_distribution<uint32_t> triangle(0, uint32_t(indices.size() / 3) - 1);
+	std::normal_distribution<float> direction;
+	std::vector<BvhRay> rays(1 << 20);
+	for (BvhRay& ray : rays)
+	{
+		const uint32_t i = triangle(random);
+		ray.origin = (positions[indices[i * 3]] + positions[indices[i * 3 + 1]] + positions[indices[i * 3 + 2]]) * (1.0f / 3.0f);
+		ray.direction = Normalize({ direction(random), direction(random), direction(random) });
+		ray.tMin = 1e-3f;
+		ray.tMax = 2.0f;
+	}
+
+	std::vector<uint8_t> occluded(rays.size());
+	BenchmarkTimer packetTimer;
+	lbvh.QueryOcclusion(rays.data(), uint32_t(rays.size()), occluded.data());
+	ReportBenchmark("1M occlusion rays, 4 ray packets", packetTimer.GetElapsedSeconds(), double(rays.size()), "ray");
+
+	BenchmarkTimer scalarTimer;
+	uint32_t numOccluded = 0;
+	for (const BvhRay& ray : rays)
+	{
+		numOccluded += lbvh.IsOccluded(ray);
+	}
+	ReportBenchmark("1M occlusion rays, single rays", scalarTimer.GetElapsedSeconds(), double(rays.size()), "ray");
+
+	Bvh bvh(&jobSystem);
+	bvh.Build(positions.data(), indices.data(), uint32_t(indices.size() / 3));
+	BenchmarkTimer sahTimer;
+	for (const BvhRay& ray : rays)
+	{
+		bvh.IsOccluded(ray);
+	}
+	ReportBenchmark("1M occlusion rays, binned SAH", sahTimer.GetElapsedSeconds(), double(rays.size()), "ray");
+	printf("    %.1f%% occluded\n", 100.0 * numOccluded / rays.size());
+}
@@ -0,0 +1,465 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "LightmapBaker.h"
+
+#include <filesystem>
+
+// Closed box facing outwards, corners shared by the faces like PathTracerScene::AddBox()
+static LightmapObject MakeBox(const BoundingBox& box, uint32_t material = 0)
+{
+	LightmapObject object;
+	object.positions =
+	{
+		{ box.min.x, box.min.y, box.min.z }, { box.max.x, box.min.y, box.min.z }, { box.min.x, box.max.y, box.min.z }, { box.max.x, box.max.y, box.min.z },
+		{ box.min.x, box.min.y, box.max.z }, { box.max.x, box.min.y, box.max.z }, { box.min.x, box.max.y, box.max.z }, { box.max.x, box.max.y, box.max.z },
+	};
+	object.indices =
+	{
+		0, 2, 1, 1, 2, 3,	4, 5, 6, 5, 7, 6,	0, 4, 2, 2, 4, 6,
+		1, 3, 5, 3, 7, 5,	0, 1, 4, 1, 5, 4,	2, 6, 3, 3, 6, 7,
+	};
+	object.material = material;
+	return object;
+}
+
+// Quad at y = 0 facing up
+static LightmapObject MakeFloor(float size, uint32_t material = 0)
+{
+	LightmapObject object;
+	object.positions = { { -size, 0.0f, -size }, { size, 0.0f, -size }, { -size, 0.0f, size }, { size, 0.0f, size } };
+	object.indices = { 0, 2, 1, 1, 2, 3 };
+	object.material = material;
+	return object;
+}
+
+static Float4x4 MakeTranslation(const Float3& translation)
+{
+	Float4x4 matrix = MatrixIdentity();
+	matrix.m[3][0] = translation.x;
+	matrix.m[3][1] = translation.y;
+	matrix.m[3][2] = translation.z;
+	return matrix;
+}
+
+TEST_CASE(LightmapBaker_PacksChartsWithoutOverlap)
+{
+	LightmapScene scene;
+	scene.materials.push_back({});
+	scene.objects.push_back(MakeFloor(3.0f));
+	for (uint32_t i = 0; i < 12; i++)
+	{
+		scene.objects.push_back(MakeBox({ { 0.0f, 0.0f, 0.0f }, { 1.0f + float(i % 3), 1.0f, 0.5f } }));
+		scene.objects.back().objectToWorld = MakeTranslation({ float(i) * 4.0f, 0.0f, 0.0f });
+	}
+	// Twice the size, twice the texels along each axis
+	scene.objects.back().objectToWorld.m[0][0] = scene.objects.back().objectToWorld.m[1][1] = scene.objects.back().objectToWorld.m[2][2] = 2.0f;
+
+	JobSystem jobSystem(2);
+	LightmapSettings settings;
+	settings.atlasSize = 64;
+	settings.texelsPerUnit = 8.0f;
+	LightmapBaker baker(&jobSystem, settings);
+	baker.SetScene(scene);
+
+	const std::vector<LightmapChart>& charts = baker.GetCharts();
+	TEST_EXPECT(charts.size() == 1 + 12 * 6);
+	TEST_EXPECT(baker.GetAtlases().size() > 1);
+	const uint32_t gutter = settings.gutter;
+	bool bInside = true;
+	bool bDisjoint = true;
+	bool bSameAtlas = true;
+	for (uint32_t a = 0; a < charts.size(); a++)
+	{
+		const LightmapChart& chart = charts[a];
+		bInside &= chart.x >= gutter && chart.y >= gutter && chart.x + chart.width + gutter <= settings.atlasSize && chart.y + chart.height + gutter <= settings.atlasSize;
+		bInside &= chart.numTexels > 0 && chart.numTexels <= chart.width * chart.height;
+		bSameAtlas &= chart.atlas == baker.GetObjectAtlas(chart.object);
+		for (uint32_t b = a + 1; b < charts.size(); b++)
+		{
+			const LightmapChart& other = charts[b];
+			const bool bOverlapX = chart.x - gutter < other.x + other.width + gutter && other.x - gutter < chart.x + chart.width + gutter;
+			const bool bOverlapY = chart.y - gutter < other.y + other.height + gutter && other.y - gutter < chart.y + chart.height + gutter;
+			bDisjoint &= chart.atlas != other.atlas || !(bOverlapX && bOverlapY);
+		}
+	}
+	TEST_EXPECT(bInside);
+	TEST_EXPECT(bDisjoint);
+	TEST_EXPECT(bSameAtlas);
+
+	// Floor: 6 units at 8 texels per unit, plus the half texel borders
+	TEST_EXPECT(charts[0].width == 49 && charts[0].height == 49);
+	// Last box is 6 units long once scaled, 49 texels: its charts stacked don't fit in 64 and the density is halved
+	TEST_EXPECT(charts.back().object == 12);
+	uint32_t maxScaledSize = 0;
+	for (const LightmapChart& chart : charts)
+	{
+		maxScaledSize = std::max(maxScaledSize, chart.object == 12 ? std::max(chart.width, chart.height) : 0u);
+	}
+	TEST_EXPECT(maxScaledSize == 25);
+
+	// Every UV of an object lies in one of its charts
+	bool bUVsInCharts = true;
+	for (uint32_t object = 0; object < scene.objects.size(); object++)
+	{
+		for (const Float2& uv : baker.GetObjectUVs(object))
+		{
+			const float x = uv.x * float(settings.atlasSize);
+			const float y = uv.y * float(settings.atlasSize);
+			bool bFound = false;
+			for (const LightmapChart& chart : charts)
+			{
+				bFound |= chart.object == object && x >= float(chart.x) + 0.49f && x <= float(chart.x + chart.width) - 0.49f && y >= float(chart.y) + 0.49f && y <= float(chart.y + chart.height) - 0.49f;
+			}
+			bUVsInCharts &= bFound;
+		}
+	}
+	TEST_EXPECT(bUVsInCharts);
+}
+
+TEST_CASE(LightmapBaker_BakesSkyAndSun)
+{
+	// Open floor under a uniform sky and the sun: every texel receives pi * sky + sun * cos, no noise
+	LightmapScene scene;
+	scene.materials.push_back({});
+	scene.objects.push_back(MakeFloor(2.0f));
+	scene.skyRadiance = { 0.5f, 0.25f, 1.0f };
+	scene.sunDirection = Normalize({ 0.0f, -1.0f, 1.0f });
+	scene.sunIlluminance = { 2.0f, 2.0f, 2.0f };
+	JobSystem jobSystem(3);
+	LightmapSettings settings;
+	settings.atlasSize = 64;
+	settings.numSamples = 8;
+	LightmapBaker baker(&jobSystem, settings);
+	baker.SetScene(scene);
+
+	uint32_t numProgressCalls = 0;
+	uint64_t lastBaked = 0;
+	bool bMonotonic = true;
+	const LightmapBakeStatistics statistics = baker.Bake([&](uint64_t numBakedTexels, uint64_t numTexels)
+	{
+		bMonotonic &= numBakedTexels >= lastBaked && numBakedTexels <= numTexels;
+		lastBaked = numBakedTexels;
+		numProgressCalls++;
+	});
+	TEST_EXPECT(statistics.numCharts == 1 && statistics.numBakedCharts == 1);
+	TEST_EXPECT(statistics.numTexels == baker.GetCharts()[0].numTexels && lastBaked == statistics.numTexels);
+	TEST_EXPECT(bMonotonic && numProgressCalls > 1);
+	TEST_EXPECT(statistics.numRays > 0 && statistics.GetTexelsPerSecond() > 0.0);
+
+	const Float3 expected = scene.skyRadiance * Pi + scene.sunIlluminance * std::sqrt(0.5f);
+	const LightmapAtlas& atlas = baker.GetAtlases()[0];
+	uint32_t numCovered = 0;
+	uint32_t numDilated = 0;
+	bool bMatches = true;
+	for (size_t i = 0; i < atlas.coverage.size(); i++)
+	{
+		if (atlas.coverage[i] != LightmapCoverage::Empty)
+		{
+			bMatches &= NearlyEqual(atlas.irradiance[i], expected, 1e-4f);
+			numCovered += atlas.coverage[i] != LightmapCoverage::Dilated;
+			numDilated += atlas.coverage[i] == LightmapCoverage::Dilated;
+		}
+	}
+	TEST_EXPECT(bMatches);
+	TEST_EXPECT(numCovered == baker.GetCharts()[0].numTexels);
+	// Gutter ring of 2 texels around the chart
+	const LightmapChart& chart = baker.GetCharts()[0];
+	TEST_EXPECT(numDilated == (chart.width + 4) * (chart.height + 4) - chart.width * chart.height);
+
+	// A box on the floor shadows the sun and some of the sky
+	scene.objects.push_back(MakeBox({ { -0.5f, 0.0f, -0.5f }, { 0.5f, 1.0f, 0.5f } }));
+	baker.SetScene(scene);
+	baker.Bake();
+	const LightmapAtlas& shadowedAtlas = baker.GetAtlases()[baker.GetObjectAtlas(0)];
+	uint32_t numShadowed = 0;
+	for (size_t i = 0; i < shadowedAtlas.coverage.size(); i++)
+	{
+		numShadowed += shadowedAtlas.coverage[i] == LightmapCoverage::Inside && shadowedAtlas.irradiance[i].x < expected.x * 0.7f;
+	}
+	TEST_EXPECT(numShadowed > 20);
+}
+
+TEST_CASE(LightmapBaker_BlendsSeams)
+{
+	// A box lit from the side: neighboring faces get different light and meet along shared edges
+	LightmapScene scene;
+	scene.materials.push_back({});
+	scene.objects.push_back(MakeBox({ { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } }));
+	scene.lights.AddPointLight({ 2.0f, 1.5f, 0.5f }, 6.0f, { 4.0f, 4.0f, 4.0f });
+	scene.skyRadiance = { 0.1f, 0.1f, 0.1f };
+	const LightmapObject& box = scene.objects[0];
+
+	auto measureSeams = [&](uint32_t seamIterations)
+	{
+		JobSystem jobSystem(1);
+		LightmapSettings settings;
+		settings.atlasSize = 64;
+		settings.texelsPerUnit = 6.0f;
+		settings.numSamples = 4;
+		settings.seamIterations = seamIterations;
+		LightmapBaker baker(&jobSystem, settings);
+		baker.SetScene(scene);
+		baker.Bake();
+		const std::vector<uint8_t> cooked = CookLightmap(baker);
+		Lightmap lightmap;
+		lightmap.OpenFromMemory(cooked.data(), cooked.size());
+
+		// Triangles of different faces sharing an edge, sampled along the edge on both sides
+		const Float2* pUVs = lightmap.GetObjectUVs(0);
+		float maxDifference = 0.0f;
+		for (uint32_t a = 0; a < 12; a++)
+		{
+			for (uint32_t b = a + 1; b < 12; b++)
+			{
+				if (a / 2 == b / 2)
+				{
+					continue;
+				}
+				for (uint32_t edgeA = 0; edgeA < 3; edgeA++)
+				{
+					for (uint32_t edgeB = 0; edgeB < 3; edgeB++)
+					{
+						const uint32_t a0 = a * 3 + edgeA, a1 = a * 3 + (edgeA + 1) % 3;
+						const uint32_t b0 = b * 3 + edgeB, b1 = b * 3 + (edgeB + 1) % 3;
+						if (box.indices[a0] != box.indices[b1] || box.indices[a1] != box.indices[b0])
+						{
+							continue;
+						}
+						for (float t = 0.1f; t < 0.95f; t += 0.2f)
+						{
+							const Float2 uvA = { pUVs[a0].x + (pUVs[a1].x - pUVs[a0].x) * t, pUVs[a0].y + (pUVs[a1].y - pUVs[a0].y) * t };
+							const Float2 uvB = { pUVs[b1].x + (pUVs[b0].x - pUVs[b1].x) * t, pUVs[b1].y + (pUVs[b0].y - pUVs[b1].y) * t };
+							const Float3 difference = lightmap.SampleIrradiance(0, uvA) - lightmap.SampleIrradiance(0, uvB);
+							maxDifference = std::max({ maxDifference, std::abs(difference.x), std::abs(difference.y), std::abs(difference.z) });
+						}
+					}
+				}
+			}
+		}
+		return maxDifference;
+	};
+	const float unblended = measureSeams(0);
+	const float blended = measureSeams(LightmapSettings().seamIterations);
+	TEST_EXPECT(unblended > 0.05f);
+	TEST_EXPECT(blended < unblended * 0.1f);
+}
+
+TEST_CASE(LightmapBaker_RebakesAffectedCharts)
+{
+	// Two boxes far apart on a long floor, a light next to the first one
+	LightmapScene scene;
+	scene.materials.push_back({ { 0.6f, 0.6f, 0.6f } });
+	scene.objects.push_back(MakeFloor(1.0f));
+	scene.objects.back().objectToWorld.m[0][0] = 20.0f;
+	scene.objects.push_back(MakeBox({ { -0.5f, 0.0f, -0.5f }, { 0.5f, 1.0f, 0.5f } }));
+	scene.objects.back().objectToWorld = MakeTranslation({ -15.0f, 0.0f, 0.0f });
+	scene.objects.push_back(MakeBox({ { -0.5f, 0.0f, -0.5f }, { 0.5f, 1.0f, 0.5f } }));
+	scene.objects.back().objectToWorld = MakeTranslation({ 15.0f, 0.0f, 0.0f });
+	scene.lights.AddPointLight({ -13.0f, 2.0f, 0.0f }, 4.0f, { 10.0f, 10.0f, 10.0f });
+	scene.skyRadiance = { 0.2f, 0.3f, 0.4f };
+
+	JobSystem jobSystem(2);
+	LightmapSettings settings;
+	settings.atlasSize = 256;
+	settings.texelsPerUnit = 4.0f;
+	settings.numSamples = 4;
+	settings.seamIterations = 0;		// Blending mixes in the neighbors' values, compare the bakes themselves
+	settings.influenceDistance = 2.0f;
+	LightmapBaker baker(&jobSystem, settings);
+	baker.SetScene(scene);
+	TEST_EXPECT(baker.Bake().numBakedCharts == 13);
+	TEST_EXPECT(baker.Bake().numBakedCharts == 0);
+	const std::vector<LightmapAtlas> before = baker.GetAtlases();
+
+	// Move the first box: it, the floor and nothing else is rebaked
+	const Float4x4 previous = scene.objects[1].objectToWorld;
+	scene.objects[1].objectToWorld = MakeTranslation({ -14.0f, 0.0f, 0.5f });
+	baker.InvalidateObject(1, previous);
+	for (uint32_t chart = 0; chart < baker.GetCharts().size(); chart++)
+	{
+		TEST_EXPECT(baker.IsChartBaked(chart) == (baker.GetCharts()[chart].object == 2));
+	}
+	const LightmapBakeStatistics statistics = baker.Bake();
+	TEST_EXPECT(statistics.numBakedCharts == 7);
+
+	LightmapBaker reference(&jobSystem, settings);
+	reference.SetScene(scene);
+	reference.Bake();
+	bool bRebakedMatch = true;
+	bool bUntouched = true;
+	for (const LightmapChart& chart : baker.GetCharts())
+	{
+		const LightmapAtlas& atlas = baker.GetAtlases()[chart.atlas];
+		for (uint32_t y = chart.y; y < chart.y + chart.height; y++)
+		{
+			for (uint32_t x = chart.x; x < chart.x + chart.width; x++)
+			{
+				const uint32_t index = y * settings.atlasSize + x;
+				if (atlas.coverage[index] == LightmapCoverage::Inside || atlas.coverage[index] == LightmapCoverage::Edge)
+				{
+					const Float3& value = atlas.irradiance[index];
+					const Float3& expected = chart.object == 2 ? before[chart.atlas].irradiance[index] : reference.GetAtlases()[chart.atlas].irradiance[index];
+					(chart.object == 2 ? bUntouched : bRebakedMatch) &= value.x == expected.x && value.y == expected.y && value.z == expected.z;
+				}
+			}
+		}
+	}
+	TEST_EXPECT(bRebakedMatch);
+	TEST_EXPECT(bUntouched);
+
+	// A light near the second box only reaches it and the floor
+	baker.InvalidateLight({ 13.0f, 2.0f, 0.0f }, 3.0f);
+	uint32_t numInvalid = 0;
+	for (uint32_t chart = 0; chart < baker.GetCharts().size(); chart++)
+	{
+		numInvalid += !baker.IsChartBaked(chart);
+		TEST_EXPECT(baker.IsChartBaked(chart) == (baker.GetCharts()[chart].object == 1));
+	}
+	TEST_EXPECT(numInvalid == 7);
+	baker.InvalidateAll();
+	TEST_EXPECT(baker.Bake().numBakedCharts == 13);
+}
+
+TEST_CASE(Lightmap_RoundTripsThroughFile)
+{
+	LightmapScene scene;
+	scene.materials.push_back({});
+	scene.objects.push_back(MakeFloor(2.0f));
+	scene.objects.push_back(MakeBox({ { -0.5f, 0.0f, -0.5f }, { 0.5f, 1.0f, 0.5f } }));
+	scene.skyRadiance = { 0.5f, 0.5f, 0.5f };
+	scene.sunIlluminance = { 1.0f, 0.8f, 0.6f };
+	scene.sunDirection = Normalize({ 0.3f, -1.0f, 0.2f });
+	JobSystem jobSystem(2);
+	LightmapSettings settings;
+	settings.atlasSize = 128;
+	settings.numSamples = 4;
+	LightmapBaker baker(&jobSystem, settings);
+	baker.SetScene(scene);
+	baker.Bake();
+
+	const std::vector<uint8_t> cooked = CookLightmap(baker);
+	const std::wstring fileName = (std::filesystem::temp_directory_path() / "LightmapTest.lightmap").wstring();
+	WriteLightmapFile(fileName, cooked);
+	{
+		Lightmap lightmap;
+		lightmap.Open(fileName);
+		TEST_EXPECT(lightmap.IsOpen() && lightmap.GetNumObjects() == 2 && lightmap.GetNumAtlases() == baker.GetAtlases().size());
+		TEST_EXPECT(lightmap.GetHeader().atlasSize == 128 && lightmap.GetHeader().numUVs == 6 + 36);
+		TEST_EXPECT(reinterpret_cast<uintptr_t>(lightmap.GetAtlas(0)) % LightmapSectionAlignment == 0);
+		for (uint32_t object = 0; object < 2; object++)
+		{
+			const std::vector<Float2>& uvs = baker.GetObjectUVs(object);
+			TEST_EXPECT(lightmap.GetFileObject(object).atlas == baker.GetObjectAtlas(object) && lightmap.GetFileObject(object).numUVs == uvs.size());
+			TEST_EXPECT(memcmp(lightmap.GetObjectUVs(object), uvs.data(), uvs.size() * sizeof(Float2)) == 0);
+		}
+
+		// Texel centers sample single texels, half floats keep 11 bits
+		const LightmapAtlas& atlas = baker.GetAtlases()[0];
+		bool bMatches = true;
+		for (uint32_t y = 0; y < 128; y += 7)
+		{
+			for (uint32_t x = 0; x < 128; x += 5)
+			{
+				const Float3& expected = atlas.irradiance[y * 128 + x];
+				const Float3 value = lightmap.SampleIrradiance(0, { (float(x) + 0.5f) / 128.0f, (float(y) + 0.5f) / 128.0f });
+				bMatches &= NearlyEqual(value, expected, 1e-3f) || std::max({ std::abs(expected.x), std::abs(expected.y), std::abs(expected.z) }) < 1e-4f;
+			}
+		}
+		TEST_EXPECT(bMatches);
+	}
+
+	// Malformed files are rejected
+	auto expectInvalid = [](std::vector<uint8_t> data)
+	{
+		Lightmap lightmap;
+		bool bThrown = false;
+		try
+		{
+			lightmap.OpenFromMemory(data.data(), data.size());
+		}
+		catch (const std::runtime_error&)
+		{
+			bThrown = true;
+		}
+		return bThrown && !lightmap.IsOpen();
+	};
+	TEST_EXPECT(expectInvalid(std::vector<uint8_t>(cooked.begin(), cooked.end() - 8)));
+	std::vector<uint8_t> badMagic = cooked;
+	badMagic[0] ^= 1;
+	TEST_EXPECT(expectInvalid(badMagic));
+	std::vector<uint8_t> badObject = cooked;
+	reinterpret_cast<LightmapFileObject*>(badObject.data() + reinterpret_cast<const LightmapFileHeader*>(cooked.data())->objectOffset)[1].numUVs = 1000;
+	TEST_EXPECT(expectInvalid(badObject));
+
+	bool bThrown = false;
+	try
+	{
+		LightmapBaker empty(&jobSystem);
+		CookLightmap(empty);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+
+	// Loaded at startup through the engine's asset path
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetLightmapPath(fileName);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("Lightmap_RoundTripsThroughFile"));
+	engine.OnInit();
+	TEST_EXPECT(engine.GetLightmap().IsOpen() && engine.GetLightmap().GetNumObjects() == 2);
+	engine.OnUpdate();
+	engine.OnDestroy();
+	Engine engineWithoutLightmap(320, 240, L"Headless", RHIBackend::Null);
+	engineWithoutLightmap.SetLightmapPath(fileName + L".missing");
+	engineWithoutLightmap.SetPipelineCachePath(GetTestPipelineCachePath("Lightmap_RoundTripsThroughFile_WithoutLightmap"));
+	engineWithoutLightmap.OnInit();
+	TEST_EXPECT(!engineWithoutLightmap.GetLightmap().IsOpen());
+	engineWithoutLightmap.OnDestroy();
+	std::filesystem::remove(fileName);
+}
+
+BENCHMARK_CASE(LightmapBaker_Bake)
+{
+	// Room with a few boxes, lit by the sun through an opening, a point light and the sky
+	LightmapScene scene;
+	scene.materials = { { { 0.7f, 0.7f, 0.7f } }, { { 0.7f, 0.2f, 0.2f } } };
+	scene.objects.push_back(MakeBox({ { -5.0f, -0.1f, -5.0f }, { 5.0f, 0.0f, 5.0f } }));
+	scene.objects.push_back(MakeBox({ { -5.1f, 0.0f, -5.0f }, { -5.0f, 4.0f, 5.0f } }, 1));
+	scene.objects.push_back(MakeBox({ { -5.0f, 0.0f, 5.0f }, { 5.0f, 4.0f, 5.1f } }));
+	scene.objects.push_back(MakeBox({ { -5.0f, 4.0f, -5.0f }, { 2.0f, 4.1f, 5.0f } }));
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		scene.objects.push_back(MakeBox({ { 0.0f, 0.0f, 0.0f }, { 0.8f, 0.5f + 0.2f * float(i), 0.8f } }, i % 2));
+		scene.objects.back().objectToWorld = MakeTranslation({ -4.0f + float(i), 0.0f, float(i % 3) * 2.0f - 2.0f });
+	}
+	scene.lights.AddPointLight({ -3.0f, 3.0f, -3.0f }, 4.0f, { 20.0f, 18.0f, 15.0f });
+	scene.sunDirection = Normalize({ -0.4f, -1.0f, 0.3f });
+	scene.sunIlluminance = { 3.0f, 3.0f, 2.5f };
+	scene.skyRadiance = { 0.4f, 0.5f, 0.7f };
+
+	JobSystem jobSystem;
+	LightmapSettings settings;
+	settings.texelsPerUnit = 4.0f;
+	settings.numSamples = 16;
+	settings.influenceDistance = 1.0f;
+	LightmapBaker baker(&jobSystem, settings);
+	BenchmarkTimer layoutTimer;
+	baker.SetScene(scene);
+	ReportBenchmark("Chart, pack and rasterize", layoutTimer.GetElapsedSeconds(), double(baker.GetCharts().size()), "chart");
+
+	const LightmapBakeStatistics statistics = baker.Bake();
+	ReportBenchmark("Full bake, 16 paths per texel", statistics.seconds, double(statistics.numTexels), "texel");
+	ReportBenchmark("  per thread", statistics.seconds * statistics.numThreads, double(statistics.numTexels), "texel");
+	ReportBenchmark("  rays", statistics.seconds, double(statistics.numRays), "ray");
+
+	// Out of the light's reach, the sun's sweep and the influence distance still take in part of the room
+	const Float4x4 previous = scene.objects[10].objectToWorld;
+	scene.objects[10].objectToWorld = MakeTranslation({ 2.5f, 0.0f, -2.0f });
+	baker.InvalidateObject(10, previous);
+	const LightmapBakeStatistics rebake = baker.Bake();
+	ReportBenchmark("Rebake after moving a box", rebake.seconds, double(rebake.numTexels), "texel");
+	printf("    %u of %u charts rebaked\n", rebake.numBakedCharts, rebake.numCharts);
+}
@@ -0,0 +1,320 @@
+#include "TestFramework.h"
+#include "MeshBuilder.h"
+#include "FileIO.h"
+
+#include <cmath>
+#include <filesystem>
+
+static std::wstring GetTestMeshPath(const char* name)
+{
+	return (std::filesystem::temp_directory_path() / (std::string("MeshFileTest_") + name + ".mesh")).wstring();
+}
+
+// Height field of (size + 1)^2 vertices, two submeshes split at the middle row
+static MeshData MakeGridMesh(uint32_t size)
+{
+	MeshData mesh;
+	for (uint32_t y = 0; y <= size; y++)
+	{
+		for (uint32_t x = 0; x <= size; x++)
+		{
+			const float height = std::sin(x * 0.1f) * std::cos(y * 0.1f);
+			mesh.positions.push_back({ float(x), height, float(y) });
+			mesh.texCoords.push_back({ float(x) / size, float(y) / size });
+		}
+	}
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			const uint32_t i = y * (size + 1) + x;
+			mesh.indices.insert(mesh.indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+		}
+	}
+	ComputeVertexNormals(mesh);
+	const uint32_t half = size / 2 * size * 6;
+	mesh.submeshes = { { 0, half, 0 }, { half, uint32_t(mesh.indices.size()) - half, 1 } };
+	mesh.materialNames = { "Ground", "Rock" };
+	return mesh;
+}
+
+static bool ThrowsInvalidMesh(const std::vector<uint8_t>& data)
+{
+	try
+	{
+		MeshFile meshFile;
+		meshFile.OpenFromMemory(data.data(), data.size());
+	}
+	catch (const std::runtime_error&)
+	{
+		return true;
+	}
+	return false;
+}
+
+TEST_CASE(MeshFile_RoundTrip)
+{
+	const MeshData mesh = MakeGridMesh(16);
+	const std::vector<uint8_t> cooked = CookMesh(mesh);
+
+	const std::wstring path = GetTestMeshPath("RoundTrip");
+	WriteMeshFile(path, cooked);
+	MeshFile meshFile;
+	meshFile.Open(path);
+
+	TEST_EXPECT(meshFile.GetNumVertices() == mesh.positions.size());
+	TEST_EXPECT(meshFile.GetNumIndices() == mesh.indices.size());
+	TEST_EXPECT(meshFile.GetHeader().indexSize == 2);
+	TEST_EXPECT(memcmp(meshFile.GetPositions(), mesh.positions.data(), mesh.positions.size() * sizeof(Float3)) == 0);
+	TEST_EXPECT(memcmp(meshFile.GetNormals(), mesh.normals.data(), mesh.normals.size() * sizeof(Float3)) == 0);
+	TEST_EXPECT(memcmp(meshFile.GetTexCoords(), mesh.texCoords.data(), mesh.texCoords.size() * sizeof(Float2)) == 0);
+	TEST_EXPECT(!meshFile.HasSection(MeshSectionType::QuantizedPositions));
+	for (uint32_t i = 0; i < meshFile.GetNumIndices(); i++)
+	{
+		TEST_EXPECT(meshFile.GetIndex(i) == mesh.indices[i]);
+	}
+
+	// Every section starts aligned so streams can be handed to upload memory or SIMD code directly
+	for (uint32_t type = 0; type < uint32_t(MeshSectionType::Count); type++)
+	{
+		if (const MeshSection* pSection = meshFile.GetSection(MeshSectionType(type)))
+		{
+			TEST_EXPECT(pSection->offset % MeshSectionAlignment == 0);
+		}
+	}
+
+	// Submesh bounds only cover their own triangles
+	TEST_EXPECT(meshFile.GetNumSubmeshes() == 2);
+	const MeshSubmesh* pSubmeshes = meshFile.GetSubmeshes();
+	TEST_EXPECT(pSubmeshes[0].bounds.min.z == 0.0f && pSubmeshes[0].bounds.max.z == 8.0f);
+	TEST_EXPECT(pSubmeshes[1].bounds.min.z == 8.0f && pSubmeshes[1].bounds.max.z == 16.0f);
+	TEST_EXPECT(meshFile.GetHeader().bounds.max.x == 16.0f);
+	TEST_EXPECT(strcmp(meshFile.GetMaterialName(pSubmeshes[1].materialIndex), "Rock") == 0);
+
+	std::error_code error;
+	std::filesystem::remove(path, error);
+}
+
+TEST_CASE(MeshFile_IndexWidth)
+{
+	// 257 x 257 vertices no longer fit 16 bit indices
+	for (uint32_t size : { 255u, 256u })
+	{
+		const std::vector<uint8_t> cooked = CookMesh(MakeGridMesh(size));
+		MeshFile meshFile;
+		meshFile.OpenFromMemory(cooked.data(), cooked.size());
+		TEST_EXPECT(meshFile.GetHeader().indexSize == (size == 255 ? 2u : 4u));
+		TEST_EXPECT(meshFile.GetIndex(meshFile.GetNumIndices() - 1) == meshFile.GetNumVertices() - 1);
+	}
+
+	MeshCookOptions options;
+	options.bForce32BitIndices = true;
+	const std::vector<uint8_t> cooked = CookMesh(MakeGridMesh(4), options);
+	MeshFile meshFile;
+	meshFile.OpenFromMemory(cooked.data(), cooked.size());
+	TEST_EXPECT(meshFile.GetHeader().indexSize == 4);
+}
+
+TEST_CASE(MeshFile_QuantizedStreams)
+{
+	const MeshData mesh = MakeGridMesh(32);
+	MeshCookOptions options;
+	options.bFloatPositions = false;
+	options.bFloatNormals = false;
+	options.bQuantizedPositions = true;
+	options.bQuantizedNormals = true;
+	const std::vector<uint8_t> cooked = CookMesh(mesh, options);
+	TEST_EXPECT(cooked.size() < CookMesh(mesh).size());
+
+	MeshFile meshFile;
+	meshFile.OpenFromMemory(cooked.data(), cooked.size());
+	TEST_EXPECT(meshFile.GetPositions() == nullptr && meshFile.GetNormals() == nullptr);
+
+	// Within one quantization step of the largest axis
+	const MeshBounds& bounds = meshFile.GetHeader().bounds;
+	const float maxError = (bounds.max.x - bounds.min.x) / 65535.0f;
+	const int8_t* pNormals = meshFile.GetQuantizedNormals();
+	for (uint32_t i = 0; i < meshFile.GetNumVertices(); i++)
+	{
+		const Float3 position = meshFile.GetPosition(i);
+		TEST_EXPECT(std::abs(position.x - mesh.positions[i].x) <= maxError);
+		TEST_EXPECT(std::abs(position.y - mesh.positions[i].y) <= maxError);
+		TEST_EXPECT(std::abs(position.z - mesh.positions[i].z) <= maxError);
+		TEST_EXPECT(std::abs(pNormals[i * 4 + 1] / 127.0f - mesh.normals[i].y) <= 1.0f / 127.0f);
+	}
+}
+
+TEST_CASE(MeshFile_RejectsMalformedFiles)
+{
+	const std::vector<uint8_t> cooked = CookMesh(MakeGridMesh(8));
+	TEST_EXPECT(!ThrowsInvalidMesh(cooked));
+
+	std::vector<uint8_t> truncated(cooked.begin(), cooked.end() - 1);
+	TEST_EXPECT(ThrowsInvalidMesh(truncated));
+	TEST_EXPECT(ThrowsInvalidMesh(std::vector<uint8_t>(cooked.begin(), cooked.begin() + 10)));
+
+	std::vector<uint8_t> badMagic = cooked;
+	badMagic[0] ^= 0xff;
+	TEST_EXPECT(ThrowsInvalidMesh(badMagic));
+
+	// A section pointing past the end of the file
+	std::vector<uint8_t> badSection = cooked;
+	MeshSection* pSection = reinterpret_cast<MeshSection*>(badSection.data() + sizeof(MeshFileHeader));
+	pSection->offset = (badSection.size() + MeshSectionAlignment) / MeshSectionAlignment * MeshSectionAlignment;
+	TEST_EXPECT(ThrowsInvalidMesh(badSection));
+
+	// More vertices than the streams hold
+	std::vector<uint8_t> badCount = cooked;
+	reinterpret_cast<MeshFileHeader*>(badCount.data())->numVertices++;
+	TEST_EXPECT(ThrowsInvalidMesh(badCount));
+
+	// Inconsistent source data is rejected before anything is written
+	MeshData mesh = MakeGridMesh(2);
+	mesh.indices.push_back(uint32_t(mesh.positions.size()));
+	bool bThrown = false;
+	try
+	{
+		CookMesh(mesh);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+TEST_CASE(MeshBuilder_ImportObj)
+{
+	const char obj[] =
+		"# quad and triangle\n"
+		"mtllib scene.mtl\n"
+		"v 0 0 0\nv 1 0 0\nv 1 0 1\nv 0 0 1\nv 0 1 0\n"
+		"vt 0 0\nvt 1 1\n"
+		"vn 0 1 0\n"
+		"usemtl Floor\n"
+		"f 1/1/1 2/1/1 3/2/1 4/2/1\n"
+		"usemtl Wall\r\n"
+		"f -5//1 -4//1 -1//1\n"
+		"usemtl Floor\n"
+		"f 1/1/1 3/2/1 4/2/1 # again\n";
+	const MeshData mesh = ImportObjFromMemory(obj, sizeof(obj) - 1);
+
+	// Fan triangulated quad + 2 triangles, identical corners are welded
+	TEST_EXPECT(mesh.indices.size() == 12);
+	TEST_EXPECT(mesh.positions.size() == 7);
+	TEST_EXPECT(mesh.materialNames.size() == 2 && mesh.materialNames[1] == "Wall");
+	TEST_EXPECT(mesh.submeshes.size() == 3);
+	TEST_EXPECT(mesh.submeshes[1].firstIndex == 6 && mesh.submeshes[1].numIndices == 3 && mesh.submeshes[1].materialIndex == 1);
+	TEST_EXPECT(mesh.submeshes[2].materialIndex == 0);
+	// V is flipped to the D3D convention
+	TEST_EXPECT(mesh.texCoords.size() == mesh.positions.size() && mesh.texCoords[2].y == 0.0f);
+	TEST_EXPECT(mesh.normals.size() == mesh.positions.size() && mesh.normals[0].y == 1.0f);
+
+	const std::vector<uint8_t> cooked = CookMesh(mesh);
+	MeshFile meshFile;
+	meshFile.OpenFromMemory(cooked.data(), cooked.size());
+	TEST_EXPECT(strcmp(meshFile.GetMaterialName(1), "Wall") == 0);
+
+	const char badObj[] = "v 0 0 0\nv 1 0 0\nf 1 2 3\n";
+	bool bThrown = false;
+	try
+	{
+		ImportObjFromMemory(badObj, sizeof(badObj) - 1);
+	}
+	catch (const std::runtime_error& exception)
+	{
+		bThrown = std::string(exception.what()).find("line 3") != std::string::npos;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+// Opening a cooked file should cost no more than reading its bytes, MODULETEST_MESH_BENCH_SIZE sets the grid size
+BENCHMARK_CASE(MeshFile_LoadThroughput)
+{
+	uint32_t gridSize = 1024;
+	if (const char* pSize = getenv("MODULETEST_MESH_BENCH_SIZE"))
+	{
+		gridSize = std::max<uint32_t>(uint32_t(strtoul(pSize, nullptr, 10)), 2);
+	}
+	const MeshData mesh = MakeGridMesh(gridSize);
+	const double numTriangles = double(mesh.indices.size() / 3);
+
+	std::vector<uint8_t> cooked;
+	{
+		BenchmarkTimer timer;
+		cooked = CookMesh(mesh);
+		ReportBenchmark("CookMesh", timer.GetElapsedSeconds(), numTriangles, "tri");
+	}
+	const std::wstring path = GetTestMeshPath("Benchmark");
+	WriteMeshFile(path, cooked);
+
+	auto checksum = [](const uint8_t* pData, uint64_t size)
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = 0; i + 8 <= size; i += 4096)
+		{
+			uint64_t value;
+			memcpy(&value, pData + i, 8);
+			sum += value;
+		}
+		return sum;
+	};
+
+	uint64_t referenceSum = 0;
+	{
+		std::vector<uint8_t> destination(cooked.size());
+		BenchmarkTimer timer;
+		File file;
+		file.Open(path);
+		file.ReadAt(0, destination.data(), destination.size());
+		referenceSum = checksum(destination.data(), destination.size());
+		ReportBenchmark("File::ReadAt whole file (I/O bound)", timer.GetElapsedSeconds(), double(cooked.size()), "B");
+	}
+	{
+		BenchmarkTimer timer;
+		MeshFile meshFile;
+		meshFile.Open(path);
+		const double openSeconds = timer.GetElapsedSeconds();
+		const uint8_t* pFileData = reinterpret_cast<const uint8_t*>(&meshFile.GetHeader());
+		const uint64_t sum = checksum(pFileData, meshFile.GetHeader().fileSize);
+		ReportBenchmark("MeshFile::Open (validation only)", openSeconds, numTriangles, "tri");
+		ReportBenchmark("MeshFile::Open + touch every page", timer.GetElapsedSeconds(), double(cooked.size()), "B");
+		TEST_EXPECT(sum == referenceSum);
+	}
+	{
+		const std::vector<uint8_t> data = ReadWholeFile(path);
+		BenchmarkTimer timer;
+		MeshFile meshFile;
+		meshFile.OpenFromMemory(data.data(), data.size());
+		ReportBenchmark("MeshFile::OpenFromMemory", timer.GetElapsedSeconds(), numTriangles, "tri");
+	}
+
+	std::error_code error;
+	std::filesystem::remove(path, error);
+}
+
+BENCHMARK_CASE(MeshBuilder_ImportObjThroughput)
+{
+	// Serialize the grid as OBJ text, then time the import alone
+	const MeshData mesh = MakeGridMesh(512);
+	std::string text;
+	char line[128];
+	for (const Float3& position : mesh.positions)
+	{
+		text.append(line, size_t(snprintf(line, sizeof(line), "v %f %f %f\n", position.x, position.y, position.z)));
+	}
+	for (const Float2& texCoord : mesh.texCoords)
+	{
+		text.append(line, size_t(snprintf(line, sizeof(line), "vt %f %f\n", texCoord.x, texCoord.y)));
+	}
+	for (size_t i = 0; i < mesh.indices.size(); i += 3)
+	{
+		text.append(line, size_t(snprintf(line, sizeof(line), "f %u/%u %u/%u %u/%u\n",
+			mesh.indices[i] + 1, mesh.indices[i] + 1, mesh.indices[i + 1] + 1, mesh.indices[i + 1] + 1, mesh.indices[i + 2] + 1, mesh.indices[i + 2] + 1)));
+	}
+
+	BenchmarkTimer timer;
+	const MeshData imported = ImportObjFromMemory(text.data(), text.size());
+	ReportBenchmark("ImportObjFromMemory", timer.GetElapsedSeconds(), double(text.size()), "B");
+	TEST_EXPECT(imported.indices.size() == mesh.indices.size());
+}
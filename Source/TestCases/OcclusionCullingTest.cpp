@@ -0,0 +1,268 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Camera.h"
+#include "Engine.h"
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <random>
+
+struct OcclusionTestScene
+{
+	std::vector<BoundingBox>	occluders;
+	OccluderMesh				occluderMesh;	// All occluder boxes
+	std::vector<BoundingBox>	occludees;
+	CullingBounds				bounds;			// Of the occludees
+};
+
+static BoundingBox MakeBox(const Float3& center, const Float3& halfSize)
+{
+	return { center - halfSize, center + halfSize };
+}
+
+// Walls in front of the camera and small objects scattered behind and between them
+static OcclusionTestScene MakeTestScene(uint32_t numOccluders, uint32_t numOccludees, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	OcclusionTestScene scene;
+	for (uint32_t i = 0; i < numOccluders; i++)
+	{
+		const Float3 center = { unit(random) * 50.0f - 25.0f, unit(random) * 10.0f - 5.0f, 10.0f + unit(random) * 30.0f };
+		const Float3 halfSize = { 1.0f + unit(random) * 4.0f, 1.0f + unit(random) * 3.0f, 0.25f };
+		scene.occluders.push_back(MakeBox(center, halfSize));
+		scene.occluderMesh.AddBox(scene.occluders.back());
+	}
+	for (uint32_t i = 0; i < numOccludees; i++)
+	{
+		const Float3 center = { unit(random) * 80.0f - 40.0f, unit(random) * 20.0f - 10.0f, 5.0f + unit(random) * 75.0f };
+		const Float3 halfSize = { 0.15f + unit(random) * 0.6f, 0.15f + unit(random) * 0.6f, 0.15f + unit(random) * 0.6f };
+		scene.occludees.push_back(MakeBox(center, halfSize));
+		scene.bounds.Add({ center, Length(halfSize) }, scene.occludees.back());
+	}
+	return scene;
+}
+
+// Distance along the ray to the box, or a negative value on a miss
+static float IntersectRayBox(const Float3& origin, const Float3& direction, const BoundingBox& box)
+{
+	const float originComponents[3] = { origin.x, origin.y, origin.z };
+	const float directionComponents[3] = { direction.x, direction.y, direction.z };
+	const float minComponents[3] = { box.min.x, box.min.y, box.min.z };
+	const float maxComponents[3] = { box.max.x, box.max.y, box.max.z };
+	float tNear = 0.0f;
+	float tFar = 1e30f;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const float invDirection = 1.0f / directionComponents[axis];
+		float t0 = (minComponents[axis] - originComponents[axis]) * invDirection;
+		float t1 = (maxComponents[axis] - originComponents[axis]) * invDirection;
+		if (t0 > t1)
+		{
+			std::swap(t0, t1);
+		}
+		tNear = std::max(tNear, t0);
+		tFar = std::min(tFar, t1);
+	}
+	return tNear <= tFar ? tNear : -1.0f;
+}
+
+// Ray cast through `samplesPerPixel`^2 points of every pixel of the occlusion buffer the box may cover
+static bool IsVisibleReference(const OcclusionTestScene& scene, const Camera& camera, uint32_t width, uint32_t height, uint32_t occludee, uint32_t samplesPerPixel)
+{
+	const Float3 forward = Normalize(camera.forward);
+	const Float3 right = Normalize(Cross(camera.up, forward));
+	const Float3 up = Cross(forward, right);
+	const float tanHalfFov = std::tan(camera.fovY * 0.5f);
+	const uint32_t sampleWidth = width * samplesPerPixel;
+	const uint32_t sampleHeight = height * samplesPerPixel;
+	for (uint32_t y = 0; y < sampleHeight; y++)
+	{
+		for (uint32_t x = 0; x < sampleWidth; x++)
+		{
+			const float ndcX = (float(x) + 0.5f) / float(sampleWidth) * 2.0f - 1.0f;
+			const float ndcY = 1.0f - (float(y) + 0.5f) / float(sampleHeight) * 2.0f;
+			const Float3 direction = forward + right * (ndcX * tanHalfFov * camera.aspectRatio) + up * (ndcY * tanHalfFov);
+			const float distance = IntersectRayBox(camera.position, direction, scene.occludees[occludee]);
+			if (distance < 0.0f)
+			{
+				continue;
+			}
+			bool bHidden = false;
+			for (const BoundingBox& occluder : scene.occluders)
+			{
+				const float occluderDistance = IntersectRayBox(camera.position, direction, occluder);
+				bHidden |= occluderDistance >= 0.0f && occluderDistance < distance;
+			}
+			if (!bHidden)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+TEST_CASE(OcclusionCulling_BoxOccluderFrontFaces)
+{
+	JobSystem jobSystem(1);
+	Camera camera;
+	camera.aspectRatio = 2.0f;
+	OcclusionCuller culler(&jobSystem, 128, 64);
+
+	OccluderMesh mesh;
+	mesh.AddBox(MakeBox({ 0.0f, 0.0f, 10.0f }, { 1.0f, 1.0f, 1.0f }));
+	TEST_EXPECT(mesh.GetNumTriangles() == 12);
+	culler.BeginFrame(camera.GetViewProjectionMatrix());
+	culler.AddOccluder(mesh, MatrixIdentity());
+	culler.RenderOccluders();
+
+	// Only the face towards the camera is front facing, its depth is where the box starts
+	TEST_EXPECT(culler.GetStatistics().numOccluderTriangles == 12);
+	TEST_EXPECT(culler.GetStatistics().numRasterizedTriangles == 2);
+	const Float4 clip = Transform({ 0.0f, 0.0f, 9.0f, 1.0f }, camera.GetViewProjectionMatrix());
+	TEST_EXPECT(std::abs(culler.GetDepth()[32 * culler.GetPitch() + 64] - clip.z / clip.w) < 1e-5f);
+	TEST_EXPECT(culler.GetDepth()[0] == 1.0f);
+
+	// Moved with the world matrix, the buffer is rebuilt from scratch every frame
+	Float4x4 world = MatrixIdentity();
+	world.m[3][0] = 100.0f;
+	culler.BeginFrame(camera.GetViewProjectionMatrix());
+	culler.AddOccluder(mesh, world);
+	culler.RenderOccluders();
+	TEST_EXPECT(culler.GetStatistics().numRasterizedTriangles == 0);
+	TEST_EXPECT(culler.GetDepth()[32 * culler.GetPitch() + 64] == 1.0f);
+}
+
+TEST_CASE(OcclusionCulling_HidesObjectsBehindWall)
+{
+	JobSystem jobSystem(2);
+	Camera camera;
+	camera.aspectRatio = 16.0f / 9.0f;
+	OcclusionCuller culler(&jobSystem, 320, 180);
+
+	OccluderMesh wall;
+	wall.AddBox(MakeBox({ 0.0f, 0.0f, 10.0f }, { 4.0f, 2.0f, 0.5f }));
+	culler.BeginFrame(camera.GetViewProjectionMatrix());
+	culler.AddOccluder(wall, MatrixIdentity());
+	culler.RenderOccluders();
+
+	TEST_EXPECT(!culler.IsVisible(MakeBox({ 0.0f, 0.0f, 20.0f }, { 1.0f, 1.0f, 1.0f })));		// Behind
+	TEST_EXPECT(!culler.IsVisible(MakeBox({ 7.0f, 3.0f, 30.0f }, { 0.5f, 0.5f, 0.5f })));		// Behind, near the corner
+	TEST_EXPECT(culler.IsVisible(MakeBox({ 0.0f, 0.0f, 5.0f }, { 0.5f, 0.5f, 0.5f })));		// In front
+	TEST_EXPECT(culler.IsVisible(MakeBox({ 10.0f, 0.0f, 20.0f }, { 1.0f, 1.0f, 1.0f })));		// Beside
+	TEST_EXPECT(culler.IsVisible(MakeBox({ 0.0f, 4.3f, 20.0f }, { 1.0f, 0.5f, 1.0f })));		// Peeks over the top
+	TEST_EXPECT(culler.IsVisible(MakeBox({ 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f })));		// Contains the camera
+
+	CullingBounds bounds;
+	for (const float z : { 20.0f, 5.0f, 30.0f })
+	{
+		const BoundingBox box = MakeBox({ 0.0f, 0.0f, z }, { 0.5f, 0.5f, 0.5f });
+		bounds.Add({ { 0.0f, 0.0f, z }, 0.9f }, box);
+	}
+	culler.TestOccludees(bounds, { 0, 1, 2 });
+	TEST_EXPECT(culler.GetVisibleIndices() == std::vector<uint32_t>({ 1 }));
+	TEST_EXPECT(culler.GetStatistics().numTestedObjects == 3 && culler.GetStatistics().numOccludedObjects == 2);
+}
+
+TEST_CASE(OcclusionCulling_MatchesRayCast)
+{
+	// Objects the ray cast sees may only be culled when they show through less than a pixel of the buffer
+	JobSystem jobSystem(2);
+	const uint32_t width = 160;
+	const uint32_t height = 90;
+	Camera camera;
+	camera.aspectRatio = float(width) / float(height);
+	const OcclusionTestScene scene = MakeTestScene(24, 400, 1);
+
+	FrustumCuller frustumCuller(&jobSystem);
+	frustumCuller.Cull(scene.bounds, ExtractFrustumPlanes(camera.GetViewProjectionMatrix()));
+	OcclusionCuller culler(&jobSystem, width, height);
+	culler.BeginFrame(camera.GetViewProjectionMatrix());
+	culler.AddOccluder(scene.occluderMesh, MatrixIdentity());
+	culler.RenderOccluders();
+	culler.TestOccludees(scene.bounds, frustumCuller.GetVisibleIndices());
+
+	std::vector<bool> bVisible(scene.occludees.size(), false);
+	for (const uint32_t object : culler.GetVisibleIndices())
+	{
+		bVisible[object] = true;
+	}
+	uint32_t numReferenceVisible = 0;
+	uint32_t numFalselyCulled = 0;
+	uint32_t numCulled = 0;
+	for (const uint32_t object : frustumCuller.GetVisibleIndices())
+	{
+		if (bVisible[object])
+		{
+			continue;
+		}
+		numCulled++;
+		numFalselyCulled += IsVisibleReference(scene, camera, width, height, object, 1) ? 1 : 0;
+	}
+	for (const uint32_t object : culler.GetVisibleIndices())
+	{
+		numReferenceVisible += IsVisibleReference(scene, camera, width, height, object, 1) ? 1 : 0;
+	}
+
+	// Sampled at the same pixel centers nothing visible is lost, and most of what is left is actually visible
+	TEST_EXPECT(numFalselyCulled == 0);
+	TEST_EXPECT(numCulled > frustumCuller.GetVisibleIndices().size() / 4);
+	TEST_EXPECT(numReferenceVisible * 10 > culler.GetVisibleIndices().size() * 7);
+}
+
+TEST_CASE(OcclusionCulling_EngineFrame)
+{
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("OcclusionCulling_EngineFrame"));
+	engine.OnInit();
+	engine.GetObjectBounds().Add({ { 0.0f, 0.0f, 20.0f }, 1.0f }, MakeBox({ 0.0f, 0.0f, 20.0f }, { 0.5f, 0.5f, 0.5f }));
+	engine.GetObjectBounds().Add({ { 0.0f, 0.0f, 5.0f }, 1.0f }, MakeBox({ 0.0f, 0.0f, 5.0f }, { 0.5f, 0.5f, 0.5f }));
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetVisibleObjects() == std::vector<uint32_t>({ 0, 1 }));
+
+	engine.GetOccluders().emplace_back().AddBox(MakeBox({ 0.0f, 0.0f, 10.0f }, { 4.0f, 4.0f, 0.5f }));
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetVisibleObjects() == std::vector<uint32_t>({ 1 }));
+	TEST_EXPECT(engine.GetOcclusionCuller()->GetStatistics().numOccludedObjects == 1);
+	engine.OnDestroy();
+}
+
+BENCHMARK_CASE(OcclusionCulling_Cull)
+{
+	JobSystem jobSystem;
+	const OcclusionTestScene scene = MakeTestScene(2000, 100000, 2);
+	for (const uint32_t width : { 320u, 640u })
+	{
+		const uint32_t height = width * 9 / 16;
+		Camera camera;
+		camera.aspectRatio = float(width) / float(height);
+		FrustumCuller frustumCuller(&jobSystem);
+		frustumCuller.Cull(scene.bounds, ExtractFrustumPlanes(camera.GetViewProjectionMatrix()));
+		OcclusionCuller culler(&jobSystem, width, height);
+
+		const uint32_t numIterations = 10;
+		double renderSeconds = 0.0;
+		double testSeconds = 0.0;
+		for (uint32_t i = 0; i < numIterations; i++)
+		{
+			BenchmarkTimer renderTimer;
+			culler.BeginFrame(camera.GetViewProjectionMatrix());
+			culler.AddOccluder(scene.occluderMesh, MatrixIdentity());
+			culler.RenderOccluders();
+			renderSeconds += renderTimer.GetElapsedSeconds();
+
+			BenchmarkTimer testTimer;
+			culler.TestOccludees(scene.bounds, frustumCuller.GetVisibleIndices());
+			testSeconds += testTimer.GetElapsedSeconds();
+		}
+		const OcclusionCullingStatistics& statistics = culler.GetStatistics();
+		char name[128];
+		snprintf(name, sizeof(name), "%ux%u render, %u of %u triangles", width, height, statistics.numRasterizedTriangles, statistics.numOccluderTriangles);
+		ReportBenchmark(name, renderSeconds, double(statistics.numOccluderTriangles) * numIterations, "tri");
+		snprintf(name, sizeof(name), "%ux%u test, %u of %u occluded", width, height, statistics.numOccludedObjects, statistics.numTestedObjects);
+		ReportBenchmark(name, testSeconds, double(statistics.numTestedObjects) * numIterations, "object");
+		printf("    %.3f ms render + %.3f ms test per frame\n", renderSeconds * 1000.0 / numIterations, testSeconds * 1000.0 / numIterations);
+	}
+}
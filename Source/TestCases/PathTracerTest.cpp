@@ -0,0 +1,359 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "PathTracer.h"
+
+#include <cfloat>
+#include <filesystem>
+#include <random>
+
+// Large floor quad at y = 0
+static void AddFloor(PathTracerScene& scene, uint32_t material, float size = 100.0f)
+{
+	const Float3 corners[4] = { { -size, 0.0f, -size }, { size, 0.0f, -size }, { -size, 0.0f, size }, { size, 0.0f, size } };
+	const uint32_t indices[6] = { 0, 2, 1, 1, 2, 3 };
+	scene.AddTriangles(corners, nullptr, 4, indices, 6, material);
+}
+
+TEST_CASE(Bvh_MatchesBruteForce)
+{
+	std::mt19937 random(7);
+	std::vector<Float3> positions;
+	std::vector<uint32_t> indices;
+	AddRandomTriangles(random, 3000, 10.0f, 1.0f, positions, indices);
+	// Clustered duplicates end up in one bin, degenerate triangles never hit
+	for (uint32_t i = 0; i < 20; i++)
+	{
+		indices.insert(indices.end(), { 0, 1, 2 });
+	}
+	indices.insert(indices.end(), { 3, 3, 4 });
+	const uint32_t numTriangles = uint32_t(indices.size() / 3);
+
+	for (const uint32_t numWorkers : { 0u, 3u })
+	{
+		JobSystem jobSystem(numWorkers);
+		Bvh bvh(&jobSystem);
+		bvh.Build(positions.data(), indices.data(), numTriangles);
+		const BvhBuildStatistics& statistics = bvh.GetStatistics();
+		TEST_EXPECT(bvh.GetNumTriangles() == numTriangles);
+		TEST_EXPECT(statistics.numNodes == statistics.numLeaves * 2 - 1);
+		TEST_EXPECT(statistics.maxDepth < Bvh::MaxDepth);
+		TEST_EXPECT(statistics.sahCost > 1.0f && statistics.sahCost < float(numTriangles) / 10.0f);
+
+		// Every leaf's bounds contain its triangles and every triangle is in exactly one leaf
+		uint32_t numLeafTriangles = 0;
+		for (const BvhNode& node : bvh.GetNodes())
+		{
+			TEST_EXPECT(node.boundsMin.x <= node.boundsMax.x && node.boundsMin.y <= node.boundsMax.y && node.boundsMin.z <= node.boundsMax.z);
+			numLeafTriangles += node.count;
+		}
+		TEST_EXPECT(numLeafTriangles == numTriangles);
+
+		std::uniform_real_distribution<float> coordinate(-12.0f, 12.0f);
+		uint32_t numHits = 0;
+		for (uint32_t i = 0; i < 2000; i++)
+		{
+			BvhRay ray;
+			ray.origin = { coordinate(random), coordinate(random), coordinate(random) };
+			ray.direction = Float3{ coordinate(random), coordinate(random), coordinate(random) } - ray.origin;
+			ray.tMax = i % 2 ? 1.0f : 1e30f;
+			BvhHit expected, hit;
+			const bool bExpected = IntersectBruteForce(positions, indices, ray, expected);
+			TEST_EXPECT(bvh.Intersect(ray, hit) == bExpected);
+			TEST_EXPECT(bvh.IsOccluded(ray) == bExpected);
+			if (bExpected)
+			{
+				// Float against the double precision reference, short hits of long rays lose the most
+				TEST_EXPECT(NearlyEqual(hit.t, expected.t, 1e-4f));
+				// Ties between overlapping triangles may pick either one
+				TEST_EXPECT(hit.triangle == expected.triangle || NearlyEqual(hit.t, expected.t, 1e-6f));
+				numHits++;
+			}
+		}
+		TEST_EXPECT(numHits > 200);
+	}
+}
+
+TEST_CASE(Bvh_EmptyAndSingleTriangle)
+{
+	JobSystem jobSystem(0);
+	Bvh bvh(&jobSystem);
+	bvh.Build(nullptr, nullptr, 0);
+	const BvhRay ray = { { 0.25f, 0.25f, -1.0f }, { 0.0f, 0.0f, 1.0f } };
+	BvhHit hit;
+	TEST_EXPECT(!bvh.Intersect(ray, hit));
+	TEST_EXPECT(!bvh.IsOccluded(ray));
+
+	const Float3 positions[3] = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+	const uint32_t indices[3] = { 0, 1, 2 };
+	bvh.Build(positions, indices, 1);
+	TEST_EXPECT(bvh.GetNodes().size() == 1);
+	TEST_EXPECT(bvh.Intersect(ray, hit));
+	TEST_EXPECT(hit.triangle == 0 && NearlyEqual(hit.t, 1.0f, 1e-6f) && NearlyEqual(hit.u, 0.25f, 1e-5f) && NearlyEqual(hit.v, 0.25f, 1e-5f));
+	TEST_EXPECT(!bvh.IsOccluded({ ray.origin, ray.direction, 0.0f, 0.5f }));
+	TEST_EXPECT(!bvh.Intersect({ { 2.0f, 2.0f, -1.0f }, { 0.0f, 0.0f, 1.0f } }, hit));
+}
+
+TEST_CASE(PathTracer_ConvexFurnace)
+{
+	// A convex box under uniform sky: every bounce escapes, so the box is exactly albedo * sky
+	PathTracerScene scene;
+	scene.skyRadiance = { 1.0f, 2.0f, 0.5f };
+	const uint32_t material = scene.AddMaterial({ { 0.5f, 0.25f, 1.0f } });
+	scene.AddBox({ { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f } }, material);
+
+	JobSystem jobSystem(2);
+	PathTracer pathTracer(&jobSystem);
+	pathTracer.SetScene(scene);
+	pathTracer.Reset(32, 32);
+	Camera camera;
+	camera.position = { 0.5f, 1.0f, -4.0f };
+	camera.forward = Normalize(Float3{ 0.0f, 0.0f, 0.0f } - camera.position);
+	camera.aspectRatio = 1.0f;
+	pathTracer.Render(camera, 2);
+
+	HdrImage image;
+	pathTracer.ResolveImage(image);
+	TEST_EXPECT(NearlyEqual(image.GetPixel(16, 16), { 0.5f, 0.5f, 0.5f }, 1e-5f));
+	TEST_EXPECT(NearlyEqual(image.GetPixel(0, 0), scene.skyRadiance, 1e-6f));
+	TEST_EXPECT(pathTracer.GetStatistics().numSamples == 32 * 32 * 2);
+}
+
+TEST_CASE(PathTracer_ClosedFurnaceConverges)
+{
+	// Inside a closed emissive box: L = E + a * L, so L = E / (1 - a). Exercises many bounces and russian roulette
+	PathTracerScene scene;
+	const uint32_t material = scene.AddMaterial({ { 0.5f, 0.5f, 0.5f }, { 1.0f, 0.5f, 0.25f } });
+	scene.AddBox({ { -2.0f, -2.0f, -2.0f }, { 2.0f, 2.0f, 2.0f } }, material);
+
+	PathTracerSettings settings;
+	settings.maxBounces = 64;
+	JobSystem jobSystem(2);
+	PathTracer pathTracer(&jobSystem, settings);
+	pathTracer.SetScene(scene);
+	pathTracer.Reset(32, 32);
+	Camera camera;
+	camera.aspectRatio = 1.0f;
+	pathTracer.Render(camera, 16);
+
+	HdrImage image;
+	pathTracer.ResolveImage(image);
+	Float3 mean = { 0.0f, 0.0f, 0.0f };
+	for (const Float3& pixel : image.pixels)
+	{
+		mean = mean + pixel * (1.0f / float(image.pixels.size()));
+	}
+	TEST_EXPECT(NearlyEqual(mean, { 2.0f, 1.0f, 0.5f }, 0.02f));
+}
+
+TEST_CASE(PathTracer_DirectLightingMatchesAnalytic)
+{
+	PathTracerScene scene;
+	const Float3 albedo = { 0.6f, 0.4f, 0.2f };
+	const uint32_t material = scene.AddMaterial({ albedo });
+	AddFloor(scene, material);
+	const Float3 intensity = { 10.0f, 20.0f, 5.0f };
+	scene.lights.AddPointLight({ 0.0f, 2.0f, 0.0f }, 8.0f, intensity);
+	scene.lights.AddSpotLight({ 5.0f, 3.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, 8.0f, 0.3f, intensity);
+
+	JobSystem jobSystem(0);
+	PathTracer pathTracer(&jobSystem);
+	pathTracer.SetScene(scene);
+	auto shadeFloor = [&](const Float3& point)
+	{
+		uint64_t numRays = 0;
+		return pathTracer.TracePath({ point + Float3{ 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } }, 0, 0, numRays);
+	};
+	auto expectedPointLight = [&](const Float3& point)
+	{
+		const Float3 toLight = Float3{ 0.0f, 2.0f, 0.0f } - point;
+		const float distanceSquared = Dot(toLight, toLight);
+		const float irradianceScale = GetLightDistanceAttenuation(distanceSquared, 8.0f) * toLight.y / std::sqrt(distanceSquared);
+		return Float3{ albedo.x * intensity.x, albedo.y * intensity.y, albedo.z * intensity.z } * (irradianceScale / Pi);
+	};
+
+	// Below the point light, then off axis where only its falloff and cosine apply (the spot cone ends at x ~ 4.07)
+	TEST_EXPECT(NearlyEqual(shadeFloor({ 0.0f, 0.0f, 0.0f }), expectedPointLight({ 0.0f, 0.0f, 0.0f }), 1e-4f));
+	TEST_EXPECT(NearlyEqual(shadeFloor({ -3.0f, 0.0f, 1.0f }), expectedPointLight({ -3.0f, 0.0f, 1.0f }), 1e-4f));
+	// Beyond the radius nothing arrives
+	TEST_EXPECT(NearlyEqual(shadeFloor({ -20.0f, 0.0f, 0.0f }), { 0.0f, 0.0f, 0.0f }, 1e-6f));
+
+	// Centre of the spot cone adds the spot light at full strength
+	const Float3 spot = shadeFloor({ 5.0f, 0.0f, 0.0f }) - expectedPointLight({ 5.0f, 0.0f, 0.0f });
+	const float spotScale = GetLightDistanceAttenuation(9.0f, 8.0f) / Pi;
+	TEST_EXPECT(NearlyEqual(spot, Float3{ albedo.x * intensity.x, albedo.y * intensity.y, albedo.z * intensity.z } * spotScale, 1e-4f));
+
+	// A blocker between the point light and the floor casts a shadow, the ray starts below it
+	const uint32_t blocker = scene.AddMaterial({ { 0.0f, 0.0f, 0.0f } });
+	scene.AddBox({ { -0.5f, 0.9f, -0.5f }, { 0.5f, 1.1f, 0.5f } }, blocker);
+	pathTracer.SetScene(scene);
+	TEST_EXPECT(NearlyEqual(shadeFloor({ 0.0f, -0.5f, 0.0f }), { 0.0f, 0.0f, 0.0f }, 1e-6f));
+
+	// Sun at 60 degrees from the normal
+	PathTracerScene sunScene;
+	AddFloor(sunScene, sunScene.AddMaterial({ albedo }));
+	sunScene.sunDirection = { std::sin(Pi / 3.0f), -std::cos(Pi / 3.0f), 0.0f };
+	sunScene.sunIlluminance = { 2.0f, 2.0f, 2.0f };
+	pathTracer.SetScene(sunScene);
+	TEST_EXPECT(NearlyEqual(shadeFloor({ 0.0f, 0.0f, 0.0f }), albedo * (2.0f * 0.5f / Pi), 1e-4f));
+}
+
+TEST_CASE(PathTracer_DeterministicAcrossThreadsAndPasses)
+{
+	PathTracerScene scene;
+	scene.skyRadiance = { 0.3f, 0.4f, 0.6f };
+	const uint32_t white = scene.AddMaterial({});
+	const uint32_t red = scene.AddMaterial({ { 0.8f, 0.2f, 0.2f } });
+	AddFloor(scene, white, 20.0f);
+	scene.AddBox({ { -1.0f, 0.0f, 2.0f }, { 1.0f, 2.0f, 4.0f } }, red);
+	scene.lights.AddPointLight({ 2.0f, 3.0f, 1.0f }, 10.0f, { 20.0f, 20.0f, 20.0f });
+	scene.sunIlluminance = { 1.0f, 1.0f, 1.0f };
+	scene.sunDirection = Normalize({ -0.3f, -1.0f, 0.4f });
+
+	Camera camera;
+	camera.position = { 0.0f, 1.5f, -3.0f };
+	camera.aspectRatio = 40.0f / 24.0f;
+
+	// Tiles do not divide the image evenly
+	std::vector<HdrImage> images;
+	for (const uint32_t numWorkers : { 0u, 3u })
+	{
+		JobSystem jobSystem(numWorkers);
+		PathTracer pathTracer(&jobSystem);
+		pathTracer.SetScene(scene);
+		pathTracer.Reset(40, 24);
+		pathTracer.Render(camera, 3);
+		pathTracer.Render(camera, 2);
+		TEST_EXPECT(pathTracer.GetNumSamplesPerPixel() == 5);
+		TEST_EXPECT(pathTracer.GetStatistics().numRays > 40 * 24 * 5);
+		images.emplace_back();
+		pathTracer.ResolveImage(images.back());
+	}
+	TEST_EXPECT(std::equal(images[0].pixels.begin(), images[0].pixels.end(), images[1].pixels.begin(),
+		[](const Float3& a, const Float3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }));
+
+	// Same samples in a single pass, only the summation order differs
+	JobSystem jobSystem(1);
+	PathTracer pathTracer(&jobSystem);
+	pathTracer.SetScene(scene);
+	pathTracer.Reset(40, 24);
+	pathTracer.Render(camera, 5);
+	HdrImage image;
+	pathTracer.ResolveImage(image);
+	for (size_t i = 0; i < image.pixels.size(); i++)
+	{
+		TEST_EXPECT(NearlyEqual(image.pixels[i], images[0].pixels[i], 1e-5f));
+	}
+}
+
+TEST_CASE(HdrImage_RoundTrip)
+{
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> value(0.0f, 100.0f);
+	// Widths below 8 are written flat, the others run length encoded
+	for (const uint32_t width : { 5u, 64u, 300u })
+	{
+		HdrImage image;
+		image.Resize(width, 7);
+		for (uint32_t y = 0; y < image.height; y++)
+		{
+			for (uint32_t x = 0; x < image.width; x++)
+			{
+				// Runs of equal pixels, noise, black and negative values
+				image.GetPixel(x, y) = y == 0 ? Float3{ 1.0f, 0.5f, 0.25f } : (y == 1 ? Float3{ 0.0f, 0.0f, 0.0f } :
+					(y == 2 ? Float3{ -1.0f, 2.0f, 0.0f } : Float3{ value(random), value(random) * 1e-3f, value(random) * 1e3f }));
+			}
+		}
+
+		const std::wstring fileName = (std::filesystem::temp_directory_path() / "PathTracerTest.hdr").wstring();
+		WriteHdrImage(fileName, image);
+		const HdrImage decoded = ReadHdrImage(fileName);
+		std::filesystem::remove(fileName);
+		TEST_EXPECT(decoded.width == image.width && decoded.height == image.height);
+		for (uint32_t y = 0; y < image.height; y++)
+		{
+			for (uint32_t x = 0; x < image.width; x++)
+			{
+				// 8 bit mantissas relative to the largest component
+				const Float3& expected = image.GetPixel(x, y);
+				const Float3& actual = decoded.GetPixel(x, y);
+				const float tolerance = std::max({ expected.x, expected.y, expected.z }) / 128.0f;
+				TEST_EXPECT(std::abs(actual.x - std::max(expected.x, 0.0f)) <= tolerance);
+				TEST_EXPECT(std::abs(actual.y - expected.y) <= tolerance);
+				TEST_EXPECT(std::abs(actual.z - expected.z) <= tolerance);
+			}
+		}
+		if (width >= 8)
+		{
+			TEST_EXPECT(EncodeHdrImage(image).size() < size_t(width) * image.height * 4);
+		}
+	}
+
+	const char truncated[] = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y 4 +X 4\n\x10\x20";
+	bool bThrown = false;
+	try
+	{
+		DecodeHdrImage(reinterpret_cast<const uint8_t*>(truncated), sizeof(truncated) - 1);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+BENCHMARK_CASE(Bvh_Build)
+{
+	std::mt19937 random(11);
+	std::vector<Float3> positions;
+	std::vector<uint32_t> indices;
+	AddRandomTriangles(random, 1 << 20, 100.0f, 0.5f, positions, indices);
+	JobSystem jobSystem;
+	Bvh bvh(&jobSystem);
+	BenchmarkTimer timer;
+	bvh.Build(positions.data(), indices.data(), uint32_t(indices.size() / 3));
+	const double seconds = timer.GetElapsedSeconds();
+	ReportBenchmark("Build 1M triangles, binned SAH", seconds, double(indices.size() / 3), "triangle");
+	printf("    %u nodes, depth %u, SAH cost %.1f\n", bvh.GetStatistics().numNodes, bvh.GetStatistics().maxDepth, bvh.GetStatistics().sahCost);
+}
+
+BENCHMARK_CASE(PathTracer_Render)
+{
+	// Room with colored walls, boxes and a sun through an opening, lit by point lights
+	PathTracerScene scene;
+	scene.skyRadiance = { 0.4f, 0.5f, 0.7f };
+	const uint32_t white = scene.AddMaterial({});
+	const uint32_t red = scene.AddMaterial({ { 0.7f, 0.1f, 0.1f } });
+	const uint32_t green = scene.AddMaterial({ { 0.1f, 0.7f, 0.1f } });
+	scene.AddBox({ { -5.0f, -0.1f, -5.0f }, { 5.0f, 0.0f, 5.0f } }, white);
+	scene.AddBox({ { -5.1f, 0.0f, -5.0f }, { -5.0f, 5.0f, 5.0f } }, red);
+	scene.AddBox({ { 5.0f, 0.0f, -5.0f }, { 5.1f, 5.0f, 5.0f } }, green);
+	scene.AddBox({ { -5.0f, 0.0f, 5.0f }, { 5.0f, 5.0f, 5.1f } }, white);
+	scene.AddBox({ { -5.0f, 5.0f, -5.0f }, { 2.0f, 5.1f, 5.0f } }, white);
+	std::mt19937 random(5);
+	std::vector<Float3> positions;
+	std::vector<uint32_t> indices;
+	AddRandomTriangles(random, 20000, 3.0f, 0.2f, positions, indices);
+	for (Float3& position : positions)
+	{
+		position.y += 2.5f;
+	}
+	scene.AddTriangles(positions.data(), nullptr, uint32_t(positions.size()), indices.data(), uint32_t(indices.size()), white);
+	scene.lights.AddPointLight({ -2.0f, 4.0f, 0.0f }, 12.0f, { 30.0f, 25.0f, 20.0f });
+	scene.lights.AddSpotLight({ 3.0f, 4.5f, -3.0f }, { -0.3f, -1.0f, 0.5f }, 10.0f, 0.6f, { 40.0f, 40.0f, 60.0f });
+	scene.sunDirection = Normalize({ -0.4f, -1.0f, 0.3f });
+	scene.sunIlluminance = { 3.0f, 3.0f, 2.5f };
+
+	JobSystem jobSystem;
+	PathTracer pathTracer(&jobSystem);
+	pathTracer.SetScene(scene);
+	pathTracer.Reset(128, 128);
+	Camera camera;
+	camera.position = { 0.0f, 2.5f, -9.0f };
+	camera.aspectRatio = 1.0f;
+	pathTracer.Render(camera, 8);
+
+	const PathTracerStatistics& statistics = pathTracer.GetStatistics();
+	ReportBenchmark("128x128, 8 spp, 20k triangles", statistics.seconds, double(statistics.numSamples), "sample");
+	ReportBenchmark("  per thread", statistics.seconds * statistics.numThreads, double(statistics.numSamples), "sample");
+	ReportBenchmark("  rays", statistics.seconds, double(statistics.numRays), "ray");
+}
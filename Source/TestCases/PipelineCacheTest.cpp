@@ -0,0 +1,263 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "PipelineCache.h"
+#include "NullRHI.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// Pipeline with a fake driver blob, checks blobs make it through Save()/Load()
+class BlobPipelineState : public RHIPipelineState
+{
+public:
+	explicit BlobPipelineState(const RHIGraphicsPipelineDesc& desc) : RHIPipelineState(desc) {}
+
+	bool GetCachedBlob(std::vector<uint8_t>& blob) const override
+	{
+		blob.assign(m_desc.pixelShader.entryPoint.begin(), m_desc.pixelShader.entryPoint.end());
+		return true;
+	}
+};
+
+// Counts creations, can simulate driver compile time and fails for entry point "Broken"
+class PipelineTestDevice : public NullRHIDevice
+{
+public:
+	std::unique_ptr<RHIPipelineState> CreateGraphicsPipelineState(const RHIGraphicsPipelineDesc& desc, const std::vector<uint8_t>* pCachedBlob) override
+	{
+		numCreations++;
+		if (pCachedBlob && std::string(pCachedBlob->begin(), pCachedBlob->end()) == desc.pixelShader.entryPoint)
+		{
+			numCreationsFromBlob++;
+		}
+		if (desc.pixelShader.entryPoint == "Broken")
+		{
+			throw std::runtime_error("Broken pixel shader");
+		}
+		if (creationCost.count() > 0)
+		{
+			std::this_thread::sleep_for(creationCost);
+		}
+		return std::make_unique<BlobPipelineState>(desc);
+	}
+
+	std::atomic<uint32_t>		numCreations = 0;
+	std::atomic<uint32_t>		numCreationsFromBlob = 0;
+	std::chrono::microseconds	creationCost{ 0 };
+};
+
+static RHIGraphicsPipelineDesc MakeTestPipelineDesc(const char* pixelEntryPoint = "PSMain")
+{
+	RHIGraphicsPipelineDesc desc;
+	desc.vertexShader = { L"Shader.hlsl", "VSMain", "vs_5_0" };
+	desc.pixelShader = { L"Shader.hlsl", pixelEntryPoint, "ps_5_0" };
+	desc.inputLayout =
+	{
+		{ "POSITION", 0, RHIFormat::R32G32B32_FLOAT, 0, 0 },
+		{ "COLOR", 0, RHIFormat::R32G32B32A32_FLOAT, 0, 12 }
+	};
+	return desc;
+}
+
+TEST_CASE(PipelineCache_CanonicalDescsHashEqual)
+{
+	const RHIGraphicsPipelineDesc reference = CanonicalizePipelineDesc(MakeTestPipelineDesc());
+
+	// Same pipeline spelled differently: reordered elements, appended offsets, other path separator and name storage
+	const std::string positionName = "POSITION";
+	RHIGraphicsPipelineDesc variant = MakeTestPipelineDesc();
+	variant.vertexShader.fileName = L".\\Shader.hlsl";
+	variant.pixelShader.fileName = L".\\Shader.hlsl";
+	RHIGraphicsPipelineDesc spelled = MakeTestPipelineDesc();
+	spelled.inputLayout =
+	{
+		{ "COLOR", 0, RHIFormat::R32G32B32A32_FLOAT, 0, 12 },
+		{ positionName.c_str(), 0, RHIFormat::R32G32B32_FLOAT, 0, 0 },
+	};
+	RHIGraphicsPipelineDesc appended = MakeTestPipelineDesc();
+	appended.inputLayout[1].alignedByteOffset = RHIAppendAlignedElement;
+
+	const RHIGraphicsPipelineDesc canonicalSpelled = CanonicalizePipelineDesc(spelled);
+	const RHIGraphicsPipelineDesc canonicalAppended = CanonicalizePipelineDesc(appended);
+	TEST_EXPECT(HashPipelineDesc(canonicalSpelled) == HashPipelineDesc(reference) && ArePipelineDescsEqual(canonicalSpelled, reference));
+	TEST_EXPECT(HashPipelineDesc(canonicalAppended) == HashPipelineDesc(reference) && ArePipelineDescsEqual(canonicalAppended, reference));
+	TEST_EXPECT(CanonicalizePipelineDesc(variant).pixelShader.fileName == L"./Shader.hlsl");
+
+	RHIGraphicsPipelineDesc depth = MakeTestPipelineDesc();
+	depth.bDepthEnable = true;
+	const RHIGraphicsPipelineDesc canonicalDepth = CanonicalizePipelineDesc(depth);
+	TEST_EXPECT(HashPipelineDesc(canonicalDepth) != HashPipelineDesc(reference) && !ArePipelineDescsEqual(canonicalDepth, reference));
+	const RHIGraphicsPipelineDesc canonicalOther = CanonicalizePipelineDesc(MakeTestPipelineDesc("PSOther"));
+	TEST_EXPECT(HashPipelineDesc(canonicalOther) != HashPipelineDesc(reference));
+}
+
+TEST_CASE(PipelineCache_ConcurrentRequestsShareOnePipeline)
+{
+	PipelineTestDevice device;
+	device.creationCost = std::chrono::microseconds(2000);
+	PipelineCache cache(&device, 2);
+
+	std::vector<RHIPipelineState*> results(8);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		threads.emplace_back([&, i]
+		{
+			results[i] = cache.GetOrCreate(MakeTestPipelineDesc());
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	TEST_EXPECT(device.numCreations == 1 && cache.GetNumPipelines() == 1);
+	TEST_EXPECT(cache.GetStatistics().hits == results.size() - 1);
+	for (RHIPipelineState* pPipelineState : results)
+	{
+		TEST_EXPECT(pPipelineState && pPipelineState == results[0]);
+	}
+}
+
+TEST_CASE(PipelineCache_FailureReachesFuture)
+{
+	PipelineTestDevice device;
+	PipelineCache cache(&device);
+
+	PipelineCache::PipelineFuture future = cache.RequestAsync(MakeTestPipelineDesc("Broken"));
+	bool bThrown = false;
+	try
+	{
+		future.get();
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown && cache.GetStatistics().failures == 1);
+	TEST_EXPECT(cache.GetOrCreate(MakeTestPipelineDesc()) != nullptr);
+}
+
+TEST_CASE(PipelineCache_WarmStartFromDisk)
+{
+	const std::wstring fileName = GetTestPipelineCachePath("WarmStart");
+	{
+		PipelineTestDevice device;
+		PipelineCache cache(&device);
+		cache.RequestAsync(MakeTestPipelineDesc("PSMain"));
+		cache.RequestAsync(MakeTestPipelineDesc("PSOther"));
+		cache.RequestAsync(MakeTestPipelineDesc("Broken"));
+		TEST_EXPECT(cache.Save(fileName));
+	}
+
+	// Next launch creates both working pipelines before anyone asks, with the driver blob
+	PipelineTestDevice device;
+	PipelineCache cache(&device);
+	TEST_EXPECT(cache.Load(fileName));
+	cache.WaitForAll();
+	TEST_EXPECT(cache.GetStatistics().prewarmed == 2 && device.numCreations == 2 && device.numCreationsFromBlob == 2);
+
+	RHIPipelineState* pPipelineState = cache.GetOrCreate(MakeTestPipelineDesc("PSOther"));
+	TEST_EXPECT(pPipelineState->GetDesc().pixelShader.entryPoint == "PSOther");
+	TEST_EXPECT(strcmp(pPipelineState->GetDesc().inputLayout[0].semanticName, "POSITION") == 0);
+	TEST_EXPECT(device.numCreations == 2 && cache.GetStatistics().hits == 1);
+
+	std::filesystem::remove(fileName);
+}
+
+TEST_CASE(PipelineCache_RejectsTruncatedFile)
+{
+	const std::wstring fileName = GetTestPipelineCachePath("Truncated");
+	{
+		PipelineTestDevice device;
+		PipelineCache cache(&device);
+		cache.RequestAsync(MakeTestPipelineDesc());
+		TEST_EXPECT(cache.Save(fileName));
+	}
+	std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) - 3);
+
+	PipelineTestDevice device;
+	PipelineCache cache(&device);
+	TEST_EXPECT(!cache.Load(fileName));
+	TEST_EXPECT(cache.GetNumPipelines() == 0);
+
+	// A valid header claiming billions of entries is a miss, not an allocation of them
+	{
+		const uint32_t header[] = { 0x434f5350, 1, uint32_t(RHIBackend::Null), 0xfffffff0 };
+		std::ofstream file(std::filesystem::path(fileName), std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	}
+	TEST_EXPECT(!cache.Load(fileName));
+	TEST_EXPECT(cache.GetNumPipelines() == 0);
+
+	std::filesystem::remove(fileName);
+}
+
+TEST_CASE(PipelineCache_DropsUnknownEnums)
+{
+	const std::wstring fileName = GetTestPipelineCachePath("UnknownEnums");
+	// The only entry ends with topology, render target format, depth flag and the blob, its pixel entry point
+	const uint64_t blobSize = strlen("PSMain");
+	for (uint64_t offsetFromEnd : { blobSize + 4 + 3, blobSize + 4 + 2 })
+	{
+		{
+			PipelineTestDevice device;
+			PipelineCache cache(&device);
+			cache.RequestAsync(MakeTestPipelineDesc());
+			TEST_EXPECT(cache.Save(fileName));
+		}
+		{
+			std::fstream file(std::filesystem::path(fileName), std::ios::binary | std::ios::in | std::ios::out);
+			file.seekp(std::streamoff(std::filesystem::file_size(fileName) - offsetFromEnd));
+			file.put(char(0x7f));
+		}
+
+		PipelineTestDevice device;
+		PipelineCache cache(&device);
+		TEST_EXPECT(cache.Load(fileName));
+		cache.WaitForAll();
+		TEST_EXPECT(cache.GetNumPipelines() == 0 && cache.GetStatistics().prewarmed == 0 && device.numCreations == 0);
+	}
+
+	std::filesystem::remove(fileName);
+}
+
+BENCHMARK_CASE(PipelineCache_Benchmark)
+{
+	PipelineTestDevice device;
+	const RHIGraphicsPipelineDesc desc = MakeTestPipelineDesc();
+	{
+		PipelineCache cache(&device);
+		cache.GetOrCreate(desc);
+		constexpr uint32_t NumLookups = 200000;
+		BenchmarkTimer timer;
+		for (uint32_t i = 0; i < NumLookups; i++)
+		{
+			cache.GetOrCreate(desc);
+		}
+		ReportBenchmark("PipelineCache hit (canonicalize + hash + lookup)", timer.GetElapsedSeconds(), NumLookups, "lookup");
+	}
+
+	// Simulated 2ms driver compile per permutation, mostly sleeping so workers overlap even on few cores
+	device.creationCost = std::chrono::microseconds(2000);
+	constexpr uint32_t NumPermutations = 64;
+	std::vector<std::string> entryPoints;
+	for (uint32_t i = 0; i < NumPermutations; i++)
+	{
+		entryPoints.push_back("PSMain" + std::to_string(i));
+	}
+	for (uint32_t numWorkers : { 1u, 4u, 8u })
+	{
+		PipelineCache cache(&device, numWorkers);
+		BenchmarkTimer timer;
+		for (const std::string& entryPoint : entryPoints)
+		{
+			cache.RequestAsync(MakeTestPipelineDesc(entryPoint.c_str()));
+		}
+		cache.WaitForAll();
+		const std::string name = "PipelineCache async creation, " + std::to_string(numWorkers) + " workers";
+		ReportBenchmark(name.c_str(), timer.GetElapsedSeconds(), NumPermutations, "pso");
+	}
+}
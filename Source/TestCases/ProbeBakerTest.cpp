@@ -0,0 +1,336 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "ProbeBaker.h"
+
+#include <atomic>
+#include <filesystem>
+
+// Bright from above, colored to tell the channels apart
+static Float3 SkyRadiance(const Float3& direction)
+{
+	const float up = std::max(direction.y, 0.0f);
+	return { 0.2f + up, 0.3f + 2.0f * up * up, 0.5f };
+}
+
+static void FillCubemap(RadianceCubemap& cubemap, Float3 (*radiance)(const Float3&))
+{
+	for (uint32_t face = 0; face < CubemapNumFaces; face++)
+	{
+		for (uint32_t y = 0; y < cubemap.size; y++)
+		{
+			for (uint32_t x = 0; x < cubemap.size; x++)
+			{
+				cubemap.SetTexel(cubemap.GetTexelIndex(face, x, y), radiance(GetCubemapTexelDirection(face, x, y, cubemap.size)));
+			}
+		}
+	}
+}
+
+TEST_CASE(SphericalHarmonics_ProjectsConstantRadiance)
+{
+	// Odd sizes leave a tail for the scalar loop
+	for (const uint32_t size : { 1u, 3u, 8u, 32u })
+	{
+		RadianceCubemap cubemap;
+		cubemap.Resize(size);
+		FillCubemap(cubemap, [](const Float3&) { return Float3{ 1.0f, 2.0f, 0.5f }; });
+		const SHColor irradiance = ProbeBaker::BakeEnvironment(cubemap);
+		for (const Float3 normal : { Float3{ 0.0f, 1.0f, 0.0f }, Float3{ 1.0f, 0.0f, 0.0f }, Normalize({ -1.0f, -2.0f, 0.5f }) })
+		{
+			TEST_EXPECT(NearlyEqualAbsolute(EvaluateSH(irradiance, normal), Float3{ Pi, 2.0f * Pi, 0.5f * Pi }, 1e-3f));
+		}
+		for (uint32_t i = 1; i < SHNumCoefficients; i++)
+		{
+			TEST_EXPECT(NearlyEqualAbsolute(irradiance.coefficients[i], { 0.0f, 0.0f, 0.0f }, 1e-4f));
+		}
+	}
+}
+
+TEST_CASE(SphericalHarmonics_MatchesIrradianceIntegral)
+{
+	RadianceCubemap cubemap;
+	cubemap.Resize(16);
+	FillCubemap(cubemap, SkyRadiance);
+	const SHColor irradiance = ProbeBaker::BakeEnvironment(cubemap);
+
+	// Brute force cosine weighted integral over a finer cubemap, L2 keeps it within a few percent for smooth lighting
+	RadianceCubemap reference;
+	reference.Resize(64);
+	FillCubemap(reference, SkyRadiance);
+	const SHProjector projector(64);
+	for (const Float3 normal : { Float3{ 0.0f, 1.0f, 0.0f }, Float3{ 0.0f, -1.0f, 0.0f }, Normalize({ 1.0f, 1.0f, 0.0f }), Normalize({ 0.3f, -0.2f, -1.0f }) })
+	{
+		// Project the radiance times the clamped cosine, the DC term times sqrt(4 pi) is the integral
+		RadianceCubemap weighted = reference;
+		for (uint32_t face = 0; face < CubemapNumFaces; face++)
+		{
+			for (uint32_t y = 0; y < reference.size; y++)
+			{
+				for (uint32_t x = 0; x < reference.size; x++)
+				{
+					const uint32_t index = reference.GetTexelIndex(face, x, y);
+					const float cosine = std::max(Dot(GetCubemapTexelDirection(face, x, y, reference.size), normal), 0.0f);
+					for (std::vector<float>& channel : weighted.channels)
+					{
+						channel[index] *= cosine;
+					}
+				}
+			}
+		}
+		const Float3 expected = projector.Project(weighted).coefficients[0] * (1.0f / 0.282095f);
+		const Float3 actual = EvaluateSH(irradiance, normal);
+		TEST_EXPECT(NearlyEqualAbsolute(actual, expected, 0.04f * std::max({ expected.x, expected.y, expected.z })));
+	}
+}
+
+TEST_CASE(ProbeBaker_BakesGridInOrder)
+{
+	JobSystem jobSystem(3);
+	ProbeBaker baker(&jobSystem);
+	ProbeGridDesc grid;
+	grid.size[0] = 5;
+	grid.size[1] = 3;
+	grid.size[2] = 7;
+	grid.bounds = { { -2.0f, 0.0f, 1.0f }, { 2.0f, 4.0f, 13.0f } };
+
+	// Radiance constant over directions, linear in the position
+	std::atomic<uint32_t> numCaptures = 0;
+	const std::vector<SHColor> probes = baker.Bake(grid, [&](const Float3& position, RadianceCubemap& cubemap)
+	{
+		TEST_EXPECT(cubemap.size == ProbeBaker::DefaultCaptureSize);
+		for (uint32_t i = 0; i < cubemap.GetNumTexels(); i++)
+		{
+			cubemap.SetTexel(i, { position.x + 2.0f, position.y, position.z });
+		}
+		numCaptures++;
+	});
+	TEST_EXPECT(numCaptures == grid.GetNumProbes() && probes.size() == grid.GetNumProbes());
+	TEST_EXPECT(NearlyEqualAbsolute(grid.GetProbePosition(0), grid.bounds.min, 0.0f) && NearlyEqualAbsolute(grid.GetProbePosition(uint32_t(grid.GetNumProbes() - 1)), grid.bounds.max, 1e-5f));
+
+	for (uint32_t z = 0; z < grid.size[2]; z++)
+	{
+		for (uint32_t y = 0; y < grid.size[1]; y++)
+		{
+			for (uint32_t x = 0; x < grid.size[0]; x++)
+			{
+				const uint32_t index = (z * grid.size[1] + y) * grid.size[0] + x;
+				const Float3 expected = { float(x), float(y) * 2.0f, 1.0f + float(z) * 2.0f };
+				TEST_EXPECT(NearlyEqualAbsolute(grid.GetProbePosition(index), { expected.x - 2.0f, expected.y, expected.z }, 1e-5f));
+				TEST_EXPECT(NearlyEqualAbsolute(EvaluateSH(probes[index], { 0.0f, 0.0f, 1.0f }), expected * Pi, 1e-3f * Pi * 13.0f));
+			}
+		}
+	}
+}
+
+TEST_CASE(ProbeVolume_RoundTripsThroughFile)
+{
+	JobSystem jobSystem(2);
+	ProbeBaker baker(&jobSystem, 4);
+	ProbeGridDesc grid;
+	grid.size[0] = 4;
+	grid.size[1] = 2;
+	grid.size[2] = 3;
+	grid.bounds = { { 0.0f, 0.0f, 0.0f }, { 3.0f, 1.0f, 4.0f } };
+	const std::vector<SHColor> probes = baker.Bake(grid, [](const Float3& position, RadianceCubemap& cubemap)
+	{
+		for (uint32_t face = 0; face < CubemapNumFaces; face++)
+		{
+			for (uint32_t y = 0; y < cubemap.size; y++)
+			{
+				for (uint32_t x = 0; x < cubemap.size; x++)
+				{
+					const Float3 sky = SkyRadiance(GetCubemapTexelDirection(face, x, y, cubemap.size));
+					cubemap.SetTexel(cubemap.GetTexelIndex(face, x, y), sky * (1.0f + position.x));
+				}
+			}
+		}
+	});
+
+	const std::vector<uint8_t> cooked = CookProbeVolume(grid, probes);
+	const std::wstring fileName = (std::filesystem::temp_directory_path() / "ProbeVolumeTest.probes").wstring();
+	WriteProbeVolumeFile(fileName, cooked);
+	{
+		ProbeVolume volume;
+		volume.Open(fileName);
+		TEST_EXPECT(volume.IsOpen() && volume.GetNumProbes() == 24 && volume.GetHeader().gridSize[2] == 3);
+		TEST_EXPECT(volume.GetHeader().planeOffset % ProbeVolumePlaneAlignment == 0);
+		TEST_EXPECT(reinterpret_cast<uintptr_t>(volume.GetPlane(SHNumCoefficients - 1)) % ProbeVolumePlaneAlignment == 0);
+		for (uint32_t i = 0; i < volume.GetNumProbes(); i++)
+		{
+			const SHColor probe = volume.GetProbe(i);
+			for (uint32_t k = 0; k < SHNumCoefficients; k++)
+			{
+				// Half floats, 11 bit mantissa
+				const Float3& expected = probes[i].coefficients[k];
+				TEST_EXPECT(NearlyEqualAbsolute(probe.coefficients[k], expected, 1e-3f * std::max({ std::abs(expected.x), std::abs(expected.y), std::abs(expected.z), 1e-3f })));
+			}
+		}
+
+		// Probes sit on the grid, the radiance is linear along x so sampling in between interpolates exactly
+		const Float3 normal = Normalize({ 0.2f, 1.0f, -0.3f });
+		TEST_EXPECT(NearlyEqualAbsolute(volume.SampleIrradiance({ 2.0f, 1.0f, 4.0f }, normal), EvaluateSH(volume.GetProbe(volume.GetProbeIndex(2, 1, 2)), normal), 1e-5f));
+		const Float3 a = volume.SampleIrradiance({ 1.0f, 0.3f, 1.7f }, normal);
+		const Float3 b = volume.SampleIrradiance({ 2.0f, 0.3f, 1.7f }, normal);
+		const Float3 middle = volume.SampleIrradiance({ 1.5f, 0.3f, 1.7f }, normal);
+		TEST_EXPECT(NearlyEqualAbsolute(middle, (a + b) * 0.5f, 1e-2f));
+		TEST_EXPECT(NearlyEqualAbsolute(volume.SampleIrradiance({ -5.0f, -5.0f, -5.0f }, normal), EvaluateSH(volume.GetProbe(0), normal), 1e-5f));
+	}
+
+	// 2048^3 probes do not fit the uint32_t probe indices
+	ProbeGridDesc hugeGrid;
+	hugeGrid.size[0] = hugeGrid.size[1] = hugeGrid.size[2] = 2048;
+	TEST_EXPECT(hugeGrid.GetNumProbes() == 2048ull * 2048 * 2048);
+	bool bBakeThrown = false;
+	try
+	{
+		baker.Bake(hugeGrid, [](const Float3&, RadianceCubemap&) {});
+	}
+	catch (const std::runtime_error&)
+	{
+		bBakeThrown = true;
+	}
+	bool bCookThrown = false;
+	try
+	{
+		CookProbeVolume(hugeGrid, probes);
+	}
+	catch (const std::runtime_error&)
+	{
+		bCookThrown = true;
+	}
+	TEST_EXPECT(bBakeThrown && bCookThrown);
+
+	// Malformed files are rejected
+	auto expectInvalid = [](std::vector<uint8_t> data)
+	{
+		ProbeVolume volume;
+		bool bThrown = false;
+		try
+		{
+			volume.OpenFromMemory(data.data(), data.size());
+		}
+		catch (const std::runtime_error&)
+		{
+			bThrown = true;
+		}
+		return bThrown && !volume.IsOpen();
+	};
+	TEST_EXPECT(expectInvalid(std::vector<uint8_t>(cooked.begin(), cooked.end() - 8)));
+	std::vector<uint8_t> badMagic = cooked;
+	badMagic[0] ^= 1;
+	TEST_EXPECT(expectInvalid(badMagic));
+	std::vector<uint8_t> badGrid = cooked;
+	reinterpret_cast<ProbeVolumeHeader*>(badGrid.data())->gridSize[0] = 1000;
+	TEST_EXPECT(expectInvalid(badGrid));
+	// The product wraps to 4 probes, which the file would hold
+	ProbeVolumeHeader* pWrappingHeader = reinterpret_cast<ProbeVolumeHeader*>(badGrid.data());
+	pWrappingHeader->gridSize[0] = 769546;
+	pWrappingHeader->gridSize[1] = 494770;
+	pWrappingHeader->gridSize[2] = 48448661;
+	TEST_EXPECT(expectInvalid(badGrid));
+
+	bool bThrown = false;
+	try
+	{
+		CookProbeVolume(grid, std::vector<SHColor>(probes.begin(), probes.end() - 1));
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+	std::filesystem::remove(fileName);
+}
+
+TEST_CASE(ProbeVolume_EngineLoadsAtStartup)
+{
+	const std::wstring fileName = (std::filesystem::temp_directory_path() / "ProbeVolumeEngineTest.probes").wstring();
+	ProbeGridDesc grid;
+	grid.size[0] = grid.size[1] = grid.size[2] = 2;
+	SHColor probe = {};
+	probe.coefficients[0] = { 1.0f, 1.0f, 1.0f };
+	WriteProbeVolumeFile(fileName, CookProbeVolume(grid, std::vector<SHColor>(8, probe)));
+
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetProbeVolumePath(fileName);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("ProbeVolume_EngineLoadsAtStartup"));
+	engine.OnInit();
+	TEST_EXPECT(engine.GetProbeVolume().IsOpen() && engine.GetProbeVolume().GetNumProbes() == 8);
+	engine.OnUpdate();
+	engine.OnDestroy();
+
+	// Missing file is not an error, there is just no baked ambient
+	Engine engineWithoutProbes(320, 240, L"Headless", RHIBackend::Null);
+	engineWithoutProbes.SetProbeVolumePath(fileName + L".missing");
+	engineWithoutProbes.SetPipelineCachePath(GetTestPipelineCachePath("ProbeVolume_EngineLoadsAtStartup_WithoutProbes"));
+	engineWithoutProbes.OnInit();
+	TEST_EXPECT(!engineWithoutProbes.GetProbeVolume().IsOpen());
+	engineWithoutProbes.OnDestroy();
+	std::filesystem::remove(fileName);
+}
+
+BENCHMARK_CASE(ProbeBaker_Bake)
+{
+	// Analytic capture: sky with a sun lobe, darkened towards the floor of the volume
+	const uint32_t captureSize = ProbeBaker::DefaultCaptureSize;
+	std::vector<Float3> directions;
+	for (uint32_t face = 0; face < CubemapNumFaces; face++)
+	{
+		for (uint32_t y = 0; y < captureSize; y++)
+		{
+			for (uint32_t x = 0; x < captureSize; x++)
+			{
+				directions.push_back(GetCubemapTexelDirection(face, x, y, captureSize));
+			}
+		}
+	}
+	const Float3 sunDirection = Normalize({ 0.3f, 0.9f, 0.3f });
+	auto capture = [&](const Float3& position, RadianceCubemap& cubemap)
+	{
+		const float openness = 0.25f + 0.75f * std::clamp(position.y / 16.0f, 0.0f, 1.0f);
+		for (uint32_t i = 0; i < cubemap.GetNumTexels(); i++)
+		{
+			const Float3& direction = directions[i];
+			const float sun = std::max(Dot(direction, sunDirection), 0.0f);
+			const float sky = direction.y > 0.0f ? openness : 0.2f;
+			cubemap.SetTexel(i, { sky * 0.6f + sun * sun * 4.0f, sky * 0.7f + sun * sun * 3.5f, sky + sun * sun * 3.0f });
+		}
+	};
+
+	JobSystem jobSystem;
+	ProbeBaker baker(&jobSystem, captureSize);
+	for (const uint32_t size : { 32u, 64u })
+	{
+		ProbeGridDesc grid;
+		grid.size[0] = grid.size[1] = grid.size[2] = size;
+		grid.bounds = { { -32.0f, 0.0f, -32.0f }, { 32.0f, 16.0f, 32.0f } };
+		BenchmarkTimer timer;
+		const std::vector<SHColor> probes = baker.Bake(grid, capture);
+		const double seconds = timer.GetElapsedSeconds();
+		char name[64];
+		snprintf(name, sizeof(name), "Bake %u^3 probes, %ux%u capture", size, captureSize, captureSize);
+		ReportBenchmark(name, seconds, double(probes.size()), "probe");
+
+		BenchmarkTimer cookTimer;
+		const std::vector<uint8_t> cooked = CookProbeVolume(grid, probes);
+		ReportBenchmark("Cook", cookTimer.GetElapsedSeconds(), double(probes.size()), "probe");
+		printf("    %.1f MB file, %u worker threads\n", double(cooked.size()) / (1024.0 * 1024.0), jobSystem.GetNumWorkerThreads());
+	}
+
+	// Projection alone, one probe's capture projected over and over
+	RadianceCubemap cubemap;
+	cubemap.Resize(captureSize);
+	capture({ 0.0f, 8.0f, 0.0f }, cubemap);
+	const SHProjector projector(captureSize);
+	const uint32_t numProjections = 200000;
+	float sink = 0.0f;
+	BenchmarkTimer projectTimer;
+	for (uint32_t i = 0; i < numProjections; i++)
+	{
+		sink += projector.Project(cubemap).coefficients[i % SHNumCoefficients].x;
+	}
+	const double projectSeconds = projectTimer.GetElapsedSeconds();
+	ReportBenchmark("Project, single thread", projectSeconds, double(numProjections) * cubemap.GetNumTexels(), "texel");
+	TEST_EXPECT(std::isfinite(sink));
+}
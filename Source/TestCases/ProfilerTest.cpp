@@ -0,0 +1,291 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "FileIO.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+static void SpinFor(double seconds)
+{
+	const auto start = std::chrono::steady_clock::now();
+	while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds)
+	{
+	}
+}
+
+static const ProfilerScopeStatistics* FindScope(const std::vector<ProfilerScopeStatistics>& statistics, const char* name)
+{
+	for (const ProfilerScopeStatistics& scope : statistics)
+	{
+		if (strcmp(scope.name, name) == 0)
+		{
+			return &scope;
+		}
+	}
+	return nullptr;
+}
+
+static ProfilerCapture MakeCapture()
+{
+	ProfilerCapture capture;
+	capture.ticksPerSecond = 1e9;
+	capture.names = { "Frame", "Shadow \"pass\"\\1" };
+	capture.threadNames = { "Main", "" };
+	capture.events = { { 1000, 9000, 0, 0, 0 }, { 2000, 5000, 1, 0, 1 }, { 2500, 4000, 1, 1, 0 } };
+	capture.frameEnds = { 9500 };
+	capture.droppedEvents = 3;
+	return capture;
+}
+
+#if ENABLE_PROFILER
+
+TEST_CASE(Profiler_AggregatesNestedScopes)
+{
+	Profiler::Reset();
+	for (uint32_t frame = 0; frame < 4; frame++)
+	{
+		{
+			PROFILE_SCOPE("Outer");
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				PROFILE_SCOPE("Inner");
+				SpinFor(20e-6);
+			}
+		}
+		Profiler::EndFrame();
+	}
+
+	const std::vector<ProfilerScopeStatistics> statistics = Profiler::GetScopeStatistics();
+	const ProfilerScopeStatistics* pOuter = FindScope(statistics, "Outer");
+	const ProfilerScopeStatistics* pInner = FindScope(statistics, "Inner");
+	TEST_EXPECT(pOuter && pInner && Profiler::GetFrameCount() == 4);
+	TEST_EXPECT(pOuter->depth == 0 && pInner->depth == 1);
+	TEST_EXPECT(pOuter->numFrames == 4 && pOuter->callsPerFrame == 1.0 && pInner->callsPerFrame == 3.0);
+	// Inclusive, the three inner calls are part of the outer one
+	TEST_EXPECT(pInner->minSeconds >= 60e-6 && pInner->averageSeconds <= pOuter->averageSeconds);
+	TEST_EXPECT(Profiler::FormatReport().find("  Inner") != std::string::npos);
+}
+
+TEST_CASE(Profiler_ComputesFrameStatistics)
+{
+	Profiler::Reset();
+	for (uint32_t frame = 0; frame < 100; frame++)
+	{
+		{
+			PROFILE_SCOPE("Work");
+			// Two spikes among 100 frames, the nearest rank p99 is the smaller one
+			SpinFor(frame == 10 || frame == 60 ? 2e-3 : 50e-6);
+		}
+		Profiler::EndFrame();
+	}
+
+	const std::vector<ProfilerScopeStatistics> statistics = Profiler::GetScopeStatistics();
+	const ProfilerScopeStatistics* pWork = FindScope(statistics, "Work");
+	TEST_EXPECT(pWork && pWork->numFrames == 100);
+	TEST_EXPECT(pWork->minSeconds >= 50e-6 && pWork->minSeconds < 1e-3);
+	TEST_EXPECT(pWork->p99Seconds >= 1.9e-3 && pWork->p99Seconds <= pWork->maxSeconds);
+	TEST_EXPECT(pWork->averageSeconds > pWork->minSeconds && pWork->averageSeconds < pWork->p99Seconds);
+
+	// Frames without the scope do not count as zero samples
+	Profiler::EndFrame();
+	TEST_EXPECT(FindScope(Profiler::GetScopeStatistics(), "Work")->numFrames == 100);
+}
+
+TEST_CASE(Profiler_CapturesThreads)
+{
+	Profiler::Reset();
+	Profiler::BeginCapture();
+	TEST_EXPECT(Profiler::IsCapturing());
+	{
+		PROFILE_SCOPE("MainWork");
+	}
+	std::vector<std::thread> threads;
+	for (uint32_t thread = 0; thread < 4; thread++)
+	{
+		threads.emplace_back([]()
+		{
+			PROFILE_THREAD("Worker");
+			for (uint32_t i = 0; i < 100; i++)
+			{
+				PROFILE_SCOPE("WorkerWork");
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	Profiler::EndFrame();
+	const ProfilerCapture capture = Profiler::EndCapture();
+	TEST_EXPECT(!Profiler::IsCapturing());
+
+	uint32_t numMainEvents = 0;
+	uint32_t numWorkerEvents = 0;
+	std::vector<uint16_t> workerThreads;
+	for (const ProfilerCaptureEvent& event : capture.events)
+	{
+		TEST_EXPECT(event.endTicks >= event.beginTicks && event.name < capture.names.size() && event.thread < capture.threadNames.size());
+		if (capture.names[event.name] == "MainWork")
+		{
+			numMainEvents++;
+		}
+		else if (capture.names[event.name] == "WorkerWork")
+		{
+			numWorkerEvents++;
+			if (std::find(workerThreads.begin(), workerThreads.end(), event.thread) == workerThreads.end())
+			{
+				workerThreads.push_back(event.thread);
+			}
+		}
+	}
+	TEST_EXPECT(numMainEvents == 1 && numWorkerEvents == 400);
+	// Exited threads give their ring back, later threads may reuse it
+	TEST_EXPECT(!workerThreads.empty() && capture.threadNames[workerThreads[0]] == "Worker");
+	TEST_EXPECT(capture.frameEnds.size() == 1 && capture.ticksPerSecond > 0.0 && capture.droppedEvents == 0);
+
+	// Events after the capture are not kept
+	{
+		PROFILE_SCOPE("AfterCapture");
+	}
+	Profiler::EndFrame();
+	TEST_EXPECT(Profiler::EndCapture().events.empty());
+}
+
+TEST_CASE(Profiler_DropsEventsWhenRingIsFull)
+{
+	Profiler::Reset();
+	for (uint32_t i = 0; i < ProfilerRingCapacity + 100; i++)
+	{
+		PROFILE_SCOPE("Overflow");
+	}
+	TEST_EXPECT(Profiler::GetDroppedEvents() == 100);
+	Profiler::EndFrame();
+	const ProfilerScopeStatistics* pOverflow = FindScope(Profiler::GetScopeStatistics(), "Overflow");
+	TEST_EXPECT(pOverflow && pOverflow->callsPerFrame == double(ProfilerRingCapacity));
+
+	// Drained rings record again
+	{
+		PROFILE_SCOPE("Overflow");
+	}
+	Profiler::EndFrame();
+	TEST_EXPECT(Profiler::GetDroppedEvents() == 100);
+	Profiler::Reset();
+	TEST_EXPECT(Profiler::GetDroppedEvents() == 0);
+}
+
+TEST_CASE(Profiler_MarksEngineStages)
+{
+	Profiler::Reset();
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("Profiler_MarksEngineStages"));
+	engine.OnInit();
+	for (uint32_t frame = 0; frame < 4; frame++)
+	{
+		engine.OnUpdate();
+	}
+	engine.OnDestroy();
+	Profiler::EndFrame();
+
+	const std::vector<ProfilerScopeStatistics> statistics = Profiler::GetScopeStatistics();
+	const char* const stages[] = { "Engine::OnInit", "CreateSwapChain", "RequestPipelines", "WaitForGpu", "Engine::OnUpdate", "BeginFrame",
+		"SetupShadows", "UploadFrameData", "BuildRenderGraph", "RenderGraph::Compile", "RecordAndSubmit", "Clear", "Scene", "Present", "EndFrame" };
+	for (const char* stage : stages)
+	{
+		TEST_EXPECT(FindScope(statistics, stage) != nullptr);
+	}
+	const ProfilerScopeStatistics* pUpdate = FindScope(statistics, "Engine::OnUpdate");
+	TEST_EXPECT(pUpdate->numFrames == 4 && pUpdate->callsPerFrame == 1.0 && FindScope(statistics, "Present")->depth == 1);
+	// Pass scopes nest inside RecordAndSubmit on the main thread, or start a worker's stack
+	TEST_EXPECT(FindScope(statistics, "Scene")->callsPerFrame == 1.0);
+}
+
+BENCHMARK_CASE(Profiler_ScopeOverhead)
+{
+	Profiler::Reset();
+	const uint32_t numFrames = 2000;
+	const uint32_t scopesPerFrame = 4096;
+	BenchmarkTimer timer;
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		for (uint32_t i = 0; i < scopesPerFrame; i++)
+		{
+			PROFILE_SCOPE("Empty");
+		}
+	}
+	const double recordSeconds = timer.GetElapsedSeconds();
+	Profiler::Reset();
+
+	// Recording and draining, as a frame would
+	timer = BenchmarkTimer();
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		for (uint32_t i = 0; i < scopesPerFrame; i++)
+		{
+			PROFILE_SCOPE("Empty");
+		}
+		Profiler::EndFrame();
+	}
+	const double frameSeconds = timer.GetElapsedSeconds();
+	const double numScopes = double(numFrames) * scopesPerFrame;
+	ReportBenchmark("Scope into a full ring (dropped)", recordSeconds, numScopes, "scope");
+	ReportBenchmark("Scope and drain", frameSeconds, numScopes, "scope");
+	printf("    %.1f ns per scope recorded and aggregated, %.1f ns per dropped scope, %.2f GHz ticks\n",
+		frameSeconds / numScopes * 1e9, recordSeconds / numScopes * 1e9, Profiler::GetTicksPerSecond() * 1e-9);
+	Profiler::Reset();
+}
+
+#endif
+
+TEST_CASE(Profiler_WritesChromeTraceAndCapture)
+{
+	const ProfilerCapture capture = MakeCapture();
+	const std::wstring traceName = GetExecutableDirectory() + L"ProfilerTest.json";
+	Profiler::WriteChromeTrace(traceName, capture);
+	const std::vector<uint8_t> traceData = ReadWholeFile(traceName);
+	const std::string trace(traceData.begin(), traceData.end());
+	std::filesystem::remove(traceName);
+	TEST_EXPECT(trace.find("\"traceEvents\":[") != std::string::npos);
+	TEST_EXPECT(trace.find("{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":0.000,\"dur\":8.000}") != std::string::npos);
+	TEST_EXPECT(trace.find("\"Shadow \\\"pass\\\"\\\\1\"") != std::string::npos);
+	TEST_EXPECT(trace.find("\"args\":{\"name\":\"Main\"}") != std::string::npos && trace.find("\"args\":{\"name\":\"Thread 1\"}") != std::string::npos);
+	TEST_EXPECT(trace.find("\"name\":\"EndFrame\",\"ph\":\"i\"") != std::string::npos);
+
+	const std::wstring captureName = GetExecutableDirectory() + L"ProfilerTest.profile";
+	Profiler::WriteCapture(captureName, capture);
+	const ProfilerCapture loaded = Profiler::ReadCapture(captureName);
+	TEST_EXPECT(loaded.ticksPerSecond == capture.ticksPerSecond && loaded.names == capture.names && loaded.threadNames == capture.threadNames);
+	TEST_EXPECT(loaded.events.size() == capture.events.size() && memcmp(loaded.events.data(), capture.events.data(), capture.events.size() * sizeof(ProfilerCaptureEvent)) == 0);
+	TEST_EXPECT(loaded.frameEnds == capture.frameEnds && loaded.droppedEvents == 3);
+
+	// Truncated and corrupted files are rejected
+	std::vector<uint8_t> data = ReadWholeFile(captureName);
+	auto IsRejected = [&](const std::vector<uint8_t>& fileData)
+	{
+		{
+			File file;
+			file.Create(captureName);
+			file.WriteAt(0, fileData.data(), fileData.size());
+		}
+		try
+		{
+			Profiler::ReadCapture(captureName);
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	};
+	TEST_EXPECT(IsRejected(std::vector<uint8_t>(data.begin(), data.end() - 1)));
+	std::vector<uint8_t> badEvent = data;
+	badEvent[sizeof(ProfilerCaptureFileHeader) + offsetof(ProfilerCaptureEvent, name)] = 7;
+	TEST_EXPECT(IsRejected(badEvent));
+	std::vector<uint8_t> badCount = data;
+	reinterpret_cast<ProfilerCaptureFileHeader*>(badCount.data())->numEvents = ~0u;
+	TEST_EXPECT(IsRejected(badCount));
+	std::filesystem::remove(captureName);
+}
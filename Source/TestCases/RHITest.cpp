@@ -0,0 +1,171 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "NullRHI.h"
+#include "Engine.h"
+
+TEST_CASE(NullRHI_RecordsCommandStream)
+{
+	NullRHIDevice device;
+	auto allocator = device.CreateCommandAllocator();
+	auto commandList = device.CreateCommandList();
+	auto renderTarget = device.CreateResource(RHIResourceDesc::Texture2D(64, 64, RHIFormat::R8G8B8A8_UNORM, true));
+
+	commandList->Begin(allocator.get());
+	const float clearColor[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+	commandList->ClearRenderTarget(renderTarget.get(), clearColor);
+	commandList->DrawInstanced(3, 2, 0, 0);
+	commandList->Close();
+
+	const NullCommandStream* pStream = static_cast<NullCommandList*>(commandList.get())->GetStream();
+	TEST_EXPECT(pStream->GetNumCommands() == 2);
+	TEST_EXPECT(pStream->GetSizeInBytes() % NullCommandStream::PacketAlignment == 0);
+
+	std::vector<NullCommandType> types;
+	pStream->ForEach([&](const NullCommandHeader& header, const void* pPayload)
+	{
+		types.push_back(header.type);
+		if (header.type == NullCommandType::DrawInstanced)
+		{
+			TEST_EXPECT(static_cast<const NullCmdDrawInstanced*>(pPayload)->instanceCount == 2);
+		}
+	});
+	TEST_EXPECT(types.size() == 2 && types[0] == NullCommandType::ClearRenderTarget && types[1] == NullCommandType::DrawInstanced);
+}
+
+TEST_CASE(NullRHI_FenceSignalsInSubmissionOrder)
+{
+	NullRHIDevice device;
+	NullGpuCostModel costModel;
+	costModel.perCommandList = std::chrono::microseconds(500);
+	device.GetNullGraphicsQueue().SetCostModel(costModel);
+
+	auto allocator = device.CreateCommandAllocator();
+	auto commandList = device.CreateCommandList();
+	auto fence = device.CreateFence(0);
+
+	commandList->Begin(allocator.get());
+	commandList->Close();
+	RHICommandList* ppCommandLists[] = { commandList.get() };
+	device.GetGraphicsQueue()->ExecuteCommandLists(1, ppCommandLists);
+	device.GetGraphicsQueue()->Signal(fence.get(), 1);
+
+	fence->Wait(1);
+	TEST_EXPECT(fence->GetCompletedValue() == 1);
+	TEST_EXPECT(device.GetNullGraphicsQueue().GetStatistics().executedCommandLists == 1);
+}
+
+TEST_CASE(NullRHI_ResetInFlightAllocatorThrows)
+{
+	NullRHIDevice device;
+	NullGpuCostModel costModel;
+	costModel.perCommandList = std::chrono::milliseconds(20);
+	device.GetNullGraphicsQueue().SetCostModel(costModel);
+
+	auto allocator = device.CreateCommandAllocator();
+	auto commandList = device.CreateCommandList();
+	commandList->Begin(allocator.get());
+	commandList->Close();
+	RHICommandList* ppCommandLists[] = { commandList.get() };
+	device.GetGraphicsQueue()->ExecuteCommandLists(1, ppCommandLists);
+
+	bool bThrown = false;
+	try
+	{
+		allocator->Reset();
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+
+	device.GetNullGraphicsQueue().Flush();
+	allocator->Reset();
+}
+
+TEST_CASE(NullRHI_BarrierValidation)
+{
+	NullRHIDevice device;
+	auto allocator = device.CreateCommandAllocator();
+	auto commandList = device.CreateCommandList();
+	auto texture = device.CreateResource(RHIResourceDesc::Texture2D(4, 4, RHIFormat::R8G8B8A8_UNORM, true));
+
+	commandList->Begin(allocator.get());
+	// Correct, then a mismatching `stateBefore`
+	RHIResourceBarrier barriers[] =
+	{
+		RHIResourceBarrier::Transition(texture.get(), RHIResourceState::RenderTarget, RHIResourceState::ShaderResource),
+		RHIResourceBarrier::Transition(texture.get(), RHIResourceState::RenderTarget, RHIResourceState::CopySource),
+	};
+	commandList->ResourceBarrier(2, barriers);
+	commandList->Close();
+	RHICommandList* ppCommandLists[] = { commandList.get() };
+	device.GetGraphicsQueue()->ExecuteCommandLists(1, ppCommandLists);
+	device.GetNullGraphicsQueue().Flush();
+
+	NullQueueStatistics statistics = device.GetNullGraphicsQueue().GetStatistics();
+	TEST_EXPECT(statistics.executedBarriers == 2);
+	TEST_EXPECT(statistics.barrierMismatches == 1);
+}
+
+TEST_CASE(Engine_HeadlessFrames)
+{
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("Engine_HeadlessFrames"));
+	engine.OnInit();
+	for (int i = 0; i < 8; i++)
+	{
+		engine.OnUpdate();
+	}
+	engine.OnDestroy();
+
+	NullRHIDevice* pDevice = static_cast<NullRHIDevice*>(engine.GetDevice());
+	NullQueueStatistics statistics = pDevice->GetNullGraphicsQueue().GetStatistics();
+	TEST_EXPECT(statistics.executedCommandLists == 8 * NumRenderPasses);
+	TEST_EXPECT(statistics.executedDraws == 8);
+	TEST_EXPECT(statistics.barrierMismatches == 0);
+	TEST_EXPECT(static_cast<NullSwapChain*>(engine.GetSwapChain())->GetPresentCount() == 8);
+}
+
+BENCHMARK_CASE(NullRHI_RecordingThroughput)
+{
+	NullRHIDevice device;
+	auto allocator = device.CreateCommandAllocator();
+	auto commandList = device.CreateCommandList();
+	auto vertexBuffer = device.CreateResource(RHIResourceDesc::Buffer(1024));
+	RHIVertexBufferView view{ vertexBuffer->GetGpuVirtualAddress(), 1024, 28 };
+
+	const int numIterations = 200;
+	const int numDraws = 10000;
+	BenchmarkTimer timer;
+	for (int iteration = 0; iteration < numIterations; iteration++)
+	{
+		allocator->Reset();
+		commandList->Begin(allocator.get());
+		for (int i = 0; i < numDraws; i++)
+		{
+			commandList->SetVertexBuffer(0, view);
+			commandList->DrawInstanced(3, 1, 0, 0);
+		}
+		commandList->Close();
+	}
+	ReportBenchmark("Record SetVertexBuffer + Draw", timer.GetElapsedSeconds(), double(numIterations) * numDraws * 2, "cmd");
+}
+
+BENCHMARK_CASE(Engine_HeadlessFrameCpuCost)
+{
+	Engine engine(1280, 720, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("Engine_HeadlessFrameCpuCost"));
+	engine.OnInit();
+
+	const int numFrames = 2000;
+	BenchmarkTimer timer;
+	for (int i = 0; i < numFrames; i++)
+	{
+		engine.OnUpdate();
+	}
+	const double seconds = timer.GetElapsedSeconds();
+	engine.OnDestroy();
+	ReportBenchmark("Engine::OnUpdate (Null RHI)", seconds, numFrames, "frame");
+	printf("    %.3f us per frame\n", seconds / numFrames * 1e6);
+}
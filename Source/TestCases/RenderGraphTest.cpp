@@ -0,0 +1,433 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "NullRHI.h"
+#include "RenderGraph.h"
+
+#include <cstring>
+
+// Records every compiled pass into one command list and runs it on the simulated GPU
+static void ExecuteGraph(NullRHIDevice& device, const RenderGraph& graph)
+{
+	auto allocator = device.CreateCommandAllocator();
+	auto commandList = device.CreateCommandList();
+	commandList->Begin(allocator.get());
+	for (uint32_t pass = 0; pass < graph.GetNumCompiledPasses(); pass++)
+	{
+		graph.RecordPass(pass, commandList.get());
+	}
+	commandList->Close();
+	RHICommandList* ppCommandLists[] = { commandList.get() };
+	device.GetGraphicsQueue()->ExecuteCommandLists(1, ppCommandLists);
+	device.GetNullGraphicsQueue().Flush();
+}
+
+TEST_CASE(RenderGraph_CullsUnusedPasses)
+{
+	NullRHIDevice device;
+	auto backBuffer = device.CreateResource(RHIResourceDesc::Texture2D(64, 64, RHIFormat::R8G8B8A8_UNORM, true));
+	RenderGraph graph(&device);
+	graph.Reset();
+
+	std::vector<const char*> executed;
+	auto record = [&](const char* name) { return [&executed, name](RHICommandList*, const RenderGraph&) { executed.push_back(name); }; };
+	const RenderGraphTexture output = graph.ImportTexture("Output", backBuffer.get(), RHIResourceState::RenderTarget, RHIResourceState::RenderTarget);
+	const RenderGraphTexture color = graph.CreateTexture("Color", 64, 64, RHIFormat::R16G16B16A16_FLOAT);
+	const RenderGraphTexture debug = graph.CreateTexture("Debug", 64, 64, RHIFormat::R8G8B8A8_UNORM);
+	const RenderGraphTexture debugResolved = graph.CreateTexture("DebugResolved", 64, 64, RHIFormat::R8G8B8A8_UNORM);
+	const RenderGraphTexture readback = graph.CreateTexture("Readback", 16, 16, RHIFormat::R32_FLOAT);
+
+	const uint32_t scene = graph.AddPass("Scene", record("Scene"));
+	graph.Write(scene, color);
+	const uint32_t debugDraw = graph.AddPass("DebugDraw", record("DebugDraw"));
+	graph.Read(debugDraw, color);
+	graph.Write(debugDraw, debug);
+	const uint32_t debugResolve = graph.AddPass("DebugResolve", record("DebugResolve"));
+	graph.Read(debugResolve, debug);
+	graph.Write(debugResolve, debugResolved);
+	const uint32_t tonemap = graph.AddPass("Tonemap", record("Tonemap"));
+	graph.Read(tonemap, color);
+	graph.Write(tonemap, output);
+	const uint32_t measure = graph.AddPass("Measure", record("Measure"));
+	graph.Write(measure, readback);
+	graph.SetSideEffects(measure);
+	graph.Compile();
+
+	TEST_EXPECT(!graph.IsPassCulled(scene) && !graph.IsPassCulled(tonemap) && !graph.IsPassCulled(measure));
+	TEST_EXPECT(graph.IsPassCulled(debugDraw) && graph.IsPassCulled(debugResolve));
+	TEST_EXPECT(graph.GetNumCompiledPasses() == 3 && strcmp(graph.GetCompiledPassName(1), "Tonemap") == 0);
+	TEST_EXPECT(graph.GetStatistics().numCulledPasses == 2 && graph.GetStatistics().numTransientTextures == 2);
+	TEST_EXPECT(graph.GetResource(debug) == nullptr && graph.GetResource(color) != nullptr && graph.GetResource(output) == backBuffer.get());
+
+	ExecuteGraph(device, graph);
+	TEST_EXPECT(executed.size() == 3 && strcmp(executed[0], "Scene") == 0 && strcmp(executed[2], "Measure") == 0);
+	TEST_EXPECT(device.GetNullGraphicsQueue().GetStatistics().barrierMismatches == 0);
+
+	// Later writes keep earlier ones alive, a pass writing nothing anybody uses goes
+	graph.Reset();
+	const RenderGraphTexture target = graph.ImportTexture("Output", backBuffer.get(), RHIResourceState::RenderTarget, RHIResourceState::RenderTarget);
+	const RenderGraphTexture unused = graph.CreateTexture("Unused", 8, 8, RHIFormat::R32_FLOAT);
+	const uint32_t clear = graph.AddPass("Clear", nullptr);
+	graph.Write(clear, target);
+	const uint32_t orphan = graph.AddPass("Orphan", nullptr);
+	graph.Write(orphan, unused);
+	const uint32_t draw = graph.AddPass("Draw", nullptr);
+	graph.Write(draw, target);
+	graph.Compile();
+	TEST_EXPECT(!graph.IsPassCulled(clear) && graph.IsPassCulled(orphan) && !graph.IsPassCulled(draw));
+	TEST_EXPECT(graph.GetStatistics().numTransientTextures == 0 && graph.GetStatistics().numBarriers == 0);
+
+	// Imported textures only culled passes read still reach their final state, after the last compiled pass
+	auto history = device.CreateResource(RHIResourceDesc::Texture2D(64, 64, RHIFormat::R8G8B8A8_UNORM, true));
+	graph.Reset();
+	const RenderGraphTexture finalTarget = graph.ImportTexture("Output", backBuffer.get(), RHIResourceState::RenderTarget, RHIResourceState::RenderTarget);
+	const RenderGraphTexture previous = graph.ImportTexture("History", history.get(), RHIResourceState::RenderTarget, RHIResourceState::ShaderResource);
+	const RenderGraphTexture scratch = graph.CreateTexture("Scratch", 8, 8, RHIFormat::R32_FLOAT);
+	const uint32_t reproject = graph.AddPass("Reproject", nullptr);
+	graph.Read(reproject, previous);
+	graph.Write(reproject, scratch);
+	graph.Write(graph.AddPass("Draw", nullptr), finalTarget);
+	graph.Compile();
+	TEST_EXPECT(graph.IsPassCulled(reproject) && graph.GetResource(previous) == history.get() && graph.GetResource(scratch) == nullptr);
+	TEST_EXPECT(graph.GetStatistics().numBarriers == 1 && graph.GetStatistics().numBarrierBatches == 1);
+	ExecuteGraph(device, graph);
+	TEST_EXPECT(static_cast<NullResource*>(history.get())->GetTrackedState() == RHIResourceState::ShaderResource);
+	TEST_EXPECT(device.GetNullGraphicsQueue().GetStatistics().barrierMismatches == 0);
+}
+
+TEST_CASE(RenderGraph_BatchesBarriers)
+{
+	NullRHIDevice device;
+	auto backBuffer = device.CreateResource(RHIResourceDesc::Texture2D(64, 64, RHIFormat::R8G8B8A8_UNORM, true));
+	static_cast<NullResource*>(backBuffer.get())->SetTrackedState(RHIResourceState::Common);
+	RenderGraph graph(&device);
+
+	for (uint32_t frame = 0; frame < 3; frame++)
+	{
+		graph.Reset();
+		const RenderGraphTexture output = graph.ImportTexture("BackBuffer", backBuffer.get(), RHIResourceState::Common, RHIResourceState::Common);
+		const RenderGraphTexture albedo = graph.CreateTexture("Albedo", 64, 64, RHIFormat::R8G8B8A8_UNORM);
+		const RenderGraphTexture normal = graph.CreateTexture("Normal", 64, 64, RHIFormat::R16G16B16A16_FLOAT);
+		const RenderGraphTexture lighting = graph.CreateTexture("Lighting", 64, 64, RHIFormat::R16G16B16A16_FLOAT);
+
+		const uint32_t gbuffer = graph.AddPass("GBuffer", nullptr);
+		graph.Write(gbuffer, albedo);
+		graph.Write(gbuffer, normal);
+		// Both G-buffer targets change state before the pass, a single batch
+		const uint32_t lightingPass = graph.AddPass("Lighting", nullptr);
+		graph.Read(lightingPass, albedo);
+		graph.Read(lightingPass, normal);
+		graph.Write(lightingPass, lighting);
+		// Already readable, no barrier for the normals
+		const uint32_t composite = graph.AddPass("Composite", nullptr);
+		graph.Read(composite, lighting);
+		graph.Read(composite, normal);
+		graph.Write(composite, output);
+		graph.Compile();
+
+		// Albedo and normal to SRV, lighting to SRV, output in and out. Later frames first turn the
+		// G-buffer and lighting targets back from SRV, the placed resources persist
+		const RenderGraphStatistics& statistics = graph.GetStatistics();
+		TEST_EXPECT(statistics.numBarriers == (frame == 0 ? 5 : 8));
+		TEST_EXPECT(statistics.numBarrierBatches == (frame == 0 ? 3 : 4));
+		ExecuteGraph(device, graph);
+	}
+	const NullQueueStatistics statistics = device.GetNullGraphicsQueue().GetStatistics();
+	TEST_EXPECT(statistics.barrierMismatches == 0);
+	TEST_EXPECT(static_cast<NullResource*>(backBuffer.get())->GetTrackedState() == RHIResourceState::Common);
+
+	// One texture, two states in one pass
+	graph.Reset();
+	const RenderGraphTexture texture = graph.CreateTexture("Texture", 4, 4, RHIFormat::R32_FLOAT);
+	const uint32_t pass = graph.AddPass("Conflict", nullptr);
+	graph.Write(pass, texture);
+	graph.Read(pass, texture);
+	graph.SetSideEffects(pass);
+	bool bThrown = false;
+	try
+	{
+		graph.Compile();
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+TEST_CASE(RenderGraph_AliasesTransientTextures)
+{
+	NullRHIDevice device;
+	auto backBuffer = device.CreateResource(RHIResourceDesc::Texture2D(256, 256, RHIFormat::R8G8B8A8_UNORM, true));
+	RenderGraph graph(&device);
+	const uint64_t textureBytes = device.GetResourceAllocationInfo(RHIResourceDesc::Texture2D(256, 256, RHIFormat::R16G16B16A16_FLOAT, true)).size;
+
+	// Ping-pong chain, each texture only lives from its writer to the next pass
+	std::vector<RenderGraphTexture> chain;
+	for (uint32_t frame = 0; frame < 4; frame++)
+	{
+		graph.Reset();
+		chain.clear();
+		const RenderGraphTexture output = graph.ImportTexture("BackBuffer", backBuffer.get(), RHIResourceState::RenderTarget, RHIResourceState::RenderTarget);
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			chain.push_back(graph.CreateTexture("Chain", 256, 256, RHIFormat::R16G16B16A16_FLOAT));
+			const uint32_t pass = graph.AddPass("Step", [i, &chain](RHICommandList* pCommandList, const RenderGraph& graph)
+			{
+				const float color[] = { float(i), 0.0f, 0.0f, 1.0f };
+				pCommandList->ClearRenderTarget(graph.GetResource(chain[i]), color);
+			});
+			if (i > 0)
+			{
+				graph.Read(pass, chain[i - 1]);
+			}
+			graph.Write(pass, chain[i]);
+		}
+		const uint32_t present = graph.AddPass("Present", nullptr);
+		graph.Read(present, chain.back());
+		graph.Write(present, output);
+		graph.Compile();
+		ExecuteGraph(device, graph);
+	}
+
+	const RenderGraphStatistics& statistics = graph.GetStatistics();
+	TEST_EXPECT(statistics.transientBytes == 6 * textureBytes);
+	TEST_EXPECT(statistics.heapBytes == 2 * textureBytes && graph.GetHeapSize() == 2 * textureBytes);
+	// Every other texture shares memory, same placement and description even shares the resource
+	NullResource* pFirst = static_cast<NullResource*>(graph.GetResource(chain[0]));
+	NullResource* pSecond = static_cast<NullResource*>(graph.GetResource(chain[1]));
+	TEST_EXPECT(graph.GetResource(chain[2]) == pFirst && graph.GetResource(chain[4]) == pFirst && graph.GetResource(chain[5]) == pSecond);
+	TEST_EXPECT(pFirst->GetData() != pSecond->GetData());
+	const NullQueueStatistics queueStatistics = device.GetNullGraphicsQueue().GetStatistics();
+	TEST_EXPECT(queueStatistics.barrierMismatches == 0);
+
+	// Overlapping lifetimes never share memory: all textures read by the last pass
+	graph.Reset();
+	std::vector<RenderGraphTexture> textures;
+	const uint32_t gather = graph.AddPass("Gather", nullptr);
+	graph.SetSideEffects(gather);
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		textures.push_back(graph.CreateTexture("Input", 128 << (i % 2), 128, RHIFormat::R8G8B8A8_UNORM));
+		const uint32_t pass = graph.AddPass("Produce", nullptr);
+		graph.Write(pass, textures.back());
+	}
+	const uint32_t consume = graph.AddPass("Consume", nullptr);
+	for (const RenderGraphTexture& texture : textures)
+	{
+		graph.Read(consume, texture);
+	}
+	graph.SetSideEffects(consume);
+	graph.Compile();
+	TEST_EXPECT(graph.GetStatistics().heapBytes == graph.GetStatistics().transientBytes);
+	bool bDisjoint = true;
+	for (uint32_t a = 0; a < 4; a++)
+	{
+		for (uint32_t b = a + 1; b < 4; b++)
+		{
+			const NullResource* pA = static_cast<const NullResource*>(graph.GetResource(textures[a]));
+			const NullResource* pB = static_cast<const NullResource*>(graph.GetResource(textures[b]));
+			bDisjoint &= pA->GetData() + pA->GetSizeInBytes() <= pB->GetData() || pB->GetData() + pB->GetSizeInBytes() <= pA->GetData();
+		}
+	}
+	TEST_EXPECT(bDisjoint);
+
+	// Fits the existing heap, the new placements start with aliasing barriers
+	TEST_EXPECT(graph.GetHeapSize() == 2 * textureBytes);
+	ExecuteGraph(device, graph);
+	TEST_EXPECT(device.GetNullGraphicsQueue().GetStatistics().barrierMismatches == 0);
+	TEST_EXPECT(device.GetNullGraphicsQueue().GetStatistics().executedAliasingBarriers > 0);
+	// Every activation after an aliasing barrier is discarded, the new placements too
+	TEST_EXPECT(graph.GetStatistics().numDiscards == 4 && device.GetNullGraphicsQueue().GetStatistics().executedDiscards >= 4);
+}
+
+TEST_CASE(RenderGraph_OrdersUnorderedAccess)
+{
+	NullRHIDevice device;
+	RenderGraph graph(&device);
+	for (uint32_t frame = 0; frame < 2; frame++)
+	{
+		graph.Reset();
+		const RenderGraphTexture volume = graph.CreateTexture("Volume", 32, 32, RHIFormat::R32_FLOAT);
+		const RenderGraphTexture result = graph.CreateTexture("Result", 32, 32, RHIFormat::R32_FLOAT);
+		const uint32_t inject = graph.AddPass("Inject", nullptr);
+		graph.Write(inject, volume, RHIResourceState::UnorderedAccess);
+		// Write after write, read after write, read after read, write after read
+		const uint32_t scatter = graph.AddPass("Scatter", nullptr);
+		graph.Write(scatter, volume, RHIResourceState::UnorderedAccess);
+		const uint32_t gatherX = graph.AddPass("GatherX", nullptr);
+		graph.Read(gatherX, volume, RHIResourceState::UnorderedAccess);
+		graph.SetSideEffects(gatherX);
+		const uint32_t gatherY = graph.AddPass("GatherY", nullptr);
+		graph.Read(gatherY, volume, RHIResourceState::UnorderedAccess);
+		graph.SetSideEffects(gatherY);
+		const uint32_t accumulate = graph.AddPass("Accumulate", nullptr);
+		graph.Write(accumulate, volume, RHIResourceState::UnorderedAccess);
+		// The transition orders the last write
+		const uint32_t resolve = graph.AddPass("Resolve", nullptr);
+		graph.Read(resolve, volume);
+		graph.Write(resolve, result);
+		graph.SetSideEffects(resolve);
+		graph.Compile();
+
+		// First frame: discards of both new textures, then the volume to UAV. Later frames: volume back to UAV
+		const RenderGraphStatistics& statistics = graph.GetStatistics();
+		TEST_EXPECT(statistics.numDiscards == (frame == 0 ? 2 : 0));
+		TEST_EXPECT(statistics.numBarriers == 3 + 1 + 1);
+		ExecuteGraph(device, graph);
+	}
+	const NullQueueStatistics statistics = device.GetNullGraphicsQueue().GetStatistics();
+	TEST_EXPECT(statistics.executedUnorderedAccessBarriers == 2 * 3 && statistics.executedDiscards == 2);
+	TEST_EXPECT(statistics.barrierMismatches == 0);
+}
+
+TEST_CASE(RenderGraph_DrivesEngineBarriers)
+{
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("RenderGraph_DrivesEngineBarriers"));
+	engine.OnInit();
+	for (int i = 0; i < 4; i++)
+	{
+		engine.OnUpdate();
+	}
+	engine.OnDestroy();
+
+	// Scene color back to render target before the clear, then to shader resource together with the back buffer
+	// leaving present before the upscale, and the back buffer back to present after it
+	const RenderGraph* pGraph = engine.GetRenderGraph();
+	TEST_EXPECT(pGraph->GetNumCompiledPasses() == NumRenderPasses && pGraph->GetStatistics().numBarrierBatches == 3);
+	const NullQueueStatistics statistics = static_cast<NullRHIDevice*>(engine.GetDevice())->GetNullGraphicsQueue().GetStatistics();
+	// Scene color is created as a render target, the first frame skips its first transition
+	TEST_EXPECT(statistics.executedBarriers == 4 * 4 - 1 && statistics.barrierMismatches == 0);
+}
+
+// Deferred frame at 1080p: shadows, G-buffer, SSAO, lighting, bloom chain, TAA, tonemap, UI and a few debug views nobody reads
+static void DeclareDeferredFrame(RenderGraph& graph, RHIResource* pBackBuffer, RHIResource* pHistory, bool bDebugViews)
+{
+	const uint32_t width = 1920;
+	const uint32_t height = 1080;
+	graph.Reset();
+	const RenderGraphTexture backBuffer = graph.ImportTexture("BackBuffer", pBackBuffer, RHIResourceState::Present, RHIResourceState::Present);
+	const RenderGraphTexture history = graph.ImportTexture("History", pHistory, RHIResourceState::ShaderResource, RHIResourceState::ShaderResource);
+
+	RenderGraphTexture cascades[4];
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		cascades[i] = graph.CreateTexture("Cascade", 2048, 2048, RHIFormat::R32_FLOAT);
+		graph.Write(graph.AddPass("ShadowCascade", nullptr), cascades[i]);
+	}
+	const RenderGraphTexture albedo = graph.CreateTexture("Albedo", width, height, RHIFormat::R8G8B8A8_UNORM);
+	const RenderGraphTexture normal = graph.CreateTexture("Normal", width, height, RHIFormat::R16G16B16A16_FLOAT);
+	const RenderGraphTexture depth = graph.CreateTexture("Depth", width, height, RHIFormat::R32_FLOAT);
+	const uint32_t gbuffer = graph.AddPass("GBuffer", nullptr);
+	graph.Write(gbuffer, albedo);
+	graph.Write(gbuffer, normal);
+	graph.Write(gbuffer, depth);
+
+	const RenderGraphTexture ao = graph.CreateTexture("AO", width / 2, height / 2, RHIFormat::R32_FLOAT);
+	const uint32_t ssao = graph.AddPass("SSAO", nullptr);
+	graph.Read(ssao, normal);
+	graph.Read(ssao, depth);
+	graph.Write(ssao, ao);
+	const RenderGraphTexture aoBlurred = graph.CreateTexture("AOBlurred", width / 2, height / 2, RHIFormat::R32_FLOAT);
+	const uint32_t aoBlur = graph.AddPass("AOBlur", nullptr);
+	graph.Read(aoBlur, ao);
+	graph.Write(aoBlur, aoBlurred);
+
+	const RenderGraphTexture hdr = graph.CreateTexture("HDR", width, height, RHIFormat::R16G16B16A16_FLOAT);
+	const uint32_t lighting = graph.AddPass("Lighting", nullptr);
+	for (const RenderGraphTexture& cascade : cascades)
+	{
+		graph.Read(lighting, cascade);
+	}
+	graph.Read(lighting, albedo);
+	graph.Read(lighting, normal);
+	graph.Read(lighting, depth);
+	graph.Read(lighting, aoBlurred);
+	graph.Write(lighting, hdr);
+
+	// Bloom: downsample chain then upsample back
+	RenderGraphTexture bloom[6];
+	RenderGraphTexture source = hdr;
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		bloom[i] = graph.CreateTexture("BloomDown", width >> (i + 1), height >> (i + 1), RHIFormat::R16G16B16A16_FLOAT);
+		const uint32_t pass = graph.AddPass("BloomDown", nullptr);
+		graph.Read(pass, source);
+		graph.Write(pass, bloom[i]);
+		source = bloom[i];
+	}
+	for (uint32_t i = 5; i-- > 0;)
+	{
+		const RenderGraphTexture upsampled = graph.CreateTexture("BloomUp", width >> (i + 1), height >> (i + 1), RHIFormat::R16G16B16A16_FLOAT);
+		const uint32_t pass = graph.AddPass("BloomUp", nullptr);
+		graph.Read(pass, source);
+		graph.Read(pass, bloom[i]);
+		graph.Write(pass, upsampled);
+		source = upsampled;
+	}
+
+	const RenderGraphTexture resolved = graph.CreateTexture("TAA", width, height, RHIFormat::R16G16B16A16_FLOAT);
+	const uint32_t taa = graph.AddPass("TAA", nullptr);
+	graph.Read(taa, hdr);
+	graph.Read(taa, history);
+	graph.Read(taa, depth);
+	graph.Write(taa, resolved);
+
+	const uint32_t tonemap = graph.AddPass("Tonemap", nullptr);
+	graph.Read(tonemap, resolved);
+	graph.Read(tonemap, source);
+	graph.Write(tonemap, backBuffer);
+	const uint32_t ui = graph.AddPass("UI", nullptr);
+	graph.Write(ui, backBuffer);
+
+	if (bDebugViews)
+	{
+		const RenderGraphTexture views[] = { albedo, normal, depth, ao, hdr };
+		for (const RenderGraphTexture& view : views)
+		{
+			const RenderGraphTexture debug = graph.CreateTexture("DebugView", width, height, RHIFormat::R8G8B8A8_UNORM);
+			const uint32_t pass = graph.AddPass("DebugView", nullptr);
+			graph.Read(pass, view);
+			graph.Write(pass, debug);
+		}
+	}
+	graph.Compile();
+}
+
+BENCHMARK_CASE(RenderGraph_Compile)
+{
+	NullRHIDevice device;
+	auto backBuffer = device.CreateResource(RHIResourceDesc::Texture2D(1920, 1080, RHIFormat::R8G8B8A8_UNORM, true));
+	auto history = device.CreateResource(RHIResourceDesc::Texture2D(1920, 1080, RHIFormat::R16G16B16A16_FLOAT, true));
+	static_cast<NullResource*>(backBuffer.get())->SetTrackedState(RHIResourceState::Present);
+	static_cast<NullResource*>(history.get())->SetTrackedState(RHIResourceState::ShaderResource);
+	RenderGraph graph(&device);
+
+	// First frame creates the heap and the placed resources, later ones reuse them
+	DeclareDeferredFrame(graph, backBuffer.get(), history.get(), true);
+	const uint32_t numFrames = 20000;
+	BenchmarkTimer timer;
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		DeclareDeferredFrame(graph, backBuffer.get(), history.get(), true);
+	}
+	const double seconds = timer.GetElapsedSeconds();
+	const RenderGraphStatistics& statistics = graph.GetStatistics();
+	ReportBenchmark("Declare and compile", seconds, double(numFrames), "frame");
+	printf("    %u of %u passes culled, %u transient textures, %u barriers in %u batches\n",
+		statistics.numCulledPasses, statistics.numPasses, statistics.numTransientTextures, statistics.numBarriers, statistics.numBarrierBatches);
+	printf("    Transient memory %.1f MB without aliasing, %.1f MB aliased (%.0f%% saved)\n",
+		double(statistics.transientBytes) / (1024 * 1024), double(statistics.heapBytes) / (1024 * 1024), 100.0 * (1.0 - double(statistics.heapBytes) / double(statistics.transientBytes)));
+
+	// Frames that are actually executed are valid on the simulated GPU, including the states carried between frames
+	RenderGraph executedGraph(&device);
+	for (uint32_t frame = 0; frame < 3; frame++)
+	{
+		DeclareDeferredFrame(executedGraph, backBuffer.get(), history.get(), true);
+		ExecuteGraph(device, executedGraph);
+	}
+	const NullQueueStatistics queueStatistics = device.GetNullGraphicsQueue().GetStatistics();
+	printf("    3 frames on the Null backend: %llu barriers, %llu aliasing, %llu mismatches\n",
+		(unsigned long long)queueStatistics.executedBarriers, (unsigned long long)queueStatistics.executedAliasingBarriers, (unsigned long long)queueStatistics.barrierMismatches);
+}
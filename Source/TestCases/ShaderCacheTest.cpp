@@ -0,0 +1,181 @@
+#include "TestFramework.h"
+#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <fstream>
+
+// Scratch folder with a shader including a common header, removed on destruction
+struct ShaderSandbox
+{
+	explicit ShaderSandbox(const char* name)
+		: root(std::filesystem::temp_directory_path() / (std::string("ShaderCacheTest_") + name))
+	{
+		std::filesystem::remove_all(root);
+		std::filesystem::create_directories(root / "Common");
+		WriteFile("Common/Lighting.hlsli", "float3 Ambient() { return 0.1; }\n");
+		WriteFile("Shader.hlsl", "#include \"Common/Lighting.hlsli\"\nfloat4 PSMain() : SV_TARGET { return float4(Ambient(), 1); }\n");
+	}
+	~ShaderSandbox()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(root, error);
+	}
+
+	void WriteFile(const char* relativePath, const std::string& content)
+	{
+		std::ofstream file(root / relativePath, std::ios::binary | std::ios::trunc);
+		file << content;
+	}
+
+	ShaderCompileRequest MakeRequest() const
+	{
+		ShaderCompileRequest request;
+		request.filePath = (root / "Shader.hlsl").wstring();
+		request.entryPoint = "PSMain";
+		request.target = "ps_5_0";
+		return request;
+	}
+
+	std::wstring GetCacheDirectory() const { return (root / "Cache").wstring(); }
+
+	std::filesystem::path root;
+};
+
+TEST_CASE(ShaderCache_HitAfterMiss)
+{
+	ShaderSandbox sandbox("HitAfterMiss");
+	StubShaderCompiler compiler;
+	ShaderCache cache(sandbox.GetCacheDirectory(), &compiler);
+
+	ShaderBytecode first = cache.GetOrCompile(sandbox.MakeRequest());
+	TEST_EXPECT(compiler.GetNumCompilations() == 1);
+	TEST_EXPECT(first.IsMapped() && first.GetSize() > 0);
+
+	ShaderBytecode second = cache.GetOrCompile(sandbox.MakeRequest());
+	TEST_EXPECT(compiler.GetNumCompilations() == 1);
+	TEST_EXPECT(cache.GetStatistics().hits == 1 && cache.GetStatistics().misses == 1);
+	TEST_EXPECT(second.GetSize() == first.GetSize() && memcmp(second.GetData(), first.GetData(), first.GetSize()) == 0);
+}
+
+TEST_CASE(ShaderCache_PersistsAcrossInstances)
+{
+	ShaderSandbox sandbox("Persists");
+	StubShaderCompiler compiler;
+	{
+		ShaderCache cache(sandbox.GetCacheDirectory(), &compiler);
+		cache.GetOrCompile(sandbox.MakeRequest());
+	}
+
+	// Next "launch" only maps the stored entry
+	ShaderCache cache(sandbox.GetCacheDirectory(), &compiler);
+	ShaderBytecode bytecode = cache.GetOrCompile(sandbox.MakeRequest());
+	TEST_EXPECT(compiler.GetNumCompilations() == 1);
+	TEST_EXPECT(cache.GetStatistics().hits == 1 && bytecode.IsMapped());
+}
+
+TEST_CASE(ShaderCache_KeyCoversIncludesDefinesAndFlags)
+{
+	ShaderSandbox sandbox("KeyCoverage");
+	StubShaderCompiler compiler;
+	ShaderCache cache(sandbox.GetCacheDirectory(), &compiler);
+
+	const ShaderCompileRequest request = sandbox.MakeRequest();
+	const uint64_t baseKey = cache.ComputeKey(request);
+	TEST_EXPECT(cache.ComputeKey(request) == baseKey);
+
+	ShaderCompileRequest withDefine = request;
+	withDefine.defines.push_back({ "USE_SHADOWS", "1" });
+	TEST_EXPECT(cache.ComputeKey(withDefine) != baseKey);
+
+	ShaderCompileRequest withFlags = request;
+	withFlags.flags1 = 1;
+	TEST_EXPECT(cache.ComputeKey(withFlags) != baseKey);
+
+	ShaderCompileRequest otherEntry = request;
+	otherEntry.target = "ps_5_1";
+	TEST_EXPECT(cache.ComputeKey(otherEntry) != baseKey);
+
+	// Editing a header only reached through #include invalidates the entry
+	cache.GetOrCompile(request);
+	sandbox.WriteFile("Common/Lighting.hlsli", "float3 Ambient() { return 0.2; }\n");
+	TEST_EXPECT(cache.ComputeKey(request) != baseKey);
+	cache.GetOrCompile(request);
+	TEST_EXPECT(compiler.GetNumCompilations() == 2);
+}
+
+TEST_CASE(ShaderCache_RejectsCorruptEntry)
+{
+	ShaderSandbox sandbox("Corrupt");
+	StubShaderCompiler compiler;
+	ShaderCache cache(sandbox.GetCacheDirectory(), &compiler);
+
+	const ShaderCompileRequest request = sandbox.MakeRequest();
+	cache.GetOrCompile(request);
+	{
+		std::ofstream file(cache.GetEntryPath(cache.ComputeKey(request)), std::ios::binary | std::ios::trunc);
+		file << "garbage";
+	}
+
+	ShaderBytecode bytecode = cache.GetOrCompile(request);
+	TEST_EXPECT(compiler.GetNumCompilations() == 2);
+	TEST_EXPECT(bytecode.IsMapped() && bytecode.GetSize() > 0);
+}
+
+TEST_CASE(ShaderCache_CompileErrorThrows)
+{
+	ShaderSandbox sandbox("CompileError");
+	StubShaderCompiler compiler;
+	ShaderCache cache(sandbox.GetCacheDirectory(), &compiler);
+
+	ShaderCompileRequest request = sandbox.MakeRequest();
+	request.entryPoint = "Missing";
+	bool bThrown = false;
+	try
+	{
+		cache.GetOrCompile(request);
+	}
+	catch (const std::runtime_error&)
+	{
+		bThrown = true;
+	}
+	TEST_EXPECT(bThrown);
+}
+
+BENCHMARK_CASE(ShaderCache_Benchmark)
+{
+	ShaderSandbox sandbox("Benchmark");
+	StubShaderCompiler compiler;
+	ShaderCache cache(sandbox.GetCacheDirectory(), &compiler);
+	const ShaderCompileRequest request = sandbox.MakeRequest();
+
+	constexpr uint32_t NumLookups = 2000;
+	{
+		BenchmarkTimer timer;
+		for (uint32_t i = 0; i < NumLookups; i++)
+		{
+			cache.ComputeKey(request);
+		}
+		ReportBenchmark("ShaderCache key (source + includes)", timer.GetElapsedSeconds(), NumLookups, "key");
+	}
+	cache.GetOrCompile(request);
+	{
+		BenchmarkTimer timer;
+		for (uint32_t i = 0; i < NumLookups; i++)
+		{
+			cache.GetOrCompile(request);
+		}
+		ReportBenchmark("ShaderCache hit (key + map)", timer.GetElapsedSeconds(), NumLookups, "lookup");
+	}
+	{
+		std::vector<uint8_t> bytes(1 << 20, 0x5a);
+		BenchmarkTimer timer;
+		constexpr uint32_t NumHashes = 64;
+		uint64_t hash = 0;
+		for (uint32_t i = 0; i < NumHashes; i++)
+		{
+			hash = HashBytes(bytes.data(), bytes.size(), hash);
+		}
+		TEST_EXPECT(hash != 0);
+		ReportBenchmark("HashBytes 1MB", timer.GetElapsedSeconds(), double(NumHashes) * bytes.size(), "B");
+	}
+}
@@ -0,0 +1,344 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "ShadowSetup.h"
+
+#include <algorithm>
+#include <random>
+
+static bool RectsOverlap(const ShadowAtlasRect& a, const ShadowAtlasRect& b)
+{
+	return a.x < b.x + b.size && b.x < a.x + a.size && a.y < b.y + b.size && b.y < a.y + a.size;
+}
+
+static ShadowedLight MakeSpotLight(uint32_t id, const Float3& position, float range)
+{
+	return { id, ShadowLightType::Spot, position, { 0.0f, -1.0f, 0.2f }, range, 0.6f };
+}
+
+static ShadowedLight MakePointLight(uint32_t id, const Float3& position, float range)
+{
+	return { id, ShadowLightType::Point, position, { 0.0f, 0.0f, 1.0f }, range, 0.0f };
+}
+
+static uint32_t CountStaticRenders(const ShadowSetup& setup, uint32_t lightId)
+{
+	return uint32_t(std::count_if(setup.GetViews().begin(), setup.GetViews().end(), [&](const ShadowMapView& view) { return view.lightId == lightId && view.bRenderStatic; }));
+}
+
+TEST_CASE(ShadowAtlas_AllocatesDisjointTiles)
+{
+	ShadowAtlas atlas(4096, 128);
+	TEST_EXPECT(atlas.GetNumLevels() == 6 && atlas.GetMinTileSize() == 128);
+
+	std::mt19937 random(1);
+	std::vector<uint32_t> nodes;
+	for (uint32_t step = 0; step < 2000; step++)
+	{
+		if (!nodes.empty() && random() % 3 == 0)
+		{
+			const size_t index = random() % nodes.size();
+			atlas.Free(nodes[index]);
+			nodes[index] = nodes.back();
+			nodes.pop_back();
+			continue;
+		}
+		const uint32_t node = atlas.Allocate(100 + random() % 1500);
+		if (node != ShadowAtlas::InvalidNode)
+		{
+			nodes.push_back(node);
+		}
+
+		// Aligned to their size, inside the atlas and disjoint
+		uint64_t area = 0;
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const ShadowAtlasRect rect = atlas.GetRect(nodes[i]);
+			TEST_EXPECT(rect.x % rect.size == 0 && rect.y % rect.size == 0 && rect.x + rect.size <= 4096 && rect.y + rect.size <= 4096);
+			for (size_t j = 0; j < i; j++)
+			{
+				TEST_EXPECT(!RectsOverlap(rect, atlas.GetRect(nodes[j])));
+			}
+			area += uint64_t(rect.size) * rect.size;
+		}
+		TEST_EXPECT(area == atlas.GetAllocatedArea());
+	}
+
+	// Everything merges back into the root
+	for (const uint32_t node : nodes)
+	{
+		atlas.Free(node);
+	}
+	TEST_EXPECT(atlas.GetAllocatedArea() == 0);
+	const uint32_t root = atlas.Allocate(4096);
+	TEST_EXPECT(root == 0 && atlas.GetRect(root).size == 4096);
+	TEST_EXPECT(atlas.Allocate(128) == ShadowAtlas::InvalidNode);
+}
+
+TEST_CASE(ShadowAtlas_FillsCompletely)
+{
+	ShadowAtlas atlas(2048, 256);
+	std::vector<uint32_t> nodes;
+	for (uint32_t i = 0; i < 64; i++)
+	{
+		nodes.push_back(atlas.Allocate(256));
+		TEST_EXPECT(nodes.back() != ShadowAtlas::InvalidNode);
+	}
+	TEST_EXPECT(atlas.Allocate(1) == ShadowAtlas::InvalidNode);
+	TEST_EXPECT(atlas.GetOccupancy() == 1.0f);
+
+	// A 2x2 block of siblings makes room for a tile twice the size
+	atlas.Free(nodes[0]);
+	TEST_EXPECT(atlas.Allocate(512) == ShadowAtlas::InvalidNode);
+	const ShadowAtlasRect freed = atlas.GetRect(nodes[0]);
+	for (uint32_t i = 1; i < 64; i++)
+	{
+		const ShadowAtlasRect rect = atlas.GetRect(nodes[i]);
+		if (rect.x / 512 == freed.x / 512 && rect.y / 512 == freed.y / 512)
+		{
+			atlas.Free(nodes[i]);
+		}
+	}
+	const uint32_t merged = atlas.Allocate(512);
+	TEST_EXPECT(merged != ShadowAtlas::InvalidNode);
+	TEST_EXPECT(atlas.GetRect(merged).x == freed.x / 512 * 512 && atlas.GetRect(merged).y == freed.y / 512 * 512);
+}
+
+TEST_CASE(ShadowCascades_FitSlicesAndSnapToTexels)
+{
+	Camera camera;
+	camera.position = { 3.0f, 5.0f, -2.0f };
+	camera.forward = { 0.4f, -0.2f, 1.0f };
+	ShadowCascadeDesc desc;
+	const Float3 sunDirection = Normalize({ 0.3f, -0.9f, 0.3f });
+	std::vector<ShadowCascade> cascades;
+	ComputeShadowCascades(camera, sunDirection, desc, cascades);
+	TEST_EXPECT(cascades.size() == desc.numCascades);
+	TEST_EXPECT(cascades.front().splitNear == camera.nearZ && cascades.back().splitFar == desc.maxDistance);
+
+	// Back to back, every corner of the view frustum slice is inside the sphere and projects into the map
+	const Float3 forward = Normalize(camera.forward);
+	const Float3 right = Normalize(Cross(camera.up, forward));
+	const Float3 up = Cross(forward, right);
+	const float tanHalfY = std::tan(camera.fovY * 0.5f);
+	for (uint32_t i = 0; i < cascades.size(); i++)
+	{
+		const ShadowCascade& cascade = cascades[i];
+		TEST_EXPECT(i == 0 || cascade.splitNear == cascades[i - 1].splitFar);
+		TEST_EXPECT(cascade.splitFar > cascade.splitNear);
+		for (const float depth : { cascade.splitNear, cascade.splitFar })
+		{
+			for (uint32_t corner = 0; corner < 4; corner++)
+			{
+				const float sx = (corner & 1) ? 1.0f : -1.0f;
+				const float sy = (corner & 2) ? 1.0f : -1.0f;
+				const Float3 point = camera.position + forward * depth + right * (sx * depth * tanHalfY * camera.aspectRatio) + up * (sy * depth * tanHalfY);
+				TEST_EXPECT(Length(point - cascade.bounds.center) <= cascade.bounds.radius * 1.0001f);
+				const Float4 clip = Transform({ point.x, point.y, point.z, 1.0f }, cascade.viewProjection);
+				TEST_EXPECT(std::abs(clip.x) <= 1.0f && std::abs(clip.y) <= 1.0f && clip.z >= 0.0f && clip.z <= 1.0f);
+			}
+		}
+	}
+
+	// Rotating the camera keeps the sphere radius, moving it shifts the map by whole texels
+	Camera rotated = camera;
+	rotated.forward = { -0.7f, 0.1f, 0.3f };
+	std::vector<ShadowCascade> rotatedCascades;
+	ComputeShadowCascades(rotated, sunDirection, desc, rotatedCascades);
+	Camera moved = camera;
+	moved.position = camera.position + Float3{ 0.0137f, 0.0021f, 0.0173f };
+	std::vector<ShadowCascade> movedCascades;
+	ComputeShadowCascades(moved, sunDirection, desc, movedCascades);
+	for (uint32_t i = 0; i < cascades.size(); i++)
+	{
+		TEST_EXPECT(rotatedCascades[i].bounds.radius == cascades[i].bounds.radius);
+		TEST_EXPECT(rotatedCascades[i].texelSize == cascades[i].texelSize);
+
+		const Float4 before = Transform({ 0.0f, 0.0f, 0.0f, 1.0f }, cascades[i].viewProjection);
+		const Float4 after = Transform({ 0.0f, 0.0f, 0.0f, 1.0f }, movedCascades[i].viewProjection);
+		const float texelsX = (after.x - before.x) * 0.5f * float(desc.resolution);
+		const float texelsY = (after.y - before.y) * 0.5f * float(desc.resolution);
+		TEST_EXPECT(std::abs(texelsX - std::round(texelsX)) < 0.01f && std::abs(texelsY - std::round(texelsY)) < 0.01f);
+	}
+}
+
+TEST_CASE(ShadowSetup_PacksByImportance)
+{
+	ShadowSetupDesc desc;
+	desc.atlasSize = 2048;
+	desc.minTileSize = 128;
+	desc.maxTileSize = 1024;
+	ShadowSetup setup(desc);
+	Camera camera;
+
+	std::vector<ShadowedLight> lights;
+	lights.push_back(MakeSpotLight(10, { 0.0f, 0.0f, 80.0f }, 5.0f));		// Far away
+	lights.push_back(MakeSpotLight(11, { 0.0f, 0.0f, 6.0f }, 5.0f));		// Close
+	lights.push_back(MakePointLight(12, { 2.0f, 0.0f, 20.0f }, 4.0f));
+	lights.push_back(MakeSpotLight(13, { 0.0f, 0.0f, -50.0f }, 5.0f));		// Behind the camera
+	setup.Update(camera, { 0.0f, -1.0f, 0.0f }, lights);
+
+	const ShadowStatistics& statistics = setup.GetStatistics();
+	TEST_EXPECT(statistics.numShadowedLights == 3 && statistics.numUnshadowedLights == 1);
+	TEST_EXPECT(statistics.numViews == 8 && setup.GetViews().size() == 8);
+	auto tileSize = [&](uint32_t lightId)
+	{
+		for (const ShadowMapView& view : setup.GetViews())
+		{
+			if (view.lightId == lightId)
+			{
+				return view.rect.size;
+			}
+		}
+		return 0u;
+	};
+	TEST_EXPECT(tileSize(11) == 1024 && tileSize(10) == 128 && tileSize(12) > tileSize(10) && tileSize(12) < tileSize(11));
+	for (size_t i = 0; i < setup.GetViews().size(); i++)
+	{
+		for (size_t j = 0; j < i; j++)
+		{
+			TEST_EXPECT(!RectsOverlap(setup.GetViews()[i].rect, setup.GetViews()[j].rect));
+		}
+	}
+
+	// More close lights than room, the most important ones come first and the rest falls back to smaller tiles
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		lights.push_back(MakeSpotLight(100 + i, { float(i) - 4.0f, 0.0f, 4.0f + float(i) * 0.5f }, 5.0f));
+	}
+	setup.Update(camera, { 0.0f, -1.0f, 0.0f }, lights);
+	TEST_EXPECT(setup.GetStatistics().numShadowedLights + setup.GetStatistics().numUnshadowedLights == lights.size());
+	TEST_EXPECT(setup.GetAtlas().GetOccupancy() <= 1.0f && setup.GetStatistics().numShadowedLights > 4);
+	TEST_EXPECT(tileSize(100) == 1024);
+	for (size_t i = 0; i < setup.GetViews().size(); i++)
+	{
+		for (size_t j = 0; j < i; j++)
+		{
+			TEST_EXPECT(!RectsOverlap(setup.GetViews()[i].rect, setup.GetViews()[j].rect));
+		}
+	}
+}
+
+TEST_CASE(ShadowSetup_CachesStaticShadows)
+{
+	ShadowSetup setup;
+	Camera camera;
+	const Float3 sunDirection = Normalize({ 0.3f, -0.9f, 0.3f });
+	std::vector<ShadowedLight> lights = { MakeSpotLight(1, { -3.0f, 2.0f, 10.0f }, 6.0f), MakePointLight(2, { 4.0f, 1.0f, 15.0f }, 5.0f), MakeSpotLight(3, { 0.0f, 3.0f, 30.0f }, 8.0f) };
+
+	// Everything is rendered once, then nothing until something changes
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(setup.GetStatistics().numStaticRenders == setup.GetViews().size() + setup.GetCascades().size());
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(setup.GetStatistics().numStaticRenders == 0 && setup.GetStatistics().numAllocations == 0);
+
+	// A moved light re-renders its own tile only
+	lights[0].position.x += 0.5f;
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(setup.GetStatistics().numStaticRenders == 1 && CountStaticRenders(setup, 1) == 1);
+
+	// Static geometry changed next to the point light, the sun's cascades see it too
+	setup.InvalidateStatic({ { 4.0f, 0.0f, 13.0f }, 0.5f });
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(CountStaticRenders(setup, 2) == 6 && CountStaticRenders(setup, 1) == 0 && CountStaticRenders(setup, 3) == 0);
+	TEST_EXPECT(std::all_of(setup.GetCascades().begin(), setup.GetCascades().end(), [](const ShadowCascade& cascade) { return cascade.bRenderStatic; }));
+
+	// Further away only the outer cascades cover it
+	setup.InvalidateStatic({ { 0.0f, 0.0f, 32.0f }, 0.5f });
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(CountStaticRenders(setup, 3) == 1 && CountStaticRenders(setup, 1) == 0 && CountStaticRenders(setup, 2) == 0);
+	TEST_EXPECT(!setup.GetCascades()[0].bRenderStatic && setup.GetCascades().back().bRenderStatic);
+
+	// Sub-texel camera motion keeps the cascades, a larger move re-renders them
+	camera.position.x += setup.GetCascades()[0].texelSize * 0.01f;
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(setup.GetStatistics().numStaticRenders <= 1);
+	camera.position.x += 5.0f;
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(std::all_of(setup.GetCascades().begin(), setup.GetCascades().end(), [](const ShadowCascade& cascade) { return cascade.bRenderStatic; }));
+
+	// A light that leaves and comes back starts from scratch
+	const ShadowedLight removed = lights.back();
+	lights.pop_back();
+	setup.Update(camera, sunDirection, lights);
+	lights.push_back(removed);
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(CountStaticRenders(setup, 3) == 1);
+
+	setup.InvalidateAllStatic();
+	setup.Update(camera, sunDirection, lights);
+	TEST_EXPECT(setup.GetStatistics().numStaticRenders == setup.GetViews().size() + setup.GetCascades().size());
+}
+
+TEST_CASE(ShadowSetup_EngineFrame)
+{
+	Engine engine(320, 240, L"Headless", RHIBackend::Null);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("ShadowSetup_EngineFrame"));
+	engine.OnInit();
+	engine.GetShadowedLights().push_back(MakeSpotLight(1, { 0.0f, 2.0f, 8.0f }, 6.0f));
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetShadowSetup()->GetViews().size() == 1 && engine.GetShadowSetup()->GetViews()[0].bRenderStatic);
+	TEST_EXPECT(engine.GetShadowSetup()->GetCascades().size() == ShadowCascadeDesc().numCascades);
+	engine.OnUpdate();
+	TEST_EXPECT(engine.GetShadowSetup()->GetStatistics().numStaticRenders == 0);
+	engine.OnDestroy();
+}
+
+BENCHMARK_CASE(ShadowSetup_Update)
+{
+	// Lights spread along a walk, the camera moves every frame so tiles keep changing size
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<ShadowedLight> lights;
+	for (uint32_t i = 0; i < 2000; i++)
+	{
+		const Float3 position = { unit(random) * 200.0f - 100.0f, unit(random) * 10.0f, unit(random) * 400.0f };
+		const float range = 2.0f + unit(random) * 10.0f;
+		lights.push_back(i % 4 == 0 ? MakePointLight(i, position, range) : MakeSpotLight(i, position, range));
+	}
+
+	ShadowSetup setup;
+	Camera camera;
+	const Float3 sunDirection = Normalize({ 0.3f, -0.9f, 0.3f });
+	const uint32_t numFrames = 200;
+	uint64_t numViews = 0;
+	uint64_t numStaticRenders = 0;
+	uint64_t numAllocations = 0;
+	BenchmarkTimer timer;
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		camera.position.z = float(frame) * 1.0f;
+		setup.Update(camera, sunDirection, lights);
+		numViews += setup.GetStatistics().numViews;
+		numStaticRenders += setup.GetStatistics().numStaticRenders;
+		numAllocations += setup.GetStatistics().numAllocations;
+	}
+	const double seconds = timer.GetElapsedSeconds();
+	ReportBenchmark("2000 lights, moving camera", seconds, double(lights.size()) * numFrames, "light");
+	printf("    %.3f ms per frame, %.1f views, %.1f static renders, %.1f allocations per frame\n", seconds * 1000.0 / numFrames,
+		double(numViews) / numFrames, double(numStaticRenders) / numFrames, double(numAllocations) / numFrames);
+
+	ShadowAtlas atlas(8192, 64);
+	std::vector<uint32_t> nodes;
+	const uint32_t numOperations = 1000000;
+	BenchmarkTimer atlasTimer;
+	for (uint32_t i = 0; i < numOperations; i++)
+	{
+		if (!nodes.empty() && (random() & 1))
+		{
+			const size_t index = random() % nodes.size();
+			atlas.Free(nodes[index]);
+			nodes[index] = nodes.back();
+			nodes.pop_back();
+		}
+		else
+		{
+			const uint32_t node = atlas.Allocate(64u << (random() % 6));
+			if (node != ShadowAtlas::InvalidNode)
+			{
+				nodes.push_back(node);
+			}
+		}
+	}
+	ReportBenchmark("Atlas allocate / free", atlasTimer.GetElapsedSeconds(), numOperations, "op");
+}
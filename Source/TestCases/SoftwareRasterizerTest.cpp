@@ -0,0 +1,338 @@
+#include "TestFramework.h"
+#include "TestHelpers.h"
+#include "Engine.h"
+#include "SoftwareRasterizer.h"
+
+#include <random>
+
+namespace
+{
+	struct TestVertex
+	{
+		Float3 position;
+		Float4 color;
+	};
+
+	// Device, target and pipeline of Shader.hlsl with the rasterizer as the GPU
+	struct TestRenderer
+	{
+		TestRenderer(uint32_t width, uint32_t height, uint32_t numWorkerThreads = 2)
+			: jobSystem(numWorkerThreads)
+			, rasterizer(&jobSystem)
+		{
+			device.GetNullGraphicsQueue().SetExecutor(&rasterizer);
+			renderTarget = device.CreateResource(RHIResourceDesc::Texture2D(width, height, RHIFormat::R8G8B8A8_UNORM, true));
+
+			RHIGraphicsPipelineDesc desc;
+			desc.vertexShader = { L"Shader.hlsl", "VSMain", "vs_5_0" };
+			desc.pixelShader = { L"Shader.hlsl", "PSMain", "ps_5_0" };
+			desc.inputLayout = { { "POSITION", 0, RHIFormat::R32G32B32_FLOAT, 0, 0 }, { "COLOR", 0, RHIFormat::R32G32B32A32_FLOAT, 0, 12 } };
+			pipelineState = device.CreateGraphicsPipelineState(desc);
+			allocator = device.CreateCommandAllocator();
+			commandList = device.CreateCommandList();
+		}
+
+		~TestRenderer()
+		{
+			device.GetNullGraphicsQueue().SetExecutor(nullptr);
+		}
+
+		void Render(const std::vector<TestVertex>& vertices, const RHIRect& scissorRect, const float clearColor[4])
+		{
+			const RHIResourceDesc& desc = renderTarget->GetDesc();
+			const uint64_t bufferSize = std::max<uint64_t>(vertices.size() * sizeof(TestVertex), 1);
+			vertexBuffer = device.CreateResource(RHIResourceDesc::Buffer(bufferSize));
+			memcpy(vertexBuffer->Map(), vertices.data(), vertices.size() * sizeof(TestVertex));
+
+			allocator->Reset();
+			commandList->Begin(allocator.get(), pipelineState.get());
+			commandList->ClearRenderTarget(renderTarget.get(), clearColor);
+			commandList->SetViewport({ 0.0f, 0.0f, float(desc.width), float(desc.height), 0.0f, 1.0f });
+			commandList->SetScissorRect(scissorRect);
+			commandList->SetRenderTarget(renderTarget.get());
+			commandList->SetPrimitiveTopology(RHIPrimitiveTopology::TriangleList);
+			commandList->SetVertexBuffer(0, { vertexBuffer->GetGpuVirtualAddress(), uint32_t(bufferSize), sizeof(TestVertex) });
+			commandList->DrawInstanced(uint32_t(vertices.size()), 1, 0, 0);
+			commandList->Close();
+			RHICommandList* ppCommandLists[] = { commandList.get() };
+			device.GetGraphicsQueue()->ExecuteCommandLists(1, ppCommandLists);
+			device.GetNullGraphicsQueue().Flush();
+		}
+
+		const uint32_t* GetPixels() { return reinterpret_cast<const uint32_t*>(static_cast<NullResource*>(renderTarget.get())->GetData()); }
+
+		NullRHIDevice device;
+		JobSystem jobSystem;
+		SoftwareRasterizer rasterizer;
+		std::unique_ptr<RHIResource> renderTarget;
+		std::unique_ptr<RHIResource> vertexBuffer;
+		std::unique_ptr<RHIPipelineState> pipelineState;
+		std::unique_ptr<RHICommandAllocator> allocator;
+		std::unique_ptr<RHICommandList> commandList;
+	};
+
+	// One pixel at a time in 64 bit: same snapping, same fill rule, barycentric colors in double
+	std::vector<uint32_t> RasterizeReference(const std::vector<TestVertex>& vertices, uint32_t width, uint32_t height, uint32_t clearColor)
+	{
+		const int64_t scale = 1 << SoftwareRasterizer::SubpixelBits;
+		std::vector<uint32_t> pixels(size_t(width) * height, clearColor);
+		for (size_t first = 0; first + 3 <= vertices.size(); first += 3)
+		{
+			int64_t x[3], y[3];
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				const Float3& p = vertices[first + i].position;
+				x[i] = std::lrint((p.x + 1.0f) * 0.5f * float(width) * scale);
+				y[i] = std::lrint((1.0f - p.y) * 0.5f * float(height) * scale);
+			}
+			const int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (area <= 0)
+			{
+				continue;
+			}
+			for (uint32_t py = 0; py < height; py++)
+			{
+				for (uint32_t px = 0; px < width; px++)
+				{
+					const int64_t sx = px * scale + scale / 2;
+					const int64_t sy = py * scale + scale / 2;
+					int64_t edges[3];
+					bool bInside = true;
+					for (uint32_t i = 0; i < 3 && bInside; i++)
+					{
+						const uint32_t j = (i + 1) % 3;
+						const int64_t a = y[i] - y[j];
+						const int64_t b = x[j] - x[i];
+						edges[i] = a * (sx - x[i]) + b * (sy - y[i]);
+						bInside = edges[i] > 0 || (edges[i] == 0 && (a > 0 || (a == 0 && b > 0)));
+					}
+					if (!bInside)
+					{
+						continue;
+					}
+					// Edge i is opposite of vertex (i + 2) % 3
+					Float4 color = {};
+					const float* pColor[3] = { &vertices[first + 0].color.x, &vertices[first + 1].color.x, &vertices[first + 2].color.x };
+					for (uint32_t component = 0; component < 4; component++)
+					{
+						const double value = (double(edges[1]) * pColor[0][component] + double(edges[2]) * pColor[1][component] + double(edges[0]) * pColor[2][component]) / double(area);
+						(&color.x)[component] = float(value);
+					}
+					pixels[py * width + px] = PackColorRGBA8(color).rgba;
+				}
+			}
+		}
+		return pixels;
+	}
+
+	bool IsSameColor(uint32_t a, uint32_t b, int32_t tolerance)
+	{
+		for (uint32_t shift = 0; shift < 32; shift += 8)
+		{
+			if (std::abs(int32_t((a >> shift) & 0xff) - int32_t((b >> shift) & 0xff)) > tolerance)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<TestVertex> MakeRandomTriangles(uint32_t count, float size, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(-1.1f, 1.1f);
+		std::uniform_real_distribution<float> offset(-size, size);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<TestVertex> vertices;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const float cx = position(random);
+			const float cy = position(random);
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				vertices.push_back({ { cx + offset(random), cy + offset(random), unit(random) }, { unit(random), unit(random), unit(random), 1.0f } });
+			}
+		}
+		return vertices;
+	}
+
+	// Regular grid of quads with jittered inner vertices, every pixel is covered by exactly one triangle
+	std::vector<TestVertex> MakeGridMesh(uint32_t cellsX, uint32_t cellsY, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+		std::vector<Float3> corners((cellsX + 1) * (cellsY + 1));
+		for (uint32_t y = 0; y <= cellsY; y++)
+		{
+			for (uint32_t x = 0; x <= cellsX; x++)
+			{
+				const bool bBorderX = x == 0 || x == cellsX;
+				const bool bBorderY = y == 0 || y == cellsY;
+				corners[y * (cellsX + 1) + x] =
+				{
+					-1.0f + 2.0f * (float(x) + (bBorderX ? 0.0f : jitter(random))) / cellsX,
+					1.0f - 2.0f * (float(y) + (bBorderY ? 0.0f : jitter(random))) / cellsY,
+					0.5f,
+				};
+			}
+		}
+		std::vector<TestVertex> vertices;
+		auto corner = [&](uint32_t x, uint32_t y) { return TestVertex{ corners[y * (cellsX + 1) + x], { float(x) / cellsX, float(y) / cellsY, 0.0f, 1.0f } }; };
+		for (uint32_t y = 0; y < cellsY; y++)
+		{
+			for (uint32_t x = 0; x < cellsX; x++)
+			{
+				// Clockwise on screen, y of the grid runs down
+				vertices.insert(vertices.end(), { corner(x, y), corner(x + 1, y), corner(x + 1, y + 1) });
+				vertices.insert(vertices.end(), { corner(x, y), corner(x + 1, y + 1), corner(x, y + 1) });
+			}
+		}
+		return vertices;
+	}
+}
+
+TEST_CASE(SoftwareRasterizer_MatchesReference)
+{
+	// Odd size for partial tiles, both windings so half of the triangles are culled
+	const uint32_t width = 250;
+	const uint32_t height = 190;
+	TestRenderer renderer(width, height);
+	const std::vector<TestVertex> vertices = MakeRandomTriangles(400, 0.3f, 1);
+	const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
+	renderer.Render(vertices, { 0, 0, int32_t(width), int32_t(height) }, clearColor);
+
+	const uint32_t clear = PackColorRGBA8({ clearColor[0], clearColor[1], clearColor[2], clearColor[3] }).rgba;
+	const std::vector<uint32_t> reference = RasterizeReference(vertices, width, height, clear);
+	uint32_t numMismatches = 0;
+	uint32_t numCovered = 0;
+	for (size_t i = 0; i < reference.size(); i++)
+	{
+		numMismatches += !IsSameColor(renderer.GetPixels()[i], reference[i], 1);
+		numCovered += reference[i] != clear;
+	}
+	TEST_EXPECT(numMismatches == 0);
+	TEST_EXPECT(numCovered > width * height / 2);
+
+	const SoftwareRasterizerStatistics& statistics = renderer.rasterizer.GetStatistics();
+	TEST_EXPECT(statistics.numDraws == 1 && statistics.numSkippedDraws == 0 && statistics.numTriangles == 400);
+	TEST_EXPECT(statistics.numRasterizedTriangles > 100 && statistics.numRasterizedTriangles < 300);
+}
+
+TEST_CASE(SoftwareRasterizer_SharedEdgesAreWatertight)
+{
+	const uint32_t width = 300;
+	const uint32_t height = 200;
+	TestRenderer renderer(width, height);
+	const float clearColor[] = { 1.0f, 0.0f, 1.0f, 0.0f };
+	renderer.Render(MakeGridMesh(23, 17, 2), { 0, 0, int32_t(width), int32_t(height) }, clearColor);
+
+	// No gaps and no pixel written twice
+	TEST_EXPECT(renderer.rasterizer.GetStatistics().numPixels == width * height);
+	const uint32_t clear = PackColorRGBA8({ clearColor[0], clearColor[1], clearColor[2], clearColor[3] }).rgba;
+	TEST_EXPECT(std::find(renderer.GetPixels(), renderer.GetPixels() + width * height, clear) == renderer.GetPixels() + width * height);
+}
+
+TEST_CASE(SoftwareRasterizer_ClipsAndScissors)
+{
+	const uint32_t width = 200;
+	const uint32_t height = 150;
+	TestRenderer renderer(width, height);
+	const float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	// Far beyond the guard band, clipped in homogeneous space and still covering exactly the scissor rectangle
+	const std::vector<TestVertex> hugeTriangle =
+	{
+		{ { -1000.0f, -1000.0f, 0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+		{ { 0.0f, 3000.0f, 0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+		{ { 1000.0f, -1000.0f, 0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+	};
+	const RHIRect scissorRect = { 30, 20, 170, 101 };
+	renderer.Render(hugeTriangle, scissorRect, clearColor);
+	TEST_EXPECT(renderer.rasterizer.GetStatistics().numPixels == uint64_t(140 * 81));
+	TEST_EXPECT(renderer.GetPixels()[20 * width + 30] == 0xffffffff && renderer.GetPixels()[19 * width + 30] == 0);
+	TEST_EXPECT(renderer.GetPixels()[100 * width + 169] == 0xffffffff && renderer.GetPixels()[100 * width + 170] == 0);
+
+	// Behind the near plane half of the quad goes away, the color stays interpolated along the clipped edge
+	renderer.rasterizer.ResetStatistics();
+	const std::vector<TestVertex> crossingNearPlane =
+	{
+		{ { -1.0f, 1.0f, -0.5f }, { 0.0f, 0.0f, 0.0f, 1.0f } },
+		{ { 1.0f, 1.0f, 0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+		{ { 1.0f, -1.0f, 0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+		{ { -1.0f, 1.0f, -0.5f }, { 0.0f, 0.0f, 0.0f, 1.0f } },
+		{ { 1.0f, -1.0f, 0.5f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+		{ { -1.0f, -1.0f, -0.5f }, { 0.0f, 0.0f, 0.0f, 1.0f } },
+	};
+	renderer.Render(crossingNearPlane, { 0, 0, int32_t(width), int32_t(height) }, clearColor);
+	const uint64_t numPixels = renderer.rasterizer.GetStatistics().numPixels;
+	TEST_EXPECT(numPixels >= width * height / 2 - height && numPixels <= width * height / 2 + height);
+	TEST_EXPECT(renderer.GetPixels()[75 * width + 10] == 0);
+	TEST_EXPECT(IsSameColor(renderer.GetPixels()[75 * width + 150], PackColorRGBA8({ 0.75f, 0.75f, 0.75f, 1.0f }).rgba, 2));
+}
+
+TEST_CASE(SoftwareRasterizer_EngineFrame)
+{
+	// The Engine's triangle through the whole RHI path, compared against the reference
+	const uint32_t width = 320;
+	const uint32_t height = 240;
+	Engine engine(width, height, L"Headless", RHIBackend::Null);
+	engine.SetSoftwareRasterization(true);
+	engine.SetPipelineCachePath(GetTestPipelineCachePath("SoftwareRasterizer_EngineFrame"));
+	engine.OnInit();
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		engine.OnUpdate();
+	}
+	engine.OnDestroy();
+
+	const float aspectRatio = float(width) / float(height);
+	const std::vector<TestVertex> vertices =
+	{
+		{ { 0.0f, 0.25f * aspectRatio, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+		{ { 0.25f, -0.25f * aspectRatio, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+		{ { -0.25f, -0.25f * aspectRatio, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+	};
+	const uint32_t clear = PackColorRGBA8({ 0.0f, 0.2f, 0.4f, 1.0f }).rgba;
+	const std::vector<uint32_t> reference = RasterizeReference(vertices, width, height, clear);
+	const uint32_t* pPixels = reinterpret_cast<const uint32_t*>(static_cast<NullResource*>(engine.GetSwapChain()->GetBackBuffer(0))->GetData());
+	uint32_t numMismatches = 0;
+	for (size_t i = 0; i < reference.size(); i++)
+	{
+		// Vertex colors went through RGBA8, they are exact in this case
+		numMismatches += !IsSameColor(pPixels[i], reference[i], 1);
+	}
+	TEST_EXPECT(numMismatches == 0);
+	// Screen center is half way down from the red top vertex
+	TEST_EXPECT(IsSameColor(pPixels[(height / 2) * width + width / 2], PackColorRGBA8({ 0.5f, 0.25f, 0.25f, 1.0f }).rgba, 4));
+	TEST_EXPECT(engine.GetSoftwareRasterizer()->GetStatistics().numDraws == 3);
+}
+
+BENCHMARK_CASE(SoftwareRasterizer_Throughput)
+{
+	const uint32_t width = 1920;
+	const uint32_t height = 1080;
+	TestRenderer renderer(width, height, JobSystem::GetDefaultNumWorkerThreads());
+	const float clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	auto run = [&](const char* name, const std::vector<TestVertex>& vertices)
+	{
+		renderer.Render(vertices, { 0, 0, int32_t(width), int32_t(height) }, clearColor);
+		renderer.rasterizer.ResetStatistics();
+		const uint32_t numIterations = 5;
+		for (uint32_t i = 0; i < numIterations; i++)
+		{
+			renderer.Render(vertices, { 0, 0, int32_t(width), int32_t(height) }, clearColor);
+		}
+		const SoftwareRasterizerStatistics& statistics = renderer.rasterizer.GetStatistics();
+		char label[128];
+		snprintf(label, sizeof(label), "%s, triangles", name);
+		ReportBenchmark(label, statistics.rasterSeconds, double(statistics.numTriangles), "tri");
+		snprintf(label, sizeof(label), "%s, pixels", name);
+		ReportBenchmark(label, statistics.rasterSeconds, double(statistics.numPixels), "px");
+		printf("    %.3f ms per frame, %.1f px per rasterized triangle\n", statistics.rasterSeconds * 1000.0 / numIterations,
+			double(statistics.numPixels) / std::max<double>(double(statistics.numRasterizedTriangles), 1.0));
+	};
+	run("100k small triangles 1080p", MakeRandomTriangles(100000, 0.01f, 3));
+	run("10k medium triangles 1080p", MakeRandomTriangles(10000, 0.1f, 4));
+	run("Full screen grid 1080p", MakeGridMesh(16, 9, 5));
+}
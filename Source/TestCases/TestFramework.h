@@ -0,0 +1,68 @@
+#pragma once
+
+// Minimal self registering test and benchmark harness for ModuleTest
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct TestCaseEntry
+{
+	const char*	name;
+	void		(*function)();
+	bool		bBenchmark;
+};
+
+inline std::vector<TestCaseEntry>& GetTestRegistry()
+{
+	static std::vector<TestCaseEntry> s_registry;
+	return s_registry;
+}
+
+struct TestCaseRegistrar
+{
+	TestCaseRegistrar(const char* name, void (*function)(), bool bBenchmark)
+	{
+		GetTestRegistry().push_back({ name, function, bBenchmark });
+	}
+};
+
+#define __test_concat_helper(a, b)	a##b
+#define __test_concat(a, b)			__test_concat_helper(a, b)
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static TestCaseRegistrar __test_concat(s_registrar_, name)(#name, &name, false); \
+	static void name()
+
+// Benchmarks only run with `ModuleTest --bench`
+#define BENCHMARK_CASE(name) \
+	static void name(); \
+	static TestCaseRegistrar __test_concat(s_registrar_, name)(#name, &name, true); \
+	static void name()
+
+#define __to_test_string_helper(x)	#x
+#define __to_test_string(x)			__to_test_string_helper(x)
+
+#define TEST_EXPECT(x) if (!(x)) { throw std::runtime_error("file: " __FILE__ ", " __to_test_string(__LINE__) ": " #x); }
+
+class BenchmarkTimer
+{
+public:
+	BenchmarkTimer() : m_start(std::chrono::steady_clock::now()) {}
+
+	double GetElapsedSeconds() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_start;
+};
+
+inline void ReportBenchmark(const char* name, double seconds, double operations, const char* unit)
+{
+	printf("    %-48s %10.3f ms  %14.3f M%s/s\n", name, seconds * 1000.0, operations / seconds / 1e6, unit);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// Helpers shared by several test files: tolerances, random geometry and a ray tracing reference independent of
+// the production ray/triangle test
+
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr float Pi = 3.14159265358979f;
+
+// In the temp directory, so tests never read or replace the PipelineCache.bin of the executable
+inline std::wstring GetTestPipelineCachePath(const char* name)
+{
+	return (std::filesystem::temp_directory_path() / (std::string("PipelineCacheTest_") + name + ".bin")).wstring();
+}
+
+// Relative to the larger magnitude, values near 0 compare absolutely against 1e-6 * tolerance
+inline bool NearlyEqual(float a, float b, float relativeTolerance)
+{
+	return std::abs(a - b) <= relativeTolerance * std::max({ std::abs(a), std::abs(b), 1e-6f });
+}
+
+inline bool NearlyEqual(const Float3& a, const Float3& b, float relativeTolerance)
+{
+	return NearlyEqual(a.x, b.x, relativeTolerance) && NearlyEqual(a.y, b.y, relativeTolerance) && NearlyEqual(a.z, b.z, relativeTolerance);
+}
+
+inline bool NearlyEqualAbsolute(const Float3& a, const Float3& b, float tolerance)
+{
+	return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+}
+
+// Triangles of random size scattered over a cube, vertices not shared
+inline void AddRandomTriangles(std::mt19937& random, uint32_t count, float sceneSize, float triangleSize, std::vector<Float3>& positions, std::vector<uint32_t>& indices)
+{
+	std::uniform_real_distribution<float> center(-sceneSize, sceneSize);
+	std::uniform_real_distribution<float> offset(-triangleSize, triangleSize);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Float3 c = { center(random), center(random), center(random) };
+		for (uint32_t v = 0; v < 3; v++)
+		{
+			indices.push_back(uint32_t(positions.size()));
+			positions.push_back(c + Float3{ offset(random), offset(random), offset(random) });
+		}
+	}
+}
+
+// Closest hit over all triangles, the reference for the hierarchies. Intersects the triangle's plane, then solves for
+// the barycentrics of the hit point, in double precision, so it shares no code and little rounding with
+// IntersectRayTriangle()
+inline bool IntersectBruteForce(const std::vector<Float3>& positions, const std::vector<uint32_t>& indices, const BvhRay& ray, BvhHit& hit)
+{
+	struct Double3
+	{
+		double x, y, z;
+	};
+	auto toDouble = [](const Float3& value) { return Double3{ value.x, value.y, value.z }; };
+	auto subtract = [](const Double3& a, const Double3& b) { return Double3{ a.x - b.x, a.y - b.y, a.z - b.z }; };
+	auto dot = [](const Double3& a, const Double3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; };
+	auto cross = [](const Double3& a, const Double3& b) { return Double3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; };
+
+	const Double3 origin = toDouble(ray.origin);
+	const Double3 direction = toDouble(ray.direction);
+	hit = {};
+	hit.t = ray.tMax;
+	for (uint32_t i = 0; i < indices.size() / 3; i++)
+	{
+		const Double3 v0 = toDouble(positions[indices[i * 3]]);
+		const Double3 edge1 = subtract(toDouble(positions[indices[i * 3 + 1]]), v0);
+		const Double3 edge2 = subtract(toDouble(positions[indices[i * 3 + 2]]), v0);
+		const Double3 normal = cross(edge1, edge2);
+		const double normalLengthSquared = dot(normal, normal);
+		const double facing = dot(normal, direction);
+		if (normalLengthSquared == 0.0 || facing == 0.0)
+		{
+			continue;
+		}
+		const double t = dot(normal, subtract(v0, origin)) / facing;
+		if (!(t > ray.tMin && t < hit.t))
+		{
+			continue;
+		}
+		// point - v0 = u * edge1 + v * edge2
+		const Double3 relative = subtract({ origin.x + direction.x * t, origin.y + direction.y * t, origin.z + direction.z * t }, v0);
+		const double u = dot(cross(relative, edge2), normal) / normalLengthSquared;
+		const double v = dot(cross(edge1, relative), normal) / normalLengthSquared;
+		if (u >= 0.0 && v >= 0.0 && u + v <= 1.0)
+		{
+			hit = { float(t), float(u), float(v), i };
+		}
+	}
+	return hit.triangle != BvhHit::InvalidTriangle;
+}
+
+// Same triangle at nearly the same distance, or a tie between overlapping triangles where either may win.
+// Float hits against the double precision reference
+inline bool IsSameHit(const BvhHit& hit, const BvhHit& reference)
+{
+	return NearlyEqual(hit.t, reference.t, 1e-4f) && (hit.triangle == reference.triangle || NearlyEqual(hit.t, reference.t, 1e-6f));
+}
@@ -1,6 +1,47 @@
 #include <iostream>
+#include <cstring>
+#include "TestFramework.h"
 
-int main()
+// Usage: ModuleTest [--bench] [name filter]
+int main(int argc, char* argv[])
 {
-	return 0;
-}
\ No newline at end of file
+	bool bRunBenchmarks = false;
+	const char* filter = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+		{
+			bRunBenchmarks = true;
+		}
+		else
+		{
+			filter = argv[i];
+		}
+	}
+
+	int numFailed = 0;
+	int numRun = 0;
+	for (const TestCaseEntry& entry : GetTestRegistry())
+	{
+		if (entry.bBenchmark != bRunBenchmarks || (filter && strstr(entry.name, filter) == nullptr))
+		{
+			continue;
+		}
+
+		std::cout << (entry.bBenchmark ? "[ BENCH ] " : "[ RUN   ] ") << entry.name << std::endl;
+		numRun++;
+		try
+		{
+			entry.function();
+			std::cout << "[    OK ] " << entry.name << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "[ FAIL  ] " << entry.name << ": " << e.what() << std::endl;
+			numFailed++;
+		}
+	}
+
+	std::cout << numRun - numFailed << "/" << numRun << " passed" << std::endl;
+	return numFailed == 0 ? 0 : 1;
+}
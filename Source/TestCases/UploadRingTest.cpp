@@ -0,0 +1,119 @@
+#include "TestFramework.h"
+#include "UploadRing.h"
+#include "NullRHI.h"
+
+#include <cstdlib>
+
+// Plain host memory standing in for a mapped upload heap
+struct HostArena
+{
+	explicit HostArena(uint64_t size) : storage(size + UploadAlignmentTexture) {}
+
+	uint8_t* GetBase() { return reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(storage.data()) + UploadAlignmentTexture - 1) & ~uintptr_t(UploadAlignmentTexture - 1)); }
+
+	std::vector<uint8_t> storage;
+};
+
+TEST_CASE(UploadRing_RespectsAlignment)
+{
+	HostArena arena(4096);
+	UploadRingAllocator ring(arena.GetBase(), 0x10000, 4096);
+	UploadAllocation vertices = ring.Allocate(36, UploadAlignmentVertex);
+	UploadAllocation constants = ring.Allocate(64, UploadAlignmentConstant);
+	UploadAllocation texels = ring.Allocate(100, UploadAlignmentTexture);
+	TEST_EXPECT(vertices.offset == 0);
+	TEST_EXPECT(constants.offset == 256 && constants.gpuAddress % UploadAlignmentConstant == 0);
+	TEST_EXPECT(texels.offset == 512 && texels.gpuAddress % UploadAlignmentTexture == 0);
+	TEST_EXPECT(texels.pCpuAddress == arena.GetBase() + 512);
+}
+
+TEST_CASE(UploadRing_ChunksReturnedOnFence)
+{
+	HostArena arena(1024);
+	UploadRingAllocator ring(arena.GetBase(), 0, 1024);
+	TEST_EXPECT(ring.Allocate(600, UploadAlignmentVertex).IsValid());
+	ring.EndFrame(1);
+	TEST_EXPECT(ring.Allocate(400, UploadAlignmentVertex).IsValid());
+	ring.EndFrame(2);
+
+	// Frame 1 still in flight, allocation would have to wrap into it
+	TEST_EXPECT(!ring.Allocate(100, UploadAlignmentVertex).IsValid());
+
+	ring.Retire(1);
+	UploadAllocation wrapped = ring.Allocate(512, UploadAlignmentTexture);
+	TEST_EXPECT(wrapped.IsValid() && wrapped.offset == 0);
+	ring.EndFrame(3);
+
+	ring.Retire(3);
+	TEST_EXPECT(ring.GetUsedSize() == 0);
+	TEST_EXPECT(ring.GetNumFramesInFlight() == 0);
+}
+
+TEST_CASE(UploadHeap_EngineFramesReuseRing)
+{
+	NullRHIDevice device;
+	UploadHeap heap(&device, 64 * 1024);
+	auto fence = device.CreateFence(0);
+	const float data[64] = {};
+	for (uint64_t frame = 1; frame <= 100; frame++)
+	{
+		// 2 frames in flight
+		if (frame > 2)
+		{
+			fence->Wait(frame - 2);
+		}
+		heap.BeginFrame(fence->GetCompletedValue());
+		for (int i = 0; i < 16; i++)
+		{
+			UploadAllocation allocation = heap.Upload(data, sizeof(data), UploadAlignmentConstant);
+			TEST_EXPECT(allocation.gpuAddress >= heap.GetResource()->GetGpuVirtualAddress());
+		}
+		heap.EndFrame(frame);
+		device.GetGraphicsQueue()->Signal(fence.get(), frame);
+	}
+	// 100 frames * 4KB went through a 64KB ring
+	TEST_EXPECT(heap.GetRing().GetPeakUsedSize() <= heap.GetRing().GetCapacity());
+}
+
+BENCHMARK_CASE(UploadRing_AllocateAndCopy)
+{
+	const uint64_t capacity = 64ull * 1024 * 1024;
+	HostArena arena(capacity);
+	UploadRingAllocator ring(arena.GetBase(), 0, capacity);
+	uint8_t payload[256] = {};
+
+	const int numFrames = 1000;
+	const int allocationsPerFrame = 10000;
+	BenchmarkTimer timer;
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		// 2 frames in flight
+		ring.Retire(frame > 2 ? frame - 2 : 0);
+		for (int i = 0; i < allocationsPerFrame; i++)
+		{
+			const uint64_t size = 64 + (i & 3) * 64;
+			UploadAllocation allocation = ring.Allocate(size, (i & 1) ? UploadAlignmentConstant : UploadAlignmentVertex);
+			memcpy(allocation.pCpuAddress, payload, size);
+		}
+		ring.EndFrame(frame + 1);
+	}
+	ReportBenchmark("Ring allocate + memcpy", timer.GetElapsedSeconds(), double(numFrames) * allocationsPerFrame, "alloc");
+
+	// Baseline, a heap allocation per dynamic buffer
+	std::vector<uint8_t*> allocations(allocationsPerFrame);
+	BenchmarkTimer mallocTimer;
+	for (int frame = 0; frame < numFrames / 10; frame++)
+	{
+		for (int i = 0; i < allocationsPerFrame; i++)
+		{
+			const uint64_t size = 64 + (i & 3) * 64;
+			allocations[i] = static_cast<uint8_t*>(malloc(size));
+			memcpy(allocations[i], payload, size);
+		}
+		for (uint8_t* pData : allocations)
+		{
+			free(pData);
+		}
+	}
+	ReportBenchmark("malloc + memcpy + free (baseline)", mallocTimer.GetElapsedSeconds(), double(numFrames / 10) * allocationsPerFrame, "alloc");
+}
@@ -0,0 +1,169 @@
+#include "TestFramework.h"
+#include "VertexLayout.h"
+
+#include <random>
+
+using TestVertexLayout = VertexLayout<
+	VertexAttribute<"POSITION", Half4>,
+	VertexAttribute<"NORMAL", OctNormal>,
+	VertexAttribute<"COLOR", ColorRGBA8>,
+	VertexAttribute<"TEXCOORD", Half2, 1>,
+	VertexAttribute<"TEXCOORD", Float2, 2>>;
+
+// Everything a pipeline needs is a constant expression
+static_assert(TestVertexLayout::Stride == 8 + 4 + 4 + 4 + 8);
+static_assert(TestVertexLayout::Offsets[3] == 16);
+static_assert(TestVertexLayout::GetInputElements()[1].format == RHIFormat::R16G16_SNORM);
+static_assert(TestVertexLayout::GetInputElements(2)[4].inputSlot == 2 && TestVertexLayout::GetInputElements()[4].semanticIndex == 2);
+static_assert(sizeof(TestVertexLayout::Vertex) == TestVertexLayout::Stride);
+
+static std::vector<Float3> MakeRandomVectors(size_t count, float range, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> distribution(-range, range);
+	std::vector<Float3> vectors(count);
+	for (Float3& vector : vectors)
+	{
+		vector = { distribution(random), distribution(random), distribution(random) };
+	}
+	return vectors;
+}
+
+TEST_CASE(VertexLayout_InputLayout)
+{
+	const std::vector<RHIInputElementDesc> layout = TestVertexLayout::GetInputLayout();
+	TEST_EXPECT(layout.size() == 5);
+	TEST_EXPECT(strcmp(layout[0].semanticName, "POSITION") == 0 && layout[0].format == RHIFormat::R16G16B16A16_FLOAT && layout[0].alignedByteOffset == 0);
+	TEST_EXPECT(strcmp(layout[2].semanticName, "COLOR") == 0 && layout[2].alignedByteOffset == 12);
+	TEST_EXPECT(strcmp(layout[3].semanticName, "TEXCOORD") == 0 && layout[3].semanticIndex == 1 && layout[3].format == RHIFormat::R16G16_FLOAT);
+	// Same semantic string in two attributes, both point at valid names
+	TEST_EXPECT(strcmp(layout[4].semanticName, "TEXCOORD") == 0 && layout[4].alignedByteOffset == 20);
+
+	TestVertexLayout::Vertex vertex = {};
+	vertex.Set<4>(Float2{ 0.25f, 0.5f });
+	vertex.Set<2>(PackColorRGBA8({ 1.0f, 0.0f, 0.0f, 1.0f }));
+	TEST_EXPECT(vertex.Get<4>().y == 0.5f && vertex.Get<2>().rgba == 0xff0000ff);
+}
+
+TEST_CASE(VertexPacking_HalfConversion)
+{
+	// Every finite half survives a round trip through float
+	for (uint32_t half = 0; half < 0x10000; half++)
+	{
+		if ((half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0)
+		{
+			continue;
+		}
+		TEST_EXPECT(FloatToHalf(HalfToFloat(uint16_t(half))) == half);
+	}
+	TEST_EXPECT(FloatToHalf(1.0f) == 0x3c00 && FloatToHalf(-2.0f) == 0xc000);
+	TEST_EXPECT(FloatToHalf(65520.0f) == 0x7c00);
+	TEST_EXPECT(FloatToHalf(std::nanf("")) == 0x7e00);
+	// Ties round to even: 1 + 2^-11 is halfway between 1 and the next half
+	TEST_EXPECT(FloatToHalf(1.0f + 1.0f / 2048.0f) == 0x3c00);
+	TEST_EXPECT(FloatToHalf(1.0f + 3.0f / 2048.0f) == 0x3c02);
+	TEST_EXPECT(HalfToFloat(0x0001) == 5.9604644775390625e-8f);
+}
+
+TEST_CASE(VertexPacking_KernelsMatchScalar)
+{
+	// Odd count exercises the scalar tail, the stride the interleaved path
+	const size_t count = 1003;
+	const std::vector<Float3> positions = MakeRandomVectors(count, 70000.0f, 1);
+	std::vector<Float3> normals = MakeRandomVectors(count, 1.0f, 2);
+	normals[0] = { 0.0f, 0.0f, -1.0f };
+	normals[1] = { 0.0f, -0.0f, 1.0f };
+	std::vector<Float4> colors(count);
+	std::vector<Float2> texCoords(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		colors[i] = { positions[i].x / 30000.0f, normals[i].y, float(i % 256) / 255.0f, 2.0f };
+		texCoords[i] = { positions[i].y * 1e-9f, normals[i].z * 4.0f };
+	}
+
+	std::vector<TestVertexLayout::Vertex> vertices(count);
+	TestVertexLayout::PackAttribute<0>(PackPositionsHalf4, positions.data(), count, vertices.data());
+	TestVertexLayout::PackAttribute<1>(PackNormalsOctahedral, normals.data(), count, vertices.data());
+	TestVertexLayout::PackAttribute<2>(PackColorsRGBA8, colors.data(), count, vertices.data());
+	TestVertexLayout::PackAttribute<3>(PackTexCoordsHalf2, texCoords.data(), count, vertices.data());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const Half4 position = vertices[i].Get<0>();
+		TEST_EXPECT(position.x == FloatToHalf(positions[i].x) && position.y == FloatToHalf(positions[i].y) && position.z == FloatToHalf(positions[i].z) && position.w == 0x3c00);
+		const OctNormal normal = vertices[i].Get<1>();
+		const OctNormal expectedNormal = EncodeOctahedral(normals[i]);
+		TEST_EXPECT(normal.x == expectedNormal.x && normal.y == expectedNormal.y);
+		TEST_EXPECT(vertices[i].Get<2>().rgba == PackColorRGBA8(colors[i]).rgba);
+		const Half2 texCoord = vertices[i].Get<3>();
+		TEST_EXPECT(texCoord.x == FloatToHalf(texCoords[i].x) && texCoord.y == FloatToHalf(texCoords[i].y));
+	}
+}
+
+TEST_CASE(VertexPacking_OctahedralError)
+{
+	const std::vector<Float3> vectors = MakeRandomVectors(100000, 1.0f, 3);
+	double maxAngle = 0.0;
+	for (const Float3& vector : vectors)
+	{
+		// Angle from the cross product, acos loses too much precision near 0
+		const Float3 decoded = DecodeOctahedral(EncodeOctahedral(vector));
+		const double cx = double(decoded.y) * vector.z - double(decoded.z) * vector.y;
+		const double cy = double(decoded.z) * vector.x - double(decoded.x) * vector.z;
+		const double cz = double(decoded.x) * vector.y - double(decoded.y) * vector.x;
+		const double dot = double(decoded.x) * vector.x + double(decoded.y) * vector.y + double(decoded.z) * vector.z;
+		maxAngle = std::max(maxAngle, std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot));
+	}
+	// 2 x 16 bit octahedral stays well below 0.01 degrees
+	TEST_EXPECT(maxAngle < 0.01 * 3.14159265 / 180.0);
+}
+
+BENCHMARK_CASE(VertexPacking_Kernels)
+{
+	const size_t count = 4 * 1024 * 1024;
+	const std::vector<Float3> vectors = MakeRandomVectors(count, 1.0f, 4);
+	std::vector<Float4> colors(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		colors[i] = { vectors[i].x, vectors[i].y, vectors[i].z, 1.0f };
+	}
+	std::vector<uint8_t> destination(count * 8);
+
+	auto run = [&](const char* name, size_t numVertices, auto&& function)
+	{
+		function();
+		BenchmarkTimer timer;
+		function();
+		ReportBenchmark(name, timer.GetElapsedSeconds(), double(numVertices), "vtx");
+	};
+
+	run("Float3 -> Half4, scalar", count, [&]
+	{
+		Half4* pOut = reinterpret_cast<Half4*>(destination.data());
+		for (size_t i = 0; i < count; i++)
+		{
+			pOut[i] = { FloatToHalf(vectors[i].x), FloatToHalf(vectors[i].y), FloatToHalf(vectors[i].z), 0x3c00 };
+		}
+	});
+	run("Float3 -> Half4, PackPositionsHalf4", count, [&] { PackPositionsHalf4(vectors.data(), count, destination.data(), sizeof(Half4)); });
+	run("Float4 -> RGBA8, scalar", count, [&]
+	{
+		ColorRGBA8* pOut = reinterpret_cast<ColorRGBA8*>(destination.data());
+		for (size_t i = 0; i < count; i++)
+		{
+			pOut[i] = PackColorRGBA8(colors[i]);
+		}
+	});
+	run("Float4 -> RGBA8, PackColorsRGBA8", count, [&] { PackColorsRGBA8(colors.data(), count, destination.data(), sizeof(ColorRGBA8)); });
+	run("Float3 -> octahedral, scalar", count, [&]
+	{
+		OctNormal* pOut = reinterpret_cast<OctNormal*>(destination.data());
+		for (size_t i = 0; i < count; i++)
+		{
+			pOut[i] = EncodeOctahedral(vectors[i]);
+		}
+	});
+	run("Float3 -> octahedral, PackNormalsOctahedral", count, [&] { PackNormalsOctahedral(vectors.data(), count, destination.data(), sizeof(OctNormal)); });
+	// Into interleaved 16 byte vertices, only half of them fit the destination
+	run("Float3 -> octahedral, 16 byte stride", count / 2, [&] { PackNormalsOctahedral(vectors.data(), count / 2, destination.data(), 16); });
+}
@@ -0,0 +1,118 @@
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include "LightmapBaker.h"
+#include "MeshFile.h"
+
+// Bakes the lightmap of a cooked .mesh standing on a floor into a .lightmap, loaded by the engine from its assets
+// Usage: LightmapCooker [options] input.mesh output.lightmap
+static void PrintUsage()
+{
+	std::cout << "Usage: LightmapCooker [options] input.mesh output.lightmap\n"
+		"  --density N     texels per world unit, default 8\n"
+		"  --atlas N       atlas size, default 512\n"
+		"  --samples N     gather paths per texel, default 64\n"
+		"  --bounces N     maximum bounces, default 4\n"
+		"  --threads N     worker threads, default one per core\n";
+}
+
+int main(int argc, char* argv[])
+{
+	LightmapSettings settings;
+	uint32_t numWorkerThreads = JobSystem::GetDefaultNumWorkerThreads();
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool bHasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--density") == 0 && bHasValue)
+		{
+			settings.texelsPerUnit = float(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--atlas") == 0 && bHasValue)
+		{
+			settings.atlasSize = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--samples") == 0 && bHasValue)
+		{
+			settings.numSamples = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bounces") == 0 && bHasValue)
+		{
+			settings.maxBounces = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && bHasValue)
+		{
+			numWorkerThreads = uint32_t(atoi(argv[++i]));
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2 || settings.texelsPerUnit <= 0.0f || settings.atlasSize == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		MeshFile mesh;
+		mesh.Open(std::filesystem::path(paths[0]).wstring());
+
+		// Same studio setup as ReferenceRenderer: the mesh on a floor under sky and sun
+		LightmapScene scene;
+		scene.materials = { { { 0.7f, 0.7f, 0.7f } }, { { 0.5f, 0.5f, 0.5f } } };
+		LightmapObject& object = scene.objects.emplace_back();
+		object.positions.resize(mesh.GetNumVertices());
+		for (uint32_t i = 0; i < mesh.GetNumVertices(); i++)
+		{
+			object.positions[i] = mesh.GetPosition(i);
+		}
+		object.indices.resize(mesh.GetNumIndices());
+		for (uint32_t i = 0; i < mesh.GetNumIndices(); i++)
+		{
+			object.indices[i] = mesh.GetIndex(i);
+		}
+
+		const MeshBounds& bounds = mesh.GetHeader().bounds;
+		const Float3 center = (bounds.min + bounds.max) * 0.5f;
+		const float radius = std::max(Length(bounds.max - bounds.min) * 0.5f, 1e-3f);
+		LightmapObject& floor = scene.objects.emplace_back();
+		floor.positions = { { -1.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 1.0f } };
+		floor.indices = { 0, 2, 1, 1, 2, 3 };
+		floor.objectToWorld = MatrixIdentity();
+		floor.objectToWorld.m[0][0] = floor.objectToWorld.m[2][2] = radius * 4.0f;
+		floor.objectToWorld.m[3][0] = center.x;
+		floor.objectToWorld.m[3][1] = bounds.min.y;
+		floor.objectToWorld.m[3][2] = center.z;
+		floor.material = 1;
+		scene.skyRadiance = { 0.5f, 0.6f, 0.8f };
+		scene.sunDirection = Normalize({ -0.4f, -1.0f, 0.6f });
+		scene.sunIlluminance = { 3.0f, 2.9f, 2.7f };
+
+		JobSystem jobSystem(numWorkerThreads);
+		LightmapBaker baker(&jobSystem, settings);
+		baker.SetScene(scene);
+		const LightmapBakeStatistics statistics = baker.Bake([](uint64_t numBakedTexels, uint64_t numTexels)
+		{
+			std::cout << "\r" << (numTexels > 0 ? numBakedTexels * 100 / numTexels : 100) << "%" << std::flush;
+		});
+		WriteLightmapFile(std::filesystem::path(paths[1]).wstring(), CookLightmap(baker));
+
+		std::cout << "\r" << paths[1] << ": " << statistics.numCharts << " charts in " << baker.GetAtlases().size() << " atlases of " << settings.atlasSize << "x" << settings.atlasSize
+			<< ", " << statistics.numTexels << " texels, " << statistics.seconds << " s, " << statistics.GetTexelsPerSecond() / 1e3 << " Ktexels/s, "
+			<< statistics.GetTexelsPerSecond() / statistics.numThreads / 1e3 << " Ktexels/s per thread (" << statistics.numThreads << " threads)" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "LightmapCooker: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
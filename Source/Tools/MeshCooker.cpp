@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include "MeshBuilder.h"
+#include "FileIO.h"
+
+// Converts Wavefront OBJ files into the binary .mesh format loaded by MeshFile
+// Usage: MeshCooker [options] input.obj output.mesh
+static void PrintUsage()
+{
+	std::cout << "Usage: MeshCooker [options] input.obj output.mesh\n"
+		"  --quantize-positions  add 16 bit unorm positions\n"
+		"  --quantize-normals    add 8 bit snorm normals\n"
+		"  --quantized-only      drop the float streams that have a quantized version\n"
+		"  --index32             always write 32 bit indices\n";
+}
+
+int main(int argc, char* argv[])
+{
+	MeshCookOptions options;
+	bool bQuantizedOnly = false;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quantize-positions") == 0)
+		{
+			options.bQuantizedPositions = true;
+		}
+		else if (strcmp(argv[i], "--quantize-normals") == 0)
+		{
+			options.bQuantizedNormals = true;
+		}
+		else if (strcmp(argv[i], "--quantized-only") == 0)
+		{
+			bQuantizedOnly = true;
+		}
+		else if (strcmp(argv[i], "--index32") == 0)
+		{
+			options.bForce32BitIndices = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+	options.bFloatPositions = !(bQuantizedOnly && options.bQuantizedPositions);
+	options.bFloatNormals = !(bQuantizedOnly && options.bQuantizedNormals);
+
+	try
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+		const MeshData mesh = ImportObj(std::filesystem::path(paths[0]).wstring());
+		const std::vector<uint8_t> cookedMesh = CookMesh(mesh, options);
+		WriteMeshFile(std::filesystem::path(paths[1]).wstring(), cookedMesh);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+		std::cout << paths[1] << ": " << mesh.positions.size() << " vertices, " << mesh.indices.size() / 3 << " triangles, "
+			<< std::max<size_t>(mesh.submeshes.size(), 1) << " submeshes, " << cookedMesh.size() << " bytes, " << seconds << " s" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "MeshCooker: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
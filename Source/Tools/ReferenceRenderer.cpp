@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include "MeshFile.h"
+#include "PathTracer.h"
+
+// Path traces a cooked .mesh into a Radiance .hdr, the lighting reference for regression images
+// Usage: ReferenceRenderer [options] input.mesh output.hdr
+static void PrintUsage()
+{
+	std::cout << "Usage: ReferenceRenderer [options] input.mesh output.hdr\n"
+		"  --size WxH      image size, default 512x512\n"
+		"  --spp N         samples per pixel, default 64\n"
+		"  --bounces N     maximum bounces, default 8\n"
+		"  --threads N     worker threads, default one per core\n";
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t width = 512;
+	uint32_t height = 512;
+	uint32_t numSamples = 64;
+	PathTracerSettings settings;
+	uint32_t numWorkerThreads = JobSystem::GetDefaultNumWorkerThreads();
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool bHasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--size") == 0 && bHasValue && sscanf(argv[i + 1], "%ux%u", &width, &height) == 2)
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--spp") == 0 && bHasValue)
+		{
+			numSamples = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bounces") == 0 && bHasValue)
+		{
+			settings.maxBounces = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && bHasValue)
+		{
+			numWorkerThreads = uint32_t(atoi(argv[++i]));
+		}
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2 || width == 0 || height == 0 || numSamples == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		MeshFile mesh;
+		mesh.Open(std::filesystem::path(paths[0]).wstring());
+		std::vector<Float3> positions(mesh.GetNumVertices());
+		for (uint32_t i = 0; i < mesh.GetNumVertices(); i++)
+		{
+			positions[i] = mesh.GetPosition(i);
+		}
+		std::vector<uint32_t> indices(mesh.GetNumIndices());
+		for (uint32_t i = 0; i < mesh.GetNumIndices(); i++)
+		{
+			indices[i] = mesh.GetIndex(i);
+		}
+
+		// Fixed studio setup: the mesh on a floor under sky and sun, seen from the front above
+		const MeshBounds& bounds = mesh.GetHeader().bounds;
+		const Float3 center = (bounds.min + bounds.max) * 0.5f;
+		const float radius = std::max(Length(bounds.max - bounds.min) * 0.5f, 1e-3f);
+		PathTracerScene scene;
+		scene.AddTriangles(positions.data(), nullptr, uint32_t(positions.size()), indices.data(), uint32_t(indices.size()), scene.AddMaterial({ { 0.7f, 0.7f, 0.7f } }));
+		scene.AddBox({ { center.x - radius * 20.0f, bounds.min.y - radius * 0.1f, center.z - radius * 20.0f }, { center.x + radius * 20.0f, bounds.min.y, center.z + radius * 20.0f } },
+			scene.AddMaterial({ { 0.5f, 0.5f, 0.5f } }));
+		scene.skyRadiance = { 0.5f, 0.6f, 0.8f };
+		scene.sunDirection = Normalize({ -0.4f, -1.0f, 0.6f });
+		scene.sunIlluminance = { 3.0f, 2.9f, 2.7f };
+
+		Camera camera;
+		camera.aspectRatio = float(width) / float(height);
+		camera.forward = Normalize({ 0.0f, -0.35f, 1.0f });
+		camera.position = center - camera.forward * (radius / std::sin(camera.fovY * 0.5f));
+
+		JobSystem jobSystem(numWorkerThreads);
+		PathTracer pathTracer(&jobSystem, settings);
+		const auto startTime = std::chrono::steady_clock::now();
+		pathTracer.SetScene(scene);
+		const double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		pathTracer.Reset(width, height);
+		pathTracer.Render(camera, numSamples);
+
+		HdrImage image;
+		pathTracer.ResolveImage(image);
+		WriteHdrImage(std::filesystem::path(paths[1]).wstring(), image);
+
+		const PathTracerStatistics& statistics = pathTracer.GetStatistics();
+		std::cout << paths[1] << ": " << width << "x" << height << ", " << numSamples << " spp, " << scene.GetNumTriangles() << " triangles, BVH "
+			<< buildSeconds << " s, render " << statistics.seconds << " s, " << statistics.GetSamplesPerSecond() / 1e6 << " Msamples/s, "
+			<< statistics.GetSamplesPerSecondPerThread() / 1e6 << " Msamples/s per thread (" << statistics.numThreads << " threads)" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ReferenceRenderer: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
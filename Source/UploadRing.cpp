@@ -0,0 +1,99 @@
+#include "UploadRing.h"
+
+#include <algorithm>
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+UploadRingAllocator::UploadRingAllocator(uint8_t* pCpuBase, uint64_t gpuBase, uint64_t capacity)
+	: m_pCpuBase(pCpuBase)
+	, m_gpuBase(gpuBase)
+	, m_capacity(capacity)
+	, m_head(0)
+	, m_tail(0)
+	, m_peakUsedSize(0)
+{
+	// Offset 0 after wrapping has to satisfy every alignment
+	check(capacity % UploadAlignmentTexture != 0);
+}
+
+UploadAllocation UploadRingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	check((alignment & (alignment - 1)) != 0);
+	if (size == 0 || size > m_capacity)
+	{
+		return {};
+	}
+
+	const uint64_t offset = m_head % m_capacity;
+	uint64_t alignedOffset = AlignUp(offset, alignment);
+	uint64_t newHead = m_head + (alignedOffset - offset);
+	if (alignedOffset + size > m_capacity)
+	{
+		// Does not fit before the end, restart at offset 0
+		newHead = m_head + (m_capacity - offset);
+		alignedOffset = 0;
+	}
+
+	if (newHead + size - m_tail > m_capacity)
+	{
+		return {};
+	}
+
+	m_head = newHead + size;
+	m_peakUsedSize = std::max(m_peakUsedSize, m_head - m_tail);
+
+	UploadAllocation allocation;
+	allocation.pCpuAddress = m_pCpuBase + alignedOffset;
+	allocation.gpuAddress = m_gpuBase + alignedOffset;
+	allocation.offset = alignedOffset;
+	allocation.size = size;
+	return allocation;
+}
+
+void UploadRingAllocator::EndFrame(uint64_t fenceValue)
+{
+	m_frameMarkers.push_back({ fenceValue, m_head });
+}
+
+void UploadRingAllocator::Retire(uint64_t completedFenceValue)
+{
+	while (!m_frameMarkers.empty() && m_frameMarkers.front().fenceValue <= completedFenceValue)
+	{
+		m_tail = m_frameMarkers.front().head;
+		m_frameMarkers.pop_front();
+	}
+}
+
+UploadHeap::UploadHeap(RHIDevice* pDevice, uint64_t capacity)
+	: m_buffer(pDevice->CreateResource(RHIResourceDesc::Buffer(capacity, RHIHeapType::Upload)))
+	, m_ring(CreateRing(m_buffer.get(), capacity))
+{
+}
+
+UploadHeap::~UploadHeap()
+{
+	m_buffer->Unmap();
+}
+
+UploadRingAllocator UploadHeap::CreateRing(RHIResource* pBuffer, uint64_t capacity)
+{
+	// Upload heaps can stay mapped while the GPU reads them, map once and never again
+	return UploadRingAllocator(static_cast<uint8_t*>(pBuffer->Map()), pBuffer->GetGpuVirtualAddress(), capacity);
+}
+
+UploadAllocation UploadHeap::Allocate(uint64_t size, uint64_t alignment)
+{
+	return m_ring.Allocate(size, alignment);
+}
+
+UploadAllocation UploadHeap::Upload(const void* pData, uint64_t size, uint64_t alignment)
+{
+	UploadAllocation allocation = m_ring.Allocate(size, alignment);
+	// Ring is sized for the worst frame times frames in flight
+	check(!allocation.IsValid());
+	memcpy(allocation.pCpuAddress, pData, size);
+	return allocation;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// Sub-allocating upload memory
+// One persistently mapped upload buffer is carved by an aligned bump pointer that moves around a ring.
+// Every frame marks its end position with the fence value it will signal, and the space behind it is
+// handed back once that fence completes. Replaces one committed upload resource per dynamic buffer.
+
+#include "RHI.h"
+
+#include <deque>
+
+enum UploadAlignment : uint64_t
+{
+	UploadAlignmentVertex = 16,
+	UploadAlignmentConstant = 256,	// D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+	UploadAlignmentTexture = 512,	// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+};
+
+struct UploadAllocation
+{
+	uint8_t*	pCpuAddress = nullptr;
+	uint64_t	gpuAddress = 0;
+	uint64_t	offset = 0;			// From the start of the arena
+	uint64_t	size = 0;
+
+	bool IsValid() const { return pCpuAddress != nullptr; }
+};
+
+// API neutral ring logic over an already mapped arena
+class UploadRingAllocator
+{
+public:
+	UploadRingAllocator(uint8_t* pCpuBase, uint64_t gpuBase, uint64_t capacity);
+
+	// `alignment` must be a power of two, returns an invalid allocation if the ring is full
+	UploadAllocation Allocate(uint64_t size, uint64_t alignment);
+	void EndFrame(uint64_t fenceValue);
+	void Retire(uint64_t completedFenceValue);
+
+	uint64_t GetCapacity() const { return m_capacity; }
+	uint64_t GetUsedSize() const { return m_head - m_tail; }
+	uint64_t GetPeakUsedSize() const { return m_peakUsedSize; }
+	size_t GetNumFramesInFlight() const { return m_frameMarkers.size(); }
+
+private:
+	struct FrameMarker
+	{
+		uint64_t fenceValue;
+		uint64_t head;
+	};
+
+	uint8_t*				m_pCpuBase;
+	uint64_t				m_gpuBase;
+	uint64_t				m_capacity;
+
+	std::deque<FrameMarker>	m_frameMarkers;
+	uint64_t				m_head;		// Monotonic, offset is `m_head % m_capacity`
+	uint64_t				m_tail;
+	uint64_t				m_peakUsedSize;
+};
+
+// Upload ring backed by an RHI upload buffer, mapped once for its whole lifetime
+class UploadHeap
+{
+public:
+	UploadHeap(RHIDevice* pDevice, uint64_t capacity);
+	~UploadHeap();
+
+	void BeginFrame(uint64_t completedFenceValue) { m_ring.Retire(completedFenceValue); }
+	void EndFrame(uint64_t frameFenceValue) { m_ring.EndFrame(frameFenceValue); }
+
+	UploadAllocation Allocate(uint64_t size, uint64_t alignment);
+	// Allocate and copy in one go, throws if the ring is exhausted
+	UploadAllocation Upload(const void* pData, uint64_t size, uint64_t alignment);
+
+	RHIResource* GetResource() { return m_buffer.get(); }
+	const UploadRingAllocator& GetRing() const { return m_ring; }
+
+private:
+	static UploadRingAllocator CreateRing(RHIResource* pBuffer, uint64_t capacity);
+
+	std::unique_ptr<RHIResource>	m_buffer;
+	UploadRingAllocator				m_ring;
+};
@@ -0,0 +1,187 @@
+#include "Upscale.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	enum : uint32_t
+	{
+		MaxTaps = 4,
+		RowsPerJob = 16,
+	};
+
+	// Taps of one destination row or column, absolute source coordinates
+	struct UpscaleTaps
+	{
+		int32_t	index[MaxTaps];
+		float	weight[MaxTaps];
+	};
+
+	uint32_t GetNumTaps(RHIUpscaleFilter filter)
+	{
+		return filter == RHIUpscaleFilter::CatmullRom ? 4 : 2;
+	}
+
+	// Same expressions as GetTaps() in Upscale.hlsl
+	std::vector<UpscaleTaps> ComputeTaps(int32_t sourceBegin, int32_t sourceEnd, int32_t destSize, RHIUpscaleFilter filter)
+	{
+		const float step = float(sourceEnd - sourceBegin) / float(destSize);
+		std::vector<UpscaleTaps> taps(destSize);
+		for (int32_t i = 0; i < destSize; i++)
+		{
+			const float position = float(sourceBegin) + (float(i) + 0.5f) * step - 0.5f;
+			const float base = std::floor(position);
+			const float t = position - base;
+			UpscaleTaps& tap = taps[i];
+			if (filter == RHIUpscaleFilter::CatmullRom)
+			{
+				tap.weight[0] = t * (-0.5f + t * (1.0f - 0.5f * t));
+				tap.weight[1] = 1.0f + t * t * (-2.5f + 1.5f * t);
+				tap.weight[2] = t * (0.5f + t * (2.0f - 1.5f * t));
+				tap.weight[3] = t * t * (-0.5f + 0.5f * t);
+			}
+			else
+			{
+				tap.weight[0] = 1.0f - t;
+				tap.weight[1] = t;
+			}
+			const int32_t first = int32_t(base) - (filter == RHIUpscaleFilter::CatmullRom ? 1 : 0);
+			for (uint32_t k = 0; k < MaxTaps; k++)
+			{
+				tap.index[k] = std::clamp(first + int32_t(k), sourceBegin, sourceEnd - 1);
+			}
+		}
+		return taps;
+	}
+
+	struct UpscaleJob
+	{
+		const uint8_t*					pSource;
+		uint32_t						sourceRowPitch;
+		RHIRect							sourceRect;
+		uint8_t*						pDest;
+		uint32_t						destRowPitch;
+		RHIRect							destRect;
+		uint32_t						numTaps;
+		std::vector<UpscaleTaps>		columnTaps;
+		std::vector<UpscaleTaps>		rowTaps;
+	};
+
+#if ENGINE_SIMD_SSE2
+	inline __m128 LoadPixel(const uint8_t* pPixel)
+	{
+		uint32_t rgba;
+		memcpy(&rgba, pPixel, sizeof(rgba));
+		const __m128i zero = _mm_setzero_si128();
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int32_t(rgba)), zero), zero));
+	}
+#endif
+
+	// Vertical pass over the source columns into `row`, then the horizontal pass into the destination row
+	void UpscaleRows(const UpscaleJob& job, uint32_t begin, uint32_t end)
+	{
+		const int32_t sourceLeft = job.sourceRect.left;
+		const uint32_t sourceWidth = uint32_t(job.sourceRect.right - sourceLeft);
+		const uint32_t destWidth = uint32_t(job.destRect.right - job.destRect.left);
+		std::vector<float> row(size_t(sourceWidth) * 4);
+		for (uint32_t y = begin; y < end; y++)
+		{
+			const UpscaleTaps& rowTap = job.rowTaps[y];
+			const uint8_t* pSourceRows[MaxTaps];
+			for (uint32_t k = 0; k < job.numTaps; k++)
+			{
+				pSourceRows[k] = job.pSource + size_t(rowTap.index[k]) * job.sourceRowPitch + size_t(sourceLeft) * 4;
+			}
+			uint8_t* pDestRow = job.pDest + size_t(job.destRect.top + int32_t(y)) * job.destRowPitch + size_t(job.destRect.left) * 4;
+
+#if ENGINE_SIMD_SSE2
+			for (uint32_t x = 0; x < sourceWidth; x++)
+			{
+				__m128 sum = _mm_mul_ps(LoadPixel(pSourceRows[0] + x * 4), _mm_set1_ps(rowTap.weight[0]));
+				for (uint32_t k = 1; k < job.numTaps; k++)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(LoadPixel(pSourceRows[k] + x * 4), _mm_set1_ps(rowTap.weight[k])));
+				}
+				_mm_storeu_ps(&row[x * 4], sum);
+			}
+			const __m128 maxValue = _mm_set1_ps(255.0f);
+			for (uint32_t x = 0; x < destWidth; x++)
+			{
+				const UpscaleTaps& columnTap = job.columnTaps[x];
+				__m128 sum = _mm_mul_ps(_mm_loadu_ps(&row[(columnTap.index[0] - sourceLeft) * 4]), _mm_set1_ps(columnTap.weight[0]));
+				for (uint32_t k = 1; k < job.numTaps; k++)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&row[(columnTap.index[k] - sourceLeft) * 4]), _mm_set1_ps(columnTap.weight[k])));
+				}
+				// Round to nearest even like the UNORM conversion, NaN goes to 0
+				const __m128i value = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), maxValue));
+				const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(value, value), _mm_setzero_si128());
+				const uint32_t rgba = uint32_t(_mm_cvtsi128_si32(packed));
+				memcpy(pDestRow + x * 4, &rgba, sizeof(rgba));
+			}
+#else
+			for (uint32_t x = 0; x < sourceWidth; x++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					float sum = 0.0f;
+					for (uint32_t k = 0; k < job.numTaps; k++)
+					{
+						sum += float(pSourceRows[k][x * 4 + c]) * rowTap.weight[k];
+					}
+					row[x * 4 + c] = sum;
+				}
+			}
+			for (uint32_t x = 0; x < destWidth; x++)
+			{
+				const UpscaleTaps& columnTap = job.columnTaps[x];
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					float sum = 0.0f;
+					for (uint32_t k = 0; k < job.numTaps; k++)
+					{
+						sum += row[(columnTap.index[k] - sourceLeft) * 4 + c] * columnTap.weight[k];
+					}
+					const float clamped = sum > 0.0f ? (sum < 255.0f ? sum : 255.0f) : 0.0f;
+					pDestRow[x * 4 + c] = uint8_t(std::nearbyint(clamped));
+				}
+			}
+#endif
+		}
+	}
+}
+
+void UpscaleRGBA8(const uint8_t* pSource, uint32_t sourceRowPitch, const RHIRect& sourceRect,
+	uint8_t* pDest, uint32_t destRowPitch, const RHIRect& destRect, RHIUpscaleFilter filter, JobSystem* pJobSystem)
+{
+	const int32_t destWidth = destRect.right - destRect.left;
+	const int32_t destHeight = destRect.bottom - destRect.top;
+	if (destWidth <= 0 || destHeight <= 0 || sourceRect.right <= sourceRect.left || sourceRect.bottom <= sourceRect.top)
+	{
+		return;
+	}
+
+	UpscaleJob job;
+	job.pSource = pSource;
+	job.sourceRowPitch = sourceRowPitch;
+	job.sourceRect = sourceRect;
+	job.pDest = pDest;
+	job.destRowPitch = destRowPitch;
+	job.destRect = destRect;
+	job.numTaps = GetNumTaps(filter);
+	job.columnTaps = ComputeTaps(sourceRect.left, sourceRect.right, destWidth, filter);
+	job.rowTaps = ComputeTaps(sourceRect.top, sourceRect.bottom, destHeight, filter);
+
+	if (pJobSystem == nullptr || uint32_t(destHeight) <= RowsPerJob)
+	{
+		UpscaleRows(job, 0, uint32_t(destHeight));
+		return;
+	}
+	JobCounter counter;
+	auto upscaleRows = [&job](uint32_t begin, uint32_t end) { UpscaleRows(job, begin, end); };
+	pJobSystem->ParallelFor(uint32_t(destHeight), RowsPerJob, upscaleRows, &counter);
+	pJobSystem->Wait(&counter);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Upscale filter of dynamic resolution
+// CPU reference of Upscale.hlsl, which the software rasterizer also runs for RHICommandList::UpscaleTexture(). Both
+// map destination pixel centers linearly onto the source rectangle and apply a separable 2 tap (bilinear) or 4 tap
+// (Catmull-Rom) kernel, taps outside of the source rectangle are clamped to its edge.
+
+#include "RHI.h"
+#include "JobSystem.h"
+
+// RGBA8 images, rows `rowPitch` bytes apart. Rows are split across `pJobSystem` when given
+void UpscaleRGBA8(const uint8_t* pSource, uint32_t sourceRowPitch, const RHIRect& sourceRect,
+	uint8_t* pDest, uint32_t destRowPitch, const RHIRect& destRect, RHIUpscaleFilter filter, JobSystem* pJobSystem = nullptr);
@@ -0,0 +1,64 @@
+// Upscale pass of dynamic resolution, UpscaleRGBA8() in Upscale.cpp is the CPU reference
+
+Texture2D<float4> Source : register(t0);
+
+cbuffer UpscaleConstants : register(b0)
+{
+	int4	SourceRect;		// left, top, right, bottom
+	float2	DestOrigin;		// Top left of the destination rectangle
+	float2	SourceStep;		// Source texels per destination pixel
+	uint	CatmullRom;
+};
+
+// One triangle covering the viewport
+float4 VSFullscreen(uint vertexId : SV_VertexID) : SV_POSITION
+{
+	float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+	return float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+}
+
+// Same expressions as ComputeTaps() in Upscale.cpp
+void GetTaps(float position, out int first, out float4 weights)
+{
+	float base = floor(position);
+	float t = position - base;
+	if (CatmullRom)
+	{
+		weights.x = t * (-0.5f + t * (1.0f - 0.5f * t));
+		weights.y = 1.0f + t * t * (-2.5f + 1.5f * t);
+		weights.z = t * (0.5f + t * (2.0f - 1.5f * t));
+		weights.w = t * t * (-0.5f + 0.5f * t);
+		first = int(base) - 1;
+	}
+	else
+	{
+		weights = float4(1.0f - t, t, 0.0f, 0.0f);
+		first = int(base);
+	}
+}
+
+float4 PSUpscale(float4 position : SV_POSITION) : SV_Target
+{
+	// Pixel centers map linearly onto the source rectangle
+	float2 sourcePosition = float2(SourceRect.xy) + (position.xy - DestOrigin) * SourceStep - 0.5f;
+	int2 first;
+	float4 weightsX;
+	float4 weightsY;
+	GetTaps(sourcePosition.x, first.x, weightsX);
+	GetTaps(sourcePosition.y, first.y, weightsY);
+
+	const int numTaps = CatmullRom ? 4 : 2;
+	float4 color = 0.0f;
+	for (int y = 0; y < numTaps; y++)
+	{
+		float4 row = 0.0f;
+		int sourceY = clamp(first.y + y, SourceRect.y, SourceRect.w - 1);
+		for (int x = 0; x < numTaps; x++)
+		{
+			int sourceX = clamp(first.x + x, SourceRect.x, SourceRect.z - 1);
+			row += Source.Load(int3(sourceX, sourceY, 0)) * weightsX[x];
+		}
+		color += row * weightsY[y];
+	}
+	return saturate(color);
+}
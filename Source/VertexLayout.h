@@ -0,0 +1,123 @@
+#pragma once
+
+// Vertex layouts declared once as a list of attributes, everything else is derived at compile time:
+//
+//	using SceneVertexLayout = VertexLayout<VertexAttribute<"POSITION", Float3>, VertexAttribute<"COLOR", ColorRGBA8>>;
+//	SceneVertexLayout::Stride, SceneVertexLayout::Offsets[1], SceneVertexLayout::GetInputLayout()
+//
+// Attribute types map to formats through VertexFormatOf, packed types come from VertexPacking.h.
+
+#include "RHI.h"
+#include "VertexPacking.h"
+
+#include <array>
+#include <tuple>
+
+template <typename T>
+struct VertexFormatOf;
+
+template <> struct VertexFormatOf<Float2>		{ static constexpr RHIFormat Format = RHIFormat::R32G32_FLOAT; };
+template <> struct VertexFormatOf<Float3>		{ static constexpr RHIFormat Format = RHIFormat::R32G32B32_FLOAT; };
+template <> struct VertexFormatOf<Float4>		{ static constexpr RHIFormat Format = RHIFormat::R32G32B32A32_FLOAT; };
+template <> struct VertexFormatOf<Half2>		{ static constexpr RHIFormat Format = RHIFormat::R16G16_FLOAT; };
+template <> struct VertexFormatOf<Half4>		{ static constexpr RHIFormat Format = RHIFormat::R16G16B16A16_FLOAT; };
+template <> struct VertexFormatOf<ColorRGBA8>	{ static constexpr RHIFormat Format = RHIFormat::R8G8B8A8_UNORM; };
+template <> struct VertexFormatOf<OctNormal>	{ static constexpr RHIFormat Format = RHIFormat::R16G16_SNORM; };
+
+// String literal usable as a template argument, the template parameter object keeps the name alive
+template <size_t N>
+struct VertexSemantic
+{
+	constexpr VertexSemantic(const char (&name)[N])
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			value[i] = name[i];
+		}
+	}
+
+	char value[N];
+};
+
+template <VertexSemantic Semantic, typename T, uint32_t SemanticIndex = 0>
+struct VertexAttribute
+{
+	using Type = T;
+	static constexpr const char* SemanticName = Semantic.value;
+	static constexpr uint32_t Index = SemanticIndex;
+	static constexpr RHIFormat Format = VertexFormatOf<T>::Format;
+
+	static_assert(sizeof(T) == GetFormatSize(Format), "Attribute type does not match its format");
+	static_assert(sizeof(T) % 4 == 0, "Input elements must stay 4 byte aligned");
+};
+
+template <typename... Attributes>
+class VertexLayout
+{
+public:
+	static constexpr uint32_t NumAttributes = sizeof...(Attributes);
+	static constexpr uint32_t Stride = (0 + ... + uint32_t(sizeof(typename Attributes::Type)));
+
+	template <uint32_t I>
+	using Attribute = std::tuple_element_t<I, std::tuple<Attributes...>>;
+	template <uint32_t I>
+	using AttributeType = typename Attribute<I>::Type;
+
+	// Attributes are tightly packed in declaration order
+	static constexpr std::array<uint32_t, NumAttributes> Offsets = []
+	{
+		std::array<uint32_t, NumAttributes> offsets = {};
+		const uint32_t sizes[] = { uint32_t(sizeof(typename Attributes::Type))... };
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < NumAttributes; i++)
+		{
+			offsets[i] = offset;
+			offset += sizes[i];
+		}
+		return offsets;
+	}();
+
+	static constexpr std::array<RHIInputElementDesc, NumAttributes> GetInputElements(uint32_t inputSlot = 0)
+	{
+		return GetInputElements(inputSlot, std::make_index_sequence<NumAttributes>());
+	}
+
+	// For RHIGraphicsPipelineDesc::inputLayout
+	static std::vector<RHIInputElementDesc> GetInputLayout(uint32_t inputSlot = 0)
+	{
+		const std::array<RHIInputElementDesc, NumAttributes> elements = GetInputElements(inputSlot);
+		return std::vector<RHIInputElementDesc>(elements.begin(), elements.end());
+	}
+
+	// Interleaved vertex storage, attributes are addressed by their position in the layout
+	struct Vertex
+	{
+		template <uint32_t I>
+		void Set(const AttributeType<I>& value) { memcpy(data + Offsets[I], &value, sizeof(value)); }
+
+		template <uint32_t I>
+		AttributeType<I> Get() const
+		{
+			AttributeType<I> value;
+			memcpy(&value, data + Offsets[I], sizeof(value));
+			return value;
+		}
+
+		alignas(4) uint8_t data[Stride];
+	};
+	static_assert(sizeof(Vertex) == Stride, "Vertex storage must not be padded");
+
+	// Fills attribute I of `count` vertices in place with one of the VertexPacking.h stream kernels
+	template <uint32_t I, typename TSource>
+	static void PackAttribute(void (*pKernel)(const TSource*, size_t, void*, size_t), const TSource* pSource, size_t count, Vertex* pVertices)
+	{
+		pKernel(pSource, count, pVertices->data + Offsets[I], Stride);
+	}
+
+private:
+	template <size_t... I>
+	static constexpr std::array<RHIInputElementDesc, NumAttributes> GetInputElements(uint32_t inputSlot, std::index_sequence<I...>)
+	{
+		return { { { Attribute<I>::SemanticName, Attribute<I>::Index, Attribute<I>::Format, inputSlot, Offsets[I] }... } };
+	}
+};
@@ -0,0 +1,188 @@
+#include "VertexPacking.h"
+#include "Simd.h"
+
+namespace
+{
+	template <typename T>
+	void StoreElement(void* pDestination, size_t destinationStride, size_t index, const T& value)
+	{
+		memcpy(static_cast<uint8_t*>(pDestination) + index * destinationStride, &value, sizeof(T));
+	}
+
+#if ENGINE_SIMD_SSE2
+	// 4 floats to 4 halves in the low 16 bits of each lane, same rounding as FloatToHalf().
+	// Lanes are sign extended so _mm_packs_epi32 keeps the exact bit pattern
+	__m128i FloatToHalf4(__m128 value)
+	{
+		const __m128i signMask = _mm_set1_epi32(int32_t(0x80000000u));
+		const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23);
+		const __m128i floatInfinity = _mm_set1_epi32(255 << 23);
+		const __m128i halfInfinity = _mm_set1_epi32(0x7c00);
+		const __m128i nanBit = _mm_set1_epi32(0x200);
+		const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+		const __m128i denormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+		const __m128 sign = _mm_and_ps(value, _mm_castsi128_ps(signMask));
+		const __m128 absolute = _mm_xor_ps(value, sign);
+		const __m128i absoluteBits = _mm_castps_si128(absolute);
+
+		const __m128i bIsNan = _mm_cmpgt_epi32(absoluteBits, floatInfinity);
+		const __m128i bIsRegular = _mm_cmpgt_epi32(halfMax, absoluteBits);
+		const __m128i bIsDenormal = _mm_cmpgt_epi32(minNormal, absoluteBits);
+		const __m128i special = _mm_or_si128(halfInfinity, _mm_and_si128(bIsNan, nanBit));
+
+		const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(denormalMagic))), denormalMagic);
+
+		// Round to nearest even: add 0xfff plus the lowest kept mantissa bit
+		const __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absoluteBits, 31 - 13), 31);
+		const __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absoluteBits, normalBias), mantissaOdd), 13);
+
+		const __m128i finite = _mm_or_si128(_mm_and_si128(bIsDenormal, denormal), _mm_andnot_si128(bIsDenormal, normal));
+		const __m128i result = _mm_or_si128(_mm_and_si128(bIsRegular, finite), _mm_andnot_si128(bIsRegular, special));
+		return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+	}
+
+	// Loads positions [i, i + 4) as one register each, w lane undefined. Reads exactly 12 floats
+	void LoadFloat3x4(const Float3* pSource, __m128& v0, __m128& v1, __m128& v2, __m128& v3)
+	{
+		const float* pFloats = &pSource->x;
+		v0 = _mm_loadu_ps(pFloats + 0);
+		v1 = _mm_loadu_ps(pFloats + 3);
+		v2 = _mm_loadu_ps(pFloats + 6);
+		const __m128 last = _mm_loadu_ps(pFloats + 8);
+		v3 = _mm_shuffle_ps(last, last, _MM_SHUFFLE(0, 3, 2, 1));
+	}
+
+	void StoreLow32(void* pDestination, __m128i value)
+	{
+		const int32_t low = _mm_cvtsi128_si32(value);
+		memcpy(pDestination, &low, sizeof(low));
+	}
+
+	// Lanes of `value` to 4 consecutive strided elements of 4 bytes
+	void Store4x32(uint8_t* pDestination, size_t destinationStride, __m128i value)
+	{
+		StoreLow32(pDestination, value);
+		StoreLow32(pDestination + destinationStride, _mm_srli_si128(value, 4));
+		StoreLow32(pDestination + destinationStride * 2, _mm_srli_si128(value, 8));
+		StoreLow32(pDestination + destinationStride * 3, _mm_srli_si128(value, 12));
+	}
+#endif
+}
+
+void PackPositionsHalf4(const Float3* pPositions, size_t count, void* pDestination, size_t destinationStride)
+{
+	size_t i = 0;
+#if ENGINE_SIMD_SSE2
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const __m128 oneW = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v0, v1, v2, v3;
+		LoadFloat3x4(pPositions + i, v0, v1, v2, v3);
+		v0 = _mm_or_ps(_mm_and_ps(v0, xyzMask), oneW);
+		v1 = _mm_or_ps(_mm_and_ps(v1, xyzMask), oneW);
+		v2 = _mm_or_ps(_mm_and_ps(v2, xyzMask), oneW);
+		v3 = _mm_or_ps(_mm_and_ps(v3, xyzMask), oneW);
+
+		// One Half4 per 64 bit half of each register
+		const __m128i h01 = _mm_packs_epi32(FloatToHalf4(v0), FloatToHalf4(v1));
+		const __m128i h23 = _mm_packs_epi32(FloatToHalf4(v2), FloatToHalf4(v3));
+		uint8_t* pOut = static_cast<uint8_t*>(pDestination) + i * destinationStride;
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pOut), h01);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + destinationStride), _mm_unpackhi_epi64(h01, h01));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + destinationStride * 2), h23);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + destinationStride * 3), _mm_unpackhi_epi64(h23, h23));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const Half4 half = { FloatToHalf(pPositions[i].x), FloatToHalf(pPositions[i].y), FloatToHalf(pPositions[i].z), 0x3c00 };
+		StoreElement(pDestination, destinationStride, i, half);
+	}
+}
+
+void PackTexCoordsHalf2(const Float2* pTexCoords, size_t count, void* pDestination, size_t destinationStride)
+{
+	size_t i = 0;
+#if ENGINE_SIMD_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 uv01 = _mm_loadu_ps(&pTexCoords[i].x);
+		const __m128 uv23 = _mm_loadu_ps(&pTexCoords[i + 2].x);
+		const __m128i halves = _mm_packs_epi32(FloatToHalf4(uv01), FloatToHalf4(uv23));
+		Store4x32(static_cast<uint8_t*>(pDestination) + i * destinationStride, destinationStride, halves);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		StoreElement(pDestination, destinationStride, i, Half2{ FloatToHalf(pTexCoords[i].x), FloatToHalf(pTexCoords[i].y) });
+	}
+}
+
+void PackColorsRGBA8(const Float4* pColors, size_t count, void* pDestination, size_t destinationStride)
+{
+	size_t i = 0;
+#if ENGINE_SIMD_SSE2
+	// NaN takes the second operand of max, packing it as 0 like FloatToUnorm8()
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	auto toUnorm8 = [&](const Float4& color)
+	{
+		return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&color.x), zero), one), scale));
+	};
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i c01 = _mm_packs_epi32(toUnorm8(pColors[i]), toUnorm8(pColors[i + 1]));
+		const __m128i c23 = _mm_packs_epi32(toUnorm8(pColors[i + 2]), toUnorm8(pColors[i + 3]));
+		Store4x32(static_cast<uint8_t*>(pDestination) + i * destinationStride, destinationStride, _mm_packus_epi16(c01, c23));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		StoreElement(pDestination, destinationStride, i, PackColorRGBA8(pColors[i]));
+	}
+}
+
+void PackNormalsOctahedral(const Float3* pNormals, size_t count, void* pDestination, size_t destinationStride)
+{
+	size_t i = 0;
+#if ENGINE_SIMD_SSE2
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x, y, z, w;
+		LoadFloat3x4(pNormals + i, x, y, z, w);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		// Same operation order as EncodeOctahedral(), results are bit identical
+		const __m128 l1Norm = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+		const __m128 invL1Norm = _mm_div_ps(one, l1Norm);
+		const __m128 octX = _mm_mul_ps(x, invL1Norm);
+		const __m128 octY = _mm_mul_ps(y, invL1Norm);
+
+		const __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, octY)), _mm_or_ps(_mm_and_ps(octX, signMask), one));
+		const __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, octX)), _mm_or_ps(_mm_and_ps(octY, signMask), one));
+		const __m128 bLowerHemisphere = _mm_cmplt_ps(z, zero);
+		__m128 resultX = _mm_or_ps(_mm_and_ps(bLowerHemisphere, foldedX), _mm_andnot_ps(bLowerHemisphere, octX));
+		__m128 resultY = _mm_or_ps(_mm_and_ps(bLowerHemisphere, foldedY), _mm_andnot_ps(bLowerHemisphere, octY));
+		resultX = _mm_mul_ps(_mm_min_ps(_mm_max_ps(resultX, minusOne), one), scale);
+		resultY = _mm_mul_ps(_mm_min_ps(_mm_max_ps(resultY, minusOne), one), scale);
+
+		const __m128i snormX = _mm_cvtps_epi32(resultX);
+		const __m128i snormY = _mm_cvtps_epi32(resultY);
+		const __m128i packed = _mm_packs_epi32(_mm_unpacklo_epi32(snormX, snormY), _mm_unpackhi_epi32(snormX, snormY));
+		Store4x32(static_cast<uint8_t*>(pDestination) + i * destinationStride, destinationStride, packed);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		StoreElement(pDestination, destinationStride, i, EncodeOctahedral(pNormals[i]));
+	}
+}
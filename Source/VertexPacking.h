@@ -0,0 +1,168 @@
+#pragma once
+
+// Packed vertex attribute storage and the kernels that fill it from float streams
+// Single element conversions are inline (tails, tests, CPU readback), stream kernels use SSE2 when available.
+// All conversions round to nearest even, so scalar and SIMD results are bit identical.
+
+#include "EngineMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// R16G16_FLOAT
+struct Half2
+{
+	uint16_t x;
+	uint16_t y;
+};
+
+// R16G16B16A16_FLOAT
+struct Half4
+{
+	uint16_t x;
+	uint16_t y;
+	uint16_t z;
+	uint16_t w;
+};
+
+// R8G8B8A8_UNORM, r in the lowest byte
+struct ColorRGBA8
+{
+	uint32_t rgba;
+};
+
+// R16G16_SNORM, unit vector folded onto an octahedron, 4 bytes instead of 12
+struct OctNormal
+{
+	int16_t x;
+	int16_t y;
+};
+
+inline uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	uint32_t half;
+	if (bits >= (127u + 16u) << 23)
+	{
+		// Too large for half becomes infinity, NaN stays a quiet NaN
+		half = bits > 255u << 23 ? 0x7e00u : 0x7c00u;
+	}
+	else if (bits < (127u - 14u) << 23)
+	{
+		// Denormal result, the float adder does the rounding
+		const uint32_t magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+		float magic;
+		float absolute;
+		memcpy(&magic, &magicBits, sizeof(magic));
+		memcpy(&absolute, &bits, sizeof(absolute));
+		absolute += magic;
+		memcpy(&half, &absolute, sizeof(half));
+		half -= magicBits;
+	}
+	else
+	{
+		const uint32_t mantissaOdd = (bits >> 13) & 1;
+		bits += ((15u - 127u) << 23) + 0xfffu + mantissaOdd;
+		half = bits >> 13;
+	}
+	return uint16_t(half | (sign >> 16));
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+	const uint32_t shiftedExponent = 0x7c00u << 13;
+	uint32_t bits = (uint32_t(half) & 0x7fffu) << 13;
+	const uint32_t exponent = bits & shiftedExponent;
+	bits += (127u - 15u) << 23;
+
+	if (exponent == shiftedExponent)
+	{
+		// Infinity or NaN
+		bits += (128u - 16u) << 23;
+	}
+	else if (exponent == 0)
+	{
+		// Denormal, renormalized by the float subtraction
+		const uint32_t magicBits = 113u << 23;
+		float magic;
+		float value;
+		bits += 1u << 23;
+		memcpy(&magic, &magicBits, sizeof(magic));
+		memcpy(&value, &bits, sizeof(value));
+		value -= magic;
+		memcpy(&bits, &value, sizeof(bits));
+	}
+	bits |= (uint32_t(half) & 0x8000u) << 16;
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// NaN packs as 0
+inline uint8_t FloatToUnorm8(float value)
+{
+	const float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+	return uint8_t(std::nearbyint(clamped * 255.0f));
+}
+
+inline ColorRGBA8 PackColorRGBA8(const Float4& color)
+{
+	return { uint32_t(FloatToUnorm8(color.x)) | uint32_t(FloatToUnorm8(color.y)) << 8 | uint32_t(FloatToUnorm8(color.z)) << 16 | uint32_t(FloatToUnorm8(color.w)) << 24 };
+}
+
+inline Float4 UnpackColorRGBA8(ColorRGBA8 color)
+{
+	const float scale = 1.0f / 255.0f;
+	return { (color.rgba & 0xff) * scale, ((color.rgba >> 8) & 0xff) * scale, ((color.rgba >> 16) & 0xff) * scale, (color.rgba >> 24) * scale };
+}
+
+inline int16_t FloatToSnorm16(float value)
+{
+	const float clamped = value > -1.0f ? (value < 1.0f ? value : 1.0f) : -1.0f;
+	return int16_t(std::nearbyint(clamped * 32767.0f));
+}
+
+// `normal` does not need to be normalized, only non-zero
+inline OctNormal EncodeOctahedral(const Float3& normal)
+{
+	const float invL1Norm = 1.0f / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+	float x = normal.x * invL1Norm;
+	float y = normal.y * invL1Norm;
+	if (normal.z < 0.0f)
+	{
+		// Lower hemisphere folds over the diagonals
+		const float foldedX = (1.0f - std::abs(y)) * std::copysign(1.0f, x);
+		const float foldedY = (1.0f - std::abs(x)) * std::copysign(1.0f, y);
+		x = foldedX;
+		y = foldedY;
+	}
+	return { FloatToSnorm16(x), FloatToSnorm16(y) };
+}
+
+inline Float3 DecodeOctahedral(OctNormal encoded)
+{
+	float x = std::max(encoded.x / 32767.0f, -1.0f);
+	float y = std::max(encoded.y / 32767.0f, -1.0f);
+	const float z = 1.0f - std::abs(x) - std::abs(y);
+	const float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+	const float invLength = 1.0f / std::sqrt(x * x + y * y + z * z);
+	return { x * invLength, y * invLength, z * invLength };
+}
+
+// Stream kernels. Element i is written to pDestination + i * destinationStride so they can fill one attribute
+// of interleaved vertices in place, destinationStride == sizeof(element) gives a tightly packed stream
+
+// w = 1
+void PackPositionsHalf4(const Float3* pPositions, size_t count, void* pDestination, size_t destinationStride);
+void PackTexCoordsHalf2(const Float2* pTexCoords, size_t count, void* pDestination, size_t destinationStride);
+void PackColorsRGBA8(const Float4* pColors, size_t count, void* pDestination, size_t destinationStride);
+void PackNormalsOctahedral(const Float3* pNormals, size_t count, void* pDestination, size_t destinationStride);
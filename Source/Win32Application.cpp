@@ -1,6 +1,8 @@
 #include "Win32Application.h"
 #include "Engine.h"
 
+#include <cstdio>
+
 HWND Win32Application::m_hWnd = nullptr;
 
 int Win32Application::Run(Engine* pEngine, HINSTANCE hInstance, int nCmdShow)
@@ -8,9 +10,26 @@ int Win32Application::Run(Engine* pEngine, HINSTANCE hInstance, int nCmdShow)
 	// Parsing command line args
 	int32_t argc;
 	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
-	pEngine->ParseCommandLineArgs(argv, argc);
+	const bool bValidArgs = pEngine->ParseCommandLineArgs(argv, argc);
 	LocalFree(argv);
 
+	// Windows subsystem apps have no console of their own, report to the one the app was started from if any
+	if (!bValidArgs || pEngine->IsHeadless())
+	{
+		FILE* pFile = nullptr;
+		if (AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			freopen_s(&pFile, "CONOUT$", "w", stdout);
+			freopen_s(&pFile, "CONOUT$", "w", stderr);
+		}
+		if (!bValidArgs)
+		{
+			fputs(Engine::GetCommandLineUsage(), stderr);
+			return 1;
+		}
+		return pEngine->RunHeadless();
+	}
+
 	// Initialize window class
 	WNDCLASSEX windowClass{};
 	windowClass.cbSize = sizeof(WNDCLASSEX);